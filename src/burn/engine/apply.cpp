@@ -38,6 +38,7 @@ typedef struct _BURN_CACHE_CONTEXT
     DWORD cSearchPaths;
     DWORD cSearchPathsMax;
     LPWSTR sczLastUsedFolderCandidate;
+    LPWSTR sczLastHitSourceRoot;
 } BURN_CACHE_CONTEXT;
 
 typedef struct _BURN_CACHE_PROGRESS_CONTEXT
@@ -51,6 +52,10 @@ typedef struct _BURN_CACHE_PROGRESS_CONTEXT
 
     BOOL fCancel;
     HRESULT hrError;
+
+    BOOL fReportedProgress;
+    BURN_CACHE_PROGRESS_TYPE lastReportedType;
+    DWORD dwLastReportedPercentage;
 } BURN_CACHE_PROGRESS_CONTEXT;
 
 typedef struct _BURN_EXECUTE_CONTEXT
@@ -134,11 +139,6 @@ static HRESULT AcquireContainerOrPayload(
     __in BURN_CACHE_PROGRESS_CONTEXT* pProgress,
     __out BOOL* pfRetry
     );
-static BOOL IsValidLocalFile(
-    __in_z LPCWSTR wzFilePath,
-    __in DWORD64 qwFileSize,
-    __in BOOL fMinimumFileSize
-    );
 static HRESULT LayoutOrCacheContainerOrPayload(
     __in BURN_CACHE_CONTEXT* pContext,
     __in_opt BURN_CONTAINER* pContainer,
@@ -280,12 +280,6 @@ static int MsiExecuteMessageHandler(
     __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
     __in_opt LPVOID pvContext
     );
-static HRESULT ReportOverallProgressTicks(
-    __in BURN_USER_EXPERIENCE* pUX,
-    __in BOOL fRollback,
-    __in DWORD cOverallProgressTicksTotal,
-    __in BURN_APPLY_CONTEXT* pApplyContext
-    );
 static HRESULT ExecutePackageComplete(
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_VARIABLES* pVariables,
@@ -556,7 +550,7 @@ extern "C" HRESULT ApplyCache(
             hr = ApplyLayoutBundle(&cacheContext, pCacheAction->bundleLayout.pPayloadGroup, pCacheAction->bundleLayout.sczExecutableName, pCacheAction->bundleLayout.sczUnverifiedPath, pCacheAction->bundleLayout.qwBundleSize);
             ExitOnFailure(hr, "Failed cache action: %ls", L"layout bundle");
 
-            hr = ReportOverallProgressTicks(pUX, FALSE, pPlan->cOverallProgressTicksTotal, pContext);
+            hr = ApplyReportOverallProgress(pUX, FALSE, pCacheAction->bundleLayout.qwProgressWeight, pPlan->qwOverallProgressWeightTotal, pContext);
             LogExitOnFailure(hr, MSG_USER_CANCELED, "Cancel during cache: %ls", L"layout bundle");
 
             break;
@@ -582,7 +576,7 @@ extern "C" HRESULT ApplyCache(
             hr = ApplyCachePackage(&cacheContext, pPackage);
             ExitOnFailure(hr, "Failed cache action: %ls", L"cache package");
 
-            hr = ReportOverallProgressTicks(pUX, FALSE, pPlan->cOverallProgressTicksTotal, pContext);
+            hr = ApplyReportOverallProgress(pUX, FALSE, pPackage->qwCacheProgressWeight, pPlan->qwOverallProgressWeightTotal, pContext);
             LogExitOnFailure(hr, MSG_USER_CANCELED, "Cancel during cache: %ls", L"cache package");
 
             break;
@@ -624,6 +618,7 @@ LExit:
     }
     ReleaseMem(cacheContext.rgSearchPaths);
     ReleaseStr(cacheContext.sczLastUsedFolderCandidate);
+    ReleaseStr(cacheContext.sczLastHitSourceRoot);
 
     UserExperienceOnCacheComplete(pUX, hr);
     return hr;
@@ -766,6 +761,45 @@ extern "C" void ApplyClean(
     }
 }
 
+extern "C" HRESULT ApplyReportOverallProgress(
+    __in BURN_USER_EXPERIENCE* pUX,
+    __in BOOL fRollback,
+    __in DWORD64 qwWeight,
+    __in DWORD64 qwOverallProgressWeightTotal,
+    __in BURN_APPLY_CONTEXT* pApplyContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwProgress = 0;
+
+    ::EnterCriticalSection(&pApplyContext->csApply);
+
+    if (fRollback)
+    {
+        pApplyContext->qwOverallProgressWeight -= min(qwWeight, pApplyContext->qwOverallProgressWeight);
+    }
+    else
+    {
+        pApplyContext->qwOverallProgressWeight += qwWeight;
+    }
+
+    dwProgress = qwOverallProgressWeightTotal ? static_cast<DWORD>(min(pApplyContext->qwOverallProgressWeight, qwOverallProgressWeightTotal) * 100 / qwOverallProgressWeightTotal) : 0;
+
+    // Only call the BA when the percentage it would see actually moves, but always send the first one.
+    if (!pApplyContext->fReportedOverallProgress || dwProgress != pApplyContext->dwLastOverallProgress)
+    {
+        pApplyContext->fReportedOverallProgress = TRUE;
+        pApplyContext->dwLastOverallProgress = dwProgress;
+
+        // TODO: consider sending different progress numbers in the future.
+        hr = UserExperienceOnProgress(pUX, fRollback, dwProgress, dwProgress);
+    }
+
+    ::LeaveCriticalSection(&pApplyContext->csApply);
+
+    return hr;
+}
+
 
 // internal helper functions
 
@@ -1124,12 +1158,15 @@ static HRESULT ApplyCacheVerifyContainerOrPayload(
 
     HRESULT hr = S_OK;
     BURN_CACHE_PROGRESS_CONTEXT progress = { };
+    BURN_PROFILER_SPAN span = { };
 
     progress.pCacheContext = pContext;
     progress.pContainer = pContainer;
     progress.pPackage = pPackage;
     progress.pPayloadGroupItem = pPayloadGroupItem;
 
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_CACHE, L"Verify", pContainer ? pContainer->sczId : pPayloadGroupItem->pPayload->sczKey);
+
     if (pContainer)
     {
         hr = CacheVerifyContainer(pContainer, pContext->wzLayoutDirectory, CacheMessageHandler, CacheProgressRoutine, &progress);
@@ -1140,9 +1177,11 @@ static HRESULT ApplyCacheVerifyContainerOrPayload(
     }
     else
     {
-        hr = CacheVerifyPayload(pPayloadGroupItem->pPayload, pContext->wzLayoutDirectory ? pContext->wzLayoutDirectory : pPackage->sczCacheFolder, CacheMessageHandler, CacheProgressRoutine, &progress);
+        hr = CacheVerifyPayload(pPayloadGroupItem->pPayload, pContext->wzLayoutDirectory ? pContext->wzLayoutDirectory : pPackage->sczCacheFolder, !pContext->wzLayoutDirectory, CacheMessageHandler, CacheProgressRoutine, &progress);
     }
 
+    ProfilerEndSpan(&span);
+
     return hr;
 }
 
@@ -1157,6 +1196,7 @@ static HRESULT ExtractContainer(
     LPWSTR sczStreamName = NULL;
     BURN_PAYLOAD* pExtract = NULL;
     BURN_CACHE_PROGRESS_CONTEXT progress = { };
+    BURN_PROFILER_SPAN span = { };
 
     progress.pCacheContext = pContext;
     progress.pContainer = pContainer;
@@ -1195,10 +1235,14 @@ static HRESULT ExtractContainer(
                     ExitOnRootFailure(hr, "BA aborted cache payload extract begin.");
                 }
 
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_CACHE, L"Extract", pExtract->sczKey);
+
                 // TODO: Send progress when extracting stream to file.
                 hr = ContainerStreamToFile(&context, pExtract->sczUnverifiedPath);
                 // Error handling happens after sending complete message to BA.
 
+                ProfilerEndSpan(&span);
+
                 // If succeeded, send 100% complete here to make sure progress was sent to the BA.
                 if (SUCCEEDED(hr))
                 {
@@ -1390,6 +1434,7 @@ static HRESULT ApplyAcquireContainerOrPayload(
     HRESULT hr = S_OK;
     BURN_CACHE_PROGRESS_CONTEXT progress = { };
     BOOL fRetry = FALSE;
+    BURN_PROFILER_SPAN span = { };
 
     progress.pCacheContext = pContext;
     progress.type = BURN_CACHE_PROGRESS_TYPE_ACQUIRE;
@@ -1397,6 +1442,8 @@ static HRESULT ApplyAcquireContainerOrPayload(
     progress.pPackage = pPackage;
     progress.pPayloadGroupItem = pPayloadGroupItem;
 
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_CACHE, L"Acquire", pContainer ? pContainer->sczId : pPayloadGroupItem->pPayload->sczKey);
+
     do
     {
         hr = AcquireContainerOrPayload(&progress, &fRetry);
@@ -1411,6 +1458,8 @@ static HRESULT ApplyAcquireContainerOrPayload(
     } while (fRetry);
 
 LExit:
+    ProfilerEndSpan(&span);
+
     return hr;
 }
 
@@ -1487,7 +1536,7 @@ static HRESULT AcquireContainerOrPayload(
                 // When a payload comes from a container, the container has the highest chance of being correct.
                 // But we want to avoid extracting the container multiple times.
                 // So only consider the destination path, which means the container was already extracted.
-                if (IsValidLocalFile(pContext->rgSearchPaths[dwDestinationSearchPath], qwFileSize, fMinimumFileSize))
+                if (CacheIsValidLocalSource(pContext->rgSearchPaths[dwDestinationSearchPath], qwFileSize, fMinimumFileSize))
                 {
                     fFoundLocal = TRUE;
                     dwChosenSearchPath = dwDestinationSearchPath;
@@ -1500,17 +1549,8 @@ static HRESULT AcquireContainerOrPayload(
 
             if (!fFoundLocal)
             {
-                for (DWORD i = 0; i < pContext->cSearchPaths; ++i)
-                {
-                    // If the file exists locally with the correct size, choose it.
-                    if (IsValidLocalFile(pContext->rgSearchPaths[i], qwFileSize, fMinimumFileSize))
-                    {
-                        dwChosenSearchPath = i;
-
-                        fFoundLocal = TRUE;
-                        break;
-                    }
-                }
+                hr = CacheProbeLocalSourcePaths(pContext->rgSearchPaths, pContext->cSearchPaths, dwDestinationSearchPath, pContext->sczLastHitSourceRoot, qwFileSize, fMinimumFileSize, &dwChosenSearchPath, &fFoundLocal);
+                ExitOnFailure(hr, "Failed to probe local source paths.");
             }
 
             if (BOOTSTRAPPER_CACHE_OPERATION_COPY == cacheOperation)
@@ -1574,6 +1614,10 @@ static HRESULT AcquireContainerOrPayload(
             hr = CopyPayload(pProgress, INVALID_HANDLE_VALUE, pContext->rgSearchPaths[dwChosenSearchPath], wzDestinationPath);
             ExitOnFailure(hr, "Failed to copy payload: %ls", wzPayloadId);
 
+            // Later payloads probe the source root that satisfied this one first.
+            hr = CacheGetSourceRoot(pContext->rgSearchPaths[dwChosenSearchPath], *pwzSourcePath, wzRelativePath, &pContext->sczLastHitSourceRoot);
+            ExitOnFailure(hr, "Failed to remember source root for payload: %ls", wzPayloadId);
+
             // Store the source path so it can be used as the LastUsedFolder if it passes verification.
             pContext->sczLastUsedFolderCandidate = pContext->rgSearchPaths[dwChosenSearchPath];
             pContext->rgSearchPaths[dwChosenSearchPath] = NULL;
@@ -1617,26 +1661,6 @@ LExit:
     return hr;
 }
 
-static BOOL IsValidLocalFile(
-    __in_z LPCWSTR wzFilePath,
-    __in DWORD64 qwFileSize,
-    __in BOOL fMinimumFileSize
-    )
-{
-    LONGLONG llFileSize = 0;
-
-    if (!qwFileSize)
-    {
-        return FileExistsEx(wzFilePath, NULL);
-    }
-    else
-    {
-        return SUCCEEDED(FileSize(wzFilePath, &llFileSize)) &&
-               (static_cast<DWORD64>(llFileSize) == qwFileSize ||
-                fMinimumFileSize && static_cast<DWORD64>(llFileSize) > qwFileSize);
-    }
-}
-
 static HRESULT LayoutOrCacheContainerOrPayload(
     __in BURN_CACHE_CONTEXT* pContext,
     __in_opt BURN_CONTAINER* pContainer,
@@ -1655,6 +1679,7 @@ static HRESULT LayoutOrCacheContainerOrPayload(
     BURN_CACHE_PROGRESS_CONTEXT progress = { };
     BOOL fMove = !pPayload || 1 == pPayload->cRemainingInstances;
     BOOL fCanceledBegin = FALSE;
+    BURN_PROFILER_SPAN span = { };
 
     if (pContainer)
     {
@@ -1681,6 +1706,8 @@ static HRESULT LayoutOrCacheContainerOrPayload(
     progress.pPackage = pPackage;
     progress.pPayloadGroupItem = pPayloadGroupItem;
 
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_CACHE, L"Transfer", pContainer ? pContainer->sczId : wzPayloadId);
+
     do
     {
         fCanceledBegin = FALSE;
@@ -1742,6 +1769,8 @@ static HRESULT LayoutOrCacheContainerOrPayload(
     }
 
 LExit:
+    ProfilerEndSpan(&span);
+
     return hr;
 }
 
@@ -2091,6 +2120,17 @@ static DWORD CALLBACK CacheProgressRoutine(
     }
     DWORD dwOverallPercentage = pProgress->pCacheContext->qwTotalCacheSize ? static_cast<DWORD>(qwCacheProgress * 100 / pProgress->pCacheContext->qwTotalCacheSize) : 0;
 
+    // Between the first and last callback of a step, only call the BA when the overall percentage moves.
+    if (pProgress->fReportedProgress && pProgress->lastReportedType == pProgress->type && pProgress->dwLastReportedPercentage == dwOverallPercentage &&
+        TotalBytesTransferred.QuadPart < TotalFileSize.QuadPart)
+    {
+        ExitFunction();
+    }
+
+    pProgress->fReportedProgress = TRUE;
+    pProgress->lastReportedType = pProgress->type;
+    pProgress->dwLastReportedPercentage = dwOverallPercentage;
+
     switch (pProgress->type)
     {
     case BURN_CACHE_PROGRESS_TYPE_ACQUIRE:
@@ -2210,6 +2250,7 @@ static HRESULT DoExecuteAction(
     BOOL fRetry = FALSE;
     BOOL fStopWusaService = FALSE;
     BOOL fInsideMsiTransaction = FALSE;
+    BURN_PROFILER_SPAN span = { };
 
     pContext->fRollback = FALSE;
 
@@ -2253,21 +2294,25 @@ static HRESULT DoExecuteAction(
             break;
 
         case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE:
+            ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"ExecutePackage", pExecuteAction->exePackage.pPackage->sczId);
             hr = ExecuteExePackage(pEngineState, pExecuteAction, pContext, FALSE, &fRetry, pfSuspend, &restart);
             ExitOnFailure(hr, "Failed to execute EXE package.");
             break;
 
         case BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE:
+            ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"ExecutePackage", pExecuteAction->msiPackage.pPackage->sczId);
             hr = ExecuteMsiPackage(pEngineState, pExecuteAction, pContext, fInsideMsiTransaction, FALSE, &fRetry, pfSuspend, &restart);
             ExitOnFailure(hr, "Failed to execute MSI package.");
             break;
 
         case BURN_EXECUTE_ACTION_TYPE_MSP_TARGET:
+            ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"ExecutePackage", pExecuteAction->mspTarget.pPackage->sczId);
             hr = ExecuteMspPackage(pEngineState, pExecuteAction, pContext, fInsideMsiTransaction, FALSE, &fRetry, pfSuspend, &restart);
             ExitOnFailure(hr, "Failed to execute MSP package.");
             break;
 
         case BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE:
+            ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"ExecutePackage", pExecuteAction->msuPackage.pPackage->sczId);
             hr = ExecuteMsuPackage(pEngineState, pExecuteAction, pContext, FALSE, fStopWusaService, &fRetry, pfSuspend, &restart);
             fStopWusaService = fRetry;
             ExitOnFailure(hr, "Failed to execute MSU package.");
@@ -2304,6 +2349,8 @@ static HRESULT DoExecuteAction(
             ExitOnFailure(hr, "Invalid execute action.");
         }
 
+        ProfilerEndSpan(&span);
+
         if (*pRestart < restart)
         {
             *pRestart = restart;
@@ -2311,6 +2358,9 @@ static HRESULT DoExecuteAction(
     } while (fRetry && *pRestart < BOOTSTRAPPER_APPLY_RESTART_INITIATED);
 
 LExit:
+    // A failed package exits before the end of the loop, so close its span here.
+    ProfilerEndSpan(&span);
+
     return hr;
 }
 
@@ -2325,6 +2375,7 @@ static HRESULT DoRollbackActions(
     DWORD iCheckpoint = 0;
     BOOL fRetryIgnored = FALSE;
     BOOL fSuspendIgnored = FALSE;
+    BURN_PROFILER_SPAN span = { };
 
     pContext->fRollback = TRUE;
 
@@ -2366,21 +2417,25 @@ static HRESULT DoRollbackActions(
                 break;
 
             case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE:
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"RollbackPackage", pRollbackAction->exePackage.pPackage->sczId);
                 hr = ExecuteExePackage(pEngineState, pRollbackAction, pContext, TRUE, &fRetryIgnored, &fSuspendIgnored, &restart);
                 IgnoreRollbackError(hr, "Failed to rollback EXE package.");
                 break;
 
             case BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE:
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"RollbackPackage", pRollbackAction->msiPackage.pPackage->sczId);
                 hr = ExecuteMsiPackage(pEngineState, pRollbackAction, pContext, FALSE, TRUE, &fRetryIgnored, &fSuspendIgnored, &restart);
                 IgnoreRollbackError(hr, "Failed to rollback MSI package.");
                 break;
 
             case BURN_EXECUTE_ACTION_TYPE_MSP_TARGET:
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"RollbackPackage", pRollbackAction->mspTarget.pPackage->sczId);
                 hr = ExecuteMspPackage(pEngineState, pRollbackAction, pContext, FALSE, TRUE, &fRetryIgnored, &fSuspendIgnored, &restart);
                 IgnoreRollbackError(hr, "Failed to rollback MSP package.");
                 break;
 
             case BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE:
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"RollbackPackage", pRollbackAction->msuPackage.pPackage->sczId);
                 hr = ExecuteMsuPackage(pEngineState, pRollbackAction, pContext, TRUE, FALSE, &fRetryIgnored, &fSuspendIgnored, &restart);
                 IgnoreRollbackError(hr, "Failed to rollback MSU package.");
                 break;
@@ -2417,6 +2472,8 @@ static HRESULT DoRollbackActions(
                 ExitOnFailure(hr, "Invalid rollback action: %d.", pRollbackAction->type);
             }
 
+            ProfilerEndSpan(&span);
+
             if (*pRestart < restart)
             {
                 *pRestart = restart;
@@ -2490,7 +2547,7 @@ static HRESULT ExecuteExePackage(
 
     pContext->cExecutedPackages += fRollback ? -1 : 1;
 
-    hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
+    hr = ApplyReportOverallProgress(&pEngineState->userExperience, fRollback, pExecuteAction->exePackage.pPackage->qwExecuteProgressWeight, pEngineState->plan.qwOverallProgressWeightTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted EXE package execute progress.");
 
 LExit:
@@ -2554,7 +2611,7 @@ static HRESULT ExecuteMsiPackage(
 
     pContext->cExecutedPackages += fRollback ? -1 : 1;
 
-    hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
+    hr = ApplyReportOverallProgress(&pEngineState->userExperience, fRollback, pExecuteAction->msiPackage.pPackage->qwExecuteProgressWeight, pEngineState->plan.qwOverallProgressWeightTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSI package execute progress.");
 
 LExit:
@@ -2627,7 +2684,7 @@ static HRESULT ExecuteMspPackage(
 
     pContext->cExecutedPackages += fRollback ? -1 : 1;
 
-    hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
+    hr = ApplyReportOverallProgress(&pEngineState->userExperience, fRollback, pExecuteAction->mspTarget.pPackage->qwExecuteProgressWeight, pEngineState->plan.qwOverallProgressWeightTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSP package execute progress.");
 
 LExit:
@@ -2707,7 +2764,7 @@ static HRESULT ExecuteMsuPackage(
 
     pContext->cExecutedPackages += fRollback ? -1 : 1;
 
-    hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
+    hr = ApplyReportOverallProgress(&pEngineState->userExperience, fRollback, pExecuteAction->msuPackage.pPackage->qwExecuteProgressWeight, pEngineState->plan.qwOverallProgressWeightTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSU package execute progress.");
 
 LExit:
@@ -3072,30 +3129,6 @@ static int MsiExecuteMessageHandler(
     return nResult;
 }
 
-static HRESULT ReportOverallProgressTicks(
-    __in BURN_USER_EXPERIENCE* pUX,
-    __in BOOL fRollback,
-    __in DWORD cOverallProgressTicksTotal,
-    __in BURN_APPLY_CONTEXT* pApplyContext
-    )
-{
-    HRESULT hr = S_OK;
-    DWORD dwProgress = 0;
-
-    ::EnterCriticalSection(&pApplyContext->csApply);
-
-    pApplyContext->cOverallProgressTicks += fRollback ? -1 : 1;
-
-    dwProgress = cOverallProgressTicksTotal ? (pApplyContext->cOverallProgressTicks * 100 / cOverallProgressTicksTotal) : 0;
-
-    // TODO: consider sending different progress numbers in the future.
-    hr = UserExperienceOnProgress(pUX, fRollback, dwProgress, dwProgress);
-
-    ::LeaveCriticalSection(&pApplyContext->csApply);
-
-    return hr;
-}
-
 static HRESULT ExecutePackageComplete(
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_VARIABLES* pVariables,
@@ -100,6 +100,13 @@ void ApplyClean(
     __in BURN_PLAN* pPlan,
     __in HANDLE hPipe
     );
+HRESULT ApplyReportOverallProgress(
+    __in BURN_USER_EXPERIENCE* pUX,
+    __in BOOL fRollback,
+    __in DWORD64 qwWeight,
+    __in DWORD64 qwOverallProgressWeightTotal,
+    __in BURN_APPLY_CONTEXT* pApplyContext
+    );
 
 
 #ifdef __cplusplus
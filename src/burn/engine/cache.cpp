@@ -5,9 +5,41 @@
 static const LPCWSTR BUNDLE_CLEAN_ROOM_WORKING_FOLDER_NAME = L".cr";
 static const LPCWSTR BUNDLE_WORKING_FOLDER_NAME = L".be";
 static const LPCWSTR UNVERIFIED_CACHE_FOLDER_NAME = L".unverified";
+static const LPCWSTR CONTENT_STORE_FOLDER_NAME = L".content";
 static const LPCWSTR PACKAGE_CACHE_FOLDER_NAME = L"Package Cache";
 static const DWORD FILE_OPERATION_RETRY_COUNT = 3;
 static const DWORD FILE_OPERATION_RETRY_WAIT = 2000;
+static const DWORD SOURCE_PROBE_THREAD_COUNT = 4;
+
+enum BURN_CACHE_TRANSFER
+{
+    BURN_CACHE_TRANSFER_MOVE,
+    BURN_CACHE_TRANSFER_HARD_LINK,
+    BURN_CACHE_TRANSFER_BLOCK_CLONE,
+    BURN_CACHE_TRANSFER_COPY,
+};
+
+enum BURN_SOURCE_PROBE_RESULT
+{
+    BURN_SOURCE_PROBE_RESULT_PENDING,
+    BURN_SOURCE_PROBE_RESULT_VALID,
+    BURN_SOURCE_PROBE_RESULT_INVALID,
+};
+
+// Shared with the probe threads, which are always joined before the probe returns.
+typedef struct _BURN_SOURCE_PROBE
+{
+    LPWSTR* rgSearchPaths;
+    DWORD* rgdwOrder;
+    DWORD cOrder;
+    DWORD64 qwFileSize;
+    BOOL fMinimumFileSize;
+
+    volatile LONG iNextOrder;
+    volatile LONG fCancel;
+    volatile LONG* rgnResults;
+    HANDLE hProbeCompleted;
+} BURN_SOURCE_PROBE;
 
 static BOOL vfInitializedCache = FALSE;
 static BOOL vfRunningFromCache = FALSE;
@@ -16,6 +48,8 @@ static LPWSTR vsczWorkingFolder = NULL;
 static LPWSTR vsczDefaultUserPackageCache = NULL;
 static LPWSTR vsczDefaultMachinePackageCache = NULL;
 static LPWSTR vsczCurrentMachinePackageCache = NULL;
+static INIT_ONCE vInitOnceContentStore = INIT_ONCE_STATIC_INIT;
+static BOOL vfContentStoreEnabled = FALSE;
 
 static HRESULT CacheVerifyPayloadSignature(
     __in BURN_PAYLOAD* pPayload,
@@ -31,6 +65,13 @@ static HRESULT GetLastUsedSourceFolder(
     __out_z LPWSTR* psczLastSource
     );
 static HRESULT SecurePerMachineCacheRoot();
+static DWORD WINAPI ProbeLocalSourceThreadProc(
+    __in LPVOID lpThreadParameter
+    );
+static BOOL IsUnderSourceRoot(
+    __in_z LPCWSTR wzSourceRoot,
+    __in_z LPCWSTR wzPath
+    );
 static HRESULT CreateCompletedPath(
     __in BOOL fPerMachine,
     __in LPCWSTR wzCacheId,
@@ -69,12 +110,20 @@ static HRESULT CacheTransferFileWithRetry(
     __in_z LPCWSTR wzSourcePath,
     __in_z LPCWSTR wzDestinationPath,
     __in BOOL fMove,
+    __in BOOL fAllowHardLink,
     __in BURN_CACHE_STEP cacheStep,
     __in DWORD64 qwFileSize,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
     __in LPPROGRESS_ROUTINE pfnProgress,
     __in LPVOID pContext
     );
+static BOOL LinkVerifiedFile(
+    __in_z LPCWSTR wzSourcePath,
+    __in_z LPCWSTR wzDestinationPath
+    );
+static LPCSTR LoggingCacheTransferToString(
+    __in BURN_CACHE_TRANSFER transfer
+    );
 static HRESULT VerifyFileAgainstContainer(
     __in BURN_CONTAINER* pContainer,
     __in_z LPCWSTR wzVerifyPath,
@@ -119,6 +168,52 @@ static HRESULT RemoveBundleOrPackage(
     __in_z LPCWSTR wzBundleOrPackageId,
     __in_z LPCWSTR wzCacheId
     );
+static BOOL IsContentStoreEnabled();
+static BOOL CALLBACK ReadContentStorePolicy(
+    __inout PINIT_ONCE pInitOnce,
+    __inout_opt PVOID pvParameter,
+    __out_opt PVOID* ppvContext
+    );
+static HRESULT GetContentStoreFolder(
+    __in_z LPCWSTR wzCompletedFolder,
+    __deref_out_z LPWSTR* psczContentFolder
+    );
+static HRESULT GetContentStorePath(
+    __in_z LPCWSTR wzCompletedFolder,
+    __in BURN_PAYLOAD* pPayload,
+    __deref_out_z_opt LPWSTR* psczContentPath
+    );
+static HRESULT LinkPayloadFromContentStore(
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzContentPath,
+    __in_z LPCWSTR wzCachedPath,
+    __in BURN_CACHE_STEP cacheStep,
+    __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
+    __in LPPROGRESS_ROUTINE pfnProgress,
+    __in LPVOID pContext
+    );
+static HRESULT AddPayloadToContentStore(
+    __in BOOL fPerMachine,
+    __in_z LPCWSTR wzContentPath,
+    __in_z LPCWSTR wzCachedPath
+    );
+static HRESULT GetFileLinks(
+    __in_z LPCWSTR wzPath,
+    __deref_inout_ecount_opt(*pcLinks) LPWSTR** prgsczLinks,
+    __inout LPUINT pcLinks
+    );
+static HRESULT FindReferencedContent(
+    __in_z LPCWSTR wzDirectory,
+    __in_z LPCWSTR wzContentFolder,
+    __deref_inout_ecount_opt(*pcContent) LPWSTR** prgsczContent,
+    __inout LPUINT pcContent
+    );
+static void RemoveUnreferencedContent(
+    __in_z LPCWSTR wzRemovedFolder,
+    __in_z LPCWSTR wzContentFolder,
+    __in_ecount(cContent) LPWSTR* rgsczContent,
+    __in UINT cContent
+    );
 static HRESULT VerifyFileSize(
     __in HANDLE hFile,
     __in DWORD64 qwFileSize,
@@ -693,6 +788,201 @@ LExit:
     return hr;
 }
 
+extern "C" BOOL CacheIsValidLocalSource(
+    __in_z LPCWSTR wzFilePath,
+    __in DWORD64 qwFileSize,
+    __in BOOL fMinimumFileSize
+    )
+{
+    LONGLONG llFileSize = 0;
+
+    if (!qwFileSize)
+    {
+        return FileExistsEx(wzFilePath, NULL);
+    }
+    else
+    {
+        return SUCCEEDED(FileSize(wzFilePath, &llFileSize)) &&
+               (static_cast<DWORD64>(llFileSize) == qwFileSize ||
+                fMinimumFileSize && static_cast<DWORD64>(llFileSize) > qwFileSize);
+    }
+}
+
+extern "C" HRESULT CacheProbeLocalSourcePaths(
+    __in_ecount(cSearchPaths) LPWSTR* rgSearchPaths,
+    __in DWORD cSearchPaths,
+    __in DWORD dwDestinationSearchPath,
+    __in_z_opt LPCWSTR wzPreferredSourceRoot,
+    __in DWORD64 qwFileSize,
+    __in BOOL fMinimumFileSize,
+    __out DWORD* pdwChosenSearchPath,
+    __out BOOL* pfFound
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_SOURCE_PROBE probe = { };
+    HANDLE rghThreads[SOURCE_PROBE_THREAD_COUNT] = { };
+    DWORD cThreads = 0;
+    BOOL fDecided = FALSE;
+
+    *pfFound = FALSE;
+
+    if (1 == cSearchPaths)
+    {
+        if (CacheIsValidLocalSource(rgSearchPaths[0], qwFileSize, fMinimumFileSize))
+        {
+            *pdwChosenSearchPath = 0;
+            *pfFound = TRUE;
+        }
+
+        ExitFunction();
+    }
+    else if (!cSearchPaths)
+    {
+        ExitFunction();
+    }
+
+    probe.rgSearchPaths = rgSearchPaths;
+    probe.qwFileSize = qwFileSize;
+    probe.fMinimumFileSize = fMinimumFileSize;
+
+    // Keep the authored order up to the destination path so a file that is already there is
+    // never copied over, then prefer the source root that satisfied the previous payload.
+    probe.rgdwOrder = static_cast<DWORD*>(MemAlloc(sizeof(DWORD) * cSearchPaths, FALSE));
+    ExitOnNull(probe.rgdwOrder, hr, E_OUTOFMEMORY, "Failed to allocate source probe order.");
+
+    for (DWORD i = 0; i < cSearchPaths && i <= dwDestinationSearchPath; ++i)
+    {
+        probe.rgdwOrder[probe.cOrder++] = i;
+    }
+
+    for (DWORD i = dwDestinationSearchPath + 1; i < cSearchPaths; ++i)
+    {
+        if (wzPreferredSourceRoot && IsUnderSourceRoot(wzPreferredSourceRoot, rgSearchPaths[i]))
+        {
+            probe.rgdwOrder[probe.cOrder++] = i;
+        }
+    }
+
+    for (DWORD i = dwDestinationSearchPath + 1; i < cSearchPaths; ++i)
+    {
+        if (!wzPreferredSourceRoot || !IsUnderSourceRoot(wzPreferredSourceRoot, rgSearchPaths[i]))
+        {
+            probe.rgdwOrder[probe.cOrder++] = i;
+        }
+    }
+
+    probe.rgnResults = static_cast<LONG*>(MemAlloc(sizeof(LONG) * cSearchPaths, TRUE));
+    ExitOnNull(probe.rgnResults, hr, E_OUTOFMEMORY, "Failed to allocate source probe results.");
+
+    probe.hProbeCompleted = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+    ExitOnNullWithLastError(probe.hProbeCompleted, hr, "Failed to create source probe event.");
+
+    // A few threads take the candidates in probe order so a slow share does not hold up the ones behind it.
+    for (DWORD i = 0; i < SOURCE_PROBE_THREAD_COUNT && i < probe.cOrder; ++i)
+    {
+        rghThreads[cThreads] = ::CreateThread(NULL, 0, ProbeLocalSourceThreadProc, &probe, 0, NULL);
+        if (!rghThreads[cThreads])
+        {
+            break;
+        }
+
+        ++cThreads;
+    }
+
+    if (!cThreads)
+    {
+        ProbeLocalSourceThreadProc(&probe);
+    }
+
+    // The first valid candidate in probe order wins as soon as every candidate ahead of it has missed.
+    while (!fDecided)
+    {
+        fDecided = TRUE;
+
+        for (DWORD i = 0; i < probe.cOrder; ++i)
+        {
+            LONG nResult = ::InterlockedCompareExchange(probe.rgnResults + probe.rgdwOrder[i], BURN_SOURCE_PROBE_RESULT_PENDING, BURN_SOURCE_PROBE_RESULT_PENDING);
+
+            if (BURN_SOURCE_PROBE_RESULT_VALID == nResult)
+            {
+                *pdwChosenSearchPath = probe.rgdwOrder[i];
+                *pfFound = TRUE;
+                break;
+            }
+            else if (BURN_SOURCE_PROBE_RESULT_PENDING == nResult)
+            {
+                fDecided = FALSE;
+                break;
+            }
+        }
+
+        if (!fDecided && WAIT_OBJECT_0 != ::WaitForSingleObject(probe.hProbeCompleted, INFINITE))
+        {
+            ExitWithLastError(hr, "Failed to wait for source probe.");
+        }
+    }
+
+LExit:
+    if (cThreads)
+    {
+        // Stop the probes that are no longer needed: no new candidates are started and
+        // blocking file system calls on slow shares are cancelled, then join the threads.
+        ::InterlockedExchange(&probe.fCancel, TRUE);
+
+        for (DWORD i = 0; i < cThreads; ++i)
+        {
+            ::CancelSynchronousIo(rghThreads[i]);
+        }
+
+        ::WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+
+        for (DWORD i = 0; i < cThreads; ++i)
+        {
+            ReleaseHandle(rghThreads[i]);
+        }
+    }
+
+    ReleaseHandle(probe.hProbeCompleted);
+    ReleaseMem(const_cast<LONG*>(probe.rgnResults));
+    ReleaseMem(probe.rgdwOrder);
+
+    return hr;
+}
+
+extern "C" HRESULT CacheGetSourceRoot(
+    __in_z LPCWSTR wzChosenPath,
+    __in_z LPCWSTR wzSourcePath,
+    __in_z LPCWSTR wzRelativePath,
+    __deref_inout_z_opt LPWSTR* psczSourceRoot
+    )
+{
+    HRESULT hr = S_FALSE;
+    LPCWSTR rgwzSuffixes[] = { wzSourcePath, wzRelativePath };
+    size_t cchPath = wcslen(wzChosenPath);
+
+    // Search paths are a source root joined with the source or relative path of the payload.
+    for (DWORD i = 0; i < countof(rgwzSuffixes); ++i)
+    {
+        size_t cchSuffix = wcslen(rgwzSuffixes[i]);
+        size_t cchRoot = cchPath - cchSuffix;
+
+        // The suffix must start a path segment, otherwise "C:\src2\a.msi" would yield the root "C:\src2".
+        if (cchSuffix && cchSuffix < cchPath && cchSuffix <= INT_MAX &&
+            (L'\\' == wzChosenPath[cchRoot - 1] || L'\\' == rgwzSuffixes[i][0]) &&
+            CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, wzChosenPath + cchRoot, static_cast<int>(cchSuffix), rgwzSuffixes[i], static_cast<int>(cchSuffix)))
+        {
+            hr = StrAllocString(psczSourceRoot, wzChosenPath, cchRoot);
+            ExitOnFailure(hr, "Failed to copy source root.");
+
+            break;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
 extern "C" HRESULT CacheSendProgressCallback(
     __in DOWNLOAD_CACHE_CALLBACK* pCallback,
     __in DWORD64 dw64Progress,
@@ -856,7 +1146,7 @@ extern "C" HRESULT CacheLayoutBundle(
 
     LogStringLine(REPORT_STANDARD, "Layout bundle from: '%ls' to: '%ls'", wzSourceBundlePath, sczTargetPath);
 
-    hr = CacheTransferFileWithRetry(wzSourceBundlePath, sczTargetPath, TRUE, BURN_CACHE_STEP_FINALIZE, qwBundleSize, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = CacheTransferFileWithRetry(wzSourceBundlePath, sczTargetPath, TRUE, FALSE, BURN_CACHE_STEP_FINALIZE, qwBundleSize, pfnCacheMessageHandler, pfnProgress, pContext);
     ExitOnFailure(hr, "Failed to layout bundle from: '%ls' to '%ls'", wzSourceBundlePath, sczTargetPath);
 
 LExit:
@@ -989,6 +1279,8 @@ extern "C" HRESULT CacheCompletePayload(
     HRESULT hr = S_OK;
     LPWSTR sczCachedPath = NULL;
     LPWSTR sczUnverifiedPayloadPath = NULL;
+    LPWSTR sczCompletedFolder = NULL;
+    LPWSTR sczContentPath = NULL;
 
     hr = CreateCompletedPath(fPerMachine, wzCacheId, pPayload->sczFilePath, &sczCachedPath);
     ExitOnFailure(hr, "Failed to get cached path for package with cache id: %ls", wzCacheId);
@@ -1000,13 +1292,33 @@ extern "C" HRESULT CacheCompletePayload(
         ExitFunction();
     }
 
+    if (IsContentStoreEnabled())
+    {
+        hr = CacheGetCompletedPath(fPerMachine, wzCacheId, &sczCompletedFolder);
+        ExitOnFailure(hr, "Failed to get completed folder for package with cache id: %ls", wzCacheId);
+
+        hr = GetContentStorePath(sczCompletedFolder, pPayload, &sczContentPath);
+        ExitOnFailure(hr, "Failed to get content store path for payload: %ls", pPayload->sczKey);
+
+        // Content in the store is verified in place and then linked, so it never needs to be staged.
+        if (sczContentPath)
+        {
+            hr = LinkPayloadFromContentStore(pPayload, sczContentPath, sczCachedPath, BURN_CACHE_STEP_HASH_TO_SKIP_VERIFY, pfnCacheMessageHandler, pfnProgress, pContext);
+            if (S_OK == hr)
+            {
+                ExitFunction();
+            }
+        }
+    }
+
     hr = CreateUnverifiedPath(fPerMachine, pPayload->sczKey, &sczUnverifiedPayloadPath);
     ExitOnFailure(hr, "Failed to create unverified path.");
 
     // If the working path exists, let's get it into the unverified path so we can reset the ACLs and verify the file.
     if (FileExistsEx(wzWorkingPayloadPath, NULL))
     {
-        hr = CacheTransferFileWithRetry(wzWorkingPayloadPath, sczUnverifiedPayloadPath, fMove, BURN_CACHE_STEP_STAGE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
+        // Never link here: the working path may be writable by the user and the data must not change after verification.
+        hr = CacheTransferFileWithRetry(wzWorkingPayloadPath, sczUnverifiedPayloadPath, fMove, FALSE, BURN_CACHE_STEP_STAGE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
         ExitOnFailure(hr, "Failed to transfer working path to unverified path for payload: %ls.", pPayload->sczKey);
     }
     else if (FileExistsEx(sczUnverifiedPayloadPath, NULL))
@@ -1034,12 +1346,24 @@ extern "C" HRESULT CacheCompletePayload(
 
     LogId(REPORT_STANDARD, MSG_VERIFIED_ACQUIRED_PAYLOAD, pPayload->sczKey, sczUnverifiedPayloadPath, fMove ? "moving" : "copying", sczCachedPath);
 
-    hr = CacheTransferFileWithRetry(sczUnverifiedPayloadPath, sczCachedPath, TRUE, BURN_CACHE_STEP_FINALIZE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = CacheTransferFileWithRetry(sczUnverifiedPayloadPath, sczCachedPath, TRUE, FALSE, BURN_CACHE_STEP_FINALIZE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
     ExitOnFailure(hr, "Failed to move verified file to complete payload path: %ls", sczCachedPath);
 
     ::DecryptFileW(sczCachedPath, 0);  // Let's try to make sure it's not encrypted.
 
+    if (sczContentPath)
+    {
+        hr = AddPayloadToContentStore(fPerMachine, sczContentPath, sczCachedPath);
+        if (FAILED(hr))
+        {
+            LogId(REPORT_WARNING, MSG_CACHE_CONTENT_STORE_ADD_FAILED, pPayload->sczKey, sczContentPath, hr);
+            hr = S_OK;
+        }
+    }
+
 LExit:
+    ReleaseStr(sczContentPath);
+    ReleaseStr(sczCompletedFolder);
     ReleaseStr(sczUnverifiedPayloadPath);
     ReleaseStr(sczCachedPath);
 
@@ -1071,6 +1395,7 @@ LExit:
 extern "C" HRESULT CacheVerifyPayload(
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzCachedDirectory,
+    __in BOOL fUseContentStore,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
     __in LPPROGRESS_ROUTINE pfnProgress,
     __in LPVOID pContext
@@ -1078,13 +1403,32 @@ extern "C" HRESULT CacheVerifyPayload(
 {
     HRESULT hr = S_OK;
     LPWSTR sczCachedPath = NULL;
+    LPWSTR sczContentPath = NULL;
 
     hr = PathConcat(wzCachedDirectory, pPayload->sczFilePath, &sczCachedPath);
     ExitOnFailure(hr, "Failed to concat complete cached path.");
 
+    // If the payload is not cached yet but another package already brought its content
+    // into the content store, link it into place so it does not need to be acquired.
+    if (fUseContentStore && IsContentStoreEnabled() && !FileExistsEx(sczCachedPath, NULL))
+    {
+        hr = GetContentStorePath(wzCachedDirectory, pPayload, &sczContentPath);
+        ExitOnFailure(hr, "Failed to get content store path for payload: %ls", pPayload->sczKey);
+
+        if (sczContentPath)
+        {
+            hr = LinkPayloadFromContentStore(pPayload, sczContentPath, sczCachedPath, BURN_CACHE_STEP_HASH_TO_SKIP_ACQUIRE, pfnCacheMessageHandler, pfnProgress, pContext);
+            if (S_OK == hr)
+            {
+                ExitFunction();
+            }
+        }
+    }
+
     hr = VerifyFileAgainstPayload(pPayload, sczCachedPath, TRUE, BURN_CACHE_STEP_HASH_TO_SKIP_ACQUIRE, pfnCacheMessageHandler, pfnProgress, pContext);
 
 LExit:
+    ReleaseStr(sczContentPath);
     ReleaseStr(sczCachedPath);
 
     return hr;
@@ -1267,6 +1611,8 @@ extern "C" void CacheUninitialize()
     ReleaseNullStr(vsczWorkingFolder);
     ReleaseNullStr(vsczSourceProcessFolder);
 
+    ::InitOnceInitialize(&vInitOnceContentStore);
+    vfContentStoreEnabled = FALSE;
     vfRunningFromCache = FALSE;
     vfInitializedCache = FALSE;
 }
@@ -1475,6 +1821,46 @@ LExit:
     return hr;
 }
 
+static DWORD WINAPI ProbeLocalSourceThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    BURN_SOURCE_PROBE* pProbe = reinterpret_cast<BURN_SOURCE_PROBE*>(lpThreadParameter);
+    LONG iOrder = 0;
+    DWORD iPath = 0;
+    BOOL fValid = FALSE;
+
+    while (!pProbe->fCancel)
+    {
+        iOrder = ::InterlockedIncrement(&pProbe->iNextOrder) - 1;
+        if (static_cast<DWORD>(iOrder) >= pProbe->cOrder)
+        {
+            break;
+        }
+
+        iPath = pProbe->rgdwOrder[iOrder];
+        fValid = CacheIsValidLocalSource(pProbe->rgSearchPaths[iPath], pProbe->qwFileSize, pProbe->fMinimumFileSize);
+
+        ::InterlockedExchange(pProbe->rgnResults + iPath, fValid ? BURN_SOURCE_PROBE_RESULT_VALID : BURN_SOURCE_PROBE_RESULT_INVALID);
+        ::SetEvent(pProbe->hProbeCompleted);
+    }
+
+    return 0;
+}
+
+static BOOL IsUnderSourceRoot(
+    __in_z LPCWSTR wzSourceRoot,
+    __in_z LPCWSTR wzPath
+    )
+{
+    size_t cchRoot = wcslen(wzSourceRoot);
+
+    // The root must end at a path separator so "C:\src" does not match "C:\src2\a.msi".
+    return cchRoot && cchRoot <= wcslen(wzPath) && cchRoot <= INT_MAX &&
+           (L'\\' == wzSourceRoot[cchRoot - 1] || L'\\' == wzPath[cchRoot]) &&
+           CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, wzPath, static_cast<int>(cchRoot), wzSourceRoot, static_cast<int>(cchRoot));
+}
+
 static HRESULT CreateCompletedPath(
     __in BOOL fPerMachine,
     __in LPCWSTR wzId,
@@ -1592,7 +1978,7 @@ static HRESULT VerifyThenTransferContainer(
 
     LogStringLine(REPORT_STANDARD, "%ls container from working path '%ls' to path '%ls'", fMove ? L"Moving" : L"Copying", wzUnverifiedContainerPath, wzCachedPath);
 
-    hr = CacheTransferFileWithRetry(wzUnverifiedContainerPath, wzCachedPath, fMove, BURN_CACHE_STEP_FINALIZE, pContainer->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = CacheTransferFileWithRetry(wzUnverifiedContainerPath, wzCachedPath, fMove, FALSE, BURN_CACHE_STEP_FINALIZE, pContainer->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
 
 LExit:
     ReleaseFileHandle(hFile);
@@ -1638,7 +2024,7 @@ static HRESULT VerifyThenTransferPayload(
 
     LogStringLine(REPORT_STANDARD, "%ls payload from working path '%ls' to path '%ls'", fMove ? L"Moving" : L"Copying", wzUnverifiedPayloadPath, wzCachedPath);
 
-    hr = CacheTransferFileWithRetry(wzUnverifiedPayloadPath, wzCachedPath, fMove, BURN_CACHE_STEP_FINALIZE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = CacheTransferFileWithRetry(wzUnverifiedPayloadPath, wzCachedPath, fMove, TRUE, BURN_CACHE_STEP_FINALIZE, pPayload->qwFileSize, pfnCacheMessageHandler, pfnProgress, pContext);
 
 LExit:
     ReleaseFileHandle(hFile);
@@ -1650,38 +2036,130 @@ static HRESULT CacheTransferFileWithRetry(
     __in_z LPCWSTR wzSourcePath,
     __in_z LPCWSTR wzDestinationPath,
     __in BOOL fMove,
+    __in BOOL fAllowHardLink,
     __in BURN_CACHE_STEP cacheStep,
     __in DWORD64 qwFileSize,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
-    __in LPPROGRESS_ROUTINE /*pfnProgress*/,
+    __in LPPROGRESS_ROUTINE pfnProgress,
     __in LPVOID pContext
     )
 {
     HRESULT hr = S_OK;
+    LPWSTR sczDestinationDirectory = NULL;
+    BURN_CACHE_TRANSFER transfer = BURN_CACHE_TRANSFER_COPY;
 
     hr = SendCacheBeginMessage(pfnCacheMessageHandler, pContext, cacheStep);
     ExitOnFailure(hr, "Aborted cache file transfer begin.");
 
-    // TODO: send progress during the file transfer.
     if (fMove)
     {
-        hr = FileEnsureMoveWithRetry(wzSourcePath, wzDestinationPath, TRUE, TRUE, FILE_OPERATION_RETRY_COUNT, FILE_OPERATION_RETRY_WAIT);
+        // The progress routine is only called when the move falls back to a copy across volumes.
+        hr = FileEnsureMoveWithRetryAndProgress(wzSourcePath, wzDestinationPath, TRUE, TRUE, FILE_OPERATION_RETRY_COUNT, FILE_OPERATION_RETRY_WAIT, pfnProgress, pContext);
         ExitOnFailure(hr, "Failed to move %ls to %ls", wzSourcePath, wzDestinationPath);
+
+        transfer = BURN_CACHE_TRANSFER_MOVE;
     }
     else
     {
-        hr = FileEnsureCopyWithRetry(wzSourcePath, wzDestinationPath, TRUE, FILE_OPERATION_RETRY_COUNT, FILE_OPERATION_RETRY_WAIT);
-        ExitOnFailure(hr, "Failed to copy %ls to %ls", wzSourcePath, wzDestinationPath);
+        hr = PathGetDirectory(wzDestinationPath, &sczDestinationDirectory);
+        ExitOnFailure(hr, "Failed to get directory of %ls", wzDestinationPath);
+
+        hr = DirEnsureExists(sczDestinationDirectory, NULL);
+        ExitOnFailure(hr, "Failed to create directory %ls", sczDestinationDirectory);
+
+        // Prefer sharing the data already on the volume over duplicating it.
+        if (fAllowHardLink && LinkVerifiedFile(wzSourcePath, wzDestinationPath))
+        {
+            transfer = BURN_CACHE_TRANSFER_HARD_LINK;
+        }
+
+        if (BURN_CACHE_TRANSFER_COPY == transfer && SUCCEEDED(FileEnsureClone(wzSourcePath, wzDestinationPath)))
+        {
+            transfer = BURN_CACHE_TRANSFER_BLOCK_CLONE;
+        }
+
+        if (BURN_CACHE_TRANSFER_COPY == transfer)
+        {
+            hr = FileEnsureCopyWithRetryAndProgress(wzSourcePath, wzDestinationPath, TRUE, FILE_OPERATION_RETRY_COUNT, FILE_OPERATION_RETRY_WAIT, pfnProgress, pContext);
+            ExitOnFailure(hr, "Failed to copy %ls to %ls", wzSourcePath, wzDestinationPath);
+        }
     }
 
+    LogId(REPORT_STANDARD, MSG_CACHE_TRANSFER, LoggingCacheTransferToString(transfer), wzSourcePath, wzDestinationPath);
+
     hr = SendCacheSuccessMessage(pfnCacheMessageHandler, pContext, qwFileSize);
 
 LExit:
     SendCacheCompleteMessage(pfnCacheMessageHandler, pContext, hr);
 
+    ReleaseStr(sczDestinationDirectory);
+
     return hr;
 }
 
+static BOOL LinkVerifiedFile(
+    __in_z LPCWSTR wzSourcePath,
+    __in_z LPCWSTR wzDestinationPath
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fLinked = FALSE;
+    DWORD dwSourceAttributes = 0;
+    LPWSTR sczLinkPath = NULL;
+
+    // Both names share the data, so only link a source that is read-only and cannot change
+    // the destination after it has been verified.
+    if (!FileExistsEx(wzSourcePath, &dwSourceAttributes) || !(FILE_ATTRIBUTE_READONLY & dwSourceAttributes))
+    {
+        ExitFunction();
+    }
+
+    hr = StrAllocFormatted(&sczLinkPath, L"%ls.%u.link", wzDestinationPath, ::GetCurrentProcessId());
+    ExitOnFailure(hr, "Failed to allocate link path for: %ls", wzDestinationPath);
+
+    // Link under a temporary name so a failed link leaves any existing destination in place.
+    if (!::CreateHardLinkW(sczLinkPath, wzSourcePath, NULL))
+    {
+        ExitFunction();
+    }
+
+    if (::MoveFileExW(sczLinkPath, wzDestinationPath, MOVEFILE_REPLACE_EXISTING))
+    {
+        fLinked = TRUE;
+    }
+    else
+    {
+        // The link shares the source's attributes, so put read-only back after removing it.
+        ::SetFileAttributesW(sczLinkPath, dwSourceAttributes & ~FILE_ATTRIBUTE_READONLY);
+        ::DeleteFileW(sczLinkPath);
+        ::SetFileAttributesW(wzSourcePath, dwSourceAttributes);
+    }
+
+LExit:
+    ReleaseStr(sczLinkPath);
+
+    return fLinked;
+}
+
+static LPCSTR LoggingCacheTransferToString(
+    __in BURN_CACHE_TRANSFER transfer
+    )
+{
+    switch (transfer)
+    {
+    case BURN_CACHE_TRANSFER_MOVE:
+        return "move";
+    case BURN_CACHE_TRANSFER_HARD_LINK:
+        return "hard link";
+    case BURN_CACHE_TRANSFER_BLOCK_CLONE:
+        return "block clone";
+    case BURN_CACHE_TRANSFER_COPY:
+        return "copy";
+    default:
+        return "Invalid";
+    }
+}
+
 static HRESULT VerifyFileAgainstContainer(
     __in BURN_CONTAINER* pContainer,
     __in_z LPCWSTR wzVerifyPath,
@@ -2078,12 +2556,25 @@ static HRESULT RemoveBundleOrPackage(
     HRESULT hr = S_OK;
     LPWSTR sczRootCacheDirectory = NULL;
     LPWSTR sczDirectory = NULL;
+    LPWSTR sczContentFolder = NULL;
+    LPWSTR* rgsczContent = NULL;
+    UINT cContent = 0;
 
     hr = CacheGetCompletedPath(fPerMachine, wzCacheId, &sczDirectory);
     ExitOnFailure(hr, "Failed to calculate cache path.");
 
     LogId(REPORT_STANDARD, fBundle ? MSG_UNCACHE_BUNDLE : MSG_UNCACHE_PACKAGE, wzBundleOrPackageId, sczDirectory);
 
+    // Remember the content this folder shares with the content store so only that content has to be checked once the folder is gone.
+    hr = GetContentStoreFolder(sczDirectory, &sczContentFolder);
+    ExitOnFailure(hr, "Failed to get content store folder.");
+
+    if (DirExists(sczContentFolder, NULL))
+    {
+        hr = FindReferencedContent(sczDirectory, sczContentFolder, &rgsczContent, &cContent);
+        TraceError(hr, "Failed to find content referenced by: %ls", sczDirectory);
+    }
+
     // Try really hard to remove the cache directory.
     hr = E_FAIL;
     for (DWORD iRetry = 0; FAILED(hr) && iRetry < FILE_OPERATION_RETRY_COUNT; ++iRetry)
@@ -2107,6 +2598,9 @@ static HRESULT RemoveBundleOrPackage(
     }
     else
     {
+        // Removing the package's links may have left content that no other package references.
+        RemoveUnreferencedContent(sczDirectory, sczContentFolder, rgsczContent, cContent);
+
         // Try to remove root package cache in the off chance it is now empty.
         hr = GetRootPath(fPerMachine, TRUE, &sczRootCacheDirectory);
         ExitOnFailure(hr, "Failed to get %hs package cache root directory.", fPerMachine ? "per-machine" : "per-user");
@@ -2122,12 +2616,407 @@ static HRESULT RemoveBundleOrPackage(
     }
 
 LExit:
+    ReleaseStrArray(rgsczContent, cContent);
+    ReleaseStr(sczContentFolder);
     ReleaseStr(sczDirectory);
     ReleaseStr(sczRootCacheDirectory);
 
     return hr;
 }
 
+static BOOL IsContentStoreEnabled()
+{
+    // The policy is read once per process. Payloads are cached on more than one thread so the read must be synchronized.
+    ::InitOnceExecuteOnce(&vInitOnceContentStore, ReadContentStorePolicy, NULL, NULL);
+
+    return vfContentStoreEnabled;
+}
+
+static BOOL CALLBACK ReadContentStorePolicy(
+    __inout PINIT_ONCE /*pInitOnce*/,
+    __inout_opt PVOID /*pvParameter*/,
+    __out_opt PVOID* /*ppvContext*/
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwContentStore = 0;
+
+    hr = PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"ContentStore", 0, &dwContentStore);
+    TraceError(hr, "Failed to read ContentStore policy.");
+
+    vfContentStoreEnabled = 0 != dwContentStore;
+
+    return TRUE;
+}
+
+static HRESULT GetContentStoreFolder(
+    __in_z LPCWSTR wzCompletedFolder,
+    __deref_out_z LPWSTR* psczContentFolder
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczRootPath = NULL;
+
+    // The content store is a sibling of the package's completed folder so links never cross volumes.
+    hr = PathGetParentPath(wzCompletedFolder, &sczRootPath);
+    ExitOnFailure(hr, "Failed to get package cache root from completed folder: %ls", wzCompletedFolder);
+
+    hr = PathConcat(sczRootPath, CONTENT_STORE_FOLDER_NAME, psczContentFolder);
+    ExitOnFailure(hr, "Failed to construct content store folder.");
+
+LExit:
+    ReleaseStr(sczRootPath);
+
+    return hr;
+}
+
+static HRESULT GetContentStorePath(
+    __in_z LPCWSTR wzCompletedFolder,
+    __in BURN_PAYLOAD* pPayload,
+    __deref_out_z_opt LPWSTR* psczContentPath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczContentFolder = NULL;
+    LPWSTR sczHash = NULL;
+
+    ReleaseNullStr(*psczContentPath);
+
+    // Only payloads identified by their full SHA-512 hash can be shared.
+    if (BURN_PAYLOAD_VERIFICATION_HASH != pPayload->verification || SHA512_HASH_LEN != pPayload->cbHash)
+    {
+        ExitFunction();
+    }
+
+    hr = GetContentStoreFolder(wzCompletedFolder, &sczContentFolder);
+    ExitOnFailure(hr, "Failed to get content store folder.");
+
+    hr = StrAllocHexEncode(pPayload->pbHash, pPayload->cbHash, &sczHash);
+    ExitOnFailure(hr, "Failed to encode payload hash.");
+
+    hr = PathConcat(sczContentFolder, sczHash, psczContentPath);
+    ExitOnFailure(hr, "Failed to construct content store path.");
+
+LExit:
+    ReleaseStr(sczHash);
+    ReleaseStr(sczContentFolder);
+
+    return hr;
+}
+
+static HRESULT LinkPayloadFromContentStore(
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzContentPath,
+    __in_z LPCWSTR wzCachedPath,
+    __in BURN_CACHE_STEP cacheStep,
+    __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
+    __in LPPROGRESS_ROUTINE pfnProgress,
+    __in LPVOID pContext
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    LPWSTR sczCachedFolder = NULL;
+
+    // Keep the content open without write sharing so it cannot change between verifying and linking it.
+    hFile = ::CreateFileW(wzContentPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+        if (E_FILENOTFOUND == hr || E_PATHNOTFOUND == hr)
+        {
+            ExitFunction1(hr = S_FALSE);
+        }
+        ExitOnRootFailure(hr, "Failed to open content: %ls", wzContentPath);
+    }
+
+    hr = VerifyHash(pPayload->pbHash, pPayload->cbHash, pPayload->qwFileSize, TRUE, wzContentPath, hFile, cacheStep, pfnCacheMessageHandler, pfnProgress, pContext);
+    if (CRYPT_E_HASH_VALUE == hr || ERROR_FILE_CORRUPT == hr)
+    {
+        // The content was damaged after it was added, so stop sharing it and acquire the payload normally.
+        ReleaseFileHandle(hFile);
+        FileEnsureDelete(wzContentPath);
+
+        ExitFunction1(hr = S_FALSE);
+    }
+    ExitOnFailure(hr, "Failed to verify content: %ls for payload: %ls", wzContentPath, pPayload->sczKey);
+
+    hr = PathGetDirectory(wzCachedPath, &sczCachedFolder);
+    ExitOnFailure(hr, "Failed to get directory for cached path: %ls", wzCachedPath);
+
+    hr = DirEnsureExists(sczCachedFolder, NULL);
+    ExitOnFailure(hr, "Failed to create cache directory: %ls", sczCachedFolder);
+
+    if (!::CreateHardLinkW(wzCachedPath, wzContentPath, NULL))
+    {
+        ExitWithLastError(hr, "Failed to link content: %ls to cached path: %ls", wzContentPath, wzCachedPath);
+    }
+
+    LogId(REPORT_STANDARD, MSG_CACHE_CONTENT_STORE_LINKED, pPayload->sczKey, wzContentPath, wzCachedPath);
+
+LExit:
+    ReleaseFileHandle(hFile);
+    ReleaseStr(sczCachedFolder);
+
+    return hr;
+}
+
+static HRESULT AddPayloadToContentStore(
+    __in BOOL fPerMachine,
+    __in_z LPCWSTR wzContentPath,
+    __in_z LPCWSTR wzCachedPath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczContentFolder = NULL;
+
+    if (FileExistsEx(wzContentPath, NULL))
+    {
+        ExitFunction();
+    }
+
+    hr = PathGetDirectory(wzContentPath, &sczContentFolder);
+    ExitOnFailure(hr, "Failed to get content store folder.");
+
+    hr = DirEnsureExists(sczContentFolder, NULL);
+    ExitOnFailure(hr, "Failed to create content store folder: %ls", sczContentFolder);
+
+    // Make sure the store inherits the package cache permissions like every other cache folder.
+    ResetPathPermissions(fPerMachine, sczContentFolder);
+
+    if (!::CreateHardLinkW(wzContentPath, wzCachedPath, NULL))
+    {
+        ExitWithLastError(hr, "Failed to add cached path: %ls to content store.", wzCachedPath);
+    }
+
+LExit:
+    ReleaseStr(sczContentFolder);
+
+    return hr;
+}
+
+static HRESULT GetFileLinks(
+    __in_z LPCWSTR wzPath,
+    __deref_inout_ecount_opt(*pcLinks) LPWSTR** prgsczLinks,
+    __inout LPUINT pcLinks
+    )
+{
+    HRESULT hr = S_OK;
+    WCHAR wzVolume[MAX_PATH] = { };
+    LPWSTR sczName = NULL;
+    DWORD cchName = MAX_PATH;
+    SIZE_T cchMax = 0;
+    LPWSTR sczLink = NULL;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    BOOL fFound = FALSE;
+
+    if (!::GetVolumePathNameW(wzPath, wzVolume, countof(wzVolume)))
+    {
+        ExitWithLastError(hr, "Failed to get volume for path: %ls", wzPath);
+    }
+
+    hr = StrAlloc(&sczName, cchName);
+    ExitOnFailure(hr, "Failed to allocate link name.");
+
+    // Link names are returned relative to the root of the volume, e.g. "\Package Cache\.content\<hash>".
+    hFind = ::FindFirstFileNameW(wzPath, 0, &cchName, sczName);
+    if (INVALID_HANDLE_VALUE == hFind && ERROR_MORE_DATA == ::GetLastError())
+    {
+        hr = StrAlloc(&sczName, cchName);
+        ExitOnFailure(hr, "Failed to grow link name.");
+
+        hFind = ::FindFirstFileNameW(wzPath, 0, &cchName, sczName);
+    }
+
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        ExitWithLastError(hr, "Failed to find links for path: %ls", wzPath);
+    }
+
+    do
+    {
+        hr = PathConcat(wzVolume, L'\\' == sczName[0] ? sczName + 1 : sczName, &sczLink);
+        ExitOnFailure(hr, "Failed to construct link path.");
+
+        hr = StrArrayAllocString(prgsczLinks, pcLinks, sczLink, 0);
+        ExitOnFailure(hr, "Failed to add link path: %ls", sczLink);
+
+        hr = StrMaxLength(sczName, &cchMax);
+        ExitOnFailure(hr, "Failed to get link name buffer size.");
+
+        cchName = static_cast<DWORD>(cchMax);
+
+        fFound = ::FindNextFileNameW(hFind, &cchName, sczName);
+        if (!fFound && ERROR_MORE_DATA == ::GetLastError())
+        {
+            hr = StrAlloc(&sczName, cchName);
+            ExitOnFailure(hr, "Failed to grow link name.");
+
+            fFound = ::FindNextFileNameW(hFind, &cchName, sczName);
+        }
+    } while (fFound);
+
+    if (ERROR_HANDLE_EOF != ::GetLastError())
+    {
+        ExitWithLastError(hr, "Failed to find next link for path: %ls", wzPath);
+    }
+
+LExit:
+    if (INVALID_HANDLE_VALUE != hFind)
+    {
+        ::FindClose(hFind);
+    }
+
+    ReleaseStr(sczLink);
+    ReleaseStr(sczName);
+
+    return hr;
+}
+
+static HRESULT FindReferencedContent(
+    __in_z LPCWSTR wzDirectory,
+    __in_z LPCWSTR wzContentFolder,
+    __deref_inout_ecount_opt(*pcContent) LPWSTR** prgsczContent,
+    __inout LPUINT pcContent
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczFiles = NULL;
+    LPWSTR sczPath = NULL;
+    LPWSTR* rgsczLinks = NULL;
+    UINT cLinks = 0;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+
+    hr = PathConcat(wzDirectory, L"*", &sczFiles);
+    ExitOnFailure(hr, "Failed to construct search path for: %ls", wzDirectory);
+
+    hFind = ::FindFirstFileW(sczFiles, &wfd);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        ExitFunction();
+    }
+
+    do
+    {
+        if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+        {
+            continue;
+        }
+
+        hr = PathConcat(wzDirectory, wfd.cFileName, &sczPath);
+        ExitOnFailure(hr, "Failed to construct path for: %ls", wfd.cFileName);
+
+        if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            hr = FindReferencedContent(sczPath, wzContentFolder, prgsczContent, pcContent);
+            ExitOnFailure(hr, "Failed to find referenced content in: %ls", sczPath);
+
+            continue;
+        }
+
+        ReleaseNullStrArray(rgsczLinks, cLinks);
+
+        // A file with a single name cannot be shared with the content store.
+        hr = GetFileLinks(sczPath, &rgsczLinks, &cLinks);
+        if (FAILED(hr) || 2 > cLinks)
+        {
+            hr = S_OK;
+            continue;
+        }
+
+        for (UINT i = 0; i < cLinks; ++i)
+        {
+            if (S_OK == PathDirectoryContainsPath(wzContentFolder, rgsczLinks[i]))
+            {
+                hr = StrArrayAllocString(prgsczContent, pcContent, rgsczLinks[i], 0);
+                ExitOnFailure(hr, "Failed to remember referenced content: %ls", rgsczLinks[i]);
+            }
+        }
+    } while (::FindNextFileW(hFind, &wfd));
+
+LExit:
+    if (INVALID_HANDLE_VALUE != hFind)
+    {
+        ::FindClose(hFind);
+    }
+
+    ReleaseStrArray(rgsczLinks, cLinks);
+    ReleaseStr(sczPath);
+    ReleaseStr(sczFiles);
+
+    return hr;
+}
+
+static void RemoveUnreferencedContent(
+    __in_z LPCWSTR wzRemovedFolder,
+    __in_z LPCWSTR wzContentFolder,
+    __in_ecount(cContent) LPWSTR* rgsczContent,
+    __in UINT cContent
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR* rgsczLinks = NULL;
+    UINT cLinks = 0;
+    BOOL fReferenced = FALSE;
+
+    for (UINT i = 0; i < cContent; ++i)
+    {
+        LPCWSTR wzContentPath = rgsczContent[i];
+
+        ReleaseNullStrArray(rgsczLinks, cLinks);
+
+        hr = GetFileLinks(wzContentPath, &rgsczLinks, &cLinks);
+        if (FAILED(hr))
+        {
+            // Content that is already gone was referenced by more than one file in the removed folder.
+            continue;
+        }
+
+        // Every package that uses the content holds a hard link to it, so the store's own
+        // link is the last reference once the link count drops to one.
+        if (1 >= cLinks)
+        {
+            hr = FileEnsureDelete(wzContentPath);
+            if (SUCCEEDED(hr))
+            {
+                LogId(REPORT_STANDARD, MSG_CACHE_CONTENT_STORE_REMOVED, wzContentPath);
+            }
+
+            continue;
+        }
+
+        // Files in the removed folder that were in use are only deleted on reboot. If those are the
+        // only other links left, delete the content on reboot too. Removing the store's name never
+        // affects the links that still exist.
+        fReferenced = FALSE;
+        for (UINT j = 0; !fReferenced && j < cLinks; ++j)
+        {
+            fReferenced = S_OK != PathDirectoryContainsPath(wzContentFolder, rgsczLinks[j]) && S_OK != PathDirectoryContainsPath(wzRemovedFolder, rgsczLinks[j]);
+        }
+
+        if (!fReferenced)
+        {
+            if (::MoveFileExW(wzContentPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT))
+            {
+                LogId(REPORT_STANDARD, MSG_CACHE_CONTENT_STORE_REMOVE_SCHEDULED, wzContentPath);
+            }
+            else
+            {
+                TraceError(HRESULT_FROM_WIN32(::GetLastError()), "Failed to schedule removal of content: %ls", wzContentPath);
+            }
+        }
+    }
+
+    // Try to remove the content store in the off chance it is now empty.
+    if (cContent)
+    {
+        DirEnsureDeleteEx(wzContentFolder, DIR_DELETE_SCHEDULE);
+    }
+
+    ReleaseStrArray(rgsczLinks, cLinks);
+}
+
 static HRESULT VerifyFileSize(
     __in HANDLE hFile,
     __in DWORD64 qwFileSize,
@@ -109,6 +109,27 @@ HRESULT CacheSetLastUsedSource(
     __in_z LPCWSTR wzSourcePath,
     __in_z LPCWSTR wzRelativePath
     );
+BOOL CacheIsValidLocalSource(
+    __in_z LPCWSTR wzFilePath,
+    __in DWORD64 qwFileSize,
+    __in BOOL fMinimumFileSize
+    );
+HRESULT CacheProbeLocalSourcePaths(
+    __in_ecount(cSearchPaths) LPWSTR* rgSearchPaths,
+    __in DWORD cSearchPaths,
+    __in DWORD dwDestinationSearchPath,
+    __in_z_opt LPCWSTR wzPreferredSourceRoot,
+    __in DWORD64 qwFileSize,
+    __in BOOL fMinimumFileSize,
+    __out DWORD* pdwChosenSearchPath,
+    __out BOOL* pfFound
+    );
+HRESULT CacheGetSourceRoot(
+    __in_z LPCWSTR wzChosenPath,
+    __in_z LPCWSTR wzSourcePath,
+    __in_z LPCWSTR wzRelativePath,
+    __deref_inout_z_opt LPWSTR* psczSourceRoot
+    );
 HRESULT CacheSendProgressCallback(
     __in DOWNLOAD_CACHE_CALLBACK* pCallback,
     __in DWORD64 dw64Progress,
@@ -191,6 +212,7 @@ HRESULT CacheVerifyContainer(
 HRESULT CacheVerifyPayload(
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzCachedDirectory,
+    __in BOOL fUseContentStore,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
     __in LPPROGRESS_ROUTINE pfnProgress,
     __in LPVOID pContext
@@ -11,6 +11,14 @@ struct BURN_CACHE_THREAD_CONTEXT
     BURN_APPLY_CONTEXT* pApplyContext;
 };
 
+struct BURN_DETECT_GATHER_CONTEXT
+{
+    BURN_PACKAGES* pPackages;
+    LONG iNextPackage;
+};
+
+const DWORD BURN_DETECT_GATHER_MAX_THREADS = 8;
+
 
 // internal function declarations
 
@@ -34,6 +42,12 @@ static HRESULT DetectPackage(
 static HRESULT DetectPackagePayloadsCached(
     __in BURN_PACKAGE* pPackage
     );
+static void DetectGatherPackages(
+    __in BURN_PACKAGES* pPackages
+    );
+static DWORD WINAPI DetectGatherThreadProc(
+    __in LPVOID lpThreadParameter
+    );
 static DWORD WINAPI CacheThreadProc(
     __in LPVOID lpThreadParameter
     );
@@ -271,6 +285,18 @@ extern "C" HRESULT CoreDetect(
     BOOL fDetectBegan = FALSE;
     BURN_PACKAGE* pPackage = NULL;
     HRESULT hrFirstPackageFailure = S_OK;
+    DWORD cInstallerQueries = 0;
+    LONGLONG llProfile = 0;
+    BURN_PROFILER_SPAN span = { };
+
+    // The bootstrapper application can turn on the profiler through the bundle variable instead of the command-line switch.
+    if (!ProfilerIsEnabled() && SUCCEEDED(VariableGetNumeric(&pEngineState->variables, BURN_BUNDLE_PROFILE, &llProfile)) && llProfile)
+    {
+        hr = ProfilerStart();
+        ExitOnFailure(hr, "Failed to start profiler.");
+    }
+
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_DETECT, L"Detect", NULL);
 
     LogId(REPORT_STANDARD, MSG_DETECT_BEGIN, pEngineState->packages.cPackages);
 
@@ -328,9 +354,11 @@ extern "C" HRESULT CoreDetect(
     ExitOnFailure(hr, "Failed to report detected related bundles.");
 
     // Do update detection.
-    hr = DetectUpdate(pEngineState->registration.sczId, &pEngineState->userExperience, &pEngineState->update);
+    hr = DetectUpdate(pEngineState->registration.sczId, pEngineState->registration.pVersion, &pEngineState->userExperience, &pEngineState->update);
     ExitOnFailure(hr, "Failed to detect update.");
 
+    cInstallerQueries = WiuGetQueryCount();
+
     // Detecting MSPs requires special initialization before processing each package but
     // only do the detection if there are actually patch packages to detect because it
     // can be expensive.
@@ -338,11 +366,15 @@ extern "C" HRESULT CoreDetect(
     {
         hr = MspEngineDetectInitialize(&pEngineState->packages);
         ExitOnFailure(hr, "Failed to initialize MSP engine detection.");
-
-        hr = MsiEngineDetectInitialize(&pEngineState->packages);
-        ExitOnFailure(hr, "Failed to initialize MSI engine detection.");
     }
 
+    hr = MsiEngineDetectInitialize(&pEngineState->packages);
+    ExitOnFailure(hr, "Failed to initialize MSI engine detection.");
+
+    // Warm the Windows Installer detect cache in parallel, then detect and report each
+    // package serially in authored order so the BA sees the same callbacks as before.
+    DetectGatherPackages(&pEngineState->packages);
+
     for (DWORD i = 0; i < pEngineState->packages.cPackages; ++i)
     {
         pPackage = pEngineState->packages.rgPackages + i;
@@ -363,6 +395,10 @@ extern "C" HRESULT CoreDetect(
         }
     }
 
+    MsiEngineDetectUninitialize(&pEngineState->packages);
+
+    LogId(REPORT_VERBOSE, MSG_DETECT_MSI_QUERIES, WiuGetQueryCount() - cInstallerQueries);
+
     hr = DependencyDetect(pEngineState);
     ExitOnFailure(hr, "Failed to detect the dependencies.");
 
@@ -417,6 +453,8 @@ LExit:
 
     pEngineState->userExperience.hwndDetect = NULL;
 
+    ProfilerEndSpan(&span);
+
     LogId(REPORT_STANDARD, MSG_DETECT_COMPLETE, hr, !fDetectBegan ? "(failed)" : LoggingBoolToString(pEngineState->registration.fInstalled), !fDetectBegan ? "(failed)" : LoggingBoolToString(pEngineState->registration.fCached), FAILED(hr) ? "(failed)" : LoggingBoolToString(pEngineState->registration.fEligibleForCleanup));
 
     return hr;
@@ -432,6 +470,9 @@ extern "C" HRESULT CorePlan(
     BURN_PACKAGE* pUpgradeBundlePackage = NULL;
     BURN_PACKAGE* pForwardCompatibleBundlePackage = NULL;
     BOOL fContinuePlanning = TRUE; // assume we won't skip planning due to dependencies.
+    BURN_PROFILER_SPAN span = { };
+
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_PLAN, L"Plan", NULL);
 
     LogId(REPORT_STANDARD, MSG_PLAN_BEGIN, pEngineState->packages.cPackages, LoggingBurnActionToString(action));
 
@@ -553,6 +594,8 @@ LExit:
         UserExperienceOnPlanComplete(&pEngineState->userExperience, hr);
     }
 
+    ProfilerEndSpan(&span);
+
     LogId(REPORT_STANDARD, MSG_PLAN_COMPLETE, hr);
 
     return hr;
@@ -609,6 +652,9 @@ extern "C" HRESULT CoreApply(
     BOOL fRollbackCache = FALSE;
     DWORD dwPhaseCount = 0;
     BOOTSTRAPPER_APPLYCOMPLETE_ACTION applyCompleteAction = BOOTSTRAPPER_APPLYCOMPLETE_ACTION_NONE;
+    BURN_PROFILER_SPAN span = { };
+
+    ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"Apply", NULL);
 
     LogId(REPORT_STANDARD, MSG_APPLY_BEGIN);
 
@@ -795,6 +841,8 @@ LExit:
         pEngineState->fRestart = TRUE;
     }
 
+    ProfilerEndSpan(&span);
+
     LogId(REPORT_STANDARD, MSG_APPLY_COMPLETE, hr, LoggingRestartToString(restart), LoggingBoolToString(pEngineState->fRestart));
 
     return hr;
@@ -1470,6 +1518,10 @@ extern "C" HRESULT CoreParseCommandLine(
             {
                 *pfDisableUnelevate = TRUE;
             }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, &argv[i][1], -1, BURN_COMMANDLINE_SWITCH_PROFILE, -1))
+            {
+                *pdwLoggingAttributes |= BURN_LOGGING_ATTRIBUTE_PROFILE;
+            }
             else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, &argv[i][1], -1, BURN_COMMANDLINE_SWITCH_RUNONCE, -1))
             {
                 if (BURN_MODE_UNTRUSTED != *pMode)
@@ -1746,7 +1798,7 @@ static HRESULT DetectPackage(
         break;
 
     case BURN_PACKAGE_TYPE_MSI:
-        hr = MsiEngineDetectPackage(pPackage, &pEngineState->userExperience);
+        hr = MsiEngineDetectPackage(pPackage, &pEngineState->packages.msiDetectCache, &pEngineState->userExperience);
         break;
 
     case BURN_PACKAGE_TYPE_MSP:
@@ -1827,6 +1879,84 @@ LExit:
     return hr;
 }
 
+static void DetectGatherPackages(
+    __in BURN_PACKAGES* pPackages
+    )
+{
+    BURN_DETECT_GATHER_CONTEXT context = { };
+    SYSTEM_INFO systemInfo = { };
+    HANDLE rghThreads[BURN_DETECT_GATHER_MAX_THREADS] = { };
+    DWORD cThreads = 0;
+    DWORD cMsiPackages = 0;
+    DWORD cMaxThreads = 0;
+
+    for (DWORD i = 0; i < pPackages->cPackages; ++i)
+    {
+        if (BURN_PACKAGE_TYPE_MSI == pPackages->rgPackages[i].type)
+        {
+            ++cMsiPackages;
+        }
+    }
+
+    // A single MSI package gains nothing from a worker.
+    if (2 > cMsiPackages)
+    {
+        ExitFunction();
+    }
+
+    ::GetSystemInfo(&systemInfo);
+
+    cMaxThreads = min(min(systemInfo.dwNumberOfProcessors, cMsiPackages), BURN_DETECT_GATHER_MAX_THREADS);
+
+    context.pPackages = pPackages;
+
+    for (DWORD i = 0; i < cMaxThreads; ++i)
+    {
+        HANDLE hThread = ::CreateThread(NULL, 0, DetectGatherThreadProc, &context, 0, NULL);
+        if (!hThread)
+        {
+            // Whatever was not gathered is simply queried by the serial detect.
+            LogStringLine(REPORT_VERBOSE, "Failed to create detect worker, error: 0x%x", ::GetLastError());
+            break;
+        }
+
+        rghThreads[cThreads] = hThread;
+        ++cThreads;
+    }
+
+    if (cThreads)
+    {
+        ::WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+    }
+
+LExit:
+    for (DWORD i = 0; i < cThreads; ++i)
+    {
+        ReleaseHandle(rghThreads[i]);
+    }
+}
+
+static DWORD WINAPI DetectGatherThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    BURN_DETECT_GATHER_CONTEXT* pContext = reinterpret_cast<BURN_DETECT_GATHER_CONTEXT*>(lpThreadParameter);
+    BURN_PACKAGES* pPackages = pContext->pPackages;
+    LONG iPackage = 0;
+
+    while (static_cast<DWORD>(iPackage = ::InterlockedIncrement(&pContext->iNextPackage) - 1) < pPackages->cPackages)
+    {
+        BURN_PACKAGE* pPackage = pPackages->rgPackages + iPackage;
+
+        if (BURN_PACKAGE_TYPE_MSI == pPackage->type)
+        {
+            MsiEngineDetectGatherPackage(pPackage, &pPackages->msiDetectCache);
+        }
+    }
+
+    return 0;
+}
+
 static DWORD WINAPI CacheThreadProc(
     __in LPVOID lpThreadParameter
     )
@@ -30,6 +30,7 @@ const LPCWSTR BURN_COMMANDLINE_SWITCH_ANCESTORS = L"burn.ancestors";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_FILEHANDLE_ATTACHED = L"burn.filehandle.attached";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_FILEHANDLE_SELF = L"burn.filehandle.self";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_SPLASH_SCREEN = L"burn.splash.screen";
+const LPCWSTR BURN_COMMANDLINE_SWITCH_PROFILE = L"burn.profile";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_PREFIX = L"burn.";
 
 const LPCWSTR BURN_BUNDLE_LAYOUT_DIRECTORY = L"WixBundleLayoutDirectory";
@@ -47,6 +48,7 @@ const LPCWSTR BURN_BUNDLE_SOURCE_PROCESS_FOLDER = L"WixBundleSourceProcessFolder
 const LPCWSTR BURN_BUNDLE_TAG = L"WixBundleTag";
 const LPCWSTR BURN_BUNDLE_UILEVEL = L"WixBundleUILevel";
 const LPCWSTR BURN_BUNDLE_VERSION = L"WixBundleVersion";
+const LPCWSTR BURN_BUNDLE_PROFILE = L"WixBundleProfile";
 const LPCWSTR BURN_REBOOT_PENDING = L"RebootPending";
 
 // The following constants must stay in sync with src\api\wix\WixToolset.Data\Burn\BurnConstants.cs
@@ -149,7 +151,9 @@ typedef struct _BURN_ENGINE_STATE
 typedef struct _BURN_APPLY_CONTEXT
 {
     CRITICAL_SECTION csApply;
-    DWORD cOverallProgressTicks;
+    DWORD64 qwOverallProgressWeight;
+    BOOL fReportedOverallProgress;
+    DWORD dwLastOverallProgress;
     HANDLE hCacheThread;
     DWORD dwCacheCheckpoint;
 } BURN_APPLY_CONTEXT;
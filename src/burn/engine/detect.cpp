@@ -8,6 +8,10 @@ typedef struct _DETECT_AUTHENTICATION_REQUIRED_DATA
     LPCWSTR wzPackageOrContainerId;
 } DETECT_AUTHENTICATION_REQUIRED_DATA;
 
+const LPCWSTR DETECT_UPDATE_FEED_CACHE_FOLDER_NAME = L"Burn\\UpdateFeed";
+const LPCWSTR DETECT_UPDATE_FEED_CACHE_FILE_NAME = L"UpdateFeed.xml";
+const LPCWSTR DETECT_UPDATE_FEED_VALIDATORS_FILE_NAME = L"UpdateFeed.dat";
+
 // internal function definitions
 static HRESULT WINAPI AuthenticationRequired(
     __in LPVOID pData,
@@ -19,6 +23,7 @@ static HRESULT WINAPI AuthenticationRequired(
 
 static HRESULT DetectAtomFeedUpdate(
     __in_z LPCWSTR wzBundleId,
+    __in VERUTIL_VERSION* pBundleVersion,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate
     );
@@ -27,7 +32,25 @@ static HRESULT DownloadUpdateFeed(
     __in_z LPCWSTR wzBundleId,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate,
-    __deref_inout_z LPWSTR* psczTempFile
+    __deref_inout_z LPWSTR* psczFeedFile,
+    __out BOOL* pfTempFile
+    );
+
+static HRESULT ReadCachedUpdateFeedValidators(
+    __in_z LPCWSTR wzValidatorsPath,
+    __deref_out_z LPWSTR* psczUrl,
+    __deref_out_z LPWSTR* psczETag,
+    __deref_out_z LPWSTR* psczLastModified
+    );
+
+static HRESULT CacheUpdateFeed(
+    __in_z LPCWSTR wzFeedFile,
+    __in_z LPCWSTR wzCacheFolder,
+    __in_z LPCWSTR wzCachedFeedPath,
+    __in_z LPCWSTR wzValidatorsPath,
+    __in_z LPCWSTR wzUrl,
+    __in_z_opt LPCWSTR wzETag,
+    __in_z_opt LPCWSTR wzLastModified
     );
 
 // function definitions
@@ -245,6 +268,7 @@ LExit:
 
 extern "C" HRESULT DetectUpdate(
     __in_z LPCWSTR wzBundleId,
+    __in VERUTIL_VERSION* pBundleVersion,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate
     )
@@ -271,7 +295,7 @@ extern "C" HRESULT DetectUpdate(
 
     if (!fSkip)
     {
-        hr = DetectAtomFeedUpdate(wzBundleId, pUX, pUpdate);
+        hr = DetectAtomFeedUpdate(wzBundleId, pBundleVersion, pUX, pUpdate);
         ExitOnFailure(hr, "Failed to detect atom feed update.");
     }
 
@@ -290,6 +314,53 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT DetectGetUpdateFeedCacheFolder(
+    __in_z LPCWSTR wzBundleId,
+    __deref_out_z LPWSTR* psczCacheFolder
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczAppData = NULL;
+    LPWSTR sczFeedRoot = NULL;
+
+    hr = PathGetKnownFolder(CSIDL_LOCAL_APPDATA, &sczAppData);
+    ExitOnFailure(hr, "Failed to find local appdata directory.");
+
+    hr = PathConcat(sczAppData, DETECT_UPDATE_FEED_CACHE_FOLDER_NAME, &sczFeedRoot);
+    ExitOnFailure(hr, "Failed to construct update feed cache root directory.");
+
+    hr = PathConcat(sczFeedRoot, wzBundleId, psczCacheFolder);
+    ExitOnFailure(hr, "Failed to construct update feed cache directory for bundle: %ls", wzBundleId);
+
+LExit:
+    ReleaseStr(sczFeedRoot);
+    ReleaseStr(sczAppData);
+
+    return hr;
+}
+
+extern "C" void DetectRemoveUpdateFeedCache(
+    __in_z LPCWSTR wzBundleId
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczCacheFolder = NULL;
+
+    // Best effort, a feed left behind is only a few kilobytes and is never read again.
+    hr = DetectGetUpdateFeedCacheFolder(wzBundleId, &sczCacheFolder);
+    if (SUCCEEDED(hr))
+    {
+        hr = DirEnsureDeleteEx(sczCacheFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_SCHEDULE);
+    }
+
+    if (FAILED(hr) && E_PATHNOTFOUND != hr)
+    {
+        LogId(REPORT_VERBOSE, MSG_DETECT_UPDATE_FEED_CACHE_REMOVE_FAILED, wzBundleId, hr);
+    }
+
+    ReleaseStr(sczCacheFolder);
+}
+
 static HRESULT WINAPI AuthenticationRequired(
     __in LPVOID pData,
     __in HINTERNET hUrl,
@@ -352,7 +423,8 @@ static HRESULT DownloadUpdateFeed(
     __in_z LPCWSTR wzBundleId,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate,
-    __deref_inout_z LPWSTR* psczTempFile
+    __deref_inout_z LPWSTR* psczFeedFile,
+    __out BOOL* pfTempFile
     )
 {
     HRESULT hr = S_OK;
@@ -360,13 +432,17 @@ static HRESULT DownloadUpdateFeed(
     DOWNLOAD_CACHE_CALLBACK cacheCallback = { };
     DOWNLOAD_AUTHENTICATION_CALLBACK authenticationCallback = { };
     DETECT_AUTHENTICATION_REQUIRED_DATA authenticationData = { };
-    LPWSTR sczUpdateId = NULL;
-    LPWSTR sczError = NULL;
-    DWORD64 qwDownloadSize = 0;
-
-    // Always do our work in the working folder, even if cached.
-    hr = PathCreateTimeBasedTempFile(NULL, L"UpdateFeed", NULL, L"xml", psczTempFile, NULL);
-    ExitOnFailure(hr, "Failed to create UpdateFeed based on current system time.");
+    LPWSTR sczCacheFolder = NULL;
+    LPWSTR sczCachedFeedPath = NULL;
+    LPWSTR sczValidatorsPath = NULL;
+    LPWSTR sczETag = NULL;
+    LPWSTR sczLastModified = NULL;
+    LPWSTR sczCachedUrl = NULL;
+    LPWSTR sczCachedETag = NULL;
+    LPWSTR sczCachedLastModified = NULL;
+    BOOL fCached = FALSE;
+
+    *pfTempFile = FALSE;
 
     // Do we need a means of the BA to pass in a user name and password? If so, we should copy it to downloadSource here
     hr = StrAllocString(&downloadSource.sczUrl, pUpdate->sczUpdateSource, 0);
@@ -382,31 +458,171 @@ static HRESULT DownloadUpdateFeed(
     authenticationCallback.pv =  static_cast<LPVOID>(&authenticationData);
     authenticationCallback.pfnAuthenticate = &AuthenticationRequired;
 
-    hr = DownloadUrl(&downloadSource, qwDownloadSize, *psczTempFile, &cacheCallback, &authenticationCallback);
-    ExitOnFailure(hr, "Failed attempt to download update feed from URL: '%ls' to: '%ls'", downloadSource.sczUrl, *psczTempFile);
+    // The last feed downloaded is kept in a per-user folder for the bundle and is only downloaded
+    // again when the server no longer matches its ETag (or Last-Modified when there is no ETag).
+    // The cache is best effort, any failure to read or write it just downloads the feed again.
+    hr = DetectGetUpdateFeedCacheFolder(wzBundleId, &sczCacheFolder);
+    if (SUCCEEDED(hr))
+    {
+        hr = PathConcat(sczCacheFolder, DETECT_UPDATE_FEED_CACHE_FILE_NAME, &sczCachedFeedPath);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = PathConcat(sczCacheFolder, DETECT_UPDATE_FEED_VALIDATORS_FILE_NAME, &sczValidatorsPath);
+    }
+
+    if (FAILED(hr))
+    {
+        ReleaseNullStr(sczCachedFeedPath);
+        hr = S_OK;
+    }
+    else if (FileExistsEx(sczCachedFeedPath, NULL) &&
+             SUCCEEDED(ReadCachedUpdateFeedValidators(sczValidatorsPath, &sczCachedUrl, &sczCachedETag, &sczCachedLastModified)) &&
+             CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczCachedUrl, -1, downloadSource.sczUrl, -1))
+    {
+        fCached = TRUE;
+    }
+
+    // Always do our work in the working folder, even if cached.
+    hr = PathCreateTimeBasedTempFile(NULL, L"UpdateFeed", NULL, L"xml", psczFeedFile, NULL);
+    ExitOnFailure(hr, "Failed to create UpdateFeed based on current system time.");
+
+    *pfTempFile = TRUE;
+
+    hr = DownloadUrlIfModified(&downloadSource, *psczFeedFile, fCached ? sczCachedETag : NULL, fCached ? sczCachedLastModified : NULL, &cacheCallback, &authenticationCallback, &sczETag, &sczLastModified);
+    ExitOnFailure(hr, "Failed attempt to download update feed from URL: '%ls' to: '%ls'", downloadSource.sczUrl, *psczFeedFile);
+
+    if (S_FALSE == hr)
+    {
+        // The server can only answer "not modified" when we asked with the cached validators.
+        if (!fCached)
+        {
+            hr = E_UNEXPECTED;
+            ExitOnRootFailure(hr, "Update feed was reported not modified but there is no cached feed for URL: %ls", downloadSource.sczUrl);
+        }
+
+        LogId(REPORT_STANDARD, MSG_DETECT_UPDATE_FEED_CACHED, sczCachedFeedPath, *sczCachedETag ? sczCachedETag : sczCachedLastModified);
+
+        FileEnsureDelete(*psczFeedFile);
+        *pfTempFile = FALSE;
+
+        hr = StrAllocString(psczFeedFile, sczCachedFeedPath, 0);
+        ExitOnFailure(hr, "Failed to copy cached update feed path.");
+    }
+    else if (sczCachedFeedPath && (sczETag || sczLastModified))
+    {
+        hr = CacheUpdateFeed(*psczFeedFile, sczCacheFolder, sczCachedFeedPath, sczValidatorsPath, downloadSource.sczUrl, sczETag, sczLastModified);
+        if (FAILED(hr))
+        {
+            LogId(REPORT_VERBOSE, MSG_DETECT_UPDATE_FEED_CACHE_FAILED, downloadSource.sczUrl, hr);
+        }
+
+        hr = S_OK;
+    }
 
 LExit:
     if (FAILED(hr))
     {
-        if (*psczTempFile)
+        if (*pfTempFile && *psczFeedFile)
         {
-            FileEnsureDelete(*psczTempFile);
+            FileEnsureDelete(*psczFeedFile);
         }
 
-        ReleaseNullStr(*psczTempFile);
+        ReleaseNullStr(*psczFeedFile);
+        *pfTempFile = FALSE;
     }
 
+    ReleaseStr(sczCachedLastModified);
+    ReleaseStr(sczCachedETag);
+    ReleaseStr(sczCachedUrl);
+    ReleaseStr(sczLastModified);
+    ReleaseStr(sczETag);
+    ReleaseStr(sczValidatorsPath);
+    ReleaseStr(sczCachedFeedPath);
+    ReleaseStr(sczCacheFolder);
     ReleaseStr(downloadSource.sczUrl);
     ReleaseStr(downloadSource.sczUser);
     ReleaseStr(downloadSource.sczPassword);
-    ReleaseStr(sczUpdateId);
-    ReleaseStr(sczError);
+    return hr;
+}
+
+static HRESULT ReadCachedUpdateFeedValidators(
+    __in_z LPCWSTR wzValidatorsPath,
+    __deref_out_z LPWSTR* psczUrl,
+    __deref_out_z LPWSTR* psczETag,
+    __deref_out_z LPWSTR* psczLastModified
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbBuffer = NULL;
+    SIZE_T cbBuffer = 0;
+    SIZE_T iBuffer = 0;
+
+    hr = FileRead(&pbBuffer, &cbBuffer, wzValidatorsPath);
+    ExitOnFailure(hr, "Failed to read update feed validators: %ls", wzValidatorsPath);
+
+    hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, psczUrl);
+    ExitOnFailure(hr, "Failed to read update feed url.");
+
+    hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, psczETag);
+    ExitOnFailure(hr, "Failed to read update feed ETag.");
+
+    hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, psczLastModified);
+    ExitOnFailure(hr, "Failed to read update feed Last-Modified.");
+
+LExit:
+    ReleaseMem(pbBuffer);
+
+    return hr;
+}
+
+static HRESULT CacheUpdateFeed(
+    __in_z LPCWSTR wzFeedFile,
+    __in_z LPCWSTR wzCacheFolder,
+    __in_z LPCWSTR wzCachedFeedPath,
+    __in_z LPCWSTR wzValidatorsPath,
+    __in_z LPCWSTR wzUrl,
+    __in_z_opt LPCWSTR wzETag,
+    __in_z_opt LPCWSTR wzLastModified
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbBuffer = NULL;
+    SIZE_T cbBuffer = 0;
+
+    hr = BuffWriteString(&pbBuffer, &cbBuffer, wzUrl);
+    ExitOnFailure(hr, "Failed to write update feed url.");
+
+    hr = BuffWriteString(&pbBuffer, &cbBuffer, wzETag);
+    ExitOnFailure(hr, "Failed to write update feed ETag.");
+
+    hr = BuffWriteString(&pbBuffer, &cbBuffer, wzLastModified);
+    ExitOnFailure(hr, "Failed to write update feed Last-Modified.");
+
+    hr = DirEnsureExists(wzCacheFolder, NULL);
+    ExitOnFailure(hr, "Failed to create update feed cache folder: %ls", wzCacheFolder);
+
+    // Remove the old validators first so a feed that fails to copy is never trusted.
+    hr = FileEnsureDelete(wzValidatorsPath);
+    ExitOnFailure(hr, "Failed to delete old update feed validators: %ls", wzValidatorsPath);
+
+    hr = FileEnsureCopy(wzFeedFile, wzCachedFeedPath, TRUE);
+    ExitOnFailure(hr, "Failed to copy update feed to: %ls", wzCachedFeedPath);
+
+    hr = FileWrite(wzValidatorsPath, FILE_ATTRIBUTE_NORMAL, pbBuffer, cbBuffer, NULL);
+    ExitOnFailure(hr, "Failed to write update feed validators: %ls", wzValidatorsPath);
+
+LExit:
+    ReleaseBuffer(pbBuffer);
+
     return hr;
 }
 
 
 static HRESULT DetectAtomFeedUpdate(
     __in_z LPCWSTR wzBundleId,
+    __in VERUTIL_VERSION* pBundleVersion,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate
     )
@@ -418,22 +634,19 @@ static HRESULT DetectAtomFeedUpdate(
 
 
     HRESULT hr = S_OK;
-    LPWSTR sczUpdateFeedTempFile = NULL;
-    ATOM_FEED* pAtomFeed = NULL;
+    LPWSTR sczUpdateFeedFile = NULL;
+    BOOL fTempFile = FALSE;
     APPLICATION_UPDATE_CHAIN* pApupChain = NULL;
     BOOL fStopProcessingUpdates = FALSE;
 
-    hr = AtomInitialize();
-    ExitOnFailure(hr, "Failed to initialize Atom.");
-
-    hr = DownloadUpdateFeed(wzBundleId, pUX, pUpdate, &sczUpdateFeedTempFile);
+    hr = DownloadUpdateFeed(wzBundleId, pUX, pUpdate, &sczUpdateFeedFile, &fTempFile);
     ExitOnFailure(hr, "Failed to download update feed.");
 
-    hr = AtomParseFromFile(sczUpdateFeedTempFile, &pAtomFeed);
-    ExitOnFailure(hr, "Failed to parse update atom feed: %ls.", sczUpdateFeedTempFile);
+    // Only entries newer than this bundle are of interest, so the older history in the feed is never materialized.
+    hr = ApupAllocChainFromFile(sczUpdateFeedFile, pBundleVersion, &pApupChain);
+    ExitOnFailure(hr, "Failed to parse update atom feed: %ls.", sczUpdateFeedFile);
 
-    hr = ApupAllocChainFromAtom(pAtomFeed, &pApupChain);
-    ExitOnFailure(hr, "Failed to allocate update chain from atom feed.");
+    LogId(REPORT_STANDARD, MSG_DETECTED_UPDATE_FEED, pApupChain->cEntries, pBundleVersion->sczVersion);
 
     if (0 < pApupChain->cEntries)
     {
@@ -455,15 +668,13 @@ static HRESULT DetectAtomFeedUpdate(
     }
 
 LExit:
-    if (sczUpdateFeedTempFile && *sczUpdateFeedTempFile)
+    if (fTempFile && sczUpdateFeedFile && *sczUpdateFeedFile)
     {
-        FileEnsureDelete(sczUpdateFeedTempFile);
+        FileEnsureDelete(sczUpdateFeedFile);
     }
 
     ApupFreeChain(pApupChain);
-    AtomFreeFeed(pAtomFeed);
-    ReleaseStr(sczUpdateFeedTempFile);
-    AtomUninitialize();
+    ReleaseStr(sczUpdateFeedFile);
 
     return hr;
 }
@@ -35,10 +35,20 @@ HRESULT DetectReportRelatedBundles(
 
 HRESULT DetectUpdate(
     __in_z LPCWSTR wzBundleId,
+    __in VERUTIL_VERSION* pBundleVersion,
     __in BURN_USER_EXPERIENCE* pUX,
     __in BURN_UPDATE* pUpdate
     );
 
+HRESULT DetectGetUpdateFeedCacheFolder(
+    __in_z LPCWSTR wzBundleId,
+    __deref_out_z LPWSTR* psczCacheFolder
+    );
+
+void DetectRemoveUpdateFeedCache(
+    __in_z LPCWSTR wzBundleId
+    );
+
 #if defined(__cplusplus)
 }
 #endif
@@ -2348,7 +2348,7 @@ static HRESULT OnCacheVerifyPayload(
             ExitOnRootFailure(hr, "Cache verify payload called without starting its package.");
         }
 
-        hr = CacheVerifyPayload(pPayload, pPackage->sczCacheFolder, BurnCacheMessageHandler, ElevatedProgressRoutine, hPipe);
+        hr = CacheVerifyPayload(pPayload, pPackage->sczCacheFolder, TRUE, BurnCacheMessageHandler, ElevatedProgressRoutine, hPipe);
     }
     else
     {
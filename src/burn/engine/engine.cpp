@@ -91,6 +91,7 @@ extern "C" HRESULT EngineRun(
     BOOL fLogInitialized = FALSE;
     BOOL fCrypInitialized = FALSE;
     BOOL fDpiuInitialized = FALSE;
+    BOOL fProfilerInitialized = FALSE;
     BOOL fRegInitialized = FALSE;
     BOOL fWiuInitialized = FALSE;
     BOOL fXmlInitialized = FALSE;
@@ -155,6 +156,9 @@ extern "C" HRESULT EngineRun(
     ExitOnFailure(hr, "Failed to initialize XML util.");
     fXmlInitialized = TRUE;
 
+    ProfilerInitialize();
+    fProfilerInitialized = TRUE;
+
     hr = OsRtlGetVersion(&ovix);
     ExitOnFailure(hr, "Failed to get OS info.");
 
@@ -259,6 +263,11 @@ LExit:
 
     UninitializeEngineState(&engineState);
 
+    if (fProfilerInitialized)
+    {
+        ProfilerUninitialize();
+    }
+
     if (fXmlInitialized)
     {
         XmlUninitialize();
@@ -521,6 +530,15 @@ static HRESULT RunNormal(
     hr = LoggingOpen(&pEngineState->log, &pEngineState->variables, pEngineState->command.display, pEngineState->registration.sczDisplayName);
     ExitOnFailure(hr, "Failed to open log.");
 
+    if (pEngineState->log.dwAttributes & BURN_LOGGING_ATTRIBUTE_PROFILE)
+    {
+        hr = ProfilerStart();
+        ExitOnFailure(hr, "Failed to start profiler.");
+
+        hr = VariableSetNumeric(&pEngineState->variables, BURN_BUNDLE_PROFILE, 1, FALSE);
+        ExitOnFailure(hr, "Failed to set the profile variable.");
+    }
+
     // Ensure we're on a supported operating system.
     hr = ConditionGlobalCheck(&pEngineState->variables, &pEngineState->condition, pEngineState->command.display, pEngineState->registration.sczDisplayName, &pEngineState->userExperience.dwExitCode, &fContinueExecution);
     ExitOnFailure(hr, "Failed to check global conditions");
@@ -603,6 +621,9 @@ LExit:
     // If the message window is still around, close it.
     UiCloseMessageWindow(pEngineState);
 
+    LoggingWriteProfileTrace(&pEngineState->log);
+    ProfilerStop();
+
     VariablesDump(&pEngineState->variables);
 
     // end per-machine process if running
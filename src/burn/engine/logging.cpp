@@ -208,6 +208,36 @@ LExit:
     }
 }
 
+extern "C" void LoggingWriteProfileTrace(
+    __in BURN_LOGGING* pLog
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczTracePath = NULL;
+
+    // The trace is written next to the log, so there is nowhere to put it when logging is off.
+    if (!ProfilerIsEnabled() || BURN_LOGGING_STATE_OPEN != pLog->state || !pLog->sczPrefix)
+    {
+        ExitFunction();
+    }
+
+    hr = StrAllocFormatted(&sczTracePath, L"%ls%ls", pLog->sczPrefix, BURN_PROFILER_TRACE_EXTENSION);
+    ExitOnFailure(hr, "Failed to allocate profile trace path.");
+
+    hr = ProfilerWriteTrace(sczTracePath);
+    if (FAILED(hr))
+    {
+        LogId(REPORT_WARNING, MSG_FAILED_WRITE_PROFILE_TRACE, sczTracePath, hr);
+    }
+    else
+    {
+        LogId(REPORT_STANDARD, MSG_PROFILE_TRACE_WRITTEN, sczTracePath);
+    }
+
+LExit:
+    ReleaseStr(sczTracePath);
+}
+
 extern "C" void LoggingIncrementPackageSequence()
 {
     ++vdwPackageSequence;
@@ -21,6 +21,7 @@ enum BURN_LOGGING_ATTRIBUTE
     BURN_LOGGING_ATTRIBUTE_APPEND = 0x1,
     BURN_LOGGING_ATTRIBUTE_VERBOSE = 0x2,
     BURN_LOGGING_ATTRIBUTE_EXTRADEBUG = 0x4,
+    BURN_LOGGING_ATTRIBUTE_PROFILE = 0x8,
 };
 
 
@@ -50,6 +51,10 @@ HRESULT LoggingOpen(
 
 void LoggingOpenFailed();
 
+void LoggingWriteProfileTrace(
+    __in BURN_LOGGING* pLog
+    );
+
 void LoggingIncrementPackageSequence();
 
 HRESULT LoggingSetPackageVariable(
@@ -49,6 +49,18 @@ static void RegisterSourceDirectory(
     __in BURN_PACKAGE* pPackage,
     __in_z LPCWSTR wzCacheDirectory
     );
+static HRESULT DetectCacheEnumRelatedProducts(
+    __in BURN_MSI_DETECT_CACHE* pCache,
+    __in_z LPCWSTR wzUpgradeCode,
+    __out BURN_MSI_RELATED_PRODUCTS** ppRelatedProducts
+    );
+static HRESULT DetectCacheGetProductInfo(
+    __in BURN_MSI_DETECT_CACHE* pCache,
+    __in_z LPCWSTR wzProductCode,
+    __in MSIINSTALLCONTEXT context,
+    __in_z LPCWSTR wzProperty,
+    __out_z LPWSTR* psczValue
+    );
 
 
 // function definitions
@@ -401,12 +413,23 @@ extern "C" HRESULT MsiEngineDetectInitialize(
     __in BURN_PACKAGES* pPackages
     )
 {
-    AssertSz(pPackages->cPatchInfo, "MsiEngineDetectInitialize() should only be called if there are MSP packages.");
-
     HRESULT hr = S_OK;
+    BURN_MSI_DETECT_CACHE* pCache = &pPackages->msiDetectCache;
+
+    // Start every detect with an empty cache since products may have changed since the last one.
+    MsiEngineDetectUninitialize(pPackages);
+
+    ::InitializeCriticalSection(&pCache->csAccess);
+    pCache->fInitialized = TRUE;
+
+    hr = DictCreateWithEmbeddedKey(&pCache->sdRelatedProducts, 0, NULL, offsetof(BURN_MSI_RELATED_PRODUCTS, sczUpgradeCode), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "Failed to create related products cache.");
+
+    hr = DictCreateWithEmbeddedKey(&pCache->sdProductInfo, 0, NULL, offsetof(BURN_MSI_PRODUCT_INFO, sczKey), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "Failed to create product info cache.");
 
     // Add target products for slipstream MSIs that weren't detected.
-    for (DWORD iPackage = 0; iPackage < pPackages->cPackages; ++iPackage)
+    for (DWORD iPackage = 0; pPackages->cPatchInfo && iPackage < pPackages->cPackages; ++iPackage)
     {
         BURN_PACKAGE* pMsiPackage = pPackages->rgPackages + iPackage;
         if (BURN_PACKAGE_TYPE_MSI == pMsiPackage->type)
@@ -429,8 +452,112 @@ LExit:
     return hr;
 }
 
+extern "C" void MsiEngineDetectUninitialize(
+    __in BURN_PACKAGES* pPackages
+    )
+{
+    BURN_MSI_DETECT_CACHE* pCache = &pPackages->msiDetectCache;
+
+    if (!pCache->fInitialized)
+    {
+        ExitFunction();
+    }
+
+    if (pCache->cLookups)
+    {
+        LogId(REPORT_VERBOSE, MSG_DETECT_MSI_CACHE, pCache->cHits, pCache->cLookups, pCache->cRelatedProducts, pCache->cProductInfo);
+    }
+
+    ReleaseDict(pCache->sdRelatedProducts);
+    ReleaseDict(pCache->sdProductInfo);
+
+    for (DWORD i = 0; i < pCache->cRelatedProducts; ++i)
+    {
+        BURN_MSI_RELATED_PRODUCTS* pRelatedProducts = pCache->rgpRelatedProducts[i];
+
+        ReleaseStr(pRelatedProducts->sczUpgradeCode);
+        ReleaseStrArray(pRelatedProducts->rgsczProductCodes, pRelatedProducts->cProductCodes);
+        MemFree(pRelatedProducts);
+    }
+
+    for (DWORD i = 0; i < pCache->cProductInfo; ++i)
+    {
+        BURN_MSI_PRODUCT_INFO* pProductInfo = pCache->rgpProductInfo[i];
+
+        ReleaseStr(pProductInfo->sczKey);
+        ReleaseStr(pProductInfo->sczValue);
+        MemFree(pProductInfo);
+    }
+
+    ReleaseMem(pCache->rgpRelatedProducts);
+    ReleaseMem(pCache->rgpProductInfo);
+
+    ::DeleteCriticalSection(&pCache->csAccess);
+
+    memset(pCache, 0, sizeof(BURN_MSI_DETECT_CACHE));
+
+LExit:
+    return;
+}
+
+extern "C" HRESULT MsiEngineDetectGatherPackage(
+    __in BURN_PACKAGE* pPackage,
+    __in BURN_MSI_DETECT_CACHE* pCache
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczValue = NULL;
+    BURN_MSI_RELATED_PRODUCTS* pRelatedProducts = NULL;
+    MSIINSTALLCONTEXT context = MSIINSTALLCONTEXT_NONE;
+
+    // Make the same queries MsiEngineDetectPackage() will make so it finds their answers
+    // in the cache. Failures are left for it to report in package order.
+    hr = DetectCacheGetProductInfo(pCache, pPackage->Msi.sczProductCode, pPackage->fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+
+    for (DWORD i = 0; i < pPackage->Msi.cRelatedMsis; ++i)
+    {
+        BURN_RELATED_MSI* pRelatedMsi = &pPackage->Msi.rgRelatedMsis[i];
+
+        hr = DetectCacheEnumRelatedProducts(pCache, pRelatedMsi->sczUpgradeCode, &pRelatedProducts);
+        if (FAILED(hr))
+        {
+            continue;
+        }
+
+        for (DWORD iProduct = 0; iProduct < pRelatedProducts->cProductCodes; ++iProduct)
+        {
+            LPCWSTR wzProductCode = pRelatedProducts->rgsczProductCodes[iProduct];
+
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, pPackage->Msi.sczProductCode, -1, wzProductCode, -1))
+            {
+                continue;
+            }
+
+            context = MSIINSTALLCONTEXT_MACHINE;
+
+            hr = DetectCacheGetProductInfo(pCache, wzProductCode, context, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+            if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) == hr || HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) == hr)
+            {
+                context = MSIINSTALLCONTEXT_USERUNMANAGED;
+
+                hr = DetectCacheGetProductInfo(pCache, wzProductCode, context, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+            }
+
+            if (SUCCEEDED(hr) && pRelatedMsi->cLanguages)
+            {
+                hr = DetectCacheGetProductInfo(pCache, wzProductCode, context, INSTALLPROPERTY_LANGUAGE, &sczValue);
+            }
+        }
+    }
+
+    ReleaseStr(sczValue);
+
+    return S_OK;
+}
+
 extern "C" HRESULT MsiEngineDetectPackage(
     __in BURN_PACKAGE* pPackage,
+    __in BURN_MSI_DETECT_CACHE* pCache,
     __in BURN_USER_EXPERIENCE* pUserExperience
     )
 {
@@ -443,14 +570,14 @@ extern "C" HRESULT MsiEngineDetectPackage(
     INSTALLSTATE installState = INSTALLSTATE_UNKNOWN;
     BOOTSTRAPPER_RELATED_OPERATION operation = BOOTSTRAPPER_RELATED_OPERATION_NONE;
     BOOTSTRAPPER_RELATED_OPERATION relatedMsiOperation = BOOTSTRAPPER_RELATED_OPERATION_NONE;
-    WCHAR wzProductCode[MAX_GUID_CHARS + 1] = { };
+    BURN_MSI_RELATED_PRODUCTS* pRelatedProducts = NULL;
     VERUTIL_VERSION* pVersion = NULL;
     UINT uLcid = 0;
     BOOL fPerMachine = FALSE;
 
     // detect self by product code
     // TODO: what to do about MSIINSTALLCONTEXT_USERMANAGED?
-    hr = WiuGetProductInfoEx(pPackage->Msi.sczProductCode, NULL, pPackage->fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+    hr = DetectCacheGetProductInfo(pCache, pPackage->Msi.sczProductCode, pPackage->fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
     if (SUCCEEDED(hr))
     {
         hr = VerParseVersion(sczInstalledVersion, 0, FALSE, &pPackage->Msi.pInstalledVersion);
@@ -504,16 +631,13 @@ extern "C" HRESULT MsiEngineDetectPackage(
     {
         BURN_RELATED_MSI* pRelatedMsi = &pPackage->Msi.rgRelatedMsis[i];
 
-        for (DWORD iProduct = 0; ; ++iProduct)
+        hr = DetectCacheEnumRelatedProducts(pCache, pRelatedMsi->sczUpgradeCode, &pRelatedProducts);
+        ExitOnFailure(hr, "Failed to enum related products.");
+
+        for (DWORD iProduct = 0; iProduct < pRelatedProducts->cProductCodes; ++iProduct)
         {
             // get product
-            hr = WiuEnumRelatedProducts(pRelatedMsi->sczUpgradeCode, iProduct, wzProductCode);
-            if (E_NOMOREITEMS == hr)
-            {
-                hr = S_OK;
-                break;
-            }
-            ExitOnFailure(hr, "Failed to enum related products.");
+            LPCWSTR wzProductCode = pRelatedProducts->rgsczProductCodes[iProduct];
 
             // If we found ourselves, skip because saying that a package is related to itself is nonsensical.
             if (CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, pPackage->Msi.sczProductCode, -1, wzProductCode, -1))
@@ -522,7 +646,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             }
 
             // get product version
-            hr = WiuGetProductInfoEx(wzProductCode, NULL, MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+            hr = DetectCacheGetProductInfo(pCache, wzProductCode, MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
             if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) != hr && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) != hr)
             {
                 ExitOnFailure(hr, "Failed to get version for product in machine context: %ls", wzProductCode);
@@ -530,7 +654,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             }
             else
             {
-                hr = WiuGetProductInfoEx(wzProductCode, NULL, MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+                hr = DetectCacheGetProductInfo(pCache, wzProductCode, MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
                 if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) != hr && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) != hr)
                 {
                     ExitOnFailure(hr, "Failed to get version for product in user unmanaged context: %ls", wzProductCode);
@@ -579,7 +703,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             if (pRelatedMsi->cLanguages)
             {
                 // If there is a language to get, convert it into an LCID.
-                hr = WiuGetProductInfoEx(wzProductCode, NULL, fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_LANGUAGE, &sczInstalledLanguage);
+                hr = DetectCacheGetProductInfo(pCache, wzProductCode, fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_LANGUAGE, &sczInstalledLanguage);
                 if (SUCCEEDED(hr))
                 {
                     hr = StrStringToUInt32(sczInstalledLanguage, 0, &uLcid);
@@ -1251,6 +1375,13 @@ extern "C" HRESULT MsiEngineExecutePackage(
     }
 
 LExit:
+    WiuFlushExternalUI(&context); // the package is done so a cancel has nothing left to stop.
+
+    if (context.cCoalescedProgress || context.cCoalescedActionData)
+    {
+        LogId(REPORT_STANDARD, MSG_APPLY_MSI_MESSAGES_RELAYED, pPackage->sczId, context.cDeliveredMessages, context.cCoalescedProgress, context.cCoalescedActionData);
+    }
+
     WiuUninitializeExternalUI(&context);
 
     StrSecureZeroFreeString(sczProperties);
@@ -2025,3 +2156,198 @@ LExit:
 
     return;
 }
+
+static HRESULT DetectCacheEnumRelatedProducts(
+    __in BURN_MSI_DETECT_CACHE* pCache,
+    __in_z LPCWSTR wzUpgradeCode,
+    __out BURN_MSI_RELATED_PRODUCTS** ppRelatedProducts
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fLocked = FALSE;
+    BURN_MSI_RELATED_PRODUCTS* pRelatedProducts = NULL;
+    BURN_MSI_RELATED_PRODUCTS* pExisting = NULL;
+    WCHAR wzProductCode[MAX_GUID_CHARS + 1] = { };
+
+    ::EnterCriticalSection(&pCache->csAccess);
+    fLocked = TRUE;
+
+    ++pCache->cLookups;
+
+    hr = DictGetValue(pCache->sdRelatedProducts, wzUpgradeCode, reinterpret_cast<void**>(ppRelatedProducts));
+    if (SUCCEEDED(hr))
+    {
+        ++pCache->cHits;
+        ExitFunction();
+    }
+    else if (E_NOTFOUND != hr)
+    {
+        ExitOnFailure(hr, "Failed to find related products for upgrade code: %ls", wzUpgradeCode);
+    }
+
+    // Enumerate without holding the lock so other detect workers are not blocked on Windows Installer.
+    ::LeaveCriticalSection(&pCache->csAccess);
+    fLocked = FALSE;
+
+    pRelatedProducts = static_cast<BURN_MSI_RELATED_PRODUCTS*>(MemAlloc(sizeof(BURN_MSI_RELATED_PRODUCTS), TRUE));
+    ExitOnNull(pRelatedProducts, hr, E_OUTOFMEMORY, "Failed to allocate related products.");
+
+    hr = StrAllocString(&pRelatedProducts->sczUpgradeCode, wzUpgradeCode, 0);
+    ExitOnFailure(hr, "Failed to copy upgrade code.");
+
+    for (DWORD iProduct = 0; ; ++iProduct)
+    {
+        hr = WiuEnumRelatedProducts(wzUpgradeCode, iProduct, wzProductCode);
+        if (E_NOMOREITEMS == hr)
+        {
+            hr = S_OK;
+            break;
+        }
+        ExitOnFailure(hr, "Failed to enum related products.");
+
+        hr = StrArrayAllocString(&pRelatedProducts->rgsczProductCodes, reinterpret_cast<UINT*>(&pRelatedProducts->cProductCodes), wzProductCode, 0);
+        ExitOnFailure(hr, "Failed to cache related product code: %ls", wzProductCode);
+    }
+
+    ::EnterCriticalSection(&pCache->csAccess);
+    fLocked = TRUE;
+
+    // Another thread may have enumerated the same upgrade code in the meantime.
+    hr = DictGetValue(pCache->sdRelatedProducts, wzUpgradeCode, reinterpret_cast<void**>(&pExisting));
+    if (SUCCEEDED(hr))
+    {
+        *ppRelatedProducts = pExisting;
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pCache->rgpRelatedProducts), pCache->cRelatedProducts, 1, sizeof(BURN_MSI_RELATED_PRODUCTS*), 16);
+    ExitOnFailure(hr, "Failed to grow related products cache.");
+
+    hr = DictAddValue(pCache->sdRelatedProducts, pRelatedProducts);
+    ExitOnFailure(hr, "Failed to add related products for upgrade code: %ls", wzUpgradeCode);
+
+    pCache->rgpRelatedProducts[pCache->cRelatedProducts] = pRelatedProducts;
+    ++pCache->cRelatedProducts;
+
+    *ppRelatedProducts = pRelatedProducts;
+    pRelatedProducts = NULL;
+
+LExit:
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&pCache->csAccess);
+    }
+
+    if (pRelatedProducts)
+    {
+        ReleaseStr(pRelatedProducts->sczUpgradeCode);
+        ReleaseStrArray(pRelatedProducts->rgsczProductCodes, pRelatedProducts->cProductCodes);
+        MemFree(pRelatedProducts);
+    }
+
+    return hr;
+}
+
+static HRESULT DetectCacheGetProductInfo(
+    __in BURN_MSI_DETECT_CACHE* pCache,
+    __in_z LPCWSTR wzProductCode,
+    __in MSIINSTALLCONTEXT context,
+    __in_z LPCWSTR wzProperty,
+    __out_z LPWSTR* psczValue
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fLocked = FALSE;
+    LPWSTR sczKey = NULL;
+    LPWSTR sczValue = NULL;
+    BURN_MSI_PRODUCT_INFO* pProductInfo = NULL;
+    BURN_MSI_PRODUCT_INFO* pNewProductInfo = NULL;
+
+    hr = StrAllocFormatted(&sczKey, L"%ls|%u|%ls", wzProductCode, context, wzProperty);
+    ExitOnFailure(hr, "Failed to build product info cache key.");
+
+    ::EnterCriticalSection(&pCache->csAccess);
+    fLocked = TRUE;
+
+    ++pCache->cLookups;
+
+    hr = DictGetValue(pCache->sdProductInfo, sczKey, reinterpret_cast<void**>(&pProductInfo));
+    if (SUCCEEDED(hr))
+    {
+        ++pCache->cHits;
+    }
+    else if (E_NOTFOUND != hr)
+    {
+        ExitOnFailure(hr, "Failed to find cached product info: %ls", sczKey);
+    }
+    else
+    {
+        ::LeaveCriticalSection(&pCache->csAccess);
+        fLocked = FALSE;
+
+        hr = WiuGetProductInfoEx(wzProductCode, NULL, context, wzProperty, &sczValue);
+
+        // Only remember answers about the product itself; anything else may be transient.
+        if (FAILED(hr) && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) != hr && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) != hr)
+        {
+            ExitFunction();
+        }
+
+        pNewProductInfo = static_cast<BURN_MSI_PRODUCT_INFO*>(MemAlloc(sizeof(BURN_MSI_PRODUCT_INFO), TRUE));
+        ExitOnNull(pNewProductInfo, hr, E_OUTOFMEMORY, "Failed to allocate product info.");
+
+        pNewProductInfo->hrResult = hr;
+        pNewProductInfo->sczKey = sczKey;
+        pNewProductInfo->sczValue = sczValue;
+        sczKey = NULL;
+        sczValue = NULL;
+
+        ::EnterCriticalSection(&pCache->csAccess);
+        fLocked = TRUE;
+
+        // Another thread may have asked the same question in the meantime.
+        hr = DictGetValue(pCache->sdProductInfo, pNewProductInfo->sczKey, reinterpret_cast<void**>(&pProductInfo));
+        if (FAILED(hr))
+        {
+            hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pCache->rgpProductInfo), pCache->cProductInfo, 1, sizeof(BURN_MSI_PRODUCT_INFO*), 64);
+            ExitOnFailure(hr, "Failed to grow product info cache.");
+
+            hr = DictAddValue(pCache->sdProductInfo, pNewProductInfo);
+            ExitOnFailure(hr, "Failed to add product info to cache.");
+
+            pCache->rgpProductInfo[pCache->cProductInfo] = pNewProductInfo;
+            ++pCache->cProductInfo;
+
+            pProductInfo = pNewProductInfo;
+            pNewProductInfo = NULL;
+        }
+    }
+
+    ::LeaveCriticalSection(&pCache->csAccess);
+    fLocked = FALSE;
+
+    hr = pProductInfo->hrResult;
+    if (SUCCEEDED(hr))
+    {
+        hr = StrAllocString(psczValue, pProductInfo->sczValue, 0);
+        ExitOnFailure(hr, "Failed to copy cached product info.");
+    }
+
+LExit:
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&pCache->csAccess);
+    }
+
+    if (pNewProductInfo)
+    {
+        ReleaseStr(pNewProductInfo->sczKey);
+        ReleaseStr(pNewProductInfo->sczValue);
+        MemFree(pNewProductInfo);
+    }
+
+    ReleaseStr(sczValue);
+    ReleaseStr(sczKey);
+
+    return hr;
+}
@@ -30,8 +30,16 @@ void MsiEnginePackageUninitialize(
 HRESULT MsiEngineDetectInitialize(
     __in BURN_PACKAGES* pPackages
     );
+void MsiEngineDetectUninitialize(
+    __in BURN_PACKAGES* pPackages
+    );
+HRESULT MsiEngineDetectGatherPackage(
+    __in BURN_PACKAGE* pPackage,
+    __in BURN_MSI_DETECT_CACHE* pCache
+    );
 HRESULT MsiEngineDetectPackage(
     __in BURN_PACKAGE* pPackage,
+    __in BURN_MSI_DETECT_CACHE* pCache,
     __in BURN_USER_EXPERIENCE* pUserExperience
     );
 HRESULT MsiEnginePlanInitializePackage(
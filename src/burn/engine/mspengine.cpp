@@ -48,6 +48,18 @@ static HRESULT DeterminePatchChainedTarget(
     __in LPCWSTR wzTargetProductCode,
     __in DWORD dwMspTargetProductIndex
     );
+static HRESULT DetectInstalledPatchStates(
+    __in BURN_PACKAGES* pPackages,
+    __in const POSSIBLE_TARGETPRODUCT* pPossibleTargetProduct
+    );
+static BURN_MSPTARGETPRODUCT* FindTargetProduct(
+    __in BURN_PACKAGE* pMspPackage,
+    __in_z LPCWSTR wzProductCode
+    );
+static void SetTargetProductPatchState(
+    __in BURN_MSPTARGETPRODUCT* pTargetProduct,
+    __in DWORD dwPatchState
+    );
 static HRESULT PlanTargetProduct(
     __in BOOTSTRAPPER_DISPLAY display,
     __in BURN_USER_EXPERIENCE* pUserExperience,
@@ -187,6 +199,21 @@ extern "C" HRESULT MspEngineDetectInitialize(
         hr = S_OK; // always reset so we test all possible target products.
     }
 
+    // Read the installed state of the patches for each target product with one enumeration per
+    // patch state instead of asking for every patch and product pair during package detect.
+    for (DWORD iSearch = 0; iSearch < cPossibleTargetProducts; ++iSearch)
+    {
+        const POSSIBLE_TARGETPRODUCT* pPossibleTargetProduct = rgPossibleTargetProducts + iSearch;
+
+        hr = DetectInstalledPatchStates(pPackages, pPossibleTargetProduct);
+        if (FAILED(hr))
+        {
+            LogStringLine(REPORT_DEBUG, "      0x%x: Failed to enumerate installed patches for product: %ls, they will be queried individually.", hr, pPossibleTargetProduct->wzProductCode);
+
+            hr = S_OK;
+        }
+    }
+
 LExit:
     if (rgPossibleTargetProducts)
     {
@@ -239,6 +266,10 @@ extern "C" HRESULT MspEngineAddMissingSlipstreamTarget(
     pTargetProduct->fSlipstreamRequired = TRUE;
     pTargetProduct->pChainedTargetPackage = pMsiPackage;
 
+    // The target product is not on the machine so the patch cannot be either.
+    pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
+    pTargetProduct->fPatchStateDetected = TRUE;
+
     hr = AddMsiChainedPatch(pMsiPackage, pSlipstreamMsp->pMspPackage, dwTargetProductIndex, &dwChainedPatchIndex);
     ExitOnFailure(hr, "Failed to add chained patch.");
 
@@ -276,37 +307,21 @@ extern "C" HRESULT MspEngineDetectPackage(
         {
             BURN_MSPTARGETPRODUCT* pTargetProduct = pPackage->Msp.rgTargetProducts + i;
 
-            hr = WiuGetPatchInfoEx(pPackage->Msp.sczPatchCode, pTargetProduct->wzTargetProductCode, NULL, pTargetProduct->context, INSTALLPROPERTY_PATCHSTATE, &sczState);
-            if (SUCCEEDED(hr))
+            // Usually already known from the enumeration in MspEngineDetectInitialize().
+            if (!pTargetProduct->fPatchStateDetected)
             {
-                switch (*sczState)
+                hr = WiuGetPatchInfoEx(pPackage->Msp.sczPatchCode, pTargetProduct->wzTargetProductCode, NULL, pTargetProduct->context, INSTALLPROPERTY_PATCHSTATE, &sczState);
+                if (SUCCEEDED(hr))
+                {
+                    SetTargetProductPatchState(pTargetProduct, *sczState - L'0');
+                }
+                else if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PATCH) == hr || HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) == hr)
                 {
-                case '1':
-                    pTargetProduct->fInstalled = TRUE;
-                    pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_PRESENT;
-                    break;
-
-                case '2':
-                    pTargetProduct->fInstalled = TRUE;
-                    pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_SUPERSEDED;
-                    break;
-
-                case '4':
-                    pTargetProduct->fInstalled = TRUE;
-                    pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_OBSOLETE;
-                    break;
-
-                default:
                     pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
-                    break;
+                    hr = S_OK;
                 }
+                ExitOnFailure(hr, "Failed to get patch information for patch code: %ls, target product code: %ls", pPackage->Msp.sczPatchCode, pTargetProduct->wzTargetProductCode);
             }
-            else if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PATCH) == hr || HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) == hr)
-            {
-                pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
-                hr = S_OK;
-            }
-            ExitOnFailure(hr, "Failed to get patch information for patch code: %ls, target product code: %ls", pPackage->Msp.sczPatchCode, pTargetProduct->wzTargetProductCode);
 
             if (pPackage->currentState > pTargetProduct->patchPackageState)
             {
@@ -676,6 +691,13 @@ extern "C" HRESULT MspEngineExecutePackage(
     }
 
 LExit:
+    WiuFlushExternalUI(&context); // the package is done so a cancel has nothing left to stop.
+
+    if (context.cCoalescedProgress || context.cCoalescedActionData)
+    {
+        LogId(REPORT_STANDARD, MSG_APPLY_MSI_MESSAGES_RELAYED, pExecuteAction->mspTarget.pPackage->sczId, context.cDeliveredMessages, context.cCoalescedProgress, context.cCoalescedActionData);
+    }
+
     WiuUninitializeExternalUI(&context);
 
     ReleaseStr(sczCachedDirectory);
@@ -1069,6 +1091,123 @@ LExit:
     return hr;
 }
 
+static HRESULT DetectInstalledPatchStates(
+    __in BURN_PACKAGES* pPackages,
+    __in const POSSIBLE_TARGETPRODUCT* pPossibleTargetProduct
+    )
+{
+    static const DWORD rgdwPatchStates[] = { MSIPATCHSTATE_APPLIED, MSIPATCHSTATE_SUPERSEDED, MSIPATCHSTATE_OBSOLETED };
+
+    HRESULT hr = S_OK;
+    BOOL fTargeted = FALSE;
+    WCHAR wzPatchCode[MAX_GUID_CHARS + 1] = { };
+
+    // Start every patch that targets this product as absent; only installed patches are enumerated.
+    for (DWORD iPatchInfo = 0; iPatchInfo < pPackages->cPatchInfo; ++iPatchInfo)
+    {
+        BURN_MSPTARGETPRODUCT* pTargetProduct = FindTargetProduct(pPackages->rgPatchInfoToPackage[iPatchInfo], pPossibleTargetProduct->wzProductCode);
+        if (pTargetProduct)
+        {
+            pTargetProduct->fInstalled = FALSE;
+            pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
+            fTargeted = TRUE;
+        }
+    }
+
+    if (!fTargeted)
+    {
+        ExitFunction();
+    }
+
+    for (DWORD iState = 0; iState < countof(rgdwPatchStates); ++iState)
+    {
+        for (DWORD iPatch = 0; ; ++iPatch)
+        {
+            hr = WiuEnumPatchesEx(pPossibleTargetProduct->wzProductCode, NULL, pPossibleTargetProduct->context, rgdwPatchStates[iState], iPatch, wzPatchCode, NULL, NULL);
+            if (E_NOMOREITEMS == hr)
+            {
+                hr = S_OK;
+                break;
+            }
+            ExitOnFailure(hr, "Failed to enumerate patches for product: %ls", pPossibleTargetProduct->wzProductCode);
+
+            for (DWORD iPatchInfo = 0; iPatchInfo < pPackages->cPatchInfo; ++iPatchInfo)
+            {
+                BURN_PACKAGE* pMspPackage = pPackages->rgPatchInfoToPackage[iPatchInfo];
+
+                if (CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, wzPatchCode, -1, pMspPackage->Msp.sczPatchCode, -1))
+                {
+                    BURN_MSPTARGETPRODUCT* pTargetProduct = FindTargetProduct(pMspPackage, pPossibleTargetProduct->wzProductCode);
+                    if (pTargetProduct)
+                    {
+                        SetTargetProductPatchState(pTargetProduct, rgdwPatchStates[iState]);
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+    for (DWORD iPatchInfo = 0; iPatchInfo < pPackages->cPatchInfo; ++iPatchInfo)
+    {
+        BURN_MSPTARGETPRODUCT* pTargetProduct = FindTargetProduct(pPackages->rgPatchInfoToPackage[iPatchInfo], pPossibleTargetProduct->wzProductCode);
+        if (pTargetProduct)
+        {
+            pTargetProduct->fPatchStateDetected = TRUE;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static BURN_MSPTARGETPRODUCT* FindTargetProduct(
+    __in BURN_PACKAGE* pMspPackage,
+    __in_z LPCWSTR wzProductCode
+    )
+{
+    for (DWORD i = 0; i < pMspPackage->Msp.cTargetProductCodes; ++i)
+    {
+        BURN_MSPTARGETPRODUCT* pTargetProduct = pMspPackage->Msp.rgTargetProducts + i;
+
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, wzProductCode, -1, pTargetProduct->wzTargetProductCode, -1))
+        {
+            return pTargetProduct;
+        }
+    }
+
+    return NULL;
+}
+
+static void SetTargetProductPatchState(
+    __in BURN_MSPTARGETPRODUCT* pTargetProduct,
+    __in DWORD dwPatchState
+    )
+{
+    switch (dwPatchState)
+    {
+    case MSIPATCHSTATE_APPLIED:
+        pTargetProduct->fInstalled = TRUE;
+        pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_PRESENT;
+        break;
+
+    case MSIPATCHSTATE_SUPERSEDED:
+        pTargetProduct->fInstalled = TRUE;
+        pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_SUPERSEDED;
+        break;
+
+    case MSIPATCHSTATE_OBSOLETED:
+        pTargetProduct->fInstalled = TRUE;
+        pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_OBSOLETE;
+        break;
+
+    default:
+        pTargetProduct->patchPackageState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
+        break;
+    }
+}
+
 static HRESULT PlanTargetProduct(
     __in BOOTSTRAPPER_DISPLAY display,
     __in BURN_USER_EXPERIENCE* pUserExperience,
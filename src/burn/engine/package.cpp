@@ -403,6 +403,8 @@ extern "C" void PackagesUninitialize(
     ReleaseMem(pPackages->rgPatchInfo);
     ReleaseMem(pPackages->rgPatchInfoToPackage);
 
+    MsiEngineDetectUninitialize(pPackages);
+
     // clear struct
     memset(pPackages, 0, sizeof(BURN_PACKAGES));
 }
@@ -107,6 +107,7 @@ typedef struct _BURN_MSPTARGETPRODUCT
     BOOL fInstalled;
     BOOL fSlipstream;
     BOOL fSlipstreamRequired; // this means the target product is not present on the machine, but is available in the chain as a slipstream target.
+    BOOL fPatchStateDetected; // patchPackageState and fInstalled were already read during detect initialization.
 
     BOOTSTRAPPER_PACKAGE_STATE patchPackageState; // only valid after Detect.
     BOOTSTRAPPER_REQUEST_STATE defaultRequested;  // only valid during Plan.
@@ -233,6 +234,8 @@ typedef struct _BURN_PACKAGE
     BOOTSTRAPPER_REQUEST_STATE requested;       // only valid during Plan.
     BOOL fPlannedCache;                         // only valid during Plan.
     BOOL fPlannedUncache;                       // only valid during Plan.
+    DWORD64 qwCacheProgressWeight;              // only valid during Plan.
+    DWORD64 qwExecuteProgressWeight;            // only valid during Plan.
     BOOTSTRAPPER_ACTION_STATE execute;          // only valid during Plan.
     BOOTSTRAPPER_ACTION_STATE rollback;         // only valid during Plan.
     BURN_DEPENDENCY_ACTION providerExecute;     // only valid during Plan.
@@ -324,6 +327,39 @@ typedef struct _BURN_PACKAGE
     };
 } BURN_PACKAGE;
 
+typedef struct _BURN_MSI_RELATED_PRODUCTS
+{
+    LPWSTR sczUpgradeCode;
+    LPWSTR* rgsczProductCodes;
+    DWORD cProductCodes;
+} BURN_MSI_RELATED_PRODUCTS;
+
+typedef struct _BURN_MSI_PRODUCT_INFO
+{
+    LPWSTR sczKey; // product code, context and property.
+    HRESULT hrResult;
+    LPWSTR sczValue;
+} BURN_MSI_PRODUCT_INFO;
+
+// Windows Installer answers that stay valid for the duration of a single detect.
+// Entries are never modified or freed once added, so they can be read outside csAccess.
+typedef struct _BURN_MSI_DETECT_CACHE
+{
+    BOOL fInitialized;
+    CRITICAL_SECTION csAccess;
+
+    STRINGDICT_HANDLE sdRelatedProducts;
+    BURN_MSI_RELATED_PRODUCTS** rgpRelatedProducts;
+    DWORD cRelatedProducts;
+
+    STRINGDICT_HANDLE sdProductInfo;
+    BURN_MSI_PRODUCT_INFO** rgpProductInfo;
+    DWORD cProductInfo;
+
+    DWORD cLookups;
+    DWORD cHits;
+} BURN_MSI_DETECT_CACHE;
+
 typedef struct _BURN_PACKAGES
 {
     BURN_ROLLBACK_BOUNDARY* rgRollbackBoundaries;
@@ -339,6 +375,8 @@ typedef struct _BURN_PACKAGES
     BURN_PACKAGE** rgPatchInfoToPackage; // direct lookup from patch information to the (MSP) package it describes.
                                          // Thus this array is the exact same size as rgPatchInfo.
     DWORD cPatchInfo;
+
+    BURN_MSI_DETECT_CACHE msiDetectCache;
 } BURN_PACKAGES;
 
 
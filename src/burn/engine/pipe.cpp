@@ -85,6 +85,9 @@ extern "C" HRESULT PipeSendMessage(
 {
     HRESULT hr = S_OK;
     BURN_PIPE_RESULT result = { };
+    BURN_PROFILER_SPAN span = { };
+
+    ProfilerBeginMessageSpan(&span, BURN_PROFILER_CATEGORY_PIPE, L"PipeSendMessage", dwMessage);
 
     hr = WritePipeMessage(hPipe, dwMessage, pvData, cbData);
     ExitOnFailure(hr, "Failed to write send message to pipe.");
@@ -95,6 +98,8 @@ extern "C" HRESULT PipeSendMessage(
     *pdwResult = result.dwResult;
 
 LExit:
+    ProfilerEndSpan(&span);
+
     return hr;
 }
 
@@ -418,7 +418,9 @@ extern "C" HRESULT PlanLayoutBundle(
     // Acquire + Verify + Finalize
     pPlan->qwCacheSizeTotal += 3 * qwBundleSize;
 
-    ++pPlan->cOverallProgressTicksTotal;
+    pCacheAction->bundleLayout.qwProgressWeight = 3 * qwBundleSize + BURN_PLAN_PROGRESS_STEP_WEIGHT;
+
+    pPlan->qwOverallProgressWeightTotal += pCacheAction->bundleLayout.qwProgressWeight;
 
 LExit:
     ReleaseStr(sczExecutablePath);
@@ -1037,9 +1039,12 @@ extern "C" HRESULT PlanLayoutPackage(
 {
     HRESULT hr = S_OK;
     BURN_CACHE_ACTION* pCacheAction = NULL;
+    DWORD64 qwCacheSizeBefore = 0;
 
     AssertSz(!pPlan->fEnabledForwardCompatibleBundle, "Passthrough packages must already be cached");
 
+    qwCacheSizeBefore = pPlan->qwCacheSizeTotal;
+
     hr = ProcessPayloadGroup(pPlan, &pPackage->payloads);
     ExitOnFailure(hr, "Failed to process payload group for package: %ls.", pPackage->sczId);
 
@@ -1049,7 +1054,9 @@ extern "C" HRESULT PlanLayoutPackage(
     pCacheAction->type = BURN_CACHE_ACTION_TYPE_PACKAGE;
     pCacheAction->package.pPackage = pPackage;
 
-    ++pPlan->cOverallProgressTicksTotal;
+    pPackage->qwCacheProgressWeight = pPlan->qwCacheSizeTotal - qwCacheSizeBefore + BURN_PLAN_PROGRESS_STEP_WEIGHT;
+
+    pPlan->qwOverallProgressWeightTotal += pPackage->qwCacheProgressWeight;
 
 LExit:
     return hr;
@@ -1147,8 +1154,10 @@ extern "C" HRESULT PlanExecutePackage(
     {
         LoggingIncrementPackageSequence();
 
+        pPackage->qwExecuteProgressWeight = pPackage->qwInstallSize + BURN_PLAN_PROGRESS_STEP_WEIGHT;
+
         ++pPlan->cExecutePackagesTotal;
-        ++pPlan->cOverallProgressTicksTotal;
+        pPlan->qwOverallProgressWeightTotal += pPackage->qwExecuteProgressWeight;
 
         // If package is per-machine and is being executed, flag the plan to be per-machine as well.
         if (pPackage->fPerMachine)
@@ -1457,8 +1466,10 @@ extern "C" HRESULT PlanRelatedBundlesComplete(
             {
                 LoggingIncrementPackageSequence();
 
+                pRelatedBundle->package.qwExecuteProgressWeight = pRelatedBundle->package.qwInstallSize + BURN_PLAN_PROGRESS_STEP_WEIGHT;
+
                 ++pPlan->cExecutePackagesTotal;
-                ++pPlan->cOverallProgressTicksTotal;
+                pPlan->qwOverallProgressWeightTotal += pRelatedBundle->package.qwExecuteProgressWeight;
             }
 
             // If package is per-machine and is being executed, flag the plan to be per-machine as well.
@@ -1867,6 +1878,8 @@ static void ResetPlannedPackageState(
     pPackage->requested = BOOTSTRAPPER_REQUEST_STATE_NONE;
     pPackage->fPlannedCache = FALSE;
     pPackage->fPlannedUncache = FALSE;
+    pPackage->qwCacheProgressWeight = 0;
+    pPackage->qwExecuteProgressWeight = 0;
     pPackage->execute = BOOTSTRAPPER_ACTION_STATE_NONE;
     pPackage->rollback = BOOTSTRAPPER_ACTION_STATE_NONE;
     pPackage->providerExecute = BURN_DEPENDENCY_ACTION_NONE;
@@ -2653,7 +2666,7 @@ extern "C" void PlanDump(
     }
 
     LogStringLine(PlanDumpLevel, "Plan execute package count: %u", pPlan->cExecutePackagesTotal);
-    LogStringLine(PlanDumpLevel, "     overall progress ticks: %u", pPlan->cOverallProgressTicksTotal);
+    LogStringLine(PlanDumpLevel, "     overall progress weight: %llu", pPlan->qwOverallProgressWeightTotal);
     for (DWORD i = 0; i < pPlan->cExecuteActions; ++i)
     {
         ExecuteActionLog(i, pPlan->rgExecuteActions + i, FALSE);
@@ -11,6 +11,10 @@ extern "C" {
 
 const DWORD BURN_PLAN_INVALID_ACTION_INDEX = 0x80000000;
 
+// Weight every cache and execute step adds to overall progress on top of the
+// bytes it moves, so steps with little data to move still advance progress.
+const DWORD64 BURN_PLAN_PROGRESS_STEP_WEIGHT = 1024 * 1024;
+
 enum BURN_REGISTRATION_ACTION_OPERATIONS
 {
     BURN_REGISTRATION_ACTION_OPERATIONS_NONE = 0x0,
@@ -108,6 +112,7 @@ typedef struct _BURN_CACHE_ACTION
             LPWSTR sczExecutableName;
             LPWSTR sczUnverifiedPath;
             DWORD64 qwBundleSize;
+            DWORD64 qwProgressWeight;
             BURN_PAYLOAD_GROUP* pPayloadGroup;
         } bundleLayout;
         struct
@@ -247,7 +252,7 @@ typedef struct _BURN_PLAN
     DWORD64 qwEstimatedSize;
 
     DWORD cExecutePackagesTotal;
-    DWORD cOverallProgressTicksTotal;
+    DWORD64 qwOverallProgressWeightTotal;
 
     BOOL fEnabledForwardCompatibleBundle;
     BURN_PACKAGE forwardCompatibleBundle;
@@ -55,6 +55,7 @@
 #include <atomutil.h>
 #include <apuputil.h>
 #include <dpiutil.h>
+#include <jsonutil.h>
 
 #include "BootstrapperEngine.h"
 #include "BootstrapperApplication.h"
@@ -62,6 +63,7 @@
 #include "BundleExtension.h"
 
 #include "platform.h"
+#include "profiler.h"
 #include "variant.h"
 #include "variable.h"
 #include "condition.h"
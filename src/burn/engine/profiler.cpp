@@ -0,0 +1,404 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+static const DWORD BURN_PROFILER_EVENT_GROWTH = 256;
+
+// structs
+
+typedef struct _BURN_PROFILER_EVENT
+{
+    LPWSTR sczCategory;
+    LPWSTR sczName;
+    LPWSTR sczDetail;
+    BOOL fMessage;
+    DWORD dwMessage;
+    DWORD dwThreadId;
+    LONGLONG llStart;
+    LONGLONG llDuration;
+} BURN_PROFILER_EVENT;
+
+
+// internal variables
+
+static BOOL vfProfilerInitialized = FALSE;
+static volatile BOOL vfProfilerEnabled = FALSE;
+static CRITICAL_SECTION vcsProfiler = { };
+static LARGE_INTEGER vliFrequency = { };
+static LARGE_INTEGER vliOrigin = { };
+static BURN_PROFILER_EVENT* vrgEvents = NULL;
+static DWORD vcEvents = 0;
+
+
+// internal function declarations
+
+static LONGLONG GetElapsedMicroseconds();
+static HRESULT WriteEvent(
+    __in JSON_WRITER* pWriter,
+    __in DWORD dwProcessId,
+    __in BURN_PROFILER_EVENT* pEvent
+    );
+static void ReleaseEvent(
+    __in BURN_PROFILER_EVENT* pEvent
+    );
+
+
+// function definitions
+
+extern "C" void ProfilerInitialize()
+{
+    ::InitializeCriticalSection(&vcsProfiler);
+    vfProfilerInitialized = TRUE;
+}
+
+extern "C" void ProfilerUninitialize()
+{
+    if (vfProfilerInitialized)
+    {
+        ProfilerStop();
+
+        ::DeleteCriticalSection(&vcsProfiler);
+        vfProfilerInitialized = FALSE;
+    }
+}
+
+extern "C" HRESULT ProfilerStart()
+{
+    HRESULT hr = S_OK;
+
+    if (!vfProfilerInitialized)
+    {
+        hr = E_UNEXPECTED;
+        ExitOnRootFailure(hr, "Profiler must be initialized before it is started.");
+    }
+
+    if (vfProfilerEnabled)
+    {
+        ExitFunction();
+    }
+
+    if (!::QueryPerformanceFrequency(&vliFrequency) || !vliFrequency.QuadPart)
+    {
+        ExitWithLastError(hr, "Failed to get performance counter frequency.");
+    }
+
+    ::QueryPerformanceCounter(&vliOrigin);
+
+    vfProfilerEnabled = TRUE;
+
+LExit:
+    return hr;
+}
+
+extern "C" void ProfilerStop()
+{
+    if (vfProfilerInitialized)
+    {
+        // Take the lock so a span ending on another thread either finishes recording
+        // before the events are released or sees the profiler is off.
+        ::EnterCriticalSection(&vcsProfiler);
+
+        vfProfilerEnabled = FALSE;
+
+        for (DWORD i = 0; i < vcEvents; ++i)
+        {
+            ReleaseEvent(vrgEvents + i);
+        }
+
+        ReleaseNullMem(vrgEvents);
+        vcEvents = 0;
+
+        ::LeaveCriticalSection(&vcsProfiler);
+    }
+}
+
+extern "C" BOOL ProfilerIsEnabled()
+{
+    return vfProfilerEnabled;
+}
+
+extern "C" void ProfilerBeginSpan(
+    __in BURN_PROFILER_SPAN* pSpan,
+    __in_z LPCWSTR wzCategory,
+    __in_z LPCWSTR wzName,
+    __in_z_opt LPCWSTR wzDetail
+    )
+{
+    pSpan->fActive = vfProfilerEnabled;
+
+    if (pSpan->fActive)
+    {
+        pSpan->wzCategory = wzCategory;
+        pSpan->wzName = wzName;
+        pSpan->wzDetail = wzDetail;
+        pSpan->fMessage = FALSE;
+        pSpan->dwMessage = 0;
+        pSpan->llStart = GetElapsedMicroseconds();
+    }
+}
+
+extern "C" void ProfilerBeginMessageSpan(
+    __in BURN_PROFILER_SPAN* pSpan,
+    __in_z LPCWSTR wzCategory,
+    __in_z LPCWSTR wzName,
+    __in DWORD dwMessage
+    )
+{
+    ProfilerBeginSpan(pSpan, wzCategory, wzName, NULL);
+
+    if (pSpan->fActive)
+    {
+        pSpan->fMessage = TRUE;
+        pSpan->dwMessage = dwMessage;
+    }
+}
+
+extern "C" void ProfilerEndSpan(
+    __in BURN_PROFILER_SPAN* pSpan
+    )
+{
+    HRESULT hr = S_OK;
+    LONGLONG llEnd = 0;
+    BURN_PROFILER_EVENT* pEvent = NULL;
+    BOOL fLocked = FALSE;
+
+    // Spans that began while the profiler was off are never recorded.
+    if (!pSpan->fActive)
+    {
+        ExitFunction();
+    }
+
+    llEnd = GetElapsedMicroseconds();
+
+    ::EnterCriticalSection(&vcsProfiler);
+    fLocked = TRUE;
+
+    // Spans still open when the profiler stopped have no trace to go into.
+    if (!vfProfilerEnabled)
+    {
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&vrgEvents), vcEvents, 1, sizeof(BURN_PROFILER_EVENT), BURN_PROFILER_EVENT_GROWTH);
+    ExitOnFailure(hr, "Failed to grow profiler events.");
+
+    pEvent = vrgEvents + vcEvents;
+    memset(pEvent, 0, sizeof(BURN_PROFILER_EVENT));
+
+    hr = StrAllocString(&pEvent->sczCategory, pSpan->wzCategory, 0);
+    ExitOnFailure(hr, "Failed to copy profiler span category.");
+
+    hr = StrAllocString(&pEvent->sczName, pSpan->wzName, 0);
+    ExitOnFailure(hr, "Failed to copy profiler span name.");
+
+    if (pSpan->wzDetail)
+    {
+        hr = StrAllocString(&pEvent->sczDetail, pSpan->wzDetail, 0);
+        ExitOnFailure(hr, "Failed to copy profiler span detail.");
+    }
+
+    pEvent->fMessage = pSpan->fMessage;
+    pEvent->dwMessage = pSpan->dwMessage;
+    pEvent->dwThreadId = ::GetCurrentThreadId();
+    pEvent->llStart = pSpan->llStart;
+    pEvent->llDuration = llEnd - pSpan->llStart;
+
+    ++vcEvents;
+    pEvent = NULL;
+
+LExit:
+    if (pEvent)
+    {
+        ReleaseEvent(pEvent);
+    }
+
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&vcsProfiler);
+    }
+
+    pSpan->fActive = FALSE;
+}
+
+extern "C" HRESULT ProfilerWriteTrace(
+    __in_z LPCWSTR wzPath
+    )
+{
+    HRESULT hr = S_OK;
+    JSON_WRITER writer = { };
+    DWORD dwProcessId = ::GetCurrentProcessId();
+    BOOL fLocked = FALSE;
+
+    if (!vfProfilerInitialized)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    JsonInitializeWriter(&writer);
+
+    ::EnterCriticalSection(&vcsProfiler);
+    fLocked = TRUE;
+
+    // Roughly 200 characters per event avoids most reallocations while writing.
+    hr = JsonReserveWriter(&writer, 64 + vcEvents * 200);
+    ExitOnFailure(hr, "Failed to reserve trace buffer.");
+
+    hr = JsonWriteObjectStart(&writer);
+    ExitOnFailure(hr, "Failed to start trace.");
+
+    hr = JsonWriteObjectKey(&writer, L"traceEvents");
+    ExitOnFailure(hr, "Failed to write trace events key.");
+
+    hr = JsonWriteArrayStart(&writer);
+    ExitOnFailure(hr, "Failed to start trace events.");
+
+    for (DWORD i = 0; i < vcEvents; ++i)
+    {
+        hr = WriteEvent(&writer, dwProcessId, vrgEvents + i);
+        ExitOnFailure(hr, "Failed to write trace event.");
+    }
+
+    hr = JsonWriteArrayEnd(&writer);
+    ExitOnFailure(hr, "Failed to end trace events.");
+
+    hr = JsonWriteObjectKey(&writer, L"displayTimeUnit");
+    ExitOnFailure(hr, "Failed to write display time unit key.");
+
+    hr = JsonWriteString(&writer, L"ms");
+    ExitOnFailure(hr, "Failed to write display time unit.");
+
+    hr = JsonWriteObjectEnd(&writer);
+    ExitOnFailure(hr, "Failed to end trace.");
+
+    ::LeaveCriticalSection(&vcsProfiler);
+    fLocked = FALSE;
+
+    hr = FileFromString(wzPath, FILE_ATTRIBUTE_NORMAL, writer.sczJson, FILE_ENCODING_UTF8);
+    ExitOnFailure(hr, "Failed to write trace: %ls", wzPath);
+
+LExit:
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&vcsProfiler);
+    }
+
+    JsonUninitializeWriter(&writer);
+
+    return hr;
+}
+
+
+// internal function definitions
+
+static LONGLONG GetElapsedMicroseconds()
+{
+    LARGE_INTEGER liNow = { };
+    LONGLONG llTicks = 0;
+
+    ::QueryPerformanceCounter(&liNow);
+    llTicks = liNow.QuadPart - vliOrigin.QuadPart;
+
+    // Split the conversion so long sessions do not overflow.
+    return llTicks / vliFrequency.QuadPart * 1000000 + llTicks % vliFrequency.QuadPart * 1000000 / vliFrequency.QuadPart;
+}
+
+static HRESULT WriteEvent(
+    __in JSON_WRITER* pWriter,
+    __in DWORD dwProcessId,
+    __in BURN_PROFILER_EVENT* pEvent
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = JsonWriteObjectStart(pWriter);
+    ExitOnFailure(hr, "Failed to start event.");
+
+    hr = JsonWriteObjectKey(pWriter, L"name");
+    ExitOnFailure(hr, "Failed to write event name key.");
+
+    hr = JsonWriteString(pWriter, pEvent->sczName);
+    ExitOnFailure(hr, "Failed to write event name.");
+
+    hr = JsonWriteObjectKey(pWriter, L"cat");
+    ExitOnFailure(hr, "Failed to write event category key.");
+
+    hr = JsonWriteString(pWriter, pEvent->sczCategory);
+    ExitOnFailure(hr, "Failed to write event category.");
+
+    // Complete events carry their own duration so nesting does not need matching begin and end events.
+    hr = JsonWriteObjectKey(pWriter, L"ph");
+    ExitOnFailure(hr, "Failed to write event phase key.");
+
+    hr = JsonWriteString(pWriter, L"X");
+    ExitOnFailure(hr, "Failed to write event phase.");
+
+    hr = JsonWriteObjectKey(pWriter, L"ts");
+    ExitOnFailure(hr, "Failed to write event timestamp key.");
+
+    hr = JsonWriteNumber64(pWriter, static_cast<DWORD64>(pEvent->llStart));
+    ExitOnFailure(hr, "Failed to write event timestamp.");
+
+    hr = JsonWriteObjectKey(pWriter, L"dur");
+    ExitOnFailure(hr, "Failed to write event duration key.");
+
+    hr = JsonWriteNumber64(pWriter, static_cast<DWORD64>(pEvent->llDuration));
+    ExitOnFailure(hr, "Failed to write event duration.");
+
+    hr = JsonWriteObjectKey(pWriter, L"pid");
+    ExitOnFailure(hr, "Failed to write event process id key.");
+
+    hr = JsonWriteNumber(pWriter, dwProcessId);
+    ExitOnFailure(hr, "Failed to write event process id.");
+
+    hr = JsonWriteObjectKey(pWriter, L"tid");
+    ExitOnFailure(hr, "Failed to write event thread id key.");
+
+    hr = JsonWriteNumber(pWriter, pEvent->dwThreadId);
+    ExitOnFailure(hr, "Failed to write event thread id.");
+
+    if (pEvent->sczDetail || pEvent->fMessage)
+    {
+        hr = JsonWriteObjectKey(pWriter, L"args");
+        ExitOnFailure(hr, "Failed to write event args key.");
+
+        hr = JsonWriteObjectStart(pWriter);
+        ExitOnFailure(hr, "Failed to start event args.");
+
+        if (pEvent->sczDetail)
+        {
+            hr = JsonWriteObjectKey(pWriter, L"id");
+            ExitOnFailure(hr, "Failed to write event id key.");
+
+            hr = JsonWriteString(pWriter, pEvent->sczDetail);
+            ExitOnFailure(hr, "Failed to write event id.");
+        }
+
+        if (pEvent->fMessage)
+        {
+            hr = JsonWriteObjectKey(pWriter, L"message");
+            ExitOnFailure(hr, "Failed to write event message key.");
+
+            hr = JsonWriteNumber(pWriter, pEvent->dwMessage);
+            ExitOnFailure(hr, "Failed to write event message.");
+        }
+
+        hr = JsonWriteObjectEnd(pWriter);
+        ExitOnFailure(hr, "Failed to end event args.");
+    }
+
+    hr = JsonWriteObjectEnd(pWriter);
+    ExitOnFailure(hr, "Failed to end event.");
+
+LExit:
+    return hr;
+}
+
+static void ReleaseEvent(
+    __in BURN_PROFILER_EVENT* pEvent
+    )
+{
+    ReleaseStr(pEvent->sczCategory);
+    ReleaseStr(pEvent->sczName);
+    ReleaseStr(pEvent->sczDetail);
+    memset(pEvent, 0, sizeof(BURN_PROFILER_EVENT));
+}
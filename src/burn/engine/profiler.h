@@ -0,0 +1,68 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+
+// constants
+
+const LPCWSTR BURN_PROFILER_CATEGORY_DETECT = L"detect";
+const LPCWSTR BURN_PROFILER_CATEGORY_PLAN = L"plan";
+const LPCWSTR BURN_PROFILER_CATEGORY_CACHE = L"cache";
+const LPCWSTR BURN_PROFILER_CATEGORY_EXECUTE = L"execute";
+const LPCWSTR BURN_PROFILER_CATEGORY_PIPE = L"pipe";
+const LPCWSTR BURN_PROFILER_CATEGORY_BA = L"ba";
+
+const LPCWSTR BURN_PROFILER_TRACE_EXTENSION = L".trace.json";
+
+
+// structs
+
+// A span lives on the caller's stack between ProfilerBeginSpan and ProfilerEndSpan.
+// The name, category and detail strings are only copied when the span ends so they
+// must stay valid until then.
+typedef struct _BURN_PROFILER_SPAN
+{
+    BOOL fActive;
+    LPCWSTR wzCategory;
+    LPCWSTR wzName;
+    LPCWSTR wzDetail;
+    BOOL fMessage;
+    DWORD dwMessage;
+    LONGLONG llStart;
+} BURN_PROFILER_SPAN;
+
+
+// functions
+
+void ProfilerInitialize();
+void ProfilerUninitialize();
+HRESULT ProfilerStart();
+void ProfilerStop();
+BOOL ProfilerIsEnabled();
+void ProfilerBeginSpan(
+    __in BURN_PROFILER_SPAN* pSpan,
+    __in_z LPCWSTR wzCategory,
+    __in_z LPCWSTR wzName,
+    __in_z_opt LPCWSTR wzDetail
+    );
+void ProfilerBeginMessageSpan(
+    __in BURN_PROFILER_SPAN* pSpan,
+    __in_z LPCWSTR wzCategory,
+    __in_z LPCWSTR wzName,
+    __in DWORD dwMessage
+    );
+void ProfilerEndSpan(
+    __in BURN_PROFILER_SPAN* pSpan
+    );
+HRESULT ProfilerWriteTrace(
+    __in_z LPCWSTR wzPath
+    );
+
+
+#if defined(__cplusplus)
+}
+#endif
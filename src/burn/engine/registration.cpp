@@ -964,6 +964,8 @@ extern "C" HRESULT RegistrationSessionEnd(
         }
 
         CacheRemoveBundle(pRegistration->fPerMachine, pRegistration->sczId);
+
+        DetectRemoveUpdateFeedCache(pRegistration->sczId);
     }
     else // the mode needs to be updated so open the registration key.
     {
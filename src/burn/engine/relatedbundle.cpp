@@ -2,17 +2,64 @@
 
 #include "precomp.h"
 
+// constants
+
+const DWORD RELATED_BUNDLE_INDEX_VERSION = 2;
+const LPCWSTR RELATED_BUNDLE_INDEX_FOLDER_NAME = L".related";
+#if defined(_WIN64)
+const LPCWSTR RELATED_BUNDLE_INDEX_FILE_NAME = L"RelatedBundles64.dat"; // each registry view has its own Uninstall key
+#else
+const LPCWSTR RELATED_BUNDLE_INDEX_FILE_NAME = L"RelatedBundles32.dat";
+#endif
+const DWORD64 RELATED_BUNDLE_INDEX_SETTLE_TIME = 2ull * 10000000ull; // two seconds in FILETIME units, well past the registry clock resolution
+
+
+// structs
+
+typedef struct _RELATED_BUNDLE_CODES
+{
+    LPWSTR* rgsczUpgradeCodes;
+    DWORD cUpgradeCodes;
+    LPWSTR* rgsczAddonCodes;
+    DWORD cAddonCodes;
+    LPWSTR* rgsczDetectCodes;
+    DWORD cDetectCodes;
+    LPWSTR* rgsczPatchCodes;
+    DWORD cPatchCodes;
+} RELATED_BUNDLE_CODES;
+
+typedef struct _RELATED_BUNDLE_INDEX_ENTRY
+{
+    LPWSTR sczId;
+    DWORD64 qwLastWrite;
+    RELATED_BUNDLE_CODES codes;
+} RELATED_BUNDLE_INDEX_ENTRY;
+
+// Remembers the bundle codes read from every subkey of the Uninstall key along with the
+// time the subkey was last written, so only subkeys written since then need to be opened.
+typedef struct _RELATED_BUNDLE_INDEX
+{
+    RELATED_BUNDLE_INDEX_ENTRY* rgEntries;
+    DWORD cEntries;
+} RELATED_BUNDLE_INDEX;
+
+
 // internal function declarations
 
-static HRESULT LoadIfRelatedBundle(
+static HRESULT LoadRelatedBundle(
     __in BOOL fPerMachine,
     __in HKEY hkUninstallKey,
     __in_z LPCWSTR sczRelatedBundleId,
-    __in BURN_REGISTRATION* pRegistration,
+    __in BOOTSTRAPPER_RELATION_TYPE relationType,
     __in BURN_RELATED_BUNDLES* pRelatedBundles
     );
+static HRESULT ReadRelatedBundleCodes(
+    __in HKEY hkUninstallKey,
+    __in_z LPCWSTR sczRelatedBundleId,
+    __inout RELATED_BUNDLE_CODES* pCodes
+    );
 static HRESULT DetermineRelationType(
-    __in HKEY hkBundleId,
+    __in RELATED_BUNDLE_CODES* pCodes,
     __in BURN_REGISTRATION* pRegistration,
     __out BOOTSTRAPPER_RELATION_TYPE* pRelationType
     );
@@ -23,6 +70,45 @@ static HRESULT LoadRelatedBundleFromKey(
     __in BOOTSTRAPPER_RELATION_TYPE relationType,
     __inout BURN_RELATED_BUNDLE *pRelatedBundle
     );
+static HRESULT GetIndexPath(
+    __in BOOL fPerMachine,
+    __deref_out_z LPWSTR* psczIndexPath
+    );
+static HRESULT AddIndexEntry(
+    __in RELATED_BUNDLE_INDEX* pIndex,
+    __in_z LPCWSTR wzRelatedBundleId,
+    __in DWORD64 qwLastWrite,
+    __inout RELATED_BUNDLE_CODES* pCodes
+    );
+static HRESULT LoadIndex(
+    __in_z LPCWSTR wzIndexPath,
+    __inout RELATED_BUNDLE_INDEX* pIndex
+    );
+static HRESULT SaveIndex(
+    __in_z LPCWSTR wzIndexPath,
+    __in RELATED_BUNDLE_INDEX* pIndex
+    );
+static HRESULT ReadIndexCodes(
+    __in_bcount(cbBuffer) const BYTE* pbBuffer,
+    __in SIZE_T cbBuffer,
+    __inout SIZE_T* piBuffer,
+    __deref_out_ecount(*pcCodes) LPWSTR** prgsczCodes,
+    __out DWORD* pcCodes
+    );
+static HRESULT WriteIndexCodes(
+    __in BUFF_WRITER* pWriter,
+    __in_ecount(cCodes) LPWSTR* rgsczCodes,
+    __in DWORD cCodes
+    );
+static void UninitializeCodes(
+    __in RELATED_BUNDLE_CODES* pCodes
+    );
+static void UninitializeIndex(
+    __in RELATED_BUNDLE_INDEX* pIndex
+    );
+static DWORD64 FileTimeToQword(
+    __in FILETIME ft
+    );
 
 
 // function definitions
@@ -37,6 +123,18 @@ extern "C" HRESULT RelatedBundlesInitializeForScope(
     HKEY hkRoot = fPerMachine ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER;
     HKEY hkUninstallKey = NULL;
     LPWSTR sczRelatedBundleId = NULL;
+    LPWSTR sczIndexPath = NULL;
+    RELATED_BUNDLE_INDEX index = { };
+    RELATED_BUNDLE_INDEX updatedIndex = { };
+    STRINGDICT_HANDLE sdIndex = NULL;
+    RELATED_BUNDLE_INDEX_ENTRY* pEntry = NULL;
+    RELATED_BUNDLE_CODES codes = { };
+    FILETIME ftLastWrite = { };
+    FILETIME ftNow = { };
+    DWORD64 qwLastWrite = 0;
+    DWORD64 qwSettled = 0;
+    BOOL fIndexChanged = FALSE;
+    BOOTSTRAPPER_RELATION_TYPE relationType = BOOTSTRAPPER_RELATION_NONE;
 
     hr = RegOpen(hkRoot, BURN_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, &hkUninstallKey);
     if (HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND) == hr || HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) == hr)
@@ -45,9 +143,34 @@ extern "C" HRESULT RelatedBundlesInitializeForScope(
     }
     ExitOnFailure(hr, "Failed to open uninstall registry key.");
 
+    // The index is shared by every bundle in the scope. Without one, every subkey is read as if it changed.
+    hr = GetIndexPath(fPerMachine, &sczIndexPath);
+    if (SUCCEEDED(hr))
+    {
+        hr = LoadIndex(sczIndexPath, &index);
+        if (SUCCEEDED(hr))
+        {
+            LogStringLine(REPORT_VERBOSE, "Using related bundle index: %ls", sczIndexPath);
+        }
+    }
+
+    hr = DictCreateWithEmbeddedKey(&sdIndex, index.cEntries, NULL, offsetof(RELATED_BUNDLE_INDEX_ENTRY, sczId), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "Failed to create related bundle index dictionary.");
+
+    for (DWORD i = 0; i < index.cEntries; ++i)
+    {
+        hr = DictAddValue(sdIndex, index.rgEntries + i);
+        ExitOnFailure(hr, "Failed to add related bundle index entry to dictionary.");
+    }
+
+    // A bundle writes its codes right after creating its key, so a key written within the
+    // settle time is always re-read in case it was indexed in between.
+    ::GetSystemTimeAsFileTime(&ftNow);
+    qwSettled = FileTimeToQword(ftNow) - RELATED_BUNDLE_INDEX_SETTLE_TIME;
+
     for (DWORD dwIndex = 0; /* exit via break below */; ++dwIndex)
     {
-        hr = RegKeyEnum(hkUninstallKey, dwIndex, &sczRelatedBundleId);
+        hr = RegKeyEnumEx(hkUninstallKey, dwIndex, &sczRelatedBundleId, &ftLastWrite);
         if (E_NOMOREITEMS == hr)
         {
             hr = S_OK;
@@ -55,17 +178,74 @@ extern "C" HRESULT RelatedBundlesInitializeForScope(
         }
         ExitOnFailure(hr, "Failed to enumerate uninstall key for related bundles.");
 
+        qwLastWrite = FileTimeToQword(ftLastWrite);
+        if (qwLastWrite > qwSettled)
+        {
+            qwLastWrite = 0;
+        }
+
+        // Writing any value to a subkey updates its last write time, so the indexed codes
+        // are current for as long as the subkey's last write time is unchanged.
+        hr = DictGetValue(sdIndex, sczRelatedBundleId, reinterpret_cast<void**>(&pEntry));
+        if (SUCCEEDED(hr) && qwLastWrite && pEntry->qwLastWrite == qwLastWrite)
+        {
+            codes = pEntry->codes;
+            memset(&pEntry->codes, 0, sizeof(RELATED_BUNDLE_CODES));
+        }
+        else
+        {
+            fIndexChanged = TRUE;
+
+            // Ignore failures here since we'll often find products that aren't bundles at all,
+            // but don't index a subkey that couldn't be read.
+            HRESULT hrCodes = ReadRelatedBundleCodes(hkUninstallKey, sczRelatedBundleId, &codes);
+            if (FAILED(hrCodes))
+            {
+                qwLastWrite = 0;
+            }
+        }
+
         // If we did not find our bundle id, try to load the subkey as a related bundle.
         if (CSTR_EQUAL != ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, sczRelatedBundleId, -1, pRegistration->sczId, -1))
         {
-            // Ignore failures here since we'll often find products that aren't actually
-            // related bundles (or even bundles at all).
-            HRESULT hrRelatedBundle = LoadIfRelatedBundle(fPerMachine, hkUninstallKey, sczRelatedBundleId, pRegistration, pRelatedBundles);
-            UNREFERENCED_PARAMETER(hrRelatedBundle);
+            hr = DetermineRelationType(&codes, pRegistration, &relationType);
+            if (SUCCEEDED(hr) && BOOTSTRAPPER_RELATION_NONE != relationType)
+            {
+                // Ignore failures here since we'll often find products that aren't actually
+                // related bundles.
+                HRESULT hrRelatedBundle = LoadRelatedBundle(fPerMachine, hkUninstallKey, sczRelatedBundleId, relationType, pRelatedBundles);
+                UNREFERENCED_PARAMETER(hrRelatedBundle);
+            }
+        }
+
+        hr = AddIndexEntry(&updatedIndex, sczRelatedBundleId, qwLastWrite, &codes);
+        if (FAILED(hr))
+        {
+            // Never save an index that is missing a subkey.
+            UninitializeCodes(&codes);
+            ReleaseNullStr(sczIndexPath);
         }
     }
 
+    // Subkeys that were removed are simply not carried over.
+    if (sczIndexPath && (fIndexChanged || updatedIndex.cEntries != index.cEntries))
+    {
+        // Failing to save is expected when the per-machine index is not writable, e.g. before elevation.
+        HRESULT hrIndex = SaveIndex(sczIndexPath, &updatedIndex);
+        if (FAILED(hrIndex))
+        {
+            LogStringLine(REPORT_VERBOSE, "Could not save related bundle index: %ls, reason: 0x%x", sczIndexPath, hrIndex);
+        }
+    }
+
+    hr = S_OK;
+
 LExit:
+    UninitializeCodes(&codes);
+    ReleaseDict(sdIndex);
+    UninitializeIndex(&updatedIndex);
+    UninitializeIndex(&index);
+    ReleaseStr(sczIndexPath);
     ReleaseStr(sczRelatedBundleId);
     ReleaseRegKey(hkUninstallKey);
 
@@ -100,40 +280,90 @@ extern "C" void RelatedBundlesUninitialize(
 
 // internal helper functions
 
-static HRESULT LoadIfRelatedBundle(
+static HRESULT LoadRelatedBundle(
     __in BOOL fPerMachine,
     __in HKEY hkUninstallKey,
     __in_z LPCWSTR sczRelatedBundleId,
-    __in BURN_REGISTRATION* pRegistration,
+    __in BOOTSTRAPPER_RELATION_TYPE relationType,
     __in BURN_RELATED_BUNDLES* pRelatedBundles
     )
 {
     HRESULT hr = S_OK;
     HKEY hkBundleId = NULL;
-    BOOTSTRAPPER_RELATION_TYPE relationType = BOOTSTRAPPER_RELATION_NONE;
+
+    hr = RegOpen(hkUninstallKey, sczRelatedBundleId, KEY_READ, &hkBundleId);
+    ExitOnFailure(hr, "Failed to open uninstall key for related bundle: %ls", sczRelatedBundleId);
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pRelatedBundles->rgRelatedBundles), pRelatedBundles->cRelatedBundles + 1, sizeof(BURN_RELATED_BUNDLE), 5);
+    ExitOnFailure(hr, "Failed to ensure there is space for related bundles.");
+
+    BURN_RELATED_BUNDLE* pRelatedBundle = pRelatedBundles->rgRelatedBundles + pRelatedBundles->cRelatedBundles;
+
+    hr = LoadRelatedBundleFromKey(sczRelatedBundleId, hkBundleId, fPerMachine, relationType, pRelatedBundle);
+    ExitOnFailure(hr, "Failed to initialize package from related bundle id: %ls", sczRelatedBundleId);
+
+    ++pRelatedBundles->cRelatedBundles;
+
+LExit:
+    ReleaseRegKey(hkBundleId);
+
+    return hr;
+}
+
+static HRESULT ReadRelatedBundleCodes(
+    __in HKEY hkUninstallKey,
+    __in_z LPCWSTR sczRelatedBundleId,
+    __inout RELATED_BUNDLE_CODES* pCodes
+    )
+{
+    HRESULT hr = S_OK;
+    HKEY hkBundleId = NULL;
 
     hr = RegOpen(hkUninstallKey, sczRelatedBundleId, KEY_READ, &hkBundleId);
     ExitOnFailure(hr, "Failed to open uninstall key for potential related bundle: %ls", sczRelatedBundleId);
 
-    hr = DetermineRelationType(hkBundleId, pRegistration, &relationType);
-    if (FAILED(hr) || BOOTSTRAPPER_RELATION_NONE == relationType)
+    // All remaining operations should treat all related bundles as non-vital,
+    // so code lists that can't be read are left empty.
+    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &pCodes->rgsczUpgradeCodes, &pCodes->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE) == hr)
     {
-        // Must not be a related bundle.
-        hr = E_NOTFOUND;
+        TraceError(hr, "Failed to read upgrade codes as REG_MULTI_SZ. Trying again as REG_SZ in case of older bundles.");
+
+        pCodes->rgsczUpgradeCodes = reinterpret_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR), TRUE));
+        ExitOnNull(pCodes->rgsczUpgradeCodes, hr, E_OUTOFMEMORY, "Failed to allocate list for a single upgrade code from older bundle.");
+
+        hr = RegReadString(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &pCodes->rgsczUpgradeCodes[0]);
+        if (SUCCEEDED(hr))
+        {
+            pCodes->cUpgradeCodes = 1;
+        }
     }
-    else // load the related bundle.
+
+    if (FAILED(hr))
     {
-        hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pRelatedBundles->rgRelatedBundles), pRelatedBundles->cRelatedBundles + 1, sizeof(BURN_RELATED_BUNDLE), 5);
-        ExitOnFailure(hr, "Failed to ensure there is space for related bundles.");
+        ReleaseNullStrArray(pCodes->rgsczUpgradeCodes, pCodes->cUpgradeCodes);
+    }
 
-        BURN_RELATED_BUNDLE* pRelatedBundle = pRelatedBundles->rgRelatedBundles + pRelatedBundles->cRelatedBundles;
+    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_ADDON_CODE, &pCodes->rgsczAddonCodes, &pCodes->cAddonCodes);
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pCodes->rgsczAddonCodes, pCodes->cAddonCodes);
+    }
 
-        hr = LoadRelatedBundleFromKey(sczRelatedBundleId, hkBundleId, fPerMachine, relationType, pRelatedBundle);
-        ExitOnFailure(hr, "Failed to initialize package from related bundle id: %ls", sczRelatedBundleId);
+    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_PATCH_CODE, &pCodes->rgsczPatchCodes, &pCodes->cPatchCodes);
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pCodes->rgsczPatchCodes, pCodes->cPatchCodes);
+    }
 
-        ++pRelatedBundles->cRelatedBundles;
+    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_DETECT_CODE, &pCodes->rgsczDetectCodes, &pCodes->cDetectCodes);
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pCodes->rgsczDetectCodes, pCodes->cDetectCodes);
     }
 
+    hr = S_OK;
+
 LExit:
     ReleaseRegKey(hkBundleId);
 
@@ -141,47 +371,23 @@ LExit:
 }
 
 static HRESULT DetermineRelationType(
-    __in HKEY hkBundleId,
+    __in RELATED_BUNDLE_CODES* pCodes,
     __in BURN_REGISTRATION* pRegistration,
     __out BOOTSTRAPPER_RELATION_TYPE* pRelationType
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR* rgsczUpgradeCodes = NULL;
-    DWORD cUpgradeCodes = 0;
     STRINGDICT_HANDLE sdUpgradeCodes = NULL;
-    LPWSTR* rgsczAddonCodes = NULL;
-    DWORD cAddonCodes = 0;
     STRINGDICT_HANDLE sdAddonCodes = NULL;
-    LPWSTR* rgsczDetectCodes = NULL;
-    DWORD cDetectCodes = 0;
     STRINGDICT_HANDLE sdDetectCodes = NULL;
-    LPWSTR* rgsczPatchCodes = NULL;
-    DWORD cPatchCodes = 0;
     STRINGDICT_HANDLE sdPatchCodes = NULL;
 
     *pRelationType = BOOTSTRAPPER_RELATION_NONE;
 
-    // All remaining operations should treat all related bundles as non-vital.
-    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &rgsczUpgradeCodes, &cUpgradeCodes);
-    if (HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE) == hr)
-    {
-        TraceError(hr, "Failed to read upgrade codes as REG_MULTI_SZ. Trying again as REG_SZ in case of older bundles.");
-
-        rgsczUpgradeCodes = reinterpret_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR), TRUE));
-        ExitOnNull(rgsczUpgradeCodes, hr, E_OUTOFMEMORY, "Failed to allocate list for a single upgrade code from older bundle.");
-
-        hr = RegReadString(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &rgsczUpgradeCodes[0]);
-        if (SUCCEEDED(hr))
-        {
-            cUpgradeCodes = 1;
-        }
-    }
-
     // Compare upgrade codes.
-    if (SUCCEEDED(hr))
+    if (pCodes->cUpgradeCodes)
     {
-        hr = DictCreateStringListFromArray(&sdUpgradeCodes, rgsczUpgradeCodes, cUpgradeCodes, DICT_FLAG_CASEINSENSITIVE);
+        hr = DictCreateStringListFromArray(&sdUpgradeCodes, pCodes->rgsczUpgradeCodes, pCodes->cUpgradeCodes, DICT_FLAG_CASEINSENSITIVE);
         ExitOnFailure(hr, "Failed to create string dictionary for %hs.", "upgrade codes");
 
         // Upgrade relationship: when their upgrade codes match our upgrade codes.
@@ -241,14 +447,12 @@ static HRESULT DetermineRelationType(
         }
 
         ReleaseNullDict(sdUpgradeCodes);
-        ReleaseNullStrArray(rgsczUpgradeCodes, cUpgradeCodes);
     }
 
     // Compare addon codes.
-    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_ADDON_CODE, &rgsczAddonCodes, &cAddonCodes);
-    if (SUCCEEDED(hr))
+    if (pCodes->cAddonCodes)
     {
-        hr = DictCreateStringListFromArray(&sdAddonCodes, rgsczAddonCodes, cAddonCodes, DICT_FLAG_CASEINSENSITIVE);
+        hr = DictCreateStringListFromArray(&sdAddonCodes, pCodes->rgsczAddonCodes, pCodes->cAddonCodes, DICT_FLAG_CASEINSENSITIVE);
         ExitOnFailure(hr, "Failed to create string dictionary for %hs.", "addon codes");
 
         // Addon relationship: when their addon codes match our detect codes.
@@ -280,14 +484,12 @@ static HRESULT DetermineRelationType(
         }
 
         ReleaseNullDict(sdAddonCodes);
-        ReleaseNullStrArray(rgsczAddonCodes, cAddonCodes);
     }
 
     // Compare patch codes.
-    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_PATCH_CODE, &rgsczPatchCodes, &cPatchCodes);
-    if (SUCCEEDED(hr))
+    if (pCodes->cPatchCodes)
     {
-        hr = DictCreateStringListFromArray(&sdPatchCodes, rgsczPatchCodes, cPatchCodes, DICT_FLAG_CASEINSENSITIVE);
+        hr = DictCreateStringListFromArray(&sdPatchCodes, pCodes->rgsczPatchCodes, pCodes->cPatchCodes, DICT_FLAG_CASEINSENSITIVE);
         ExitOnFailure(hr, "Failed to create string dictionary for %hs.", "patch codes");
 
         // Patch relationship: when their patch codes match our detect codes.
@@ -319,14 +521,12 @@ static HRESULT DetermineRelationType(
         }
 
         ReleaseNullDict(sdPatchCodes);
-        ReleaseNullStrArray(rgsczPatchCodes, cPatchCodes);
     }
 
     // Compare detect codes.
-    hr = RegReadStringArray(hkBundleId, BURN_REGISTRATION_REGISTRY_BUNDLE_DETECT_CODE, &rgsczDetectCodes, &cDetectCodes);
-    if (SUCCEEDED(hr))
+    if (pCodes->cDetectCodes)
     {
-        hr = DictCreateStringListFromArray(&sdDetectCodes, rgsczDetectCodes, cDetectCodes, DICT_FLAG_CASEINSENSITIVE);
+        hr = DictCreateStringListFromArray(&sdDetectCodes, pCodes->rgsczDetectCodes, pCodes->cDetectCodes, DICT_FLAG_CASEINSENSITIVE);
         ExitOnFailure(hr, "Failed to create string dictionary for %hs.", "detect codes");
 
         // Detect relationship: when their detect codes match our detect codes.
@@ -372,7 +572,6 @@ static HRESULT DetermineRelationType(
         }
 
         ReleaseNullDict(sdDetectCodes);
-        ReleaseNullStrArray(rgsczDetectCodes, cDetectCodes);
     }
 
 LExit:
@@ -382,13 +581,9 @@ LExit:
     }
 
     ReleaseDict(sdUpgradeCodes);
-    ReleaseStrArray(rgsczUpgradeCodes, cUpgradeCodes);
     ReleaseDict(sdAddonCodes);
-    ReleaseStrArray(rgsczAddonCodes, cAddonCodes);
     ReleaseDict(sdDetectCodes);
-    ReleaseStrArray(rgsczDetectCodes, cDetectCodes);
     ReleaseDict(sdPatchCodes);
-    ReleaseStrArray(rgsczPatchCodes, cPatchCodes);
 
     return hr;
 }
@@ -481,3 +676,285 @@ LExit:
 
     return hr;
 }
+
+static HRESULT GetIndexPath(
+    __in BOOL fPerMachine,
+    __deref_out_z LPWSTR* psczIndexPath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczCacheFolder = NULL;
+
+    hr = CacheGetCompletedPath(fPerMachine, RELATED_BUNDLE_INDEX_FOLDER_NAME, &sczCacheFolder);
+    ExitOnFailure(hr, "Failed to get %hs related bundle index folder.", fPerMachine ? "per-machine" : "per-user");
+
+    hr = PathConcat(sczCacheFolder, RELATED_BUNDLE_INDEX_FILE_NAME, psczIndexPath);
+    ExitOnFailure(hr, "Failed to build related bundle index path.");
+
+LExit:
+    ReleaseStr(sczCacheFolder);
+
+    return hr;
+}
+
+static HRESULT AddIndexEntry(
+    __in RELATED_BUNDLE_INDEX* pIndex,
+    __in_z LPCWSTR wzRelatedBundleId,
+    __in DWORD64 qwLastWrite,
+    __inout RELATED_BUNDLE_CODES* pCodes
+    )
+{
+    HRESULT hr = S_OK;
+    RELATED_BUNDLE_INDEX_ENTRY* pEntry = NULL;
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pIndex->rgEntries), pIndex->cEntries, 1, sizeof(RELATED_BUNDLE_INDEX_ENTRY), 16);
+    ExitOnFailure(hr, "Failed to ensure there is space for related bundle index entries.");
+
+    pEntry = pIndex->rgEntries + pIndex->cEntries;
+
+    hr = StrAllocString(&pEntry->sczId, wzRelatedBundleId, 0);
+    ExitOnFailure(hr, "Failed to copy related bundle id into index.");
+
+    pEntry->qwLastWrite = qwLastWrite;
+
+    // The index takes ownership of the codes.
+    pEntry->codes = *pCodes;
+    memset(pCodes, 0, sizeof(RELATED_BUNDLE_CODES));
+
+    ++pIndex->cEntries;
+
+LExit:
+    return hr;
+}
+
+static HRESULT LoadIndex(
+    __in_z LPCWSTR wzIndexPath,
+    __inout RELATED_BUNDLE_INDEX* pIndex
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbBuffer = NULL;
+    SIZE_T cbBuffer = 0;
+    SIZE_T iBuffer = 0;
+    DWORD dwVersion = 0;
+    DWORD cEntries = 0;
+
+    hr = FileRead(&pbBuffer, &cbBuffer, wzIndexPath);
+    ExitOnFailure(hr, "Failed to read related bundle index: %ls", wzIndexPath);
+
+    hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &dwVersion);
+    ExitOnFailure(hr, "Failed to read related bundle index version.");
+
+    if (RELATED_BUNDLE_INDEX_VERSION != dwVersion)
+    {
+        hr = E_INVALIDDATA;
+        ExitOnRootFailure(hr, "Unsupported related bundle index version: %u", dwVersion);
+    }
+
+    hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &cEntries);
+    ExitOnFailure(hr, "Failed to read related bundle index entry count.");
+
+    if (cEntries > cbBuffer / sizeof(SIZE_T))
+    {
+        hr = E_INVALIDDATA;
+        ExitOnRootFailure(hr, "Related bundle index entry count is larger than the index.");
+    }
+
+    if (cEntries)
+    {
+        pIndex->rgEntries = static_cast<RELATED_BUNDLE_INDEX_ENTRY*>(MemAlloc(sizeof(RELATED_BUNDLE_INDEX_ENTRY) * cEntries, TRUE));
+        ExitOnNull(pIndex->rgEntries, hr, E_OUTOFMEMORY, "Failed to allocate related bundle index entries.");
+    }
+
+    for (DWORD i = 0; i < cEntries; ++i)
+    {
+        RELATED_BUNDLE_INDEX_ENTRY* pEntry = pIndex->rgEntries + i;
+        ++pIndex->cEntries;
+
+        hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, &pEntry->sczId);
+        ExitOnFailure(hr, "Failed to read related bundle id from index.");
+
+        hr = BuffReadNumber64(pbBuffer, cbBuffer, &iBuffer, &pEntry->qwLastWrite);
+        ExitOnFailure(hr, "Failed to read related bundle last write time from index.");
+
+        hr = ReadIndexCodes(pbBuffer, cbBuffer, &iBuffer, &pEntry->codes.rgsczUpgradeCodes, &pEntry->codes.cUpgradeCodes);
+        ExitOnFailure(hr, "Failed to read upgrade codes from related bundle index.");
+
+        hr = ReadIndexCodes(pbBuffer, cbBuffer, &iBuffer, &pEntry->codes.rgsczAddonCodes, &pEntry->codes.cAddonCodes);
+        ExitOnFailure(hr, "Failed to read addon codes from related bundle index.");
+
+        hr = ReadIndexCodes(pbBuffer, cbBuffer, &iBuffer, &pEntry->codes.rgsczDetectCodes, &pEntry->codes.cDetectCodes);
+        ExitOnFailure(hr, "Failed to read detect codes from related bundle index.");
+
+        hr = ReadIndexCodes(pbBuffer, cbBuffer, &iBuffer, &pEntry->codes.rgsczPatchCodes, &pEntry->codes.cPatchCodes);
+        ExitOnFailure(hr, "Failed to read patch codes from related bundle index.");
+    }
+
+LExit:
+    if (FAILED(hr))
+    {
+        UninitializeIndex(pIndex);
+    }
+
+    ReleaseBuffer(pbBuffer);
+
+    return hr;
+}
+
+static HRESULT SaveIndex(
+    __in_z LPCWSTR wzIndexPath,
+    __in RELATED_BUNDLE_INDEX* pIndex
+    )
+{
+    HRESULT hr = S_OK;
+    BUFF_WRITER writer = { };
+    LPWSTR sczIndexFolder = NULL;
+    LPWSTR sczTempPath = NULL;
+
+    hr = BuffWriterWriteNumber(&writer, RELATED_BUNDLE_INDEX_VERSION);
+    ExitOnFailure(hr, "Failed to write related bundle index version.");
+
+    hr = BuffWriterWriteNumber(&writer, pIndex->cEntries);
+    ExitOnFailure(hr, "Failed to write related bundle index entry count.");
+
+    for (DWORD i = 0; i < pIndex->cEntries; ++i)
+    {
+        RELATED_BUNDLE_INDEX_ENTRY* pEntry = pIndex->rgEntries + i;
+
+        hr = BuffWriterWriteString(&writer, pEntry->sczId);
+        ExitOnFailure(hr, "Failed to write related bundle id to index.");
+
+        hr = BuffWriterWriteNumber64(&writer, pEntry->qwLastWrite);
+        ExitOnFailure(hr, "Failed to write related bundle last write time to index.");
+
+        hr = WriteIndexCodes(&writer, pEntry->codes.rgsczUpgradeCodes, pEntry->codes.cUpgradeCodes);
+        ExitOnFailure(hr, "Failed to write upgrade codes to related bundle index.");
+
+        hr = WriteIndexCodes(&writer, pEntry->codes.rgsczAddonCodes, pEntry->codes.cAddonCodes);
+        ExitOnFailure(hr, "Failed to write addon codes to related bundle index.");
+
+        hr = WriteIndexCodes(&writer, pEntry->codes.rgsczDetectCodes, pEntry->codes.cDetectCodes);
+        ExitOnFailure(hr, "Failed to write detect codes to related bundle index.");
+
+        hr = WriteIndexCodes(&writer, pEntry->codes.rgsczPatchCodes, pEntry->codes.cPatchCodes);
+        ExitOnFailure(hr, "Failed to write patch codes to related bundle index.");
+    }
+
+    hr = PathGetDirectory(wzIndexPath, &sczIndexFolder);
+    ExitOnFailure(hr, "Failed to get related bundle index folder.");
+
+    hr = DirEnsureExists(sczIndexFolder, NULL);
+    ExitOnFailure(hr, "Failed to create related bundle index folder: %ls", sczIndexFolder);
+
+    // Other bundles read the index concurrently, so it is replaced in a single rename.
+    hr = StrAllocFormatted(&sczTempPath, L"%ls.%u", wzIndexPath, ::GetCurrentProcessId());
+    ExitOnFailure(hr, "Failed to build temporary related bundle index path.");
+
+    hr = FileWrite(sczTempPath, FILE_ATTRIBUTE_NORMAL, writer.pbData, writer.cbData, NULL);
+    ExitOnFailure(hr, "Failed to write related bundle index: %ls", sczTempPath);
+
+    hr = FileEnsureMove(sczTempPath, wzIndexPath, TRUE, FALSE);
+    ExitOnFailure(hr, "Failed to replace related bundle index: %ls", wzIndexPath);
+
+LExit:
+    if (FAILED(hr) && sczTempPath)
+    {
+        FileEnsureDelete(sczTempPath);
+    }
+
+    ReleaseStr(sczTempPath);
+    ReleaseStr(sczIndexFolder);
+    ReleaseBuffWriter(writer);
+
+    return hr;
+}
+
+static HRESULT ReadIndexCodes(
+    __in_bcount(cbBuffer) const BYTE* pbBuffer,
+    __in SIZE_T cbBuffer,
+    __inout SIZE_T* piBuffer,
+    __deref_out_ecount(*pcCodes) LPWSTR** prgsczCodes,
+    __out DWORD* pcCodes
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cCodes = 0;
+
+    hr = BuffReadNumber(pbBuffer, cbBuffer, piBuffer, &cCodes);
+    ExitOnFailure(hr, "Failed to read code count.");
+
+    if (cCodes > (cbBuffer - *piBuffer) / sizeof(SIZE_T))
+    {
+        hr = E_INVALIDDATA;
+        ExitOnRootFailure(hr, "Code count is larger than the remaining index.");
+    }
+
+    if (cCodes)
+    {
+        *prgsczCodes = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * cCodes, TRUE));
+        ExitOnNull(*prgsczCodes, hr, E_OUTOFMEMORY, "Failed to allocate codes.");
+
+        *pcCodes = cCodes;
+
+        for (DWORD i = 0; i < cCodes; ++i)
+        {
+            hr = BuffReadString(pbBuffer, cbBuffer, piBuffer, *prgsczCodes + i);
+            ExitOnFailure(hr, "Failed to read code.");
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriteIndexCodes(
+    __in BUFF_WRITER* pWriter,
+    __in_ecount(cCodes) LPWSTR* rgsczCodes,
+    __in DWORD cCodes
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = BuffWriterWriteNumber(pWriter, cCodes);
+    ExitOnFailure(hr, "Failed to write code count.");
+
+    hr = BuffWriterWriteStrings(pWriter, const_cast<LPCWSTR*>(rgsczCodes), cCodes);
+    ExitOnFailure(hr, "Failed to write codes.");
+
+LExit:
+    return hr;
+}
+
+static void UninitializeCodes(
+    __in RELATED_BUNDLE_CODES* pCodes
+    )
+{
+    ReleaseStrArray(pCodes->rgsczUpgradeCodes, pCodes->cUpgradeCodes);
+    ReleaseStrArray(pCodes->rgsczAddonCodes, pCodes->cAddonCodes);
+    ReleaseStrArray(pCodes->rgsczDetectCodes, pCodes->cDetectCodes);
+    ReleaseStrArray(pCodes->rgsczPatchCodes, pCodes->cPatchCodes);
+
+    memset(pCodes, 0, sizeof(RELATED_BUNDLE_CODES));
+}
+
+static void UninitializeIndex(
+    __in RELATED_BUNDLE_INDEX* pIndex
+    )
+{
+    for (DWORD i = 0; i < pIndex->cEntries; ++i)
+    {
+        ReleaseStr(pIndex->rgEntries[i].sczId);
+        UninitializeCodes(&pIndex->rgEntries[i].codes);
+    }
+
+    ReleaseMem(pIndex->rgEntries);
+
+    memset(pIndex, 0, sizeof(RELATED_BUNDLE_INDEX));
+}
+
+static DWORD64 FileTimeToQword(
+    __in FILETIME ft
+    )
+{
+    return (static_cast<DWORD64>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
@@ -473,6 +473,7 @@ extern "C" HRESULT SearchesExecute(
 {
     HRESULT hr = S_OK;
     BOOL f = FALSE;
+    BURN_PROFILER_SPAN span = { };
 
     for (DWORD i = 0; i < pSearches->cSearches; ++i)
     {
@@ -496,6 +497,8 @@ extern "C" HRESULT SearchesExecute(
             }
         }
 
+        ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_DETECT, L"Search", pSearch->sczKey);
+
         switch (pSearch->Type)
         {
         case BURN_SEARCH_TYPE_DIRECTORY:
@@ -559,6 +562,8 @@ extern "C" HRESULT SearchesExecute(
             hr = E_UNEXPECTED;
         }
 
+        ProfilerEndSpan(&span);
+
         if (FAILED(hr))
         {
             TraceError(hr, "Search failed. Id = '%ls'", pSearch->sczKey);
@@ -2617,13 +2617,19 @@ static HRESULT SendBAMessage(
     )
 {
     HRESULT hr = S_OK;
+    BURN_PROFILER_SPAN span = { };
 
     if (!pUserExperience->hUXModule)
     {
         ExitFunction();
     }
 
+    ProfilerBeginMessageSpan(&span, BURN_PROFILER_CATEGORY_BA, L"BAProc", message);
+
     hr = pUserExperience->pfnBAProc(message, pvArgs, pvResults, pUserExperience->pvBAProcContext);
+
+    ProfilerEndSpan(&span);
+
     if (hr == E_NOTIMPL)
     {
         hr = S_OK;
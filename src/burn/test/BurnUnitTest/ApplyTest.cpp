@@ -0,0 +1,154 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+
+using namespace System;
+using namespace Xunit;
+
+typedef struct _APPLY_TEST_PROGRESS
+{
+    DWORD cCalls;
+    DWORD rgdwPercentages[256];
+} APPLY_TEST_PROGRESS;
+
+static HRESULT WINAPI ApplyTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults,
+    __in_opt LPVOID pvContext
+    );
+
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    public ref class ApplyTest : BurnUnitTest
+    {
+    public:
+        ApplyTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void ApplyReportOverallProgressSendsEachPercentageOnceTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            APPLY_TEST_PROGRESS progress = { };
+            const DWORD cSteps = 1000;
+
+            ::InitializeCriticalSection(&applyContext.csApply);
+
+            try
+            {
+                InitializeUserExperience(&userExperience, &progress);
+
+                // The first step is still 0%, which the BA must see before anything else.
+                for (DWORD i = 0; i < cSteps; ++i)
+                {
+                    hr = ApplyReportOverallProgress(&userExperience, FALSE, 1, cSteps, &applyContext);
+                    NativeAssert::Succeeded(hr, "Failed to report progress.");
+                }
+
+                Assert::Equal<DWORD>(101, progress.cCalls);
+                for (DWORD i = 0; i < progress.cCalls; ++i)
+                {
+                    Assert::Equal<DWORD>(i, progress.rgdwPercentages[i]);
+                }
+
+                // Rolling every step back walks the percentage down to 0% again.
+                for (DWORD i = 0; i < cSteps; ++i)
+                {
+                    hr = ApplyReportOverallProgress(&userExperience, TRUE, 1, cSteps, &applyContext);
+                    NativeAssert::Succeeded(hr, "Failed to report rollback progress.");
+                }
+
+                Assert::Equal<DWORD>(201, progress.cCalls);
+                for (DWORD i = 101; i < progress.cCalls; ++i)
+                {
+                    Assert::Equal<DWORD>(200 - i, progress.rgdwPercentages[i]);
+                }
+            }
+            finally
+            {
+                ::DeleteCriticalSection(&applyContext.csApply);
+            }
+        }
+
+        [Fact]
+        void ApplyReportOverallProgressSendsFirstProgressWithoutWeightTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            APPLY_TEST_PROGRESS progress = { };
+
+            ::InitializeCriticalSection(&applyContext.csApply);
+
+            try
+            {
+                InitializeUserExperience(&userExperience, &progress);
+
+                // A plan with nothing to weigh still tells the BA where it is, but only once.
+                hr = ApplyReportOverallProgress(&userExperience, FALSE, 0, 0, &applyContext);
+                NativeAssert::Succeeded(hr, "Failed to report progress.");
+
+                hr = ApplyReportOverallProgress(&userExperience, FALSE, 0, 0, &applyContext);
+                NativeAssert::Succeeded(hr, "Failed to report progress.");
+
+                Assert::Equal<DWORD>(1, progress.cCalls);
+                Assert::Equal<DWORD>(0, progress.rgdwPercentages[0]);
+            }
+            finally
+            {
+                ::DeleteCriticalSection(&applyContext.csApply);
+            }
+        }
+
+    private:
+        void InitializeUserExperience(BURN_USER_EXPERIENCE* pUserExperience, APPLY_TEST_PROGRESS* pProgress)
+        {
+            // Messages are only sent while a BA module is loaded, so stand in the test module for it.
+            pUserExperience->hUXModule = ::GetModuleHandleW(NULL);
+            pUserExperience->pfnBAProc = ApplyTestBAProc;
+            pUserExperience->pvBAProcContext = pProgress;
+        }
+    };
+}
+}
+}
+}
+}
+
+
+static HRESULT WINAPI ApplyTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID /*pvResults*/,
+    __in_opt LPVOID pvContext
+    )
+{
+    APPLY_TEST_PROGRESS* pProgress = reinterpret_cast<APPLY_TEST_PROGRESS*>(pvContext);
+    BA_ONPROGRESS_ARGS* pArgs = reinterpret_cast<BA_ONPROGRESS_ARGS*>(pvArgs);
+
+    if (BOOTSTRAPPER_APPLICATION_MESSAGE_ONPROGRESS == message)
+    {
+        if (pProgress->cCalls < countof(pProgress->rgdwPercentages))
+        {
+            pProgress->rgdwPercentages[pProgress->cCalls] = pArgs->dwOverallPercentage;
+        }
+
+        ++pProgress->cCalls;
+    }
+
+    return S_OK;
+}
@@ -2,6 +2,20 @@
 
 #include "precomp.h"
 
+
+#define ROOT_PATH L"SOFTWARE\\WiX_Burn_UnitTest"
+#define HKLM_PATH L"SOFTWARE\\WiX_Burn_UnitTest\\HKLM"
+#define POLICY_PATH HKLM_PATH L"\\SOFTWARE\\Policies\\WiX\\Burn"
+
+
+static LSTATUS APIENTRY CacheTest_RegOpenKeyExW(
+    __in HKEY hKey,
+    __in_opt LPCWSTR lpSubKey,
+    __reserved DWORD ulOptions,
+    __in REGSAM samDesired,
+    __out PHKEY phkResult
+    );
+
 static HRESULT CALLBACK CacheTestEventRoutine(
     __in BURN_CACHE_MESSAGE* pMessage,
     __in LPVOID pvContext
@@ -33,6 +47,7 @@ namespace Test
 {
 namespace Bootstrapper
 {
+    using namespace Microsoft::Win32;
     using namespace System;
     using namespace System::IO;
     using namespace Xunit;
@@ -90,6 +105,359 @@ namespace Bootstrapper
                 }
             }
         }
+
+        [Fact]
+        void CacheLayoutPayloadLinksOnlyReadOnlyVerifiedFilesTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_PAYLOAD payload = { };
+            LPWSTR sczTestFile = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczTempFolder = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczReadOnlyPath = NULL;
+            LPWSTR sczWritablePath = NULL;
+            LPWSTR sczLayoutFolder = NULL;
+            LPWSTR sczLayoutPath = NULL;
+            BYTE* pb = NULL;
+            DWORD cb = NULL;
+            CACHE_TEST_CONTEXT context = { };
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest\\CacheSignatureTest.File", &sczTestFile);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file.");
+
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = PathExpand(&sczTempFolder, L"%TEMP%", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::Succeeded(hr, "Failed to get temp folder.");
+
+                hr = PathConcat(sczTempFolder, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to get test folder.");
+
+                hr = PathConcat(sczFolder, L"readonly\\CacheSignatureTest.File", &sczReadOnlyPath);
+                NativeAssert::Succeeded(hr, "Failed to get read-only source path.");
+
+                hr = PathConcat(sczFolder, L"writable\\CacheSignatureTest.File", &sczWritablePath);
+                NativeAssert::Succeeded(hr, "Failed to get writable source path.");
+
+                hr = PathConcat(sczFolder, L"layout", &sczLayoutFolder);
+                NativeAssert::Succeeded(hr, "Failed to get layout folder.");
+
+                hr = PathConcat(sczLayoutFolder, L"CacheSignatureTest.File", &sczLayoutPath);
+                NativeAssert::Succeeded(hr, "Failed to get layout path.");
+
+                hr = FileEnsureCopy(sczTestFile, sczReadOnlyPath, TRUE);
+                NativeAssert::Succeeded(hr, "Failed to copy read-only source.");
+                Assert::True(::SetFileAttributesW(sczReadOnlyPath, FILE_ATTRIBUTE_READONLY));
+
+                hr = FileEnsureCopy(sczTestFile, sczWritablePath, TRUE);
+                NativeAssert::Succeeded(hr, "Failed to copy writable source.");
+
+                hr = StrAllocHexDecode(L"25e61cd83485062b70713aebddd3fe4992826cb121466fddc8de3eacb1e42f39d4bdd8455d95eec8c9529ced4c0296ab861931fe2c86df2f2b4e8d259a6d9223", &pb, &cb);
+                Assert::Equal(S_OK, hr);
+
+                payload.sczKey = L"CacheSignatureTest.PayloadKey";
+                payload.sczFilePath = L"CacheSignatureTest.File";
+                payload.pbHash = pb;
+                payload.cbHash = cb;
+                payload.qwFileSize = 27;
+                payload.verification = BURN_PAYLOAD_VERIFICATION_HASH;
+
+                // A writable source could change the layout after verification, so it is copied.
+                hr = CacheLayoutPayload(&payload, sczLayoutFolder, sczWritablePath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                NativeAssert::Succeeded(hr, "Failed to layout writable payload.");
+                Assert::Equal<DWORD>(1, GetLinkCount(sczLayoutPath));
+                Assert::Equal<DWORD>(1, GetLinkCount(sczWritablePath));
+
+                // A read-only source replaces the copy with a link.
+                hr = CacheLayoutPayload(&payload, sczLayoutFolder, sczReadOnlyPath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                NativeAssert::Succeeded(hr, "Failed to layout read-only payload.");
+                Assert::Equal<DWORD>(2, GetLinkCount(sczLayoutPath));
+                Assert::Equal<DWORD>(FILE_ATTRIBUTE_READONLY, ::GetFileAttributesW(sczReadOnlyPath) & FILE_ATTRIBUTE_READONLY);
+
+                // A source that fails verification is never linked or copied.
+                payload.qwFileSize = 26;
+
+                hr = CacheLayoutPayload(&payload, sczFolder, sczReadOnlyPath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::True(FAILED(hr));
+                Assert::Equal<DWORD>(2, GetLinkCount(sczReadOnlyPath));
+            }
+            finally
+            {
+                if (sczFolder)
+                {
+                    DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                ReleaseMem(pb);
+                ReleaseStr(sczLayoutPath);
+                ReleaseStr(sczLayoutFolder);
+                ReleaseStr(sczWritablePath);
+                ReleaseStr(sczReadOnlyPath);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczTempFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczTestFile);
+            }
+        }
+
+        [Fact]
+        void CacheContentStoreLinksAndRemovesSharedContentTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_PAYLOAD payload = { };
+            LPWSTR sczTestFile = NULL;
+            LPWSTR sczFolderA = NULL;
+            LPWSTR sczFolderB = NULL;
+            LPWSTR sczCachedPathA = NULL;
+            LPWSTR sczCachedPathB = NULL;
+            LPWSTR sczContentPath = NULL;
+            BYTE* pb = NULL;
+            DWORD cb = NULL;
+            HANDLE hFile = INVALID_HANDLE_VALUE;
+            BYTE rgbCorrupt[27] = { };
+            CACHE_TEST_CONTEXT context = { };
+            String^ contentPath = nullptr;
+
+            try
+            {
+                // Enable the content store through a redirected policy key.
+                RegFunctionOverride(NULL, CacheTest_RegOpenKeyExW, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                Registry::CurrentUser->CreateSubKey(gcnew String(POLICY_PATH))->SetValue(gcnew String(L"ContentStore"), 1, RegistryValueKind::DWord);
+                CacheUninitialize();
+
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest\\CacheSignatureTest.File", &sczTestFile);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file.");
+
+                hr = StrAllocHexDecode(L"25e61cd83485062b70713aebddd3fe4992826cb121466fddc8de3eacb1e42f39d4bdd8455d95eec8c9529ced4c0296ab861931fe2c86df2f2b4e8d259a6d9223", &pb, &cb);
+                Assert::Equal(S_OK, hr);
+
+                payload.sczKey = L"CacheSignatureTest.PayloadKey";
+                payload.sczFilePath = L"CacheSignatureTest.File";
+                payload.pbHash = pb;
+                payload.cbHash = cb;
+                payload.qwFileSize = 27;
+                payload.verification = BURN_PAYLOAD_VERIFICATION_HASH;
+
+                hr = CacheGetCompletedPath(FALSE, L"Bootstrapper.CacheTest.ContentStoreA", &sczFolderA);
+                NativeAssert::Succeeded(hr, "Failed to get completed folder for package A.");
+
+                hr = CacheGetCompletedPath(FALSE, L"Bootstrapper.CacheTest.ContentStoreB", &sczFolderB);
+                NativeAssert::Succeeded(hr, "Failed to get completed folder for package B.");
+
+                hr = PathConcat(sczFolderA, payload.sczFilePath, &sczCachedPathA);
+                NativeAssert::Succeeded(hr, "Failed to get cached path for package A.");
+
+                hr = PathConcat(sczFolderB, payload.sczFilePath, &sczCachedPathB);
+                NativeAssert::Succeeded(hr, "Failed to get cached path for package B.");
+
+                contentPath = Path::Combine(Environment::GetFolderPath(Environment::SpecialFolder::LocalApplicationData), "Package Cache\\.content\\25e61cd83485062b70713aebddd3fe4992826cb121466fddc8de3eacb1e42f39d4bdd8455d95eec8c9529ced4c0296ab861931fe2c86df2f2b4e8d259a6d9223");
+                pin_ptr<const wchar_t> wzContentPath = PtrToStringChars(contentPath);
+                hr = StrAllocString(&sczContentPath, wzContentPath, 0);
+                NativeAssert::Succeeded(hr, "Failed to copy content path.");
+
+                // Caching the payload for package A adds it to the store.
+                hr = CacheCompletePayload(FALSE, &payload, L"Bootstrapper.CacheTest.ContentStoreA", sczTestFile, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                NativeAssert::Succeeded(hr, "Failed to cache payload for package A.");
+                Assert::Equal<DWORD>(2, GetLinkCount(sczContentPath));
+
+                // Package B links the same content without acquiring it.
+                hr = CacheVerifyPayload(&payload, sczFolderB, TRUE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                NativeAssert::Succeeded(hr, "Failed to link payload for package B.");
+                Assert::Equal<DWORD>(3, GetLinkCount(sczCachedPathB));
+
+                // The content stays while package B still references it.
+                hr = CacheRemovePackage(FALSE, L"PackageA", L"Bootstrapper.CacheTest.ContentStoreA");
+                NativeAssert::Succeeded(hr, "Failed to remove package A.");
+                Assert::False(FileExistsEx(sczCachedPathA, NULL));
+                Assert::Equal<DWORD>(2, GetLinkCount(sczContentPath));
+
+                hr = CacheRemovePackage(FALSE, L"PackageB", L"Bootstrapper.CacheTest.ContentStoreB");
+                NativeAssert::Succeeded(hr, "Failed to remove package B.");
+                Assert::False(FileExistsEx(sczContentPath, NULL));
+
+                // Content that no longer matches its hash is deleted instead of linked.
+                hr = CacheCompletePayload(FALSE, &payload, L"Bootstrapper.CacheTest.ContentStoreA", sczTestFile, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                NativeAssert::Succeeded(hr, "Failed to cache payload for package A again.");
+
+                Assert::True(::SetFileAttributesW(sczContentPath, FILE_ATTRIBUTE_NORMAL));
+                hFile = ::CreateFileW(sczContentPath, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                Assert::True(INVALID_HANDLE_VALUE != hFile);
+
+                hr = FileWriteHandle(hFile, rgbCorrupt, sizeof(rgbCorrupt));
+                NativeAssert::Succeeded(hr, "Failed to corrupt content.");
+                ReleaseFileHandle(hFile);
+
+                hr = CacheVerifyPayload(&payload, sczFolderB, TRUE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::True(FAILED(hr));
+                Assert::False(FileExistsEx(sczCachedPathB, NULL));
+                Assert::False(FileExistsEx(sczContentPath, NULL));
+            }
+            finally
+            {
+                ReleaseFileHandle(hFile);
+
+                if (sczFolderA)
+                {
+                    DirEnsureDeleteEx(sczFolderA, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                if (sczFolderB)
+                {
+                    DirEnsureDeleteEx(sczFolderB, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                if (contentPath && File::Exists(contentPath))
+                {
+                    File::SetAttributes(contentPath, FileAttributes::Normal);
+                    File::Delete(contentPath);
+                }
+
+                RegFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                Registry::CurrentUser->DeleteSubKeyTree(gcnew String(ROOT_PATH), false);
+                CacheUninitialize();
+
+                ReleaseMem(pb);
+                ReleaseStr(sczContentPath);
+                ReleaseStr(sczCachedPathB);
+                ReleaseStr(sczCachedPathA);
+                ReleaseStr(sczFolderB);
+                ReleaseStr(sczFolderA);
+                ReleaseStr(sczTestFile);
+            }
+        }
+
+        [Fact]
+        void CacheProbeLocalSourcePathsTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczTestFile = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczTempFolder = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczSourceRoot = NULL;
+            LPWSTR sczPreferredRoot = NULL;
+            LPWSTR rgsczPaths[5] = { };
+            LPCWSTR rgwzRelativePaths[] = { L"dest\\a.file", L"missing\\a.file", L"src\\a.file", L"src2\\a.file", L"other\\a.file" };
+            DWORD dwChosen = 0;
+            BOOL fFound = FALSE;
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest\\CacheSignatureTest.File", &sczTestFile);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file.");
+
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = PathExpand(&sczTempFolder, L"%TEMP%", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::Succeeded(hr, "Failed to get temp folder.");
+
+                hr = PathConcat(sczTempFolder, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to get test folder.");
+
+                for (DWORD i = 0; i < countof(rgsczPaths); ++i)
+                {
+                    hr = PathConcat(sczFolder, rgwzRelativePaths[i], rgsczPaths + i);
+                    NativeAssert::Succeeded(hr, "Failed to get source path.");
+                }
+
+                // Only src, src2 and other hold the payload; the destination is empty.
+                for (DWORD i = 2; i < countof(rgsczPaths); ++i)
+                {
+                    hr = FileEnsureCopy(sczTestFile, rgsczPaths[i], TRUE);
+                    NativeAssert::Succeeded(hr, "Failed to copy source.");
+                }
+
+                // The first valid candidate in authored order wins.
+                hr = CacheProbeLocalSourcePaths(rgsczPaths, countof(rgsczPaths), 0, NULL, 27, FALSE, &dwChosen, &fFound);
+                NativeAssert::Succeeded(hr, "Failed to probe source paths.");
+                Assert::True(fFound);
+                Assert::Equal<DWORD>(2, dwChosen);
+
+                // A candidate with the wrong size is never chosen.
+                hr = CacheProbeLocalSourcePaths(rgsczPaths, countof(rgsczPaths), 0, NULL, 26, FALSE, &dwChosen, &fFound);
+                NativeAssert::Succeeded(hr, "Failed to probe source paths with wrong size.");
+                Assert::False(fFound);
+
+                // The source root of the last hit is probed first, but only on a separator boundary.
+                hr = CacheGetSourceRoot(rgsczPaths[4], L"a.file", L"other\\a.file", &sczSourceRoot);
+                Assert::Equal(S_OK, hr);
+
+                hr = PathConcat(sczFolder, L"other\\", &sczPreferredRoot);
+                NativeAssert::Succeeded(hr, "Failed to get preferred root.");
+                NativeAssert::StringEqual(sczPreferredRoot, sczSourceRoot);
+
+                hr = CacheProbeLocalSourcePaths(rgsczPaths, countof(rgsczPaths), 0, sczSourceRoot, 27, FALSE, &dwChosen, &fFound);
+                NativeAssert::Succeeded(hr, "Failed to probe source paths with preferred root.");
+                Assert::True(fFound);
+                Assert::Equal<DWORD>(4, dwChosen);
+
+                hr = PathConcat(sczFolder, L"src", &sczPreferredRoot);
+                NativeAssert::Succeeded(hr, "Failed to get preferred root without separator.");
+
+                LPWSTR rgsczReordered[] = { rgsczPaths[1], rgsczPaths[4], rgsczPaths[3], rgsczPaths[2] };
+                hr = CacheProbeLocalSourcePaths(rgsczReordered, countof(rgsczReordered), 0, sczPreferredRoot, 27, FALSE, &dwChosen, &fFound);
+                NativeAssert::Succeeded(hr, "Failed to probe source paths with root without separator.");
+                Assert::True(fFound);
+                Assert::Equal<DWORD>(3, dwChosen);
+
+                // A suffix that does not start a path segment is not a source root.
+                hr = CacheGetSourceRoot(rgsczPaths[3], L"2\\a.file", L"2\\a.file", &sczSourceRoot);
+                Assert::Equal(S_FALSE, hr);
+            }
+            finally
+            {
+                if (sczFolder)
+                {
+                    DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                for (DWORD i = 0; i < countof(rgsczPaths); ++i)
+                {
+                    ReleaseStr(rgsczPaths[i]);
+                }
+
+                ReleaseStr(sczPreferredRoot);
+                ReleaseStr(sczSourceRoot);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczTempFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczTestFile);
+            }
+        }
+
+    private:
+        DWORD GetLinkCount(
+            __in_z LPCWSTR wzPath
+            )
+        {
+            HRESULT hr = S_OK;
+            HANDLE hFile = INVALID_HANDLE_VALUE;
+            BY_HANDLE_FILE_INFORMATION info = { };
+
+            try
+            {
+                hFile = ::CreateFileW(wzPath, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (INVALID_HANDLE_VALUE == hFile || !::GetFileInformationByHandle(hFile, &info))
+                {
+                    hr = HRESULT_FROM_WIN32(::GetLastError());
+                    NativeAssert::Succeeded(hr, "Failed to get file information: {0}", wzPath);
+                }
+            }
+            finally
+            {
+                ReleaseFileHandle(hFile);
+            }
+
+            return info.nNumberOfLinks;
+        }
     };
 }
 }
@@ -119,3 +487,33 @@ static DWORD CALLBACK CacheTestProgressRoutine(
 {
     return PROGRESS_QUIET;
 }
+
+static LSTATUS APIENTRY CacheTest_RegOpenKeyExW(
+    __in HKEY hKey,
+    __in_opt LPCWSTR lpSubKey,
+    __reserved DWORD ulOptions,
+    __in REGSAM samDesired,
+    __out PHKEY phkResult
+    )
+{
+    LSTATUS ls = ERROR_SUCCESS;
+    HKEY hkRoot = NULL;
+
+    if (HKEY_LOCAL_MACHINE == hKey)
+    {
+        ls = ::RegOpenKeyExW(HKEY_CURRENT_USER, HKLM_PATH, 0, KEY_READ, &hkRoot);
+        if (ERROR_SUCCESS != ls)
+        {
+            ExitFunction();
+        }
+
+        hKey = hkRoot;
+    }
+
+    ls = ::RegOpenKeyExW(hKey, lpSubKey, ulOptions, samDesired, phkResult);
+
+LExit:
+    ReleaseRegKey(hkRoot);
+
+    return ls;
+}
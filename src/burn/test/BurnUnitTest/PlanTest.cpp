@@ -155,7 +155,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(4ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(7ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(7868433ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -258,7 +258,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(3ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(3ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(3151581ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             ValidateCleanAction(pPlan, dwIndex++, L"PackageC");
@@ -349,7 +349,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(1ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(2ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(2267818ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -420,7 +420,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(0ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(1ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(1217291ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -504,7 +504,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(2ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(3ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(3316394ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -563,7 +563,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(0ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(0ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(0ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             ValidateCleanAction(pPlan, dwIndex++, L"PackageA");
@@ -635,7 +635,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(1ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(1ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(1050527ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             ValidateCleanAction(pPlan, dwIndex++, L"PackageA");
@@ -700,7 +700,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(0ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(0ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(0ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -809,7 +809,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(2ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(5ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(11396055ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             Assert::Equal(dwIndex, pPlan->cCleanActions);
@@ -897,7 +897,7 @@ namespace Bootstrapper
             Assert::Equal(dwIndex, pPlan->cRollbackActions);
 
             Assert::Equal(2ul, pPlan->cExecutePackagesTotal);
-            Assert::Equal(2ul, pPlan->cOverallProgressTicksTotal);
+            Assert::Equal(2119735ull, pPlan->qwOverallProgressWeightTotal);
 
             dwIndex = 0;
             ValidateCleanAction(pPlan, dwIndex++, L"PatchA");
@@ -0,0 +1,341 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+
+static HRESULT WINAPI ProfilerTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults,
+    __in_opt LPVOID pvContext
+    );
+
+using namespace System;
+using namespace Xunit;
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    public ref class ProfilerTest : BurnUnitTest
+    {
+    public:
+        ProfilerTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void ProfilerWritesPlanSpansToTrace()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_ENGINE_STATE* pEngineState = &engineState;
+            DWORD cBAMessages = 0;
+            LPWSTR sczTrace = NULL;
+            LPWSTR sczKey = NULL;
+            LPWSTR sczValue = NULL;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            DWORD dwDepth = 0;
+            DWORD cEvents = 0;
+            DWORD cPlanEvents = 0;
+            DWORD cBAEvents = 0;
+            BOOL fPlanEvent = FALSE;
+            BOOL fBAEvent = FALSE;
+            BOOL fMessage = FALSE;
+            LONGLONG llPlanStart = -1;
+            LONGLONG llPlanEnd = -1;
+            LONGLONG llStart = -1;
+            LONGLONG llDuration = -1;
+            LONGLONG llBAStart = MAXLONGLONG;
+            LONGLONG llBAEnd = 0;
+
+            ProfilerInitialize();
+
+            try
+            {
+                pin_ptr<const WCHAR> wzTracePath = PtrToStringChars(System::IO::Path::Combine(this->TestContext->TestDirectory, gcnew String(L"ProfilerTest.trace.json")));
+
+                InitializeEngineState(L"BasicFunctionality_BundleA_manifest.xml", pEngineState, &cBAMessages);
+
+                hr = ProfilerStart();
+                TestThrowOnFailure(hr, L"Failed to start profiler.");
+
+                Assert::True(ProfilerIsEnabled());
+
+                hr = CorePlan(pEngineState, BOOTSTRAPPER_ACTION_INSTALL);
+                TestThrowOnFailure(hr, L"CorePlan failed.");
+
+                Assert::True(0 < cBAMessages);
+
+                hr = ProfilerWriteTrace(wzTracePath);
+                TestThrowOnFailure(hr, L"Failed to write profile trace.");
+
+                hr = FileToString(wzTracePath, &sczTrace, NULL);
+                TestThrowOnFailure(hr, L"Failed to read profile trace.");
+
+                hr = JsonInitializeReader(sczTrace, &reader);
+                TestThrowOnFailure(hr, L"Failed to initialize JSON reader.");
+
+                // Depth 1 is the document, 2 the traceEvents array, 3 an event and 4 its args.
+                for (;;)
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                    if (E_NOMOREITEMS == hr)
+                    {
+                        break;
+                    }
+                    TestThrowOnFailure(hr, L"Failed to read profile trace token.");
+
+                    switch (token)
+                    {
+                    case JSON_TOKEN_OBJECT_START: __fallthrough;
+                    case JSON_TOKEN_ARRAY_START:
+                        ++dwDepth;
+                        if (3 == dwDepth)
+                        {
+                            fPlanEvent = FALSE;
+                            fBAEvent = FALSE;
+                            fMessage = FALSE;
+                            llStart = -1;
+                            llDuration = -1;
+                        }
+                        break;
+
+                    case JSON_TOKEN_OBJECT_END:
+                        if (3 == dwDepth)
+                        {
+                            Assert::True(0 <= llStart);
+                            Assert::True(0 <= llDuration);
+
+                            ++cEvents;
+                            if (fPlanEvent)
+                            {
+                                ++cPlanEvents;
+                                llPlanStart = llStart;
+                                llPlanEnd = llStart + llDuration;
+                            }
+                            else if (fBAEvent)
+                            {
+                                Assert::True(fMessage);
+
+                                ++cBAEvents;
+                                llBAStart = min(llBAStart, llStart);
+                                llBAEnd = max(llBAEnd, llStart + llDuration);
+                            }
+                        }
+                        __fallthrough;
+                    case JSON_TOKEN_ARRAY_END:
+                        --dwDepth;
+                        break;
+
+                    case JSON_TOKEN_OBJECT_KEY:
+                        hr = JsonUnescapeString(&value, &sczKey);
+                        TestThrowOnFailure(hr, L"Failed to read profile trace key.");
+
+                        if (1 == dwDepth)
+                        {
+                            Assert::True(CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"traceEvents", -1) || CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"displayTimeUnit", -1));
+                        }
+                        break;
+
+                    case JSON_TOKEN_VALUE:
+                        if (JSON_VALUE_TYPE_STRING == value.type)
+                        {
+                            hr = JsonUnescapeString(&value, &sczValue);
+                            TestThrowOnFailure(hr, L"Failed to read profile trace string.");
+                        }
+                        else
+                        {
+                            hr = StrAllocString(&sczValue, value.wzValue, value.cchValue);
+                            TestThrowOnFailure(hr, L"Failed to copy profile trace number.");
+                        }
+
+                        if (3 == dwDepth)
+                        {
+                            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"name", -1))
+                            {
+                                fPlanEvent = CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, L"Plan", -1);
+                                fBAEvent = CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, L"BAProc", -1);
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"cat", -1))
+                            {
+                                Assert::True(CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, BURN_PROFILER_CATEGORY_PLAN, -1) || CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, BURN_PROFILER_CATEGORY_BA, -1));
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"ph", -1))
+                            {
+                                NativeAssert::StringEqual(L"X", sczValue);
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"ts", -1))
+                            {
+                                llStart = _wtoi64(sczValue);
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"dur", -1))
+                            {
+                                llDuration = _wtoi64(sczValue);
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"pid", -1))
+                            {
+                                Assert::Equal<DWORD>(::GetCurrentProcessId(), static_cast<DWORD>(_wtoi64(sczValue)));
+                            }
+                            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"tid", -1))
+                            {
+                                Assert::Equal<DWORD>(::GetCurrentThreadId(), static_cast<DWORD>(_wtoi64(sczValue)));
+                            }
+                        }
+                        else if (4 == dwDepth && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczKey, -1, L"message", -1))
+                        {
+                            fMessage = TRUE;
+                        }
+                        break;
+                    }
+                }
+
+                Assert::Equal<DWORD>(0, dwDepth);
+                Assert::Equal<DWORD>(1, cPlanEvents);
+                Assert::Equal<DWORD>(cBAMessages, cBAEvents);
+                Assert::Equal<DWORD>(cPlanEvents + cBAEvents, cEvents);
+
+                // Every BA callback was made while the engine was planning.
+                Assert::True(llPlanStart <= llBAStart);
+                Assert::True(llBAEnd <= llPlanEnd);
+            }
+            finally
+            {
+                JsonUninitializeReader(&reader);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczKey);
+                ReleaseStr(sczTrace);
+                ProfilerUninitialize();
+            }
+        }
+
+        [Fact]
+        void ProfilerDropsSpansStillOpenWhenStopped()
+        {
+            HRESULT hr = S_OK;
+            BURN_PROFILER_SPAN span = { };
+            LPWSTR sczTrace = NULL;
+
+            ProfilerInitialize();
+
+            try
+            {
+                pin_ptr<const WCHAR> wzTracePath = PtrToStringChars(System::IO::Path::Combine(this->TestContext->TestDirectory, gcnew String(L"ProfilerTestStopped.trace.json")));
+
+                hr = ProfilerStart();
+                TestThrowOnFailure(hr, L"Failed to start profiler.");
+
+                ProfilerBeginSpan(&span, BURN_PROFILER_CATEGORY_EXECUTE, L"Apply", NULL);
+
+                ProfilerStop();
+                Assert::False(ProfilerIsEnabled());
+
+                hr = ProfilerStart();
+                TestThrowOnFailure(hr, L"Failed to restart profiler.");
+
+                // The span began before the restart, so it belongs to no trace.
+                ProfilerEndSpan(&span);
+
+                hr = ProfilerWriteTrace(wzTracePath);
+                TestThrowOnFailure(hr, L"Failed to write profile trace.");
+
+                hr = FileToString(wzTracePath, &sczTrace, NULL);
+                TestThrowOnFailure(hr, L"Failed to read profile trace.");
+
+                Assert::True(NULL == wcsstr(sczTrace, L"Apply"));
+            }
+            finally
+            {
+                ReleaseStr(sczTrace);
+                ProfilerUninitialize();
+            }
+        }
+
+    private:
+        // This doesn't initialize everything, just enough for CorePlan to run with a BA loaded.
+        void InitializeEngineState(LPCWSTR wzManifestFileName, BURN_ENGINE_STATE* pEngineState, DWORD* pcBAMessages)
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczFilePath = NULL;
+            BURN_REGISTRATION* pRegistration = &pEngineState->registration;
+
+            ::InitializeCriticalSection(&pEngineState->userExperience.csEngineActive);
+
+            hr = VariableInitialize(&pEngineState->variables);
+            NativeAssert::Succeeded(hr, "Failed to initialize variables.");
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\PlanTest", &sczFilePath);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file directory.");
+                hr = PathConcat(sczFilePath, wzManifestFileName, &sczFilePath);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file.");
+                Assert::True(FileExistsEx(sczFilePath, NULL), "Test file does not exist.");
+
+                hr = ManifestLoadXmlFromFile(sczFilePath, pEngineState);
+                NativeAssert::Succeeded(hr, "Failed to load manifest.");
+            }
+            finally
+            {
+                ReleaseStr(sczFilePath);
+            }
+
+            hr = CoreInitializeConstants(pEngineState);
+            NativeAssert::Succeeded(hr, "Failed to initialize core constants");
+
+            // Messages are only sent while a BA module is loaded, so stand in the test module for it.
+            pEngineState->userExperience.hUXModule = ::GetModuleHandleW(NULL);
+            pEngineState->userExperience.pfnBAProc = ProfilerTestBAProc;
+            pEngineState->userExperience.pvBAProcContext = pcBAMessages;
+
+            DetectReset(pRegistration, &pEngineState->packages);
+            PlanReset(&pEngineState->plan, &pEngineState->containers, &pEngineState->packages, &pEngineState->layoutPayloads);
+
+            hr = DepDependencyArrayAlloc(&pRegistration->rgIgnoredDependencies, &pRegistration->cIgnoredDependencies, pRegistration->sczProviderKey, NULL);
+            NativeAssert::Succeeded(hr, "Failed to add the bundle provider key to the list of dependencies to ignore.");
+
+            for (DWORD i = 0; i < pEngineState->packages.cPackages; ++i)
+            {
+                BURN_PACKAGE* pPackage = pEngineState->packages.rgPackages + i;
+
+                pPackage->currentState = BOOTSTRAPPER_PACKAGE_STATE_ABSENT;
+                if (pPackage->fCanAffectRegistration)
+                {
+                    pPackage->cacheRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_ABSENT;
+                    pPackage->installRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_ABSENT;
+                }
+            }
+
+            pEngineState->userExperience.fEngineActive = TRUE;
+            pEngineState->fDetected = TRUE;
+        }
+    };
+}
+}
+}
+}
+}
+
+
+static HRESULT WINAPI ProfilerTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE /*message*/,
+    __in const LPVOID /*pvArgs*/,
+    __inout LPVOID /*pvResults*/,
+    __in_opt LPVOID pvContext
+    )
+{
+    DWORD* pcBAMessages = reinterpret_cast<DWORD*>(pvContext);
+
+    ++*pcBAMessages;
+
+    return S_OK;
+}
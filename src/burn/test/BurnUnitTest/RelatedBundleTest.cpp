@@ -0,0 +1,223 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+
+#define ROOT_PATH L"SOFTWARE\\WiX_Burn_UnitTest"
+#define HKCU_PATH L"SOFTWARE\\WiX_Burn_UnitTest\\HKCU"
+#define REGISTRY_UNINSTALL_KEY L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Uninstall"
+
+#define TEST_BUNDLE_ID L"{D54F896D-1952-43e6-9C67-B5652240618C}"
+#define TEST_UPGRADE_CODE L"{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}"
+#define TEST_UNINSTALL_KEY_ROOT L"HKEY_CURRENT_USER\\" HKCU_PATH L"\\" REGISTRY_UNINSTALL_KEY L"\\"
+#define RELATED_BUNDLE_ID L"{AD75FE35-C3E1-4A36-A7A1-E2E9D4F0BA8F}"
+#define UNRELATED_BUNDLE_ID L"{6C4DF4B4-4E79-4D5C-9C0B-2A6A6F2B8A51}"
+
+
+static LSTATUS APIENTRY RelatedBundleTest_RegCreateKeyExW(
+    __in HKEY hKey,
+    __in LPCWSTR lpSubKey,
+    __reserved DWORD Reserved,
+    __in_opt LPWSTR lpClass,
+    __in DWORD dwOptions,
+    __in REGSAM samDesired,
+    __in_opt CONST LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+    __out PHKEY phkResult,
+    __out_opt LPDWORD lpdwDisposition
+    );
+static LSTATUS APIENTRY RelatedBundleTest_RegOpenKeyExW(
+    __in HKEY hKey,
+    __in_opt LPCWSTR lpSubKey,
+    __reserved DWORD ulOptions,
+    __in REGSAM samDesired,
+    __out PHKEY phkResult
+    );
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace Microsoft::Win32;
+    using namespace System;
+    using namespace System::IO;
+    using namespace Xunit;
+
+    public ref class RelatedBundleTest : BurnUnitTest
+    {
+    public:
+        RelatedBundleTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void RelatedBundleIndexTracksChangedSubkeysTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_REGISTRATION registration = { };
+            LPWSTR sczIndexFolder = NULL;
+            String^ indexFolder = nullptr;
+            String^ indexBackupFolder = nullptr;
+
+            try
+            {
+                RegFunctionOverride(RelatedBundleTest_RegCreateKeyExW, RelatedBundleTest_RegOpenKeyExW, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+                // The per-user index is shared with real bundles, so set it aside while the test runs.
+                hr = CacheGetCompletedPath(FALSE, L".related", &sczIndexFolder);
+                NativeAssert::Succeeded(hr, "Failed to get related bundle index folder.");
+
+                indexFolder = Path::GetDirectoryName(gcnew String(sczIndexFolder));
+                indexBackupFolder = indexFolder + L".test";
+                if (Directory::Exists(indexFolder))
+                {
+                    Directory::Move(indexFolder, indexBackupFolder);
+                }
+
+                hr = StrAllocString(&registration.sczId, TEST_BUNDLE_ID, 0);
+                NativeAssert::Succeeded(hr, "Failed to copy bundle id.");
+
+                hr = StrArrayAllocString(&registration.rgsczUpgradeCodes, reinterpret_cast<UINT*>(&registration.cUpgradeCodes), TEST_UPGRADE_CODE, 0);
+                NativeAssert::Succeeded(hr, "Failed to copy upgrade code.");
+
+                Registry::CurrentUser->CreateSubKey(gcnew String(HKCU_PATH));
+                WriteBundleRegistration(RELATED_BUNDLE_ID, TEST_UPGRADE_CODE);
+                WriteBundleRegistration(UNRELATED_BUNDLE_ID, L"{3D0C4B70-4A0C-4D9A-9E4B-6B2E2C8D1F11}");
+
+                // Let the new keys settle so the index is trusted for them.
+                ::Sleep(2500);
+
+                DetectRelatedBundles(&registration);
+                Assert::Equal(1lu, registration.relatedBundles.cRelatedBundles);
+                NativeAssert::StringEqual(RELATED_BUNDLE_ID, registration.relatedBundles.rgRelatedBundles[0].package.sczId);
+                Assert::Equal((int)BOOTSTRAPPER_RELATION_UPGRADE, (int)registration.relatedBundles.rgRelatedBundles[0].relationType);
+                Assert::True(Directory::Exists(indexFolder));
+
+                // Rewriting a value in place doesn't touch the Uninstall key itself, only the bundle's subkey.
+                Registry::SetValue(gcnew String(TEST_UNINSTALL_KEY_ROOT UNRELATED_BUNDLE_ID), gcnew String(L"BundleUpgradeCode"), gcnew array<String^>{ gcnew String(TEST_UPGRADE_CODE) });
+
+                DetectRelatedBundles(&registration);
+                Assert::Equal(2lu, registration.relatedBundles.cRelatedBundles);
+
+                Registry::CurrentUser->DeleteSubKeyTree(gcnew String(HKCU_PATH L"\\" REGISTRY_UNINSTALL_KEY L"\\" RELATED_BUNDLE_ID));
+
+                DetectRelatedBundles(&registration);
+                Assert::Equal(1lu, registration.relatedBundles.cRelatedBundles);
+                NativeAssert::StringEqual(UNRELATED_BUNDLE_ID, registration.relatedBundles.rgRelatedBundles[0].package.sczId);
+            }
+            finally
+            {
+                ReleaseStr(sczIndexFolder);
+                RegistrationUninitialize(&registration);
+
+                Registry::CurrentUser->DeleteSubKeyTree(gcnew String(ROOT_PATH), false);
+
+                if (indexFolder && Directory::Exists(indexFolder))
+                {
+                    Directory::Delete(indexFolder, true);
+                }
+
+                if (indexBackupFolder && Directory::Exists(indexBackupFolder))
+                {
+                    Directory::Move(indexBackupFolder, indexFolder);
+                }
+
+                RegFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+            }
+        }
+
+    private:
+        void WriteBundleRegistration(LPCWSTR wzBundleId, LPCWSTR wzUpgradeCode)
+        {
+            String^ key = gcnew String(TEST_UNINSTALL_KEY_ROOT) + gcnew String(wzBundleId);
+
+            Registry::SetValue(key, gcnew String(L"BundleVersion"), gcnew String(L"1.0.0.0"));
+            Registry::SetValue(key, gcnew String(L"BundleCachePath"), Path::Combine(Path::GetTempPath(), gcnew String(wzBundleId) + L".exe"));
+            Registry::SetValue(key, gcnew String(L"BundleUpgradeCode"), gcnew array<String^>{ gcnew String(wzUpgradeCode) });
+        }
+
+        void DetectRelatedBundles(BURN_REGISTRATION* pRegistration)
+        {
+            HRESULT hr = S_OK;
+
+            RelatedBundlesUninitialize(&pRegistration->relatedBundles);
+
+            hr = RelatedBundlesInitializeForScope(FALSE, pRegistration, &pRegistration->relatedBundles);
+            NativeAssert::Succeeded(hr, "Failed to initialize per-user related bundles.");
+        }
+    };
+}
+}
+}
+}
+}
+
+
+static LSTATUS APIENTRY RelatedBundleTest_RegCreateKeyExW(
+    __in HKEY hKey,
+    __in LPCWSTR lpSubKey,
+    __reserved DWORD Reserved,
+    __in_opt LPWSTR lpClass,
+    __in DWORD dwOptions,
+    __in REGSAM samDesired,
+    __in_opt CONST LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+    __out PHKEY phkResult,
+    __out_opt LPDWORD lpdwDisposition
+    )
+{
+    LSTATUS ls = ERROR_SUCCESS;
+    HKEY hkRoot = NULL;
+
+    if (HKEY_CURRENT_USER == hKey)
+    {
+        ls = ::RegOpenKeyExW(HKEY_CURRENT_USER, HKCU_PATH, 0, KEY_WRITE, &hkRoot);
+        if (ERROR_SUCCESS != ls)
+        {
+            ExitFunction();
+        }
+
+        hKey = hkRoot;
+    }
+
+    ls = ::RegCreateKeyExW(hKey, lpSubKey, Reserved, lpClass, dwOptions, samDesired, lpSecurityAttributes, phkResult, lpdwDisposition);
+
+LExit:
+    ReleaseRegKey(hkRoot);
+
+    return ls;
+}
+
+static LSTATUS APIENTRY RelatedBundleTest_RegOpenKeyExW(
+    __in HKEY hKey,
+    __in_opt LPCWSTR lpSubKey,
+    __reserved DWORD ulOptions,
+    __in REGSAM samDesired,
+    __out PHKEY phkResult
+    )
+{
+    LSTATUS ls = ERROR_SUCCESS;
+    HKEY hkRoot = NULL;
+
+    if (HKEY_CURRENT_USER == hKey)
+    {
+        ls = ::RegOpenKeyExW(HKEY_CURRENT_USER, HKCU_PATH, 0, KEY_READ, &hkRoot);
+        if (ERROR_SUCCESS != ls)
+        {
+            ExitFunction();
+        }
+
+        hKey = hkRoot;
+    }
+
+    ls = ::RegOpenKeyExW(hKey, lpSubKey, ulOptions, samDesired, phkResult);
+
+LExit:
+    ReleaseRegKey(hkRoot);
+
+    return ls;
+}
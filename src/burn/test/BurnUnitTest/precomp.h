@@ -19,6 +19,7 @@
 #include <buffutil.h>
 #include <dirutil.h>
 #include <fileutil.h>
+#include <guidutil.h>
 #include <logutil.h>
 #include <memutil.h>
 #include <pathutil.h>
@@ -30,6 +31,7 @@
 #include <xmlutil.h>
 #include <dictutil.h>
 #include <deputil.h>
+#include <jsonutil.h>
 
 #include "BootstrapperEngine.h"
 #include "BootstrapperApplication.h"
@@ -37,6 +39,7 @@
 #include "BundleExtension.h"
 
 #include "platform.h"
+#include "profiler.h"
 #include "variant.h"
 #include "variable.h"
 #include "condition.h"
@@ -52,6 +55,7 @@
 #include "update.h"
 #include "pseudobundle.h"
 #include "registration.h"
+#include "relatedbundle.h"
 #include "plan.h"
 #include "pipe.h"
 #include "logging.h"
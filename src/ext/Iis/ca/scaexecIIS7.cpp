@@ -4,23 +4,59 @@
 
 #include "precomp.h"
 
+// In-memory index of the site, application and virtual directory elements so each
+// change does not search the config collections again. Applications and virtual
+// directories are keyed by their parent's key and their path separated by a tab.
+// MIME map and handler blocks index the one collection they change the same way.
+struct IIS7_INDEXED_ELEMENT
+{
+    LPWSTR sczKey;
+    IAppHostElement *pElement; // NULL once the element has been deleted.
+    BOOL fChildrenIndexed;
+};
+
+struct IIS7_ELEMENT_INDEX
+{
+    STRINGDICT_HANDLE sdElements;
+    IIS7_INDEXED_ELEMENT *rgElements;
+    DWORD cElements;
+};
+
+struct IIS7_CONFIG_INDEX
+{
+    BOOL fSitesIndexed;
+    IIS7_ELEMENT_INDEX sites;
+    IIS7_ELEMENT_INDEX applications;
+    IIS7_ELEMENT_INDEX vdirs;
+};
+
+static HRESULT CreateAdminManager(
+    __out IAppHostWritableAdminManager **ppAdminMgr
+    );
+
+static PFN_IIS7CREATEADMINMANAGER vpfnCreateAdminManager = CreateAdminManager;
+
 //local CAData action functions
 HRESULT IIS7Site(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 
 HRESULT IIS7Application(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 HRESULT IIS7VDir(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 HRESULT IIS7Binding(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 HRESULT IIS7AppPool(
     __inout  LPWSTR *ppwzCustomActionData,
@@ -40,7 +76,8 @@ HRESULT IIS7DirProperties(
     );
 HRESULT IIS7WebLog(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 HRESULT IIS7FilterGlobal(
     __inout  LPWSTR *ppwzCustomActionData,
@@ -76,7 +113,8 @@ HRESULT IIS7AspProperty(
     );
 HRESULT IIS7SslBinding(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     );
 //local helper functions
 
@@ -86,23 +124,53 @@ static HRESULT GetNextAvailableSiteId(
     );
 static HRESULT GetSiteElement(
     IAppHostWritableAdminManager *pAdminMgr,
+    IIS7_CONFIG_INDEX *pIndex,
     LPCWSTR swSiteName,
     IAppHostElement **pSiteElement,
     BOOL* fFound
     );
 static HRESULT GetApplicationElement(
     IAppHostElement *pSiteElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR swSiteName,
     LPCWSTR swAppPath,
     IAppHostElement **pAppElement,
     BOOL* fFound
     );
 static HRESULT GetApplicationElementForVDir(
     IAppHostElement *pSiteElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR swSiteName,
     LPCWSTR swVDirPath,
     IAppHostElement **ppAppElement,
+    LPWSTR *psczAppKey,
     LPCWSTR *ppwzVDirSubPath,
     BOOL* fFound
     );
+static HRESULT IndexAppHostElement(
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzKey,
+    IAppHostElement *pElement
+    );
+static HRESULT IndexAppHostChildren(
+    IIS7_ELEMENT_INDEX *pParentIndex,
+    LPCWSTR wzParentKey,
+    IAppHostElement *pParentElement,
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzElementName,
+    LPCWSTR wzKeyName
+    );
+static HRESULT FindIndexedAppHostElement(
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzKey,
+    IAppHostElement **ppElement
+    );
+static void ResetElementIndex(
+    IIS7_ELEMENT_INDEX *pIndex
+    );
+static void ResetConfigIndex(
+    IIS7_CONFIG_INDEX *pIndex
+    );
 
 static HRESULT CreateApplication(
     IAppHostElement *pSiteElement,
@@ -120,11 +188,15 @@ static HRESULT SetAppPool(
     );
 static HRESULT CreateVdir(
     IAppHostElement *pAppElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR wzAppKey,
     LPCWSTR pwzVDirPath,
     LPCWSTR pwzVDirPhyDir
     );
 static HRESULT DeleteVdir(
     IAppHostElement *pAppElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR wzAppKey,
     LPCWSTR pwzVDirPath
     );
 
@@ -293,6 +365,19 @@ public:
 };
 
 
+/********************************************************************
+ IIS7FunctionOverride - overrides how the admin manager is created.
+   Pass NULL to go back to the AppHost admin manager.
+
+ *******************************************************************/
+void IIS7FunctionOverride(
+    __in_opt PFN_IIS7CREATEADMINMANAGER pfnCreateAdminManager
+    )
+{
+    vpfnCreateAdminManager = pfnCreateAdminManager ? pfnCreateAdminManager : CreateAdminManager;
+}
+
+
 /********************************************************************
  IIS7ConfigChanges - Start of IIS7 config changes
 
@@ -303,12 +388,14 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
     BOOL fInitializedCom = FALSE;
 
     IAppHostWritableAdminManager *pAdminMgr = NULL;
+    IIS7_CONFIG_INDEX index = { };
 
     LPWSTR pwz = NULL;
-    LPWSTR pwzLast = NULL;
     LPWSTR pwzBackup = NULL;
     DWORD cchData = lstrlenW(pwzData);
     int iAction = -1;
+    DWORD cChanges = 0;
+    DWORD dwCommitStart = 0;
 
     int iRetryCount = 0;
 
@@ -316,20 +403,65 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
     ExitOnFailure(hr, "Failed to initialize COM");
     fInitializedCom = TRUE;
 
-    pwz = pwzLast = pwzData;
+    pwz = pwzData;
 
     hr = StrAllocString(&pwzBackup, pwz, 0);
     ExitOnFailure(hr, "Failed to backup custom action data");
 
-    while (S_OK == (hr = WcaReadIntegerFromCaData(&pwz, &iAction)))
+    for (;;)
     {
+        hr = WcaReadIntegerFromCaData(&pwz, &iAction);
+        if (E_NOMOREITEMS == hr)
+        {
+            if (NULL == pAdminMgr)
+            {
+                hr = S_OK;
+                break;
+            }
+
+            // All of the changes were made in one admin manager so they are saved together,
+            // the Rollback or Commit defered CAs will determine final commit status.
+            dwCommitStart = ::GetTickCount();
+            hr = pAdminMgr->CommitChanges();
+
+            // Our transaction may have been interrupted.
+            if (hr == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION) || hr == HRESULT_FROM_WIN32(ERROR_TRANSACTIONAL_CONFLICT))
+            {
+                WcaLog(LOGMSG_VERBOSE, "Sharing violation or transactional conflict during attempt to save changes to applicationHost.config");
+                if (++iRetryCount > 30)
+                {
+                    if (IDRETRY == WcaErrorMessage(msierrIISFailedCommitInUse, hr, INSTALLMESSAGE_ERROR | MB_RETRYCANCEL, 0))
+                    {
+                        iRetryCount = 0;
+                    }
+                    else
+                    {
+                        ExitOnFailure(hr, "Failed to Commit IIS Config Changes, in silent mode or user has chosen to cancel");
+                    }
+                }
+
+                // Throw away the changes since IIS has no way to remove uncommited changes from an AdminManager.
+                ResetConfigIndex(&index);
+                ReleaseNullObject(pAdminMgr);
+
+                // Restore our CA data backup and apply every change again.
+                pwz = pwzData;
+                hr = ::StringCchCopyW(pwz, cchData + 1, pwzBackup);
+                ExitOnFailure(hr , "Failed to restore custom action data backup");
+
+                cChanges = 0;
+                continue;
+            }
+            ExitOnFailure(hr , "Failed to Commit IIS Config Changes");
+
+            WcaLog(LOGMSG_VERBOSE, "Committed %u IIS config changes in %u ms", cChanges, ::GetTickCount() - dwCommitStart);
+            break;
+        }
+        ExitOnFailure(hr, "Failed to read IIS config action");
+
         if (NULL == pAdminMgr)
         {
-            hr = ::CoCreateInstance( __uuidof(AppHostWritableAdminManager),
-                                    NULL,
-                                    CLSCTX_INPROC_SERVER,
-                                    __uuidof(IAppHostWritableAdminManager),
-                                    reinterpret_cast<void**> (&pAdminMgr));
+            hr = vpfnCreateAdminManager(&pAdminMgr);
             ExitOnFailure(hr , "Failed to open AppHostWritableAdminManager to configure IIS7");
         }
 
@@ -338,28 +470,28 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
         case IIS_SITE:
             {
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7Site(&pwz, pAdminMgr);
+                hr = IIS7Site(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS site.");
                 break;
             }
         case IIS_APPLICATION:
             {
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7Application(&pwz, pAdminMgr);
+                hr = IIS7Application(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS application.");
                 break;
             }
         case IIS_VDIR:
             {
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7VDir(&pwz, pAdminMgr);
+                hr = IIS7VDir(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS VDir.");
                 break;
             }
         case IIS_BINDING:
             {
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7Binding(&pwz, pAdminMgr);
+                hr = IIS7Binding(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS site binding.");
                 break;
             }
@@ -394,7 +526,7 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
         case IIS_WEBLOG:
             {
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7WebLog(&pwz, pAdminMgr);
+                hr = IIS7WebLog(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS WebLog.");
                 break;
             }
@@ -456,7 +588,7 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
             }
         case IIS_SSL_BINDING:
 #pragma prefast(suppress:26010, "This is a prefast issue - pAdminMgr is correctly allocated")
-                hr = IIS7SslBinding(&pwz, pAdminMgr);
+                hr = IIS7SslBinding(&pwz, pAdminMgr, &index);
                 ExitOnFailure(hr, "Failed to configure IIS SSL binding.");
                 break;
 
@@ -464,58 +596,12 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
             ExitOnFailure(hr = E_UNEXPECTED, "IIS7ConfigChanges: Unexpected IIS Config action specified: %d", iAction);
             break;
         }
-        if (S_OK == hr)
-        {
-            // commit config changes now to close out IIS Admin changes,
-            // the Rollback or Commit defered CAs will determine final commit status.
-            hr = pAdminMgr->CommitChanges();
 
-            // Our transaction may have been interrupted.
-            if (hr == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION) || hr == HRESULT_FROM_WIN32(ERROR_TRANSACTIONAL_CONFLICT))
-            {
-                WcaLog(LOGMSG_VERBOSE, "Sharing violation or transactional conflict during attempt to save changes to applicationHost.config");
-                if (++iRetryCount > 30)
-                {
-                    if (IDRETRY == WcaErrorMessage(msierrIISFailedCommitInUse, hr, INSTALLMESSAGE_ERROR | MB_RETRYCANCEL, 0))
-                    {
-                        iRetryCount = 0;
-                    }
-                    else
-                    {
-                        ExitOnFailure(hr, "Failed to Commit IIS Config Changes, in silent mode or user has chosen to cancel");
-                    }
-                }
-
-                // Throw away the changes since IIS has no way to remove uncommited changes from an AdminManager.
-                ReleaseNullObject(pAdminMgr);
-
-                // Restore our CA data backup
-                pwz = pwzLast;
-                hr = ::StringCchCopyW(pwz, cchData - (pwz - pwzData) + 1, pwzBackup);
-                ExitOnFailure(hr , "Failed to restore custom action data backup");
-
-            }
-            else if (FAILED(hr))
-            {
-                ExitOnFailure(hr , "Failed to Commit IIS Config Changes");
-            }
-            else
-            {
-                // store a backup of CA data @ the last place that we successfully commited changes unless we are done.
-                if(NULL != pwz)
-                {
-                    pwzLast = pwz;
-                    hr = StrAllocString(&pwzBackup, pwz, 0);
-                    ExitOnFailure(hr, "Failed to backup custom action data");
-                }
-            }
-        }
-    }
-    if (E_NOMOREITEMS == hr) // If there are no more items, all is well
-    {
-        hr = S_OK;
+        ++cChanges;
     }
+
 LExit:
+    ResetConfigIndex(&index);
     ReleaseObject(pAdminMgr);
     ReleaseStr(pwzBackup);
 
@@ -1808,7 +1894,8 @@ LExit:
 //-------------------------------------------------------------------------------------------------
 HRESULT IIS7Site(
     __inout LPWSTR *ppwzCustomActionData,
-    __in    IAppHostWritableAdminManager *pAdminMgr)
+    __in    IAppHostWritableAdminManager *pAdminMgr,
+    __in    IIS7_CONFIG_INDEX *pIndex)
 {
     HRESULT hr  = S_OK;
     int iAction = -1;
@@ -1830,7 +1917,7 @@ HRESULT IIS7Site(
     ExitOnFailure(hr, "Failed to read site key");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
     hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_SITES_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pSites);
@@ -1847,6 +1934,9 @@ HRESULT IIS7Site(
             {
                 hr = DeleteCollectionElement(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, pwzSiteName);
                 ExitOnFailure(hr, "Failed to delete website");
+
+                // the site's applications and vdirs went with it so start the index over
+                ResetConfigIndex(pIndex);
             }
             ExitFunction();
             break;
@@ -1859,6 +1949,9 @@ HRESULT IIS7Site(
                 hr = CreateSite(pCollection, pwzSiteName, &pSiteElem);
                 ExitOnFailure(hr, "Failed to create site");
 
+                hr = IndexAppHostElement(&pIndex->sites, pwzSiteName, pSiteElem);
+                ExitOnFailure(hr, "Failed to index site");
+
             }
         }
     }
@@ -1917,7 +2010,8 @@ LExit:
 
 HRESULT IIS7Application(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr)
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex)
 {
     HRESULT hr = S_OK;
 
@@ -1928,6 +2022,7 @@ HRESULT IIS7Application(
     LPWSTR pwzSiteName = NULL;
     LPWSTR pwzAppPath = NULL;
     LPWSTR pwzAppPool = NULL;
+    LPWSTR pwzAppKey = NULL;
     LPWSTR pwzLocationPath = NULL;
     IAppHostElement *pSiteElem = NULL;
     IAppHostElement *pAppElement = NULL;
@@ -1945,7 +2040,7 @@ HRESULT IIS7Application(
     ExitOnFailure(hr, "Failed to read app pool key");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fSiteFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fSiteFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
     switch (iAction)
@@ -1956,6 +2051,8 @@ HRESULT IIS7Application(
             {
                 //have site get application collection
                 hr = GetApplicationElement(pSiteElem,
+                                            pIndex,
+                                            pwzSiteName,
                                             pwzAppPath,
                                             &pAppElement,
                                             &fAppFound);
@@ -1966,6 +2063,12 @@ HRESULT IIS7Application(
                     //Create Application
                     hr = CreateApplication(pSiteElem, pwzAppPath, &pAppElement);
                     ExitOnFailure(hr, "Error creating application in config");
+
+                    hr = StrAllocFormatted(&pwzAppKey, L"%ls\t%ls", pwzSiteName, pwzAppPath);
+                    ExitOnFailure(hr, "failed to format application index key");
+
+                    hr = IndexAppHostElement(&pIndex->applications, pwzAppKey, pAppElement);
+                    ExitOnFailure(hr, "Error indexing application");
                 }
                 //Update application properties:
                 //
@@ -1986,6 +2089,8 @@ HRESULT IIS7Application(
             {
                 //have site get application collection
                 hr = GetApplicationElement( pSiteElem,
+                                            pIndex,
+                                            pwzSiteName,
                                             pwzAppPath,
                                             &pAppElement,
                                             &fAppFound);
@@ -1995,6 +2100,20 @@ HRESULT IIS7Application(
                     //delete Application
                     hr = DeleteApplication(pSiteElem, pwzAppPath);
                     ExitOnFailure(hr, "Error deleating application from config")
+
+                    hr = StrAllocFormatted(&pwzAppKey, L"%ls\t%ls", pwzSiteName, pwzAppPath);
+                    ExitOnFailure(hr, "failed to format application index key");
+
+                    // forget the application and, since its vdirs went with it, every indexed vdir
+                    hr = IndexAppHostElement(&pIndex->applications, pwzAppKey, NULL);
+                    ExitOnFailure(hr, "Error removing application from index");
+
+                    ResetElementIndex(&pIndex->vdirs);
+                    for (DWORD i = 0; i < pIndex->applications.cElements; ++i)
+                    {
+                        pIndex->applications.rgElements[i].fChildrenIndexed = FALSE;
+                    }
+
                     //Construct Location path
                     // TODO: it seems odd that these are just
                     // jammed together, need to determine if this requires a '\'
@@ -2019,6 +2138,7 @@ LExit:
     ReleaseStr(pwzSiteName);
     ReleaseStr(pwzAppPath);
     ReleaseStr(pwzAppPool);
+    ReleaseStr(pwzAppKey);
     ReleaseStr(pwzLocationPath);
     ReleaseObject(pSiteElem);
     ReleaseObject(pAppElement);
@@ -2033,7 +2153,8 @@ LExit:
 //-------------------------------------------------------------------------------------------------
 HRESULT IIS7VDir(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr)
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex)
 {
     HRESULT hr = S_OK;
 
@@ -2044,6 +2165,7 @@ HRESULT IIS7VDir(
     LPWSTR pwzSiteName = NULL;
     LPWSTR pwzVDirPath = NULL;
     LPWSTR pwzVDirPhyDir = NULL;
+    LPWSTR pwzAppKey = NULL;
     LPCWSTR pwzVDirSubPath = NULL;
 
     IAppHostElement *pSiteElem = NULL;
@@ -2065,7 +2187,7 @@ HRESULT IIS7VDir(
     ExitOnFailure(hr, "Failed to read VDirPath key");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fSiteFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fSiteFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
     if (IIS_CREATE == iAction)
@@ -2074,8 +2196,11 @@ HRESULT IIS7VDir(
         {
             //have site get application
             hr = GetApplicationElementForVDir( pSiteElem,
+                                               pIndex,
+                                               pwzSiteName,
                                                pwzVDirPath,
                                                &pAppElement,
+                                               &pwzAppKey,
                                                &pwzVDirSubPath,
                                                &fAppFound);
             ExitOnFailure(hr, "Error reading application element from config");
@@ -2089,7 +2214,7 @@ HRESULT IIS7VDir(
             //
             // create the virDir
             //
-            hr = CreateVdir(pAppElement, pwzVDirSubPath, pwzVDirPhyDir);
+            hr = CreateVdir(pAppElement, pIndex, pwzAppKey, pwzVDirSubPath, pwzVDirPhyDir);
             ExitOnFailure(hr, "Failed to create vdir for application");
         }
         else
@@ -2104,15 +2229,18 @@ HRESULT IIS7VDir(
         {
             //have site get application
             hr = GetApplicationElementForVDir( pSiteElem,
+                                               pIndex,
+                                               pwzSiteName,
                                                pwzVDirPath,
                                                &pAppElement,
+                                               &pwzAppKey,
                                                &pwzVDirSubPath,
                                                &fAppFound);
             ExitOnFailure(hr, "Error reading application from config")
             if (fAppFound)
             {
                 //delete vdir
-                hr = DeleteVdir(pAppElement, pwzVDirSubPath);
+                hr = DeleteVdir(pAppElement, pIndex, pwzAppKey, pwzVDirSubPath);
                 ExitOnFailure(hr, "Unable to delete vdir for application");
             }
         }
@@ -2122,6 +2250,7 @@ HRESULT IIS7VDir(
     ReleaseStr(pwzSiteName);
     ReleaseStr(pwzVDirPath);
     ReleaseStr(pwzVDirPhyDir);
+    ReleaseStr(pwzAppKey);
     ReleaseObject(pSiteElem);
     ReleaseObject(pAppElement);
     ReleaseObject(pElement);
@@ -2137,7 +2266,8 @@ HRESULT IIS7VDir(
 //-------------------------------------------------------------------------------------------------
 HRESULT IIS7Binding(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr)
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex)
 {
     HRESULT hr = S_OK;
 
@@ -2167,7 +2297,7 @@ HRESULT IIS7Binding(
     ExitOnFailure(hr, "Failed to read binding info");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fSiteFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fSiteFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
     if (IIS_CREATE == iAction)
@@ -2210,7 +2340,8 @@ HRESULT IIS7Binding(
 //-------------------------------------------------------------------------------------------------
 HRESULT IIS7WebLog(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr)
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex)
 {
     HRESULT hr = S_OK;
 
@@ -2230,7 +2361,7 @@ HRESULT IIS7WebLog(
     ExitOnFailure(hr, "Failed to read web log protocol");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fSiteFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fSiteFound);
     ExitOnFailure(hr, "Failed to read web log sites from config");
 
     if (fSiteFound)
@@ -2322,6 +2453,7 @@ HRESULT IIS7AppExtension(
    IAppHostElement *pSection = NULL;
    IAppHostElement *pElement = NULL;
    IAppHostElementCollection *pCollection = NULL;
+   IIS7_ELEMENT_INDEX handlers = { };
 
    BOOL fFound = FALSE;
    DWORD cHandlers = 1000;
@@ -2364,6 +2496,9 @@ HRESULT IIS7AppExtension(
     hr = pSection->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get handlers collection for appext");
 
+    hr = IndexAppHostChildren(NULL, NULL, pSection, &handlers, IIS_CONFIG_ADD, IIS_CONFIG_NAME);
+    ExitOnFailure(hr, "Failed to index handlers for appext");
+
     while (IIS_APPEXT_END != iAction)
     {
         fFound = FALSE;
@@ -2377,8 +2512,8 @@ HRESULT IIS7AppExtension(
                 hr = StrAllocFormatted(&pwzHandlerName, L"MsiCustom-%u", ++cHandlers);
                 ExitOnFailure(hr, "Failed increment handler name");
 
-                hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, pwzHandlerName, &pElement, NULL);
-                ExitOnFailure(hr, "Failed to find mimemap extension");
+                hr = FindIndexedAppHostElement(&handlers, pwzHandlerName, &pElement);
+                ExitOnFailure(hr, "Failed to find appext handler");
 
                 fFound = (NULL != pElement);
                 if (!fFound)
@@ -2434,6 +2569,9 @@ HRESULT IIS7AppExtension(
             //  put handler element at beginning of list
             hr = pCollection->AddElement(pElement, 0);
             ExitOnFailure(hr, "Failed add handler element for appext");
+
+            hr = IndexAppHostElement(&handlers, pwzHandlerName, pElement);
+            ExitOnFailure(hr, "Failed to index handler element for appext");
         }
 
         ReleaseNullObject(pElement);
@@ -2450,6 +2588,7 @@ LExit:
     ReleaseStr(pwzConfigPath);
     ReleaseStr(pwzHandlerName);
     ReleaseStr(pwzPath);
+    ResetElementIndex(&handlers);
     ReleaseObject(pSection);
     ReleaseObject(pElement);
     ReleaseObject(pCollection);
@@ -2472,12 +2611,14 @@ LExit:
     LPWSTR pwzConfigPath = NULL;
     LPWSTR pwzWebName = NULL;
     LPWSTR pwzWebRoot = NULL;
+    LPWSTR pwzExtension = NULL;
     LPWSTR pwzData = NULL;
     int iAction = -1;
 
     IAppHostElement *pSection = NULL;
     IAppHostElement *pElement = NULL;
     IAppHostElementCollection *pCollection = NULL;
+    IIS7_ELEMENT_INDEX mimeMaps = { };
 
     BOOL fFound = FALSE;
 
@@ -2520,6 +2661,9 @@ LExit:
     hr = pSection->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get staticContent collection for mimemap");
 
+    hr = IndexAppHostChildren(NULL, NULL, pSection, &mimeMaps, IIS_CONFIG_MIMEMAP, IIS_CONFIG_FILEEXT);
+    ExitOnFailure(hr, "Failed to index mimemaps");
+
     while (IIS_MIMEMAP_END != iAction)
     {
         //Process property action
@@ -2528,10 +2672,10 @@ LExit:
             case IIS_MIMEMAP :
             {
                 //get extension
-                hr = WcaReadStringFromCaData(ppwzCustomActionData, &pwzData);
+                hr = WcaReadStringFromCaData(ppwzCustomActionData, &pwzExtension);
                 ExitOnFailure(hr, "Failed to read mimemap extension");
 
-                hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_MIMEMAP, IIS_CONFIG_FILEEXT, pwzData, &pElement, NULL);
+                hr = FindIndexedAppHostElement(&mimeMaps, pwzExtension, &pElement);
                 ExitOnFailure(hr, "Failed to find mimemap extension");
                 fFound = (NULL != pElement);
 
@@ -2543,7 +2687,7 @@ LExit:
                 }
 
                 //put property
-                hr = Iis7PutPropertyString(pElement, IIS_CONFIG_FILEEXT, pwzData);
+                hr = Iis7PutPropertyString(pElement, IIS_CONFIG_FILEEXT, pwzExtension);
                 ExitOnFailure(hr, "Failed set mimemap extension property");
 
                 //get type
@@ -2567,6 +2711,9 @@ LExit:
             //  put mimeMap element at beginning of list
             hr = pCollection->AddElement(pElement, -1);
             ExitOnFailure(hr, "Failed add mimemap");
+
+            hr = IndexAppHostElement(&mimeMaps, pwzExtension, pElement);
+            ExitOnFailure(hr, "Failed to index mimemap");
         }
 
         // Get AppExt action
@@ -2580,7 +2727,9 @@ LExit:
     ReleaseStr(pwzConfigPath);
     ReleaseStr(pwzWebName);
     ReleaseStr(pwzWebRoot);
+    ReleaseStr(pwzExtension);
     ReleaseStr(pwzData);
+    ResetElementIndex(&mimeMaps);
     ReleaseObject(pSection);
     ReleaseObject(pElement);
     ReleaseObject(pCollection);
@@ -2850,7 +2999,8 @@ LExit:
 //-------------------------------------------------------------------------------------------------
 HRESULT IIS7SslBinding(
     __inout  LPWSTR *ppwzCustomActionData,
-    __in     IAppHostWritableAdminManager *pAdminMgr
+    __in     IAppHostWritableAdminManager *pAdminMgr,
+    __in     IIS7_CONFIG_INDEX *pIndex
     )
 {
     HRESULT hr = S_OK;
@@ -2880,7 +3030,7 @@ HRESULT IIS7SslBinding(
     ExitOnFailure(hr, "Failed to read binding info");
 
     //Get site if it exists
-    hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fSiteFound);
+    hr = GetSiteElement(pAdminMgr, pIndex, pwzSiteName, &pSiteElem, &fSiteFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
     if (IIS_CREATE == iAction)
@@ -2980,6 +3130,7 @@ LExit:
 
 static HRESULT GetSiteElement(
     IAppHostWritableAdminManager *pAdminMgr,
+    IIS7_CONFIG_INDEX *pIndex,
     LPCWSTR swSiteName,
     IAppHostElement **ppSiteElement,
     BOOL* fFound
@@ -2987,67 +3138,77 @@ static HRESULT GetSiteElement(
 {
    HRESULT hr = S_OK;
    IAppHostElement *pSites = NULL;
-   IAppHostElementCollection *pCollection = NULL;
 
    *fFound = FALSE;
 
-    hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_SITES_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pSites);
-    ExitOnFailure(hr, "Failed get sites section");
-    ExitOnNull(pSites, hr, ERROR_FILE_NOT_FOUND, "Failed get sites section object");
+    if (!pIndex->fSitesIndexed)
+    {
+        hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_SITES_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pSites);
+        ExitOnFailure(hr, "Failed get sites section");
+        ExitOnNull(pSites, hr, ERROR_FILE_NOT_FOUND, "Failed get sites section object");
 
-    hr = pSites->get_Collection(&pCollection);
-    ExitOnFailure(hr, "Failed get sites collection");
+        hr = IndexAppHostChildren(NULL, NULL, pSites, &pIndex->sites, IIS_CONFIG_SITE, IIS_CONFIG_NAME);
+        ExitOnFailure(hr, "Failed to index sites");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, swSiteName, ppSiteElement, NULL);
+        pIndex->fSitesIndexed = TRUE;
+    }
+
+    hr = FindIndexedAppHostElement(&pIndex->sites, swSiteName, ppSiteElement);
     ExitOnFailure(hr, "Failed to find site %ls", swSiteName);
 
     *fFound = ppSiteElement != NULL && *ppSiteElement != NULL;
 
 LExit:
     ReleaseObject(pSites);
-    ReleaseObject(pCollection);
 
     return hr;
 }
 
 static HRESULT GetApplicationElement( IAppHostElement *pSiteElement,
+                                      IIS7_CONFIG_INDEX *pIndex,
+                                      LPCWSTR swSiteName,
                                       LPCWSTR swAppPath,
                                       IAppHostElement **ppAppElement,
                                       BOOL* fFound)
 {
    HRESULT hr = S_OK;
-   IAppHostElementCollection *pCollection = NULL;
+   LPWSTR pwzAppKey = NULL;
 
    *fFound = FALSE;
 
-    hr = pSiteElement->get_Collection( &pCollection);
-    ExitOnFailure(hr, "Failed get site app collection");
+    hr = IndexAppHostChildren(&pIndex->sites, swSiteName, pSiteElement, &pIndex->applications, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH);
+    ExitOnFailure(hr, "Failed to index site apps");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, swAppPath, ppAppElement, NULL);
+    hr = StrAllocFormatted(&pwzAppKey, L"%ls\t%ls", swSiteName, swAppPath);
+    ExitOnFailure(hr, "Failed to format app index key");
+
+    hr = FindIndexedAppHostElement(&pIndex->applications, pwzAppKey, ppAppElement);
     ExitOnFailure(hr, "Failed to find app %ls", swAppPath);
 
     *fFound = ppAppElement != NULL && *ppAppElement != NULL;
 
 LExit:
-    ReleaseObject(pCollection);
+    ReleaseStr(pwzAppKey);
 
     return hr;
 }
 
 static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
+                                             IIS7_CONFIG_INDEX *pIndex,
+                                             LPCWSTR swSiteName,
                                              LPCWSTR pwzVDirPath,
                                              IAppHostElement **ppAppElement,
+                                             LPWSTR *psczAppKey,
                                              LPCWSTR *ppwzVDirSubPath,
                                              BOOL* fFound)
 {
     HRESULT hr = S_OK;
-    IAppHostElementCollection *pCollection = NULL;
     LPWSTR pwzAppPath = NULL;
     *fFound = FALSE;
     *ppwzVDirSubPath = NULL;
 
-    hr = pSiteElement->get_Collection( &pCollection);
-    ExitOnFailure(hr, "Failed get site app collection");
+    hr = IndexAppHostChildren(&pIndex->sites, swSiteName, pSiteElement, &pIndex->applications, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH);
+    ExitOnFailure(hr, "Failed to index site apps");
 
     // Start with full path
     int iLastPathIndex = lstrlenW(pwzVDirPath) - 1;
@@ -3071,7 +3232,10 @@ static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
             LPCWSTR pwzAppSearchPath = 0 == iSubPathIndex ? L"/" : pwzAppPath;
 
             // Try to find an app with the specified path
-            hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, pwzAppSearchPath, ppAppElement, NULL);
+            hr = StrAllocFormatted(psczAppKey, L"%ls\t%ls", swSiteName, pwzAppSearchPath);
+            ExitOnFailure(hr, "Failed to format app index key");
+
+            hr = FindIndexedAppHostElement(&pIndex->applications, *psczAppKey, ppAppElement);
             ExitOnFailure(hr, "Failed to search for app %ls", pwzAppSearchPath);
             *fFound = ppAppElement != NULL && *ppAppElement != NULL;
 
@@ -3085,12 +3249,213 @@ static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
     }
 
 LExit:
-    ReleaseObject(pCollection);
     ReleaseStr(pwzAppPath);
 
     return hr;
 }
 
+static HRESULT IndexAppHostElement(
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzKey,
+    IAppHostElement *pElement
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_INDEXED_ELEMENT *pIndexed = NULL;
+
+    if (!pIndex->sdElements)
+    {
+        hr = DictCreateWithEmbeddedKey(&pIndex->sdElements, 0, reinterpret_cast<void **>(&pIndex->rgElements), offsetof(IIS7_INDEXED_ELEMENT, sczKey), DICT_FLAG_CASEINSENSITIVE);
+        ExitOnFailure(hr, "Failed to create element index");
+    }
+
+    hr = DictGetValue(pIndex->sdElements, wzKey, reinterpret_cast<void **>(&pIndexed));
+    if (E_NOTFOUND == hr)
+    {
+        hr = MemEnsureArraySize(reinterpret_cast<void **>(&pIndex->rgElements), pIndex->cElements + 1, sizeof(IIS7_INDEXED_ELEMENT), 16);
+        ExitOnFailure(hr, "Failed to grow element index");
+
+        pIndexed = pIndex->rgElements + pIndex->cElements;
+
+        hr = StrAllocString(&pIndexed->sczKey, wzKey, 0);
+        ExitOnFailure(hr, "Failed to copy element index key %ls", wzKey);
+
+        ++pIndex->cElements;
+
+        hr = DictAddValue(pIndex->sdElements, pIndexed);
+        ExitOnFailure(hr, "Failed to add %ls to element index", wzKey);
+    }
+    ExitOnFailure(hr, "Failed to find %ls in element index", wzKey);
+
+    // The children of a replaced or deleted element have to be indexed again.
+    ReleaseNullObject(pIndexed->pElement);
+    pIndexed->fChildrenIndexed = FALSE;
+
+    if (pElement)
+    {
+        pElement->AddRef();
+        pIndexed->pElement = pElement;
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT IndexAppHostChildren(
+    IIS7_ELEMENT_INDEX *pParentIndex,
+    LPCWSTR wzParentKey,
+    IAppHostElement *pParentElement,
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzElementName,
+    LPCWSTR wzKeyName
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_INDEXED_ELEMENT *pParent = NULL;
+    IAppHostElementCollection *pCollection = NULL;
+    IAppHostElement *pElement = NULL;
+    BSTR bstrElementName = NULL;
+    LPWSTR pwzValue = NULL;
+    LPWSTR pwzKey = NULL;
+    DWORD cElements = 0;
+    VARIANT vtIndex;
+
+    ::VariantInit(&vtIndex);
+
+    if (pParentIndex)
+    {
+        hr = DictGetValue(pParentIndex->sdElements, wzParentKey, reinterpret_cast<void **>(&pParent));
+        ExitOnFailure(hr, "Failed to find %ls in element index", wzParentKey);
+
+        if (pParent->fChildrenIndexed)
+        {
+            ExitFunction();
+        }
+    }
+
+    hr = pParentElement->get_Collection(&pCollection);
+    ExitOnFailure(hr, "Failed get %ls collection", wzElementName);
+
+    hr = pCollection->get_Count(&cElements);
+    ExitOnFailure(hr, "Failed get %ls collection count", wzElementName);
+
+    vtIndex.vt = VT_UI4;
+    for (DWORD i = 0; i < cElements; ++i)
+    {
+        vtIndex.ulVal = i;
+        hr = pCollection->get_Item(vtIndex, &pElement);
+        ExitOnFailure(hr, "Failed get %ls collection item", wzElementName);
+
+        hr = pElement->get_Name(&bstrElementName);
+        ExitOnFailure(hr, "Failed get %ls collection item name", wzElementName);
+
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, wzElementName, -1, bstrElementName, -1))
+        {
+            hr = Iis7GetPropertyString(pElement, wzKeyName, &pwzValue);
+            ExitOnFailure(hr, "Failed get %ls %ls property", wzElementName, wzKeyName);
+
+            if (wzParentKey)
+            {
+                hr = StrAllocFormatted(&pwzKey, L"%ls\t%ls", wzParentKey, pwzValue);
+            }
+            else
+            {
+                hr = StrAllocString(&pwzKey, pwzValue, 0);
+            }
+            ExitOnFailure(hr, "Failed to format %ls index key", wzElementName);
+
+            hr = IndexAppHostElement(pIndex, pwzKey, pElement);
+            ExitOnFailure(hr, "Failed to index %ls %ls", wzElementName, pwzValue);
+        }
+
+        ReleaseNullBSTR(bstrElementName);
+        ReleaseNullObject(pElement);
+    }
+
+    // Only the child index grew, so the parent entry is still in place.
+    if (pParent)
+    {
+        pParent->fChildrenIndexed = TRUE;
+    }
+
+LExit:
+    ReleaseVariant(vtIndex);
+    ReleaseStr(pwzKey);
+    ReleaseStr(pwzValue);
+    ReleaseBSTR(bstrElementName);
+    ReleaseObject(pElement);
+    ReleaseObject(pCollection);
+
+    return hr;
+}
+
+static HRESULT FindIndexedAppHostElement(
+    IIS7_ELEMENT_INDEX *pIndex,
+    LPCWSTR wzKey,
+    IAppHostElement **ppElement
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_INDEXED_ELEMENT *pIndexed = NULL;
+
+    *ppElement = NULL;
+
+    if (pIndex->sdElements)
+    {
+        hr = DictGetValue(pIndex->sdElements, wzKey, reinterpret_cast<void **>(&pIndexed));
+        if (E_NOTFOUND == hr)
+        {
+            ExitFunction1(hr = S_OK);
+        }
+        ExitOnFailure(hr, "Failed to find %ls in element index", wzKey);
+
+        if (pIndexed->pElement)
+        {
+            pIndexed->pElement->AddRef();
+            *ppElement = pIndexed->pElement;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static void ResetElementIndex(
+    IIS7_ELEMENT_INDEX *pIndex
+    )
+{
+    for (DWORD i = 0; i < pIndex->cElements; ++i)
+    {
+        ReleaseStr(pIndex->rgElements[i].sczKey);
+        ReleaseObject(pIndex->rgElements[i].pElement);
+    }
+
+    ReleaseDict(pIndex->sdElements);
+    ReleaseMem(pIndex->rgElements);
+    memset(pIndex, 0, sizeof(IIS7_ELEMENT_INDEX));
+}
+
+static void ResetConfigIndex(
+    IIS7_CONFIG_INDEX *pIndex
+    )
+{
+    ResetElementIndex(&pIndex->vdirs);
+    ResetElementIndex(&pIndex->applications);
+    ResetElementIndex(&pIndex->sites);
+    pIndex->fSitesIndexed = FALSE;
+}
+
+static HRESULT CreateAdminManager(
+    __out IAppHostWritableAdminManager **ppAdminMgr
+    )
+{
+    return ::CoCreateInstance(__uuidof(AppHostWritableAdminManager),
+                              NULL,
+                              CLSCTX_INPROC_SERVER,
+                              __uuidof(IAppHostWritableAdminManager),
+                              reinterpret_cast<void**> (ppAdminMgr));
+}
+
 static HRESULT CreateSite(
     __in IAppHostElementCollection *pCollection,
     __in LPCWSTR swSiteName,
@@ -3195,6 +3560,8 @@ LExit:
 
 static HRESULT CreateVdir(
     IAppHostElement *pAppElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR wzAppKey,
     LPCWSTR pwzVDirPath,
     LPCWSTR pwzVDirPhyDir
     )
@@ -3202,12 +3569,19 @@ static HRESULT CreateVdir(
     HRESULT hr = S_OK;
     IAppHostElement *pElement = NULL;
     IAppHostElementCollection *pCollection = NULL;
+    LPWSTR pwzVDirKey = NULL;
     BOOL fFound;
 
     hr = pAppElement->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get application VDir collection");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_VDIR, IIS_CONFIG_PATH, pwzVDirPath, &pElement, NULL);
+    hr = IndexAppHostChildren(&pIndex->applications, wzAppKey, pAppElement, &pIndex->vdirs, IIS_CONFIG_VDIR, IIS_CONFIG_PATH);
+    ExitOnFailure(hr, "Failed to index application VDirs");
+
+    hr = StrAllocFormatted(&pwzVDirKey, L"%ls\t%ls", wzAppKey, pwzVDirPath);
+    ExitOnFailure(hr, "Failed to format VDir index key");
+
+    hr = FindIndexedAppHostElement(&pIndex->vdirs, pwzVDirKey, &pElement);
     ExitOnFailure(hr, "Failed while finding virtualDir");
     fFound = (NULL != pElement);
 
@@ -3227,9 +3601,13 @@ static HRESULT CreateVdir(
     {
         hr = pCollection->AddElement(pElement);
         ExitOnFailure(hr, "Failed add application VDir element");
+
+        hr = IndexAppHostElement(&pIndex->vdirs, pwzVDirKey, pElement);
+        ExitOnFailure(hr, "Failed to index application VDir element");
     }
 
 LExit:
+    ReleaseStr(pwzVDirKey);
     ReleaseObject(pCollection);
     ReleaseObject(pElement);
 
@@ -3238,11 +3616,14 @@ LExit:
 
 static HRESULT DeleteVdir(
     IAppHostElement *pAppElement,
+    IIS7_CONFIG_INDEX *pIndex,
+    LPCWSTR wzAppKey,
     LPCWSTR pwzVDirPath
     )
 {
     HRESULT hr = S_OK;
     IAppHostElementCollection *pCollection = NULL;
+    LPWSTR pwzVDirKey = NULL;
 
     hr = pAppElement->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get application VDir collection");
@@ -3250,7 +3631,14 @@ static HRESULT DeleteVdir(
     hr = DeleteCollectionElement(pCollection, IIS_CONFIG_VDIR, IIS_CONFIG_PATH, pwzVDirPath);
     ExitOnFailure(hr, "Failed to delete vdir");
 
+    hr = StrAllocFormatted(&pwzVDirKey, L"%ls\t%ls", wzAppKey, pwzVDirPath);
+    ExitOnFailure(hr, "Failed to format VDir index key");
+
+    hr = IndexAppHostElement(&pIndex->vdirs, pwzVDirKey, NULL);
+    ExitOnFailure(hr, "Failed to remove vdir from index");
+
 LExit:
+    ReleaseStr(pwzVDirKey);
     ReleaseObject(pCollection);
 
     return hr;
@@ -2,4 +2,11 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
 
 
+typedef HRESULT (*PFN_IIS7CREATEADMINMANAGER)(
+    __out IAppHostWritableAdminManager **ppAdminMgr
+    );
+
+void IIS7FunctionOverride(
+    __in_opt PFN_IIS7CREATEADMINMANAGER pfnCreateAdminManager
+    );
 HRESULT IIS7ConfigChanges(MSIHANDLE hInstall, __inout LPWSTR pwzData);
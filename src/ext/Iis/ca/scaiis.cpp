@@ -3,7 +3,7 @@
 #include "precomp.h"
 
 // globals
-LPWSTR vpwzCustomActionData = NULL;
+WCA_CADATA_WRITER vCustomActionData = { };
 DWORD vdwCustomActionCost = 0;
 
 HRESULT ScaMetabaseTransaction(__in_z LPCWSTR wzBackup)
@@ -389,7 +389,7 @@ HRESULT ScaAddToIisConfiguration(LPCWSTR pwzData, DWORD dwCost)
 {
     HRESULT hr = S_OK;
 
-    hr = WcaWriteStringToCaData(pwzData, &vpwzCustomActionData);
+    hr = WcaCaDataWriteString(&vCustomActionData, pwzData);
     ExitOnFailure(hr, "failed to add to metabase configuration data string: %ls", pwzData);
 
     vdwCustomActionCost += dwCost;
@@ -411,12 +411,12 @@ HRESULT ScaWriteConfigurationScript(__in LPCWSTR pwzCaScriptKey)
     hr = WcaCaScriptCreate(WCA_ACTION_INSTALL, WCA_CASCRIPT_SCHEDULED, FALSE, pwzCaScriptKey, FALSE, &hScript);
     ExitOnFailure(hr, "Failed to write ca script for WriteMetabaseChanges script.");
 
-    if (vpwzCustomActionData && *vpwzCustomActionData)
+    if (vCustomActionData.cchData)
     {
         // Write the actual custom action data to the ca script
-        WcaCaScriptWriteString(hScript, vpwzCustomActionData);
+        WcaCaScriptWriteString(hScript, vCustomActionData.pwzData);
 
-        hr = CrypHashBuffer((BYTE*)vpwzCustomActionData, sizeof(vpwzCustomActionData) * sizeof(WCHAR), PROV_RSA_AES, CALG_SHA1, rgbActualHash, dwHashedBytes);
+        hr = CrypHashBuffer((BYTE*)vCustomActionData.pwzData, sizeof(vCustomActionData.pwzData) * sizeof(WCHAR), PROV_RSA_AES, CALG_SHA1, rgbActualHash, dwHashedBytes);
         ExitOnFailure(hr, "Failed to calculate hash of CustomAction data.");
 
         hr = StrAlloc(&pwzHashString, ((dwHashedBytes * 2) + 1));
@@ -426,14 +426,14 @@ HRESULT ScaWriteConfigurationScript(__in LPCWSTR pwzCaScriptKey)
         ExitOnFailure(hr, "Failed to convert hash bytes to string.");
 
         WcaLog(LOGMSG_VERBOSE,  "Custom action data hash: %ls", pwzHashString);
-        WcaLog(LOGMSG_TRACEONLY, "Custom action data being written to ca script: %ls", vpwzCustomActionData);
+        WcaLog(LOGMSG_TRACEONLY, "Custom action data being written to ca script: %ls", vCustomActionData.pwzData);
     }
     else
         hr = S_FALSE;
 
 LExit:
     // Release the string
-    ReleaseStr(vpwzCustomActionData);
+    WcaCaDataWriterUninitialize(&vCustomActionData);
     ReleaseStr(pwzHashString);
 
     // Flush the ca script to disk as best we can
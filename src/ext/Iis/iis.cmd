@@ -15,6 +15,7 @@ msbuild -t:Restore -p:Configuration=%_C% || exit /b
 msbuild -t:Build -p:Configuration=%_C% test\WixToolsetTest.Iis\WixToolsetTest.Iis.csproj || exit /b
 
 :: Test
+msbuild -t:Test -p:Configuration=%_C% test\IisCaUnitTest || exit /b
 dotnet test -c %_C% --no-build test\WixToolsetTest.Iis || exit /b
 
 :: Pack
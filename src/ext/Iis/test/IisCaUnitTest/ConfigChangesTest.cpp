@@ -0,0 +1,340 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+static LPCWSTR TEST_WEB_NAME = L"Default Web Site";
+static LPCWSTR TEST_CONFIG_PATH = IIS_CONFIG_APPHOST_ROOT L"/Default Web Site";
+
+namespace IisCaTests
+{
+    public ref class ConfigChanges
+    {
+    public:
+        [Fact]
+        void IIS7ConfigChangesReplaysEveryChangeAfterCommitConflictTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_APPHOST appHost = { };
+            WCA_CADATA_WRITER writer = { };
+
+            try
+            {
+                hInstall = OpenConfigChangesTestSession(packagePath, &appHost);
+
+                WriteBlockStart(&writer, IIS_MIMEMAP_BEGIN);
+                WriteMimeMaps(&writer, L".a", 3, L"text/plain");
+                WriteInteger(&writer, IIS_MIMEMAP_END);
+
+                WriteBlockStart(&writer, IIS_APPEXT_BEGIN);
+                WriteHandlers(&writer, 2, L"GET");
+                WriteInteger(&writer, IIS_APPEXT_END);
+
+                // The first commit hits a sharing violation, so everything is applied again to a fresh admin manager.
+                appHost.cConflicts = 1;
+
+                hr = IIS7ConfigChanges(hInstall, writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to apply IIS config changes.");
+
+                Assert::Equal<DWORD>(2, appHost.cAdminManagers);
+                Assert::Equal<DWORD>(2, appHost.cCommits);
+                Assert::Equal<DWORD>(0, appHost.cConflicts);
+
+                VerifyMimeMaps(&appHost, L".a", 3, L"text/plain", 3);
+                VerifyHandlers(&appHost, 2, L"GET", 2);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseConfigChangesTestSession(hInstall, packagePath, &appHost);
+            }
+        }
+
+        [Fact]
+        void IIS7ConfigChangesIndexesMimeMapsAndHandlersTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_APPHOST appHost = { };
+            WCA_CADATA_WRITER writer = { };
+            const DWORD cMimeMaps = 2000;
+            const DWORD cHandlers = 200;
+
+            try
+            {
+                hInstall = OpenConfigChangesTestSession(packagePath, &appHost);
+
+                // Commit the entries a previous install left behind.
+                WriteBlockStart(&writer, IIS_MIMEMAP_BEGIN);
+                WriteMimeMaps(&writer, L".old", cMimeMaps, L"text/old");
+                WriteInteger(&writer, IIS_MIMEMAP_END);
+
+                WriteBlockStart(&writer, IIS_APPEXT_BEGIN);
+                WriteHandlers(&writer, cHandlers, L"GET");
+                WriteInteger(&writer, IIS_APPEXT_END);
+
+                hr = IIS7ConfigChanges(hInstall, writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to apply the existing IIS config.");
+
+                WcaCaDataWriterUninitialize(&writer);
+
+                // Update every existing entry and add as many new MIME maps.
+                WriteBlockStart(&writer, IIS_MIMEMAP_BEGIN);
+                WriteMimeMaps(&writer, L".old", cMimeMaps, L"text/new");
+                WriteMimeMaps(&writer, L".new", cMimeMaps, L"text/new");
+                WriteInteger(&writer, IIS_MIMEMAP_END);
+
+                WriteBlockStart(&writer, IIS_APPEXT_BEGIN);
+                WriteHandlers(&writer, cHandlers, L"GET,POST");
+                WriteInteger(&writer, IIS_APPEXT_END);
+
+                appHost.cItemReads = 0;
+
+                hr = IIS7ConfigChanges(hInstall, writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to apply IIS config changes.");
+
+                // Each collection is read once to build its index, however many changes look it up,
+                // and all of the changes go out in a single commit.
+                Assert::Equal<DWORD>(cMimeMaps + cHandlers, appHost.cItemReads);
+                Assert::Equal<DWORD>(2, appHost.cAdminManagers);
+                Assert::Equal<DWORD>(2, appHost.cCommits);
+
+                VerifyMimeMaps(&appHost, L".old", cMimeMaps, L"text/new", 2 * cMimeMaps);
+                VerifyMimeMaps(&appHost, L".new", cMimeMaps, L"text/new", 2 * cMimeMaps);
+                VerifyHandlers(&appHost, cHandlers, L"GET,POST", cHandlers);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseConfigChangesTestSession(hInstall, packagePath, &appHost);
+            }
+        }
+
+    private:
+        MSIHANDLE OpenConfigChangesTestSession(String^ packagePath, FAKE_APPHOST* pAppHost)
+        {
+            HRESULT hr = S_OK;
+            pin_ptr<const WCHAR> wzPackagePath = PtrToStringChars(packagePath);
+            MSIHANDLE hDatabase = NULL;
+            MSIHANDLE hInstall = NULL;
+
+            try
+            {
+                hr = WcaTestCreatePackage(wzPackagePath, &hDatabase);
+                NativeAssert::Succeeded(hr, "Failed to create test package.");
+
+                hr = WcaTestOpenSession(wzPackagePath, &hDatabase, &hInstall);
+                NativeAssert::Succeeded(hr, "Failed to open session on test package.");
+            }
+            finally
+            {
+                if (hDatabase)
+                {
+                    ::MsiCloseHandle(hDatabase);
+                }
+            }
+
+            FakeAppHostInitialize(pAppHost);
+            IIS7FunctionOverride(FakeAppHostCreateAdminManager);
+
+            return hInstall;
+        }
+
+        void CloseConfigChangesTestSession(MSIHANDLE hInstall, String^ packagePath, FAKE_APPHOST* pAppHost)
+        {
+            IIS7FunctionOverride(NULL);
+            FakeAppHostUninitialize(pAppHost);
+
+            WcaTestCloseSession(hInstall);
+
+            if (File::Exists(packagePath))
+            {
+                File::Delete(packagePath);
+            }
+        }
+
+        void WriteInteger(WCA_CADATA_WRITER* pWriter, int iValue)
+        {
+            HRESULT hr = WcaCaDataWriteInteger(pWriter, iValue);
+            NativeAssert::Succeeded(hr, "Failed to write integer.");
+        }
+
+        void WriteString(WCA_CADATA_WRITER* pWriter, LPCWSTR wzValue)
+        {
+            HRESULT hr = WcaCaDataWriteString(pWriter, wzValue);
+            NativeAssert::Succeeded(hr, "Failed to write string.");
+        }
+
+        // Every block in these tests changes the root of the test web site.
+        void WriteBlockStart(WCA_CADATA_WRITER* pWriter, IIS_CONFIG_ACTION action)
+        {
+            WriteInteger(pWriter, action);
+            WriteString(pWriter, TEST_WEB_NAME);
+            WriteString(pWriter, L"/");
+        }
+
+        void WriteMimeMaps(WCA_CADATA_WRITER* pWriter, LPCWSTR wzPrefix, DWORD cMimeMaps, LPCWSTR wzType)
+        {
+            HRESULT hr = S_OK;
+            WCHAR wzExtension[32] = { };
+
+            for (DWORD i = 0; i < cMimeMaps; ++i)
+            {
+                hr = ::StringCchPrintfW(wzExtension, countof(wzExtension), L"%ls%u", wzPrefix, i);
+                NativeAssert::Succeeded(hr, "Failed to format extension.");
+
+                WriteInteger(pWriter, IIS_MIMEMAP);
+                WriteString(pWriter, wzExtension);
+                WriteString(pWriter, wzType);
+            }
+        }
+
+        void WriteHandlers(WCA_CADATA_WRITER* pWriter, DWORD cHandlers, LPCWSTR wzVerbs)
+        {
+            HRESULT hr = S_OK;
+            WCHAR wzExtension[32] = { };
+
+            for (DWORD i = 0; i < cHandlers; ++i)
+            {
+                hr = ::StringCchPrintfW(wzExtension, countof(wzExtension), L"ext%u", i);
+                NativeAssert::Succeeded(hr, "Failed to format extension.");
+
+                WriteInteger(pWriter, IIS_APPEXT);
+                WriteString(pWriter, wzExtension);
+                WriteString(pWriter, L"C:\\Program Files\\Test\\handler.dll");
+                WriteString(pWriter, wzVerbs);
+            }
+        }
+
+        IAppHostElementCollection* GetCommittedCollection(FAKE_APPHOST* pAppHost, LPCWSTR wzSectionName)
+        {
+            HRESULT hr = S_OK;
+            BSTR bstrSectionName = NULL;
+            BSTR bstrPath = NULL;
+            IAppHostElement* pSection = NULL;
+            IAppHostElementCollection* pCollection = NULL;
+
+            Assert::True(NULL != pAppHost->pCommitted);
+
+            try
+            {
+                bstrSectionName = ::SysAllocString(wzSectionName);
+                bstrPath = ::SysAllocString(TEST_CONFIG_PATH);
+                Assert::True(NULL != bstrSectionName && NULL != bstrPath);
+
+                hr = pAppHost->pCommitted->GetAdminSection(bstrSectionName, bstrPath, &pSection);
+                NativeAssert::Succeeded(hr, "Failed to get committed section.");
+
+                hr = pSection->get_Collection(&pCollection);
+                NativeAssert::Succeeded(hr, "Failed to get committed collection.");
+            }
+            finally
+            {
+                ReleaseObject(pSection);
+                ReleaseBSTR(bstrPath);
+                ReleaseBSTR(bstrSectionName);
+            }
+
+            return pCollection;
+        }
+
+        void VerifyMimeMaps(FAKE_APPHOST* pAppHost, LPCWSTR wzPrefix, DWORD cMimeMaps, LPCWSTR wzType, DWORD cTotal)
+        {
+            HRESULT hr = S_OK;
+            IAppHostElementCollection* pCollection = NULL;
+            IAppHostElement* pElement = NULL;
+            LPWSTR sczType = NULL;
+            WCHAR wzExtension[32] = { };
+            DWORD cElements = 0;
+
+            try
+            {
+                pCollection = GetCommittedCollection(pAppHost, IIS_CONFIG_STATICCONTENT_SECTION);
+
+                hr = pCollection->get_Count(&cElements);
+                NativeAssert::Succeeded(hr, "Failed to count MIME maps.");
+                Assert::Equal<DWORD>(cTotal, cElements);
+
+                // Spot check the first and last entries so verifying stays cheap for large collections.
+                for (DWORD i = 0; i < cMimeMaps; i += (1 < cMimeMaps ? cMimeMaps - 1 : 1))
+                {
+                    hr = ::StringCchPrintfW(wzExtension, countof(wzExtension), L"%ls%u", wzPrefix, i);
+                    NativeAssert::Succeeded(hr, "Failed to format extension.");
+
+                    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_MIMEMAP, IIS_CONFIG_FILEEXT, wzExtension, &pElement, NULL);
+                    NativeAssert::Succeeded(hr, "Failed to find MIME map.");
+                    Assert::True(NULL != pElement, String::Format("MIME map {0} is missing.", gcnew String(wzExtension)));
+
+                    hr = Iis7GetPropertyString(pElement, IIS_CONFIG_MIMETYPE, &sczType);
+                    NativeAssert::Succeeded(hr, "Failed to get MIME type.");
+                    NativeAssert::StringEqual(wzType, sczType);
+
+                    ReleaseNullObject(pElement);
+                }
+            }
+            finally
+            {
+                ReleaseStr(sczType);
+                ReleaseObject(pElement);
+                ReleaseObject(pCollection);
+            }
+        }
+
+        void VerifyHandlers(FAKE_APPHOST* pAppHost, DWORD cHandlers, LPCWSTR wzVerbs, DWORD cTotal)
+        {
+            HRESULT hr = S_OK;
+            IAppHostElementCollection* pCollection = NULL;
+            IAppHostElement* pElement = NULL;
+            LPWSTR sczValue = NULL;
+            WCHAR wzName[32] = { };
+            WCHAR wzPath[32] = { };
+            DWORD cElements = 0;
+
+            try
+            {
+                pCollection = GetCommittedCollection(pAppHost, IIS_CONFIG_HANDLERS_SECTION);
+
+                hr = pCollection->get_Count(&cElements);
+                NativeAssert::Succeeded(hr, "Failed to count handlers.");
+                Assert::Equal<DWORD>(cTotal, cElements);
+
+                for (DWORD i = 0; i < cHandlers; i += (1 < cHandlers ? cHandlers - 1 : 1))
+                {
+                    // The custom action names its handlers MsiCustom-1001, MsiCustom-1002 and so on.
+                    hr = ::StringCchPrintfW(wzName, countof(wzName), L"MsiCustom-%u", 1001 + i);
+                    NativeAssert::Succeeded(hr, "Failed to format handler name.");
+
+                    hr = ::StringCchPrintfW(wzPath, countof(wzPath), L"*.ext%u", i);
+                    NativeAssert::Succeeded(hr, "Failed to format handler path.");
+
+                    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, wzName, &pElement, NULL);
+                    NativeAssert::Succeeded(hr, "Failed to find handler.");
+                    Assert::True(NULL != pElement, String::Format("Handler {0} is missing.", gcnew String(wzName)));
+
+                    hr = Iis7GetPropertyString(pElement, IIS_CONFIG_PATH, &sczValue);
+                    NativeAssert::Succeeded(hr, "Failed to get handler path.");
+                    NativeAssert::StringEqual(wzPath, sczValue);
+
+                    hr = Iis7GetPropertyString(pElement, IIS_CONFIG_VERBS, &sczValue);
+                    NativeAssert::Succeeded(hr, "Failed to get handler verbs.");
+                    NativeAssert::StringEqual(wzVerbs, sczValue);
+
+                    ReleaseNullObject(pElement);
+                }
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                ReleaseObject(pElement);
+                ReleaseObject(pCollection);
+            }
+        }
+    };
+}
@@ -0,0 +1,839 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+static FAKE_APPHOST* vpAppHost = NULL;
+
+
+template <class T> class CFakeAppHostObject : public T
+{
+public: // IUnknown
+    virtual STDMETHODIMP QueryInterface(
+        __in REFIID riid,
+        __out LPVOID *ppvObject
+        )
+    {
+        if (!ppvObject)
+        {
+            return E_INVALIDARG;
+        }
+
+        *ppvObject = NULL;
+
+        if (::IsEqualIID(__uuidof(T), riid) || ::IsEqualIID(IID_IDispatch, riid) || ::IsEqualIID(IID_IUnknown, riid))
+        {
+            *ppvObject = static_cast<T*>(this);
+        }
+        else // no interface for requested iid
+        {
+            return E_NOINTERFACE;
+        }
+
+        this->AddRef();
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP_(ULONG) AddRef()
+    {
+        return ::InterlockedIncrement(&this->m_cReferences);
+    }
+
+    virtual STDMETHODIMP_(ULONG) Release()
+    {
+        long l = ::InterlockedDecrement(&this->m_cReferences);
+        if (0 < l)
+        {
+            return l;
+        }
+
+        delete this;
+        return 0;
+    }
+
+public: // IDispatch
+    virtual STDMETHODIMP GetTypeInfoCount(
+        __out UINT* /*pctinfo*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetTypeInfo(
+        __in UINT /*iTInfo*/,
+        __in LCID /*lcid*/,
+        __out ITypeInfo** /*ppTInfo*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetIDsOfNames(
+        __in REFIID /*riid*/,
+        __in LPOLESTR* /*rgszNames*/,
+        __in UINT /*cNames*/,
+        __in LCID /*lcid*/,
+        __out DISPID* /*rgDispId*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP Invoke(
+        __in DISPID /*dispIdMember*/,
+        __in REFIID /*riid*/,
+        __in LCID /*lcid*/,
+        __in WORD /*wFlags*/,
+        __in DISPPARAMS* /*pDispParams*/,
+        __out VARIANT* /*pVarResult*/,
+        __out EXCEPINFO* /*pExcepInfo*/,
+        __out UINT* /*puArgErr*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+protected:
+    CFakeAppHostObject()
+    {
+        m_cReferences = 1;
+    }
+
+    virtual ~CFakeAppHostObject()
+    {
+    }
+
+private:
+    long m_cReferences;
+};
+
+
+class CFakeAppHostProperty : public CFakeAppHostObject<IAppHostProperty>
+{
+public: // IAppHostProperty
+    virtual STDMETHODIMP get_Name(
+        __out BSTR* pbstrName
+        )
+    {
+        *pbstrName = ::SysAllocString(m_bstrName);
+        return *pbstrName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    virtual STDMETHODIMP get_Value(
+        __out VARIANT* pVariant
+        )
+    {
+        ::VariantInit(pVariant);
+        return ::VariantCopy(pVariant, &m_vtValue);
+    }
+
+    virtual STDMETHODIMP put_Value(
+        __in VARIANT value
+        )
+    {
+        return ::VariantCopy(&m_vtValue, &value);
+    }
+
+    virtual STDMETHODIMP Clear()
+    {
+        return ::VariantClear(&m_vtValue);
+    }
+
+    virtual STDMETHODIMP get_StringValue(
+        __out BSTR* /*pbstrValue*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_Exception(
+        __out IAppHostPropertyException** /*ppException*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetMetadata(
+        __in BSTR /*bstrMetadataType*/,
+        __out VARIANT* /*pValue*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP SetMetadata(
+        __in BSTR /*bstrMetadataType*/,
+        __in VARIANT /*value*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_Schema(
+        __out IAppHostPropertySchema** /*ppSchema*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public:
+    LPCWSTR Name()
+    {
+        return m_bstrName;
+    }
+
+    const VARIANT* Value()
+    {
+        return &m_vtValue;
+    }
+
+public:
+    // Unset properties read back as an empty string, the default of most AppHost attributes.
+    CFakeAppHostProperty(
+        __in LPCWSTR wzName,
+        __in_opt const VARIANT* pvtValue
+        )
+    {
+        m_bstrName = ::SysAllocString(wzName);
+        ::VariantInit(&m_vtValue);
+
+        if (pvtValue)
+        {
+            ::VariantCopy(&m_vtValue, pvtValue);
+        }
+        else
+        {
+            m_vtValue.vt = VT_BSTR;
+            m_vtValue.bstrVal = ::SysAllocString(L"");
+        }
+    }
+
+protected:
+    virtual ~CFakeAppHostProperty()
+    {
+        ::VariantClear(&m_vtValue);
+        ReleaseBSTR(m_bstrName);
+    }
+
+private:
+    BSTR m_bstrName;
+    VARIANT m_vtValue;
+};
+
+
+class CFakeAppHostElementCollection;
+
+class CFakeAppHostElement : public CFakeAppHostObject<IAppHostElement>
+{
+public: // IAppHostElement
+    virtual STDMETHODIMP get_Name(
+        __out BSTR* pbstrName
+        )
+    {
+        *pbstrName = ::SysAllocString(m_bstrName);
+        return *pbstrName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    virtual STDMETHODIMP get_Collection(
+        __out IAppHostElementCollection** ppCollection
+        );
+
+    virtual STDMETHODIMP get_Properties(
+        __out IAppHostPropertyCollection** /*ppProperties*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_ChildElements(
+        __out IAppHostChildElementCollection** /*ppElements*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetMetadata(
+        __in BSTR /*bstrMetadataType*/,
+        __out VARIANT* /*pValue*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP SetMetadata(
+        __in BSTR /*bstrMetadataType*/,
+        __in VARIANT /*value*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_Schema(
+        __out IAppHostElementSchema** /*ppSchema*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetElementByName(
+        __in BSTR /*bstrSubName*/,
+        __out IAppHostElement** /*ppElement*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP GetPropertyByName(
+        __in BSTR bstrSubName,
+        __out IAppHostProperty** ppProperty
+        )
+    {
+        HRESULT hr = S_OK;
+        CFakeAppHostProperty* pProperty = NULL;
+
+        hr = FindProperty(bstrSubName, NULL, &pProperty);
+        ExitOnFailure(hr, "Failed to find fake property: %ls", bstrSubName);
+
+        pProperty->AddRef();
+        *ppProperty = pProperty;
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP Clear()
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_Methods(
+        __out IAppHostMethodCollection** /*ppMethods*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public:
+    HRESULT Clone(
+        __out CFakeAppHostElement** ppClone
+        );
+
+public:
+    CFakeAppHostElement(
+        __in LPCWSTR wzName
+        )
+    {
+        m_bstrName = ::SysAllocString(wzName);
+        m_rgpProperties = NULL;
+        m_cProperties = 0;
+        m_pCollection = NULL;
+    }
+
+protected:
+    virtual ~CFakeAppHostElement();
+
+private:
+    HRESULT FindProperty(
+        __in LPCWSTR wzName,
+        __in_opt const VARIANT* pvtValue,
+        __out CFakeAppHostProperty** ppProperty
+        )
+    {
+        HRESULT hr = S_OK;
+
+        for (DWORD i = 0; i < m_cProperties; ++i)
+        {
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, wzName, -1, m_rgpProperties[i]->Name(), -1))
+            {
+                ExitFunction1(*ppProperty = m_rgpProperties[i]);
+            }
+        }
+
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&m_rgpProperties), m_cProperties + 1, sizeof(CFakeAppHostProperty*), 8);
+        ExitOnFailure(hr, "Failed to grow fake properties.");
+
+        m_rgpProperties[m_cProperties] = new CFakeAppHostProperty(wzName, pvtValue);
+        ExitOnNull(m_rgpProperties[m_cProperties], hr, E_OUTOFMEMORY, "Failed to create fake property.");
+
+        *ppProperty = m_rgpProperties[m_cProperties];
+        ++m_cProperties;
+
+    LExit:
+        return hr;
+    }
+
+private:
+    BSTR m_bstrName;
+    CFakeAppHostProperty** m_rgpProperties;
+    DWORD m_cProperties;
+    CFakeAppHostElementCollection* m_pCollection;
+};
+
+
+class CFakeAppHostElementCollection : public CFakeAppHostObject<IAppHostElementCollection>
+{
+public: // IAppHostElementCollection
+    virtual STDMETHODIMP get_Count(
+        __out DWORD* pcElementCount
+        )
+    {
+        *pcElementCount = m_cElements;
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP get_Item(
+        __in VARIANT cIndex,
+        __out IAppHostElement** ppElement
+        )
+    {
+        HRESULT hr = S_OK;
+        DWORD dwIndex = 0;
+
+        hr = GetIndex(&cIndex, &dwIndex);
+        ExitOnFailure(hr, "Failed to get fake collection index.");
+
+        ++vpAppHost->cItemReads;
+
+        m_rgpElements[dwIndex]->AddRef();
+        *ppElement = m_rgpElements[dwIndex];
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP AddElement(
+        __in IAppHostElement* pElement,
+        __in INT cPosition
+        )
+    {
+        HRESULT hr = S_OK;
+        DWORD dwPosition = (0 > cPosition || m_cElements < static_cast<DWORD>(cPosition)) ? m_cElements : cPosition;
+
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&m_rgpElements), m_cElements + 1, sizeof(CFakeAppHostElement*), 64);
+        ExitOnFailure(hr, "Failed to grow fake collection.");
+
+        memmove(m_rgpElements + dwPosition + 1, m_rgpElements + dwPosition, sizeof(CFakeAppHostElement*) * (m_cElements - dwPosition));
+
+        pElement->AddRef();
+        m_rgpElements[dwPosition] = static_cast<CFakeAppHostElement*>(pElement);
+        ++m_cElements;
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP DeleteElement(
+        __in VARIANT cIndex
+        )
+    {
+        HRESULT hr = S_OK;
+        DWORD dwIndex = 0;
+
+        hr = GetIndex(&cIndex, &dwIndex);
+        ExitOnFailure(hr, "Failed to get fake collection index.");
+
+        m_rgpElements[dwIndex]->Release();
+
+        --m_cElements;
+        memmove(m_rgpElements + dwIndex, m_rgpElements + dwIndex + 1, sizeof(CFakeAppHostElement*) * (m_cElements - dwIndex));
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP Clear()
+    {
+        for (DWORD i = 0; i < m_cElements; ++i)
+        {
+            m_rgpElements[i]->Release();
+        }
+
+        m_cElements = 0;
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP CreateNewElement(
+        __in BSTR bstrElementName,
+        __out IAppHostElement** ppElement
+        )
+    {
+        HRESULT hr = S_OK;
+
+        *ppElement = new CFakeAppHostElement(bstrElementName);
+        ExitOnNull(*ppElement, hr, E_OUTOFMEMORY, "Failed to create fake element.");
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP get_Schema(
+        __out IAppHostCollectionSchema** /*ppSchema*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public:
+    HRESULT CloneInto(
+        __in CFakeAppHostElementCollection* pClone
+        )
+    {
+        HRESULT hr = S_OK;
+        CFakeAppHostElement* pElement = NULL;
+
+        for (DWORD i = 0; i < m_cElements; ++i)
+        {
+            hr = m_rgpElements[i]->Clone(&pElement);
+            ExitOnFailure(hr, "Failed to clone fake element.");
+
+            hr = pClone->AddElement(pElement, -1);
+            ExitOnFailure(hr, "Failed to add cloned fake element.");
+
+            ReleaseNullObject(pElement);
+        }
+
+    LExit:
+        ReleaseObject(pElement);
+
+        return hr;
+    }
+
+public:
+    CFakeAppHostElementCollection()
+    {
+        m_rgpElements = NULL;
+        m_cElements = 0;
+    }
+
+protected:
+    virtual ~CFakeAppHostElementCollection()
+    {
+        Clear();
+        ReleaseMem(m_rgpElements);
+    }
+
+private:
+    HRESULT GetIndex(
+        __in const VARIANT* pvtIndex,
+        __out DWORD* pdwIndex
+        )
+    {
+        HRESULT hr = S_OK;
+
+        if (VT_UI4 == pvtIndex->vt)
+        {
+            *pdwIndex = pvtIndex->ulVal;
+        }
+        else if (VT_I4 == pvtIndex->vt && 0 <= pvtIndex->lVal)
+        {
+            *pdwIndex = pvtIndex->lVal;
+        }
+        else
+        {
+            ExitWithRootFailure(hr, E_INVALIDARG, "The fake collection only supports integer indexes.");
+        }
+
+        if (m_cElements <= *pdwIndex)
+        {
+            ExitWithRootFailure(hr, E_INVALIDARG, "Fake collection index %u is out of range.", *pdwIndex);
+        }
+
+    LExit:
+        return hr;
+    }
+
+private:
+    CFakeAppHostElement** m_rgpElements;
+    DWORD m_cElements;
+};
+
+
+STDMETHODIMP CFakeAppHostElement::get_Collection(
+    __out IAppHostElementCollection** ppCollection
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!m_pCollection)
+    {
+        m_pCollection = new CFakeAppHostElementCollection();
+        ExitOnNull(m_pCollection, hr, E_OUTOFMEMORY, "Failed to create fake collection.");
+    }
+
+    m_pCollection->AddRef();
+    *ppCollection = m_pCollection;
+
+LExit:
+    return hr;
+}
+
+HRESULT CFakeAppHostElement::Clone(
+    __out CFakeAppHostElement** ppClone
+    )
+{
+    HRESULT hr = S_OK;
+    CFakeAppHostElement* pClone = NULL;
+    CFakeAppHostProperty* pProperty = NULL;
+    IAppHostElementCollection* pCollection = NULL;
+
+    pClone = new CFakeAppHostElement(m_bstrName);
+    ExitOnNull(pClone, hr, E_OUTOFMEMORY, "Failed to create fake element clone.");
+
+    for (DWORD i = 0; i < m_cProperties; ++i)
+    {
+        hr = pClone->FindProperty(m_rgpProperties[i]->Name(), m_rgpProperties[i]->Value(), &pProperty);
+        ExitOnFailure(hr, "Failed to clone fake property.");
+    }
+
+    if (m_pCollection)
+    {
+        hr = pClone->get_Collection(&pCollection);
+        ExitOnFailure(hr, "Failed to create fake collection clone.");
+
+        hr = m_pCollection->CloneInto(static_cast<CFakeAppHostElementCollection*>(pCollection));
+        ExitOnFailure(hr, "Failed to clone fake collection.");
+    }
+
+    *ppClone = pClone;
+    pClone = NULL;
+
+LExit:
+    ReleaseObject(pCollection);
+    ReleaseObject(pClone);
+
+    return hr;
+}
+
+CFakeAppHostElement::~CFakeAppHostElement()
+{
+    for (DWORD i = 0; i < m_cProperties; ++i)
+    {
+        m_rgpProperties[i]->Release();
+    }
+
+    ReleaseMem(m_rgpProperties);
+    ReleaseObject(m_pCollection);
+    ReleaseBSTR(m_bstrName);
+}
+
+
+typedef struct _FAKE_APPHOST_SECTION
+{
+    BSTR bstrName;
+    BSTR bstrPath;
+    CFakeAppHostElement* pSection;
+} FAKE_APPHOST_SECTION;
+
+class CFakeAppHostAdminManager : public CFakeAppHostObject<IAppHostWritableAdminManager>
+{
+public: // IAppHostAdminManager
+    virtual STDMETHODIMP GetAdminSection(
+        __in BSTR bstrSectionName,
+        __in BSTR bstrPath,
+        __out IAppHostElement** ppAdminSection
+        )
+    {
+        HRESULT hr = S_OK;
+        FAKE_APPHOST_SECTION* pSection = NULL;
+
+        hr = FindSection(bstrSectionName, bstrPath, &pSection);
+        ExitOnFailure(hr, "Failed to find fake section %ls at %ls", bstrSectionName, bstrPath);
+
+        if (!pSection->pSection)
+        {
+            pSection->pSection = new CFakeAppHostElement(bstrSectionName);
+            ExitOnNull(pSection->pSection, hr, E_OUTOFMEMORY, "Failed to create fake section.");
+        }
+
+        pSection->pSection->AddRef();
+        *ppAdminSection = pSection->pSection;
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP get_Metadata(
+        __in BSTR /*bstrMetadataName*/,
+        __out VARIANT* /*pValue*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP SetMetadata(
+        __in BSTR /*bstrMetadataName*/,
+        __in VARIANT /*value*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP get_ConfigManager(
+        __out IAppHostConfigManager** /*ppConfigManager*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public: // IAppHostWritableAdminManager
+    virtual STDMETHODIMP CommitChanges()
+    {
+        ++vpAppHost->cCommits;
+
+        if (vpAppHost->cConflicts)
+        {
+            --vpAppHost->cConflicts;
+            return HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+        }
+
+        ReleaseObject(vpAppHost->pCommitted);
+
+        this->AddRef();
+        vpAppHost->pCommitted = this;
+
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP get_CommitPath(
+        __out BSTR* /*pbstrCommitPath*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP put_CommitPath(
+        __in BSTR /*bstrCommitPath*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public:
+    HRESULT Load(
+        __in CFakeAppHostAdminManager* pCommitted
+        )
+    {
+        HRESULT hr = S_OK;
+        FAKE_APPHOST_SECTION* pSection = NULL;
+
+        for (DWORD i = 0; i < pCommitted->m_cSections; ++i)
+        {
+            hr = FindSection(pCommitted->m_rgSections[i].bstrName, pCommitted->m_rgSections[i].bstrPath, &pSection);
+            ExitOnFailure(hr, "Failed to add fake section.");
+
+            if (pCommitted->m_rgSections[i].pSection)
+            {
+                hr = pCommitted->m_rgSections[i].pSection->Clone(&pSection->pSection);
+                ExitOnFailure(hr, "Failed to clone fake section.");
+            }
+        }
+
+    LExit:
+        return hr;
+    }
+
+public:
+    CFakeAppHostAdminManager()
+    {
+        m_rgSections = NULL;
+        m_cSections = 0;
+    }
+
+protected:
+    virtual ~CFakeAppHostAdminManager()
+    {
+        for (DWORD i = 0; i < m_cSections; ++i)
+        {
+            ReleaseBSTR(m_rgSections[i].bstrName);
+            ReleaseBSTR(m_rgSections[i].bstrPath);
+            ReleaseObject(m_rgSections[i].pSection);
+        }
+
+        ReleaseMem(m_rgSections);
+    }
+
+private:
+    HRESULT FindSection(
+        __in LPCWSTR wzName,
+        __in LPCWSTR wzPath,
+        __out FAKE_APPHOST_SECTION** ppSection
+        )
+    {
+        HRESULT hr = S_OK;
+        FAKE_APPHOST_SECTION* pSection = NULL;
+
+        for (DWORD i = 0; i < m_cSections; ++i)
+        {
+            pSection = m_rgSections + i;
+
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, wzName, -1, pSection->bstrName, -1) &&
+                CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, wzPath, -1, pSection->bstrPath, -1))
+            {
+                ExitFunction1(*ppSection = pSection);
+            }
+        }
+
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&m_rgSections), m_cSections + 1, sizeof(FAKE_APPHOST_SECTION), 8);
+        ExitOnFailure(hr, "Failed to grow fake sections.");
+
+        pSection = m_rgSections + m_cSections;
+        ++m_cSections;
+
+        pSection->bstrName = ::SysAllocString(wzName);
+        ExitOnNull(pSection->bstrName, hr, E_OUTOFMEMORY, "Failed to copy fake section name.");
+
+        pSection->bstrPath = ::SysAllocString(wzPath);
+        ExitOnNull(pSection->bstrPath, hr, E_OUTOFMEMORY, "Failed to copy fake section path.");
+
+        *ppSection = pSection;
+
+    LExit:
+        return hr;
+    }
+
+private:
+    FAKE_APPHOST_SECTION* m_rgSections;
+    DWORD m_cSections;
+};
+
+
+void FakeAppHostInitialize(
+    __in FAKE_APPHOST* pAppHost
+    )
+{
+    vpAppHost = pAppHost;
+}
+
+void FakeAppHostUninitialize(
+    __in FAKE_APPHOST* pAppHost
+    )
+{
+    ReleaseNullObject(pAppHost->pCommitted);
+    vpAppHost = NULL;
+}
+
+HRESULT FakeAppHostCreateAdminManager(
+    __out IAppHostWritableAdminManager** ppAdminMgr
+    )
+{
+    HRESULT hr = S_OK;
+    CFakeAppHostAdminManager* pAdminMgr = NULL;
+
+    pAdminMgr = new CFakeAppHostAdminManager();
+    ExitOnNull(pAdminMgr, hr, E_OUTOFMEMORY, "Failed to create fake admin manager.");
+
+    if (vpAppHost->pCommitted)
+    {
+        hr = pAdminMgr->Load(static_cast<CFakeAppHostAdminManager*>(vpAppHost->pCommitted));
+        ExitOnFailure(hr, "Failed to load the committed fake configuration.");
+    }
+
+    ++vpAppHost->cAdminManagers;
+
+    *ppAdminMgr = pAdminMgr;
+    pAdminMgr = NULL;
+
+LExit:
+    ReleaseObject(pAdminMgr);
+
+    return hr;
+}
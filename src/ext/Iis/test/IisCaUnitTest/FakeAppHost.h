@@ -0,0 +1,26 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+// In-memory stand-in for applicationHost.config. Every admin manager starts from the
+// sections of the last manager that committed, like the real one loads the file.
+typedef struct _FAKE_APPHOST
+{
+    DWORD cConflicts; // CommitChanges calls left to fail with a sharing violation.
+
+    DWORD cAdminManagers;
+    DWORD cCommits;
+    DWORD cItemReads;
+
+    IAppHostWritableAdminManager* pCommitted;
+} FAKE_APPHOST;
+
+void FakeAppHostInitialize(
+    __in FAKE_APPHOST* pAppHost
+    );
+void FakeAppHostUninitialize(
+    __in FAKE_APPHOST* pAppHost
+    );
+HRESULT FakeAppHostCreateAdminManager(
+    __out IAppHostWritableAdminManager** ppAdminMgr
+    );
@@ -0,0 +1,25 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+#include <windows.h>
+#include <msiquery.h>
+#include <msidefs.h>
+#include <strsafe.h>
+#include <ahadmin.h>
+
+#include <dutil.h>
+#include <iis7util.h>
+#include <memutil.h>
+#include <strutil.h>
+
+#include <wcautil.h>
+
+#include "sca.h"
+#include "scaexecIIS7.h"
+
+#include "FakeAppHost.h"
+#include "WcaTestPackage.h"
+
+#pragma managed
+#include <vcclr.h>
@@ -22,5 +22,6 @@
 #include "sca.h"
 #include "scacost.h"
 #include "scasqlstr.h"
+#include "scaexec.h"
 
 #include "caDecor.h"
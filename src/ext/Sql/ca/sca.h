@@ -20,6 +20,8 @@ enum SCADB_ATTRIBUTES
     SCADB_CONFIRM_OVERWRITE = 0x00000020,
     SCADB_CREATE_ON_REINSTALL = 0x00000040,
     SCADB_DROP_ON_REINSTALL = 0x00000080,
+    SCADB_BATCH_STATEMENTS = 0x00000100,
+    SCADB_BATCH_IN_TRANSACTION = 0x00000200,
 };
 
 // sql string/script attributes definitions
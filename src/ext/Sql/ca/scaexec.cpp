@@ -2,6 +2,8 @@
 
 #include "precomp.h"
 
+static PFN_SQLCONNECTDATABASE vpfnConnectDatabase = SqlConnectDatabase;
+
 
 /********************************************************************
  * CreateDatabase - CUSTOM ACTION ENTRY POINT for creating databases
@@ -265,19 +267,108 @@ LExit:
 
 
 /********************************************************************
- ExecuteSqlStrings - CUSTOM ACTION ENTRY POINT for running SQL strings
+ ExecuteSqlBatch - executes a batch of SQL strings in one round-trip,
+                   optionally inside a transaction
+
+ *******************************************************************/
+static HRESULT ExecuteSqlBatch(
+    __in IDBCreateSession* pidbSession,
+    __in int iAttributesDB,
+    __in_z LPCWSTR wzBatch,
+    __in DWORD cStatements,
+    __out BSTR* pbstrErrorDescription
+    )
+{
+    HRESULT hr = S_OK;
+    IDBCreateCommand* pidbCommand = NULL;
+    ICommandText* picmdText = NULL;
+    ITransaction* pit = NULL;
+    BOOL fTransaction = FALSE;
+    DWORD dwStart = ::GetTickCount();
 
-  Input:  deferred CustomActionData - DbKey\tServer\tInstance\tDatabase\tAttributes\tIntegratedAuth\tUser\tPassword\tSQLKey1\tSQLString1\tSQLKey2\tSQLString2\tSQLKey3\tSQLString3\t...
-          rollback CustomActionData - same as above
+    ReleaseNullBSTR(*pbstrErrorDescription);
+
+    WcaLog(LOGMSG_VERBOSE, "Executing batch of %u SQL strings: %ls", cStatements, wzBatch);
+
+    if (iAttributesDB & SCADB_BATCH_IN_TRANSACTION)
+    {
+        hr = SqlStartTransaction(pidbSession, &pidbCommand, &pit);
+        ExitOnFailure(hr, "failed to start transaction for batch of SQL strings");
+        fTransaction = TRUE;
+
+        hr = pidbCommand->CreateCommand(NULL, IID_ICommandText, reinterpret_cast<IUnknown**>(&picmdText));
+        ExitOnFailure(hr, "failed to create command for batch of SQL strings");
+
+        hr = picmdText->SetCommandText(DBGUID_DEFAULT, wzBatch);
+        ExitOnFailure(hr, "failed to set command text for batch of SQL strings");
+
+        hr = picmdText->Execute(NULL, IID_NULL, NULL, NULL, NULL);
+        if (DB_S_ERRORSOCCURRED == hr)
+        {
+            hr = E_FAIL;
+        }
+
+        // Report the provider's error the same way SqlSessionExecuteQuery does outside a transaction.
+        if (FAILED(hr) && FAILED(SqlGetErrorInfo(picmdText, IID_ICommandText, 0x409, NULL, pbstrErrorDescription)))
+        {
+            ReleaseNullBSTR(*pbstrErrorDescription);
+        }
+    }
+    else
+    {
+        hr = SqlSessionExecuteQuery(pidbSession, wzBatch, NULL, NULL, pbstrErrorDescription);
+    }
+    ExitOnFailure(hr, "failed to execute batch of SQL strings");
+
+    if (fTransaction)
+    {
+        fTransaction = FALSE;
+
+        hr = SqlEndTransaction(pit, TRUE);
+        ExitOnFailure(hr, "failed to commit transaction for batch of SQL strings");
+    }
+
+    WcaLog(LOGMSG_STANDARD, "Executed batch of %u SQL strings in %u ms%ls", cStatements, ::GetTickCount() - dwStart, pit ? L" in a transaction" : L"");
+
+LExit:
+    if (fTransaction)
+    {
+        SqlEndTransaction(pit, FALSE);
+    }
+
+    ReleaseObject(pit);
+    ReleaseObject(picmdText);
+    ReleaseObject(pidbCommand);
+
+    return hr;
+}
+
+
+/********************************************************************
+ ScaExecFunctionOverride - overrides how database connections are made.
+   Pass NULL to go back to SqlConnectDatabase.
+
+ *******************************************************************/
+void ScaExecFunctionOverride(
+    __in_opt PFN_SQLCONNECTDATABASE pfnConnectDatabase
+    )
+{
+    vpfnConnectDatabase = pfnConnectDatabase ? pfnConnectDatabase : SqlConnectDatabase;
+}
+
+
+/********************************************************************
+ ScaExecuteSqlStrings - runs the SQL strings for one database
+
+  Input:  CustomActionData - DbKey\tServer\tInstance\tDatabase\tAttributes\tIntegratedAuth\tUser\tPassword\tSQLKey1\tSQLString1\tSQLKey2\tSQLString2\tSQLKey3\tSQLString3\t...
  * ****************************************************************/
-extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
+HRESULT ScaExecuteSqlStrings(
+    __in_z LPWSTR pwzData
+    )
 {
-//Assert(FALSE);
-    UINT er = ERROR_SUCCESS;
     HRESULT hr = S_OK;
     HRESULT hrDB = S_OK;
 
-    LPWSTR pwzData = NULL;
     IDBCreateSession* pidbSession = NULL;
     BSTR bstrErrorDescription = NULL;
 
@@ -293,19 +384,9 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
     LPWSTR pwzPassword = NULL;
     LPWSTR pwzSqlKey = NULL;
     LPWSTR pwzSql = NULL;
-    BOOL fInitializedCom = FALSE;
-
-    hr = WcaInitialize(hInstall, "ExecuteSqlStrings");
-    ExitOnFailure(hr, "failed to initialize");
-
-    hr = ::CoInitialize(NULL);
-    ExitOnFailure(hr, "failed to intialize COM");
-    fInitializedCom = TRUE;
-
-    hr = WcaGetProperty( L"CustomActionData", &pwzData);
-    ExitOnFailure(hr, "failed to get CustomActionData");
-
-    WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", pwzData);
+    LPWSTR pwzBatch = NULL;
+    LPWSTR pwzBatchKeys = NULL;
+    DWORD cBatch = 0;
 
     pwz = pwzData;
     hr = WcaReadStringFromCaData(&pwz, &pwzDatabaseKey);
@@ -327,7 +408,7 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
 
     // Store off the result of the connect, only exit if we don't care if the database connection succeeds
     // Wait to fail until later to see if we actually have work to do that is not set to continue on error
-    hrDB = SqlConnectDatabase(pwzServer, pwzInstance, pwzDatabase, fIntegratedAuth, pwzUser, pwzPassword, &pidbSession);
+    hrDB = vpfnConnectDatabase(pwzServer, pwzInstance, pwzDatabase, fIntegratedAuth, pwzUser, pwzPassword, &pidbSession);
     if ((iAttributesDB & SCADB_CONTINUE_ON_ERROR) && FAILED(hrDB))
     {
         WcaLog(LOGMSG_STANDARD, "Error 0x%x: continuing after failure to connect to database: %ls", hrDB, pwzDatabase);
@@ -352,6 +433,32 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
         // Now check if the DB connection succeeded
         MessageExitOnFailure(hr = hrDB, msierrSQLFailedConnectDatabase, "failed to connect to database: '%ls'", pwzDatabase);
 
+        // When the database allows it, consecutive strings are sent in one batch. Strings that continue on error
+        // need their own result so they end the current batch and still execute alone.
+        if ((iAttributesDB & (SCADB_BATCH_STATEMENTS | SCADB_BATCH_IN_TRANSACTION)) && !(iAttributesSQL & SCASQL_CONTINUE_ON_ERROR))
+        {
+            hr = StrAllocConcatFormatted(&pwzBatch, cBatch ? L"\r\n%ls" : L"%ls", pwzSql);
+            ExitOnFailure(hr, "failed to add SQL string to batch for key: %ls", pwzSqlKey);
+
+            hr = StrAllocConcatFormatted(&pwzBatchKeys, cBatch ? L", %ls" : L"%ls", pwzSqlKey);
+            ExitOnFailure(hr, "failed to add SQL key to batch: %ls", pwzSqlKey);
+
+            ++cBatch;
+            continue;
+        }
+
+        if (cBatch)
+        {
+            hr = ExecuteSqlBatch(pidbSession, iAttributesDB, pwzBatch, cBatch, &bstrErrorDescription);
+            MessageExitOnFailure(hr, msierrSQLFailedExecString, "failed to execute SQL string, error: %ls, SQL key: %ls SQL string: %ls", NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzBatchKeys, pwzBatch);
+
+            WcaProgressMessage(COST_SQL_STRING * cBatch, FALSE);
+
+            cBatch = 0;
+            *pwzBatch = L'\0';
+            *pwzBatchKeys = L'\0';
+        }
+
         WcaLog(LOGMSG_VERBOSE, "Executing SQL string: %ls", pwzSql);
         hr = SqlSessionExecuteQuery(pidbSession, pwzSql, NULL, NULL, &bstrErrorDescription);
         if ((iAttributesSQL & SCASQL_CONTINUE_ON_ERROR) && FAILED(hr))
@@ -368,18 +475,63 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
         hr = S_OK;
     }
 
+    if (SUCCEEDED(hr) && cBatch)
+    {
+        hr = ExecuteSqlBatch(pidbSession, iAttributesDB, pwzBatch, cBatch, &bstrErrorDescription);
+        MessageExitOnFailure(hr, msierrSQLFailedExecString, "failed to execute SQL string, error: %ls, SQL key: %ls SQL string: %ls", NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzBatchKeys, pwzBatch);
+
+        WcaProgressMessage(COST_SQL_STRING * cBatch, FALSE);
+    }
+
 LExit:
+    ReleaseStr(pwzBatchKeys);
+    ReleaseStr(pwzBatch);
     ReleaseStr(pwzDatabaseKey);
     ReleaseStr(pwzServer);
     ReleaseStr(pwzInstance);
     ReleaseStr(pwzDatabase);
     ReleaseStr(pwzUser);
     ReleaseStr(pwzPassword);
-    ReleaseStr(pwzData);
 
     ReleaseBSTR(bstrErrorDescription);
     ReleaseObject(pidbSession);
 
+    return hr;
+}
+
+
+/********************************************************************
+ ExecuteSqlStrings - CUSTOM ACTION ENTRY POINT for running SQL strings
+
+  Input:  deferred CustomActionData - DbKey\tServer\tInstance\tDatabase\tAttributes\tIntegratedAuth\tUser\tPassword\tSQLKey1\tSQLString1\tSQLKey2\tSQLString2\tSQLKey3\tSQLString3\t...
+          rollback CustomActionData - same as above
+ * ****************************************************************/
+extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
+{
+//Assert(FALSE);
+    UINT er = ERROR_SUCCESS;
+    HRESULT hr = S_OK;
+
+    LPWSTR pwzData = NULL;
+    BOOL fInitializedCom = FALSE;
+
+    hr = WcaInitialize(hInstall, "ExecuteSqlStrings");
+    ExitOnFailure(hr, "failed to initialize");
+
+    hr = ::CoInitialize(NULL);
+    ExitOnFailure(hr, "failed to intialize COM");
+    fInitializedCom = TRUE;
+
+    hr = WcaGetProperty( L"CustomActionData", &pwzData);
+    ExitOnFailure(hr, "failed to get CustomActionData");
+
+    WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", pwzData);
+
+    hr = ScaExecuteSqlStrings(pwzData);
+
+LExit:
+    ReleaseStr(pwzData);
+
     if (fInitializedCom)
     {
         ::CoUninitialize();
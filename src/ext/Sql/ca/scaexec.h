@@ -0,0 +1,20 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+typedef HRESULT (DAPI *PFN_SQLCONNECTDATABASE)(
+    __in_z LPCWSTR wzServer,
+    __in_z LPCWSTR wzInstance,
+    __in_z LPCWSTR wzDatabase,
+    __in BOOL fIntegratedAuth,
+    __in_z LPCWSTR wzUser,
+    __in_z LPCWSTR wzPassword,
+    __out IDBCreateSession** ppidbSession
+    );
+
+void ScaExecFunctionOverride(
+    __in_opt PFN_SQLCONNECTDATABASE pfnConnectDatabase
+    );
+HRESULT ScaExecuteSqlStrings(
+    __in_z LPWSTR pwzData
+    );
@@ -613,7 +613,7 @@ static HRESULT ExecuteStrings(
 
     LPCWSTR wzOldDb = NULL;
     UINT uiCost = 0;
-    WCHAR* pwzCustomActionData = NULL;
+    WCA_CADATA_WRITER customActionData = { };
     WCHAR wzNumber[64];
 
     // loop through all sql strings
@@ -650,46 +650,46 @@ static HRESULT ExecuteStrings(
                 Assert(0 == iOldRollback || 1 == iOldRollback);
 
                 // if there was custom action data before, schedule the action to write it
-                if (pwzCustomActionData && *pwzCustomActionData)
+                if (customActionData.cchData)
                 {
-                    Assert(pwzCustomActionData && *pwzCustomActionData && uiCost);
+                    Assert(uiCost);
 
-                    hr = WcaDoDeferredAction(1 == iOldRollback ? CUSTOM_ACTION_DECORATION(L"RollbackExecuteSqlStrings") : CUSTOM_ACTION_DECORATION(L"ExecuteSqlStrings"), pwzCustomActionData, uiCost);
+                    hr = WcaDoDeferredAction(1 == iOldRollback ? CUSTOM_ACTION_DECORATION(L"RollbackExecuteSqlStrings") : CUSTOM_ACTION_DECORATION(L"ExecuteSqlStrings"), customActionData.pwzData, uiCost);
                     ExitOnFailure(hr, "failed to schedule ExecuteSqlStrings action, rollback: %d", iOldRollback);
                     iOldRollback = iRollback;
 
-                    *pwzCustomActionData = L'\0';
+                    WcaCaDataWriterUninitialize(&customActionData);
                     uiCost = 0;
                 }
 
-                Assert(!pwzCustomActionData  || (pwzCustomActionData && 0 == *pwzCustomActionData) && 0 == uiCost);
+                Assert(0 == customActionData.cchData && 0 == uiCost);
 
-                hr = WcaWriteStringToCaData(psd->wzKey, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->wzKey);
                 ExitOnFailure(hr, "Failed to add SQL Server Database String to CustomActionData for Database String: %ls", psd->wzKey);
 
-                hr = WcaWriteStringToCaData(psd->wzServer, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->wzServer);
                 ExitOnFailure(hr, "Failed to add SQL Server to CustomActionData for Database String: %ls", psd->wzKey);
 
-                hr = WcaWriteStringToCaData(psd->wzInstance, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->wzInstance);
                 ExitOnFailure(hr, "Failed to add SQL Instance to CustomActionData for Database String: %ls", psd->wzKey);
 
-                hr = WcaWriteStringToCaData(psd->wzDatabase, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->wzDatabase);
                 ExitOnFailure(hr, "Failed to add SQL Database to CustomActionData for Database String: %ls", psd->wzKey);
 
                 hr = ::StringCchPrintfW(wzNumber, countof(wzNumber), L"%d", psd->iAttributes);
                 ExitOnFailure(hr, "Failed to format attributes integer value to string");
-                hr = WcaWriteStringToCaData(wzNumber, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, wzNumber);
                 ExitOnFailure(hr, "Failed to add SQL Attributes to CustomActionData for Database String: %ls", psd->wzKey);
 
                 hr = ::StringCchPrintfW(wzNumber, countof(wzNumber), L"%d", psd->fUseIntegratedAuth);
                 ExitOnFailure(hr, "Failed to format UseIntegratedAuth integer value to string");
-                hr = WcaWriteStringToCaData(wzNumber, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, wzNumber);
                 ExitOnFailure(hr, "Failed to add SQL IntegratedAuth flag to CustomActionData for Database String: %ls", psd->wzKey);
 
-                hr = WcaWriteStringToCaData(psd->scau.wzName, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->scau.wzName);
                 ExitOnFailure(hr, "Failed to add SQL UserName to CustomActionData for Database String: %ls", psd->wzKey);
 
-                hr = WcaWriteStringToCaData(psd->scau.wzPassword, &pwzCustomActionData);
+                hr = WcaCaDataWriteString(&customActionData, psd->scau.wzPassword);
                 ExitOnFailure(hr, "Failed to add SQL Password to CustomActionData for Database String: %ls", psd->wzKey);
 
                 uiCost += COST_SQL_CONNECTDB;
@@ -699,30 +699,29 @@ static HRESULT ExecuteStrings(
 
             WcaLog(LOGMSG_VERBOSE, "Scheduling SQL string: %ls", psss->pwzSql);
 
-            hr = WcaWriteStringToCaData(psss->wzKey, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, psss->wzKey);
             ExitOnFailure(hr, "Failed to add SQL Key to CustomActionData for SQL string: %ls", psss->wzKey);
 
-            hr = WcaWriteIntegerToCaData(psss->iAttributes, &pwzCustomActionData);
+            hr = WcaCaDataWriteInteger(&customActionData, psss->iAttributes);
             ExitOnFailure(hr, "failed to add attributes to CustomActionData for SQL string: %ls", psss->wzKey);
 
-            hr = WcaWriteStringToCaData(psss->pwzSql, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, psss->pwzSql);
             ExitOnFailure(hr, "Failed to to add SQL Query to CustomActionData for SQL string: %ls", psss->wzKey);
             uiCost += COST_SQL_STRING;
         }
     }
 
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
-        Assert(pwzCustomActionData && *pwzCustomActionData && uiCost);
-        hr = WcaDoDeferredAction(1 == iRollback ? CUSTOM_ACTION_DECORATION(L"RollbackExecuteSqlStrings") : CUSTOM_ACTION_DECORATION(L"ExecuteSqlStrings"), pwzCustomActionData, uiCost);
+        Assert(uiCost);
+        hr = WcaDoDeferredAction(1 == iRollback ? CUSTOM_ACTION_DECORATION(L"RollbackExecuteSqlStrings") : CUSTOM_ACTION_DECORATION(L"ExecuteSqlStrings"), customActionData.pwzData, uiCost);
         ExitOnFailure(hr, "Failed to schedule ExecuteSqlStrings action");
 
-        *pwzCustomActionData = L'\0';
         uiCost = 0;
     }
 
 LExit:
-    ReleaseStr(pwzCustomActionData);
+    WcaCaDataWriterUninitialize(&customActionData);
 
     return hr;
 }
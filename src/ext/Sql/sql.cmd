@@ -15,6 +15,7 @@ msbuild -t:Restore -p:Configuration=%_C% || exit /b
 msbuild -t:Build -p:Configuration=%_C% test\WixToolsetTest.Sql\WixToolsetTest.Sql.csproj || exit /b
 
 :: Test
+msbuild -t:Test -p:Configuration=%_C% test\SqlCaUnitTest || exit /b
 dotnet test -c %_C% --no-build test\WixToolsetTest.Sql || exit /b
 
 :: Pack
@@ -0,0 +1,12 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System::Reflection;
+using namespace System::Runtime::CompilerServices;
+using namespace System::Runtime::InteropServices;
+
+[assembly: AssemblyTitleAttribute("Windows Installer XML Sql CustomAction unit tests")];
+[assembly: AssemblyDescriptionAttribute("Sql CustomAction unit tests")];
+[assembly: AssemblyCultureAttribute("")];
+[assembly: ComVisible(false)];
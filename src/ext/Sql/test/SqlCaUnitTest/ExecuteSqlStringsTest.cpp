@@ -0,0 +1,258 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+namespace SqlCaTests
+{
+    public ref class ExecuteSqlStrings
+    {
+    public:
+        [Fact]
+        void ExecuteSqlStringsBatchesStringsPerDatabaseTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_OLEDB oleDb = { };
+            WCA_CADATA_WRITER writer = { };
+
+            try
+            {
+                hInstall = OpenExecuteSqlStringsTestSession(packagePath, &oleDb);
+
+                // Scheduling starts new CustomActionData whenever the database changes, so each
+                // database's strings are executed by their own action and end up in their own batch.
+                WriteDatabase(&writer, L"TestDbA", SCADB_BATCH_STATEMENTS);
+                WriteSqlString(&writer, L"A1", 0, L"INSERT INTO a VALUES (1)");
+                WriteSqlString(&writer, L"A2", 0, L"INSERT INTO a VALUES (2)");
+                WriteSqlString(&writer, L"A3", 0, L"INSERT INTO a VALUES (3)");
+
+                hr = ScaExecuteSqlStrings(writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to execute SQL strings for the first database.");
+
+                WcaCaDataWriterUninitialize(&writer);
+
+                WriteDatabase(&writer, L"TestDbB", SCADB_BATCH_STATEMENTS);
+                WriteSqlString(&writer, L"B1", 0, L"INSERT INTO b VALUES (1)");
+                WriteSqlString(&writer, L"B2", 0, L"INSERT INTO b VALUES (2)");
+
+                hr = ScaExecuteSqlStrings(writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to execute SQL strings for the second database.");
+
+                Assert::Equal<DWORD>(2, oleDb.cConnections);
+                Assert::Equal<DWORD>(2, oleDb.cCommands);
+                Assert::Equal<DWORD>(0, oleDb.cTransactions);
+
+                VerifyCommand(&oleDb, 0, L"TestDbA", L"INSERT INTO a VALUES (1)\r\nINSERT INTO a VALUES (2)\r\nINSERT INTO a VALUES (3)", FALSE);
+                VerifyCommand(&oleDb, 1, L"TestDbB", L"INSERT INTO b VALUES (1)\r\nINSERT INTO b VALUES (2)", FALSE);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseExecuteSqlStringsTestSession(hInstall, packagePath, &oleDb);
+            }
+        }
+
+        [Fact]
+        void ExecuteSqlStringsFlushesBatchBeforeContinueOnErrorStringTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_OLEDB oleDb = { };
+            WCA_CADATA_WRITER writer = { };
+
+            try
+            {
+                hInstall = OpenExecuteSqlStringsTestSession(packagePath, &oleDb);
+
+                WriteDatabase(&writer, L"TestDb", SCADB_BATCH_STATEMENTS);
+                WriteSqlString(&writer, L"S1", 0, L"UPDATE t SET v = 1");
+                WriteSqlString(&writer, L"S2", 0, L"UPDATE t SET v = 2");
+                WriteSqlString(&writer, L"C1", SCASQL_CONTINUE_ON_ERROR, L"DROP TABLE missing");
+                WriteSqlString(&writer, L"S3", 0, L"UPDATE t SET v = 3");
+
+                // The string that continues on error fails on its own without stopping the rest.
+                oleDb.wzFailCommand = L"missing";
+
+                hr = ScaExecuteSqlStrings(writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to execute SQL strings.");
+
+                Assert::Equal<DWORD>(1, oleDb.cConnections);
+                Assert::Equal<DWORD>(3, oleDb.cCommands);
+
+                VerifyCommand(&oleDb, 0, L"TestDb", L"UPDATE t SET v = 1\r\nUPDATE t SET v = 2", FALSE);
+                VerifyCommand(&oleDb, 1, L"TestDb", L"DROP TABLE missing", FALSE);
+                VerifyCommand(&oleDb, 2, L"TestDb", L"UPDATE t SET v = 3", FALSE);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseExecuteSqlStringsTestSession(hInstall, packagePath, &oleDb);
+            }
+        }
+
+        [Fact]
+        void ExecuteSqlStringsCommitsBatchInTransactionTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_OLEDB oleDb = { };
+            WCA_CADATA_WRITER writer = { };
+
+            try
+            {
+                hInstall = OpenExecuteSqlStringsTestSession(packagePath, &oleDb);
+
+                WriteDatabase(&writer, L"TestDb", SCADB_BATCH_IN_TRANSACTION);
+                WriteSqlString(&writer, L"S1", 0, L"CREATE TABLE t (v int)");
+                WriteSqlString(&writer, L"S2", 0, L"INSERT INTO t VALUES (1)");
+
+                hr = ScaExecuteSqlStrings(writer.pwzData);
+                NativeAssert::Succeeded(hr, "Failed to execute SQL strings.");
+
+                Assert::Equal<DWORD>(1, oleDb.cCommands);
+                Assert::Equal<DWORD>(1, oleDb.cTransactions);
+                Assert::Equal<DWORD>(1, oleDb.cCommits);
+                Assert::Equal<DWORD>(0, oleDb.cAborts);
+
+                VerifyCommand(&oleDb, 0, L"TestDb", L"CREATE TABLE t (v int)\r\nINSERT INTO t VALUES (1)", TRUE);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseExecuteSqlStringsTestSession(hInstall, packagePath, &oleDb);
+            }
+        }
+
+        [Fact]
+        void ExecuteSqlStringsRollsBackFailedBatchTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            FAKE_OLEDB oleDb = { };
+            WCA_CADATA_WRITER writer = { };
+
+            try
+            {
+                hInstall = OpenExecuteSqlStringsTestSession(packagePath, &oleDb);
+
+                WriteDatabase(&writer, L"TestDb", SCADB_BATCH_IN_TRANSACTION);
+                WriteSqlString(&writer, L"S1", 0, L"INSERT INTO t VALUES (1)");
+                WriteSqlString(&writer, L"S2", 0, L"INSERT INTO missing VALUES (2)");
+                WriteSqlString(&writer, L"S3", 0, L"INSERT INTO t VALUES (3)");
+
+                oleDb.wzFailCommand = L"missing";
+
+                hr = ScaExecuteSqlStrings(writer.pwzData);
+                Assert::Equal<HRESULT>(DB_E_ERRORSINCOMMAND, hr);
+
+                Assert::Equal<DWORD>(1, oleDb.cCommands);
+                Assert::Equal<DWORD>(1, oleDb.cTransactions);
+                Assert::Equal<DWORD>(0, oleDb.cCommits);
+                Assert::Equal<DWORD>(1, oleDb.cAborts);
+
+                VerifyCommand(&oleDb, 0, L"TestDb", L"INSERT INTO t VALUES (1)\r\nINSERT INTO missing VALUES (2)\r\nINSERT INTO t VALUES (3)", TRUE);
+            }
+            finally
+            {
+                WcaCaDataWriterUninitialize(&writer);
+                CloseExecuteSqlStringsTestSession(hInstall, packagePath, &oleDb);
+            }
+        }
+
+    private:
+        MSIHANDLE OpenExecuteSqlStringsTestSession(String^ packagePath, FAKE_OLEDB* pOleDb)
+        {
+            HRESULT hr = S_OK;
+            pin_ptr<const WCHAR> wzPackagePath = PtrToStringChars(packagePath);
+            MSIHANDLE hDatabase = NULL;
+            MSIHANDLE hInstall = NULL;
+
+            try
+            {
+                hr = WcaTestCreatePackage(wzPackagePath, &hDatabase);
+                NativeAssert::Succeeded(hr, "Failed to create test package.");
+
+                hr = WcaTestOpenSession(wzPackagePath, &hDatabase, &hInstall);
+                NativeAssert::Succeeded(hr, "Failed to open session on test package.");
+            }
+            finally
+            {
+                if (hDatabase)
+                {
+                    ::MsiCloseHandle(hDatabase);
+                }
+            }
+
+            FakeOleDbInitialize(pOleDb);
+            ScaExecFunctionOverride(FakeOleDbConnectDatabase);
+
+            return hInstall;
+        }
+
+        void CloseExecuteSqlStringsTestSession(MSIHANDLE hInstall, String^ packagePath, FAKE_OLEDB* pOleDb)
+        {
+            ScaExecFunctionOverride(NULL);
+            FakeOleDbUninitialize(pOleDb);
+
+            WcaTestCloseSession(hInstall);
+
+            if (File::Exists(packagePath))
+            {
+                File::Delete(packagePath);
+            }
+        }
+
+        void WriteInteger(WCA_CADATA_WRITER* pWriter, int iValue)
+        {
+            HRESULT hr = WcaCaDataWriteInteger(pWriter, iValue);
+            NativeAssert::Succeeded(hr, "Failed to write integer.");
+        }
+
+        void WriteString(WCA_CADATA_WRITER* pWriter, LPCWSTR wzValue)
+        {
+            HRESULT hr = WcaCaDataWriteString(pWriter, wzValue);
+            NativeAssert::Succeeded(hr, "Failed to write string.");
+        }
+
+        // Writes the connection header the same way ExecuteStrings schedules it.
+        void WriteDatabase(WCA_CADATA_WRITER* pWriter, LPCWSTR wzDatabase, int iAttributes)
+        {
+            WriteString(pWriter, wzDatabase);
+            WriteString(pWriter, L"TestServer");
+            WriteString(pWriter, L"");
+            WriteString(pWriter, wzDatabase);
+            WriteInteger(pWriter, iAttributes);
+            WriteInteger(pWriter, TRUE);
+            WriteString(pWriter, L"");
+            WriteString(pWriter, L"");
+        }
+
+        void WriteSqlString(WCA_CADATA_WRITER* pWriter, LPCWSTR wzKey, int iAttributes, LPCWSTR wzSql)
+        {
+            WriteString(pWriter, wzKey);
+            WriteInteger(pWriter, SCASQL_EXECUTE_ON_INSTALL | iAttributes);
+            WriteString(pWriter, wzSql);
+        }
+
+        void VerifyCommand(FAKE_OLEDB* pOleDb, DWORD iCommand, LPCWSTR wzDatabase, LPCWSTR wzCommandText, BOOL fTransaction)
+        {
+            FAKE_OLEDB_COMMAND* pCommand = NULL;
+
+            Assert::True(iCommand < pOleDb->cCommands);
+
+            pCommand = pOleDb->rgCommands + iCommand;
+            NativeAssert::StringEqual(wzDatabase, pCommand->sczDatabase);
+            NativeAssert::StringEqual(wzCommandText, pCommand->sczCommandText);
+            Assert::Equal<BOOL>(fTransaction, pCommand->fTransaction);
+        }
+    };
+}
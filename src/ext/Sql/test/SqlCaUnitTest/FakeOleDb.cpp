@@ -0,0 +1,486 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+static FAKE_OLEDB* vpOleDb = NULL;
+
+
+template <class T> class CFakeOleDbObject : public T
+{
+public: // IUnknown
+    virtual STDMETHODIMP QueryInterface(
+        __in REFIID riid,
+        __out LPVOID *ppvObject
+        )
+    {
+        if (!ppvObject)
+        {
+            return E_INVALIDARG;
+        }
+
+        *ppvObject = NULL;
+
+        if (::IsEqualIID(__uuidof(T), riid) || ::IsEqualIID(IID_IUnknown, riid))
+        {
+            *ppvObject = static_cast<T*>(this);
+        }
+        else if (!QueryOtherInterface(riid, ppvObject)) // no interface for requested iid
+        {
+            return E_NOINTERFACE;
+        }
+
+        this->AddRef();
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP_(ULONG) AddRef()
+    {
+        return ::InterlockedIncrement(&this->m_cReferences);
+    }
+
+    virtual STDMETHODIMP_(ULONG) Release()
+    {
+        long l = ::InterlockedDecrement(&this->m_cReferences);
+        if (0 < l)
+        {
+            return l;
+        }
+
+        delete this;
+        return 0;
+    }
+
+protected:
+    CFakeOleDbObject()
+    {
+        m_cReferences = 1;
+    }
+
+    virtual ~CFakeOleDbObject()
+    {
+    }
+
+    // Objects that implement more than one interface hand out the others here.
+    virtual BOOL QueryOtherInterface(
+        __in REFIID /*riid*/,
+        __out LPVOID* /*ppvObject*/
+        )
+    {
+        return FALSE;
+    }
+
+private:
+    long m_cReferences;
+};
+
+
+class CFakeOleDbSession : public CFakeOleDbObject<IDBCreateCommand>, public ITransactionLocal
+{
+public: // IUnknown
+    virtual STDMETHODIMP QueryInterface(
+        __in REFIID riid,
+        __out LPVOID *ppvObject
+        )
+    {
+        return CFakeOleDbObject<IDBCreateCommand>::QueryInterface(riid, ppvObject);
+    }
+
+    virtual STDMETHODIMP_(ULONG) AddRef()
+    {
+        return CFakeOleDbObject<IDBCreateCommand>::AddRef();
+    }
+
+    virtual STDMETHODIMP_(ULONG) Release()
+    {
+        return CFakeOleDbObject<IDBCreateCommand>::Release();
+    }
+
+public: // IDBCreateCommand
+    virtual STDMETHODIMP CreateCommand(
+        __in_opt IUnknown* pUnkOuter,
+        __in REFIID riid,
+        __out IUnknown** ppCommand
+        );
+
+public: // ITransaction
+    virtual STDMETHODIMP Commit(
+        __in BOOL /*fRetaining*/,
+        __in DWORD /*grfTC*/,
+        __in DWORD /*grfRM*/
+        )
+    {
+        if (!m_fTransaction)
+        {
+            return XACT_E_NOTRANSACTION;
+        }
+
+        m_fTransaction = FALSE;
+        ++vpOleDb->cCommits;
+
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP Abort(
+        __in_opt BOID* /*pboidReason*/,
+        __in BOOL /*fRetaining*/,
+        __in BOOL /*fAsync*/
+        )
+    {
+        if (!m_fTransaction)
+        {
+            return XACT_E_NOTRANSACTION;
+        }
+
+        m_fTransaction = FALSE;
+        ++vpOleDb->cAborts;
+
+        return S_OK;
+    }
+
+    virtual STDMETHODIMP GetTransactionInfo(
+        __out XACTTRANSINFO* /*pinfo*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public: // ITransactionLocal
+    virtual STDMETHODIMP GetOptionsObject(
+        __out ITransactionOptions** /*ppOptions*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP StartTransaction(
+        __in ISOLEVEL /*isoLevel*/,
+        __in ULONG /*isoFlags*/,
+        __in_opt ITransactionOptions* /*pOtherOptions*/,
+        __out_opt ULONG* pulTransactionLevel
+        )
+    {
+        // Like SQL Server's provider, a session only supports one level of transaction.
+        if (m_fTransaction)
+        {
+            return XACT_E_XTIONEXISTS;
+        }
+
+        m_fTransaction = TRUE;
+        ++vpOleDb->cTransactions;
+
+        if (pulTransactionLevel)
+        {
+            *pulTransactionLevel = 1;
+        }
+
+        return S_OK;
+    }
+
+public:
+    HRESULT Execute(
+        __in_z LPCWSTR wzCommandText
+        )
+    {
+        HRESULT hr = S_OK;
+        FAKE_OLEDB_COMMAND* pCommand = NULL;
+
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&vpOleDb->rgCommands), vpOleDb->cCommands + 1, sizeof(FAKE_OLEDB_COMMAND), 8);
+        ExitOnFailure(hr, "Failed to grow fake commands.");
+
+        pCommand = vpOleDb->rgCommands + vpOleDb->cCommands;
+        ++vpOleDb->cCommands;
+
+        hr = StrAllocString(&pCommand->sczDatabase, m_sczDatabase, 0);
+        ExitOnFailure(hr, "Failed to copy fake command database.");
+
+        hr = StrAllocString(&pCommand->sczCommandText, wzCommandText, 0);
+        ExitOnFailure(hr, "Failed to copy fake command text.");
+
+        pCommand->fTransaction = m_fTransaction;
+
+        if (vpOleDb->wzFailCommand && wcsstr(wzCommandText, vpOleDb->wzFailCommand))
+        {
+            hr = DB_E_ERRORSINCOMMAND;
+        }
+
+    LExit:
+        return hr;
+    }
+
+    HRESULT Initialize(
+        __in_z LPCWSTR wzDatabase
+        )
+    {
+        return StrAllocString(&m_sczDatabase, wzDatabase, 0);
+    }
+
+public:
+    CFakeOleDbSession()
+    {
+        m_sczDatabase = NULL;
+        m_fTransaction = FALSE;
+    }
+
+protected:
+    virtual ~CFakeOleDbSession()
+    {
+        ReleaseStr(m_sczDatabase);
+    }
+
+    virtual BOOL QueryOtherInterface(
+        __in REFIID riid,
+        __out LPVOID* ppvObject
+        )
+    {
+        if (::IsEqualIID(IID_ITransactionLocal, riid) || ::IsEqualIID(IID_ITransaction, riid))
+        {
+            *ppvObject = static_cast<ITransactionLocal*>(this);
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+
+private:
+    LPWSTR m_sczDatabase;
+    BOOL m_fTransaction;
+};
+
+
+class CFakeOleDbCommand : public CFakeOleDbObject<ICommandText>
+{
+public: // ICommand
+    virtual STDMETHODIMP Cancel()
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP Execute(
+        __in_opt IUnknown* /*pUnkOuter*/,
+        __in REFIID /*riid*/,
+        __inout_opt DBPARAMS* /*pParams*/,
+        __out_opt DBROWCOUNT* pcRowsAffected,
+        __out_opt IUnknown** ppRowset
+        )
+    {
+        if (pcRowsAffected)
+        {
+            *pcRowsAffected = 0;
+        }
+
+        if (ppRowset)
+        {
+            *ppRowset = NULL;
+        }
+
+        if (!m_sczCommandText)
+        {
+            return DB_E_NOCOMMAND;
+        }
+
+        return m_pSession->Execute(m_sczCommandText);
+    }
+
+    virtual STDMETHODIMP GetDBSession(
+        __in REFIID /*riid*/,
+        __out IUnknown** /*ppSession*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+public: // ICommandText
+    virtual STDMETHODIMP GetCommandText(
+        __inout_opt GUID* /*pguidDialect*/,
+        __out LPOLESTR* /*ppwszCommand*/
+        )
+    {
+        return E_NOTIMPL;
+    }
+
+    virtual STDMETHODIMP SetCommandText(
+        __in REFGUID /*rguidDialect*/,
+        __in_z_opt LPCOLESTR pwszCommand
+        )
+    {
+        if (!pwszCommand)
+        {
+            ReleaseNullStr(m_sczCommandText);
+            return S_OK;
+        }
+
+        return StrAllocString(&m_sczCommandText, pwszCommand, 0);
+    }
+
+public:
+    CFakeOleDbCommand(
+        __in CFakeOleDbSession* pSession
+        )
+    {
+        m_pSession = pSession;
+        m_pSession->AddRef();
+        m_sczCommandText = NULL;
+    }
+
+protected:
+    virtual ~CFakeOleDbCommand()
+    {
+        ReleaseStr(m_sczCommandText);
+        ReleaseObject(m_pSession);
+    }
+
+    virtual BOOL QueryOtherInterface(
+        __in REFIID riid,
+        __out LPVOID* ppvObject
+        )
+    {
+        if (::IsEqualIID(IID_ICommand, riid))
+        {
+            *ppvObject = static_cast<ICommandText*>(this);
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+
+private:
+    CFakeOleDbSession* m_pSession;
+    LPWSTR m_sczCommandText;
+};
+
+
+STDMETHODIMP CFakeOleDbSession::CreateCommand(
+    __in_opt IUnknown* pUnkOuter,
+    __in REFIID riid,
+    __out IUnknown** ppCommand
+    )
+{
+    HRESULT hr = S_OK;
+    CFakeOleDbCommand* pCommand = NULL;
+
+    if (pUnkOuter)
+    {
+        ExitFunction1(hr = DB_E_NOAGGREGATION);
+    }
+
+    pCommand = new CFakeOleDbCommand(this);
+    ExitOnNull(pCommand, hr, E_OUTOFMEMORY, "Failed to create fake command.");
+
+    hr = pCommand->QueryInterface(riid, reinterpret_cast<LPVOID*>(ppCommand));
+
+LExit:
+    ReleaseObject(pCommand);
+
+    return hr;
+}
+
+
+class CFakeOleDbDataSource : public CFakeOleDbObject<IDBCreateSession>
+{
+public: // IDBCreateSession
+    virtual STDMETHODIMP CreateSession(
+        __in_opt IUnknown* pUnkOuter,
+        __in REFIID riid,
+        __out IUnknown** ppDBSession
+        )
+    {
+        HRESULT hr = S_OK;
+        CFakeOleDbSession* pSession = NULL;
+
+        if (pUnkOuter)
+        {
+            ExitFunction1(hr = DB_E_NOAGGREGATION);
+        }
+
+        pSession = new CFakeOleDbSession();
+        ExitOnNull(pSession, hr, E_OUTOFMEMORY, "Failed to create fake session.");
+
+        hr = pSession->Initialize(m_sczDatabase);
+        ExitOnFailure(hr, "Failed to initialize fake session.");
+
+        hr = pSession->QueryInterface(riid, reinterpret_cast<LPVOID*>(ppDBSession));
+
+    LExit:
+        ReleaseObject(pSession);
+
+        return hr;
+    }
+
+public:
+    HRESULT Initialize(
+        __in_z LPCWSTR wzDatabase
+        )
+    {
+        return StrAllocString(&m_sczDatabase, wzDatabase, 0);
+    }
+
+public:
+    CFakeOleDbDataSource()
+    {
+        m_sczDatabase = NULL;
+    }
+
+protected:
+    virtual ~CFakeOleDbDataSource()
+    {
+        ReleaseStr(m_sczDatabase);
+    }
+
+private:
+    LPWSTR m_sczDatabase;
+};
+
+
+void FakeOleDbInitialize(
+    __in FAKE_OLEDB* pOleDb
+    )
+{
+    vpOleDb = pOleDb;
+}
+
+void FakeOleDbUninitialize(
+    __in FAKE_OLEDB* pOleDb
+    )
+{
+    for (DWORD i = 0; i < pOleDb->cCommands; ++i)
+    {
+        ReleaseStr(pOleDb->rgCommands[i].sczDatabase);
+        ReleaseStr(pOleDb->rgCommands[i].sczCommandText);
+    }
+
+    ReleaseMem(pOleDb->rgCommands);
+    pOleDb->rgCommands = NULL;
+    pOleDb->cCommands = 0;
+
+    vpOleDb = NULL;
+}
+
+HRESULT DAPI FakeOleDbConnectDatabase(
+    __in_z LPCWSTR /*wzServer*/,
+    __in_z LPCWSTR /*wzInstance*/,
+    __in_z LPCWSTR wzDatabase,
+    __in BOOL /*fIntegratedAuth*/,
+    __in_z LPCWSTR /*wzUser*/,
+    __in_z LPCWSTR /*wzPassword*/,
+    __out IDBCreateSession** ppidbSession
+    )
+{
+    HRESULT hr = S_OK;
+    CFakeOleDbDataSource* pDataSource = NULL;
+
+    pDataSource = new CFakeOleDbDataSource();
+    ExitOnNull(pDataSource, hr, E_OUTOFMEMORY, "Failed to create fake data source.");
+
+    hr = pDataSource->Initialize(wzDatabase);
+    ExitOnFailure(hr, "Failed to initialize fake data source.");
+
+    ++vpOleDb->cConnections;
+
+    *ppidbSession = pDataSource;
+    pDataSource = NULL;
+
+LExit:
+    ReleaseObject(pDataSource);
+
+    return hr;
+}
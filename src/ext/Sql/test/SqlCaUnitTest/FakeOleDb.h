@@ -0,0 +1,42 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+// A command text the fake provider was asked to execute.
+typedef struct _FAKE_OLEDB_COMMAND
+{
+    LPWSTR sczDatabase;
+    LPWSTR sczCommandText;
+    BOOL fTransaction; // Executed inside a transaction that was started on its session.
+} FAKE_OLEDB_COMMAND;
+
+// In-memory stand-in for the SQL Server OLE DB provider. Nothing is executed, every
+// command is recorded in order along with the transactions started around it.
+typedef struct _FAKE_OLEDB
+{
+    LPCWSTR wzFailCommand; // Command text that contains this fails to execute.
+
+    DWORD cConnections;
+    DWORD cTransactions;
+    DWORD cCommits;
+    DWORD cAborts;
+
+    FAKE_OLEDB_COMMAND* rgCommands;
+    DWORD cCommands;
+} FAKE_OLEDB;
+
+void FakeOleDbInitialize(
+    __in FAKE_OLEDB* pOleDb
+    );
+void FakeOleDbUninitialize(
+    __in FAKE_OLEDB* pOleDb
+    );
+HRESULT DAPI FakeOleDbConnectDatabase(
+    __in_z LPCWSTR wzServer,
+    __in_z LPCWSTR wzInstance,
+    __in_z LPCWSTR wzDatabase,
+    __in BOOL fIntegratedAuth,
+    __in_z LPCWSTR wzUser,
+    __in_z LPCWSTR wzPassword,
+    __out IDBCreateSession** ppidbSession
+    );
@@ -0,0 +1,24 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+#include <windows.h>
+#include <msiquery.h>
+#include <msidefs.h>
+#include <strsafe.h>
+
+#include <dutil.h>
+#include <memutil.h>
+#include <sqlutil.h>
+#include <strutil.h>
+
+#include <wcautil.h>
+
+#include "sca.h"
+#include "scaexec.h"
+
+#include "FakeOleDb.h"
+#include "WcaTestPackage.h"
+
+#pragma managed
+#include <vcclr.h>
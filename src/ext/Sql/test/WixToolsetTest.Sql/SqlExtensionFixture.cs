@@ -27,6 +27,24 @@ namespace WixToolsetTest.Sql
             }, results.ToArray());
         }
 
+        [Fact]
+        public void CanBuildWithBatchedSqlStrings()
+        {
+            var folder = TestData.Get(@"TestData\UsingSqlBatch");
+            var build = new Builder(folder, typeof(SqlExtensionFactory), new[] { folder });
+
+            var results = build.BuildAndQuery(Build, "Wix4SqlDatabase", "Wix4SqlString");
+            WixAssert.CompareLineByLine(new[]
+            {
+                "Wix4SqlDatabase:BatchDB\tMySQLHostName\t\tBatchDB\tDatabaseComponent\t\t\t\t257",
+                "Wix4SqlDatabase:TransactionDB\tMySQLHostName\t\tTransactionDB\tDatabaseComponent\t\t\t\t769",
+                "Wix4SqlString:BatchString1\tBatchDB\tDatabaseComponent\tCREATE TABLE TestTable1(name varchar(20))\t\t1\t1",
+                "Wix4SqlString:BatchString2\tBatchDB\tDatabaseComponent\tCREATE TABLE TestTable2(name varchar(20))\t\t1\t2",
+                "Wix4SqlString:TransactionString1\tTransactionDB\tDatabaseComponent\tCREATE TABLE TestTable3(name varchar(20))\t\t1\t1",
+                "Wix4SqlString:TransactionString2\tTransactionDB\tDatabaseComponent\tCREATE TABLE TestTable4(name varchar(20))\t\t5\t2",
+            }, results.OrderBy(s => s).ToArray());
+        }
+
         private static void Build(string[] args)
         {
             var result = WixRunner.Execute(args)
@@ -24,6 +24,8 @@ namespace WixToolset.Sql
         internal const int DbConfirmOverwrite = 0x00000020;
         internal const int DbCreateOnReinstall = 0x00000040;
         internal const int DbDropOnReinstall = 0x00000080;
+        internal const int DbBatchStatements = 0x00000100;
+        internal const int DbBatchInTransaction = 0x00000200;
 
         // sql string/script attributes definitions (from sca.h)
         internal const int SqlExecuteOnInstall = 0x00000001;
@@ -112,6 +114,28 @@ namespace WixToolset.Sql
                         case "Id":
                             id = this.ParseHelper.GetAttributeIdentifier(sourceLineNumbers, attrib);
                             break;
+                        case "BatchStatements":
+                            if (null == componentId)
+                            {
+                                this.Messaging.Write(SqlErrors.IllegalAttributeWithoutComponent(sourceLineNumbers, element.Name.LocalName, attrib.Name.LocalName));
+                            }
+
+                            if (YesNoType.Yes == this.ParseHelper.GetAttributeYesNoValue(sourceLineNumbers, attrib))
+                            {
+                                attributes |= DbBatchStatements;
+                            }
+                            break;
+                        case "BatchInTransaction":
+                            if (null == componentId)
+                            {
+                                this.Messaging.Write(SqlErrors.IllegalAttributeWithoutComponent(sourceLineNumbers, element.Name.LocalName, attrib.Name.LocalName));
+                            }
+
+                            if (YesNoType.Yes == this.ParseHelper.GetAttributeYesNoValue(sourceLineNumbers, attrib))
+                            {
+                                attributes |= DbBatchStatements | DbBatchInTransaction;
+                            }
+                            break;
                         case "ConfirmOverwrite":
                             if (null == componentId)
                             {
@@ -142,6 +142,16 @@ namespace WixToolset.Sql
                     {
                         sqlDatabase.DropOnReinstall = Sql.YesNoType.yes;
                     }
+
+                    // BatchInTransaction also sets the batch statements bit.
+                    if (SqlCompiler.DbBatchInTransaction == (attributes & SqlCompiler.DbBatchInTransaction))
+                    {
+                        sqlDatabase.BatchInTransaction = Sql.YesNoType.yes;
+                    }
+                    else if (SqlCompiler.DbBatchStatements == (attributes & SqlCompiler.DbBatchStatements))
+                    {
+                        sqlDatabase.BatchStatements = Sql.YesNoType.yes;
+                    }
                 }
 
                 if (null != row[4])
@@ -80,12 +80,64 @@ BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam)
     return fContinueWindowsInProcess;
 }
 
+/******************************************************************
+ EnsureProcessSnapshot - captures the running processes unless a
+ snapshot is already available. Callers release the snapshot once
+ they may have changed which processes are running so the next
+ lookup sees a fresh one.
+
+******************************************************************/
+static HRESULT EnsureProcessSnapshot(
+    __inout PROC_SNAPSHOT_HANDLE* phSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwStart = 0;
+
+    if (!*phSnapshot)
+    {
+        dwStart = ::GetTickCount();
+
+        hr = ProcSnapshotCreate(phSnapshot);
+        ExitOnFailure(hr, "Failed to capture running processes.");
+
+        WcaLog(LOGMSG_VERBOSE, "Enumerated %u running processes in %u ms", ProcSnapshotGetProcessCount(*phSnapshot), ::GetTickCount() - dwStart);
+    }
+
+LExit:
+    return hr;
+}
+
+/******************************************************************
+ FindRunningProcessIds - returns the process ids currently running
+ the specified executable.
+
+******************************************************************/
+static HRESULT FindRunningProcessIds(
+    __inout PROC_SNAPSHOT_HANDLE* phSnapshot,
+    __in_z LPCWSTR wzApplication,
+    __out const DWORD** prgProcessIds,
+    __out DWORD* pcProcessIds
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = EnsureProcessSnapshot(phSnapshot);
+    if (SUCCEEDED(hr))
+    {
+        hr = ProcSnapshotFindIds(*phSnapshot, wzApplication, prgProcessIds, pcProcessIds);
+    }
+
+    return hr;
+}
+
 /******************************************************************
  PromptToContinue - displays the prompt if the application is still
   running.
 
 ******************************************************************/
 static HRESULT PromptToContinue(
+    __inout PROC_SNAPSHOT_HANDLE* phSnapshot,
     __in_z LPCWSTR wzApplication,
     __in_z LPCWSTR wzPrompt
     )
@@ -93,7 +145,7 @@ static HRESULT PromptToContinue(
     HRESULT hr = S_OK;
     UINT er = ERROR_SUCCESS;
     PMSIHANDLE hRecMessage = NULL;
-    DWORD *prgProcessIds = NULL;
+    const DWORD *prgProcessIds = NULL;
     DWORD cProcessIds = 0;
 
     hRecMessage = ::MsiCreateRecord(1);
@@ -104,9 +156,12 @@ static HRESULT PromptToContinue(
 
     do
     {
-        hr = ProcFindAllIdsFromExeName(wzApplication, &prgProcessIds, &cProcessIds);
+        hr = FindRunningProcessIds(phSnapshot, wzApplication, &prgProcessIds, &cProcessIds);
         if (SUCCEEDED(hr) && 0 < cProcessIds)
         {
+            // The user may close the application before answering.
+            ReleaseNullProcSnapshot(*phSnapshot);
+
             er = WcaProcessMessage(static_cast<INSTALLMESSAGE>(INSTALLMESSAGE_WARNING | MB_ABORTRETRYIGNORE | MB_DEFBUTTON3 | MB_ICONWARNING), hRecMessage);
             if (IDABORT == er)
             {
@@ -125,13 +180,9 @@ static HRESULT PromptToContinue(
                 ExitOnWin32Error(er, hr, "Unexpected return value from prompt to continue.");
             }
         }
-
-        ReleaseNullMem(prgProcessIds);
-        cProcessIds = 0;
     } while (S_FALSE == hr);
 
 LExit:
-    ReleaseMem(prgProcessIds);
     return hr;
 }
 
@@ -171,18 +222,19 @@ void SendProcessMessage(
 
 ******************************************************************/
 void SendApplicationMessage(
+    __inout PROC_SNAPSHOT_HANDLE* phSnapshot,
     __in LPCWSTR wzApplication,
     __in DWORD dwMessageId,
     __in DWORD dwTimeout
     )
 {
-    DWORD *prgProcessIds = NULL;
+    const DWORD *prgProcessIds = NULL;
     DWORD cProcessIds = 0, iProcessId;
     HRESULT hr = S_OK;
 
     WcaLog(LOGMSG_VERBOSE, "Checking App: %ls ", wzApplication);
 
-    hr = ProcFindAllIdsFromExeName(wzApplication, &prgProcessIds, &cProcessIds);
+    hr = FindRunningProcessIds(phSnapshot, wzApplication, &prgProcessIds, &cProcessIds);
 
     if (SUCCEEDED(hr) && 0 < cProcessIds)
     {
@@ -194,9 +246,10 @@ void SendApplicationMessage(
         }
 
         ProcWaitForIds(prgProcessIds, cProcessIds, dwTimeout);
-    }
 
-    ReleaseMem(prgProcessIds);
+        // Some of the processes may have exited.
+        ReleaseNullProcSnapshot(*phSnapshot);
+    }
 }
 
 /******************************************************************
@@ -205,25 +258,24 @@ void SendApplicationMessage(
  running. Useful to show custom UI to ask for shutdown.
 ******************************************************************/
 void SetRunningProcessProperty(
+    __inout PROC_SNAPSHOT_HANDLE* phSnapshot,
     __in LPCWSTR wzApplication,
     __in LPCWSTR wzProperty
     )
 {
-    DWORD *prgProcessIds = NULL;
+    const DWORD *prgProcessIds = NULL;
     DWORD cProcessIds = 0;
     HRESULT hr = S_OK;
 
     WcaLog(LOGMSG_VERBOSE, "Checking App: %ls ", wzApplication);
 
-    hr = ProcFindAllIdsFromExeName(wzApplication, &prgProcessIds, &cProcessIds);
+    hr = FindRunningProcessIds(phSnapshot, wzApplication, &prgProcessIds, &cProcessIds);
 
     if (SUCCEEDED(hr) && 0 < cProcessIds)
     {
         WcaLog(LOGMSG_VERBOSE, "App: %ls found running, %d processes, setting '%ls' property.", wzApplication, cProcessIds, wzProperty);
         WcaSetIntProperty(wzProperty, cProcessIds);
     }
-
-    ReleaseMem(prgProcessIds);
 }
 
 /******************************************************************
@@ -231,7 +283,7 @@ void SetRunningProcessProperty(
  process ids such that they return a particular exit code.
 ******************************************************************/
 void TerminateProcesses(
-    __in_ecount(cProcessIds) DWORD rgdwProcessIds[],
+    __in_ecount(cProcessIds) const DWORD rgdwProcessIds[],
     __in DWORD cProcessIds,
     __in DWORD dwExitCode
     )
@@ -273,6 +325,7 @@ extern "C" UINT __stdcall WixCloseApplications(
     MSICONDITION condition = MSICONDITION_NONE;
 
     DWORD cCloseApps = 0;
+    PROC_SNAPSHOT_HANDLE hSnapshot = NULL;
 
     PMSIHANDLE hView = NULL;
     PMSIHANDLE hRec = NULL;
@@ -346,7 +399,7 @@ extern "C" UINT __stdcall WixCloseApplications(
         // Before trying any changes to the machine, prompt if requested.
         if (dwAttributes & CLOSEAPP_ATTRIBUTE_PROMPTTOCONTINUE)
         {
-            hr = PromptToContinue(pwzTarget, pwzDescription ? pwzDescription : L"");
+            hr = PromptToContinue(&hSnapshot, pwzTarget, pwzDescription ? pwzDescription : L"");
             if (HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT) == hr)
             {
                 // Skip error message if user canceled.
@@ -360,12 +413,12 @@ extern "C" UINT __stdcall WixCloseApplications(
         //
         if (dwAttributes & CLOSEAPP_ATTRIBUTE_CLOSEMESSAGE)
         {
-            SendApplicationMessage(pwzTarget, WM_CLOSE, dwTimeout);
+            SendApplicationMessage(&hSnapshot, pwzTarget, WM_CLOSE, dwTimeout);
         }
 
         if (dwAttributes & CLOSEAPP_ATTRIBUTE_ENDSESSIONMESSAGE)
         {
-            SendApplicationMessage(pwzTarget, WM_QUERYENDSESSION, dwTimeout);
+            SendApplicationMessage(&hSnapshot, pwzTarget, WM_QUERYENDSESSION, dwTimeout);
         }
 
         //
@@ -389,7 +442,7 @@ extern "C" UINT __stdcall WixCloseApplications(
 
         if (pwzProperty && *pwzProperty)
         {
-            SetRunningProcessProperty(pwzTarget, pwzProperty);
+            SetRunningProcessProperty(&hSnapshot, pwzTarget, pwzProperty);
         }
 
         ++cCloseApps;
@@ -445,6 +498,8 @@ LExit:
         ::MsiCloseHandle(hListboxTable);
     }
 
+    ReleaseProcSnapshot(hSnapshot);
+
     ReleaseStr(pwzCustomActionData);
     ReleaseStr(pwzData);
     ReleaseStr(pwzProperty);
@@ -485,7 +540,8 @@ extern "C" UINT __stdcall WixCloseApplicationsDeferred(
     DWORD dwTimeout = 0;
     DWORD dwTerminateExitCode = 0;
 
-    DWORD *prgProcessIds = NULL;
+    PROC_SNAPSHOT_HANDLE hSnapshot = NULL;
+    const DWORD *prgProcessIds = NULL;
     DWORD cProcessIds = 0;
 
     //
@@ -525,17 +581,25 @@ extern "C" UINT __stdcall WixCloseApplicationsDeferred(
         //
         if (dwAttributes & CLOSEAPP_ATTRIBUTE_ELEVATEDCLOSEMESSAGE)
         {
-            SendApplicationMessage(pwzTarget, WM_CLOSE, dwTimeout);
+            SendApplicationMessage(&hSnapshot, pwzTarget, WM_CLOSE, dwTimeout);
         }
 
         if (dwAttributes & CLOSEAPP_ATTRIBUTE_ELEVATEDENDSESSIONMESSAGE)
         {
-            SendApplicationMessage(pwzTarget, WM_QUERYENDSESSION, dwTimeout);
+            SendApplicationMessage(&hSnapshot, pwzTarget, WM_QUERYENDSESSION, dwTimeout);
         }
 
         // If we find that an app that we need closed is still runing, require a
         // restart or kill the process as directed.
-        ProcFindAllIdsFromExeName(pwzTarget, &prgProcessIds, &cProcessIds);
+        hr = FindRunningProcessIds(&hSnapshot, pwzTarget, &prgProcessIds, &cProcessIds);
+        if (FAILED(hr))
+        {
+            WcaLog(LOGMSG_VERBOSE, "Failed to check whether App: %ls is running, error: 0x%x", pwzTarget, hr);
+
+            cProcessIds = 0;
+            hr = S_OK;
+        }
+
         if (0 < cProcessIds)
         {
             if (dwAttributes & CLOSEAPP_ATTRIBUTE_REBOOTPROMPT)
@@ -547,6 +611,7 @@ extern "C" UINT __stdcall WixCloseApplicationsDeferred(
             else if (dwAttributes & CLOSEAPP_ATTRIBUTE_TERMINATEPROCESS)
             {
                 TerminateProcesses(prgProcessIds, cProcessIds, dwTerminateExitCode);
+                ReleaseNullProcSnapshot(hSnapshot);
             }
         }
 
@@ -555,7 +620,7 @@ extern "C" UINT __stdcall WixCloseApplicationsDeferred(
     }
 
 LExit:
-    ReleaseMem(prgProcessIds);
+    ReleaseProcSnapshot(hSnapshot);
 
     ReleaseStr(pwzTarget);
     ReleaseStr(pwzData);
@@ -3,10 +3,32 @@
 #include "precomp.h"
 
 LPCWSTR vcsRemoveFolderExQuery =
-    L"SELECT `Wix4RemoveFolderEx`, `Component_`, `Property`, `InstallMode`, `WixRemoveFolderEx`.`Condition`, `Component`.`Attributes`"
-    L"FROM `Wix4RemoveFolderEx``,`Component` "
+    L"SELECT `Wix4RemoveFolderEx`, `Component_`, `Property`, `InstallMode`, `Wix4RemoveFolderEx`.`Condition`, `Component`.`Attributes`, `Wix4RemoveFolderEx`.`Attributes` "
+    L"FROM `Wix4RemoveFolderEx`,`Component` "
     L"WHERE `Wix4RemoveFolderEx`.`Component_`=`Component`.`Component`";
-enum eRemoveFolderExQuery { rfqId = 1, rfqComponent, rfqProperty, rfqMode, rfqCondition, rfqComponentAttributes };
+enum eRemoveFolderExQuery { rfqId = 1, rfqComponent, rfqProperty, rfqMode, rfqCondition, rfqComponentAttributes, rfqAttributes };
+
+// Wix4RemoveFolderEx.Attributes
+enum eRemoveFolderExAttributes
+{
+    REMOVEFOLDEREX_ATTRIBUTE_DEFERRED = 0x1,
+};
+
+// Operations passed to WixExecRemoveFoldersEx in CustomActionData.
+enum eRemoveFolderExOperation
+{
+    REMOVEFOLDEREX_OPERATION_MOVE_TO_BACKUP = 1,
+    REMOVEFOLDEREX_OPERATION_RESTORE_BACKUP,
+    REMOVEFOLDEREX_OPERATION_DELETE,
+};
+
+const DWORD REMOVEFOLDEREX_MAX_DELETE_THREADS = 8;
+
+struct REMOVEFOLDEREX_PROGRESS
+{
+    UINT uiCost;
+    UINT uiReported;
+};
 
 static HRESULT RecursePath(
     __in_z LPCWSTR wzPath,
@@ -131,6 +153,7 @@ extern "C" UINT WINAPI WixRemoveFoldersEx(
     LPWSTR sczExpandedPath = NULL;
     int iMode = 0;
     int iComponentAttributes;
+    int iAttributes = 0;
     BOOL f64BitComponent = FALSE;
     DWORD dwCounter = 0;
     DWORD_PTR cchLen = 0;
@@ -192,6 +215,16 @@ extern "C" UINT WINAPI WixRemoveFoldersEx(
 
         f64BitComponent = iComponentAttributes & msidbComponentAttributes64bit;
 
+        hr = WcaGetRecordInteger(hRec, rfqAttributes, &iAttributes);
+        ExitOnFailure(hr, "failed to get attributes for row: %ls", sczId);
+
+        // Deferred rows are removed directly by WixSchedRemoveFoldersEx.
+        if (S_OK == hr && (iAttributes & REMOVEFOLDEREX_ATTRIBUTE_DEFERRED))
+        {
+            WcaLog(LOGMSG_VERBOSE, "Row %ls is removed during the install script; skipping.", sczId);
+            continue;
+        }
+
         // fail early if the property isn't set as you probably don't want your installers trying to delete SystemFolder
         // StringCchLengthW succeeds only if the string is zero characters plus 1 for the terminating null
         hr = ::StringCchLengthW(sczPath, 1, reinterpret_cast<UINT_PTR*>(&cchLen));
@@ -241,3 +274,418 @@ LExit:
     DWORD er = SUCCEEDED(hr) ? ERROR_SUCCESS : ERROR_INSTALL_FAILURE;
     return WcaFinalize(er);
 }
+
+
+static HRESULT CALLBACK DeleteTreeProgress(
+    __in DWORD cScanned,
+    __in DWORD cDirectories,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    REMOVEFOLDEREX_PROGRESS* pProgress = reinterpret_cast<REMOVEFOLDEREX_PROGRESS*>(pvContext);
+
+    // Emptying folders is most of the work, so it gets all but the last tick.
+    UINT uiScanned = static_cast<UINT>(static_cast<ULONGLONG>(pProgress->uiCost - 1) * cScanned / cDirectories);
+    if (uiScanned > pProgress->uiReported)
+    {
+        hr = WcaProgressMessage(uiScanned - pProgress->uiReported, FALSE);
+        ExitOnFailure(hr, "Failed to send progress message.");
+
+        pProgress->uiReported = uiScanned;
+    }
+
+LExit:
+    return hr;
+}
+
+/******************************************************************
+ DeleteTree - deletes a folder and everything under it, walking the
+              tree on a pool of workers and ticking the progress bar
+              within uiCost as folders are emptied.
+
+******************************************************************/
+static HRESULT DeleteTree(
+    __in_z LPCWSTR wzPath,
+    __in UINT uiCost
+    )
+{
+    HRESULT hr = S_OK;
+    REMOVEFOLDEREX_PROGRESS progress = { uiCost, 0 };
+    DIR_DELETE_TREE_RESULTS results = { };
+    SYSTEM_INFO systemInfo = { };
+    DWORD dwStart = ::GetTickCount();
+
+    ::GetNativeSystemInfo(&systemInfo);
+
+    hr = DirDeleteTree(wzPath, min(systemInfo.dwNumberOfProcessors, REMOVEFOLDEREX_MAX_DELETE_THREADS), DeleteTreeProgress, &progress, &results);
+    ExitOnFailure(hr, "Failed to delete folder: %ls", wzPath);
+
+    if (S_FALSE == hr)
+    {
+        WcaLog(LOGMSG_VERBOSE, "Folder not found: %ls; skipping", wzPath);
+    }
+    else
+    {
+        if (results.cRebootRequired)
+        {
+            WcaDeferredActionRequiresReboot();
+        }
+
+        WcaLog(LOGMSG_STANDARD, "Deleted %u files and folders in %u folders under %ls on %u threads in %u ms, %u left for reboot, %u skipped.", results.cDeleted, results.cDirectories, wzPath, results.cThreads, ::GetTickCount() - dwStart, results.cRebootRequired, results.cSkipped);
+    }
+
+    hr = WcaProgressMessage(uiCost - progress.uiReported, FALSE);
+    ExitOnFailure(hr, "Failed to send progress message.");
+
+LExit:
+    return hr;
+}
+
+/******************************************************************
+ WixSchedRemoveFoldersEx - entry point for the deferred RemoveFolderEx
+                           rows. Instead of a RemoveFile row per folder
+                           each tree is moved aside during the script,
+                           moved back on rollback and deleted on commit.
+
+******************************************************************/
+extern "C" UINT WINAPI WixSchedRemoveFoldersEx(
+    __in MSIHANDLE hInstall
+    )
+{
+    //AssertSz(FALSE, "debug WixSchedRemoveFoldersEx");
+
+    HRESULT hr = S_OK;
+    PMSIHANDLE hView;
+    PMSIHANDLE hRec;
+    LPWSTR sczId = NULL;
+    LPWSTR sczComponent = NULL;
+    LPWSTR sczProperty = NULL;
+    LPWSTR sczCondition = NULL;
+    LPWSTR sczPath = NULL;
+    LPWSTR sczExpandedPath = NULL;
+    LPWSTR sczBackupPath = NULL;
+    int iMode = 0;
+    int iComponentAttributes = 0;
+    int iAttributes = 0;
+    BOOL f64BitComponent = FALSE;
+    BOOL fRollbackDisabled = FALSE;
+    WCA_TODO todo = WCA_TODO_UNKNOWN;
+    DWORD_PTR cchLen = 0;
+    DWORD cFolders = 0;
+    WCA_CADATA_WRITER rollbackData = { };
+    WCA_CADATA_WRITER execData = { };
+    WCA_CADATA_WRITER commitData = { };
+
+    hr = WcaInitialize(hInstall, "WixSchedRemoveFoldersEx");
+    ExitOnFailure(hr, "Failed to initialize WixSchedRemoveFoldersEx.");
+
+    // anything to do?
+    if (S_OK != WcaTableExists(L"Wix4RemoveFolderEx"))
+    {
+        WcaLog(LOGMSG_STANDARD, "Wix4RemoveFolderEx table doesn't exist, so there are no folders to remove.");
+        ExitFunction();
+    }
+
+    // Without rollback there is nothing to restore so the folders are deleted in place.
+    fRollbackDisabled = WcaIsPropertySet("RollbackDisabled");
+
+    hr = WcaOpenExecuteView(vcsRemoveFolderExQuery, &hView);
+    ExitOnFailure(hr, "Failed to open view on Wix4RemoveFolderEx table");
+
+    while (S_OK == (hr = WcaFetchRecord(hView, &hRec)))
+    {
+        hr = WcaGetRecordString(hRec, rfqId, &sczId);
+        ExitOnFailure(hr, "Failed to get remove folder identity.");
+
+        hr = WcaGetRecordInteger(hRec, rfqAttributes, &iAttributes);
+        ExitOnFailure(hr, "failed to get attributes for row: %ls", sczId);
+
+        if (S_OK != hr || !(iAttributes & REMOVEFOLDEREX_ATTRIBUTE_DEFERRED))
+        {
+            continue;
+        }
+
+        hr = WcaGetRecordString(hRec, rfqCondition, &sczCondition);
+        ExitOnFailure(hr, "Failed to get remove folder condition.");
+
+        if (sczCondition && *sczCondition)
+        {
+            MSICONDITION condition = ::MsiEvaluateConditionW(hInstall, sczCondition);
+            if (MSICONDITION_TRUE == condition)
+            {
+                WcaLog(LOGMSG_STANDARD, "True condition for row %ls: %ls; processing.", sczId, sczCondition);
+            }
+            else
+            {
+                WcaLog(LOGMSG_STANDARD, "False or invalid condition for row %ls: %ls; skipping.", sczId, sczCondition);
+                continue;
+            }
+        }
+
+        hr = WcaGetRecordString(hRec, rfqComponent, &sczComponent);
+        ExitOnFailure(hr, "Failed to get remove folder component.");
+
+        hr = WcaGetRecordInteger(hRec, rfqMode, &iMode);
+        ExitOnFailure(hr, "Failed to get remove folder mode");
+
+        // Same rules the RemoveFile table applies to its InstallMode column.
+        todo = WcaGetComponentToDo(sczComponent);
+        if (!(((msidbRemoveFileInstallModeOnInstall & iMode) && (WCA_TODO_INSTALL == todo || WCA_TODO_REINSTALL == todo)) ||
+              ((msidbRemoveFileInstallModeOnRemove & iMode) && WCA_TODO_UNINSTALL == todo)))
+        {
+            WcaLog(LOGMSG_VERBOSE, "Component: %ls for row: %ls has no matching action; skipping.", sczComponent, sczId);
+            continue;
+        }
+
+        hr = WcaGetRecordString(hRec, rfqProperty, &sczProperty);
+        ExitOnFailure(hr, "Failed to get remove folder property.");
+
+        hr = WcaGetProperty(sczProperty, &sczPath);
+        ExitOnFailure(hr, "Failed to resolve remove folder property: %ls for row: %ls", sczProperty, sczId);
+
+        hr = WcaGetRecordInteger(hRec, rfqComponentAttributes, &iComponentAttributes);
+        ExitOnFailure(hr, "failed to get component attributes for row: %ls", sczId);
+
+        f64BitComponent = iComponentAttributes & msidbComponentAttributes64bit;
+
+        // fail early if the property isn't set as you probably don't want your installers trying to delete SystemFolder
+        // StringCchLengthW succeeds only if the string is zero characters plus 1 for the terminating null
+        hr = ::StringCchLengthW(sczPath, 1, reinterpret_cast<UINT_PTR*>(&cchLen));
+        if (SUCCEEDED(hr))
+        {
+            ExitOnFailure(hr = E_INVALIDARG, "Missing folder property: %ls for row: %ls", sczProperty, sczId);
+        }
+
+        hr = PathExpand(&sczExpandedPath, sczPath, PATH_EXPAND_ENVIRONMENT | PATH_EXPAND_FULLPATH);
+        ExitOnFailure(hr, "Failed to expand path: %ls for row: %ls", sczPath, sczId);
+
+        // The folder is renamed, so refer to it without the trailing backslash.
+        cchLen = lstrlenW(sczExpandedPath);
+        while (1 < cchLen && L'\\' == sczExpandedPath[cchLen - 1])
+        {
+            sczExpandedPath[--cchLen] = L'\0';
+        }
+
+        hr = PathGetParentPath(sczExpandedPath, &sczBackupPath);
+        if (SUCCEEDED(hr) && (!sczBackupPath || !*sczBackupPath))
+        {
+            hr = E_INVALIDARG;
+        }
+        ExitOnFailure(hr, "Refusing to remove a root folder: %ls for row: %ls", sczExpandedPath, sczId);
+
+        hr = StrAllocFormatted(&sczBackupPath, L"%ls.rfx%x_%u", sczExpandedPath, ::GetTickCount(), cFolders);
+        ExitOnFailure(hr, "Failed to build backup path for: %ls", sczExpandedPath);
+
+        WcaLog(LOGMSG_STANDARD, "Scheduling removal of path: %ls for row: %ls.", sczExpandedPath, sczId);
+
+        if (fRollbackDisabled)
+        {
+            hr = WcaCaDataWriteInteger(&execData, REMOVEFOLDEREX_OPERATION_DELETE);
+            ExitOnFailure(hr, "Failed to add operation to CustomActionData.");
+            hr = WcaCaDataWriteInteger(&execData, f64BitComponent);
+            ExitOnFailure(hr, "Failed to add bitness to CustomActionData.");
+            hr = WcaCaDataWriteString(&execData, sczExpandedPath);
+            ExitOnFailure(hr, "Failed to add path to CustomActionData.");
+            hr = WcaCaDataWriteString(&execData, L"");
+            ExitOnFailure(hr, "Failed to add backup path to CustomActionData.");
+        }
+        else
+        {
+            hr = WcaCaDataWriteInteger(&rollbackData, REMOVEFOLDEREX_OPERATION_RESTORE_BACKUP);
+            ExitOnFailure(hr, "Failed to add operation to rollback CustomActionData.");
+            hr = WcaCaDataWriteInteger(&rollbackData, f64BitComponent);
+            ExitOnFailure(hr, "Failed to add bitness to rollback CustomActionData.");
+            hr = WcaCaDataWriteString(&rollbackData, sczExpandedPath);
+            ExitOnFailure(hr, "Failed to add path to rollback CustomActionData.");
+            hr = WcaCaDataWriteString(&rollbackData, sczBackupPath);
+            ExitOnFailure(hr, "Failed to add backup path to rollback CustomActionData.");
+
+            hr = WcaCaDataWriteInteger(&execData, REMOVEFOLDEREX_OPERATION_MOVE_TO_BACKUP);
+            ExitOnFailure(hr, "Failed to add operation to CustomActionData.");
+            hr = WcaCaDataWriteInteger(&execData, f64BitComponent);
+            ExitOnFailure(hr, "Failed to add bitness to CustomActionData.");
+            hr = WcaCaDataWriteString(&execData, sczExpandedPath);
+            ExitOnFailure(hr, "Failed to add path to CustomActionData.");
+            hr = WcaCaDataWriteString(&execData, sczBackupPath);
+            ExitOnFailure(hr, "Failed to add backup path to CustomActionData.");
+
+            hr = WcaCaDataWriteInteger(&commitData, REMOVEFOLDEREX_OPERATION_DELETE);
+            ExitOnFailure(hr, "Failed to add operation to commit CustomActionData.");
+            hr = WcaCaDataWriteInteger(&commitData, f64BitComponent);
+            ExitOnFailure(hr, "Failed to add bitness to commit CustomActionData.");
+            hr = WcaCaDataWriteString(&commitData, sczBackupPath);
+            ExitOnFailure(hr, "Failed to add path to commit CustomActionData.");
+            hr = WcaCaDataWriteString(&commitData, L"");
+            ExitOnFailure(hr, "Failed to add backup path to commit CustomActionData.");
+        }
+
+        ++cFolders;
+    }
+
+    // reaching the end of the list is actually a good thing, not an error
+    if (E_NOMOREITEMS == hr)
+    {
+        hr = S_OK;
+    }
+    ExitOnFailure(hr, "Failure occured while processing Wix4RemoveFolderEx table");
+
+    if (rollbackData.cFields)
+    {
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RollbackRemoveFoldersEx"), rollbackData.pwzData, cFolders * COST_REMOVEFOLDEREX);
+        ExitOnFailure(hr, "Failed to schedule RollbackRemoveFoldersEx");
+    }
+
+    if (execData.cFields)
+    {
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecRemoveFoldersEx"), execData.pwzData, cFolders * COST_REMOVEFOLDEREX);
+        ExitOnFailure(hr, "Failed to schedule ExecRemoveFoldersEx");
+    }
+
+    if (commitData.cFields)
+    {
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"CommitRemoveFoldersEx"), commitData.pwzData, cFolders * COST_REMOVEFOLDEREX);
+        ExitOnFailure(hr, "Failed to schedule CommitRemoveFoldersEx");
+    }
+
+LExit:
+    WcaCaDataWriterUninitialize(&commitData);
+    WcaCaDataWriterUninitialize(&execData);
+    WcaCaDataWriterUninitialize(&rollbackData);
+    ReleaseStr(sczBackupPath);
+    ReleaseStr(sczExpandedPath);
+    ReleaseStr(sczPath);
+    ReleaseStr(sczProperty);
+    ReleaseStr(sczComponent);
+    ReleaseStr(sczCondition);
+    ReleaseStr(sczId);
+
+    DWORD er = SUCCEEDED(hr) ? ERROR_SUCCESS : ERROR_INSTALL_FAILURE;
+    return WcaFinalize(er);
+}
+
+/******************************************************************
+ WixExecRemoveFoldersEx - entry point for the deferred, rollback and
+                          commit RemoveFoldersEx custom actions
+
+ NOTE: CustomActionData == iOperation\tf64Bit\twzPath\twzBackupPath\t...
+ NOTE: a folder that cannot be renamed as a whole, usually because
+       something in it is in use, is moved aside item by item; if any
+       item cannot be moved the action fails and rollback moves back
+       everything that was
+******************************************************************/
+extern "C" UINT WINAPI WixExecRemoveFoldersEx(
+    __in MSIHANDLE hInstall
+    )
+{
+    //AssertSz(FALSE, "debug WixExecRemoveFoldersEx");
+
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    LPWSTR sczData = NULL;
+    LPWSTR pwz = NULL;
+    LPWSTR sczPath = NULL;
+    LPWSTR sczBackupPath = NULL;
+    int iOperation = 0;
+    int f64Bit = 0;
+    BOOL fWow64Disabled = FALSE;
+    BOOL fRollback = FALSE;
+
+    hr = WcaInitialize(hInstall, "WixExecRemoveFoldersEx");
+    ExitOnFailure(hr, "Failed to initialize WixExecRemoveFoldersEx.");
+
+    WcaInitializeWow64();
+
+    fRollback = ::MsiGetMode(hInstall, MSIRUNMODE_ROLLBACK);
+
+    hr = WcaGetProperty(L"CustomActionData", &sczData);
+    ExitOnFailure(hr, "Failed to get CustomActionData.");
+
+    WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", sczData);
+
+    pwz = sczData;
+
+    while (pwz && *pwz)
+    {
+        hr = WcaReadIntegerFromCaData(&pwz, &iOperation);
+        ExitOnFailure(hr, "Failed to read operation from CustomActionData.");
+
+        hr = WcaReadIntegerFromCaData(&pwz, &f64Bit);
+        ExitOnFailure(hr, "Failed to read bitness from CustomActionData.");
+
+        hr = WcaReadStringFromCaData(&pwz, &sczPath);
+        ExitOnFailure(hr, "Failed to read path from CustomActionData.");
+
+        hr = WcaReadStringFromCaData(&pwz, &sczBackupPath);
+        ExitOnFailure(hr, "Failed to read backup path from CustomActionData.");
+
+        if (f64Bit && !fWow64Disabled)
+        {
+            hr = WcaDisableWow64FSRedirection();
+            ExitOnFailure(hr, "Custom action was told to act on a 64-bit component, but was unable to disable filesystem redirection through the Wow64 API.");
+
+            fWow64Disabled = TRUE;
+        }
+        else if (!f64Bit && fWow64Disabled)
+        {
+            WcaRevertWow64FSRedirection();
+            fWow64Disabled = FALSE;
+        }
+
+        switch (iOperation)
+        {
+        case REMOVEFOLDEREX_OPERATION_MOVE_TO_BACKUP:
+            if (!DirExists(sczPath, NULL))
+            {
+                WcaLog(LOGMSG_VERBOSE, "Folder not found: %ls; skipping", sczPath);
+            }
+            else
+            {
+                hr = DirMoveTree(sczPath, sczBackupPath, FALSE);
+                ExitOnFailure(hr, "Failed to move folder: %ls to: %ls", sczPath, sczBackupPath);
+
+                WcaLog(LOGMSG_STANDARD, "Moved folder: %ls to: %ls until the install commits.", sczPath, sczBackupPath);
+            }
+
+            hr = WcaProgressMessage(COST_REMOVEFOLDEREX, FALSE);
+            ExitOnFailure(hr, "Failed to send progress message.");
+            break;
+
+        case REMOVEFOLDEREX_OPERATION_RESTORE_BACKUP:
+            // Merges into the folder when the move aside stopped part way.
+            if (DirExists(sczBackupPath, NULL))
+            {
+                hr = DirMoveTree(sczBackupPath, sczPath, TRUE);
+                if (FAILED(hr))
+                {
+                    WcaLog(LOGMSG_STANDARD, "Failed to restore folder: %ls from: %ls, error: 0x%x", sczPath, sczBackupPath, hr);
+                    hr = S_OK;
+                }
+            }
+
+            hr = WcaProgressMessage(COST_REMOVEFOLDEREX, FALSE);
+            ExitOnFailure(hr, "Failed to send progress message.");
+            break;
+
+        case REMOVEFOLDEREX_OPERATION_DELETE:
+            hr = DeleteTree(sczPath, COST_REMOVEFOLDEREX);
+            ExitOnFailure(hr, "Failed to delete folder: %ls", sczPath);
+            break;
+
+        default:
+            hr = E_INVALIDARG;
+            ExitOnFailure(hr, "Unknown RemoveFoldersEx operation: %d", iOperation);
+        }
+    }
+
+LExit:
+    WcaFinalizeWow64();
+
+    ReleaseStr(sczBackupPath);
+    ReleaseStr(sczPath);
+    ReleaseStr(sczData);
+
+    // Rollback restores what it can rather than stopping at the first failure.
+    er = SUCCEEDED(hr) || fRollback ? ERROR_SUCCESS : ERROR_INSTALL_FAILURE;
+    return WcaFinalize(er);
+}
@@ -54,6 +54,11 @@ extern "C" UINT __stdcall WixRegisterRestartResources(
     WCA_TODO todo = WCA_TODO_UNKNOWN;
     int iType = etInvalid;
 
+    PROC_SNAPSHOT_HANDLE hSnapshot = NULL;
+    const DWORD* rgdwProcessIds = NULL;
+    DWORD cProcessIds = 0;
+    DWORD dwStart = 0;
+
     hr = WcaInitialize(hInstall, "WixRegisterRestartResources");
     ExitOnFailure(hr, "Failed to initialize.");
 
@@ -130,8 +135,22 @@ extern "C" UINT __stdcall WixRegisterRestartResources(
             break;
 
         case etApplication:
+            // Capture the running processes once for all of the application resources.
+            if (!hSnapshot)
+            {
+                dwStart = ::GetTickCount();
+
+                hr = ProcSnapshotCreate(&hSnapshot);
+                ExitOnFailure(hr, "Failed to enumerate the running processes.");
+
+                WcaLog(LOGMSG_VERBOSE, "Enumerated %u running processes in %u ms.", ProcSnapshotGetProcessCount(hSnapshot), ::GetTickCount() - dwStart);
+            }
+
             WcaLog(LOGMSG_VERBOSE, "Registering process name %ls with the Restart Manager.", wzResource);
-            hr = RmuAddProcessesByName(pSession, wzResource);
+            hr = ProcSnapshotFindIds(hSnapshot, wzResource, &rgdwProcessIds, &cProcessIds);
+            ExitOnFailure(hr, "Failed to find the processes by name %ls.", wzResource);
+
+            hr = RmuAddProcessesByIds(pSession, rgdwProcessIds, cProcessIds);
             if (E_NOTFOUND == hr)
             {
                 // ERROR_ACCESS_DENIED was returned when trying to register this process.
@@ -172,6 +191,8 @@ extern "C" UINT __stdcall WixRegisterRestartResources(
     }
 
 LExit:
+    ReleaseProcSnapshot(hSnapshot);
+
     ReleaseStr(wzRestartResource);
     ReleaseStr(wzComponent);
     ReleaseStr(wzResource);
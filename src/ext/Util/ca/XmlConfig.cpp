@@ -337,10 +337,10 @@ LExit:
 static HRESULT BeginChangeFile(
     __in LPCWSTR pwzFile,
     __in int iCompAttributes,
-    __inout LPWSTR* ppwzCustomActionData
+    __in WCA_CADATA_WRITER* pCustomActionData
     )
 {
-    Assert(pwzFile && *pwzFile && ppwzCustomActionData);
+    Assert(pwzFile && *pwzFile && pCustomActionData);
 
     HRESULT hr = S_OK;
     BOOL fIs64Bit = iCompAttributes & msidbComponentAttributes64bit;
@@ -352,16 +352,16 @@ static HRESULT BeginChangeFile(
 
     if (fIs64Bit)
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFilex64, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xaOpenFilex64);
         ExitOnFailure(hr, "failed to write 64-bit file indicator to custom action data");
     }
     else
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFile, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xaOpenFile);
         ExitOnFailure(hr, "failed to write file indicator to custom action data");
     }
 
-    hr = WcaWriteStringToCaData(pwzFile, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pwzFile);
     ExitOnFailure(hr, "failed to write file to custom action data: %ls", pwzFile);
 
     // If the file already exits, then we have to put it back the way it was on failure
@@ -395,30 +395,30 @@ LExit:
 static HRESULT WriteChangeData(
     __in XML_CONFIG_CHANGE* pxfc,
     __in eXmlAction action,
-    __inout LPWSTR* ppwzCustomActionData
+    __in WCA_CADATA_WRITER* pCustomActionData
     )
 {
-    Assert(pxfc && ppwzCustomActionData);
+    Assert(pxfc && pCustomActionData);
 
     HRESULT hr = S_OK;
     XML_CONFIG_CHANGE* pxfcAdditionalChanges = NULL;
     LPCWSTR wzElementPath = pxfc->pwzElementId ? pxfc->pwzElementId : pxfc->pwzElementPath;
 
-    hr = WcaWriteStringToCaData(wzElementPath, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, wzElementPath);
     ExitOnFailure(hr, "failed to write ElementPath to custom action data: %ls", wzElementPath);
 
-    hr = WcaWriteStringToCaData(pxfc->pwzVerifyPath, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->pwzVerifyPath);
     ExitOnFailure(hr, "failed to write VerifyPath to custom action data: %ls", pxfc->pwzVerifyPath);
 
-    hr = WcaWriteStringToCaData(pxfc->wzName, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->wzName);
     ExitOnFailure(hr, "failed to write Name to custom action data: %ls", pxfc->wzName);
 
-    hr = WcaWriteStringToCaData(pxfc->pwzValue, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->pwzValue);
     ExitOnFailure(hr, "failed to write Value to custom action data: %ls", pxfc->pwzValue);
 
     if (pxfc->iXmlFlags & XMLCONFIG_CREATE && pxfc->iXmlFlags & XMLCONFIG_ELEMENT && xaCreateElement == action && pxfc->pxfcAdditionalChanges)
     {
-        hr = WcaWriteIntegerToCaData(pxfc->cAdditionalChanges, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, pxfc->cAdditionalChanges);
         ExitOnFailure(hr, "failed to write additional changes value to custom action data");
 
         pxfcAdditionalChanges = pxfc->pxfcAdditionalChanges;
@@ -426,10 +426,10 @@ static HRESULT WriteChangeData(
         {
             Assert((0 == lstrcmpW(pxfcAdditionalChanges->wzComponent, pxfc->wzComponent)) && 0 == pxfcAdditionalChanges->iXmlFlags && (0 == lstrcmpW(pxfcAdditionalChanges->wzFile, pxfc->wzFile)));
 
-            hr = WcaWriteStringToCaData(pxfcAdditionalChanges->wzName, ppwzCustomActionData);
+            hr = WcaCaDataWriteString(pCustomActionData, pxfcAdditionalChanges->wzName);
             ExitOnFailure(hr, "failed to write Name to custom action data: %ls", pxfc->wzName);
 
-            hr = WcaWriteStringToCaData(pxfcAdditionalChanges->pwzValue, ppwzCustomActionData);
+            hr = WcaCaDataWriteString(pCustomActionData, pxfcAdditionalChanges->pwzValue);
             ExitOnFailure(hr, "failed to write Value to custom action data: %ls", pxfc->pwzValue);
 
             pxfcAdditionalChanges = pxfcAdditionalChanges->pxfcNext;
@@ -437,7 +437,7 @@ static HRESULT WriteChangeData(
     }
     else
     {
-        hr = WcaWriteIntegerToCaData(0, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, 0);
         ExitOnFailure(hr, "failed to write additional changes value to custom action data");
     }
 
@@ -472,7 +472,7 @@ extern "C" UINT __stdcall SchedXmlConfig(
     eXmlAction xa = xaUnknown;
     eXmlPreserveDate xd;
 
-    LPWSTR pwzCustomActionData = NULL;
+    WCA_CADATA_WRITER customActionData = { };
 
     DWORD cFiles = 0;
 
@@ -486,11 +486,16 @@ extern "C" UINT __stdcall SchedXmlConfig(
     hr = ProcessChanges(&pxfcHead);
     ExitOnFailure(hr, "failed to process Wix4XmlConfig changes");
 
+    // The table is sorted by the unformatted File column, so different entries can still end up targeting the same file.
+    // Each merged group keeps the order of its File values, then Sequence within each of them.
+    // ProcessChanges doesn't keep pxfcTail up to date, so it isn't passed along
+    GroupXmlChangesByFile<XML_CONFIG_CHANGE>(&pxfcHead, NULL);
+
     // loop through all the xml configurations
     for (pxfc = pxfcHead; pxfc; pxfc = pxfc->pxfcNext)
     {
         // If this is a different file, or the first file...
-        if (NULL == pwzCurrentFile || 0 != lstrcmpW(pwzCurrentFile, pxfc->wzFile))
+        if (NULL == pwzCurrentFile || !IsSameXmlFile(pwzCurrentFile, pxfc->wzFile))
         {
             // Remember the file we're currently working on
             hr = StrAllocString(&pwzCurrentFile, pxfc->wzFile, 0);
@@ -549,20 +554,20 @@ extern "C" UINT __stdcall SchedXmlConfig(
         {
             if (fCurrentFileChanged)
             {
-                hr = BeginChangeFile(pwzCurrentFile, pxfc->iCompAttributes, &pwzCustomActionData);
+                hr = BeginChangeFile(pwzCurrentFile, pxfc->iCompAttributes, &customActionData);
                 ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
 
                 fCurrentFileChanged = FALSE;
                 ++cFiles;
             }
 
-            hr = WcaWriteIntegerToCaData((int)xa, &pwzCustomActionData);
+            hr = WcaCaDataWriteInteger(&customActionData, (int)xa);
             ExitOnFailure(hr, "failed to write action indicator custom action data");
 
-            hr = WcaWriteIntegerToCaData((int)xd, &pwzCustomActionData);
+            hr = WcaCaDataWriteInteger(&customActionData, (int)xd);
             ExitOnFailure(hr, "failed to write Preserve Date indicator to custom action data");
 
-            hr = WriteChangeData(pxfc, xa, &pwzCustomActionData);
+            hr = WriteChangeData(pxfc, xa, &customActionData);
             ExitOnFailure(hr, "failed to write change data");
         }
     }
@@ -575,17 +580,17 @@ extern "C" UINT __stdcall SchedXmlConfig(
     ExitOnFailure(hr, "failed while looping through all objects to secure");
 
     // Schedule the custom action and add to progress bar
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
         Assert(0 < cFiles);
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfig"), pwzCustomActionData, cFiles * COST_XMLFILE);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfig"), customActionData.pwzData, cFiles * COST_XMLFILE);
         ExitOnFailure(hr, "failed to schedule ExecXmlConfig action");
     }
 
 LExit:
     ReleaseStr(pwzCurrentFile);
-    ReleaseStr(pwzCustomActionData);
+    WcaCaDataWriterUninitialize(&customActionData);
 
     FreeXmlConfigChangeList(pxfcHead);
 
@@ -638,6 +643,11 @@ extern "C" UINT __stdcall ExecXmlConfig(
 
     int id = IDRETRY;
 
+    DWORD dwStart = 0;
+    DWORD dwParse = 0;
+    DWORD dwApply = 0;
+    DWORD cChanges = 0;
+
     eXmlAction xa;
     eXmlPreserveDate xd;
 
@@ -698,6 +708,8 @@ extern "C" UINT __stdcall ExecXmlConfig(
         }
 #endif
 
+        dwStart = ::GetTickCount();
+
         hr = XmlLoadDocumentFromFileEx(pwzFile, XML_LOAD_PRESERVE_WHITESPACE, &pixd);
         if (FAILED(hr))
         {
@@ -712,6 +724,10 @@ extern "C" UINT __stdcall ExecXmlConfig(
 
         WcaLog(LOGMSG_VERBOSE, "Configuring Xml File: %ls", pwzFile);
 
+        dwParse = ::GetTickCount() - dwStart;
+        dwStart = ::GetTickCount();
+        cChanges = 0;
+
         while (pwz && *pwz)
         {
             // If we skip past an element that has additional changes we need to strip them off the stream before
@@ -739,6 +755,8 @@ extern "C" UINT __stdcall ExecXmlConfig(
                 break;
             }
 
+            ++cChanges;
+
             hr = WcaReadIntegerFromCaData(&pwz, (int*) &xd);
             ExitOnFailure(hr, "failed to process CustomActionData");
 
@@ -919,6 +937,9 @@ extern "C" UINT __stdcall ExecXmlConfig(
         // Now that we've made all of the changes to this file, save it and move on to the next
         if (S_OK == hrOpenFailure)
         {
+            dwApply = ::GetTickCount() - dwStart;
+            dwStart = ::GetTickCount();
+
             if (fPreserveDate)
             {
                 hr = FileGetTime(pwzFile, NULL, NULL, &ft);
@@ -972,6 +993,8 @@ extern "C" UINT __stdcall ExecXmlConfig(
                 ExitOnFailure(hr, "failed to set modified time of file : %ls", pwzFile);
             }
 
+            WcaLog(LOGMSG_VERBOSE, "Xml File: %ls parsed in %u ms, %u changes applied in %u ms, saved in %u ms", pwzFile, dwParse, cChanges, dwApply, ::GetTickCount() - dwStart);
+
 #ifndef _WIN64
             if (fIsFSRedirectDisabled)
             {
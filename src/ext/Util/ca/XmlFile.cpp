@@ -21,6 +21,7 @@ enum eXmlAction
     xaCreateElement,
     xaDeleteElement,
     xaBulkWriteValue,
+    xaSelectionLanguage,
 };
 
 enum eXmlPreserveDate
@@ -204,10 +205,10 @@ LExit:
 static HRESULT BeginChangeFile(
     __in LPCWSTR pwzFile,
     __in XML_FILE_CHANGE* pxfc,
-    __inout LPWSTR* ppwzCustomActionData
+    __in WCA_CADATA_WRITER* pCustomActionData
     )
 {
-    Assert(pwzFile && *pwzFile && ppwzCustomActionData);
+    Assert(pwzFile && *pwzFile && pCustomActionData);
 
     HRESULT hr = S_OK;
     BOOL fIs64Bit = pxfc->iCompAttributes & msidbComponentAttributes64bit;
@@ -219,25 +220,25 @@ static HRESULT BeginChangeFile(
 
     if (fIs64Bit)
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFilex64, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xaOpenFilex64);
         ExitOnFailure(hr, "failed to write 64-bit file indicator to custom action data");
     }
     else
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFile, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xaOpenFile);
         ExitOnFailure(hr, "failed to write file indicator to custom action data");
     }
     if (fUseXPath)
     {
-        hr = WcaWriteIntegerToCaData((int)xsXPath, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xsXPath);
         ExitOnFailure(hr, "failed to write XPath selectionlanguage indicator to custom action data");
     }
     else
     {
-        hr = WcaWriteIntegerToCaData((int)xsXSLPattern, ppwzCustomActionData);
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xsXSLPattern);
         ExitOnFailure(hr, "failed to write XSLPattern selectionlanguage indicator to custom action data");
     }
-    hr = WcaWriteStringToCaData(pwzFile, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pwzFile);
     ExitOnFailure(hr, "failed to write file to custom action data: %ls", pwzFile);
 
     // If the file already exits, then we have to put it back the way it was on failure
@@ -270,20 +271,20 @@ LExit:
 
 static HRESULT WriteChangeData(
     __in XML_FILE_CHANGE* pxfc,
-    __inout LPWSTR* ppwzCustomActionData
+    __in WCA_CADATA_WRITER* pCustomActionData
     )
 {
-    Assert(pxfc && ppwzCustomActionData);
+    Assert(pxfc && pCustomActionData);
 
     HRESULT hr = S_OK;
 
-    hr = WcaWriteStringToCaData(pxfc->pwzElementPath, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->pwzElementPath);
     ExitOnFailure(hr, "failed to write ElementPath to custom action data: %ls", pxfc->pwzElementPath);
 
-    hr = WcaWriteStringToCaData(pxfc->wzName, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->wzName);
     ExitOnFailure(hr, "failed to write Name to custom action data: %ls", pxfc->wzName);
 
-    hr = WcaWriteStringToCaData(pxfc->pwzValue, ppwzCustomActionData);
+    hr = WcaCaDataWriteString(pCustomActionData, pxfc->pwzValue);
     ExitOnFailure(hr, "failed to write Value to custom action data: %ls", pxfc->pwzValue);
 
 LExit:
@@ -291,6 +292,62 @@ LExit:
 }
 
 
+static HRESULT WriteFileChange(
+    __in_z LPCWSTR pwzFile,
+    __in XML_FILE_CHANGE* pxfc,
+    __in eXmlAction xa,
+    __inout BOOL* pfFileChanged,
+    __inout BOOL* pfUseXPath,
+    __inout DWORD* pcFiles,
+    __in WCA_CADATA_WRITER* pCustomActionData
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fUseXPath = (XMLFILE_USE_XPATH & pxfc->iXmlFlags) ? TRUE : FALSE;
+
+    if (!*pfFileChanged)
+    {
+        hr = BeginChangeFile(pwzFile, pxfc, pCustomActionData);
+        ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzFile);
+
+        *pfFileChanged = TRUE;
+        *pfUseXPath = fUseXPath;
+        ++*pcFiles;
+    }
+    else if (*pfUseXPath != fUseXPath)
+    {
+        // Switch the selection language in place rather than loading the file again
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xaSelectionLanguage);
+        ExitOnFailure(hr, "failed to write selection language change indicator to custom action data");
+
+        hr = WcaCaDataWriteInteger(pCustomActionData, fUseXPath ? (int)xsXPath : (int)xsXSLPattern);
+        ExitOnFailure(hr, "failed to write selection language to custom action data");
+
+        *pfUseXPath = fUseXPath;
+    }
+
+    hr = WcaCaDataWriteInteger(pCustomActionData, (int)xa);
+    ExitOnFailure(hr, "failed to write action indicator to custom action data");
+
+    if (XMLFILE_PRESERVE_MODIFIED & pxfc->iXmlFlags)
+    {
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xdPreserve);
+        ExitOnFailure(hr, "failed to write Preserve Date indicator to custom action data");
+    }
+    else
+    {
+        hr = WcaCaDataWriteInteger(pCustomActionData, (int)xdDontPreserve);
+        ExitOnFailure(hr, "failed to write Don't Preserve Date indicator to custom action data");
+    }
+
+    hr = WriteChangeData(pxfc, pCustomActionData);
+    ExitOnFailure(hr, "failed to write change data");
+
+LExit:
+    return hr;
+}
+
+
 /******************************************************************
  SchedXmlFile - entry point for XmlFile Custom Action
 
@@ -304,7 +361,6 @@ extern "C" UINT __stdcall SchedXmlFile(
     HRESULT hr = S_OK;
     UINT er = ERROR_SUCCESS;
 
-    LPWSTR pwzCurrentFile = NULL;
     BOOL fCurrentFileChanged = FALSE;
     BOOL fCurrentUseXPath = FALSE;
 
@@ -314,9 +370,12 @@ extern "C" UINT __stdcall SchedXmlFile(
     XML_FILE_CHANGE* pxfcHead = NULL;
     XML_FILE_CHANGE* pxfcTail = NULL;
     XML_FILE_CHANGE* pxfc = NULL;
-    XML_FILE_CHANGE* pxfcUninstall = NULL;
+    XML_FILE_CHANGE* pxfcLast = NULL;
+    XML_FILE_CHANGE* pxfcChange = NULL;
 
-    LPWSTR pwzCustomActionData = NULL;
+    eXmlAction xa;
+
+    WCA_CADATA_WRITER customActionData = { };
 
     DWORD cFiles = 0;
 
@@ -333,141 +392,125 @@ extern "C" UINT __stdcall SchedXmlFile(
 
     MessageExitOnFailure(hr, msierrXmlFileFailedRead, "failed to read Wix4XmlFile table");
 
-    // loop through all the xml configurations
-    for (pxfc = pxfcHead; pxfc; pxfc = pxfc->pxfcNext)
+    // The table is sorted by the unformatted File column, so different entries can still end up targeting the same file.
+    // Each merged group keeps the order of its File values, then Sequence within each of them.
+    GroupXmlChangesByFile(&pxfcHead, &pxfcTail);
+
+    // loop through all the xml configurations one file at a time
+    for (pxfc = pxfcHead; pxfc; pxfc = pxfcLast->pxfcNext)
     {
-        // If this is the first file, a different file, the last file, or the SelectionLanguage property changes...
-        if (NULL == pwzCurrentFile || 0 != lstrcmpW(pwzCurrentFile, pxfc->wzFile) || NULL == pxfc->pxfcNext || fCurrentUseXPath != ((XMLFILE_USE_XPATH & pxfc->iXmlFlags)))
+        // Find the last change for this file, they're all next to each other now
+        pxfcLast = pxfc;
+        while (pxfcLast->pxfcNext && IsSameXmlFile(pxfc->wzFile, pxfcLast->pxfcNext->wzFile))
         {
-            // If this isn't the first file
-            if (NULL != pwzCurrentFile)
-            {
-                // Do the uninstall work for the current file by walking backwards through the list (so the sequence is reversed)
-                for (pxfcUninstall = ((NULL != pxfc->pxfcNext) ? pxfc->pxfcPrev : pxfc); pxfcUninstall && 0 == lstrcmpW(pwzCurrentFile, pxfcUninstall->wzFile) &&  fCurrentUseXPath == ((XMLFILE_USE_XPATH & pxfcUninstall->iXmlFlags)); pxfcUninstall = pxfcUninstall->pxfcPrev)
-                {
-                    // If it's being uninstalled
-                    if (WcaIsUninstalling(pxfcUninstall->isInstalled, pxfcUninstall->isAction))
-                    {
-                        // Uninstall the change
-                        if (!(XMLFILE_DONT_UNINSTALL & pxfcUninstall->iXmlFlags))
-                        {
-                            if (!fCurrentFileChanged)
-                            {
-                                hr = BeginChangeFile(pwzCurrentFile, pxfcUninstall, &pwzCustomActionData);
-                                ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
-
-                                fCurrentFileChanged = TRUE;
-                                ++cFiles;
-                            }
-                            if (XMLFILE_CREATE_ELEMENT & pxfcUninstall->iXmlFlags)
-                            {
-                                hr = WcaWriteIntegerToCaData((int)xaDeleteElement, &pwzCustomActionData);
-                                ExitOnFailure(hr, "failed to write delete element action indicator to custom action data");
-                            }
-                            else
-                            {
-                                hr = WcaWriteIntegerToCaData((int)xaDeleteValue, &pwzCustomActionData);
-                                ExitOnFailure(hr, "failed to write delete value action indicator to custom action data");
-                            }
+            pxfcLast = pxfcLast->pxfcNext;
+        }
 
-                            if (XMLFILE_PRESERVE_MODIFIED & pxfc->iXmlFlags)
-                            {
-                                hr = WcaWriteIntegerToCaData((int)xdPreserve, &pwzCustomActionData);
-                                ExitOnFailure(hr, "failed to write Preserve Date indicator to custom action data");
-                            }
-                            else
-                            {
-                                hr = WcaWriteIntegerToCaData((int)xdDontPreserve, &pwzCustomActionData);
-                                ExitOnFailure(hr, "failed to write Don't Preserve Date indicator to custom action data");
-                            }
+        // We haven't changed the current file yet
+        fCurrentFileChanged = FALSE;
 
-                            hr = WriteChangeData(pxfcUninstall, &pwzCustomActionData);
-                            ExitOnFailure(hr, "failed to write uninstall change data");
-                        }
-                    }
+        // Do the install work for the file in the grouped order
+        for (pxfcChange = pxfc; pxfcChange != pxfcLast->pxfcNext; pxfcChange = pxfcChange->pxfcNext)
+        {
+            // If it's being installed
+            if (WcaIsInstalling(pxfcChange->isInstalled, pxfcChange->isAction))
+            {
+                if (XMLFILE_CREATE_ELEMENT & pxfcChange->iXmlFlags)
+                {
+                    xa = xaCreateElement;
+                }
+                else if (XMLFILE_DELETE_VALUE & pxfcChange->iXmlFlags)
+                {
+                    xa = xaDeleteValue;
+                }
+                else if (XMLFILE_BULKWRITE_VALUE & pxfcChange->iXmlFlags)
+                {
+                    xa = xaBulkWriteValue;
+                }
+                else
+                {
+                    xa = xaWriteValue;
                 }
-            }
-
-            // Remember the file we're currently working on
-            hr = StrAllocString(&pwzCurrentFile, pxfc->wzFile, 0);
-            ExitOnFailure(hr, "failed to copy file name");
-            fCurrentUseXPath = (XMLFILE_USE_XPATH & pxfc->iXmlFlags);
 
-            // We haven't changed the current file yet
-            fCurrentFileChanged = FALSE;
+                hr = WriteFileChange(pxfc->wzFile, pxfcChange, xa, &fCurrentFileChanged, &fCurrentUseXPath, &cFiles, &customActionData);
+                ExitOnFailure(hr, "failed to write install change for file: %ls", pxfc->wzFile);
+            }
         }
 
-        // If it's being installed
-        if (WcaIsInstalling(pxfc->isInstalled, pxfc->isAction))
+        // Do the uninstall work for the file by walking backwards through its changes (so the grouped order is reversed)
+        for (pxfcChange = pxfcLast; pxfcChange != pxfc->pxfcPrev; pxfcChange = pxfcChange->pxfcPrev)
         {
-            if (!fCurrentFileChanged)
+            // If it's being uninstalled
+            if (WcaIsUninstalling(pxfcChange->isInstalled, pxfcChange->isAction) && !(XMLFILE_DONT_UNINSTALL & pxfcChange->iXmlFlags))
             {
-                hr = BeginChangeFile(pwzCurrentFile, pxfc, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
-                fCurrentFileChanged = TRUE;
-                ++cFiles;
-            }
-
-            // Install the change
-            if (XMLFILE_CREATE_ELEMENT & pxfc->iXmlFlags)
-            {
-                hr = WcaWriteIntegerToCaData((int)xaCreateElement, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write create element action indicator to custom action data");
-            }
-            else if (XMLFILE_DELETE_VALUE & pxfc->iXmlFlags)
-            {
-                hr = WcaWriteIntegerToCaData((int)xaDeleteValue, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write delete value action indicator to custom action data");
-            }
-            else if (XMLFILE_BULKWRITE_VALUE & pxfc->iXmlFlags)
-            {
-                hr = WcaWriteIntegerToCaData((int)xaBulkWriteValue, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write builkwrite value action indicator to custom action data");
-            }
-            else
-            {
-                hr = WcaWriteIntegerToCaData((int)xaWriteValue, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write file indicator to custom action data");
-            }
+                xa = (XMLFILE_CREATE_ELEMENT & pxfcChange->iXmlFlags) ? xaDeleteElement : xaDeleteValue;
 
-            if (XMLFILE_PRESERVE_MODIFIED & pxfc->iXmlFlags)
-            {
-                hr = WcaWriteIntegerToCaData((int)xdPreserve, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write Preserve Date indicator to custom action data");
+                hr = WriteFileChange(pxfc->wzFile, pxfcChange, xa, &fCurrentFileChanged, &fCurrentUseXPath, &cFiles, &customActionData);
+                ExitOnFailure(hr, "failed to write uninstall change for file: %ls", pxfc->wzFile);
             }
-            else
-            {
-                hr = WcaWriteIntegerToCaData((int)xdDontPreserve, &pwzCustomActionData);
-                ExitOnFailure(hr, "failed to write Don't Preserve Date indicator to custom action data");
-            }
-
-            hr = WriteChangeData(pxfc, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to write change data");
         }
     }
 
-    // If we looped through all records all is well
-    if (E_NOMOREITEMS == hr)
-        hr = S_OK;
-    ExitOnFailure(hr, "failed while looping through all objects to secure");
-
     // Schedule the custom action and add to progress bar
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
         Assert(0 < cFiles);
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlFile"), pwzCustomActionData, cFiles * COST_XMLFILE);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlFile"), customActionData.pwzData, cFiles * COST_XMLFILE);
         ExitOnFailure(hr, "failed to schedule ExecXmlFile action");
     }
 
 LExit:
-    ReleaseStr(pwzCurrentFile);
-    ReleaseStr(pwzCustomActionData);
+    WcaCaDataWriterUninitialize(&customActionData);
 
     return WcaFinalize(FAILED(hr) ? ERROR_INSTALL_FAILURE : er);
 }
 
 
+static HRESULT SetSelectionLanguage(
+    __in IXMLDOMDocument* pixd,
+    __in eXmlSelectionLanguage xl
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMDocument2* pixdDocument2 = NULL;
+    BSTR bstrProperty = NULL;
+    VARIANT varValue;
+    ::VariantInit(&varValue);
+
+    if (!vfMsxml30)
+    {
+        // Older MSXML versions only know XSLPattern
+        if (xsXPath == xl)
+        {
+            ExitOnFailure(hr = E_NOTIMPL, "Error: current MSXML version does not support xpath query.");
+        }
+
+        ExitFunction();
+    }
+
+    bstrProperty = ::SysAllocString(L"SelectionLanguage");
+    ExitOnNull(bstrProperty, hr, E_OUTOFMEMORY, "failed SysAllocString");
+
+    varValue.vt = VT_BSTR;
+    varValue.bstrVal = ::SysAllocString(xsXPath == xl ? L"XPath" : L"XSLPattern");
+    ExitOnNull(varValue.bstrVal, hr, E_OUTOFMEMORY, "failed SysAllocString");
+
+    hr = pixd->QueryInterface(XmlUtil_IID_IXMLDOMDocument2, (void**)&pixdDocument2);
+    ExitOnFailure(hr, "failed in querying IXMLDOMDocument2 interface");
+
+    hr = pixdDocument2->setProperty(bstrProperty, varValue);
+    ExitOnFailure(hr, "failed in setting SelectionLanguage");
+
+LExit:
+    ReleaseObject(pixdDocument2);
+    ReleaseBSTR(bstrProperty);
+    ReleaseVariant(varValue);
+
+    return hr;
+}
+
+
 /******************************************************************
  ExecXmlFile - entry point for XmlFile Custom Action
 
@@ -486,6 +529,11 @@ extern "C" UINT __stdcall ExecXmlFile(
 
     int id = IDRETRY;
 
+    DWORD dwStart = 0;
+    DWORD dwParse = 0;
+    DWORD dwApply = 0;
+    DWORD cChanges = 0;
+
     LPWSTR pwzCustomActionData = NULL;
     LPWSTR pwzData = NULL;
     LPWSTR pwzFile = NULL;
@@ -571,6 +619,8 @@ extern "C" UINT __stdcall ExecXmlFile(
 #endif
         }
 
+        dwStart = ::GetTickCount();
+
         hr = XmlLoadDocumentFromFileEx(pwzFile, XML_LOAD_PRESERVE_WHITESPACE, &pixd);
         if (FAILED(hr))
         {
@@ -584,6 +634,10 @@ extern "C" UINT __stdcall ExecXmlFile(
         }
         WcaLog(LOGMSG_VERBOSE, "Configuring Xml File: %ls", pwzFile);
 
+        dwParse = ::GetTickCount() - dwStart;
+        dwStart = ::GetTickCount();
+        cChanges = 0;
+
         if (xsXPath == xl)
         {
             if (vfMsxml30)
@@ -612,6 +666,22 @@ extern "C" UINT __stdcall ExecXmlFile(
             if (xaOpenFile == xa || xaOpenFilex64 == xa)
                 break;
 
+            // Changes with a different selection language are applied to the same document
+            if (xaSelectionLanguage == xa)
+            {
+                hr = WcaReadIntegerFromCaData(&pwz, (int*) &xl);
+                ExitOnFailure(hr, "failed to process CustomActionData");
+
+                if (SUCCEEDED(hrOpenFailure))
+                {
+                    hr = SetSelectionLanguage(pixd, xl);
+                    ExitOnFailure(hr, "failed to change selection language for XML file: %ls", pwzFile);
+                }
+                continue;
+            }
+
+            ++cChanges;
+
             hr = WcaReadIntegerFromCaData(&pwz, (int*) &xd);
             ExitOnFailure(hr, "failed to process CustomActionData");
 
@@ -741,6 +811,9 @@ extern "C" UINT __stdcall ExecXmlFile(
         // Now that we've made all of the changes to this file, save it and move on to the next
         if (S_OK == hrOpenFailure)
         {
+            dwApply = ::GetTickCount() - dwStart;
+            dwStart = ::GetTickCount();
+
             if (fPreserveDate)
             {
                 hr = FileGetTime(pwzFile, NULL, NULL, &ft);
@@ -794,6 +867,8 @@ extern "C" UINT __stdcall ExecXmlFile(
                 ExitOnFailure(hr, "failed to set modified time of file : %ls", pwzFile);
             }
 
+            WcaLog(LOGMSG_VERBOSE, "Xml File: %ls parsed in %u ms, %u changes applied in %u ms, saved in %u ms", pwzFile, dwParse, cChanges, dwApply, ::GetTickCount() - dwStart);
+
             if (fIsFSRedirectDisabled)
             {
                 fIsFSRedirectDisabled = FALSE;
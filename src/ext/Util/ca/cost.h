@@ -7,3 +7,4 @@ const UINT COST_SERVICECONFIG = 1000;
 const UINT COST_XMLFILE = 1000;
 const UINT COST_CLOSEAPP = 500;
 const UINT COST_INTERNETSHORTCUT = 2000;
+const UINT COST_REMOVEFOLDEREX = 2000;
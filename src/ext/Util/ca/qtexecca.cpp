@@ -26,7 +26,19 @@ const LPCWSTR WIX_SILENT64_ARGUMENTS_PROPERTY = L"WixSilentExec64CmdLine";
 const LPCWSTR WIX_SILENT_TIMEOUT_PROPERTY = L"WixSilentExecCmdTimeout";
 const LPCWSTR WIX_SILENT64_TIMEOUT_PROPERTY = L"WixSilentExec64CmdTimeout";
 
-HRESULT BuildCommandLine(
+// WixCA quiet multiple commandline argument properties
+const LPCWSTR WIX_QUIET_MULTIPLE_ARGUMENTS_PROPERTY = L"WixQuietExecMultipleCmdLine";
+const LPCWSTR WIX_QUIET64_MULTIPLE_ARGUMENTS_PROPERTY = L"WixQuietExec64MultipleCmdLine";
+
+// WixCA quiet multiple timeout properties, applied to each command
+const LPCWSTR WIX_QUIET_MULTIPLE_TIMEOUT_PROPERTY = L"WixQuietExecMultipleCmdTimeout";
+const LPCWSTR WIX_QUIET64_MULTIPLE_TIMEOUT_PROPERTY = L"WixQuietExec64MultipleCmdTimeout";
+
+// WixCA quiet multiple properties limiting how many commands run at once
+const LPCWSTR WIX_QUIET_MULTIPLE_MAX_PARALLEL_PROPERTY = L"WixQuietExecMultipleMaxParallel";
+const LPCWSTR WIX_QUIET64_MULTIPLE_MAX_PARALLEL_PROPERTY = L"WixQuietExec64MultipleMaxParallel";
+
+HRESULT GetCommandLineData(
     __in LPCWSTR wzProperty,
     __out LPWSTR *ppwzCommand
     )
@@ -59,6 +71,22 @@ HRESULT BuildCommandLine(
         ExitOnFailure(hr = E_INVALIDARG, "Failed to get command line data");
     }
 
+LExit:
+    return hr;
+}
+
+HRESULT BuildCommandLine(
+    __in LPCWSTR wzProperty,
+    __out LPWSTR *ppwzCommand
+    )
+{
+    Assert(ppwzCommand);
+
+    HRESULT hr = S_OK;
+
+    hr = GetCommandLineData(wzProperty, ppwzCommand);
+    ExitOnFailure(hr, "Failed to get command line data");
+
     if (L'"' != **ppwzCommand)
     {
         WcaLog(LOGMSG_STANDARD, "Command string must begin with quoted application name.");
@@ -96,6 +124,60 @@ LExit:
 
 }
 
+// Commands run by the multiple variants are terminated when they run past their timeout, so
+// there is no timeout unless the property sets one.
+DWORD GetMultipleTimeout(LPCWSTR wzPropertyName)
+{
+    DWORD dwTimeout = INFINITE;
+    HRESULT hr = S_OK;
+
+    LPWSTR pwzData = NULL;
+
+    if (WcaIsUnicodePropertySet(wzPropertyName))
+    {
+        hr = WcaGetProperty(wzPropertyName, &pwzData);
+        ExitOnFailure(hr, "Failed to get %ls", wzPropertyName);
+
+        if ((dwTimeout = (DWORD)_wtoi(pwzData)) == 0)
+        {
+            dwTimeout = INFINITE;
+        }
+    }
+
+LExit:
+    ReleaseStr(pwzData);
+
+    return dwTimeout;
+}
+
+DWORD GetMaxParallel(LPCWSTR wzPropertyName)
+{
+    DWORD cMaxParallel = 0;
+    HRESULT hr = S_OK;
+    SYSTEM_INFO systemInfo = { };
+
+    LPWSTR pwzData = NULL;
+
+    if (WcaIsUnicodePropertySet(wzPropertyName))
+    {
+        hr = WcaGetProperty(wzPropertyName, &pwzData);
+        ExitOnFailure(hr, "Failed to get %ls", wzPropertyName);
+
+        cMaxParallel = (DWORD)_wtoi(pwzData);
+    }
+
+LExit:
+    if (0 == cMaxParallel)
+    {
+        ::GetSystemInfo(&systemInfo);
+        cMaxParallel = systemInfo.dwNumberOfProcessors;
+    }
+
+    ReleaseStr(pwzData);
+
+    return cMaxParallel;
+}
+
 HRESULT ExecCommon(
     __in LPCWSTR wzArgumentsProperty,
     __in LPCWSTR wzTimeoutProperty,
@@ -174,6 +256,140 @@ LExit:
     return hr;
 }
 
+// Runs a list of commands, one per line. The commands in a batch run at the same time, up to
+// the limit in wzMaxParallelProperty, and a blank line ends a batch so the commands after it
+// wait for the ones before it. Blank lines before the first command are ignored. A command
+// still running after the timeout in wzTimeoutProperty, in milliseconds, is terminated; with
+// no timeout set the commands run to completion.
+HRESULT ExecMultipleCommon(
+    __in LPCWSTR wzArgumentsProperty,
+    __in LPCWSTR wzTimeoutProperty,
+    __in LPCWSTR wzMaxParallelProperty,
+    __in BOOL fLogCommand,
+    __in BOOL fLogOutput
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzCommands = NULL;
+    LPWSTR pwz = NULL;
+    LPWSTR* rgwzBatch = NULL;
+    DWORD cBatch = 0;
+    DWORD dwTimeout = 0;
+    DWORD cMaxParallel = 0;
+    size_t cch = 0;
+    WCHAR wchEnd = L'\0';
+
+    // Each line is checked for a quoted application name below, so leading blank lines are fine.
+    hr = GetCommandLineData(wzArgumentsProperty, &pwzCommands);
+    ExitOnFailure(hr, "Failed to get Command Line");
+
+    dwTimeout = GetMultipleTimeout(wzTimeoutProperty);
+    cMaxParallel = GetMaxParallel(wzMaxParallelProperty);
+
+    pwz = pwzCommands;
+    for (;;)
+    {
+        while (L' ' == *pwz || L'\t' == *pwz)
+        {
+            ++pwz;
+        }
+
+        cch = wcscspn(pwz, L"\r\n");
+        wchEnd = pwz[cch];
+        pwz[cch] = L'\0';
+
+        if (cch)
+        {
+            if (L'"' != *pwz)
+            {
+                WcaLog(LOGMSG_STANDARD, "Command string must begin with quoted application name.");
+                ExitOnFailure(hr = E_INVALIDARG, "invalid command line property value");
+            }
+
+            hr = MemEnsureArraySize(reinterpret_cast<void**>(&rgwzBatch), cBatch + 1, sizeof(LPWSTR), 8);
+            ExitOnFailure(hr, "Failed to grow batch of commands");
+
+            rgwzBatch[cBatch] = pwz;
+            ++cBatch;
+        }
+        else if (cBatch)
+        {
+            hr = QuietExecMultiple(rgwzBatch, cBatch, cMaxParallel, dwTimeout, fLogCommand, fLogOutput);
+            ExitOnFailure(hr, "QuietExecMultiple Failed");
+
+            cBatch = 0;
+        }
+
+        if (L'\0' == wchEnd)
+        {
+            break;
+        }
+
+        pwz += cch + 1;
+        if (L'\r' == wchEnd && L'\n' == *pwz)
+        {
+            ++pwz;
+        }
+    }
+
+    if (cBatch)
+    {
+        hr = QuietExecMultiple(rgwzBatch, cBatch, cMaxParallel, dwTimeout, fLogCommand, fLogOutput);
+        ExitOnFailure(hr, "QuietExecMultiple Failed");
+    }
+
+LExit:
+    ReleaseMem(rgwzBatch);
+    ReleaseStr(pwzCommands);
+
+    return hr;
+}
+
+HRESULT ExecMultipleCommon64(
+    __in LPCWSTR wzArgumentsProperty,
+    __in LPCWSTR wzTimeoutProperty,
+    __in LPCWSTR wzMaxParallelProperty,
+    __in BOOL fLogCommand,
+    __in BOOL fLogOutput
+    )
+{
+    HRESULT hr = S_OK;
+#ifndef _WIN64
+    BOOL fIsWow64Initialized = FALSE;
+    BOOL fRedirected = FALSE;
+
+    hr = WcaInitializeWow64();
+    if (S_FALSE == hr)
+    {
+        hr = TYPE_E_DLLFUNCTIONNOTFOUND;
+    }
+    ExitOnFailure(hr, "Failed to intialize WOW64.");
+    fIsWow64Initialized = TRUE;
+
+    hr = WcaDisableWow64FSRedirection();
+    ExitOnFailure(hr, "Failed to enable filesystem redirection.");
+    fRedirected = TRUE;
+#endif
+
+    hr = ExecMultipleCommon(wzArgumentsProperty, wzTimeoutProperty, wzMaxParallelProperty, fLogCommand, fLogOutput);
+    ExitOnFailure(hr, "QuietExecMultiple64 Failed");
+
+LExit:
+#ifndef _WIN64
+    if (fRedirected)
+    {
+        WcaRevertWow64FSRedirection();
+    }
+
+    if (fIsWow64Initialized)
+    {
+        WcaFinalizeWow64();
+    }
+#endif
+
+    return hr;
+}
+
 // These two custom actions are deprecated, and should go away in wix v4.0. WixQuietExec replaces this one,
 // and is not intended to have any difference in behavior apart from CA name and property names.
 extern "C" UINT __stdcall CAQuietExec(
@@ -314,3 +530,49 @@ LExit:
 
     return WcaFinalize(er);
 }
+
+extern "C" UINT __stdcall WixQuietExecMultiple(
+    __in MSIHANDLE hInstall
+    )
+{
+    Assert(hInstall);
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+
+    hr = WcaInitialize(hInstall, "WixQuietExecMultiple");
+    ExitOnFailure(hr, "Failed to initialize");
+
+    hr = ExecMultipleCommon(WIX_QUIET_MULTIPLE_ARGUMENTS_PROPERTY, WIX_QUIET_MULTIPLE_TIMEOUT_PROPERTY, WIX_QUIET_MULTIPLE_MAX_PARALLEL_PROPERTY, TRUE, TRUE);
+    ExitOnFailure(hr, "Failed in ExecMultipleCommon method");
+
+LExit:
+    if (FAILED(hr))
+    {
+        er = ERROR_INSTALL_FAILURE;
+    }
+
+    return WcaFinalize(er);
+}
+
+extern "C" UINT __stdcall WixQuietExec64Multiple(
+    __in MSIHANDLE hInstall
+    )
+{
+    Assert(hInstall);
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+
+    hr = WcaInitialize(hInstall, "WixQuietExec64Multiple");
+    ExitOnFailure(hr, "Failed to initialize");
+
+    hr = ExecMultipleCommon64(WIX_QUIET64_MULTIPLE_ARGUMENTS_PROPERTY, WIX_QUIET64_MULTIPLE_TIMEOUT_PROPERTY, WIX_QUIET64_MULTIPLE_MAX_PARALLEL_PROPERTY, TRUE, TRUE);
+    ExitOnFailure(hr, "Failed in ExecMultipleCommon64 method");
+
+LExit:
+    if (FAILED(hr))
+    {
+        er = ERROR_INSTALL_FAILURE;
+    }
+
+    return WcaFinalize(er);
+}
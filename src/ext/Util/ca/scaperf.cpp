@@ -79,6 +79,8 @@ extern "C" UINT __stdcall ConfigurePerfmonInstall(
 
     PMSIHANDLE hView, hRec;
     LPWSTR pwzData = NULL, pwzName = NULL, pwzFile = NULL;
+    LPWSTR pwzFiles = NULL, pwzNames = NULL;
+    DWORD cPerfmon = 0;
     INSTALLSTATE isInstalled, isAction;
 
     hr = WcaInitialize(hInstall, "ConfigurePerfmonInstall");
@@ -113,10 +115,12 @@ extern "C" UINT __stdcall ConfigurePerfmonInstall(
         ExitOnFailure(hr, "failed to get File for PerfMon");
 
         WcaLog(LOGMSG_VERBOSE, "ConfigurePerfmonInstall's CustomActionData: '%ls', '%ls'", pwzName, pwzFile);
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RegisterPerfmon"), pwzFile, COST_PERFMON_REGISTER);
-        ExitOnFailure(hr, "failed to schedule RegisterPerfmon action");
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RollbackRegisterPerfmon"), pwzName, COST_PERFMON_UNREGISTER);
-        ExitOnFailure(hr, "failed to schedule RollbackRegisterPerfmon action");
+        hr = WcaWriteStringToCaData(pwzFile, &pwzFiles);
+        ExitOnFailure(hr, "failed to add File to CustomActionData for PerfMon");
+        hr = WcaWriteStringToCaData(pwzName, &pwzNames);
+        ExitOnFailure(hr, "failed to add Name to CustomActionData for PerfMon");
+
+        ++cPerfmon;
     }
 
     if (hr == E_NOMOREITEMS)
@@ -125,9 +129,20 @@ extern "C" UINT __stdcall ConfigurePerfmonInstall(
     }
     ExitOnFailure(hr, "Failure while processing PerfMon");
 
+    // Register all of the DLLs in one action, rolling back the whole set on failure.
+    if (cPerfmon)
+    {
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RollbackRegisterPerfmon"), pwzNames, cPerfmon * COST_PERFMON_UNREGISTER);
+        ExitOnFailure(hr, "failed to schedule RollbackRegisterPerfmon action");
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RegisterPerfmon"), pwzFiles, cPerfmon * COST_PERFMON_REGISTER);
+        ExitOnFailure(hr, "failed to schedule RegisterPerfmon action");
+    }
+
     hr = S_OK;
 
 LExit:
+    ReleaseStr(pwzNames);
+    ReleaseStr(pwzFiles);
     ReleaseStr(pwzData);
     ReleaseStr(pwzName);
     ReleaseStr(pwzFile);
@@ -152,6 +167,8 @@ extern "C" UINT __stdcall ConfigurePerfmonUninstall(
 
     PMSIHANDLE hView, hRec;
     LPWSTR pwzData = NULL, pwzName = NULL, pwzFile = NULL;
+    LPWSTR pwzFiles = NULL, pwzNames = NULL;
+    DWORD cPerfmon = 0;
     INSTALLSTATE isInstalled, isAction;
 
     hr = WcaInitialize(hInstall, "ConfigurePerfmonUninstall");
@@ -186,10 +203,12 @@ extern "C" UINT __stdcall ConfigurePerfmonUninstall(
         ExitOnFailure(hr, "failed to get File for PerfMon");
 
         WcaLog(LOGMSG_VERBOSE, "ConfigurePerfmonUninstall's CustomActionData: '%ls', '%ls'", pwzName, pwzFile);
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"UnregisterPerfmon"), pwzName, COST_PERFMON_UNREGISTER);
-        ExitOnFailure(hr, "failed to schedule UnregisterPerfmon action");
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RollbackUnregisterPerfmon"), pwzFile, COST_PERFMON_REGISTER);
-        ExitOnFailure(hr, "failed to schedule RollbackUnregisterPerfmon action");
+        hr = WcaWriteStringToCaData(pwzName, &pwzNames);
+        ExitOnFailure(hr, "failed to add Name to CustomActionData for PerfMon");
+        hr = WcaWriteStringToCaData(pwzFile, &pwzFiles);
+        ExitOnFailure(hr, "failed to add File to CustomActionData for PerfMon");
+
+        ++cPerfmon;
     }
 
     if (hr == E_NOMOREITEMS)
@@ -198,9 +217,20 @@ extern "C" UINT __stdcall ConfigurePerfmonUninstall(
     }
     ExitOnFailure(hr, "Failure while processing PerfMon");
 
+    // Unregister all of the DLLs in one action, rolling back the whole set on failure.
+    if (cPerfmon)
+    {
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"RollbackUnregisterPerfmon"), pwzFiles, cPerfmon * COST_PERFMON_REGISTER);
+        ExitOnFailure(hr, "failed to schedule RollbackUnregisterPerfmon action");
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"UnregisterPerfmon"), pwzNames, cPerfmon * COST_PERFMON_UNREGISTER);
+        ExitOnFailure(hr, "failed to schedule UnregisterPerfmon action");
+    }
+
     hr = S_OK;
 
 LExit:
+    ReleaseStr(pwzNames);
+    ReleaseStr(pwzFiles);
     ReleaseStr(pwzData);
     ReleaseStr(pwzName);
     ReleaseStr(pwzFile);
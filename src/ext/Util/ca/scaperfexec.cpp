@@ -74,7 +74,7 @@ LExit:
                    counters
 
  Input:  deferred CustomActionData - 
-    wzFile or wzName
+    wzFile\twzFile\t... or wzName\twzName\t...
 *******************************************************************/
 extern "C" UINT __stdcall RegisterPerfmon(
     __in MSIHANDLE hInstall
@@ -84,6 +84,8 @@ extern "C" UINT __stdcall RegisterPerfmon(
     UINT er = ERROR_SUCCESS;
     HRESULT hr = S_OK;
     LPWSTR pwzData = NULL;
+    LPWSTR pwz = NULL;
+    LPWSTR pwzFile = NULL;
 
     HMODULE hMod = NULL;
     PFNPERFCOUNTERTEXTSTRINGS pfnPerfCounterTextString;
@@ -93,6 +95,8 @@ extern "C" UINT __stdcall RegisterPerfmon(
     DWORD cchShortPathLength  = 0;
 
     LPWSTR pwzCommand = NULL;
+    DWORD cFiles = 0;
+    DWORD dwStart = ::GetTickCount();
 
     hr = WcaInitialize(hInstall, "RegisterPerfmon");
     ExitOnFailure(hr, "failed to initialize");
@@ -115,35 +119,61 @@ extern "C" UINT __stdcall RegisterPerfmon(
     hr = StrAlloc(&pwzShortPath, cchShortPath);
     ExitOnFailure(hr, "failed to allocate string");
 
-    WcaLog(LOGMSG_VERBOSE, "Converting DLL path to short format: %ls", pwzData);
-    cchShortPathLength = ::GetShortPathNameW(pwzData, pwzShortPath, cchShortPath);
-    if (cchShortPathLength > cchShortPath)
+    pwz = pwzData;
+
+    while (S_OK == (hr = WcaReadStringFromCaData(&pwz, &pwzFile)))
     {
-        cchShortPath = cchShortPathLength + 1;
-        hr = StrAlloc(&pwzShortPath, cchShortPath);
-        ExitOnFailure(hr, "failed to allocate string");
+        WcaLog(LOGMSG_VERBOSE, "Converting DLL path to short format: %ls", pwzFile);
+        cchShortPathLength = ::GetShortPathNameW(pwzFile, pwzShortPath, cchShortPath);
+        if (cchShortPathLength > cchShortPath)
+        {
+            cchShortPath = cchShortPathLength + 1;
+            hr = StrAlloc(&pwzShortPath, cchShortPath);
+            ExitOnFailure(hr, "failed to allocate string");
+
+            cchShortPathLength = ::GetShortPathNameW(pwzFile, pwzShortPath, cchShortPath);
+        }
+
+        if (0 == cchShortPathLength)
+        {
+            ExitOnLastError(hr, "failed to get short path format of path: %ls", pwzFile);
+        }
+
+        hr = StrAllocFormatted(&pwzCommand, L"lodctr \"%s\"", pwzShortPath);
+        ExitOnFailure(hr, "failed to format lodctr string");
+
+        WcaLog(LOGMSG_VERBOSE, "RegisterPerfmon running command: '%ls'", pwzCommand);
+        dwRet = (*pfnPerfCounterTextString)(pwzCommand, TRUE);
+        if (dwRet != ERROR_SUCCESS && dwRet != ERROR_ALREADY_EXISTS)
+        {
+            hr = HRESULT_FROM_WIN32(dwRet);
+            MessageExitOnFailure(hr, msierrPERFMONFailedRegisterDLL, "failed to register with PerfMon, DLL: %ls", pwzFile);
+        }
+
+        ++cFiles;
 
-        cchShortPathLength = ::GetShortPathNameW(pwzData, pwzShortPath, cchShortPath);
+        hr = WcaProgressMessage(COST_PERFMON_REGISTER, FALSE);
+        ExitOnFailure(hr, "failed to send progress message");
     }
 
-    if (0 == cchShortPathLength)
+    if (E_NOMOREITEMS == hr)
     {
-        ExitOnLastError(hr, "failed to get short path format of path: %ls", pwzData);
+        hr = S_OK;
     }
+    ExitOnFailure(hr, "failed to read file from CustomActionData");
 
-    hr = StrAllocFormatted(&pwzCommand, L"lodctr \"%s\"", pwzShortPath);
-    ExitOnFailure(hr, "failed to format lodctr string");
+    WcaLog(LOGMSG_VERBOSE, "Registered %u PerfMon DLLs in %u ms", cFiles, ::GetTickCount() - dwStart);
 
-    WcaLog(LOGMSG_VERBOSE, "RegisterPerfmon running command: '%ls'", pwzCommand);
-    dwRet = (*pfnPerfCounterTextString)(pwzCommand, TRUE);
-    if (dwRet != ERROR_SUCCESS && dwRet != ERROR_ALREADY_EXISTS)
+    hr = S_OK;
+LExit:
+    if (hMod)
     {
-        hr = HRESULT_FROM_WIN32(dwRet);
-        MessageExitOnFailure(hr, msierrPERFMONFailedRegisterDLL, "failed to register with PerfMon, DLL: %ls", pwzData);
+        ::FreeLibrary(hMod);
     }
 
-    hr = S_OK;
-LExit:
+    ReleaseStr(pwzCommand);
+    ReleaseStr(pwzShortPath);
+    ReleaseStr(pwzFile);
     ReleaseStr(pwzData);
 
     if (FAILED(hr))
@@ -160,6 +190,8 @@ extern "C" UINT __stdcall UnregisterPerfmon(
     UINT er = ERROR_SUCCESS;
     HRESULT hr = S_OK;
     LPWSTR pwzData = NULL;
+    LPWSTR pwz = NULL;
+    LPWSTR pwzName = NULL;
 
     HMODULE hMod = NULL;
     PFNPERFCOUNTERTEXTSTRINGS pfnPerfCounterTextString;
@@ -185,19 +217,39 @@ extern "C" UINT __stdcall UnregisterPerfmon(
     pfnPerfCounterTextString = (PFNPERFCOUNTERTEXTSTRINGS)::GetProcAddress(hMod, "UnloadPerfCounterTextStringsW");
     ExitOnNullWithLastError(pfnPerfCounterTextString, hr, "failed to get DLL function for PerfMon");
 
-    hr = ::StringCchPrintfW(wz, countof(wz), L"unlodctr \"%s\"", pwzData);
-    ExitOnFailure(hr, "Failed to format unlodctr string with: %ls", pwzData);
-    WcaLog(LOGMSG_VERBOSE, "UnregisterPerfmon running command: '%ls'", wz);
-    dwRet = (*pfnPerfCounterTextString)(wz, TRUE);
-    // if the counters aren't registered, then OK to continue
-    if (dwRet != ERROR_SUCCESS && dwRet != ERROR_FILE_NOT_FOUND && dwRet != ERROR_BADKEY)
+    pwz = pwzData;
+
+    while (S_OK == (hr = WcaReadStringFromCaData(&pwz, &pwzName)))
     {
-        hr = HRESULT_FROM_WIN32(dwRet);
-        MessageExitOnFailure(hr, msierrPERFMONFailedUnregisterDLL, "failed to unregsister with PerfMon, DLL: %ls", pwzData);
+        hr = ::StringCchPrintfW(wz, countof(wz), L"unlodctr \"%s\"", pwzName);
+        ExitOnFailure(hr, "Failed to format unlodctr string with: %ls", pwzName);
+        WcaLog(LOGMSG_VERBOSE, "UnregisterPerfmon running command: '%ls'", wz);
+        dwRet = (*pfnPerfCounterTextString)(wz, TRUE);
+        // if the counters aren't registered, then OK to continue
+        if (dwRet != ERROR_SUCCESS && dwRet != ERROR_FILE_NOT_FOUND && dwRet != ERROR_BADKEY)
+        {
+            hr = HRESULT_FROM_WIN32(dwRet);
+            MessageExitOnFailure(hr, msierrPERFMONFailedUnregisterDLL, "failed to unregsister with PerfMon, DLL: %ls", pwzName);
+        }
+
+        hr = WcaProgressMessage(COST_PERFMON_UNREGISTER, FALSE);
+        ExitOnFailure(hr, "failed to send progress message");
     }
 
+    if (E_NOMOREITEMS == hr)
+    {
+        hr = S_OK;
+    }
+    ExitOnFailure(hr, "failed to read name from CustomActionData");
+
     hr = S_OK;
 LExit:
+    if (hMod)
+    {
+        ::FreeLibrary(hMod);
+    }
+
+    ReleaseStr(pwzName);
     ReleaseStr(pwzData);
 
     if (FAILED(hr))
@@ -231,6 +283,9 @@ static HRESULT ExecutePerfCounterData(
     HANDLE hIniData = INVALID_HANDLE_VALUE;
     HANDLE hConstantData = INVALID_HANDLE_VALUE;
 
+    DWORD cCategories = 0;
+    DWORD dwStart = ::GetTickCount();
+
     // Load the system performance counter helper DLL then get the appropriate
     // entrypoint out of it. Fortunately, they have the same signature so we
     // can use one function pointer to point to both.
@@ -267,8 +322,13 @@ static HRESULT ExecutePerfCounterData(
 
         if (fInstall)
         {
-            hr = PathCreateTempDirectory(NULL, L"WIXPF%03x", 999, &pwzTempFolder);
-            ExitOnFailure(hr, "Failed to create temp directory.");
+            // Every category's data files are written over the previous ones
+            // in a single temp directory that is removed once all are loaded.
+            if (!pwzTempFolder)
+            {
+                hr = PathCreateTempDirectory(NULL, L"WIXPF%03x", 999, &pwzTempFolder);
+                ExitOnFailure(hr, "Failed to create temp directory.");
+            }
 
             hr = CreateDataFile(pwzTempFolder, pwzIniData, TRUE, &hIniData, &pwzIniFile);
             ExitOnFailure(hr, "Failed to create .ini file for performance counter category: %ls", pwzName);
@@ -295,8 +355,6 @@ static HRESULT ExecutePerfCounterData(
                 ::CloseHandle(hConstantData);
                 hConstantData = INVALID_HANDLE_VALUE;
             }
-
-            DirEnsureDelete(pwzTempFolder, TRUE, TRUE);
         }
         else
         {
@@ -313,6 +371,8 @@ static HRESULT ExecutePerfCounterData(
             hr = HRESULT_FROM_WIN32(er);
             ExitOnFailure(hr, "Failed to execute uninstall of performance counter category: %ls", pwzName);
         }
+
+        ++cCategories;
     }
 
     if (E_NOMOREITEMS == hr) // If there are no more items, all is well
@@ -321,6 +381,8 @@ static HRESULT ExecutePerfCounterData(
     }
     ExitOnFailure(hr, "Failed to execute all perf counter data.");
 
+    WcaLog(LOGMSG_VERBOSE, "Executed %ls for %u performance counter categories in %u ms", wzPrefix, cCategories, ::GetTickCount() - dwStart);
+
     hr = S_OK;
 
 LExit:
@@ -334,6 +396,11 @@ LExit:
         ::CloseHandle(hConstantData);
     }
 
+    if (pwzTempFolder)
+    {
+        DirEnsureDelete(pwzTempFolder, TRUE, TRUE);
+    }
+
     ReleaseStr(pwzExecute);
     ReleaseStr(pwzIniFile);
     ReleaseStr(pwzTempFolder);
@@ -19,6 +19,31 @@ enum eOBJECTTYPE { OT_UNKNOWN, OT_SERVICE, OT_FOLDER, OT_FILE, OT_REGISTRY };
 enum eSECURE_OBJECT_ATTRIBUTE
 {
     SECURE_OBJECT_ATTRIBUTE_INHERITABLE = 0x1,
+    SECURE_OBJECT_ATTRIBUTE_PARALLEL_PROPAGATION = 0x2,
+};
+
+const DWORD SECURE_OBJECT_MAX_PROPAGATION_THREADS = 8;
+const DWORD SECURE_OBJECT_PROGRESS_INTERVAL = 250;
+
+// All of the permissions for one object, applied with a single SetNamedSecurityInfo call.
+struct SECURE_OBJECT
+{
+    LPWSTR sczKey;
+    LPWSTR sczObject;
+    LPWSTR sczTable;
+    SE_OBJECT_TYPE objectType;
+    BOOL fParallelPropagation;
+
+    EXPLICIT_ACCESSW* rgEntries; // Trustee.ptstrName is a SID owned by the entry.
+    DWORD cEntries;
+    DWORD cRequested;            // CustomActionData entries merged into this object, for progress.
+};
+
+// Progress owed to the installer for one folder while its subtrees are propagated.
+struct SECURE_OBJECT_PROPAGATION_PROGRESS
+{
+    UINT uiCost;
+    UINT uiReported;
 };
 
 static eOBJECTTYPE EObjectTypeFromString(
@@ -336,7 +361,7 @@ extern "C" UINT __stdcall SchedSecureObjects(
     INSTALLSTATE isInstalled;
     INSTALLSTATE isAction;
 
-    LPWSTR pwzCustomActionData = NULL;
+    WCA_CADATA_WRITER customActionData = { };
 
     DWORD cObjects = 0;
     eOBJECTTYPE eType = OT_UNKNOWN;
@@ -409,33 +434,33 @@ extern "C" UINT __stdcall SchedSecureObjects(
 
         if (WcaIsInstalling(isInstalled, isAction))
         {
-            hr = WcaWriteStringToCaData(pwzTargetPath, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, pwzTargetPath);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             // add the data to the CustomActionData
             hr = WcaGetRecordString(hRec, QSO_SECUREOBJECT, &pwzData);
             ExitOnFailure(hr, "failed to get name of object");
-            hr = WcaWriteStringToCaData(pwzTable, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, pwzTable);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             hr = WcaGetRecordFormattedString(hRec, QSO_DOMAIN, &pwzData);
             ExitOnFailure(hr, "failed to get domain for user to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, pwzData);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             hr = WcaGetRecordFormattedString(hRec, QSO_USER, &pwzData);
             ExitOnFailure(hr, "failed to get user to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, pwzData);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             hr = WcaGetRecordInteger(hRec, QSO_ATTRIBUTES, reinterpret_cast<int*>(&dwAttributes));
             ExitOnFailure(hr, "failed to get attributes to configure object");
-            hr = WcaWriteIntegerToCaData(dwAttributes, &pwzCustomActionData);
+            hr = WcaCaDataWriteInteger(&customActionData, dwAttributes);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             hr = WcaGetRecordString(hRec, QSO_PERMISSION, &pwzData);
             ExitOnFailure(hr, "failed to get permission to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
+            hr = WcaCaDataWriteString(&customActionData, pwzData);
             ExitOnFailure(hr, "failed to add data to CustomActionData");
 
             ++cObjects;
@@ -450,17 +475,17 @@ extern "C" UINT __stdcall SchedSecureObjects(
     //
     // schedule the custom action and add to progress bar
     //
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
         Assert(0 < cObjects);
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjects"), pwzCustomActionData, cObjects * COST_SECUREOBJECT);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjects"), customActionData.pwzData, cObjects * COST_SECUREOBJECT);
         ExitOnFailure(hr, "failed to schedule ExecSecureObjects action");
     }
 
 LExit:
     ReleaseStr(pwzSecureObject);
-    ReleaseStr(pwzCustomActionData);
+    WcaCaDataWriterUninitialize(&customActionData);
     ReleaseStr(pwzData);
     ReleaseStr(pwzTable);
     ReleaseStr(pwzTargetPath);
@@ -573,12 +598,354 @@ LExit:
     return WcaFinalize(er);
 }
 
+static HRESULT GetSecureObjectSid(
+    __in_z LPCWSTR wzDomain,
+    __in_z LPCWSTR wzUser,
+    __inout LPWSTR* psczAccount,
+    __out PSID* ppsid
+    )
+{
+    HRESULT hr = S_OK;
+
+    // figure out the right user to put into the access block
+    if (!*wzDomain && 0 == lstrcmpW(wzUser, L"Everyone"))
+    {
+        hr = AclGetWellKnownSid(WinWorldSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"Administrators"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinAdministratorsSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"LocalSystem"))
+    {
+        hr = AclGetWellKnownSid(WinLocalSystemSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"LocalService"))
+    {
+        hr = AclGetWellKnownSid(WinLocalServiceSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"NetworkService"))
+    {
+        hr = AclGetWellKnownSid(WinNetworkServiceSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"AuthenticatedUser"))
+    {
+        hr = AclGetWellKnownSid(WinAuthenticatedUserSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"Guests"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinGuestsSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"CREATOR OWNER"))
+    {
+        hr = AclGetWellKnownSid(WinCreatorOwnerSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"INTERACTIVE"))
+    {
+        hr = AclGetWellKnownSid(WinInteractiveSid, ppsid);
+    }
+    else if (!*wzDomain && 0 == lstrcmpW(wzUser, L"Users"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinUsersSid, ppsid);
+    }
+    else
+    {
+        hr = StrAllocFormatted(psczAccount, L"%s%s%s", wzDomain, *wzDomain ? L"\\" : L"", wzUser);
+        ExitOnFailure(hr, "failed to build domain user name");
+
+        hr = AclGetAccountSid(NULL, *psczAccount, ppsid);
+    }
+    ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", wzDomain, *wzDomain ? L"\\" : L"", wzUser);
+
+LExit:
+    return hr;
+}
+
+/******************************************************************
+ AddSecureObjectEntry - adds a permission to the object it secures,
+                        creating the object the first time it is seen
+
+ NOTE: takes ownership of psid
+******************************************************************/
+static HRESULT AddSecureObjectEntry(
+    __in STRINGDICT_HANDLE sdObjects,
+    __inout SECURE_OBJECT** prgObjects,
+    __inout DWORD* pcObjects,
+    __inout LPWSTR* psczKey,
+    __in_z LPCWSTR wzObject,
+    __in_z LPCWSTR wzTable,
+    __in DWORD dwAttributes,
+    __in DWORD dwPermissions,
+    __in PSID psid
+    )
+{
+    HRESULT hr = S_OK;
+    SECURE_OBJECT* pObject = NULL;
+    EXPLICIT_ACCESSW* pEntry = NULL;
+
+    hr = StrAllocFormatted(psczKey, L"%ls\t%ls", wzTable, wzObject);
+    ExitOnFailure(hr, "failed to build key for object: %ls", wzObject);
+
+    hr = DictGetValue(sdObjects, *psczKey, reinterpret_cast<void**>(&pObject));
+    if (E_NOTFOUND == hr)
+    {
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(prgObjects), *pcObjects + 1, sizeof(SECURE_OBJECT), 16);
+        ExitOnFailure(hr, "failed to grow secure objects");
+
+        pObject = *prgObjects + *pcObjects;
+        ++*pcObjects;
+
+        hr = StrAllocString(&pObject->sczKey, *psczKey, 0);
+        ExitOnFailure(hr, "failed to copy key for object: %ls", wzObject);
+
+        hr = StrAllocString(&pObject->sczObject, wzObject, 0);
+        ExitOnFailure(hr, "failed to copy object: %ls", wzObject);
+
+        hr = StrAllocString(&pObject->sczTable, wzTable, 0);
+        ExitOnFailure(hr, "failed to copy table for object: %ls", wzObject);
+
+        pObject->objectType = SEObjectTypeFromString(wzTable);
+
+        hr = DictAddValue(sdObjects, pObject);
+        ExitOnFailure(hr, "failed to add object: %ls", wzObject);
+    }
+    ExitOnFailure(hr, "failed to find object: %ls", wzObject);
+
+    ++pObject->cRequested;
+
+    if (dwAttributes & SECURE_OBJECT_ATTRIBUTE_PARALLEL_PROPAGATION)
+    {
+        pObject->fParallelPropagation = TRUE;
+    }
+
+    // Each entry replaces whatever an earlier entry set for the same account,
+    // so only the last one for a SID needs to be given to SetEntriesInAcl.
+    for (DWORD i = 0; i < pObject->cEntries; ++i)
+    {
+        if (::EqualSid(reinterpret_cast<PSID>(pObject->rgEntries[i].Trustee.ptstrName), psid))
+        {
+            WcaLog(LOGMSG_VERBOSE, "Merging duplicate permission for object: %ls", wzObject);
+
+            pEntry = pObject->rgEntries + i;
+            break;
+        }
+    }
+
+    if (pEntry)
+    {
+        AclFreeSid(psid);
+        psid = reinterpret_cast<PSID>(pEntry->Trustee.ptstrName);
+    }
+    else
+    {
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&pObject->rgEntries), pObject->cEntries + 1, sizeof(EXPLICIT_ACCESSW), 4);
+        ExitOnFailure(hr, "failed to grow permissions for object: %ls", wzObject);
+
+        pEntry = pObject->rgEntries + pObject->cEntries;
+        ++pObject->cEntries;
+    }
+
+    pEntry->grfAccessMode = SET_ACCESS;
+    pEntry->grfInheritance = (dwAttributes & SECURE_OBJECT_ATTRIBUTE_INHERITABLE) ? SUB_CONTAINERS_AND_OBJECTS_INHERIT : NO_INHERITANCE;
+    pEntry->grfAccessPermissions = dwPermissions;
+
+#pragma prefast(push)
+#pragma prefast(disable:25029)
+    ::BuildTrusteeWithSidW(&pEntry->Trustee, psid);
+#pragma prefast(pop)
+    psid = NULL;
+
+LExit:
+    if (psid)
+    {
+        AclFreeSid(psid);
+    }
+
+    return hr;
+}
+
+static void FreeSecureObjects(
+    __in_ecount(cObjects) SECURE_OBJECT* rgObjects,
+    __in DWORD cObjects
+    )
+{
+    for (DWORD i = 0; i < cObjects; ++i)
+    {
+        SECURE_OBJECT* pObject = rgObjects + i;
+
+        for (DWORD j = 0; j < pObject->cEntries; ++j)
+        {
+            AclFreeSid(reinterpret_cast<PSID>(pObject->rgEntries[j].Trustee.ptstrName));
+        }
+
+        ReleaseMem(pObject->rgEntries);
+        ReleaseStr(pObject->sczTable);
+        ReleaseStr(pObject->sczObject);
+        ReleaseStr(pObject->sczKey);
+    }
+
+    ReleaseMem(rgObjects);
+}
+
+static HRESULT CALLBACK SendPropagationProgress(
+    __in DWORD cCompleted,
+    __in DWORD cTotal,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    SECURE_OBJECT_PROPAGATION_PROGRESS* pProgress = reinterpret_cast<SECURE_OBJECT_PROPAGATION_PROGRESS*>(pvContext);
+    UINT uiTicks = static_cast<UINT>(static_cast<ULONGLONG>(pProgress->uiCost) * cCompleted / cTotal) - pProgress->uiReported;
+
+    if (uiTicks)
+    {
+        hr = WcaProgressMessage(uiTicks, FALSE);
+        ExitOnFailure(hr, "failed to send progress message");
+
+        pProgress->uiReported += uiTicks;
+    }
+
+LExit:
+    return hr;
+}
+
+/******************************************************************
+ SetFolderAclWithParallelPropagation - sets the folder's own DACL without
+                   automatic propagation and then carries the inheritable
+                   ACEs into each child's subtree on a pool of workers
+
+******************************************************************/
+static HRESULT SetFolderAclWithParallelPropagation(
+    __in SECURE_OBJECT* pObject,
+    __in PACL pAcl,
+    __in SECURITY_DESCRIPTOR_CONTROL sdcExisting
+    )
+{
+    HRESULT hr = S_OK;
+    SECURITY_DESCRIPTOR sd = { };
+    SECURE_OBJECT_PROPAGATION_PROGRESS progress = { };
+    LPWSTR sczFailedPath = NULL;
+    DWORD dwStart = ::GetTickCount();
+
+    progress.uiCost = COST_SECUREOBJECT * pObject->cRequested;
+
+    if (!::InitializeSecurityDescriptor(&sd, SECURITY_DESCRIPTOR_REVISION))
+    {
+        ExitWithLastError(hr, "failed to initialize security descriptor for object: %ls", pObject->sczObject);
+    }
+
+    if (!::SetSecurityDescriptorDacl(&sd, TRUE, pAcl, FALSE))
+    {
+        ExitWithLastError(hr, "failed to set DACL in security descriptor for object: %ls", pObject->sczObject);
+    }
+
+    if (!::SetSecurityDescriptorControl(&sd, SE_DACL_PROTECTED | SE_DACL_AUTO_INHERITED, sdcExisting & (SE_DACL_PROTECTED | SE_DACL_AUTO_INHERITED)))
+    {
+        ExitWithLastError(hr, "failed to set security descriptor control for object: %ls", pObject->sczObject);
+    }
+
+    if (!::SetFileSecurityW(pObject->sczObject, DACL_SECURITY_INFORMATION, &sd))
+    {
+        MessageExitOnLastError(hr, msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", pObject->sczObject);
+    }
+
+    // Tick the progress bar as subtrees finish, within the cost scheduled for the object.
+    hr = AclPropagateInheritance(pObject->sczObject, SECURE_OBJECT_MAX_PROPAGATION_THREADS, SECURE_OBJECT_PROGRESS_INTERVAL, SendPropagationProgress, &progress, &sczFailedPath);
+    if (sczFailedPath)
+    {
+        MessageExitOnFailure(hr, msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", sczFailedPath);
+    }
+    ExitOnFailure(hr, "failed to propagate security info for folder: %ls", pObject->sczObject);
+
+    hr = WcaProgressMessage(progress.uiCost - progress.uiReported, FALSE);
+    ExitOnFailure(hr, "failed to send progress message");
+
+    WcaLog(LOGMSG_VERBOSE, "Propagated security info for folder: %ls in %u ms", pObject->sczObject, ::GetTickCount() - dwStart);
+
+LExit:
+    ReleaseStr(sczFailedPath);
+
+    return hr;
+}
+
+static HRESULT ApplySecureObject(
+    __in SECURE_OBJECT* pObject
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwRevision = 0;
+    PSECURITY_DESCRIPTOR psd = NULL;
+    SECURITY_DESCRIPTOR_CONTROL sdc = {0};
+    SECURITY_INFORMATION si = {0};
+    PACL pAclExisting = NULL;   // doesn't get freed
+    PACL pAclNew = NULL;
+
+    WcaLog(LOGMSG_VERBOSE, "Securing Object: %ls Type: %ls with %u permissions", pObject->sczObject, pObject->sczTable, pObject->cEntries);
+
+    if (SE_UNKNOWN_OBJECT_TYPE == pObject->objectType)
+    {
+        MessageExitOnFailure(hr = E_UNEXPECTED, msierrSecureObjectsUnknownType, "unknown object type: %ls", pObject->sczTable);
+    }
+
+    er = ::GetNamedSecurityInfoW(pObject->sczObject, pObject->objectType, DACL_SECURITY_INFORMATION, NULL, NULL, &pAclExisting, NULL, &psd);
+    ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get security info for object: %ls", pObject->sczObject);
+
+    //Need to see if DACL is protected so getting Descriptor information
+    if (!::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
+    {
+        ExitOnLastError(hr, "failed to get security descriptor control for object: %ls", pObject->sczObject);
+    }
+
+#pragma prefast(push)
+#pragma prefast(disable:25029)
+    er = ::SetEntriesInAclW(pObject->cEntries, pObject->rgEntries, pAclExisting, &pAclNew);
+#pragma prefast(pop)
+    ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to add ACLs for object: %ls", pObject->sczObject);
+
+    if (pObject->fParallelPropagation && SE_FILE_OBJECT == pObject->objectType && DirExists(pObject->sczObject, NULL))
+    {
+        hr = SetFolderAclWithParallelPropagation(pObject, pAclNew, sdc);
+        ExitOnFailure(hr, "failed to set security info for folder: %ls", pObject->sczObject);
+    }
+    else
+    {
+        if (sdc & SE_DACL_PROTECTED)
+        {
+            si = DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION;
+        }
+        else
+        {
+            si = DACL_SECURITY_INFORMATION;
+        }
+        er = ::SetNamedSecurityInfoW(pObject->sczObject, pObject->objectType, si, NULL, NULL, pAclNew, NULL);
+        MessageExitOnFailure(hr = HRESULT_FROM_WIN32(er), msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", pObject->sczObject);
+
+        hr = WcaProgressMessage(COST_SECUREOBJECT * pObject->cRequested, FALSE);
+        ExitOnFailure(hr, "failed to send progress message");
+    }
+
+LExit:
+    if (pAclNew)
+    {
+        ::LocalFree(pAclNew);
+    }
+    if (psd)
+    {
+        ::LocalFree(psd);
+    }
+
+    return hr;
+}
+
 /******************************************************************
  CaExecSecureObjects - entry point for SecureObjects Custom Action
                    called as Type 1025 CustomAction (deferred binary DLL)
 
  NOTE: deferred CustomAction since it modifies the machine
  NOTE: CustomActionData == wzObject\twzTable\twzDomain\twzUser\tdwAttributes\tdwPermissions\t...
+ NOTE: all of the permissions for an object are applied together, in the
+       order each object first appears
 ******************************************************************/
 extern "C" UINT __stdcall ExecSecureObjects(
     __in MSIHANDLE hInstall
@@ -593,22 +960,16 @@ extern "C" UINT __stdcall ExecSecureObjects(
     LPWSTR pwzObject = NULL;
     LPWSTR pwzTable = NULL;
     LPWSTR pwzDomain = NULL;
-    DWORD dwRevision = 0;
     LPWSTR pwzUser = NULL;
     DWORD dwPermissions = 0;
     DWORD dwAttributes = 0;
     LPWSTR pwzAccount = NULL;
+    LPWSTR pwzKey = NULL;
     PSID psid = NULL;
 
-    EXPLICIT_ACCESSW ea = {0};
-    SE_OBJECT_TYPE objectType = SE_UNKNOWN_OBJECT_TYPE;
-    PSECURITY_DESCRIPTOR psd = NULL;
-    SECURITY_DESCRIPTOR_CONTROL sdc = {0};
-    SECURITY_INFORMATION si = {0};
-    PACL pAclExisting = NULL;   // doesn't get freed
-    PACL pAclNew = NULL;
-
-    PMSIHANDLE hActionRec = ::MsiCreateRecord(1);
+    STRINGDICT_HANDLE sdObjects = NULL;
+    SECURE_OBJECT* rgObjects = NULL;
+    DWORD cObjects = 0;
 
     //
     // initialize
@@ -621,10 +982,13 @@ extern "C" UINT __stdcall ExecSecureObjects(
 
     WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", pwzData);
 
+    hr = DictCreateWithEmbeddedKey(&sdObjects, 0, reinterpret_cast<void**>(&rgObjects), offsetof(SECURE_OBJECT, sczKey), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "failed to create secure objects dictionary");
+
     pwz = pwzData;
 
     //
-    // loop through all the passed in data
+    // loop through all the passed in data, collecting the permissions for each object
     //
     while (pwz && *pwz)
     {
@@ -642,82 +1006,13 @@ extern "C" UINT __stdcall ExecSecureObjects(
         hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&dwPermissions));
         ExitOnFailure(hr, "failed to process CustomActionData");
 
-        WcaLog(LOGMSG_VERBOSE, "Securing Object: %ls Type: %ls User: %ls", pwzObject, pwzTable, pwzUser);
+        WcaLog(LOGMSG_VERBOSE, "Permission for Object: %ls Type: %ls User: %ls", pwzObject, pwzTable, pwzUser);
 
         //
         // create the appropriate SID
         //
-
-        // figure out the right user to put into the access block
-        if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Everyone"))
-        {
-            hr = AclGetWellKnownSid(WinWorldSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Administrators"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinAdministratorsSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalSystem"))
-        {
-            hr = AclGetWellKnownSid(WinLocalSystemSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalService"))
-        {
-            hr = AclGetWellKnownSid(WinLocalServiceSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"NetworkService"))
-        {
-            hr = AclGetWellKnownSid(WinNetworkServiceSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"AuthenticatedUser"))
-        {
-            hr = AclGetWellKnownSid(WinAuthenticatedUserSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Guests"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinGuestsSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"CREATOR OWNER"))
-        {
-            hr = AclGetWellKnownSid(WinCreatorOwnerSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"INTERACTIVE"))
-        {
-            hr = AclGetWellKnownSid(WinInteractiveSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Users"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinUsersSid, &psid);
-        }
-        else
-        {
-            hr = StrAllocFormatted(&pwzAccount, L"%s%s%s", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
-            ExitOnFailure(hr, "failed to build domain user name");
-
-            hr = AclGetAccountSid(NULL, pwzAccount, &psid);
-        }
-        ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
-
-        //
-        // build up the explicit access
-        //
-        ea.grfAccessMode = SET_ACCESS;
-
-        if (dwAttributes & SECURE_OBJECT_ATTRIBUTE_INHERITABLE)
-        {
-            ea.grfInheritance = SUB_CONTAINERS_AND_OBJECTS_INHERIT;
-        }
-        else
-        {
-            ea.grfInheritance = NO_INHERITANCE;
-        }
-
-#pragma prefast(push)
-#pragma prefast(disable:25029)
-        ::BuildTrusteeWithSidW(&ea.Trustee, psid);
-#pragma prefast(pop)
-
-        objectType = SEObjectTypeFromString(const_cast<LPCWSTR> (pwzTable));
+        hr = GetSecureObjectSid(pwzDomain, pwzUser, &pwzAccount, &psid);
+        ExitOnFailure(hr, "failed to get sid for object: %ls", pwzObject);
 
         // always add these permissions for services
         // these are basic permissions that are often forgotten
@@ -726,45 +1021,18 @@ extern "C" UINT __stdcall ExecSecureObjects(
             dwPermissions |= SERVICE_QUERY_CONFIG | SERVICE_QUERY_STATUS | SERVICE_ENUMERATE_DEPENDENTS | SERVICE_INTERROGATE;
         }
 
-        ea.grfAccessPermissions = dwPermissions;
-
-        if (SE_UNKNOWN_OBJECT_TYPE != objectType)
-        {
-            er = ::GetNamedSecurityInfoW(pwzObject, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, &pAclExisting, NULL, &psd);
-            ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get security info for object: %ls", pwzObject);
-
-            //Need to see if DACL is protected so getting Descriptor information
-            if (!::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
-            {
-                ExitOnLastError(hr, "failed to get security descriptor control for object: %ls", pwzObject);
-            }
-
-#pragma prefast(push)
-#pragma prefast(disable:25029)
-            er = ::SetEntriesInAclW(1, &ea, pAclExisting, &pAclNew);
-#pragma prefast(pop)
-            ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to add ACLs for object: %ls", pwzObject);
-
-            if (sdc & SE_DACL_PROTECTED)
-            {
-                si = DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION;
-            }
-            else
-            {
-                si = DACL_SECURITY_INFORMATION;
-            }
-            er = ::SetNamedSecurityInfoW(pwzObject, objectType, si, NULL, NULL, pAclNew, NULL);
-            MessageExitOnFailure(hr = HRESULT_FROM_WIN32(er), msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", pwzObject);
-        }
-        else
-        {
-            MessageExitOnFailure(hr = E_UNEXPECTED, msierrSecureObjectsUnknownType, "unknown object type: %ls", pwzTable);
-        }
-
-        hr = WcaProgressMessage(COST_SECUREOBJECT, FALSE);
-        ExitOnFailure(hr, "failed to send progress message");
+        hr = AddSecureObjectEntry(sdObjects, &rgObjects, &cObjects, &pwzKey, pwzObject, pwzTable, dwAttributes, dwPermissions, psid);
+        psid = NULL;
+        ExitOnFailure(hr, "failed to add permission for object: %ls", pwzObject);
+    }
 
-        objectType = SE_UNKNOWN_OBJECT_TYPE;
+    //
+    // apply each object's permissions at once
+    //
+    for (DWORD i = 0; i < cObjects; ++i)
+    {
+        hr = ApplySecureObject(rgObjects + i);
+        ExitOnFailure(hr, "failed to secure object: %ls", rgObjects[i].sczObject);
     }
 
 LExit:
@@ -774,15 +1042,11 @@ LExit:
     ReleaseStr(pwzObject);
     ReleaseStr(pwzData);
     ReleaseStr(pwzAccount);
+    ReleaseStr(pwzKey);
+
+    ReleaseDict(sdObjects);
+    FreeSecureObjects(rgObjects, cObjects);
 
-    if (pAclNew)
-    {
-        ::LocalFree(pAclNew);
-    }
-    if (psd)
-    {
-        ::LocalFree(psd);
-    }
     if (psid)
     {
         AclFreeSid(psid);
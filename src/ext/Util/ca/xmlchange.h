@@ -0,0 +1,69 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+static BOOL IsSameXmlFile(
+    __in_z LPCWSTR wzFile1,
+    __in_z LPCWSTR wzFile2
+    )
+{
+    return CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, wzFile1, -1, wzFile2, -1);
+}
+
+
+/********************************************************************
+ GroupXmlChangesByFile - moves the changes for each formatted file
+   next to each other so every file is loaded and saved once.
+
+ NOTE: the tables are read ordered by the unformatted File column and
+       then Sequence, so a group built from several File values keeps
+       the changes of the first File value in sequence order, followed
+       by the changes of the next File value in sequence order, and so
+       on. Sequence order is not kept across File values.
+       ppxfcTail is optional and is kept pointing at the last change.
+********************************************************************/
+template<class T> static void GroupXmlChangesByFile(
+    __inout T** ppxfcHead,
+    __inout_opt T** ppxfcTail
+    )
+{
+    T* pxfcGroupTail = NULL;
+    T* pxfcCheck = NULL;
+    T* pxfcNextCheck = NULL;
+
+    for (T* pxfc = *ppxfcHead; pxfc; pxfc = pxfcGroupTail->pxfcNext)
+    {
+        pxfcGroupTail = pxfc;
+        while (pxfcGroupTail->pxfcNext && IsSameXmlFile(pxfc->wzFile, pxfcGroupTail->pxfcNext->wzFile))
+        {
+            pxfcGroupTail = pxfcGroupTail->pxfcNext;
+        }
+
+        for (pxfcCheck = pxfcGroupTail->pxfcNext; pxfcCheck; pxfcCheck = pxfcNextCheck)
+        {
+            pxfcNextCheck = pxfcCheck->pxfcNext;
+
+            if (IsSameXmlFile(pxfc->wzFile, pxfcCheck->wzFile))
+            {
+                // Take it out of its current spot...
+                pxfcCheck->pxfcPrev->pxfcNext = pxfcCheck->pxfcNext;
+                if (pxfcCheck->pxfcNext)
+                {
+                    pxfcCheck->pxfcNext->pxfcPrev = pxfcCheck->pxfcPrev;
+                }
+                else if (ppxfcTail)
+                {
+                    *ppxfcTail = pxfcCheck->pxfcPrev;
+                }
+
+                // ...and put it after the last change for the same file
+                pxfcCheck->pxfcPrev = pxfcGroupTail;
+                pxfcCheck->pxfcNext = pxfcGroupTail->pxfcNext;
+                pxfcGroupTail->pxfcNext->pxfcPrev = pxfcCheck;
+                pxfcGroupTail->pxfcNext = pxfcCheck;
+
+                pxfcGroupTail = pxfcCheck;
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+struct TEST_XML_CHANGE
+{
+    WCHAR wzFile[MAX_PATH];
+    int iSequence;
+
+    TEST_XML_CHANGE* pxfcPrev;
+    TEST_XML_CHANGE* pxfcNext;
+};
+
+namespace UtilCaTests
+{
+    public ref class XmlChange
+    {
+    public:
+        [Fact]
+        void GroupXmlChangesByFileMovesChangesNextToTheirFileTest()
+        {
+            // The first and third entries had different unformatted File values that resolved to the same file.
+            TEST_XML_CHANGE rgChanges[] =
+            {
+                { L"C:\\App\\app.config", 1 },
+                { L"C:\\App\\web.config", 2 },
+                { L"c:\\app\\APP.CONFIG", 3 },
+                { L"C:\\App\\web.config", 4 },
+                { L"C:\\App\\app.config", 5 },
+            };
+            TEST_XML_CHANGE* pxfcHead = NULL;
+            TEST_XML_CHANGE* pxfcTail = NULL;
+
+            LinkChanges(rgChanges, countof(rgChanges), &pxfcHead, &pxfcTail);
+
+            GroupXmlChangesByFile(&pxfcHead, &pxfcTail);
+
+            VerifyOrder(pxfcHead, pxfcTail, gcnew array<int>{ 1, 3, 5, 2, 4 });
+        }
+
+        [Fact]
+        void GroupXmlChangesByFileUpdatesTailTest()
+        {
+            TEST_XML_CHANGE rgChanges[] =
+            {
+                { L"C:\\App\\app.config", 1 },
+                { L"C:\\App\\web.config", 2 },
+                { L"C:\\App\\app.config", 3 },
+            };
+            TEST_XML_CHANGE* pxfcHead = NULL;
+            TEST_XML_CHANGE* pxfcTail = NULL;
+
+            LinkChanges(rgChanges, countof(rgChanges), &pxfcHead, &pxfcTail);
+
+            GroupXmlChangesByFile(&pxfcHead, &pxfcTail);
+
+            VerifyOrder(pxfcHead, pxfcTail, gcnew array<int>{ 1, 3, 2 });
+        }
+
+        [Fact]
+        void GroupXmlChangesByFileLeavesGroupedListsAloneTest()
+        {
+            TEST_XML_CHANGE rgChanges[] =
+            {
+                { L"C:\\App\\app.config", 1 },
+                { L"C:\\App\\app.config", 2 },
+                { L"C:\\App\\web.config", 3 },
+            };
+            TEST_XML_CHANGE* pxfcHead = NULL;
+            TEST_XML_CHANGE* pxfcTail = NULL;
+
+            LinkChanges(rgChanges, countof(rgChanges), &pxfcHead, &pxfcTail);
+
+            GroupXmlChangesByFile<TEST_XML_CHANGE>(&pxfcHead, NULL);
+
+            VerifyOrder(pxfcHead, pxfcTail, gcnew array<int>{ 1, 2, 3 });
+
+            pxfcHead = NULL;
+            GroupXmlChangesByFile<TEST_XML_CHANGE>(&pxfcHead, NULL);
+            Assert::True(NULL == pxfcHead);
+        }
+
+    private:
+        void LinkChanges(TEST_XML_CHANGE* rgChanges, DWORD cChanges, TEST_XML_CHANGE** ppxfcHead, TEST_XML_CHANGE** ppxfcTail)
+        {
+            for (DWORD i = 0; i < cChanges; ++i)
+            {
+                rgChanges[i].pxfcPrev = i ? &rgChanges[i - 1] : NULL;
+                rgChanges[i].pxfcNext = i + 1 < cChanges ? &rgChanges[i + 1] : NULL;
+            }
+
+            *ppxfcHead = &rgChanges[0];
+            *ppxfcTail = &rgChanges[cChanges - 1];
+        }
+
+        void VerifyOrder(TEST_XML_CHANGE* pxfcHead, TEST_XML_CHANGE* pxfcTail, array<int>^ expectedSequences)
+        {
+            TEST_XML_CHANGE* pxfc = pxfcHead;
+
+            Assert::True(NULL == pxfcHead->pxfcPrev);
+
+            for (int i = 0; i < expectedSequences->Length; ++i)
+            {
+                Assert::True(NULL != pxfc);
+                Assert::Equal(expectedSequences[i], pxfc->iSequence);
+
+                if (pxfc->pxfcNext)
+                {
+                    Assert::True(pxfc == pxfc->pxfcNext->pxfcPrev);
+                }
+                else
+                {
+                    Assert::True(pxfc == pxfcTail);
+                }
+
+                pxfc = pxfc->pxfcNext;
+            }
+
+            Assert::True(NULL == pxfc);
+        }
+    };
+}
@@ -129,6 +129,21 @@ namespace WixToolsetTest.Util
             }, results.OrderBy(s => s).ToArray());
         }
 
+        [Fact]
+        public void CanBuildWithPermissionExParallelPropagation()
+        {
+            var folder = TestData.Get(@"TestData\PermissionExParallelPropagation");
+            var build = new Builder(folder, typeof(UtilExtensionFactory), new[] { folder });
+
+            var results = build.BuildAndQuery(BuildX64, "Wix4SecureObject");
+            WixAssert.CompareLineByLine(new[]
+            {
+                "Wix4SecureObject:filF5_pLhBuF5b4N9XEo52g_hUM5Lo\tFile\t\tEveryone\t1\t268435456\tfilF5_pLhBuF5b4N9XEo52g_hUM5Lo",
+                "Wix4SecureObject:INSTALLFOLDER\tCreateFolder\t\tEveryone\t3\t268435456\tfilF5_pLhBuF5b4N9XEo52g_hUM5Lo",
+                "Wix4SecureObject:INSTALLFOLDER\tCreateFolder\t\tUsers\t2\t268435456\tfilF5_pLhBuF5b4N9XEo52g_hUM5Lo",
+            }, results.OrderBy(s => s).ToArray());
+        }
+
         [Fact]
         public void CanBuildRemoveRegistryKeyExInMergeModule()
         {
@@ -155,7 +170,25 @@ namespace WixToolsetTest.Util
             {
                 "Binary:Wix4UtilCA_X64.047730A5_30FE_4A62_A520_DA9381B8226A\t[Binary data]",
                 "CustomAction:Wix4RemoveFoldersEx_X64.047730A5_30FE_4A62_A520_DA9381B8226A\t65\tWix4UtilCA_X64.047730A5_30FE_4A62_A520_DA9381B8226A\tWixRemoveFoldersEx\t",
-                "Wix4RemoveFolderEx:wrf5qCm1SE.zp8djrlk78l1IYFXsEw.047730A5_30FE_4A62_A520_DA9381B8226A\tfilh4juyUVjoUcWWtcQmd5L07FoON4.047730A5_30FE_4A62_A520_DA9381B8226A\tRemoveProp.047730A5_30FE_4A62_A520_DA9381B8226A\t3\t",
+                "Wix4RemoveFolderEx:wrf5qCm1SE.zp8djrlk78l1IYFXsEw.047730A5_30FE_4A62_A520_DA9381B8226A\tfilh4juyUVjoUcWWtcQmd5L07FoON4.047730A5_30FE_4A62_A520_DA9381B8226A\tRemoveProp.047730A5_30FE_4A62_A520_DA9381B8226A\t3\t\t",
+            }, results.OrderBy(s => s).ToArray());
+        }
+
+        [Fact]
+        public void CanBuildDeferredRemoveFolderEx()
+        {
+            var folder = TestData.Get(@"TestData\RemoveFolderExDeferred");
+            var build = new Builder(folder, typeof(UtilExtensionFactory), new[] { folder });
+
+            var results = build.BuildAndQuery(BuildX64, "Binary", "CustomAction", "Wix4RemoveFolderEx");
+            WixAssert.CompareLineByLine(new[]
+            {
+                "Binary:Wix4UtilCA_X64\t[Binary data]",
+                "CustomAction:Wix4CommitRemoveFoldersEx_X64\t3649\tWix4UtilCA_X64\tWixExecRemoveFoldersEx\t",
+                "CustomAction:Wix4ExecRemoveFoldersEx_X64\t3073\tWix4UtilCA_X64\tWixExecRemoveFoldersEx\t",
+                "CustomAction:Wix4RollbackRemoveFoldersEx_X64\t3329\tWix4UtilCA_X64\tWixExecRemoveFoldersEx\t",
+                "CustomAction:Wix4SchedRemoveFoldersEx_X64\t1\tWix4UtilCA_X64\tWixSchedRemoveFoldersEx\t",
+                "Wix4RemoveFolderEx:wrfYMimBjq.A4WpIy10XlPym7Yx2u4\tfilF5_pLhBuF5b4N9XEo52g_hUM5Lo\tRemoveProp\t2\t\t1",
             }, results.OrderBy(s => s).ToArray());
         }
 
@@ -184,6 +217,22 @@ namespace WixToolsetTest.Util
             }, results.OrderBy(s => s).ToArray());
         }
 
+        [Fact]
+        public void CanBuildWithQuietExecMultiple()
+        {
+            var folder = TestData.Get(@"TestData\QuietExecMultiple");
+            var build = new Builder(folder, typeof(UtilExtensionFactory), new[] { folder });
+
+            var results = build.BuildAndQuery(BuildX64, "Binary", "CustomAction", "Property");
+            WixAssert.CompareLineByLine(new[]
+            {
+                "Binary:Wix4UtilCA_X64\t[Binary data]",
+                "CustomAction:Wix4QuietExecMultiple_X64\t1\tWix4UtilCA_X64\tWixQuietExecMultiple\t",
+                "Property:WixQuietExecMultipleCmdLine\t\n\"[SystemFolder]cmd.exe\" /c echo one\n\"[SystemFolder]cmd.exe\" /c echo two\n\n\"[SystemFolder]cmd.exe\" /c echo three",
+                "Property:WixQuietExecMultipleMaxParallel\t2",
+            }, results.Where(s => !s.StartsWith("Property:") || s.StartsWith("Property:WixQuietExec")).OrderBy(s => s).ToArray());
+        }
+
         [Fact]
         public void CanBuildWithQueries()
         {
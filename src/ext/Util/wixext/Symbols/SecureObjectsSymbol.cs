@@ -43,7 +43,8 @@ namespace WixToolset.Util.Symbols
     public enum WixPermissionExAttributes
     {
         None = 0x0,
-        Inheritable = 0x01
+        Inheritable = 0x01,
+        ParallelPropagation = 0x02,
     }
 
     public class SecureObjectsSymbol : IntermediateSymbol
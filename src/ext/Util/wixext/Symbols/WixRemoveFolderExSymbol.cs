@@ -15,6 +15,7 @@ namespace WixToolset.Util
                 new IntermediateFieldDefinition(nameof(WixRemoveFolderExSymbolFields.Property), IntermediateFieldType.String),
                 new IntermediateFieldDefinition(nameof(WixRemoveFolderExSymbolFields.InstallMode), IntermediateFieldType.Number),
                 new IntermediateFieldDefinition(nameof(WixRemoveFolderExSymbolFields.Condition), IntermediateFieldType.String),
+                new IntermediateFieldDefinition(nameof(WixRemoveFolderExSymbolFields.Attributes), IntermediateFieldType.Number),
             },
             typeof(WixRemoveFolderExSymbol));
     }
@@ -22,6 +23,7 @@ namespace WixToolset.Util
 
 namespace WixToolset.Util.Symbols
 {
+    using System;
     using WixToolset.Data;
 
     public enum WixRemoveFolderExSymbolFields
@@ -30,6 +32,7 @@ namespace WixToolset.Util.Symbols
         Property,
         InstallMode,
         Condition,
+        Attributes,
     }
 
     public enum WixRemoveFolderExInstallMode
@@ -39,6 +42,13 @@ namespace WixToolset.Util.Symbols
         Both = 3,
     }
 
+    [Flags]
+    public enum WixRemoveFolderExAttributes
+    {
+        None = 0x0,
+        Deferred = 0x1,
+    }
+
     public class WixRemoveFolderExSymbol : IntermediateSymbol
     {
         public WixRemoveFolderExSymbol() : base(UtilSymbolDefinitions.WixRemoveFolderEx, null, null)
@@ -74,5 +84,11 @@ namespace WixToolset.Util.Symbols
             get => this.Fields[(int)WixRemoveFolderExSymbolFields.Condition].AsString();
             set => this.Set((int)WixRemoveFolderExSymbolFields.Condition, value);
         }
+
+        public WixRemoveFolderExAttributes Attributes
+        {
+            get => (WixRemoveFolderExAttributes)this.Fields[(int)WixRemoveFolderExSymbolFields.Attributes].AsNumber();
+            set => this.Set((int)WixRemoveFolderExSymbolFields.Attributes, (int)value);
+        }
     }
 }
\ No newline at end of file
@@ -2489,6 +2489,16 @@ namespace WixToolset.Util
                                 attributes &= ~WixPermissionExAttributes.Inheritable;
                             }
                             break;
+                        case "ParallelPropagation":
+                            if ("CreateFolder" != tableName)
+                            {
+                                this.ParseHelper.UnexpectedAttribute(element, attrib);
+                            }
+                            else if (this.ParseHelper.GetAttributeYesNoValue(sourceLineNumbers, attrib) == YesNoType.Yes)
+                            {
+                                attributes |= WixPermissionExAttributes.ParallelPropagation;
+                            }
+                            break;
                         case "User":
                             user = this.ParseHelper.GetAttributeValue(sourceLineNumbers, attrib);
                             break;
@@ -2805,6 +2815,7 @@ namespace WixToolset.Util
             var mode = WixRemoveFolderExInstallMode.Uninstall;
             string property = null;
             string condition = null;
+            var attributes = WixRemoveFolderExAttributes.None;
 
             foreach (var attrib in element.Attributes())
             {
@@ -2815,6 +2826,12 @@ namespace WixToolset.Util
                         case "Condition":
                             condition = this.ParseHelper.GetAttributeValue(sourceLineNumbers, attrib);
                             break;
+                        case "Deferred":
+                            if (this.ParseHelper.GetAttributeYesNoValue(sourceLineNumbers, attrib) == YesNoType.Yes)
+                            {
+                                attributes |= WixRemoveFolderExAttributes.Deferred;
+                            }
+                            break;
                         case "Id":
                             id = this.ParseHelper.GetAttributeIdentifier(sourceLineNumbers, attrib);
                             break;
@@ -2870,17 +2887,28 @@ namespace WixToolset.Util
 
             if (!this.Messaging.EncounteredError)
             {
-                this.ParseHelper.CreateCustomActionReference(sourceLineNumbers, section, "Wix4RemoveFoldersEx", this.Context.Platform, CustomActionPlatforms.X86 | CustomActionPlatforms.X64 | CustomActionPlatforms.ARM64);
+                // Deferred folders are deleted by the install script rather than through RemoveFile rows.
+                var deferred = WixRemoveFolderExAttributes.Deferred == (attributes & WixRemoveFolderExAttributes.Deferred);
 
-                section.AddSymbol(new WixRemoveFolderExSymbol(sourceLineNumbers, id)
+                this.ParseHelper.CreateCustomActionReference(sourceLineNumbers, section, deferred ? "Wix4SchedRemoveFoldersEx" : "Wix4RemoveFoldersEx", this.Context.Platform, CustomActionPlatforms.X86 | CustomActionPlatforms.X64 | CustomActionPlatforms.ARM64);
+
+                var symbol = section.AddSymbol(new WixRemoveFolderExSymbol(sourceLineNumbers, id)
                 {
                     ComponentRef = componentId,
                     Property = property,
                     InstallMode = mode,
-                    Condition = condition
+                    Condition = condition,
                 });
 
-                this.ParseHelper.EnsureTable(section, sourceLineNumbers, "RemoveFile");
+                if (attributes != WixRemoveFolderExAttributes.None)
+                {
+                    symbol.Attributes = attributes;
+                }
+
+                if (!deferred)
+                {
+                    this.ParseHelper.EnsureTable(section, sourceLineNumbers, "RemoveFile");
+                }
             }
         }
 
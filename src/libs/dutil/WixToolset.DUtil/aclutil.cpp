@@ -16,6 +16,22 @@
 #define AclExitOnWin32Error(e, x, s, ...) ExitOnWin32ErrorSource(DUTIL_SOURCE_ACLUTIL, e, x, s, __VA_ARGS__)
 #define AclExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_ACLUTIL, g, x, s, __VA_ARGS__)
 
+// Shared by the workers that carry a folder's inheritable ACEs into the subtrees under it.
+struct ACL_PROPAGATION
+{
+    LPWSTR* rgsczChildren;
+    UINT cChildren;
+    LONG iNextChild;
+    LONG cCompleted;
+    LONG fStop;
+    LONG erFailure;
+    LONG iFailedChild;
+};
+
+static DWORD WINAPI PropagateInheritanceThreadProc(
+    __in LPVOID lpThreadParameter
+    );
+
 /********************************************************************
 AclCheckAccess - determines if token has appropriate privileges
 
@@ -941,6 +957,142 @@ LExit:
 }
 
 
+/********************************************************************
+AclPropagateInheritance - re-applies the inheritable ACEs of a folder to
+                          each of its immediate children's subtrees, using
+                          a pool of threads so separate subtrees are
+                          propagated at the same time
+
+NOTE: the folder's own DACL must already be set. Protected children are
+      skipped and children deleted during the walk are ignored.
+      cMaxThreads of zero uses one thread per processor.
+********************************************************************/
+extern "C" HRESULT DAPI AclPropagateInheritance(
+    __in_z LPCWSTR wzFolder,
+    __in DWORD cMaxThreads,
+    __in DWORD dwProgressInterval,
+    __in_opt PFN_ACLPROPAGATIONPROGRESS pfnProgress,
+    __in_opt LPVOID pvContext,
+    __deref_opt_out_z_opt LPWSTR* psczFailedPath
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    ACL_PROPAGATION propagation = { };
+    HANDLE rghThreads[MAXIMUM_WAIT_OBJECTS] = { };
+    DWORD cThreads = 0;
+    SYSTEM_INFO systemInfo = { };
+    LPWSTR sczPattern = NULL;
+    LPWSTR sczChild = NULL;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+
+    hr = PathConcat(wzFolder, L"*", &sczPattern);
+    AclExitOnFailure(hr, "Failed to build search pattern for folder: %ls", wzFolder);
+
+    hFind = ::FindFirstFileExW(sczPattern, FindExInfoBasic, &wfd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        er = ::GetLastError();
+        if (ERROR_FILE_NOT_FOUND != er)
+        {
+            AclExitOnWin32Error(er, hr, "Failed to enumerate folder: %ls", wzFolder);
+        }
+    }
+    else
+    {
+        do
+        {
+            if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+            {
+                continue;
+            }
+
+            hr = PathConcat(wzFolder, wfd.cFileName, &sczChild);
+            AclExitOnFailure(hr, "Failed to build path to child of folder: %ls", wzFolder);
+
+            hr = StrArrayAllocString(&propagation.rgsczChildren, &propagation.cChildren, sczChild, 0);
+            AclExitOnFailure(hr, "Failed to add child of folder: %ls", wzFolder);
+        } while (::FindNextFileW(hFind, &wfd));
+
+        er = ::GetLastError();
+        if (ERROR_NO_MORE_FILES != er)
+        {
+            AclExitOnWin32Error(er, hr, "Failed to enumerate folder: %ls", wzFolder);
+        }
+    }
+
+    // Never use more threads than there are processors or subtrees to propagate.
+    ::GetNativeSystemInfo(&systemInfo);
+    cMaxThreads = cMaxThreads ? min(cMaxThreads, systemInfo.dwNumberOfProcessors) : systemInfo.dwNumberOfProcessors;
+    cMaxThreads = min(min(cMaxThreads, propagation.cChildren), countof(rghThreads));
+
+    for (DWORD i = 0; i < cMaxThreads; ++i)
+    {
+        HANDLE hThread = ::CreateThread(NULL, 0, PropagateInheritanceThreadProc, &propagation, 0, NULL);
+        AclExitOnNullWithLastError(hThread, hr, "Failed to create thread to propagate security for folder: %ls", wzFolder);
+
+        rghThreads[cThreads] = hThread;
+        ++cThreads;
+    }
+
+    while (cThreads)
+    {
+        er = ::WaitForMultipleObjects(cThreads, rghThreads, TRUE, pfnProgress ? dwProgressInterval : INFINITE);
+        if (WAIT_FAILED == er)
+        {
+            AclExitWithLastError(hr, "Failed to wait for security propagation for folder: %ls", wzFolder);
+        }
+
+        if (pfnProgress)
+        {
+            hr = pfnProgress(static_cast<DWORD>(::InterlockedCompareExchange(&propagation.cCompleted, 0, 0)), propagation.cChildren, pvContext);
+            AclExitOnFailure(hr, "Failed to report security propagation progress for folder: %ls", wzFolder);
+        }
+
+        if (WAIT_TIMEOUT != er)
+        {
+            break;
+        }
+    }
+
+    if (ERROR_SUCCESS != propagation.erFailure)
+    {
+        if (psczFailedPath)
+        {
+            hr = StrAllocString(psczFailedPath, propagation.rgsczChildren[propagation.iFailedChild], 0);
+            AclExitOnFailure(hr, "Failed to copy path that could not be secured.");
+        }
+
+        hr = HRESULT_FROM_WIN32(static_cast<DWORD>(propagation.erFailure));
+        AclExitOnRootFailure(hr, "Failed to set security on object: %ls", propagation.rgsczChildren[propagation.iFailedChild]);
+    }
+
+LExit:
+    if (cThreads)
+    {
+        ::InterlockedExchange(&propagation.fStop, TRUE);
+        ::WaitForMultipleObjects(cThreads, rghThreads, TRUE, INFINITE);
+
+        for (DWORD i = 0; i < cThreads; ++i)
+        {
+            ReleaseHandle(rghThreads[i]);
+        }
+    }
+
+    if (INVALID_HANDLE_VALUE != hFind)
+    {
+        ::FindClose(hFind);
+    }
+
+    ReleaseStrArray(propagation.rgsczChildren, propagation.cChildren);
+    ReleaseStr(sczChild);
+    ReleaseStr(sczPattern);
+
+    return hr;
+}
+
+
 /********************************************************************
 AclFreeSid - frees a SID created by any Acl* functions
 
@@ -1042,3 +1194,57 @@ LExit:
 
     return hr;
 }
+
+
+static DWORD WINAPI PropagateInheritanceThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    ACL_PROPAGATION* pPropagation = reinterpret_cast<ACL_PROPAGATION*>(lpThreadParameter);
+    LONG iChild = 0;
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwRevision = 0;
+    PSECURITY_DESCRIPTOR psd = NULL;
+    SECURITY_DESCRIPTOR_CONTROL sdc = 0;
+    PACL pAcl = NULL;   // doesn't get freed
+
+    while (!pPropagation->fStop && static_cast<UINT>(iChild = ::InterlockedIncrement(&pPropagation->iNextChild) - 1) < pPropagation->cChildren)
+    {
+        LPCWSTR wzChild = pPropagation->rgsczChildren[iChild];
+
+        er = ::GetNamedSecurityInfoW(wzChild, SE_FILE_OBJECT, DACL_SECURITY_INFORMATION, NULL, NULL, &pAcl, NULL, &psd);
+        if (ERROR_SUCCESS == er && !::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
+        {
+            er = ::GetLastError();
+        }
+
+        // A protected child inherits nothing so neither it nor anything below it changes.
+        // Otherwise setting its own DACL again recomputes the inherited ACEs from the parent
+        // and the system carries them down the child's subtree.
+        if (ERROR_SUCCESS == er && !(sdc & SE_DACL_PROTECTED))
+        {
+            er = ::SetNamedSecurityInfoW(const_cast<LPWSTR>(wzChild), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION | UNPROTECTED_DACL_SECURITY_INFORMATION, NULL, NULL, pAcl, NULL);
+        }
+
+        if (psd)
+        {
+            ::LocalFree(psd);
+            psd = NULL;
+        }
+
+        // Something deleted while we were walking has nothing left to secure.
+        if (ERROR_SUCCESS != er && ERROR_FILE_NOT_FOUND != er && ERROR_PATH_NOT_FOUND != er)
+        {
+            if (ERROR_SUCCESS == ::InterlockedCompareExchange(&pPropagation->erFailure, static_cast<LONG>(er), ERROR_SUCCESS))
+            {
+                pPropagation->iFailedChild = iChild;
+            }
+
+            ::InterlockedExchange(&pPropagation->fStop, TRUE);
+        }
+
+        ::InterlockedIncrement(&pPropagation->cCompleted);
+    }
+
+    return ERROR_SUCCESS;
+}
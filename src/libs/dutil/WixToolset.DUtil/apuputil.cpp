@@ -16,6 +16,21 @@
 #define ApupExitOnWin32Error(e, x, s, ...) ExitOnWin32ErrorSource(DUTIL_SOURCE_APUPUTIL, e, x, s, __VA_ARGS__)
 #define ApupExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_APUPUTIL, g, x, s, __VA_ARGS__)
 
+// XmlLite and the shell stream are loaded on demand so consumers of dutil do not need to link xmllite.lib and shlwapi.lib.
+typedef HRESULT(WINAPI *PFN_CREATEXMLREADER)(
+    __in REFIID riid,
+    __out void** ppvObject,
+    __in_opt IMalloc* pMalloc
+    );
+typedef HRESULT(WINAPI *PFN_SHCREATESTREAMONFILEEX)(
+    __in LPCWSTR pszFile,
+    __in DWORD grfMode,
+    __in DWORD dwAttributes,
+    __in BOOL fCreate,
+    __in_opt IStream* pstmTemplate,
+    __out IStream** ppstm
+    );
+
 // prototypes
 static HRESULT ProcessEntry(
     __in ATOM_ENTRY* pAtomEntry,
@@ -26,6 +41,45 @@ static HRESULT ParseEnclosure(
     __in ATOM_LINK* pLink,
     __in APPLICATION_UPDATE_ENCLOSURE* pEnclosure
     );
+static HRESULT ParseDigest(
+    __in_z_opt LPCWSTR wzAlgorithm,
+    __in_z LPCWSTR wzValue,
+    __in APPLICATION_UPDATE_ENCLOSURE* pEnclosure
+    );
+static HRESULT CreateFeedReader(
+    __in_z LPCWSTR wzFeedFile,
+    __out HMODULE* phXmlLite,
+    __out HMODULE* phShlwapi,
+    __out IStream** ppStream,
+    __out IXmlReader** ppReader
+    );
+static HRESULT ReadFeedEntry(
+    __in IXmlReader* pReader,
+    __in_opt VERUTIL_VERSION* pMinimumVersion,
+    __inout APPLICATION_UPDATE_ENTRY* pApupEntry
+    );
+static HRESULT ReadFeedLink(
+    __in IXmlReader* pReader,
+    __inout APPLICATION_UPDATE_ENTRY* pApupEntry
+    );
+static HRESULT ReadNextChildElement(
+    __in IXmlReader* pReader,
+    __in UINT nParentDepth,
+    __out BOOL* pfAppSyn,
+    __out_z LPCWSTR* pwzLocalName
+    );
+static HRESULT ReadAttributeValue(
+    __in IXmlReader* pReader,
+    __in_z LPCWSTR wzName,
+    __deref_out_z_opt LPWSTR* psczValue
+    );
+static HRESULT ReadElementText(
+    __in IXmlReader* pReader,
+    __deref_out_z LPWSTR* psczValue
+    );
+static HRESULT SkipElement(
+    __in IXmlReader* pReader
+    );
 static __callback int __cdecl CompareEntries(
     void* pvContext,
     const void* pvLeft,
@@ -135,6 +189,143 @@ LExit:
 }
 
 
+//
+// ApupAllocChainFromFile - streams an ATOM feed from disk, materializing only the application updates newer than the minimum version.
+//
+extern "C" HRESULT DAPI ApupAllocChainFromFile(
+    __in_z LPCWSTR wzFeedFile,
+    __in_opt VERUTIL_VERSION* pMinimumVersion,
+    __out APPLICATION_UPDATE_CHAIN** ppChain
+    )
+{
+    HRESULT hr = S_OK;
+    HMODULE hXmlLite = NULL;
+    HMODULE hShlwapi = NULL;
+    IStream* pStream = NULL;
+    IXmlReader* pReader = NULL;
+    APPLICATION_UPDATE_CHAIN* pChain = NULL;
+    APPLICATION_UPDATE_ENTRY entry = { };
+    XmlNodeType nodeType = XmlNodeType_None;
+    UINT nFeedDepth = 0;
+    BOOL fAppSyn = FALSE;
+    LPCWSTR wzLocalName = NULL;
+    DWORD cKeptEntries = 0;
+
+    pChain = static_cast<APPLICATION_UPDATE_CHAIN*>(MemAlloc(sizeof(APPLICATION_UPDATE_CHAIN), TRUE));
+    ApupExitOnNull(pChain, hr, E_OUTOFMEMORY, "Failed to allocate update chain.");
+
+    hr = CreateFeedReader(wzFeedFile, &hXmlLite, &hShlwapi, &pStream, &pReader);
+    ApupExitOnFailure(hr, "Failed to create reader for ATOM feed: %ls", wzFeedFile);
+
+    // Find the feed element.
+    do
+    {
+        hr = pReader->Read(&nodeType);
+        ApupExitOnFailure(hr, "Failed to read ATOM feed: %ls", wzFeedFile);
+    } while (S_OK == hr && XmlNodeType_Element != nodeType);
+
+    if (S_FALSE == hr)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "ATOM feed has no root element: %ls", wzFeedFile);
+    }
+
+    hr = pReader->GetLocalName(&wzLocalName, NULL);
+    ApupExitOnFailure(hr, "Failed to get root element name.");
+
+    if (CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"feed", -1))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Root element is not an ATOM feed: %ls", wzLocalName);
+    }
+
+    hr = pReader->GetDepth(&nFeedDepth);
+    ApupExitOnFailure(hr, "Failed to get depth of ATOM feed element.");
+
+    if (!pReader->IsEmptyElement())
+    {
+        while (S_OK == (hr = ReadNextChildElement(pReader, nFeedDepth, &fAppSyn, &wzLocalName)))
+        {
+            if (fAppSyn && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"application", -1))
+            {
+                hr = ReadAttributeValue(pReader, L"type", &pChain->wzDefaultApplicationType);
+                ApupExitOnFailure(hr, "Failed to read default application type.");
+
+                hr = ReadElementText(pReader, &pChain->wzDefaultApplicationId);
+                ApupExitOnFailure(hr, "Failed to read default application id.");
+            }
+            else if (!fAppSyn && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"entry", -1))
+            {
+                hr = ReadFeedEntry(pReader, pMinimumVersion, &entry);
+                ApupExitOnFailure(hr, "Failed to read ATOM entry.");
+
+                if (S_OK == hr)
+                {
+                    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pChain->rgEntries), pChain->cEntries, 1, sizeof(APPLICATION_UPDATE_ENTRY), 16);
+                    ApupExitOnFailure(hr, "Failed to grow update entries.");
+
+                    // The chain takes ownership of the entry.
+                    pChain->rgEntries[pChain->cEntries] = entry;
+                    ++pChain->cEntries;
+
+                    memset(&entry, 0, sizeof(entry));
+                }
+            }
+            else
+            {
+                hr = SkipElement(pReader);
+                ApupExitOnFailure(hr, "Failed to skip ATOM feed element: %ls", wzLocalName);
+            }
+        }
+        ApupExitOnFailure(hr, "Failed to read ATOM feed: %ls", wzFeedFile);
+    }
+
+    // The default application identity may follow the entries, so entries without their own identity are only dropped now.
+    if (!pChain->wzDefaultApplicationId)
+    {
+        for (DWORD i = 0; i < pChain->cEntries; ++i)
+        {
+            if (pChain->rgEntries[i].wzApplicationId)
+            {
+                pChain->rgEntries[cKeptEntries] = pChain->rgEntries[i];
+                ++cKeptEntries;
+            }
+            else
+            {
+                FreeEntry(pChain->rgEntries + i);
+            }
+        }
+
+        pChain->cEntries = cKeptEntries;
+    }
+
+    // Sort the chain by descending version and ascending total size.
+    qsort_s(pChain->rgEntries, pChain->cEntries, sizeof(APPLICATION_UPDATE_ENTRY), CompareEntries, NULL);
+
+    *ppChain = pChain;
+    pChain = NULL;
+    hr = S_OK;
+
+LExit:
+    FreeEntry(&entry);
+    ReleaseApupChain(pChain);
+    ReleaseObject(pReader);
+    ReleaseObject(pStream);
+
+    if (hShlwapi)
+    {
+        ::FreeLibrary(hShlwapi);
+    }
+
+    if (hXmlLite)
+    {
+        ::FreeLibrary(hXmlLite);
+    }
+
+    return hr;
+}
+
+
 //
 // ApupFilterChain - remove the unneeded update elements from the chain.
 //
@@ -337,9 +528,6 @@ static HRESULT ParseEnclosure(
     )
 {
     HRESULT hr = S_OK;
-    DWORD dwDigestLength = 0;
-    DWORD dwDigestStringLength = 0;
-    size_t cchDigestString = 0;
 
     // First search the ATOM link's custom elements to try and find the application update enclosure information.
     for (ATOM_UNKNOWN_ELEMENT* pElement = pLink->pUnknownElements; pElement; pElement = pElement->pNext)
@@ -349,60 +537,19 @@ static HRESULT ParseEnclosure(
             if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, L"digest", -1, pElement->wzElement, -1))
             {
                 // Find the digest[@algorithm] which is required. Everything else is ignored.
+                LPCWSTR wzAlgorithm = NULL;
+
                 for (ATOM_UNKNOWN_ATTRIBUTE* pAttribute = pElement->pAttributes; pAttribute; pAttribute = pAttribute->pNext)
                 {
-                    dwDigestLength = 0;
                     if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, L"algorithm", -1, pAttribute->wzAttribute, -1))
                     {
-                        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"md5", -1, pAttribute->wzValue, -1))
-                        {
-                            pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_MD5;
-                            dwDigestLength = MD5_HASH_LEN;
-                        }
-                        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha1", -1, pAttribute->wzValue, -1))
-                        {
-                            pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA1;
-                            dwDigestLength = SHA1_HASH_LEN;
-                        }
-                        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha256", -1, pAttribute->wzValue, -1))
-                        {
-                            pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA256;
-                            dwDigestLength = SHA256_HASH_LEN;
-                        }
-                        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha512", -1, pAttribute->wzValue, -1))
-                        {
-                            pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA512;
-                            dwDigestLength = SHA512_HASH_LEN;
-                        }
+                        wzAlgorithm = pAttribute->wzValue;
                         break;
                     }
                 }
 
-                if (dwDigestLength)
-                {
-                    dwDigestStringLength = 2 * dwDigestLength;
-
-                    hr = ::StringCchLengthW(pElement->wzValue, STRSAFE_MAX_CCH, &cchDigestString);
-                    ApupExitOnFailure(hr, "Failed to get string length of digest value.");
-
-                    if (dwDigestStringLength != cchDigestString)
-                    {
-                        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
-                        ApupExitOnRootFailure(hr, "Invalid digest length (%Iu) for digest algorithm (%u).", cchDigestString, dwDigestStringLength);
-                    }
-
-                    pEnclosure->cbDigest = sizeof(BYTE) * dwDigestLength;
-                    pEnclosure->rgbDigest = static_cast<BYTE*>(MemAlloc(pEnclosure->cbDigest, TRUE));
-                    ApupExitOnNull(pEnclosure->rgbDigest, hr, E_OUTOFMEMORY, "Failed to allocate memory for digest.");
-
-                    hr = StrHexDecode(pElement->wzValue, pEnclosure->rgbDigest, pEnclosure->cbDigest);
-                    ApupExitOnFailure(hr, "Failed to decode digest value.");
-                }
-                else
-                {
-                    hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
-                    ApupExitOnRootFailure(hr, "Unknown algorithm type for digest.");
-                }
+                hr = ParseDigest(wzAlgorithm, pElement->wzValue, pEnclosure);
+                ApupExitOnFailure(hr, "Failed to parse digest.");
 
                 break;
             }
@@ -427,6 +574,564 @@ LExit:
 }
 
 
+static HRESULT ParseDigest(
+    __in_z_opt LPCWSTR wzAlgorithm,
+    __in_z LPCWSTR wzValue,
+    __in APPLICATION_UPDATE_ENCLOSURE* pEnclosure
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwDigestLength = 0;
+    DWORD dwDigestStringLength = 0;
+    size_t cchDigestString = 0;
+
+    if (!wzAlgorithm)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Missing algorithm for digest.");
+    }
+    else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"md5", -1, wzAlgorithm, -1))
+    {
+        pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_MD5;
+        dwDigestLength = MD5_HASH_LEN;
+    }
+    else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha1", -1, wzAlgorithm, -1))
+    {
+        pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA1;
+        dwDigestLength = SHA1_HASH_LEN;
+    }
+    else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha256", -1, wzAlgorithm, -1))
+    {
+        pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA256;
+        dwDigestLength = SHA256_HASH_LEN;
+    }
+    else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"sha512", -1, wzAlgorithm, -1))
+    {
+        pEnclosure->digestAlgorithm = APUP_HASH_ALGORITHM_SHA512;
+        dwDigestLength = SHA512_HASH_LEN;
+    }
+
+    if (!dwDigestLength)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Unknown algorithm type for digest.");
+    }
+
+    dwDigestStringLength = 2 * dwDigestLength;
+
+    hr = ::StringCchLengthW(wzValue, STRSAFE_MAX_CCH, &cchDigestString);
+    ApupExitOnFailure(hr, "Failed to get string length of digest value.");
+
+    if (dwDigestStringLength != cchDigestString)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Invalid digest length (%Iu) for digest algorithm (%u).", cchDigestString, dwDigestStringLength);
+    }
+
+    pEnclosure->cbDigest = sizeof(BYTE) * dwDigestLength;
+    pEnclosure->rgbDigest = static_cast<BYTE*>(MemAlloc(pEnclosure->cbDigest, TRUE));
+    ApupExitOnNull(pEnclosure->rgbDigest, hr, E_OUTOFMEMORY, "Failed to allocate memory for digest.");
+
+    hr = StrHexDecode(wzValue, pEnclosure->rgbDigest, pEnclosure->cbDigest);
+    ApupExitOnFailure(hr, "Failed to decode digest value.");
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT CreateFeedReader(
+    __in_z LPCWSTR wzFeedFile,
+    __out HMODULE* phXmlLite,
+    __out HMODULE* phShlwapi,
+    __out IStream** ppStream,
+    __out IXmlReader** ppReader
+    )
+{
+    HRESULT hr = S_OK;
+    PFN_CREATEXMLREADER pfnCreateXmlReader = NULL;
+    PFN_SHCREATESTREAMONFILEEX pfnSHCreateStreamOnFileEx = NULL;
+    IStream* pStream = NULL;
+    IXmlReader* pReader = NULL;
+
+    hr = LoadSystemLibrary(L"xmllite.dll", phXmlLite);
+    ApupExitOnFailure(hr, "Failed to load xmllite.dll.");
+
+    pfnCreateXmlReader = reinterpret_cast<PFN_CREATEXMLREADER>(::GetProcAddress(*phXmlLite, "CreateXmlReader"));
+    ApupExitOnNullWithLastError(pfnCreateXmlReader, hr, "Failed to get address of CreateXmlReader.");
+
+    hr = LoadSystemLibrary(L"shlwapi.dll", phShlwapi);
+    ApupExitOnFailure(hr, "Failed to load shlwapi.dll.");
+
+    pfnSHCreateStreamOnFileEx = reinterpret_cast<PFN_SHCREATESTREAMONFILEEX>(::GetProcAddress(*phShlwapi, "SHCreateStreamOnFileEx"));
+    ApupExitOnNullWithLastError(pfnSHCreateStreamOnFileEx, hr, "Failed to get address of SHCreateStreamOnFileEx.");
+
+    hr = pfnSHCreateStreamOnFileEx(wzFeedFile, STGM_READ | STGM_SHARE_DENY_WRITE, FILE_ATTRIBUTE_NORMAL, FALSE, NULL, &pStream);
+    ApupExitOnFailure(hr, "Failed to open ATOM feed: %ls", wzFeedFile);
+
+    hr = pfnCreateXmlReader(__uuidof(IXmlReader), reinterpret_cast<void**>(&pReader), NULL);
+    ApupExitOnFailure(hr, "Failed to create XML reader.");
+
+    hr = pReader->SetProperty(XmlReaderProperty_DtdProcessing, DtdProcessing_Prohibit);
+    ApupExitOnFailure(hr, "Failed to prohibit DTD processing.");
+
+    hr = pReader->SetInput(pStream);
+    ApupExitOnFailure(hr, "Failed to set XML reader input.");
+
+    *ppStream = pStream;
+    pStream = NULL;
+    *ppReader = pReader;
+    pReader = NULL;
+
+LExit:
+    ReleaseObject(pReader);
+    ReleaseObject(pStream);
+
+    return hr;
+}
+
+static HRESULT ReadFeedEntry(
+    __in IXmlReader* pReader,
+    __in_opt VERUTIL_VERSION* pMinimumVersion,
+    __inout APPLICATION_UPDATE_ENTRY* pApupEntry
+    )
+{
+    HRESULT hr = S_OK;
+    UINT nEntryDepth = 0;
+    BOOL fAppSyn = FALSE;
+    LPCWSTR wzLocalName = NULL;
+    LPWSTR sczValue = NULL;
+    BOOL fSkip = FALSE;
+    int nCompareResult = 0;
+
+    if (pReader->IsEmptyElement())
+    {
+        ExitFunction1(hr = S_FALSE); // an empty entry cannot have a version.
+    }
+
+    hr = pReader->GetDepth(&nEntryDepth);
+    ApupExitOnFailure(hr, "Failed to get depth of ATOM entry element.");
+
+    while (S_OK == (hr = ReadNextChildElement(pReader, nEntryDepth, &fAppSyn, &wzLocalName)))
+    {
+        // Once the entry is known to be too old, consume the rest of it without materializing anything.
+        if (fSkip)
+        {
+            hr = SkipElement(pReader);
+            ApupExitOnFailure(hr, "Failed to skip ATOM entry element.");
+        }
+        else if (fAppSyn)
+        {
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"application", -1))
+            {
+                hr = ReadAttributeValue(pReader, L"type", &pApupEntry->wzApplicationType);
+                ApupExitOnFailure(hr, "Failed to read application type.");
+
+                hr = ReadElementText(pReader, &pApupEntry->wzApplicationId);
+                ApupExitOnFailure(hr, "Failed to read application identity.");
+            }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"upgrade", -1))
+            {
+                hr = ReadAttributeValue(pReader, L"version", &sczValue);
+                ApupExitOnFailure(hr, "Failed to read upgrade version.");
+
+                if (S_OK == hr)
+                {
+                    ReleaseVerutilVersion(pApupEntry->pUpgradeVersion);
+
+                    hr = VerParseVersion(sczValue, 0, FALSE, &pApupEntry->pUpgradeVersion);
+                    ApupExitOnFailure(hr, "Failed to parse upgrade version string '%ls' from ATOM entry.", sczValue);
+                }
+
+                hr = ReadAttributeValue(pReader, L"exclusive", &sczValue);
+                ApupExitOnFailure(hr, "Failed to read upgrade exclusive.");
+
+                if (S_OK == hr && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, L"true", -1))
+                {
+                    pApupEntry->fUpgradeExclusive = TRUE;
+                }
+
+                hr = ReadElementText(pReader, &pApupEntry->wzUpgradeId);
+                ApupExitOnFailure(hr, "Failed to read upgrade id.");
+            }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"version", -1))
+            {
+                hr = ReadElementText(pReader, &sczValue);
+                ApupExitOnFailure(hr, "Failed to read version.");
+
+                ReleaseVerutilVersion(pApupEntry->pVersion);
+
+                hr = VerParseVersion(sczValue, 0, FALSE, &pApupEntry->pVersion);
+                ApupExitOnFailure(hr, "Failed to parse version string '%ls' from ATOM entry.", sczValue);
+
+                if (pMinimumVersion)
+                {
+                    hr = VerCompareParsedVersions(pApupEntry->pVersion, pMinimumVersion, &nCompareResult);
+                    ApupExitOnFailure(hr, "Failed to compare version to minimum version.");
+
+                    fSkip = (0 >= nCompareResult);
+                }
+            }
+            else
+            {
+                hr = SkipElement(pReader);
+                ApupExitOnFailure(hr, "Failed to skip ATOM entry element: %ls", wzLocalName);
+            }
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"title", -1))
+        {
+            hr = ReadElementText(pReader, &pApupEntry->wzTitle);
+            ApupExitOnFailure(hr, "Failed to read application title.");
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"summary", -1))
+        {
+            hr = ReadElementText(pReader, &pApupEntry->wzSummary);
+            ApupExitOnFailure(hr, "Failed to read application summary.");
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"content", -1))
+        {
+            hr = ReadAttributeValue(pReader, L"type", &pApupEntry->wzContentType);
+            ApupExitOnFailure(hr, "Failed to read content type.");
+
+            hr = ReadElementText(pReader, &pApupEntry->wzContent);
+            ApupExitOnFailure(hr, "Failed to read content.");
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzLocalName, -1, L"link", -1))
+        {
+            hr = ReadFeedLink(pReader, pApupEntry);
+            ApupExitOnFailure(hr, "Failed to read link.");
+        }
+        else
+        {
+            hr = SkipElement(pReader);
+            ApupExitOnFailure(hr, "Failed to skip ATOM entry element: %ls", wzLocalName);
+        }
+    }
+    ApupExitOnFailure(hr, "Failed to read ATOM entry.");
+
+    // If there is no version or the entry is not newer than the minimum version, skip the whole thing.
+    if (fSkip || !pApupEntry->pVersion)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    if (pApupEntry->pUpgradeVersion)
+    {
+        hr = VerCompareParsedVersions(pApupEntry->pUpgradeVersion, pApupEntry->pVersion, &nCompareResult);
+        ApupExitOnFailure(hr, "Failed to compare version to upgrade version.");
+
+        if (nCompareResult >= 0)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            ApupExitOnRootFailure(hr, "Upgrade version is greater than or equal to application version.");
+        }
+    }
+
+    hr = S_OK;
+
+LExit:
+    ReleaseStr(sczValue);
+
+    if (S_OK != hr) // if anything went wrong or the entry was skipped, free the entry.
+    {
+        FreeEntry(pApupEntry);
+        memset(pApupEntry, 0, sizeof(APPLICATION_UPDATE_ENTRY));
+    }
+
+    return hr;
+}
+
+
+static HRESULT ReadFeedLink(
+    __in IXmlReader* pReader,
+    __inout APPLICATION_UPDATE_ENTRY* pApupEntry
+    )
+{
+    HRESULT hr = S_OK;
+    APPLICATION_UPDATE_ENCLOSURE enclosure = { };
+    UINT nLinkDepth = 0;
+    BOOL fAppSyn = FALSE;
+    LPCWSTR wzLocalName = NULL;
+    LPWSTR sczValue = NULL;
+    LPWSTR sczAlgorithm = NULL;
+
+    hr = ReadAttributeValue(pReader, L"rel", &sczValue);
+    ApupExitOnFailure(hr, "Failed to read link rel.");
+
+    // Only enclosures are interesting, everything else is skipped.
+    if (S_FALSE == hr || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, -1, L"enclosure", -1))
+    {
+        hr = SkipElement(pReader);
+        ApupExitOnFailure(hr, "Failed to skip link.");
+
+        ExitFunction();
+    }
+
+    hr = ReadAttributeValue(pReader, L"href", &enclosure.wzUrl);
+    ApupExitOnFailure(hr, "Failed to read enclosure href.");
+
+    if (S_FALSE == hr)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Enclosure is missing its href.");
+    }
+
+    hr = ReadAttributeValue(pReader, L"length", &sczValue);
+    ApupExitOnFailure(hr, "Failed to read enclosure length.");
+
+    if (S_OK == hr)
+    {
+        hr = StrStringToUInt64(sczValue, 0, &enclosure.dw64Size);
+        if (E_INVALIDARG == hr)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+        ApupExitOnFailure(hr, "Failed to parse enclosure length.");
+    }
+
+    if (!pReader->IsEmptyElement())
+    {
+        hr = pReader->GetDepth(&nLinkDepth);
+        ApupExitOnFailure(hr, "Failed to get depth of link element.");
+
+        while (S_OK == (hr = ReadNextChildElement(pReader, nLinkDepth, &fAppSyn, &wzLocalName)))
+        {
+            if (fAppSyn && !enclosure.rgbDigest && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, L"digest", -1, wzLocalName, -1))
+            {
+                hr = ReadAttributeValue(pReader, L"algorithm", &sczAlgorithm);
+                ApupExitOnFailure(hr, "Failed to read digest algorithm.");
+
+                hr = ReadElementText(pReader, &sczValue);
+                ApupExitOnFailure(hr, "Failed to read digest.");
+
+                hr = ParseDigest(sczAlgorithm, sczValue, &enclosure);
+                ApupExitOnFailure(hr, "Failed to parse digest.");
+            }
+            else if (fAppSyn && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, L"name", -1, wzLocalName, -1))
+            {
+                hr = ReadElementText(pReader, &enclosure.wzLocalName);
+                ApupExitOnFailure(hr, "Failed to read local name.");
+            }
+            else
+            {
+                hr = SkipElement(pReader);
+                ApupExitOnFailure(hr, "Failed to skip link element: %ls", wzLocalName);
+            }
+        }
+        ApupExitOnFailure(hr, "Failed to read link.");
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pApupEntry->rgEnclosures), pApupEntry->cEnclosures, 1, sizeof(APPLICATION_UPDATE_ENCLOSURE), 2);
+    ApupExitOnFailure(hr, "Failed to grow enclosures for application update entry.");
+
+    // The entry takes ownership of the enclosure.
+    pApupEntry->rgEnclosures[pApupEntry->cEnclosures] = enclosure;
+    ++pApupEntry->cEnclosures;
+
+    pApupEntry->dw64TotalSize += enclosure.dw64Size; // total up the size of the enclosures
+
+    memset(&enclosure, 0, sizeof(enclosure));
+    hr = S_OK;
+
+LExit:
+    FreeEnclosure(&enclosure);
+    ReleaseStr(sczAlgorithm);
+    ReleaseStr(sczValue);
+
+    return hr;
+}
+
+
+static HRESULT ReadNextChildElement(
+    __in IXmlReader* pReader,
+    __in UINT nParentDepth,
+    __out BOOL* pfAppSyn,
+    __out_z LPCWSTR* pwzLocalName
+    )
+{
+    HRESULT hr = S_OK;
+    XmlNodeType nodeType = XmlNodeType_None;
+    UINT nDepth = 0;
+    LPCWSTR wzNamespace = NULL;
+
+    while (S_OK == (hr = pReader->Read(&nodeType)))
+    {
+        if (XmlNodeType_Element == nodeType)
+        {
+            hr = pReader->GetNamespaceUri(&wzNamespace, NULL);
+            ApupExitOnFailure(hr, "Failed to get element namespace.");
+
+            hr = pReader->GetLocalName(pwzLocalName, NULL);
+            ApupExitOnFailure(hr, "Failed to get element name.");
+
+            *pfAppSyn = CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, wzNamespace, -1, APPLICATION_SYNDICATION_NAMESPACE, -1);
+
+            ExitFunction();
+        }
+        else if (XmlNodeType_EndElement == nodeType)
+        {
+            hr = pReader->GetDepth(&nDepth);
+            ApupExitOnFailure(hr, "Failed to get element depth.");
+
+            if (nDepth == nParentDepth)
+            {
+                ExitFunction1(hr = S_FALSE); // no more children.
+            }
+        }
+    }
+    ApupExitOnFailure(hr, "Failed to read XML node.");
+
+    hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    ApupExitOnRootFailure(hr, "Unexpected end of ATOM feed.");
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT ReadAttributeValue(
+    __in IXmlReader* pReader,
+    __in_z LPCWSTR wzName,
+    __deref_out_z_opt LPWSTR* psczValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wzValue = NULL;
+    UINT cchValue = 0;
+
+    hr = pReader->MoveToAttributeByName(wzName, NULL);
+    ApupExitOnFailure(hr, "Failed to find attribute: %ls", wzName);
+
+    if (S_FALSE == hr)
+    {
+        ReleaseNullStr(*psczValue);
+        ExitFunction();
+    }
+
+    hr = pReader->GetValue(&wzValue, &cchValue);
+    ApupExitOnFailure(hr, "Failed to get value of attribute: %ls", wzName);
+
+    hr = StrAllocString(psczValue, wzValue, cchValue);
+    ApupExitOnFailure(hr, "Failed to copy value of attribute: %ls", wzName);
+
+LExit:
+    // Always leave the reader on the element so its text and children can be read next.
+    pReader->MoveToElement();
+
+    return hr;
+}
+
+
+static HRESULT ReadElementText(
+    __in IXmlReader* pReader,
+    __deref_out_z LPWSTR* psczValue
+    )
+{
+    HRESULT hr = S_OK;
+    XmlNodeType nodeType = XmlNodeType_None;
+    UINT nElementDepth = 0;
+    UINT nDepth = 0;
+    LPCWSTR wzValue = NULL;
+    UINT cchValue = 0;
+    LPWSTR wzStart = NULL;
+    size_t cchText = 0;
+
+    hr = StrAllocString(psczValue, L"", 0);
+    ApupExitOnFailure(hr, "Failed to initialize element text.");
+
+    if (pReader->IsEmptyElement())
+    {
+        ExitFunction();
+    }
+
+    hr = pReader->GetDepth(&nElementDepth);
+    ApupExitOnFailure(hr, "Failed to get element depth.");
+
+    // Concatenate all descendant text, the same as the DOM's text property.
+    while (S_OK == (hr = pReader->Read(&nodeType)))
+    {
+        if (XmlNodeType_Text == nodeType || XmlNodeType_CDATA == nodeType || XmlNodeType_Whitespace == nodeType)
+        {
+            hr = pReader->GetValue(&wzValue, &cchValue);
+            ApupExitOnFailure(hr, "Failed to get element text.");
+
+            if (cchValue)
+            {
+                hr = StrAllocConcat(psczValue, wzValue, cchValue);
+                ApupExitOnFailure(hr, "Failed to append element text.");
+            }
+        }
+        else if (XmlNodeType_EndElement == nodeType)
+        {
+            hr = pReader->GetDepth(&nDepth);
+            ApupExitOnFailure(hr, "Failed to get element depth.");
+
+            if (nDepth == nElementDepth)
+            {
+                break;
+            }
+        }
+    }
+    ApupExitOnFailure(hr, "Failed to read element text.");
+
+    if (S_FALSE == hr)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        ApupExitOnRootFailure(hr, "Unexpected end of ATOM feed.");
+    }
+
+    // Trim leading and trailing whitespace in place.
+    wzStart = *psczValue;
+    while (L' ' == *wzStart || L'\t' == *wzStart || L'\r' == *wzStart || L'\n' == *wzStart)
+    {
+        ++wzStart;
+    }
+
+    cchText = wcslen(wzStart);
+    while (cchText && (L' ' == wzStart[cchText - 1] || L'\t' == wzStart[cchText - 1] || L'\r' == wzStart[cchText - 1] || L'\n' == wzStart[cchText - 1]))
+    {
+        --cchText;
+    }
+
+    memmove(*psczValue, wzStart, cchText * sizeof(WCHAR));
+    (*psczValue)[cchText] = L'\0';
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT SkipElement(
+    __in IXmlReader* pReader
+    )
+{
+    HRESULT hr = S_OK;
+    UINT nElementDepth = 0;
+    BOOL fAppSyn = FALSE;
+    LPCWSTR wzLocalName = NULL;
+
+    if (pReader->IsEmptyElement())
+    {
+        ExitFunction();
+    }
+
+    hr = pReader->GetDepth(&nElementDepth);
+    ApupExitOnFailure(hr, "Failed to get element depth.");
+
+    while (S_OK == (hr = ReadNextChildElement(pReader, nElementDepth, &fAppSyn, &wzLocalName)))
+    {
+        hr = SkipElement(pReader);
+        ApupExitOnFailure(hr, "Failed to skip child element.");
+    }
+    ApupExitOnFailure(hr, "Failed to skip element.");
+
+    hr = S_OK;
+
+LExit:
+    return hr;
+}
+
+
 static __callback int __cdecl CompareEntries(
     void* /*pvContext*/,
     const void* pvLeft,
@@ -29,6 +29,14 @@ static HRESULT EnsureBufferSize(
     __deref_inout_bcount(cbSize) BYTE** ppbBuffer,
     __in SIZE_T cbSize
     );
+static HRESULT EnsureWriterCapacity(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cbAdditional
+    );
+static void WriterAppendSize(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cb
+    );
 
 
 // functions
@@ -498,6 +506,192 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT BuffWriterReserve(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cbAdditional
+    )
+{
+    Assert(pWriter);
+
+    HRESULT hr = S_OK;
+
+    hr = EnsureWriterCapacity(pWriter, cbAdditional);
+    BuffExitOnFailure(hr, "Failed to reserve buffer writer capacity.");
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWriteNumber(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD dw
+    )
+{
+    Assert(pWriter);
+
+    HRESULT hr = S_OK;
+
+    hr = EnsureWriterCapacity(pWriter, sizeof(DWORD));
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    *(DWORD*)(pWriter->pbData + pWriter->cbData) = dw;
+    pWriter->cbData += sizeof(DWORD);
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWriteNumber64(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD64 dw64
+    )
+{
+    Assert(pWriter);
+
+    HRESULT hr = S_OK;
+
+    hr = EnsureWriterCapacity(pWriter, sizeof(DWORD64));
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    *(DWORD64*)(pWriter->pbData + pWriter->cbData) = dw64;
+    pWriter->cbData += sizeof(DWORD64);
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWritePointer(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD_PTR dw
+    )
+{
+    Assert(pWriter);
+
+    HRESULT hr = S_OK;
+
+    hr = EnsureWriterCapacity(pWriter, sizeof(DWORD_PTR));
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    *(DWORD_PTR*)(pWriter->pbData + pWriter->cbData) = dw;
+    pWriter->cbData += sizeof(DWORD_PTR);
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWriteString(
+    __in BUFF_WRITER* pWriter,
+    __in_z_opt LPCWSTR scz
+    )
+{
+    return BuffWriterWriteStrings(pWriter, &scz, 1);
+}
+
+extern "C" HRESULT BuffWriterWriteStrings(
+    __in BUFF_WRITER* pWriter,
+    __in_ecount(cStrings) LPCWSTR* rgsz,
+    __in DWORD cStrings
+    )
+{
+    Assert(pWriter);
+    Assert(rgsz || !cStrings);
+
+    HRESULT hr = S_OK;
+    SIZE_T cch = 0;
+    SIZE_T cb = 0;
+    SIZE_T cbTotal = 0;
+
+    // size the whole batch first so the buffer grows at most once
+    for (DWORD i = 0; i < cStrings; ++i)
+    {
+        cch = 0;
+
+        if (rgsz[i])
+        {
+            hr = ::StringCchLengthW(rgsz[i], STRSAFE_MAX_CCH, reinterpret_cast<size_t*>(&cch));
+            BuffExitOnRootFailure(hr, "Failed to get string size.");
+        }
+
+        hr = ::SIZETAdd(cbTotal, sizeof(SIZE_T) + cch * sizeof(WCHAR), &cbTotal);
+        BuffExitOnRootFailure(hr, "Overflow while calculating size of strings.");
+    }
+
+    hr = EnsureWriterCapacity(pWriter, cbTotal);
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    for (DWORD i = 0; i < cStrings; ++i)
+    {
+        cch = rgsz[i] ? wcslen(rgsz[i]) : 0;
+        cb = cch * sizeof(WCHAR);
+
+        // copy character count and data to buffer
+        WriterAppendSize(pWriter, cch);
+
+        memcpy(pWriter->pbData + pWriter->cbData, rgsz[i], cb);
+        pWriter->cbData += cb;
+    }
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWriteStringAnsi(
+    __in BUFF_WRITER* pWriter,
+    __in_z_opt LPCSTR scz
+    )
+{
+    Assert(pWriter);
+
+    HRESULT hr = S_OK;
+    SIZE_T cch = 0;
+
+    if (scz)
+    {
+        hr = ::StringCchLengthA(scz, STRSAFE_MAX_CCH, reinterpret_cast<size_t*>(&cch));
+        BuffExitOnRootFailure(hr, "Failed to get string size.");
+    }
+
+    hr = EnsureWriterCapacity(pWriter, sizeof(SIZE_T) + cch * sizeof(CHAR));
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    // copy character count and data to buffer
+    WriterAppendSize(pWriter, cch);
+
+    memcpy(pWriter->pbData + pWriter->cbData, scz, cch * sizeof(CHAR));
+    pWriter->cbData += cch * sizeof(CHAR);
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT BuffWriterWriteStream(
+    __in BUFF_WRITER* pWriter,
+    __in_bcount(cbStream) const BYTE* pbStream,
+    __in SIZE_T cbStream
+    )
+{
+    Assert(pWriter);
+    Assert(pbStream || !cbStream);
+
+    HRESULT hr = S_OK;
+    SIZE_T cbTotal = 0;
+
+    hr = ::SIZETAdd(cbStream, sizeof(SIZE_T), &cbTotal);
+    BuffExitOnRootFailure(hr, "Overflow while calculating size of stream.");
+
+    hr = EnsureWriterCapacity(pWriter, cbTotal);
+    BuffExitOnFailure(hr, "Failed to ensure buffer size.");
+
+    // copy byte count and data to buffer
+    WriterAppendSize(pWriter, cbStream);
+
+    memcpy(pWriter->pbData + pWriter->cbData, pbStream, cbStream);
+    pWriter->cbData += cbStream;
+
+LExit:
+    return hr;
+}
+
 
 // helper functions
 
@@ -508,11 +702,19 @@ static HRESULT EnsureBufferSize(
 {
     HRESULT hr = S_OK;
     SIZE_T cbTarget = ((cbSize / BUFFER_INCREMENT) + 1) * BUFFER_INCREMENT;
+    SIZE_T cbCurrent = 0;
 
     if (*ppbBuffer)
     {
-        if (MemSize(*ppbBuffer) < cbTarget)
+        cbCurrent = MemSize(*ppbBuffer);
+        if (cbCurrent < cbTarget)
         {
+            // grow geometrically so a long series of small writes doesn't reallocate on every call
+            if (cbTarget < cbCurrent * 2 && cbCurrent < SIZE_T_MAX / 2)
+            {
+                cbTarget = cbCurrent * 2;
+            }
+
             LPVOID pv = MemReAlloc(*ppbBuffer, cbTarget, TRUE);
             BuffExitOnNull(pv, hr, E_OUTOFMEMORY, "Failed to reallocate buffer.");
             *ppbBuffer = (BYTE*)pv;
@@ -527,3 +729,51 @@ static HRESULT EnsureBufferSize(
 LExit:
     return hr;
 }
+
+static HRESULT EnsureWriterCapacity(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cbAdditional
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cbRequired = 0;
+    SIZE_T cbTarget = 0;
+    LPVOID pv = NULL;
+
+    hr = ::SIZETAdd(pWriter->cbData, cbAdditional, &cbRequired);
+    BuffExitOnRootFailure(hr, "Overflow while calculating buffer size.");
+
+    if (cbRequired <= pWriter->cbAllocated)
+    {
+        ExitFunction();
+    }
+
+    cbTarget = pWriter->cbAllocated < SIZE_T_MAX / 2 ? pWriter->cbAllocated * 2 : SIZE_T_MAX;
+    if (cbTarget < cbRequired)
+    {
+        cbTarget = cbRequired;
+    }
+
+    if (cbTarget < BUFFER_INCREMENT)
+    {
+        cbTarget = BUFFER_INCREMENT;
+    }
+
+    pv = pWriter->pbData ? MemReAlloc(pWriter->pbData, cbTarget, FALSE) : MemAlloc(cbTarget, FALSE);
+    BuffExitOnNull(pv, hr, E_OUTOFMEMORY, "Failed to allocate buffer.");
+
+    pWriter->pbData = static_cast<BYTE*>(pv);
+    pWriter->cbAllocated = cbTarget;
+
+LExit:
+    return hr;
+}
+
+static void WriterAppendSize(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cb
+    )
+{
+    *(SIZE_T*)(pWriter->pbData + pWriter->cbData) = cb;
+    pWriter->cbData += sizeof(SIZE_T);
+}
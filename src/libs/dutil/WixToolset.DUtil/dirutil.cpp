@@ -17,6 +17,67 @@
 #define DirExitOnWin32Error(e, x, s, ...) ExitOnWin32ErrorSource(DUTIL_SOURCE_DIRUTIL, e, x, s, __VA_ARGS__)
 #define DirExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_DIRUTIL, g, x, s, __VA_ARGS__)
 
+// constants
+
+const DWORD DIR_DELETE_TREE_PROGRESS_INTERVAL = 250;
+
+// structs
+
+typedef struct _DIR_DELETE_TREE_DIRECTORY
+{
+    LPWSTR sczPath;
+    DWORD dwDepth;
+} DIR_DELETE_TREE_DIRECTORY;
+
+// Shared by the workers that delete a tree. Directories are appended as they
+// are found and each one is claimed by exactly one worker, which deletes its
+// files. The directories themselves are removed deepest first once every
+// worker is done. The trace callback may not be thread safe so the workers
+// never trace; they only count what they could not delete.
+typedef struct _DIR_DELETE_TREE
+{
+    CRITICAL_SECTION cs;
+    DIR_DELETE_TREE_DIRECTORY* rgDirectories;
+    DWORD cDirectories;
+    DWORD iNextDirectory;
+    DWORD cThreads;
+
+    HANDLE hQueued;     // semaphore, one count per directory waiting to be claimed.
+    LONG cPending;      // directories found but not finished.
+    LONG fDone;
+    LONG hrFailure;
+
+    LONG cScanned;
+    LONG cDeleted;
+    LONG cRebootRequired;
+    LONG cSkipped;
+} DIR_DELETE_TREE;
+
+// internal function declarations
+
+static void DeleteTreeItem(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwFileAttributes
+    );
+static HRESULT QueueDeleteTreeDirectory(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwDepth
+    );
+static HRESULT DeleteTreeDirectoryFiles(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwDepth
+    );
+static DWORD WINAPI DeleteTreeThreadProc(
+    __in LPVOID lpThreadParameter
+    );
+static int __cdecl CompareDeleteTreeDirectoryDepth(
+    __in const void* pvLeft,
+    __in const void* pvRight
+    );
+
 
 /*******************************************************************
  DirExists
@@ -352,6 +413,267 @@ LExit:
 }
 
 
+/*******************************************************************
+ DirDeleteTree - removes a directory and everything under it, walking
+                 the tree on a pool of cThreads workers (zero picks one
+                 per processor). Junctions and symbolic links are removed
+                 without being followed. Anything in use is scheduled for
+                 removal on reboot.
+
+ Returns: S_FALSE if the directory does not exist.
+*******************************************************************/
+extern "C" HRESULT DAPI DirDeleteTree(
+    __in_z LPCWSTR wzPath,
+    __in DWORD cThreads,
+    __in_opt PFN_DIR_DELETE_TREE_PROGRESS pfnProgress,
+    __in_opt LPVOID pvContext,
+    __out_opt DIR_DELETE_TREE_RESULTS* pResults
+    )
+{
+    Assert(wzPath && *wzPath);
+
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    DIR_DELETE_TREE del = { };
+    BOOL fInitializedCs = FALSE;
+    HANDLE* rghThreads = NULL;
+    DWORD cStarted = 0;
+    DWORD cScanned = 0;
+    DWORD cDirectories = 0;
+    SYSTEM_INFO systemInfo = { };
+
+    if (pResults)
+    {
+        memset(pResults, 0, sizeof(DIR_DELETE_TREE_RESULTS));
+    }
+
+    if (!DirExists(wzPath, NULL))
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    if (!cThreads)
+    {
+        ::GetNativeSystemInfo(&systemInfo);
+        cThreads = max(1, systemInfo.dwNumberOfProcessors);
+    }
+
+    ::InitializeCriticalSection(&del.cs);
+    fInitializedCs = TRUE;
+
+    del.cThreads = cThreads;
+    del.hQueued = ::CreateSemaphoreW(NULL, 0, LONG_MAX, NULL);
+    DirExitOnNullWithLastError(del.hQueued, hr, "Failed to create semaphore to delete directory: %ls", wzPath);
+
+    rghThreads = static_cast<HANDLE*>(MemAlloc(sizeof(HANDLE) * cThreads, TRUE));
+    DirExitOnNull(rghThreads, hr, E_OUTOFMEMORY, "Failed to allocate threads to delete directory: %ls", wzPath);
+
+    hr = QueueDeleteTreeDirectory(&del, wzPath, 0);
+    DirExitOnFailure(hr, "Failed to queue directory to delete: %ls", wzPath);
+
+    for (DWORD i = 0; i < cThreads; ++i)
+    {
+        rghThreads[i] = ::CreateThread(NULL, 0, DeleteTreeThreadProc, &del, 0, NULL);
+        if (!rghThreads[i])
+        {
+            DirExitWithLastError(hr, "Failed to create thread to delete directory: %ls", wzPath);
+        }
+
+        ++cStarted;
+    }
+
+    do
+    {
+        er = ::WaitForMultipleObjects(cStarted, rghThreads, TRUE, pfnProgress ? DIR_DELETE_TREE_PROGRESS_INTERVAL : INFINITE);
+        if (WAIT_FAILED == er)
+        {
+            DirExitWithLastError(hr, "Failed to wait for directory to be deleted: %ls", wzPath);
+        }
+
+        if (pfnProgress)
+        {
+            ::EnterCriticalSection(&del.cs);
+            cScanned = del.cScanned;
+            cDirectories = del.cDirectories;
+            ::LeaveCriticalSection(&del.cs);
+
+            hr = pfnProgress(cScanned, cDirectories, pvContext);
+            DirExitOnFailure(hr, "Progress callback stopped delete of directory: %ls", wzPath);
+        }
+    } while (WAIT_TIMEOUT == er);
+
+    hr = del.hrFailure;
+    DirExitOnFailure(hr, "Failed to delete files in directory: %ls", wzPath);
+
+    // Children sort ahead of their parents so each directory is empty when it is removed.
+    qsort(del.rgDirectories, del.cDirectories, sizeof(DIR_DELETE_TREE_DIRECTORY), CompareDeleteTreeDirectoryDepth);
+
+    for (DWORD i = 0; i < del.cDirectories; ++i)
+    {
+        DeleteTreeItem(&del, del.rgDirectories[i].sczPath, ::GetFileAttributesW(del.rgDirectories[i].sczPath));
+    }
+
+    if (pResults)
+    {
+        pResults->cDirectories = del.cDirectories;
+        pResults->cDeleted = del.cDeleted;
+        pResults->cRebootRequired = del.cRebootRequired;
+        pResults->cSkipped = del.cSkipped;
+        pResults->cThreads = cStarted;
+    }
+
+LExit:
+    if (cStarted)
+    {
+        ::InterlockedExchange(&del.fDone, TRUE);
+        ::ReleaseSemaphore(del.hQueued, cThreads, NULL);
+        ::WaitForMultipleObjects(cStarted, rghThreads, TRUE, INFINITE);
+
+        for (DWORD i = 0; i < cStarted; ++i)
+        {
+            ReleaseHandle(rghThreads[i]);
+        }
+    }
+
+    for (DWORD i = 0; i < del.cDirectories; ++i)
+    {
+        ReleaseStr(del.rgDirectories[i].sczPath);
+    }
+    ReleaseMem(del.rgDirectories);
+    ReleaseMem(rghThreads);
+    ReleaseHandle(del.hQueued);
+
+    if (fInitializedCs)
+    {
+        ::DeleteCriticalSection(&del.cs);
+    }
+
+    return hr;
+}
+
+
+/*******************************************************************
+ DirMoveTree - moves a directory and everything under it to wzTarget.
+               When the directory cannot be renamed as a whole, because
+               wzTarget already exists or something under it is in use,
+               each child is moved on its own into wzTarget, so whatever
+               could be moved can be moved back the same way. Keeps
+               going after a child fails and returns the first failure.
+
+*******************************************************************/
+extern "C" HRESULT DAPI DirMoveTree(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fReplaceExisting
+    )
+{
+    Assert(wzSource && *wzSource && wzTarget && *wzTarget);
+
+    HRESULT hr = S_OK;
+    HRESULT hrChild = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwAttributes = 0;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+    LPWSTR sczSearch = NULL;
+    LPWSTR sczSourceChild = NULL;
+    LPWSTR sczTargetChild = NULL;
+
+    if (!DirExists(wzSource, &dwAttributes))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
+        DirExitOnRootFailure(hr, "Directory to move does not exist: %ls", wzSource);
+    }
+
+    if (!DirExists(wzTarget, NULL) && ::MoveFileExW(wzSource, wzTarget, 0))
+    {
+        ExitFunction();
+    }
+
+    hr = DirEnsureExists(wzTarget, NULL);
+    DirExitOnFailure(hr, "Failed to create directory to move into: %ls", wzTarget);
+
+    hr = PathConcat(wzSource, L"*", &sczSearch);
+    DirExitOnFailure(hr, "Failed to concat wild cards to string: %ls", wzSource);
+
+    hFind = ::FindFirstFileW(sczSearch, &wfd);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        DirExitWithLastError(hr, "Failed to get first file in directory: %ls", wzSource);
+    }
+
+    do
+    {
+        // Skip the dot directories.
+        if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+        {
+            continue;
+        }
+
+        hr = PathConcat(wzSource, wfd.cFileName, &sczSourceChild);
+        DirExitOnFailure(hr, "Failed to concat filename '%ls' to directory: %ls", wfd.cFileName, wzSource);
+
+        hr = PathConcat(wzTarget, wfd.cFileName, &sczTargetChild);
+        DirExitOnFailure(hr, "Failed to concat filename '%ls' to directory: %ls", wfd.cFileName, wzTarget);
+
+        // Junctions and symbolic links move as themselves, never their contents.
+        if ((FILE_ATTRIBUTE_DIRECTORY & wfd.dwFileAttributes) && !(FILE_ATTRIBUTE_REPARSE_POINT & wfd.dwFileAttributes))
+        {
+            hr = DirMoveTree(sczSourceChild, sczTargetChild, fReplaceExisting); // recursive call
+        }
+        else if (::MoveFileExW(sczSourceChild, sczTargetChild, fReplaceExisting ? MOVEFILE_REPLACE_EXISTING : 0))
+        {
+            hr = S_OK;
+        }
+        else
+        {
+            hr = HRESULT_FROM_WIN32(::GetLastError());
+        }
+
+        if (FAILED(hr))
+        {
+            ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed to move '%ls' to '%ls'; continuing.", sczSourceChild, sczTargetChild);
+
+            if (SUCCEEDED(hrChild))
+            {
+                hrChild = hr;
+            }
+
+            hr = S_OK;
+        }
+    } while (::FindNextFileW(hFind, &wfd));
+
+    er = ::GetLastError();
+    if (ERROR_NO_MORE_FILES != er)
+    {
+        DirExitWithLastError(hr, "Failed while looping through files in directory: %ls", wzSource);
+    }
+
+    hr = hrChild;
+    DirExitOnFailure(hr, "Failed to move everything in '%ls' to '%ls'.", wzSource, wzTarget);
+
+    ReleaseFileFindHandle(hFind);
+
+    if (FILE_ATTRIBUTE_READONLY & dwAttributes)
+    {
+        ::SetFileAttributesW(wzSource, dwAttributes & ~FILE_ATTRIBUTE_READONLY);
+    }
+
+    if (!::RemoveDirectoryW(wzSource))
+    {
+        DirExitWithLastError(hr, "Failed to remove directory after moving its contents: %ls", wzSource);
+    }
+
+LExit:
+    ReleaseFileFindHandle(hFind);
+    ReleaseStr(sczTargetChild);
+    ReleaseStr(sczSourceChild);
+    ReleaseStr(sczSearch);
+
+    return hr;
+}
+
+
 /*******************************************************************
 DirDeleteEmptyDirectoriesToRoot - removes an empty directory and as many
                                   of its parents as possible.
@@ -439,3 +761,213 @@ extern "C" HRESULT DAPI DirSetCurrent(
 LExit:
     return hr;
 }
+
+
+// internal functions
+
+static void DeleteTreeItem(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwFileAttributes
+    )
+{
+    DWORD er = ERROR_SUCCESS;
+
+    if (INVALID_FILE_ATTRIBUTES == dwFileAttributes)
+    {
+        ExitFunction();
+    }
+
+    if (FILE_ATTRIBUTE_READONLY & dwFileAttributes)
+    {
+        ::SetFileAttributesW(wzPath, dwFileAttributes & ~FILE_ATTRIBUTE_READONLY);
+    }
+
+    if ((FILE_ATTRIBUTE_DIRECTORY & dwFileAttributes) ? ::RemoveDirectoryW(wzPath) : ::DeleteFileW(wzPath))
+    {
+        ::InterlockedIncrement(&pDelete->cDeleted);
+        ExitFunction();
+    }
+
+    er = ::GetLastError();
+    if (ERROR_FILE_NOT_FOUND == er || ERROR_PATH_NOT_FOUND == er)
+    {
+        ExitFunction();
+    }
+
+    if (::MoveFileExW(wzPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT))
+    {
+        ::InterlockedIncrement(&pDelete->cRebootRequired);
+    }
+    else
+    {
+        ::InterlockedIncrement(&pDelete->cSkipped);
+    }
+
+LExit:
+    return;
+}
+
+static HRESULT QueueDeleteTreeDirectory(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwDepth
+    )
+{
+    HRESULT hr = S_OK;
+    DIR_DELETE_TREE_DIRECTORY* pDirectory = NULL;
+
+    ::EnterCriticalSection(&pDelete->cs);
+
+    hr = MemEnsureArraySize(reinterpret_cast<void**>(&pDelete->rgDirectories), pDelete->cDirectories + 1, sizeof(DIR_DELETE_TREE_DIRECTORY), 256);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    pDirectory = pDelete->rgDirectories + pDelete->cDirectories;
+
+    hr = StrAllocString(&pDirectory->sczPath, wzPath, 0);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    pDirectory->dwDepth = dwDepth;
+    ++pDelete->cDirectories;
+
+    ::InterlockedIncrement(&pDelete->cPending);
+    ::ReleaseSemaphore(pDelete->hQueued, 1, NULL);
+
+LExit:
+    ::LeaveCriticalSection(&pDelete->cs);
+
+    return hr;
+}
+
+static HRESULT DeleteTreeDirectoryFiles(
+    __in DIR_DELETE_TREE* pDelete,
+    __in_z LPCWSTR wzPath,
+    __in DWORD dwDepth
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    LPWSTR sczSearch = NULL;
+    LPWSTR sczChild = NULL;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+
+    hr = PathConcat(wzPath, L"*", &sczSearch);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    hFind = ::FindFirstFileExW(sczSearch, FindExInfoBasic, &wfd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        er = ::GetLastError();
+        if (ERROR_FILE_NOT_FOUND != er && ERROR_PATH_NOT_FOUND != er)
+        {
+            ::InterlockedIncrement(&pDelete->cSkipped);
+        }
+        ExitFunction();
+    }
+
+    do
+    {
+        // Skip the dot directories.
+        if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+        {
+            continue;
+        }
+
+        hr = PathConcat(wzPath, wfd.cFileName, &sczChild);
+        if (FAILED(hr))
+        {
+            ExitFunction();
+        }
+
+        if ((FILE_ATTRIBUTE_DIRECTORY & wfd.dwFileAttributes) && !(FILE_ATTRIBUTE_REPARSE_POINT & wfd.dwFileAttributes))
+        {
+            hr = QueueDeleteTreeDirectory(pDelete, sczChild, dwDepth + 1);
+            if (FAILED(hr))
+            {
+                ExitFunction();
+            }
+        }
+        else
+        {
+            DeleteTreeItem(pDelete, sczChild, wfd.dwFileAttributes);
+        }
+    } while (!pDelete->fDone && ::FindNextFileW(hFind, &wfd));
+
+LExit:
+    ReleaseFileFindHandle(hFind);
+    ReleaseStr(sczChild);
+    ReleaseStr(sczSearch);
+
+    return hr;
+}
+
+static DWORD WINAPI DeleteTreeThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    HRESULT hr = S_OK;
+    DIR_DELETE_TREE* pDelete = reinterpret_cast<DIR_DELETE_TREE*>(lpThreadParameter);
+    LPCWSTR wzPath = NULL;
+    DWORD dwDepth = 0;
+
+    for (;;)
+    {
+        ::WaitForSingleObject(pDelete->hQueued, INFINITE);
+
+        if (pDelete->fDone)
+        {
+            break;
+        }
+
+        // The string belongs to the directory entry and does not move when the array grows.
+        ::EnterCriticalSection(&pDelete->cs);
+        wzPath = pDelete->rgDirectories[pDelete->iNextDirectory].sczPath;
+        dwDepth = pDelete->rgDirectories[pDelete->iNextDirectory].dwDepth;
+        ++pDelete->iNextDirectory;
+        ::LeaveCriticalSection(&pDelete->cs);
+
+        hr = DeleteTreeDirectoryFiles(pDelete, wzPath, dwDepth);
+        if (FAILED(hr))
+        {
+            ::InterlockedCompareExchange(&pDelete->hrFailure, hr, S_OK);
+            ::InterlockedExchange(&pDelete->fDone, TRUE);
+        }
+
+        ::InterlockedIncrement(&pDelete->cScanned);
+
+        // The last directory to finish wakes everyone so they can exit.
+        if (0 == ::InterlockedDecrement(&pDelete->cPending))
+        {
+            ::InterlockedExchange(&pDelete->fDone, TRUE);
+        }
+
+        if (pDelete->fDone)
+        {
+            ::ReleaseSemaphore(pDelete->hQueued, pDelete->cThreads, NULL);
+            break;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static int __cdecl CompareDeleteTreeDirectoryDepth(
+    __in const void* pvLeft,
+    __in const void* pvRight
+    )
+{
+    const DIR_DELETE_TREE_DIRECTORY* pLeft = static_cast<const DIR_DELETE_TREE_DIRECTORY*>(pvLeft);
+    const DIR_DELETE_TREE_DIRECTORY* pRight = static_cast<const DIR_DELETE_TREE_DIRECTORY*>(pvRight);
+
+    return pLeft->dwDepth < pRight->dwDepth ? 1 : pLeft->dwDepth > pRight->dwDepth ? -1 : 0;
+}
@@ -25,6 +25,9 @@ static LPCWSTR DOWNLOAD_ENGINE_ACCEPT_TYPES[] = { L"*/*", NULL };
 
 // internal function declarations
 
+static HRESULT OpenSession(
+    __out HINTERNET* phSession
+    );
 static HRESULT InitializeResume(
     __in LPCWSTR wzDestinationPath,
     __out LPWSTR* psczResumePath,
@@ -78,6 +81,7 @@ static HRESULT MakeRequest(
     __inout_z LPWSTR* psczSourceUrl,
     __in_z_opt LPCWSTR wzMethod,
     __in_z_opt LPCWSTR wzHeaders,
+    __in BOOL fConditional,
     __in_z_opt LPCWSTR wzUser,
     __in_z_opt LPCWSTR wzPassword,
     __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
@@ -98,6 +102,7 @@ static HRESULT SendRequest(
     __in HINTERNET hUrl,
     __inout_z LPWSTR* psczUrl,
     __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
+    __in BOOL fConditional,
     __out BOOL* pfRetry,
     __out BOOL* pfRangesAccepted
     );
@@ -131,7 +136,6 @@ extern "C" HRESULT DAPI DownloadUrl(
     HRESULT hr = S_OK;
     LPWSTR sczUrl = NULL;
     HINTERNET hSession = NULL;
-    DWORD dwTimeout = 0;
     LPWSTR sczResumePath = NULL;
     HANDLE hResumeFile = INVALID_HANDLE_VALUE;
     DWORD64 dw64ResumeOffset = 0;
@@ -143,18 +147,8 @@ extern "C" HRESULT DAPI DownloadUrl(
     hr = StrAllocString(&sczUrl, pDownloadSource->sczUrl, 0);
     DlExitOnFailure(hr, "Failed to copy download source URL.");
 
-    hSession = ::InternetOpenW(L"Burn", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
-    DlExitOnNullWithLastError(hSession, hr, "Failed to open internet session");
-
-    // Make a best effort to set the download timeouts to 2 minutes or whatever policy says.
-    PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"DownloadTimeout", 2 * 60, &dwTimeout);
-    if (0 < dwTimeout)
-    {
-        dwTimeout *= 1000; // convert to milliseconds.
-        ::InternetSetOptionW(hSession, INTERNET_OPTION_CONNECT_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
-        ::InternetSetOptionW(hSession, INTERNET_OPTION_RECEIVE_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
-        ::InternetSetOptionW(hSession, INTERNET_OPTION_SEND_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
-    }
+    hr = OpenSession(&hSession);
+    DlExitOnFailure(hr, "Failed to open internet session.");
 
     // Get the resource size and creation time from the internet.
     hr = GetResourceMetadata(hSession, &sczUrl, pDownloadSource->sczUser, pDownloadSource->sczPassword, pAuthenticate, &dw64Size, &ftCreated);
@@ -182,9 +176,133 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT DAPI DownloadUrlIfModified(
+    __in DOWNLOAD_SOURCE* pDownloadSource,
+    __in LPCWSTR wzDestinationPath,
+    __in_z_opt LPCWSTR wzETag,
+    __in_z_opt LPCWSTR wzLastModified,
+    __in_opt DOWNLOAD_CACHE_CALLBACK* pCache,
+    __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
+    __deref_opt_out_z_opt LPWSTR* psczETag,
+    __deref_opt_out_z_opt LPWSTR* psczLastModified
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczUrl = NULL;
+    LPWSTR sczHeaders = NULL;
+    HINTERNET hSession = NULL;
+    HINTERNET hConnect = NULL;
+    HINTERNET hUrl = NULL;
+    HANDLE hDestinationFile = INVALID_HANDLE_VALUE;
+    DWORD cbMaxData = 64 * 1024; // 64 KB
+    BYTE* pbData = NULL;
+    BOOL fRangeRequestsAccepted = FALSE;
+    LONGLONG llLength = 0;
+    DWORD64 dw64Offset = 0;
+
+    hr = StrAllocString(&sczUrl, pDownloadSource->sczUrl, 0);
+    DlExitOnFailure(hr, "Failed to copy download source URL.");
+
+    // Prefer the strong validator when there is one, the server ignores If-Modified-Since when If-None-Match is present anyway.
+    if (wzETag && *wzETag)
+    {
+        hr = StrAllocFormatted(&sczHeaders, L"If-None-Match: %ls\r\n", wzETag);
+        DlExitOnFailure(hr, "Failed to allocate If-None-Match header.");
+    }
+    else if (wzLastModified && *wzLastModified)
+    {
+        hr = StrAllocFormatted(&sczHeaders, L"If-Modified-Since: %ls\r\n", wzLastModified);
+        DlExitOnFailure(hr, "Failed to allocate If-Modified-Since header.");
+    }
+
+    hr = OpenSession(&hSession);
+    DlExitOnFailure(hr, "Failed to open internet session.");
+
+    hr = MakeRequest(hSession, &sczUrl, L"GET", sczHeaders, NULL != sczHeaders, pDownloadSource->sczUser, pDownloadSource->sczPassword, pAuthenticate, &hConnect, &hUrl, &fRangeRequestsAccepted);
+    DlExitOnFailure(hr, "Failed to request URL for download: %ls", sczUrl);
+
+    if (S_FALSE != hr)
+    {
+        hDestinationFile = ::CreateFileW(wzDestinationPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        DlExitOnInvalidHandleWithLastError(hDestinationFile, hr, "Failed to create download destination file: %ls", wzDestinationPath);
+
+        pbData = static_cast<BYTE*>(MemAlloc(cbMaxData, FALSE));
+        DlExitOnNull(pbData, hr, E_OUTOFMEMORY, "Failed to allocate buffer to download files into.");
+
+        hr = InternetGetSizeByHandle(hUrl, &llLength);
+        if (FAILED(hr))
+        {
+            llLength = 0;
+        }
+
+        hr = WriteToFile(hUrl, hDestinationFile, &dw64Offset, INVALID_HANDLE_VALUE, static_cast<DWORD64>(llLength), pbData, cbMaxData, pCache);
+        DlExitOnFailure(hr, "Failed while reading from internet and writing to: %ls", wzDestinationPath);
+    }
+
+    // Servers are not required to send either validator, so a missing header is returned as NULL.
+    if (psczETag)
+    {
+        ReleaseNullStr(*psczETag);
+
+        if (FAILED(InternetQueryInfoString(hUrl, HTTP_QUERY_ETAG, psczETag)))
+        {
+            ReleaseNullStr(*psczETag);
+        }
+    }
+
+    if (psczLastModified)
+    {
+        ReleaseNullStr(*psczLastModified);
+
+        if (FAILED(InternetQueryInfoString(hUrl, HTTP_QUERY_LAST_MODIFIED, psczLastModified)))
+        {
+            ReleaseNullStr(*psczLastModified);
+        }
+    }
+
+LExit:
+    ReleaseMem(pbData);
+    ReleaseFileHandle(hDestinationFile);
+    ReleaseInternet(hUrl);
+    ReleaseInternet(hConnect);
+    ReleaseInternet(hSession);
+    ReleaseStr(sczHeaders);
+    ReleaseStr(sczUrl);
+
+    return hr;
+}
 
 // internal helper functions
 
+static HRESULT OpenSession(
+    __out HINTERNET* phSession
+    )
+{
+    HRESULT hr = S_OK;
+    HINTERNET hSession = NULL;
+    DWORD dwTimeout = 0;
+
+    hSession = ::InternetOpenW(L"Burn", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    DlExitOnNullWithLastError(hSession, hr, "Failed to open internet session");
+
+    // Make a best effort to set the download timeouts to 2 minutes or whatever policy says.
+    PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"DownloadTimeout", 2 * 60, &dwTimeout);
+    if (0 < dwTimeout)
+    {
+        dwTimeout *= 1000; // convert to milliseconds.
+        ::InternetSetOptionW(hSession, INTERNET_OPTION_CONNECT_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
+        ::InternetSetOptionW(hSession, INTERNET_OPTION_RECEIVE_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
+        ::InternetSetOptionW(hSession, INTERNET_OPTION_SEND_TIMEOUT, &dwTimeout, sizeof(dwTimeout));
+    }
+
+    *phSession = hSession;
+    hSession = NULL;
+
+LExit:
+    ReleaseInternet(hSession);
+    return hr;
+}
+
 static HRESULT InitializeResume(
     __in LPCWSTR wzDestinationPath,
     __out LPWSTR* psczResumePath,
@@ -247,7 +365,7 @@ static HRESULT GetResourceMetadata(
     HINTERNET hUrl = NULL;
     LONGLONG llLength = 0;
 
-    hr = MakeRequest(hSession, psczUrl, L"HEAD", NULL, wzUser, wzPassword, pAuthenticate, &hConnect, &hUrl, &fRangeRequestsAccepted);
+    hr = MakeRequest(hSession, psczUrl, L"HEAD", NULL, FALSE, wzUser, wzPassword, pAuthenticate, &hConnect, &hUrl, &fRangeRequestsAccepted);
     DlExitOnFailure(hr, "Failed to connect to URL: %ls", *psczUrl);
 
     hr = InternetGetSizeByHandle(hUrl, &llLength);
@@ -320,7 +438,7 @@ static HRESULT DownloadResource(
         ReleaseNullInternet(hConnect);
         ReleaseNullInternet(hUrl);
 
-        hr = MakeRequest(hSession, psczUrl, L"GET", sczRangeRequestHeader, wzUser, wzPassword, pAuthenticate, &hConnect, &hUrl, &fRangeRequestsAccepted);
+        hr = MakeRequest(hSession, psczUrl, L"GET", sczRangeRequestHeader, FALSE, wzUser, wzPassword, pAuthenticate, &hConnect, &hUrl, &fRangeRequestsAccepted);
         DlExitOnFailure(hr, "Failed to request URL for download: %ls", *psczUrl);
 
         // If we didn't get the size of the resource from the initial "HEAD" request
@@ -494,6 +612,7 @@ static HRESULT MakeRequest(
     __inout_z LPWSTR* psczSourceUrl,
     __in_z_opt LPCWSTR wzMethod,
     __in_z_opt LPCWSTR wzHeaders,
+    __in BOOL fConditional,
     __in_z_opt LPCWSTR wzUser,
     __in_z_opt LPCWSTR wzPassword,
     __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
@@ -536,7 +655,7 @@ static HRESULT MakeRequest(
         hr = OpenRequest(hConnect, wzMethod, uri.scheme, uri.sczPath, uri.sczQueryString, wzHeaders, &hUrl);
         DlExitOnFailure(hr, "Failed to open internet URL: %ls", *psczSourceUrl);
 
-        hr = SendRequest(hUrl, psczSourceUrl, pAuthenticate, &fRetry, pfRangeRequestsAccepted);
+        hr = SendRequest(hUrl, psczSourceUrl, pAuthenticate, fConditional, &fRetry, pfRangeRequestsAccepted);
         DlExitOnFailure(hr, "Failed to send request to URL: %ls", *psczSourceUrl);
     } while (fRetry);
 
@@ -613,6 +732,7 @@ static HRESULT SendRequest(
     __in HINTERNET hUrl,
     __inout_z LPWSTR* psczUrl,
     __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
+    __in BOOL fConditional,
     __out BOOL* pfRetry,
     __out BOOL* pfRangesAccepted
     )
@@ -653,6 +773,22 @@ static HRESULT SendRequest(
             hr = S_OK;
             break;
 
+        case 304: // Not modified, only a valid answer to a conditional request.
+            if (fConditional)
+            {
+                hr = S_FALSE;
+            }
+            else
+            {
+                if (SUCCEEDED(hr))
+                {
+                    hr = E_UNEXPECTED;
+                }
+
+                LogErrorString(hr, "Unexpected HTTP status code %d to an unconditional request, returned from URL: %ls", lCode, *psczUrl);
+            }
+            break;
+
         // redirection cases
         case 301: __fallthrough; // file moved
         case 302: __fallthrough; // temporary
@@ -25,6 +25,65 @@ const BYTE UTF16BOM[] = {0xFF, 0xFE};
 const LPCWSTR REGISTRY_PENDING_FILE_RENAME_KEY = L"SYSTEM\\CurrentControlSet\\Control\\Session Manager";
 const LPCWSTR REGISTRY_PENDING_FILE_RENAME_VALUE = L"PendingFileRenameOperations";
 
+// Block cloning needs a newer SDK target than the rest of dutil.
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING 0x08000000
+#endif
+
+#ifndef FSCTL_GET_INTEGRITY_INFORMATION
+#define FSCTL_GET_INTEGRITY_INFORMATION CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 159, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define FSCTL_SET_INTEGRITY_INFORMATION CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 160, METHOD_BUFFERED, FILE_READ_DATA | FILE_WRITE_DATA)
+
+typedef struct _FSCTL_GET_INTEGRITY_INFORMATION_BUFFER
+{
+    WORD ChecksumAlgorithm;
+    WORD Reserved;
+    DWORD Flags;
+    DWORD ChecksumChunkSizeInBytes;
+    DWORD ClusterSizeInBytes;
+} FSCTL_GET_INTEGRITY_INFORMATION_BUFFER;
+
+typedef struct _FSCTL_SET_INTEGRITY_INFORMATION_BUFFER
+{
+    WORD ChecksumAlgorithm;
+    WORD Reserved;
+    DWORD Flags;
+} FSCTL_SET_INTEGRITY_INFORMATION_BUFFER;
+#endif
+
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
+
+typedef struct _DUPLICATE_EXTENTS_DATA
+{
+    HANDLE FileHandle;
+    LARGE_INTEGER SourceFileOffset;
+    LARGE_INTEGER TargetFileOffset;
+    LARGE_INTEGER ByteCount;
+} DUPLICATE_EXTENTS_DATA;
+#endif
+
+// A single duplicate extents request must stay below 4GB.
+const LONGLONG FILE_CLONE_MAX_CHUNK = 0x80000000;
+
+// internal function declarations
+
+static HRESULT EnsureCopy(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    );
+static HRESULT EnsureMove(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in BOOL fAllowCopy,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    );
+
 /*******************************************************************
  FileFromPath -  returns a pointer to the file part of the path
 
@@ -1262,58 +1321,7 @@ extern "C" HRESULT DAPI FileEnsureCopy(
     __in BOOL fOverwrite
     )
 {
-    HRESULT hr = S_OK;
-    DWORD er;
-
-    // try to copy the file first
-    if (::CopyFileW(wzSource, wzTarget, !fOverwrite))
-    {
-        ExitFunction();  // we're done
-    }
-
-    er = ::GetLastError();  // check the error and do the right thing below
-    if (!fOverwrite && (ERROR_FILE_EXISTS == er || ERROR_ALREADY_EXISTS == er))
-    {
-        // if not overwriting this is an expected error
-        ExitFunction1(hr = S_FALSE);
-    }
-    else if (ERROR_PATH_NOT_FOUND == er)  // if the path doesn't exist
-    {
-        // try to create the directory then do the copy
-        LPWSTR pwzLastSlash = NULL;
-        for (LPWSTR pwz = const_cast<LPWSTR>(wzTarget); *pwz; ++pwz)
-        {
-            if (*pwz == L'\\')
-            {
-                pwzLastSlash = pwz;
-            }
-        }
-
-        if (pwzLastSlash)
-        {
-            *pwzLastSlash = L'\0'; // null terminate
-            hr = DirEnsureExists(wzTarget, NULL);
-            *pwzLastSlash = L'\\'; // now put the slash back
-            FileExitOnFailureDebugTrace(hr, "failed to create directory while copying file: '%ls' to: '%ls'", wzSource, wzTarget);
-
-            // try to copy again
-            if (!::CopyFileW(wzSource, wzTarget, fOverwrite))
-            {
-                FileExitOnLastErrorDebugTrace(hr, "failed to copy file: '%ls' to: '%ls'", wzSource, wzTarget);
-            }
-        }
-        else // no path was specified so just return the error
-        {
-            hr = HRESULT_FROM_WIN32(er);
-        }
-    }
-    else // unexpected error
-    {
-        hr = HRESULT_FROM_WIN32(er);
-    }
-
-LExit:
-    return hr;
+    return EnsureCopy(wzSource, wzTarget, fOverwrite, NULL, NULL);
 }
 
 
@@ -1328,6 +1336,27 @@ extern "C" HRESULT DAPI FileEnsureCopyWithRetry(
     __in DWORD cRetry,
     __in DWORD dwWaitMilliseconds
     )
+{
+    return FileEnsureCopyWithRetryAndProgress(wzSource, wzTarget, fOverwrite, cRetry, dwWaitMilliseconds, NULL, NULL);
+}
+
+
+/*******************************************************************
+ FileEnsureCopyWithRetryAndProgress - like FileEnsureCopyWithRetry
+                                      but reports progress through
+                                      pfnProgress, which can cancel
+                                      the copy.
+
+*******************************************************************/
+extern "C" HRESULT DAPI FileEnsureCopyWithRetryAndProgress(
+    __in LPCWSTR wzSource,
+    __in LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in DWORD cRetry,
+    __in DWORD dwWaitMilliseconds,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    )
 {
     AssertSz(cRetry != DWORD_MAX, "Cannot pass DWORD_MAX for retry.");
 
@@ -1341,9 +1370,10 @@ extern "C" HRESULT DAPI FileEnsureCopyWithRetry(
             ::Sleep(dwWaitMilliseconds);
         }
 
-        hr = FileEnsureCopy(wzSource, wzTarget, fOverwrite);
+        hr = EnsureCopy(wzSource, wzTarget, fOverwrite, pfnProgress, pvContext);
         if (HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) == hr || HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND) == hr
-            || HRESULT_FROM_WIN32(ERROR_FILE_EXISTS) == hr || HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) == hr)
+            || HRESULT_FROM_WIN32(ERROR_FILE_EXISTS) == hr || HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS) == hr
+            || HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED) == hr)
         {
             break; // no reason to retry these errors.
         }
@@ -1356,95 +1386,154 @@ LExit:
 
 
 /*******************************************************************
- FileEnsureMove
+ FileEnsureClone - creates wzTarget sharing the data blocks of wzSource
+                   instead of copying them. Returns E_NOTIMPL when the
+                   files are not on one volume that supports block
+                   cloning, in which case the caller should copy.
 
 *******************************************************************/
-extern "C" HRESULT DAPI FileEnsureMove(
+extern "C" HRESULT DAPI FileEnsureClone(
     __in_z LPCWSTR wzSource,
-    __in_z LPCWSTR wzTarget,
-    __in BOOL fOverwrite,
-    __in BOOL fAllowCopy
+    __in_z LPCWSTR wzTarget
     )
 {
     HRESULT hr = S_OK;
-    DWORD er;
+    HANDLE hSource = INVALID_HANDLE_VALUE;
+    HANDLE hTarget = INVALID_HANDLE_VALUE;
+    BOOL fDeleteTarget = FALSE;
+    DWORD dwFileSystemFlags = 0;
+    DWORD cbReturned = 0;
+    BY_HANDLE_FILE_INFORMATION sourceInfo = { };
+    BY_HANDLE_FILE_INFORMATION targetInfo = { };
+    FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity = { };
+    FSCTL_SET_INTEGRITY_INFORMATION_BUFFER setIntegrity = { };
+    FILE_END_OF_FILE_INFO endOfFile = { };
+    FILE_BASIC_INFO basicInfo = { };
+    FILE_DISPOSITION_INFO disposition = { };
+    DUPLICATE_EXTENTS_DATA duplicate = { };
+    LONGLONG llFileSize = 0;
+    LONGLONG llClusterSize = 0;
+    LONGLONG llMaxChunk = 0;
 
-    DWORD dwFlags = 0;
+    hSource = ::CreateFileW(wzSource, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    FileExitOnInvalidHandleWithLastError(hSource, hr, "Failed to open file to clone: %ls", wzSource);
 
-    if (fOverwrite)
+    if (!::GetVolumeInformationByHandleW(hSource, NULL, 0, NULL, NULL, &dwFileSystemFlags, NULL, 0) ||
+        !(FILE_SUPPORTS_BLOCK_REFCOUNTING & dwFileSystemFlags))
     {
-        dwFlags |= MOVEFILE_REPLACE_EXISTING;
+        ExitFunction1(hr = E_NOTIMPL);
     }
-    if (fAllowCopy)
+
+    // The duplicate extents request works in whole clusters of the volume.
+    if (!::DeviceIoControl(hSource, FSCTL_GET_INTEGRITY_INFORMATION, NULL, 0, &integrity, sizeof(integrity), &cbReturned, NULL) || !integrity.ClusterSizeInBytes)
     {
-        dwFlags |= MOVEFILE_COPY_ALLOWED;
+        ExitFunction1(hr = E_NOTIMPL);
     }
 
-    // try to move the file first
-    if (::MoveFileExW(wzSource, wzTarget, dwFlags))
+    if (!::GetFileInformationByHandle(hSource, &sourceInfo))
     {
-        ExitFunction();  // we're done
+        FileExitWithLastError(hr, "Failed to get information for file to clone: %ls", wzSource);
     }
 
-    er = ::GetLastError();  // check the error and do the right thing below
-    if (!fOverwrite && (ERROR_FILE_EXISTS == er || ERROR_ALREADY_EXISTS == er))
+    hTarget = ::CreateFileW(wzTarget, GENERIC_READ | GENERIC_WRITE | DELETE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    FileExitOnInvalidHandleWithLastError(hTarget, hr, "Failed to create clone target: %ls", wzTarget);
+
+    fDeleteTarget = TRUE;
+
+    if (!::GetFileInformationByHandle(hTarget, &targetInfo))
     {
-        // if not overwriting this is an expected error
-        ExitFunction1(hr = S_FALSE);
+        FileExitWithLastError(hr, "Failed to get information for clone target: %ls", wzTarget);
     }
-    else if (ERROR_FILE_NOT_FOUND == er)
+
+    if (sourceInfo.dwVolumeSerialNumber != targetInfo.dwVolumeSerialNumber)
     {
-        // We are seeing some cases where ::MoveFileEx() says a file was not found
-        // but the source file is actually present. In that case, return path not
-        // found so we try to create the target path since that is most likely
-        // what is missing. Otherwise, the source file is missing and we're obviously
-        // not going to be recovering from that.
-        if (FileExistsEx(wzSource, NULL))
-        {
-            er = ERROR_PATH_NOT_FOUND;
-        }
+        ExitFunction1(hr = E_NOTIMPL);
     }
 
-    // If the path doesn't exist, try to create the directory tree then do the move.
-    if (ERROR_PATH_NOT_FOUND == er)
+    // The target must match the source's sparseness and integrity settings for the clone to succeed.
+    if (FILE_ATTRIBUTE_SPARSE_FILE & sourceInfo.dwFileAttributes)
     {
-        LPWSTR pwzLastSlash = NULL;
-        for (LPWSTR pwz = const_cast<LPWSTR>(wzTarget); *pwz; ++pwz)
+        if (!::DeviceIoControl(hTarget, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &cbReturned, NULL))
         {
-            if (*pwz == L'\\')
-            {
-                pwzLastSlash = pwz;
-            }
+            FileExitWithLastError(hr, "Failed to make clone target sparse: %ls", wzTarget);
         }
+    }
 
-        if (pwzLastSlash)
-        {
-            *pwzLastSlash = L'\0'; // null terminate
-            hr = DirEnsureExists(wzTarget, NULL);
-            *pwzLastSlash = L'\\'; // now put the slash back
-            FileExitOnFailureDebugTrace(hr, "failed to create directory while moving file: '%ls' to: '%ls'", wzSource, wzTarget);
+    setIntegrity.ChecksumAlgorithm = integrity.ChecksumAlgorithm;
+    setIntegrity.Flags = integrity.Flags;
 
-            // try to move again
-            if (!::MoveFileExW(wzSource, wzTarget, dwFlags))
-            {
-                FileExitOnLastErrorDebugTrace(hr, "failed to move file: '%ls' to: '%ls'", wzSource, wzTarget);
-            }
-        }
-        else // no path was specified so just return the error
+    if (!::DeviceIoControl(hTarget, FSCTL_SET_INTEGRITY_INFORMATION, &setIntegrity, sizeof(setIntegrity), NULL, 0, &cbReturned, NULL))
+    {
+        FileExitWithLastError(hr, "Failed to set integrity information on clone target: %ls", wzTarget);
+    }
+
+    llFileSize = (static_cast<LONGLONG>(sourceInfo.nFileSizeHigh) << 32) | sourceInfo.nFileSizeLow;
+    endOfFile.EndOfFile.QuadPart = llFileSize;
+
+    if (!::SetFileInformationByHandle(hTarget, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)))
+    {
+        FileExitWithLastError(hr, "Failed to size clone target: %ls", wzTarget);
+    }
+
+    llClusterSize = integrity.ClusterSizeInBytes;
+    llMaxChunk = FILE_CLONE_MAX_CHUNK / llClusterSize * llClusterSize;
+    duplicate.FileHandle = hSource;
+
+    for (LONGLONG llOffset = 0; llOffset < llFileSize; llOffset += llMaxChunk)
+    {
+        // The last chunk is rounded up to a whole cluster; the end of file set above still applies.
+        LONGLONG llChunk = (llFileSize - llOffset + llClusterSize - 1) / llClusterSize * llClusterSize;
+
+        duplicate.SourceFileOffset.QuadPart = llOffset;
+        duplicate.TargetFileOffset.QuadPart = llOffset;
+        duplicate.ByteCount.QuadPart = min(llChunk, llMaxChunk);
+
+        if (!::DeviceIoControl(hTarget, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &duplicate, sizeof(duplicate), NULL, 0, &cbReturned, NULL))
         {
-            hr = HRESULT_FROM_WIN32(er);
+            FileExitWithLastError(hr, "Failed to clone file: %ls to: %ls", wzSource, wzTarget);
         }
     }
-    else // unexpected error
+
+    // Carry the timestamps and attributes over like CopyFile() does. Best effort.
+    if (::GetFileInformationByHandleEx(hSource, FileBasicInfo, &basicInfo, sizeof(basicInfo)))
     {
-        hr = HRESULT_FROM_WIN32(er);
+        basicInfo.ChangeTime.QuadPart = 0;
+        basicInfo.FileAttributes &= FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED;
+
+        ::SetFileInformationByHandle(hTarget, FileBasicInfo, &basicInfo, sizeof(basicInfo));
     }
 
+    fDeleteTarget = FALSE;
+
 LExit:
+    if (fDeleteTarget)
+    {
+        disposition.DeleteFile = TRUE;
+        ::SetFileInformationByHandle(hTarget, FileDispositionInfo, &disposition, sizeof(disposition));
+    }
+
+    ReleaseFileHandle(hTarget);
+    ReleaseFileHandle(hSource);
+
     return hr;
 }
 
 
+/*******************************************************************
+ FileEnsureMove
+
+*******************************************************************/
+extern "C" HRESULT DAPI FileEnsureMove(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in BOOL fAllowCopy
+    )
+{
+    return EnsureMove(wzSource, wzTarget, fOverwrite, fAllowCopy, NULL, NULL);
+}
+
+
 /*******************************************************************
  FileEnsureMoveWithRetry
 
@@ -1457,6 +1546,28 @@ extern "C" HRESULT DAPI FileEnsureMoveWithRetry(
     __in DWORD cRetry,
     __in DWORD dwWaitMilliseconds
     )
+{
+    return FileEnsureMoveWithRetryAndProgress(wzSource, wzTarget, fOverwrite, fAllowCopy, cRetry, dwWaitMilliseconds, NULL, NULL);
+}
+
+
+/*******************************************************************
+ FileEnsureMoveWithRetryAndProgress - like FileEnsureMoveWithRetry but
+                                      reports progress through
+                                      pfnProgress when the move has to
+                                      copy across volumes.
+
+*******************************************************************/
+extern "C" HRESULT DAPI FileEnsureMoveWithRetryAndProgress(
+    __in LPCWSTR wzSource,
+    __in LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in BOOL fAllowCopy,
+    __in DWORD cRetry,
+    __in DWORD dwWaitMilliseconds,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    )
 {
     AssertSz(cRetry != DWORD_MAX, "Cannot pass DWORD_MAX for retry.");
 
@@ -1470,7 +1581,11 @@ extern "C" HRESULT DAPI FileEnsureMoveWithRetry(
             ::Sleep(dwWaitMilliseconds);
         }
 
-        hr = FileEnsureMove(wzSource, wzTarget, fOverwrite, fAllowCopy);
+        hr = EnsureMove(wzSource, wzTarget, fOverwrite, fAllowCopy, pfnProgress, pvContext);
+        if (HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED) == hr)
+        {
+            break; // canceled through the progress routine.
+        }
     }
     FileExitOnFailure(hr, "Failed to move file: '%ls' to: '%ls' after %u retries.", wzSource, wzTarget, i);
 
@@ -2030,3 +2145,155 @@ LExit:
 
     return hr;
 }
+
+
+// internal functions
+
+static HRESULT EnsureCopy(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er;
+
+    // try to copy the file first
+    if (::CopyFileExW(wzSource, wzTarget, pfnProgress, pvContext, NULL, fOverwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS))
+    {
+        ExitFunction();  // we're done
+    }
+
+    er = ::GetLastError();  // check the error and do the right thing below
+    if (!fOverwrite && (ERROR_FILE_EXISTS == er || ERROR_ALREADY_EXISTS == er))
+    {
+        // if not overwriting this is an expected error
+        ExitFunction1(hr = S_FALSE);
+    }
+    else if (ERROR_PATH_NOT_FOUND == er)  // if the path doesn't exist
+    {
+        // try to create the directory then do the copy
+        LPWSTR pwzLastSlash = NULL;
+        for (LPWSTR pwz = const_cast<LPWSTR>(wzTarget); *pwz; ++pwz)
+        {
+            if (*pwz == L'\\')
+            {
+                pwzLastSlash = pwz;
+            }
+        }
+
+        if (pwzLastSlash)
+        {
+            *pwzLastSlash = L'\0'; // null terminate
+            hr = DirEnsureExists(wzTarget, NULL);
+            *pwzLastSlash = L'\\'; // now put the slash back
+            FileExitOnFailureDebugTrace(hr, "failed to create directory while copying file: '%ls' to: '%ls'", wzSource, wzTarget);
+
+            // try to copy again
+            if (!::CopyFileExW(wzSource, wzTarget, pfnProgress, pvContext, NULL, fOverwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS))
+            {
+                FileExitOnLastErrorDebugTrace(hr, "failed to copy file: '%ls' to: '%ls'", wzSource, wzTarget);
+            }
+        }
+        else // no path was specified so just return the error
+        {
+            hr = HRESULT_FROM_WIN32(er);
+        }
+    }
+    else // unexpected error
+    {
+        hr = HRESULT_FROM_WIN32(er);
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT EnsureMove(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in BOOL fAllowCopy,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er;
+
+    DWORD dwFlags = 0;
+
+    if (fOverwrite)
+    {
+        dwFlags |= MOVEFILE_REPLACE_EXISTING;
+    }
+    if (fAllowCopy)
+    {
+        dwFlags |= MOVEFILE_COPY_ALLOWED;
+    }
+
+    // try to move the file first
+    if (::MoveFileWithProgressW(wzSource, wzTarget, pfnProgress, pvContext, dwFlags))
+    {
+        ExitFunction();  // we're done
+    }
+
+    er = ::GetLastError();  // check the error and do the right thing below
+    if (!fOverwrite && (ERROR_FILE_EXISTS == er || ERROR_ALREADY_EXISTS == er))
+    {
+        // if not overwriting this is an expected error
+        ExitFunction1(hr = S_FALSE);
+    }
+    else if (ERROR_FILE_NOT_FOUND == er)
+    {
+        // We are seeing some cases where ::MoveFileEx() says a file was not found
+        // but the source file is actually present. In that case, return path not
+        // found so we try to create the target path since that is most likely
+        // what is missing. Otherwise, the source file is missing and we're obviously
+        // not going to be recovering from that.
+        if (FileExistsEx(wzSource, NULL))
+        {
+            er = ERROR_PATH_NOT_FOUND;
+        }
+    }
+
+    // If the path doesn't exist, try to create the directory tree then do the move.
+    if (ERROR_PATH_NOT_FOUND == er)
+    {
+        LPWSTR pwzLastSlash = NULL;
+        for (LPWSTR pwz = const_cast<LPWSTR>(wzTarget); *pwz; ++pwz)
+        {
+            if (*pwz == L'\\')
+            {
+                pwzLastSlash = pwz;
+            }
+        }
+
+        if (pwzLastSlash)
+        {
+            *pwzLastSlash = L'\0'; // null terminate
+            hr = DirEnsureExists(wzTarget, NULL);
+            *pwzLastSlash = L'\\'; // now put the slash back
+            FileExitOnFailureDebugTrace(hr, "failed to create directory while moving file: '%ls' to: '%ls'", wzSource, wzTarget);
+
+            // try to move again
+            if (!::MoveFileWithProgressW(wzSource, wzTarget, pfnProgress, pvContext, dwFlags))
+            {
+                FileExitOnLastErrorDebugTrace(hr, "failed to move file: '%ls' to: '%ls'", wzSource, wzTarget);
+            }
+        }
+        else // no path was specified so just return the error
+        {
+            hr = HRESULT_FROM_WIN32(er);
+        }
+    }
+    else // unexpected error
+    {
+        hr = HRESULT_FROM_WIN32(er);
+    }
+
+LExit:
+    return hr;
+}
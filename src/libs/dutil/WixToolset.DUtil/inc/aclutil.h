@@ -33,6 +33,13 @@ struct ACL_ACE
     PSID psid;
 };
 
+// callbacks
+typedef HRESULT(CALLBACK *PFN_ACLPROPAGATIONPROGRESS)(
+    __in DWORD cCompleted,
+    __in DWORD cTotal,
+    __in_opt LPVOID pvContext
+    );
+
 
 // functions
 HRESULT DAPI AclCheckAccess(
@@ -121,6 +128,14 @@ HRESULT DAPI AclSetSecurityWithRetry(
     __in DWORD cRetry,
     __in DWORD dwWaitMilliseconds
     );
+HRESULT DAPI AclPropagateInheritance(
+    __in_z LPCWSTR wzFolder,
+    __in DWORD cMaxThreads,
+    __in DWORD dwProgressInterval,
+    __in_opt PFN_ACLPROPAGATIONPROGRESS pfnProgress,
+    __in_opt LPVOID pvContext,
+    __deref_opt_out_z_opt LPWSTR* psczFailedPath
+    );
 
 HRESULT DAPI AclFreeSid(
     __in PSID psid
@@ -72,6 +72,20 @@ HRESULT DAPI ApupAllocChainFromAtom(
     __out APPLICATION_UPDATE_CHAIN** ppChain
     );
 
+/********************************************************************
+ ApupAllocChainFromFile - streams an ATOM feed from disk and returns the
+    chain of application updates without building a DOM of the feed.
+    When pMinimumVersion is provided only entries with a version greater
+    than it are materialized; older entries are skipped as soon as their
+    version is read.
+
+********************************************************************/
+HRESULT DAPI ApupAllocChainFromFile(
+    __in_z LPCWSTR wzFeedFile,
+    __in_opt VERUTIL_VERSION* pMinimumVersion,
+    __out APPLICATION_UPDATE_CHAIN** ppChain
+    );
+
 HRESULT DAPI ApupFilterChain(
     __in APPLICATION_UPDATE_CHAIN* pChain,
     __in VERUTIL_VERSION* pVersion,
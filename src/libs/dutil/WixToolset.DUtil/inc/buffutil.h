@@ -12,6 +12,17 @@ extern "C" {
 #define ReleaseBuffer ReleaseMem
 #define ReleaseNullBuffer ReleaseNullMem
 #define BuffFree MemFree
+#define ReleaseBuffWriter(w) { ReleaseNullMem((w).pbData); (w).cbData = 0; (w).cbAllocated = 0; }
+
+
+// structs
+
+typedef struct _BUFF_WRITER
+{
+    BYTE* pbData;
+    SIZE_T cbData;
+    SIZE_T cbAllocated;
+} BUFF_WRITER;
 
 
 // function declarations
@@ -86,6 +97,41 @@ HRESULT BuffWriteStream(
     __in SIZE_T cbStream
     );
 
+HRESULT BuffWriterReserve(
+    __in BUFF_WRITER* pWriter,
+    __in SIZE_T cbAdditional
+    );
+HRESULT BuffWriterWriteNumber(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD dw
+    );
+HRESULT BuffWriterWriteNumber64(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD64 dw64
+    );
+HRESULT BuffWriterWritePointer(
+    __in BUFF_WRITER* pWriter,
+    __in DWORD_PTR dw
+    );
+HRESULT BuffWriterWriteString(
+    __in BUFF_WRITER* pWriter,
+    __in_z_opt LPCWSTR scz
+    );
+HRESULT BuffWriterWriteStrings(
+    __in BUFF_WRITER* pWriter,
+    __in_ecount(cStrings) LPCWSTR* rgsz,
+    __in DWORD cStrings
+    );
+HRESULT BuffWriterWriteStringAnsi(
+    __in BUFF_WRITER* pWriter,
+    __in_z_opt LPCSTR scz
+    );
+HRESULT BuffWriterWriteStream(
+    __in BUFF_WRITER* pWriter,
+    __in_bcount(cbStream) const BYTE* pbStream,
+    __in SIZE_T cbStream
+    );
+
 #ifdef __cplusplus
 }
 #endif
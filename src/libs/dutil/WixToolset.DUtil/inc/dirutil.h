@@ -9,6 +9,23 @@ typedef enum DIR_DELETE
     DIR_DELETE_SCHEDULE = 4,
 } DIR_DELETE;
 
+typedef struct _DIR_DELETE_TREE_RESULTS
+{
+    DWORD cDirectories;     // directories found under and including the root.
+    DWORD cDeleted;         // files and directories removed.
+    DWORD cRebootRequired;  // files and directories in use, scheduled for removal on reboot.
+    DWORD cSkipped;         // files and directories that could be neither removed nor scheduled.
+    DWORD cThreads;         // workers that shared the walk.
+} DIR_DELETE_TREE_RESULTS;
+
+// Called on the thread that called DirDeleteTree while the workers run.
+// Returning a failure stops the delete and DirDeleteTree returns it.
+typedef HRESULT(CALLBACK *PFN_DIR_DELETE_TREE_PROGRESS)(
+    __in DWORD cScanned,
+    __in DWORD cDirectories,
+    __in_opt LPVOID pvContext
+    );
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -40,6 +57,20 @@ HRESULT DAPI DirEnsureDeleteEx(
     __in DWORD dwFlags
     );
 
+HRESULT DAPI DirDeleteTree(
+    __in_z LPCWSTR wzPath,
+    __in DWORD cThreads,
+    __in_opt PFN_DIR_DELETE_TREE_PROGRESS pfnProgress,
+    __in_opt LPVOID pvContext,
+    __out_opt DIR_DELETE_TREE_RESULTS* pResults
+    );
+
+HRESULT DAPI DirMoveTree(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget,
+    __in BOOL fReplaceExisting
+    );
+
 DWORD DAPI DirDeleteEmptyDirectoriesToRoot(
     __in_z LPCWSTR wzPath,
     __in DWORD dwFlags
@@ -53,6 +53,23 @@ HRESULT DAPI DownloadUrl(
     __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate
     );
 
+/********************************************************************
+ DownloadUrlIfModified - downloads the URL with a single conditional GET.
+
+ NOTE: returns S_FALSE without touching the destination when the server
+       reports the resource has not changed since wzETag or wzLastModified.
+********************************************************************/
+HRESULT DAPI DownloadUrlIfModified(
+    __in DOWNLOAD_SOURCE* pDownloadSource,
+    __in LPCWSTR wzDestinationPath,
+    __in_z_opt LPCWSTR wzETag,
+    __in_z_opt LPCWSTR wzLastModified,
+    __in_opt DOWNLOAD_CACHE_CALLBACK* pCache,
+    __in_opt DOWNLOAD_AUTHENTICATION_CALLBACK* pAuthenticate,
+    __deref_opt_out_z_opt LPWSTR* psczETag,
+    __deref_opt_out_z_opt LPWSTR* psczLastModified
+    );
+
 
 #ifdef __cplusplus
 }
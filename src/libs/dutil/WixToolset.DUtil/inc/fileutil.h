@@ -172,6 +172,19 @@ HRESULT DAPI FileEnsureCopyWithRetry(
     __in DWORD cRetry,
     __in DWORD dwWaitMilliseconds
     );
+HRESULT DAPI FileEnsureCopyWithRetryAndProgress(
+    __in LPCWSTR wzSource,
+    __in LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in DWORD cRetry,
+    __in DWORD dwWaitMilliseconds,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    );
+HRESULT DAPI FileEnsureClone(
+    __in_z LPCWSTR wzSource,
+    __in_z LPCWSTR wzTarget
+    );
 HRESULT DAPI FileEnsureMove(
     __in_z LPCWSTR wzSource, 
     __in_z LPCWSTR wzTarget, 
@@ -186,6 +199,16 @@ HRESULT DAPI FileEnsureMoveWithRetry(
     __in DWORD cRetry,
     __in DWORD dwWaitMilliseconds
     );
+HRESULT DAPI FileEnsureMoveWithRetryAndProgress(
+    __in LPCWSTR wzSource,
+    __in LPCWSTR wzTarget,
+    __in BOOL fOverwrite,
+    __in BOOL fAllowCopy,
+    __in DWORD cRetry,
+    __in DWORD dwWaitMilliseconds,
+    __in_opt LPPROGRESS_ROUTINE pfnProgress,
+    __in_opt LPVOID pvContext
+    );
 HRESULT DAPI FileCreateTemp(
     __in_z LPCWSTR wzPrefix,
     __in_z LPCWSTR wzExtension,
@@ -46,6 +46,8 @@ HRESULT DAPI IniSetCommentStyle(
     __inout_bcount(INI_HANDLE_BYTES) INI_HANDLE piHandle,
     __in_z_opt LPCWSTR wzLinePrefix
     );
+// Parsing again replaces the values from the previous parse, and drops any
+// changes that were not written
 HRESULT DAPI IniParse(
     __inout_bcount(INI_HANDLE_BYTES) INI_HANDLE piHandle,
     __in LPCWSTR wzPath,
@@ -19,8 +19,25 @@ typedef enum JSON_TOKEN
     JSON_TOKEN_VALUE,
 } JSON_TOKEN;
 
+typedef enum JSON_VALUE_TYPE
+{
+    JSON_VALUE_TYPE_NONE,
+    JSON_VALUE_TYPE_STRING,
+    JSON_VALUE_TYPE_NUMBER,
+    JSON_VALUE_TYPE_TRUE,
+    JSON_VALUE_TYPE_FALSE,
+    JSON_VALUE_TYPE_NULL,
+} JSON_VALUE_TYPE;
+
+// A value returned by the reader. wzValue points into the reader's source
+// buffer and is not null terminated. String values exclude the quotes and are
+// still escaped when fEscaped is set; use JsonUnescapeString to decode them.
 typedef struct _JSON_VALUE
 {
+    JSON_VALUE_TYPE type;
+    LPCWSTR wzValue;
+    DWORD cchValue;
+    BOOL fEscaped;
 } JSON_VALUE;
 
 typedef struct _JSON_READER
@@ -28,14 +45,21 @@ typedef struct _JSON_READER
     CRITICAL_SECTION cs;
     LPWSTR sczJson;
 
-    LPWSTR pwz;
+    LPCWSTR pwz;
+    LPCWSTR pwzEnd;
     JSON_TOKEN token;
+
+    JSON_TOKEN* rgTokenStack;
+    DWORD cTokens;
+    DWORD cMaxTokens;
 } JSON_READER;
 
 typedef struct _JSON_WRITER
 {
     CRITICAL_SECTION cs;
     LPWSTR sczJson;
+    DWORD cchJson;
+    DWORD cchJsonAlloc;
 
     JSON_TOKEN* rgTokenStack;
     DWORD cTokens;
@@ -48,6 +72,18 @@ DAPI_(HRESULT) JsonInitializeReader(
     __in JSON_READER* pReader
     );
 
+/********************************************************************
+ JsonInitializeReaderFromBuffer - initializes a reader over a caller-owned
+   buffer without copying it. The buffer must outlive the reader and every
+   JSON_VALUE returned from it.
+
+********************************************************************/
+DAPI_(HRESULT) JsonInitializeReaderFromBuffer(
+    __in_ecount(cchJson) LPCWSTR wzJson,
+    __in SIZE_T cchJson,
+    __in JSON_READER* pReader
+    );
+
 DAPI_(void) JsonUninitializeReader(
     __in JSON_READER* pReader
     );
@@ -63,6 +99,16 @@ DAPI_(HRESULT) JsonReadValue(
     __in JSON_VALUE* pValue
     );
 
+/********************************************************************
+ JsonUnescapeString - decodes an escaped string value returned by the
+   reader.
+
+********************************************************************/
+DAPI_(HRESULT) JsonUnescapeString(
+    __in const JSON_VALUE* pValue,
+    __deref_out_z LPWSTR* psczValue
+    );
+
 DAPI_(HRESULT) JsonInitializeWriter(
     __in JSON_WRITER* pWriter
     );
@@ -71,6 +117,25 @@ DAPI_(void) JsonUninitializeWriter(
     __in JSON_WRITER* pWriter
     );
 
+/********************************************************************
+ JsonReserveWriter - ensures the writer can hold at least cchReserve
+   characters without growing.
+
+********************************************************************/
+DAPI_(HRESULT) JsonReserveWriter(
+    __in JSON_WRITER* pWriter,
+    __in DWORD cchReserve
+    );
+
+/********************************************************************
+ JsonResetWriter - clears the written JSON but keeps the buffer so the
+   writer can be reused for the next document without allocating.
+
+********************************************************************/
+DAPI_(void) JsonResetWriter(
+    __in JSON_WRITER* pWriter
+    );
+
 DAPI_(HRESULT) JsonWriteBool(
     __in JSON_WRITER* pWriter,
     __in BOOL fValue
@@ -81,6 +146,15 @@ DAPI_(HRESULT) JsonWriteNumber(
     __in DWORD dwValue
     );
 
+DAPI_(HRESULT) JsonWriteNumber64(
+    __in JSON_WRITER* pWriter,
+    __in DWORD64 qwValue
+    );
+
+DAPI_(HRESULT) JsonWriteNull(
+    __in JSON_WRITER* pWriter
+    );
+
 DAPI_(HRESULT) JsonWriteString(
     __in JSON_WRITER* pWriter,
     __in_z LPCWSTR wzValue
@@ -6,6 +6,12 @@
 extern "C" {
 #endif
 
+#define ReleaseProcSnapshot(ph) if (ph) { ProcSnapshotUninitialize(ph); }
+#define ReleaseNullProcSnapshot(ph) if (ph) { ProcSnapshotUninitialize(ph); ph = NULL; }
+
+typedef void* PROC_SNAPSHOT_HANDLE;
+typedef const void* C_PROC_SNAPSHOT_HANDLE;
+
 // structs
 typedef struct _PROC_FILESYSTEMREDIRECTION
 {
@@ -62,6 +68,21 @@ HRESULT DAPI ProcFindAllIdsFromExeName(
     __out DWORD** ppdwProcessIds,
     __out DWORD* pcProcessIds
     );
+HRESULT DAPI ProcSnapshotCreate(
+    __out PROC_SNAPSHOT_HANDLE* phSnapshot
+    );
+HRESULT DAPI ProcSnapshotFindIds(
+    __in C_PROC_SNAPSHOT_HANDLE hSnapshot,
+    __in_z LPCWSTR wzExeName,
+    __out_ecount(*pcProcessIds) const DWORD** prgdwProcessIds,
+    __out DWORD* pcProcessIds
+    );
+DWORD DAPI ProcSnapshotGetProcessCount(
+    __in C_PROC_SNAPSHOT_HANDLE hSnapshot
+    );
+void DAPI ProcSnapshotUninitialize(
+    __in PROC_SNAPSHOT_HANDLE hSnapshot
+    );
 
 // following code in proc3utl.cpp due to dependency on Wtsapi32.DLL.
 HRESULT DAPI ProcExecuteAsInteractiveUser(
@@ -145,6 +145,12 @@ HRESULT DAPI RegKeyEnum(
     __in DWORD dwIndex,
     __deref_out_z LPWSTR* psczKey
     );
+HRESULT DAPI RegKeyEnumEx(
+    __in HKEY hk,
+    __in DWORD dwIndex,
+    __deref_out_z LPWSTR* psczKey,
+    __out_opt FILETIME* pftLastWrite
+    );
 HRESULT DAPI RegValueEnum(
     __in HKEY hk,
     __in DWORD dwIndex,
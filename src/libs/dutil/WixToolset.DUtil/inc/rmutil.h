@@ -28,6 +28,12 @@ HRESULT DAPI RmuAddProcessesByName(
     __in_z LPCWSTR wzProcessName
     );
 
+HRESULT DAPI RmuAddProcessesByIds(
+    __in PRMU_SESSION pSession,
+    __in_ecount(cProcessIds) const DWORD* rgdwProcessIds,
+    __in DWORD cProcessIds
+    );
+
 HRESULT DAPI RmuAddService(
     __in PRMU_SESSION pSession,
     __in_z LPCWSTR wzServiceName
@@ -17,6 +17,13 @@ extern "C" {
 #define DeclareConstBSTR(bstr_const, wz) const WCHAR bstr_const[] = { 0x00, 0x00, sizeof(wz)-sizeof(WCHAR), 0x00, wz }
 #define UseConstBSTR(bstr_const) const_cast<BSTR>(bstr_const + 4)
 
+typedef enum _STR_CODEC_ISA
+{
+    STR_CODEC_ISA_SCALAR,
+    STR_CODEC_ISA_SSE2,
+    STR_CODEC_ISA_AVX2,
+} STR_CODEC_ISA;
+
 HRESULT DAPI StrAlloc(
     __deref_out_ecount_part(cch, 0) LPWSTR* ppwz,
     __in SIZE_T cch
@@ -163,6 +170,10 @@ HRESULT DAPI StrReplaceString(
     __in_z LPCWSTR wzNewSubString
     );
 
+STR_CODEC_ISA DAPI StrCodecSetMaximumIsa(
+    __in STR_CODEC_ISA isa
+    );
+
 HRESULT DAPI StrHexEncode(
     __in_ecount(cbSource) const BYTE* pbSource,
     __in SIZE_T cbSource,
@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #define ReleaseVerutilVersion(p) if (p) { VerFreeVersion(p); p = NULL; }
+#define ReleaseVerutilVersionPool(p) VerFreeVersionPool(&p)
 
 typedef struct _VERUTIL_VERSION_RELEASE_LABEL
 {
@@ -29,6 +30,33 @@ typedef struct _VERUTIL_VERSION
     BOOL fInvalid;
 } VERUTIL_VERSION;
 
+// A version packed into a VERUTIL_VERSION_POOL. The version string and release
+// labels live in the pool so comparing packed versions never allocates.
+typedef struct _VERUTIL_PACKED_VERSION
+{
+    DWORD dwMajor;
+    DWORD dwMinor;
+    DWORD dwPatch;
+    DWORD dwRevision;
+    DWORD iReleaseLabel;
+    DWORD cReleaseLabels;
+    SIZE_T cchVersionOffset;
+    SIZE_T cchMetadataOffset;
+    BOOL fInvalid;
+} VERUTIL_PACKED_VERSION;
+
+typedef struct _VERUTIL_VERSION_POOL
+{
+    VERUTIL_PACKED_VERSION* rgVersions;
+    DWORD cVersions;
+
+    VERUTIL_VERSION_RELEASE_LABEL* rgReleaseLabels;
+    DWORD cReleaseLabels;
+
+    LPWSTR wzStrings;
+    DWORD cchStrings;
+} VERUTIL_VERSION_POOL;
+
 /*******************************************************************
  VerCompareParsedVersions - compares the Verutil versions.
 
@@ -88,6 +116,71 @@ HRESULT DAPI VerVersionFromQword(
     __out VERUTIL_VERSION** ppVersion
     );
 
+/*******************************************************************
+ VerSortVersions - sorts an array of Verutil versions in ascending order.
+                   NULL entries sort before all other versions.
+
+*******************************************************************/
+HRESULT DAPI VerSortVersions(
+    __in_ecount(cVersions) VERUTIL_VERSION** rgpVersions,
+    __in DWORD cVersions
+    );
+
+/*******************************************************************
+ VerPoolAddVersion - parses the string into a packed version in the pool.
+                     Returns the index of the packed version.
+
+*******************************************************************/
+HRESULT DAPI VerPoolAddVersion(
+    __in VERUTIL_VERSION_POOL* pPool,
+    __in_z LPCWSTR wzVersion,
+    __in SIZE_T cchVersion,
+    __in BOOL fStrict,
+    __out_opt DWORD* pdwIndex
+    );
+
+/*******************************************************************
+ VerPoolCompareVersions - compares two packed versions in the pool
+                          without allocating.
+
+*******************************************************************/
+HRESULT DAPI VerPoolCompareVersions(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex1,
+    __in DWORD dwIndex2,
+    __out int* pnResult
+    );
+
+/*******************************************************************
+ VerPoolGetVersionString - gets the version string of a packed version.
+                           The string is owned by the pool.
+
+*******************************************************************/
+HRESULT DAPI VerPoolGetVersionString(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex,
+    __out_z LPCWSTR* pwzVersion
+    );
+
+/*******************************************************************
+ VerPoolSortVersions - sorts the indices of packed versions in ascending
+                       version order.
+
+*******************************************************************/
+HRESULT DAPI VerPoolSortVersions(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __inout_ecount(cIndices) DWORD* rgdwIndices,
+    __in DWORD cIndices
+    );
+
+/*******************************************************************
+ VerFreeVersionPool - frees any memory associated with a version pool.
+
+*******************************************************************/
+void DAPI VerFreeVersionPool(
+    __in VERUTIL_VERSION_POOL* pPool
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,6 +11,10 @@ extern "C" {
 #define IDNOACTION 0
 #define WIU_MB_OKIGNORECANCELRETRY 0xE
 
+// Minimum number of milliseconds between progress or action data messages
+// delivered to the execute message handler.
+#define WIU_MSI_EXECUTE_RELAY_INTERVAL 50
+
 #define MAX_DARWIN_KEY 73
 #define MAX_DARWIN_COLUMN 255
 
@@ -107,6 +111,20 @@ typedef struct _WIU_MSI_EXECUTE_CONTEXT
 
     BOOL fSetPreviousExternalUIRecord;
     BOOL fSetPreviousExternalUI;
+
+    DWORD dwLastProgressTick;
+    DWORD dwLastActionDataTick;
+    BOOL fPendingProgress;
+    DWORD dwPendingPercentage;
+    BOOL fPendingActionData;
+    UINT uiPendingActionDataFlags;
+    LPWSTR sczPendingActionData;
+    LPWSTR* rgsczPendingActionData;
+    DWORD cPendingActionData;
+
+    DWORD cDeliveredMessages;
+    DWORD cCoalescedProgress;
+    DWORD cCoalescedActionData;
 } WIU_MSI_EXECUTE_CONTEXT;
 
 
@@ -212,6 +230,18 @@ typedef UINT (WINAPI *PFN_MSIENUMPRODUCTSEXW)(
     __inout_opt LPDWORD pcchSid
     );
 
+typedef UINT (WINAPI *PFN_MSIENUMPATCHESEXW)(
+    __in_z_opt LPCWSTR szProductCode,
+    __in_z_opt LPCWSTR szUserSid,
+    __in DWORD dwContext,
+    __in DWORD dwFilter,
+    __in DWORD dwIndex,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR szPatchCode,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR szTargetProductCode,
+    __out_opt MSIINSTALLCONTEXT* pdwTargetProductContext,
+    __out_ecount_opt(*pcchTargetUserSid) LPWSTR szTargetUserSid,
+    __inout_opt LPDWORD pcchTargetUserSid
+    );
 typedef UINT (WINAPI *PFN_MSIENUMRELATEDPRODUCTSW)(
     __in LPCWSTR lpUpgradeCode,
     __reserved DWORD dwReserved,
@@ -328,6 +358,18 @@ HRESULT DAPI WiuEnumRelatedProducts(
     __in DWORD iProductIndex,
     __out_ecount(MAX_GUID_CHARS + 1) LPWSTR wzProductCode
     );
+HRESULT DAPI WiuEnumPatchesEx(
+    __in_z_opt LPCWSTR wzProductCode,
+    __in_z_opt LPCWSTR wzUserSid,
+    __in DWORD dwContext,
+    __in DWORD dwFilter,
+    __in DWORD dwIndex,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR wzPatchCode,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR wzTargetProductCode,
+    __out_opt MSIINSTALLCONTEXT* pdwTargetProductContext
+    );
+DWORD DAPI WiuGetQueryCount(
+    );
 HRESULT DAPI WiuEnumRelatedProductCodes(
     __in_z LPCWSTR wzUpgradeCode,
     __deref_out_ecount_opt(*pcRelatedProducts) LPWSTR** prgsczProductCodes,
@@ -352,6 +394,9 @@ HRESULT DAPI WiuInitializeExternalUI(
     __in BOOL fRollback,
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     );
+INT DAPI WiuFlushExternalUI(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
+    );
 void DAPI WiuUninitializeExternalUI(
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     );
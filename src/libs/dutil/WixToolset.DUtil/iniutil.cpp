@@ -18,6 +18,46 @@
 #define IniExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_INIUTIL, g, x, s, __VA_ARGS__)
 
 const LPCWSTR wzSectionSeparator = L"\\";
+const BYTE UTF8BOM[] = {0xEF, 0xBB, 0xBF};
+const BYTE UTF16BOM[] = {0xFF, 0xFE};
+
+// The global section holds values that appear before any section tag (or all values when sections aren't used).
+const DWORD INI_GLOBAL_SECTION = 0;
+
+enum INI_LINE_TYPE
+{
+    INI_LINE_OTHER,
+    INI_LINE_SECTION,
+    INI_LINE_VALUE,
+};
+
+struct INI_SECTION
+{
+    LPWSTR sczPrefix; // section name followed by the section separator, NULL for the global section
+
+    BOOL fFromFile;
+    SIZE_T iInsertAt; // offset into the parsed contents where values added to this section are written
+
+    DWORD dwFirstAdded; // values added since parsing, linked through INI_VALUE_SPAN::dwNextAdded
+    DWORD dwLastAdded;
+};
+
+// Tracks where each value in rgivValues lives in the parsed contents so edits can be patched in place.
+struct INI_VALUE_SPAN
+{
+    DWORD dwSection;
+    DWORD dwNextAdded;
+
+    BOOL fFromFile;
+    SIZE_T iLineStart; // includes the line ending
+    SIZE_T iLineEnd;
+    SIZE_T iValueStart; // the trimmed value text
+    SIZE_T cchValue;
+
+    BOOL fValueModified;
+    BOOL fNameAllocated; // names and values read from the file live in sczPool
+    BOOL fValueAllocated;
+};
 
 struct INI_STRUCT
 {
@@ -34,11 +74,19 @@ struct INI_STRUCT
 
     LPWSTR sczCommentLinePrefix; // for regular ini, this would be ';'
 
+    LPWSTR sczContents; // the decoded file, left untouched so unmodified lines are written back verbatim
+    SIZE_T cchContents;
+
+    LPWSTR sczPool; // names and values read from the file
+
     INI_VALUE *rgivValues;
+    INI_VALUE_SPAN *rgSpans; // parallel to rgivValues
     DWORD cValues;
+    STRINGDICT_HANDLE shValues; // name -> INI_VALUE
 
-    LPWSTR *rgsczLines;
-    DWORD cLines;
+    INI_SECTION *rgSections;
+    DWORD cSections;
+    STRINGDICT_HANDLE shSections; // prefix -> INI_SECTION, excludes the global section
 
     FILE_ENCODING feEncoding;
     BOOL fModified;
@@ -46,12 +94,62 @@ struct INI_STRUCT
 
 const int INI_HANDLE_BYTES = sizeof(INI_STRUCT);
 
+static HRESULT ResetContents(
+    __in INI_STRUCT* pi
+    );
+static HRESULT ReadContents(
+    __in INI_STRUCT* pi
+    );
+static HRESULT ParseContents(
+    __in INI_STRUCT* pi
+    );
+static INI_LINE_TYPE ClassifyLine(
+    __in INI_STRUCT* pi,
+    __in_z LPCWSTR wzLine,
+    __out LPCWSTR* pwzNameStart,
+    __out LPCWSTR* pwzNameEnd,
+    __out LPCWSTR* pwzValueStart
+    );
+static void TrimSpan(
+    __inout LPCWSTR* pwzStart,
+    __inout LPCWSTR* pwzEnd
+    );
+static HRESULT FindOrAddSection(
+    __in INI_STRUCT* pi,
+    __in_z LPCWSTR wzPrefix,
+    __out DWORD* pdwSection
+    );
+static HRESULT AddValue(
+    __in INI_STRUCT* pi,
+    __out DWORD* pdwIndex
+    );
+static HRESULT AppendToBuffer(
+    __deref_inout_ecount(*pcchBuffer) LPWSTR* psczBuffer,
+    __inout SIZE_T* pcchBuffer,
+    __inout SIZE_T* pcchUsed,
+    __in_ecount(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    );
+static HRESULT AppendAddedValues(
+    __in INI_STRUCT* pi,
+    __in DWORD dwSection,
+    __in BOOL fSections,
+    __in BOOL fWriteSectionTag,
+    __deref_inout_ecount(*pcchBuffer) LPWSTR* psczBuffer,
+    __inout SIZE_T* pcchBuffer,
+    __inout SIZE_T* pcchUsed
+    );
+static BOOL SectionHasAddedValues(
+    __in INI_STRUCT* pi,
+    __in DWORD dwSection
+    );
 static HRESULT GetSectionPrefixFromName(
     __in_z LPCWSTR wzName,
     __deref_inout_z LPWSTR* psczOutput
     );
 static void UninitializeIniValue(
-    INI_VALUE *pivValue
+    INI_VALUE *pivValue,
+    INI_VALUE_SPAN *pSpan
     );
 
 extern "C" HRESULT DAPI IniInitialize(
@@ -59,12 +157,27 @@ extern "C" HRESULT DAPI IniInitialize(
     )
 {
     HRESULT hr = S_OK;
+    INI_STRUCT *pi = NULL;
 
     // Allocate the handle
-    *piHandle = static_cast<INI_HANDLE>(MemAlloc(sizeof(INI_STRUCT), TRUE));
-    IniExitOnNull(*piHandle, hr, E_OUTOFMEMORY, "Failed to allocate ini object");
+    pi = static_cast<INI_STRUCT *>(MemAlloc(sizeof(INI_STRUCT), TRUE));
+    IniExitOnNull(pi, hr, E_OUTOFMEMORY, "Failed to allocate ini object");
+
+    hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgSections), 1, sizeof(INI_SECTION), 10);
+    IniExitOnFailure(hr, "Failed to allocate ini section array");
+
+    hr = ResetContents(pi);
+    IniExitOnFailure(hr, "Failed to initialize ini struct");
+
+    *piHandle = pi;
+    pi = NULL;
 
 LExit:
+    if (pi)
+    {
+        IniUninitialize(pi);
+    }
+
     return hr;
 }
 
@@ -82,22 +195,33 @@ extern "C" void DAPI IniUninitialize(
 
     for (DWORD i = 0; i < pi->cValueSeparatorExceptions; ++i)
     {
-        ReleaseStr(pi->rgsczValueSeparatorExceptions + i);
+        ReleaseStr(pi->rgsczValueSeparatorExceptions[i]);
     }
+    ReleaseMem(pi->rgsczValueSeparatorExceptions);
 
     ReleaseStr(pi->sczCommentLinePrefix);
 
+    ReleaseDict(pi->shValues);
+    ReleaseDict(pi->shSections);
+
     for (DWORD i = 0; i < pi->cValues; ++i)
     {
-        UninitializeIniValue(pi->rgivValues + i);
+        UninitializeIniValue(pi->rgivValues + i, pi->rgSpans + i);
     }
     ReleaseMem(pi->rgivValues);
+    ReleaseMem(pi->rgSpans);
 
-    ReleaseStrArray(pi->rgsczLines, pi->cLines);
+    for (DWORD i = 0; i < pi->cSections; ++i)
+    {
+        ReleaseStr(pi->rgSections[i].sczPrefix);
+    }
+    ReleaseMem(pi->rgSections);
+
+    ReleaseStr(pi->sczPool);
+    ReleaseStr(pi->sczContents);
 
     ReleaseMem(pi);
 }
-
 extern "C" HRESULT DAPI IniSetOpenTag(
     __inout_bcount(INI_HANDLE_BYTES) INI_HANDLE piHandle,
     __in_z_opt LPCWSTR wzOpenTagPrefix,
@@ -218,195 +342,34 @@ extern "C" HRESULT DAPI IniParse(
     )
 {
     HRESULT hr = S_OK;
-    DWORD dwValuePrefixLength = 0;
-    DWORD dwValueSeparatorExceptionLength = 0;
-    LPWSTR sczContents = NULL;
-    LPWSTR sczCurrentSection = NULL;
-    LPWSTR sczName = NULL;
-    LPWSTR sczNameTrimmed = NULL;
-    LPWSTR sczValue = NULL;
-    LPWSTR sczValueTrimmed = NULL;
-    LPWSTR wzOpenTagPrefix = NULL;
-    LPWSTR wzOpenTagPostfix = NULL;
-    LPWSTR wzValuePrefix = NULL;
-    LPWSTR wzValueNameStart = NULL;
-    LPWSTR wzValueSeparator = NULL;
-    LPWSTR wzCommentLinePrefix = NULL;
-    LPWSTR wzValueBegin = NULL;
-    LPCWSTR wzTemp = NULL;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
 
-    BOOL fSections = (NULL != pi->sczOpenTagPrefix) && (NULL != pi->sczOpenTagPostfix);
-    BOOL fValuePrefix = (NULL != pi->sczValuePrefix);
+    // Parsing again starts over, dropping the values of the previous parse along with any changes that weren't written.
+    hr = ResetContents(pi);
+    IniExitOnFailure(hr, "Failed to reset ini struct before parsing: %ls", wzPath);
 
     hr = StrAllocString(&pi->sczPath, wzPath, 0);
     IniExitOnFailure(hr, "Failed to copy path to ini struct: %ls", wzPath);
 
-    hr = FileToString(pi->sczPath, &sczContents, &pi->feEncoding);
-    IniExitOnFailure(hr, "Failed to convert file to string: %ls", pi->sczPath);
+    hr = ReadContents(pi);
+    IniExitOnFailure(hr, "Failed to read INI file: %ls", pi->sczPath);
 
     if (pfeEncodingFound)
     {
         *pfeEncodingFound = pi->feEncoding;
     }
 
-    if (!sczContents || !*sczContents)
+    if (!pi->cchContents)
     {
-        // Empty string, nothing to parse
+        // Empty file, nothing to parse
         ExitFunction1(hr = S_OK);
     }
 
-    dwValuePrefixLength = lstrlenW(pi->sczValuePrefix);
-    hr = StrSplitAllocArray(&pi->rgsczLines, reinterpret_cast<UINT *>(&pi->cLines), sczContents, L"\n");
-    IniExitOnFailure(hr, "Failed to split INI file into lines");
-
-    for (DWORD i = 0; i < pi->cLines; ++i)
-    {
-        if (!*pi->rgsczLines[i] || '\r' == *pi->rgsczLines[i])
-        {
-            continue;
-        }
-
-        if (pi->sczCommentLinePrefix)
-        {
-            wzCommentLinePrefix = wcsstr(pi->rgsczLines[i], pi->sczCommentLinePrefix);
-
-            if (wzCommentLinePrefix && wzCommentLinePrefix <= pi->rgsczLines[i] + 1)
-            {
-                continue;
-            }
-        }
-
-        if (pi->sczOpenTagPrefix)
-        {
-            wzOpenTagPrefix = wcsstr(pi->rgsczLines[i], pi->sczOpenTagPrefix);
-            if (wzOpenTagPrefix)
-            {
-                // If there is an open tag prefix but there is anything but whitespace before it, then it's NOT an open tag prefix
-                // This is important, for example, to support values with names like "Array[0]=blah" in INI format
-                for (wzTemp = pi->rgsczLines[i]; wzTemp < wzOpenTagPrefix; ++wzTemp)
-                {
-                    if (*wzTemp != L' ' && *wzTemp != L'\t')
-                    {
-                        wzOpenTagPrefix = NULL;
-                        break;
-                    }
-                }
-            }
-        }
-
-        if (pi->sczOpenTagPostfix)
-        {
-            wzOpenTagPostfix = wcsstr(pi->rgsczLines[i], pi->sczOpenTagPostfix);
-        }
-
-        if (pi->sczValuePrefix)
-        {
-            wzValuePrefix = wcsstr(pi->rgsczLines[i], pi->sczValuePrefix);
-            if (wzValuePrefix != NULL)
-            {
-                wzValueNameStart = wzValuePrefix + dwValuePrefixLength;
-            }
-        }
-        else
-        {
-            wzValueNameStart = pi->rgsczLines[i];
-        }
-
-        if (pi->sczValueSeparator && NULL != wzValueNameStart && *wzValueNameStart != L'\0')
-        {
-            dwValueSeparatorExceptionLength = 0;
-            for (DWORD j = 0; j < pi->cValueSeparatorExceptions; ++j)
-            {
-                if (pi->rgsczLines[i] == wcsstr(pi->rgsczLines[i], pi->rgsczValueSeparatorExceptions[j]))
-                {
-                    dwValueSeparatorExceptionLength = lstrlenW(pi->rgsczValueSeparatorExceptions[j]);
-                    break;
-                }
-            }
-
-            wzValueSeparator = wcsstr(wzValueNameStart + dwValueSeparatorExceptionLength, pi->sczValueSeparator);
-        }
-
-        // Don't keep the endline
-        if (pi->rgsczLines[i][lstrlenW(pi->rgsczLines[i])-1] == L'\r')
-        {
-            pi->rgsczLines[i][lstrlenW(pi->rgsczLines[i])-1] = L'\0';
-        }
-
-        if (fSections && wzOpenTagPrefix && wzOpenTagPostfix && wzOpenTagPrefix < wzOpenTagPostfix && (NULL == wzCommentLinePrefix || wzOpenTagPrefix < wzCommentLinePrefix))
-        {
-            // There is an section starting here, let's keep track of it and move on
-            hr = StrAllocString(&sczCurrentSection, wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix), wzOpenTagPostfix - (wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix)));
-            IniExitOnFailure(hr, "Failed to record section name for line: %ls of INI file: %ls", pi->rgsczLines[i], pi->sczPath);
-
-            // Sections will be calculated dynamically after any set operations, so don't include this in the list of lines to remember for output
-            ReleaseNullStr(pi->rgsczLines[i]);
-        }
-        else if (wzValueSeparator && (NULL == wzCommentLinePrefix || wzValueSeparator < wzCommentLinePrefix)
-            && (!fValuePrefix || wzValuePrefix))
-        {
-            if (fValuePrefix)
-            {
-                wzValueBegin = wzValuePrefix + lstrlenW(pi->sczValuePrefix);
-            }
-            else
-            {
-                wzValueBegin = pi->rgsczLines[i];
-            }
-
-            hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgivValues), pi->cValues + 1, sizeof(INI_VALUE), 100);
-            IniExitOnFailure(hr, "Failed to increase array size for value array");
-
-            if (sczCurrentSection)
-            {
-                hr = StrAllocString(&sczName, sczCurrentSection, 0);
-                IniExitOnFailure(hr, "Failed to copy current section name");
-
-                hr = StrAllocConcat(&sczName, wzSectionSeparator, 0);
-                IniExitOnFailure(hr, "Failed to copy current section name");
-            }
-
-            hr = StrAllocConcat(&sczName, wzValueBegin, wzValueSeparator - wzValueBegin);
-            IniExitOnFailure(hr, "Failed to copy name");
-
-            hr = StrAllocString(&sczValue, wzValueSeparator + lstrlenW(pi->sczValueSeparator), 0);
-            IniExitOnFailure(hr, "Failed to copy value");
-
-            hr = StrTrimWhitespace(&sczNameTrimmed, sczName);
-            IniExitOnFailure(hr, "Failed to trim whitespace from name");
-
-            hr = StrTrimWhitespace(&sczValueTrimmed, sczValue);
-            IniExitOnFailure(hr, "Failed to trim whitespace from value");
-
-            pi->rgivValues[pi->cValues].wzName = const_cast<LPCWSTR>(sczNameTrimmed);
-            sczNameTrimmed = NULL;
-            pi->rgivValues[pi->cValues].wzValue = const_cast<LPCWSTR>(sczValueTrimmed);
-            sczValueTrimmed = NULL;
-            pi->rgivValues[pi->cValues].dwLineNumber = i + 1;
-
-            ++pi->cValues;
-
-            // Values will be calculated dynamically after any set operations, so don't include this in the list of lines to remember for output
-            ReleaseNullStr(pi->rgsczLines[i]);
-        }
-        else
-        {
-            // Must be a comment, so ignore it and keep it in the list to output
-        }
-
-        ReleaseNullStr(sczName);
-    }
+    hr = ParseContents(pi);
+    IniExitOnFailure(hr, "Failed to parse INI file: %ls", pi->sczPath);
 
 LExit:
-    ReleaseStr(sczCurrentSection);
-    ReleaseStr(sczContents);
-    ReleaseStr(sczName);
-    ReleaseStr(sczNameTrimmed);
-    ReleaseStr(sczValue);
-    ReleaseStr(sczValueTrimmed);
-
     return hr;
 }
 
@@ -437,20 +400,12 @@ extern "C" HRESULT DAPI IniGetValue(
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
     INI_VALUE *pValue = NULL;
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
+    hr = DictGetValue(pi->shValues, wzValueName, reinterpret_cast<void **>(&pValue));
+    if (E_NOTFOUND == hr)
     {
-        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pi->rgivValues[i].wzName, -1, wzValueName, -1))
-        {
-            pValue = pi->rgivValues + i;
-            break;
-        }
-    }
-
-    if (NULL == pValue)
-    {
-        hr = E_NOTFOUND;
-        IniExitOnFailure(hr, "Failed to check for INI value: %ls", wzValueName);
+        ExitFunction();
     }
+    IniExitOnFailure(hr, "Failed to check for INI value: %ls", wzValueName);
 
     if (NULL == pValue->wzValue)
     {
@@ -474,18 +429,27 @@ extern "C" HRESULT DAPI IniSetValue(
     LPWSTR sczSectionPrefix = NULL; // includes section name and backslash
     LPWSTR sczName = NULL;
     LPWSTR sczValue = NULL;
-    DWORD dwInsertIndex = DWORD_MAX;
+    DWORD dwIndex = 0;
+    DWORD dwSection = INI_GLOBAL_SECTION;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
     INI_VALUE *pValue = NULL;
+    INI_VALUE_SPAN *pSpan = NULL;
+    INI_SECTION *pSection = NULL;
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
+    BOOL fSections = (NULL != pi->sczOpenTagPrefix) && (NULL != pi->sczOpenTagPostfix);
+
+    hr = DictGetValue(pi->shValues, wzValueName, reinterpret_cast<void **>(&pValue));
+    if (E_NOTFOUND == hr)
     {
-        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pi->rgivValues[i].wzName, -1, wzValueName, -1))
-        {
-            pValue = pi->rgivValues + i;
-            break;
-        }
+        hr = S_OK;
+        pValue = NULL;
+    }
+    IniExitOnFailure(hr, "Failed to look up INI value: %ls", wzValueName);
+
+    if (pValue)
+    {
+        pSpan = pi->rgSpans + (pValue - pi->rgivValues);
     }
 
     // We're killing the value
@@ -494,90 +458,90 @@ extern "C" HRESULT DAPI IniSetValue(
         if (pValue && pValue->wzValue)
         {
             pi->fModified = TRUE;
-            sczValue = const_cast<LPWSTR>(pValue->wzValue);
+
+            if (pSpan->fValueAllocated)
+            {
+                sczValue = const_cast<LPWSTR>(pValue->wzValue);
+                pSpan->fValueAllocated = FALSE;
+            }
             pValue->wzValue = NULL;
-            ReleaseNullStr(sczValue);
         }
 
         ExitFunction();
     }
-    else
+    else if (pValue)
     {
-        if (pValue)
+        if (NULL == pValue->wzValue || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, pValue->wzValue, -1, wzValue, -1))
         {
-            if (CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, pValue->wzValue, -1, wzValue, -1))
+            pi->fModified = TRUE;
+
+            // Values read from the file live in the pool, so they can't be reallocated in place.
+            if (!pSpan->fValueAllocated)
             {
-                pi->fModified = TRUE;
-                hr = StrAllocString(const_cast<LPWSTR *>(&pValue->wzValue), wzValue, 0);
-                IniExitOnFailure(hr, "Failed to update value INI value named: %ls", wzValueName);
+                pValue->wzValue = NULL;
             }
 
-            ExitFunction1(hr = S_OK);
+            hr = StrAllocString(const_cast<LPWSTR *>(&pValue->wzValue), wzValue, 0);
+            IniExitOnFailure(hr, "Failed to update value INI value named: %ls", wzValueName);
+
+            pSpan->fValueAllocated = TRUE;
+            pSpan->fValueModified = TRUE;
         }
-        else
+    }
+    else
+    {
+        if (fSections)
         {
-            if (wzValueName)
-            {
-                hr = GetSectionPrefixFromName(wzValueName, &sczSectionPrefix);
-                IniExitOnFailure(hr, "Failed to get section prefix from value name: %ls", wzValueName);
-            }
+            hr = GetSectionPrefixFromName(wzValueName, &sczSectionPrefix);
+            IniExitOnFailure(hr, "Failed to get section prefix from value name: %ls", wzValueName);
 
-            // If we have a section prefix, figure out the index to insert it (at the end of the section it belongs in)
             if (sczSectionPrefix)
             {
-                for (DWORD i = 0; i < pi->cValues; ++i)
-                {
-                    if (0 == wcsncmp(pi->rgivValues[i].wzName, sczSectionPrefix, lstrlenW(sczSectionPrefix)))
-                    {
-                        dwInsertIndex = i;
-                    }
-                    else if (DWORD_MAX != dwInsertIndex)
-                    {
-                        break;
-                    }
-                }
-            }
-            else
-            {
-                for (DWORD i = 0; i < pi->cValues; ++i)
-                {
-                    if (NULL == wcsstr(pi->rgivValues[i].wzName, wzSectionSeparator))
-                    {
-                        dwInsertIndex = i;
-                    }
-                    else if (DWORD_MAX != dwInsertIndex)
-                    {
-                        break;
-                    }
-                }
+                hr = FindOrAddSection(pi, sczSectionPrefix, &dwSection);
+                IniExitOnFailure(hr, "Failed to find section for value: %ls", wzValueName);
             }
+        }
 
-            // Otherwise, just add it to the end
-            if (DWORD_MAX == dwInsertIndex)
-            {
-                dwInsertIndex = pi->cValues;
-            }
+        hr = StrAllocString(&sczName, wzValueName, 0);
+        IniExitOnFailure(hr, "Failed to copy name");
 
-            pi->fModified = TRUE;
-            hr = MemInsertIntoArray(reinterpret_cast<void **>(&pi->rgivValues), dwInsertIndex, 1, pi->cValues + 1, sizeof(INI_VALUE), 100);
-            IniExitOnFailure(hr, "Failed to insert value into array");
+        hr = StrAllocString(&sczValue, wzValue, 0);
+        IniExitOnFailure(hr, "Failed to copy value");
 
-            hr = StrAllocString(&sczName, wzValueName, 0);
-            IniExitOnFailure(hr, "Failed to copy name");
+        hr = AddValue(pi, &dwIndex);
+        IniExitOnFailure(hr, "Failed to add value: %ls", wzValueName);
 
-            hr = StrAllocString(&sczValue, wzValue, 0);
-            IniExitOnFailure(hr, "Failed to copy value");
+        pi->fModified = TRUE;
+
+        pValue = pi->rgivValues + dwIndex;
+        pValue->wzName = sczName;
+        sczName = NULL;
+        pValue->wzValue = sczValue;
+        sczValue = NULL;
 
-            pi->rgivValues[dwInsertIndex].wzName = const_cast<LPCWSTR>(sczName);
-            sczName = NULL;
-            pi->rgivValues[dwInsertIndex].wzValue = const_cast<LPCWSTR>(sczValue);
-            sczValue = NULL;
+        pSpan = pi->rgSpans + dwIndex;
+        pSpan->dwSection = dwSection;
+        pSpan->fNameAllocated = TRUE;
+        pSpan->fValueAllocated = TRUE;
 
-            ++pi->cValues;
+        // Remember the order values were added to each section so they are written in that order.
+        pSection = pi->rgSections + dwSection;
+        if (DWORD_MAX == pSection->dwLastAdded)
+        {
+            pSection->dwFirstAdded = dwIndex;
         }
+        else
+        {
+            pi->rgSpans[pSection->dwLastAdded].dwNextAdded = dwIndex;
+        }
+        pSection->dwLastAdded = dwIndex;
+
+        hr = DictAddValue(pi->shValues, pValue);
+        IniExitOnFailure(hr, "Failed to index value: %ls", wzValueName);
     }
 
 LExit:
+    ReleaseStr(sczSectionPrefix);
     ReleaseStr(sczName);
     ReleaseStr(sczValue);
 
@@ -591,14 +555,23 @@ extern "C" HRESULT DAPI IniWriteFile(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczCurrentSectionPrefix = NULL;
-    LPWSTR sczNewSectionPrefix = NULL;
     LPWSTR sczContents = NULL;
-    LPCWSTR wzName = NULL;
-    DWORD dwLineArrayIndex = 1;
+    SIZE_T cchContents = 0;
+    SIZE_T cchUsed = 0;
+    SIZE_T iCopied = 0;
+    SIZE_T iEdit = 0;
+    SIZE_T iInsertAt = 0;
+    DWORD *rgdwInsertSections = NULL;
+    DWORD cInsertSections = 0;
+    DWORD iInsertSection = 0;
+    DWORD iValue = 0;
+    DWORD dwSection = 0;
     FILE_ENCODING feEncoding;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
+    INI_VALUE_SPAN *pSpan = NULL;
+
+    BOOL fSections = (pi->sczOpenTagPrefix) && (pi->sczOpenTagPostfix);
 
     if (FILE_ENCODING_UNSPECIFIED == feOverrideEncoding)
     {
@@ -623,127 +596,720 @@ extern "C" HRESULT DAPI IniWriteFile(
         ExitFunction1(hr = E_NOTFOUND);
     }
 
-    BOOL fSections = (pi->sczOpenTagPrefix) && (pi->sczOpenTagPostfix);
+    // Values added to sections that appear in the file are written where those sections end, so visit them in file order.
+    rgdwInsertSections = static_cast<DWORD *>(MemAlloc(sizeof(DWORD) * pi->cSections, FALSE));
+    IniExitOnNull(rgdwInsertSections, hr, E_OUTOFMEMORY, "Failed to allocate section insertion order");
 
-    hr = StrAllocString(&sczContents, L"", 0);
-    IniExitOnFailure(hr, "Failed to begin contents string as empty string");
+    for (DWORD i = 0; i < pi->cSections; ++i)
+    {
+        if (pi->rgSections[i].fFromFile && SectionHasAddedValues(pi, i))
+        {
+            DWORD j = cInsertSections;
+            for (; j > 0 && pi->rgSections[rgdwInsertSections[j - 1]].iInsertAt > pi->rgSections[i].iInsertAt; --j)
+            {
+                rgdwInsertSections[j] = rgdwInsertSections[j - 1];
+            }
 
-    // Insert any beginning lines we didn't understand like comments
-    if (0 < pi->cLines)
+            rgdwInsertSections[j] = i;
+            ++cInsertSections;
+        }
+    }
+
+    // Unmodified runs of the file are copied verbatim, so start with room for about the whole file.
+    cchContents = pi->cchContents + pi->cchContents / 8 + 256;
+    hr = StrAlloc(&sczContents, cchContents);
+    IniExitOnFailure(hr, "Failed to allocate ini output buffer");
+
+    *sczContents = L'\0';
+
+    for (;;)
     {
-        while (pi->rgsczLines[dwLineArrayIndex])
+        // Find the next value read from the file that was changed or deleted.
+        for (; iValue < pi->cValues; ++iValue)
+        {
+            pSpan = pi->rgSpans + iValue;
+            if (pSpan->fFromFile && (NULL == pi->rgivValues[iValue].wzValue || pSpan->fValueModified))
+            {
+                break;
+            }
+        }
+
+        if (iValue < pi->cValues)
+        {
+            iEdit = pi->rgivValues[iValue].wzValue ? pSpan->iValueStart : pSpan->iLineStart;
+        }
+        else if (iInsertSection < cInsertSections)
+        {
+            iEdit = SIZE_T_MAX;
+        }
+        else
+        {
+            break;
+        }
+
+        iInsertAt = (iInsertSection < cInsertSections) ? pi->rgSections[rgdwInsertSections[iInsertSection]].iInsertAt : SIZE_T_MAX;
+
+        if (iInsertAt <= iEdit)
         {
-            hr = StrAllocConcat(&sczContents, pi->rgsczLines[dwLineArrayIndex], 0);
-            IniExitOnFailure(hr, "Failed to add previous line to ini output buffer in-memory");
+            hr = AppendToBuffer(&sczContents, &cchContents, &cchUsed, pi->sczContents + iCopied, iInsertAt - iCopied);
+            IniExitOnFailure(hr, "Failed to add unmodified lines to ini output buffer in-memory");
 
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+            iCopied = iInsertAt;
 
-            ++dwLineArrayIndex;
+            hr = AppendAddedValues(pi, rgdwInsertSections[iInsertSection], fSections, FALSE, &sczContents, &cchContents, &cchUsed);
+            IniExitOnFailure(hr, "Failed to add new values to ini output buffer in-memory");
+
+            ++iInsertSection;
+        }
+        else
+        {
+            hr = AppendToBuffer(&sczContents, &cchContents, &cchUsed, pi->sczContents + iCopied, iEdit - iCopied);
+            IniExitOnFailure(hr, "Failed to add unmodified lines to ini output buffer in-memory");
+
+            if (pi->rgivValues[iValue].wzValue)
+            {
+                // Patch just the value text, keeping the name, separator and any surrounding whitespace.
+                hr = AppendToBuffer(&sczContents, &cchContents, &cchUsed, pi->rgivValues[iValue].wzValue, lstrlenW(pi->rgivValues[iValue].wzValue));
+                IniExitOnFailure(hr, "Failed to add modified value to ini output buffer in-memory");
+
+                iCopied = pSpan->iValueStart + pSpan->cchValue;
+            }
+            else
+            {
+                // Deleted values drop their whole line.
+                iCopied = pSpan->iLineEnd;
+            }
+
+            ++iValue;
         }
     }
 
+    hr = AppendToBuffer(&sczContents, &cchContents, &cchUsed, pi->sczContents + iCopied, pi->cchContents - iCopied);
+    IniExitOnFailure(hr, "Failed to add remaining lines to ini output buffer in-memory");
+
+    // Sections that didn't appear in the file are written at the end, in the order they were added.
+    for (dwSection = 0; dwSection < pi->cSections; ++dwSection)
+    {
+        if (!pi->rgSections[dwSection].fFromFile && SectionHasAddedValues(pi, dwSection))
+        {
+            hr = AppendAddedValues(pi, dwSection, fSections, fSections && INI_GLOBAL_SECTION != dwSection, &sczContents, &cchContents, &cchUsed);
+            IniExitOnFailure(hr, "Failed to add new section to ini output buffer in-memory");
+        }
+    }
+
+    // If no path was specified, use the path to the file we parsed
+    if (NULL == wzPath)
+    {
+        wzPath = pi->sczPath;
+    }
+
+    hr = FileFromString(wzPath, 0, sczContents, feEncoding);
+    IniExitOnFailure(hr, "Failed to write INI contents out to file: %ls", wzPath);
+
+LExit:
+    ReleaseMem(rgdwInsertSections);
+    ReleaseStr(sczContents);
+
+    return hr;
+}
+
+static HRESULT ResetContents(
+    __in INI_STRUCT* pi
+    )
+{
+    HRESULT hr = S_OK;
+
+    ReleaseNullDict(pi->shValues);
+    ReleaseNullDict(pi->shSections);
+
     for (DWORD i = 0; i < pi->cValues; ++i)
     {
-        // Skip if this value was killed off
-        if (NULL == pi->rgivValues[i].wzValue)
+        UninitializeIniValue(pi->rgivValues + i, pi->rgSpans + i);
+    }
+    pi->cValues = 0;
+
+    for (DWORD i = 0; i < pi->cSections; ++i)
+    {
+        ReleaseNullStr(pi->rgSections[i].sczPrefix);
+    }
+
+    ::ZeroMemory(pi->rgSections + INI_GLOBAL_SECTION, sizeof(INI_SECTION));
+    pi->rgSections[INI_GLOBAL_SECTION].dwFirstAdded = DWORD_MAX;
+    pi->rgSections[INI_GLOBAL_SECTION].dwLastAdded = DWORD_MAX;
+    pi->cSections = 1;
+
+    ReleaseNullStr(pi->sczPool);
+    ReleaseNullStr(pi->sczContents);
+    pi->cchContents = 0;
+    pi->fModified = FALSE;
+
+    hr = DictCreateWithEmbeddedKey(&pi->shValues, 0, reinterpret_cast<void **>(&pi->rgivValues), offsetof(INI_VALUE, wzName), DICT_FLAG_NONE);
+    IniExitOnFailure(hr, "Failed to create ini value index");
+
+    hr = DictCreateWithEmbeddedKey(&pi->shSections, 0, reinterpret_cast<void **>(&pi->rgSections), offsetof(INI_SECTION, sczPrefix), DICT_FLAG_NONE);
+    IniExitOnFailure(hr, "Failed to create ini section index");
+
+LExit:
+    return hr;
+}
+
+static HRESULT ReadContents(
+    __in INI_STRUCT* pi
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMap = NULL;
+    LARGE_INTEGER liFileSize = { };
+    const BYTE* pbFile = NULL;
+    SIZE_T cbFile = 0;
+    SIZE_T cchFile = 0;
+
+    hFile = ::CreateFileW(pi->sczPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        IniExitWithLastError(hr, "Failed to open INI file: %ls", pi->sczPath);
+    }
+
+    if (!::GetFileSizeEx(hFile, &liFileSize))
+    {
+        IniExitWithLastError(hr, "Failed to get size of INI file: %ls", pi->sczPath);
+    }
+
+    if (0 == liFileSize.QuadPart)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    else if (INT_MAX < liFileSize.QuadPart)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+        IniExitOnRootFailure(hr, "INI file is too large: %ls", pi->sczPath);
+    }
+
+    cbFile = static_cast<SIZE_T>(liFileSize.QuadPart);
+
+    hMap = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    IniExitOnNullWithLastError(hMap, hr, "Failed to create file mapping for INI file: %ls", pi->sczPath);
+
+    pbFile = static_cast<const BYTE*>(::MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0));
+    IniExitOnNullWithLastError(pbFile, hr, "Failed to map view of INI file: %ls", pi->sczPath);
+
+    // Decode the mapped view once, detecting the encoding the same way FileToString() does. The mapping itself is released before
+    // returning so the file can be rewritten by IniWriteFile().
+    if (cbFile > sizeof(UTF8BOM) && 0 == memcmp(pbFile, UTF8BOM, sizeof(UTF8BOM)))
+    {
+        pi->feEncoding = FILE_ENCODING_UTF8_WITH_BOM;
+
+        hr = StrAllocStringAnsi(&pi->sczContents, reinterpret_cast<LPCSTR>(pbFile + sizeof(UTF8BOM)), cbFile - sizeof(UTF8BOM), CP_UTF8);
+        IniExitOnFailure(hr, "Failed to convert INI file %ls from UTF-8 as its BOM indicated", pi->sczPath);
+    }
+    else if (cbFile > sizeof(UTF16BOM) && 0 == memcmp(pbFile, UTF16BOM, sizeof(UTF16BOM)))
+    {
+        pi->feEncoding = FILE_ENCODING_UTF16_WITH_BOM;
+
+        cchFile = (cbFile - sizeof(UTF16BOM)) / sizeof(WCHAR);
+        if (cchFile)
         {
-            continue;
+            hr = StrAllocString(&pi->sczContents, reinterpret_cast<LPCWSTR>(pbFile + sizeof(UTF16BOM)), cchFile);
+            IniExitOnFailure(hr, "Failed to copy INI file contents: %ls", pi->sczPath);
+        }
+    }
+    else if (!memchr(pbFile, '\0', cbFile))
+    {
+        pi->feEncoding = FILE_ENCODING_UTF8;
+
+        hr = StrAllocStringAnsi(&pi->sczContents, reinterpret_cast<LPCSTR>(pbFile), cbFile, CP_UTF8);
+        IniExitOnFailure(hr, "Failed to convert INI file %ls from UTF-8", pi->sczPath);
+    }
+    else
+    {
+        pi->feEncoding = FILE_ENCODING_UTF16;
+
+        cchFile = cbFile / sizeof(WCHAR);
+        if (cchFile)
+        {
+            hr = StrAllocString(&pi->sczContents, reinterpret_cast<LPCWSTR>(pbFile), cchFile);
+            IniExitOnFailure(hr, "Failed to copy INI file contents: %ls", pi->sczPath);
         }
+    }
+
+    pi->cchContents = pi->sczContents ? wcslen(pi->sczContents) : 0;
+
+LExit:
+    if (pbFile)
+    {
+        ::UnmapViewOfFile(pbFile);
+    }
 
-        // Now generate any lines for the current value like value line and maybe also a new section line before it
+    ReleaseHandle(hMap);
+    ReleaseFileHandle(hFile);
 
-        // First see if we need to write a section line
-        hr = GetSectionPrefixFromName(pi->rgivValues[i].wzName, &sczNewSectionPrefix);
-        IniExitOnFailure(hr, "Failed to get section prefix from name: %ls", pi->rgivValues[i].wzName);
+    return hr;
+}
 
-        // If the new section prefix is different, write a section out for it
-        if (fSections && sczNewSectionPrefix && (NULL == sczCurrentSectionPrefix || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, sczNewSectionPrefix, -1, sczCurrentSectionPrefix, -1)))
+static HRESULT ParseContents(
+    __in INI_STRUCT* pi
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczSectionPrefix = NULL;
+    SIZE_T cchPool = 0;
+    SIZE_T cchPoolUsed = 0;
+    SIZE_T iLineStart = 0;
+    SIZE_T iLineEnd = 0;
+    SIZE_T cchLine = 0;
+    DWORD dwLineNumber = 0;
+    DWORD dwSection = INI_GLOBAL_SECTION;
+    DWORD dwFirstValue = pi->cValues;
+    DWORD dwIndex = 0;
+    BOOL fSeenSection = FALSE;
+    BOOL fGlobalValues = FALSE;
+    LPWSTR wzLine = NULL;
+    LPCWSTR wzNewline = NULL;
+    LPCWSTR wzNameStart = NULL;
+    LPCWSTR wzNameEnd = NULL;
+    LPCWSTR wzValueStart = NULL;
+    LPCWSTR wzValueEnd = NULL;
+    LPCWSTR wzPrefix = NULL;
+    WCHAR wchTerminator = L'\0';
+    INI_LINE_TYPE lineType = INI_LINE_OTHER;
+    INI_VALUE_SPAN *pSpan = NULL;
+
+    // Values added outside of any section go after the last such value, or before the first section when there are none.
+    pi->rgSections[INI_GLOBAL_SECTION].fFromFile = TRUE;
+    pi->rgSections[INI_GLOBAL_SECTION].iInsertAt = pi->cchContents;
+
+    for (iLineStart = 0; iLineStart < pi->cchContents; iLineStart = iLineEnd)
+    {
+        ++dwLineNumber;
+
+        wzLine = pi->sczContents + iLineStart;
+        wzNewline = wcschr(wzLine, L'\n');
+        cchLine = wzNewline ? wzNewline - wzLine : pi->cchContents - iLineStart;
+        iLineEnd = wzNewline ? iLineStart + cchLine + 1 : pi->cchContents;
+
+        // Don't keep the endline
+        if (cchLine && L'\r' == wzLine[cchLine - 1])
         {
-            hr = StrAllocConcat(&sczContents, pi->sczOpenTagPrefix, 0);
-            IniExitOnFailure(hr, "Failed to concat open tag prefix to string");
-
-            // Exclude section separator (i.e. backslash) from new section prefix
-            hr = StrAllocConcat(&sczContents, sczNewSectionPrefix, lstrlenW(sczNewSectionPrefix)-lstrlenW(wzSectionSeparator));
-            IniExitOnFailure(hr, "Failed to concat section name to string");
-
-            hr = StrAllocConcat(&sczContents, pi->sczOpenTagPostfix, 0);
-            IniExitOnFailure(hr, "Failed to concat open tag postfix to string");
-
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
-            
-            ReleaseNullStr(sczCurrentSectionPrefix);
-            sczCurrentSectionPrefix = sczNewSectionPrefix;
-            sczNewSectionPrefix = NULL;
+            --cchLine;
         }
 
-        // Inserting lines we read before the current value if appropriate
-        while (pi->rgivValues[i].dwLineNumber > dwLineArrayIndex)
+        // Terminate the line in place so matching can't run past it, restoring the contents before anything can fail.
+        wchTerminator = wzLine[cchLine];
+        wzLine[cchLine] = L'\0';
+
+        lineType = ClassifyLine(pi, wzLine, &wzNameStart, &wzNameEnd, &wzValueStart);
+
+        wzLine[cchLine] = wchTerminator;
+
+        if (INI_LINE_SECTION == lineType)
         {
-            // Skip any lines were purposely forgot
-            if (NULL == pi->rgsczLines[dwLineArrayIndex])
+            if (!fSeenSection && !fGlobalValues)
             {
-                ++dwLineArrayIndex;
-                continue;
+                pi->rgSections[INI_GLOBAL_SECTION].iInsertAt = iLineStart;
             }
+            fSeenSection = TRUE;
+
+            hr = StrAllocFormatted(&sczSectionPrefix, L"%.*ls%ls", static_cast<int>(wzNameEnd - wzNameStart), wzNameStart, wzSectionSeparator);
+            IniExitOnFailure(hr, "Failed to record section name for line: %u of INI file: %ls", dwLineNumber, pi->sczPath);
 
-            hr = StrAllocConcat(&sczContents, pi->rgsczLines[dwLineArrayIndex++], 0);
-            IniExitOnFailure(hr, "Failed to add previous line to ini output buffer in-memory");
+            hr = FindOrAddSection(pi, sczSectionPrefix, &dwSection);
+            IniExitOnFailure(hr, "Failed to add section: %ls", sczSectionPrefix);
 
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+            pi->rgSections[dwSection].fFromFile = TRUE;
+            pi->rgSections[dwSection].iInsertAt = iLineEnd;
         }
+        else if (INI_LINE_VALUE == lineType)
+        {
+            wzValueEnd = wzLine + cchLine;
 
-        wzName = pi->rgivValues[i].wzName;
-        if (fSections)
+            TrimSpan(&wzNameStart, &wzNameEnd);
+            TrimSpan(&wzValueStart, &wzValueEnd);
+
+            hr = AddValue(pi, &dwIndex);
+            IniExitOnFailure(hr, "Failed to add value for line: %u of INI file: %ls", dwLineNumber, pi->sczPath);
+
+            pSpan = pi->rgSpans + dwIndex;
+            pSpan->dwSection = dwSection;
+            pSpan->fFromFile = TRUE;
+            pSpan->iLineStart = iLineStart;
+            pSpan->iLineEnd = iLineEnd;
+            pSpan->iValueStart = wzValueStart - pi->sczContents;
+            pSpan->cchValue = wzValueEnd - wzValueStart;
+
+            pi->rgivValues[dwIndex].dwLineNumber = dwLineNumber;
+
+            // The pool moves as it grows, so names and values hold offsets into it until parsing is complete.
+            pi->rgivValues[dwIndex].wzName = reinterpret_cast<LPCWSTR>(cchPoolUsed);
+
+            if (INI_GLOBAL_SECTION != dwSection)
+            {
+                wzPrefix = pi->rgSections[dwSection].sczPrefix;
+
+                hr = AppendToBuffer(&pi->sczPool, &cchPool, &cchPoolUsed, wzPrefix, lstrlenW(wzPrefix));
+                IniExitOnFailure(hr, "Failed to copy current section name");
+            }
+
+            hr = AppendToBuffer(&pi->sczPool, &cchPool, &cchPoolUsed, wzNameStart, wzNameEnd - wzNameStart);
+            IniExitOnFailure(hr, "Failed to copy name");
+
+            ++cchPoolUsed; // keep the terminator
+
+            pi->rgivValues[dwIndex].wzValue = reinterpret_cast<LPCWSTR>(cchPoolUsed);
+
+            hr = AppendToBuffer(&pi->sczPool, &cchPool, &cchPoolUsed, wzValueStart, wzValueEnd - wzValueStart);
+            IniExitOnFailure(hr, "Failed to copy value");
+
+            ++cchPoolUsed;
+
+            pi->rgSections[dwSection].iInsertAt = iLineEnd;
+            fGlobalValues |= (INI_GLOBAL_SECTION == dwSection);
+        }
+        else
         {
-            wzName += lstrlenW(sczCurrentSectionPrefix);
+            // Must be a comment or blank line, which is written back untouched.
         }
+    }
 
-        // OK, now just write the name/value pair, if it isn't deleted
-        if (pi->sczValuePrefix)
+    for (DWORD i = dwFirstValue; i < pi->cValues; ++i)
+    {
+        pi->rgivValues[i].wzName = pi->sczPool + reinterpret_cast<SIZE_T>(pi->rgivValues[i].wzName);
+        pi->rgivValues[i].wzValue = pi->sczPool + reinterpret_cast<SIZE_T>(pi->rgivValues[i].wzValue);
+
+        // When a name repeats, lookups find its first occurrence.
+        hr = DictKeyExists(pi->shValues, pi->rgivValues[i].wzName);
+        if (E_NOTFOUND == hr)
         {
-            hr = StrAllocConcat(&sczContents, pi->sczValuePrefix, 0);
-            IniExitOnFailure(hr, "Failed to concat value prefix to ini output buffer");
+            hr = DictAddValue(pi->shValues, pi->rgivValues + i);
         }
+        IniExitOnFailure(hr, "Failed to index value: %ls", pi->rgivValues[i].wzName);
+    }
 
-        hr = StrAllocConcat(&sczContents, wzName, 0);
-        IniExitOnFailure(hr, "Failed to concat value name to ini output buffer");
+LExit:
+    ReleaseStr(sczSectionPrefix);
 
-        hr = StrAllocConcat(&sczContents, pi->sczValueSeparator, 0);
-        IniExitOnFailure(hr, "Failed to concat value separator to ini output buffer");
+    return hr;
+}
 
-        hr = StrAllocConcat(&sczContents, pi->rgivValues[i].wzValue, 0);
-        IniExitOnFailure(hr, "Failed to concat value to ini output buffer");
+static INI_LINE_TYPE ClassifyLine(
+    __in INI_STRUCT* pi,
+    __in_z LPCWSTR wzLine,
+    __out LPCWSTR* pwzNameStart,
+    __out LPCWSTR* pwzNameEnd,
+    __out LPCWSTR* pwzValueStart
+    )
+{
+    LPCWSTR wzOpenTagPrefix = NULL;
+    LPCWSTR wzOpenTagPostfix = NULL;
+    LPCWSTR wzValuePrefix = NULL;
+    LPCWSTR wzValueNameStart = NULL;
+    LPCWSTR wzValueSeparator = NULL;
+    LPCWSTR wzCommentLinePrefix = NULL;
+    LPCWSTR wzTemp = NULL;
+    SIZE_T cchValueSeparatorException = 0;
 
-        hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-        IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+    BOOL fSections = (NULL != pi->sczOpenTagPrefix) && (NULL != pi->sczOpenTagPostfix);
+    BOOL fValuePrefix = (NULL != pi->sczValuePrefix);
+
+    if (!*wzLine)
+    {
+        return INI_LINE_OTHER;
     }
 
-    // If no path was specified, use the path to the file we parsed
-    if (NULL == wzPath)
+    if (pi->sczCommentLinePrefix)
     {
-        wzPath = pi->sczPath;
+        wzCommentLinePrefix = wcsstr(wzLine, pi->sczCommentLinePrefix);
+
+        if (wzCommentLinePrefix && wzCommentLinePrefix <= wzLine + 1)
+        {
+            return INI_LINE_OTHER;
+        }
     }
 
-    hr = FileFromString(wzPath, 0, sczContents, feEncoding);
-    IniExitOnFailure(hr, "Failed to write INI contents out to file: %ls", wzPath);
+    if (pi->sczOpenTagPrefix)
+    {
+        wzOpenTagPrefix = wcsstr(wzLine, pi->sczOpenTagPrefix);
+        if (wzOpenTagPrefix)
+        {
+            // If there is an open tag prefix but there is anything but whitespace before it, then it's NOT an open tag prefix
+            // This is important, for example, to support values with names like "Array[0]=blah" in INI format
+            for (wzTemp = wzLine; wzTemp < wzOpenTagPrefix; ++wzTemp)
+            {
+                if (*wzTemp != L' ' && *wzTemp != L'\t')
+                {
+                    wzOpenTagPrefix = NULL;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (pi->sczOpenTagPostfix)
+    {
+        wzOpenTagPostfix = wcsstr(wzLine, pi->sczOpenTagPostfix);
+    }
+
+    if (fValuePrefix)
+    {
+        wzValuePrefix = wcsstr(wzLine, pi->sczValuePrefix);
+        if (wzValuePrefix)
+        {
+            wzValueNameStart = wzValuePrefix + lstrlenW(pi->sczValuePrefix);
+        }
+    }
+    else
+    {
+        wzValueNameStart = wzLine;
+    }
+
+    if (pi->sczValueSeparator && NULL != wzValueNameStart && *wzValueNameStart != L'\0')
+    {
+        for (DWORD j = 0; j < pi->cValueSeparatorExceptions; ++j)
+        {
+            if (wzLine == wcsstr(wzLine, pi->rgsczValueSeparatorExceptions[j]))
+            {
+                cchValueSeparatorException = lstrlenW(pi->rgsczValueSeparatorExceptions[j]);
+                break;
+            }
+        }
+
+        if (cchValueSeparatorException <= wcslen(wzValueNameStart))
+        {
+            wzValueSeparator = wcsstr(wzValueNameStart + cchValueSeparatorException, pi->sczValueSeparator);
+        }
+    }
+
+    if (fSections && wzOpenTagPrefix && wzOpenTagPostfix && wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix) <= wzOpenTagPostfix && (NULL == wzCommentLinePrefix || wzOpenTagPrefix < wzCommentLinePrefix))
+    {
+        *pwzNameStart = wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix);
+        *pwzNameEnd = wzOpenTagPostfix;
+
+        return INI_LINE_SECTION;
+    }
+    else if (wzValueSeparator && (NULL == wzCommentLinePrefix || wzValueSeparator < wzCommentLinePrefix) && (!fValuePrefix || wzValuePrefix))
+    {
+        *pwzNameStart = fValuePrefix ? wzValuePrefix + lstrlenW(pi->sczValuePrefix) : wzLine;
+        *pwzNameEnd = wzValueSeparator;
+        *pwzValueStart = wzValueSeparator + lstrlenW(pi->sczValueSeparator);
+
+        return INI_LINE_VALUE;
+    }
+
+    return INI_LINE_OTHER;
+}
+
+static void TrimSpan(
+    __inout LPCWSTR* pwzStart,
+    __inout LPCWSTR* pwzEnd
+    )
+{
+    while (*pwzStart < *pwzEnd && (L' ' == **pwzStart || L'\t' == **pwzStart))
+    {
+        ++*pwzStart;
+    }
+
+    while (*pwzStart < *pwzEnd && (L' ' == *(*pwzEnd - 1) || L'\t' == *(*pwzEnd - 1)))
+    {
+        --*pwzEnd;
+    }
+}
+
+static HRESULT FindOrAddSection(
+    __in INI_STRUCT* pi,
+    __in_z LPCWSTR wzPrefix,
+    __out DWORD* pdwSection
+    )
+{
+    HRESULT hr = S_OK;
+    INI_SECTION *pSection = NULL;
+
+    hr = DictGetValue(pi->shSections, wzPrefix, reinterpret_cast<void **>(&pSection));
+    if (E_NOTFOUND == hr)
+    {
+        hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgSections), pi->cSections + 1, sizeof(INI_SECTION), 10);
+        IniExitOnFailure(hr, "Failed to increase array size for section array");
+
+        pSection = pi->rgSections + pi->cSections;
+
+        hr = StrAllocString(&pSection->sczPrefix, wzPrefix, 0);
+        IniExitOnFailure(hr, "Failed to copy section prefix");
+
+        pSection->dwFirstAdded = DWORD_MAX;
+        pSection->dwLastAdded = DWORD_MAX;
+        ++pi->cSections;
+
+        hr = DictAddValue(pi->shSections, pSection);
+        IniExitOnFailure(hr, "Failed to index section: %ls", wzPrefix);
+    }
+    IniExitOnFailure(hr, "Failed to look up section: %ls", wzPrefix);
+
+    *pdwSection = static_cast<DWORD>(pSection - pi->rgSections);
 
 LExit:
-    ReleaseStr(sczContents);
-    ReleaseStr(sczCurrentSectionPrefix);
-    ReleaseStr(sczNewSectionPrefix);
+    return hr;
+}
+
+static HRESULT AddValue(
+    __in INI_STRUCT* pi,
+    __out DWORD* pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwGrowth = (100 < pi->cValues) ? pi->cValues : 100;
+
+    hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgivValues), pi->cValues + 1, sizeof(INI_VALUE), dwGrowth);
+    IniExitOnFailure(hr, "Failed to increase array size for value array");
+
+    hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgSpans), pi->cValues + 1, sizeof(INI_VALUE_SPAN), dwGrowth);
+    IniExitOnFailure(hr, "Failed to increase array size for value span array");
+
+    ::ZeroMemory(pi->rgivValues + pi->cValues, sizeof(INI_VALUE));
+    ::ZeroMemory(pi->rgSpans + pi->cValues, sizeof(INI_VALUE_SPAN));
+    pi->rgSpans[pi->cValues].dwNextAdded = DWORD_MAX;
+
+    *pdwIndex = pi->cValues;
+    ++pi->cValues;
+
+LExit:
+    return hr;
+}
+
+static HRESULT AppendToBuffer(
+    __deref_inout_ecount(*pcchBuffer) LPWSTR* psczBuffer,
+    __inout SIZE_T* pcchBuffer,
+    __inout SIZE_T* pcchUsed,
+    __in_ecount(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cchNeeded = *pcchUsed + cch + 1;
+    SIZE_T cchNew = 0;
+
+    if (cchNeeded > *pcchBuffer)
+    {
+        cchNew = max(cchNeeded, *pcchBuffer * 2);
+        if (256 > cchNew)
+        {
+            cchNew = 256;
+        }
+
+        hr = StrAlloc(psczBuffer, cchNew);
+        IniExitOnFailure(hr, "Failed to grow buffer to %Iu characters", cchNew);
+
+        *pcchBuffer = cchNew;
+    }
+
+    if (cch)
+    {
+        memcpy_s(*psczBuffer + *pcchUsed, (*pcchBuffer - *pcchUsed) * sizeof(WCHAR), wz, cch * sizeof(WCHAR));
+    }
 
+    *pcchUsed += cch;
+    (*psczBuffer)[*pcchUsed] = L'\0';
+
+LExit:
     return hr;
 }
 
+static HRESULT AppendAddedValues(
+    __in INI_STRUCT* pi,
+    __in DWORD dwSection,
+    __in BOOL fSections,
+    __in BOOL fWriteSectionTag,
+    __deref_inout_ecount(*pcchBuffer) LPWSTR* psczBuffer,
+    __inout SIZE_T* pcchBuffer,
+    __inout SIZE_T* pcchUsed
+    )
+{
+    HRESULT hr = S_OK;
+    INI_SECTION *pSection = pi->rgSections + dwSection;
+    SIZE_T cchPrefix = (fSections && pSection->sczPrefix) ? lstrlenW(pSection->sczPrefix) : 0;
+    INI_VALUE *pValue = NULL;
+
+    // Start on a new line even if the text before didn't end with one.
+    if (*pcchUsed && L'\n' != (*psczBuffer)[*pcchUsed - 1])
+    {
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, L"\r\n", 2);
+        IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+    }
+
+    if (fWriteSectionTag)
+    {
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pi->sczOpenTagPrefix, lstrlenW(pi->sczOpenTagPrefix));
+        IniExitOnFailure(hr, "Failed to concat open tag prefix to string");
+
+        // Exclude section separator (i.e. backslash) from section prefix
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pSection->sczPrefix, cchPrefix - lstrlenW(wzSectionSeparator));
+        IniExitOnFailure(hr, "Failed to concat section name to string");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pi->sczOpenTagPostfix, lstrlenW(pi->sczOpenTagPostfix));
+        IniExitOnFailure(hr, "Failed to concat open tag postfix to string");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, L"\r\n", 2);
+        IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+    }
+
+    for (DWORD i = pSection->dwFirstAdded; DWORD_MAX != i; i = pi->rgSpans[i].dwNextAdded)
+    {
+        pValue = pi->rgivValues + i;
+
+        // Skip if this value was killed off
+        if (NULL == pValue->wzValue)
+        {
+            continue;
+        }
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pi->sczValuePrefix, lstrlenW(pi->sczValuePrefix));
+        IniExitOnFailure(hr, "Failed to concat value prefix to ini output buffer");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pValue->wzName + cchPrefix, lstrlenW(pValue->wzName + cchPrefix));
+        IniExitOnFailure(hr, "Failed to concat value name to ini output buffer");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pi->sczValueSeparator, lstrlenW(pi->sczValueSeparator));
+        IniExitOnFailure(hr, "Failed to concat value separator to ini output buffer");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, pValue->wzValue, lstrlenW(pValue->wzValue));
+        IniExitOnFailure(hr, "Failed to concat value to ini output buffer");
+
+        hr = AppendToBuffer(psczBuffer, pcchBuffer, pcchUsed, L"\r\n", 2);
+        IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+    }
+
+LExit:
+    return hr;
+}
+
+static BOOL SectionHasAddedValues(
+    __in INI_STRUCT* pi,
+    __in DWORD dwSection
+    )
+{
+    for (DWORD i = pi->rgSections[dwSection].dwFirstAdded; DWORD_MAX != i; i = pi->rgSpans[i].dwNextAdded)
+    {
+        if (pi->rgivValues[i].wzValue)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 static void UninitializeIniValue(
-    INI_VALUE *pivValue
+    INI_VALUE *pivValue,
+    INI_VALUE_SPAN *pSpan
     )
 {
-    ReleaseStr(const_cast<LPWSTR>(pivValue->wzName));
-    ReleaseStr(const_cast<LPWSTR>(pivValue->wzValue));
+    if (pSpan->fNameAllocated)
+    {
+        ReleaseStr(const_cast<LPWSTR>(pivValue->wzName));
+    }
+
+    if (pSpan->fValueAllocated)
+    {
+        ReleaseStr(const_cast<LPWSTR>(pivValue->wzValue));
+    }
 }
 
 static HRESULT GetSectionPrefixFromName(
@@ -17,18 +17,44 @@
 #define JsonExitOnWin32Error(e, x, s, ...) ExitOnWin32ErrorSource(DUTIL_SOURCE_JSONUTIL, e, x, s, __VA_ARGS__)
 #define JsonExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_JSONUTIL, g, x, s, __VA_ARGS__)
 
-const DWORD JSON_STACK_INCREMENT = 5;
+const DWORD JSON_MIN_BUFFER_ALLOC = 256;
+const DWORD JSON_MIN_TOKEN_STACK = 16;
 
 // Prototypes
+static HRESULT NextToken(
+    __in JSON_READER* pReader,
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
+    );
+static HRESULT ReadScalar(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    );
+static BOOL MatchLiteral(
+    __in JSON_READER* pReader,
+    __in_z LPCWSTR wzLiteral,
+    __in DWORD cchLiteral
+    );
+static LPCWSTR ScanNumber(
+    __in LPCWSTR pwz,
+    __in LPCWSTR pwzEnd
+    );
+static LPCWSTR ScanDigits(
+    __in LPCWSTR pwz,
+    __in LPCWSTR pwzEnd
+    );
+static void SkipWhitespace(
+    __in JSON_READER* pReader
+    );
 static HRESULT DoStart(
     __in JSON_WRITER* pWriter,
     __in JSON_TOKEN tokenStart,
-    __in_z LPCWSTR wzStartString
+    __in WCHAR wchStart
     );
 static HRESULT DoEnd(
     __in JSON_WRITER* pWriter,
     __in JSON_TOKEN tokenEnd,
-    __in_z LPCWSTR wzEndString
+    __in WCHAR wchEnd
     );
 static HRESULT DoKey(
     __in JSON_WRITER* pWriter,
@@ -36,15 +62,31 @@ static HRESULT DoKey(
     );
 static HRESULT DoValue(
     __in JSON_WRITER* pWriter,
-    __in_z_opt LPCWSTR wzValue
+    __in_ecount_opt(cchValue) LPCWSTR wzValue,
+    __in DWORD cchValue,
+    __in BOOL fString
     );
 static HRESULT EnsureTokenStack(
-    __in JSON_WRITER* pWriter
+    __inout JSON_TOKEN** prgTokenStack,
+    __inout DWORD* pcMaxTokens,
+    __in DWORD cTokens
     );
-static HRESULT SerializeJsonString(
-    __out_z LPWSTR* psczJsonString,
+static HRESULT EnsureWriterBuffer(
+    __in JSON_WRITER* pWriter,
+    __in DWORD cchAdditional
+    );
+static HRESULT AppendJson(
+    __in JSON_WRITER* pWriter,
+    __in_ecount(cch) LPCWSTR wz,
+    __in DWORD cch
+    );
+static HRESULT AppendJsonString(
+    __in JSON_WRITER* pWriter,
     __in_z LPCWSTR wzString
     );
+static WCHAR GetEscapeCharacter(
+    __in WCHAR wch
+    );
 
 
 
@@ -54,24 +96,46 @@ DAPI_(HRESULT) JsonInitializeReader(
     )
 {
     HRESULT hr = S_OK;
+    SIZE_T cchJson = 0;
 
     memset(pReader, 0, sizeof(JSON_READER));
     ::InitializeCriticalSection(&pReader->cs);
 
-    hr = StrAllocString(&pReader->sczJson, wzJson, 0);
+    hr = ::StringCchLengthW(wzJson, STRSAFE_MAX_CCH, reinterpret_cast<size_t*>(&cchJson));
+    JsonExitOnRootFailure(hr, "Failed to get length of json string.");
+
+    hr = StrAllocString(&pReader->sczJson, wzJson, cchJson);
     JsonExitOnFailure(hr, "Failed to allocate json string.");
 
     pReader->pwz = pReader->sczJson;
+    pReader->pwzEnd = pReader->sczJson + cchJson;
 
 LExit:
     return hr;
 }
 
 
+DAPI_(HRESULT) JsonInitializeReaderFromBuffer(
+    __in_ecount(cchJson) LPCWSTR wzJson,
+    __in SIZE_T cchJson,
+    __in JSON_READER* pReader
+    )
+{
+    memset(pReader, 0, sizeof(JSON_READER));
+    ::InitializeCriticalSection(&pReader->cs);
+
+    pReader->pwz = wzJson;
+    pReader->pwzEnd = wzJson + cchJson;
+
+    return S_OK;
+}
+
+
 DAPI_(void) JsonUninitializeReader(
     __in JSON_READER* pReader
     )
 {
+    ReleaseMem(pReader->rgTokenStack);
     ReleaseStr(pReader->sczJson);
 
     ::DeleteCriticalSection(&pReader->cs);
@@ -79,104 +143,50 @@ DAPI_(void) JsonUninitializeReader(
 }
 
 
-static HRESULT NextToken(
+DAPI_(HRESULT) JsonReadNext(
     __in JSON_READER* pReader,
-    __out JSON_TOKEN* pToken
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
     )
 {
     HRESULT hr = S_OK;
 
-    // Skip whitespace.
-    while (L' ' == *pReader->pwz ||
-        L'\t' == *pReader->pwz ||
-        L'\r' == *pReader->pwz ||
-        L'\n' == *pReader->pwz ||
-        L',' == *pReader->pwz)
-    {
-        ++pReader->pwz;
-    }
+    ::EnterCriticalSection(&pReader->cs);
 
-    switch (*pReader->pwz)
+    hr = NextToken(pReader, pToken, pValue);
+    if (E_NOMOREITEMS == hr)
     {
-    case L'{':
-        *pToken = JSON_TOKEN_OBJECT_START;
-        break;
-
-    case L':': // begin object value
-        *pToken = JSON_TOKEN_OBJECT_VALUE;
-        break;
-
-    case L'}': // end object
-        *pToken = JSON_TOKEN_OBJECT_END;
-        break;
-
-    case L'[': // begin array
-        *pToken = JSON_TOKEN_ARRAY_START;
-        break;
-
-    case L']': // end array
-        *pToken = JSON_TOKEN_ARRAY_END;
-        break;
-
-    case L'"': // string
-        *pToken = JSON_TOKEN_OBJECT_START == *pToken ? JSON_TOKEN_VALUE : JSON_TOKEN_OBJECT_KEY;
-        break;
-
-    case L't': // true
-    case L'f': // false
-    case L'n': // null
-    case L'-': // number
-    case L'0':
-    case L'1':
-    case L'2':
-    case L'3':
-    case L'4':
-    case L'5':
-    case L'6':
-    case L'7':
-    case L'8':
-    case L'9':
-        *pToken = JSON_TOKEN_VALUE;
-        break;
-
-    case L'\0':
-        hr = E_NOMOREITEMS;
-        break;
-
-    default:
-        hr = E_INVALIDSTATE;
+        ExitFunction();
     }
+    JsonExitOnFailure(hr, "Failed to get next token.");
 
+LExit:
+    ::LeaveCriticalSection(&pReader->cs);
     return hr;
 }
 
 
-DAPI_(HRESULT) JsonReadNext(
+DAPI_(HRESULT) JsonReadValue(
     __in JSON_READER* pReader,
-    __out JSON_TOKEN* pToken,
-    __out JSON_VALUE* pValue
+    __in JSON_VALUE* pValue
     )
 {
     HRESULT hr = S_OK;
-    //WCHAR wz;
-    //JSON_TOKEN token = JSON_TOKEN_NONE;
+    JSON_TOKEN token = JSON_TOKEN_NONE;
 
     ::EnterCriticalSection(&pReader->cs);
 
-    hr = NextToken(pReader, pToken);
+    hr = NextToken(pReader, &token, pValue);
     if (E_NOMOREITEMS == hr)
     {
         ExitFunction();
     }
     JsonExitOnFailure(hr, "Failed to get next token.");
 
-    if (JSON_TOKEN_VALUE == *pToken)
-    {
-        hr = JsonReadValue(pReader, pValue);
-    }
-    else
+    if (JSON_TOKEN_VALUE != token)
     {
-        ++pReader->pwz;
+        hr = E_INVALIDDATA;
+        JsonExitOnRootFailure(hr, "Expected JSON value but found token: %d", token);
     }
 
 LExit:
@@ -185,14 +195,134 @@ LExit:
 }
 
 
-DAPI_(HRESULT) JsonReadValue(
-    __in JSON_READER* /*pReader*/,
-    __in JSON_VALUE* /*pValue*/
+DAPI_(HRESULT) JsonUnescapeString(
+    __in const JSON_VALUE* pValue,
+    __deref_out_z LPWSTR* psczValue
     )
 {
     HRESULT hr = S_OK;
+    LPCWSTR pwz = pValue->wzValue;
+    LPCWSTR pwzEnd = pValue->wzValue + pValue->cchValue;
+    LPWSTR pwzTarget = NULL;
+
+    if (JSON_VALUE_TYPE_STRING != pValue->type)
+    {
+        hr = E_INVALIDARG;
+        JsonExitOnRootFailure(hr, "Only JSON string values can be unescaped.");
+    }
+
+    // The unescaped string is never longer than the escaped one.
+    hr = StrAlloc(psczValue, pValue->cchValue + 1);
+    JsonExitOnFailure(hr, "Failed to allocate unescaped JSON string.");
+
+    pwzTarget = *psczValue;
+
+    if (!pValue->fEscaped)
+    {
+        memcpy_s(pwzTarget, pValue->cchValue * sizeof(WCHAR), pwz, pValue->cchValue * sizeof(WCHAR));
+        pwzTarget += pValue->cchValue;
+        ExitFunction();
+    }
+
+    while (pwz < pwzEnd)
+    {
+        if (L'\\' != *pwz)
+        {
+            *pwzTarget = *pwz;
+            ++pwzTarget;
+            ++pwz;
+            continue;
+        }
+
+        ++pwz;
+        if (pwz >= pwzEnd)
+        {
+            hr = E_INVALIDDATA;
+            JsonExitOnRootFailure(hr, "JSON string ends with an incomplete escape sequence.");
+        }
+
+        switch (*pwz)
+        {
+        case L'"':
+        case L'\\':
+        case L'/':
+            *pwzTarget = *pwz;
+            break;
+
+        case L'b':
+            *pwzTarget = L'\b';
+            break;
+
+        case L'f':
+            *pwzTarget = L'\f';
+            break;
+
+        case L'n':
+            *pwzTarget = L'\n';
+            break;
+
+        case L'r':
+            *pwzTarget = L'\r';
+            break;
+
+        case L't':
+            *pwzTarget = L'\t';
+            break;
+
+        case L'u':
+        {
+            WCHAR wch = 0;
+
+            if (pwzEnd - pwz < 5)
+            {
+                hr = E_INVALIDDATA;
+                JsonExitOnRootFailure(hr, "JSON string contains an incomplete unicode escape sequence.");
+            }
+
+            for (DWORD i = 1; i <= 4; ++i)
+            {
+                WCHAR wchDigit = pwz[i];
+
+                wch <<= 4;
+                if (L'0' <= wchDigit && L'9' >= wchDigit)
+                {
+                    wch |= wchDigit - L'0';
+                }
+                else if (L'a' <= wchDigit && L'f' >= wchDigit)
+                {
+                    wch |= wchDigit - L'a' + 10;
+                }
+                else if (L'A' <= wchDigit && L'F' >= wchDigit)
+                {
+                    wch |= wchDigit - L'A' + 10;
+                }
+                else
+                {
+                    hr = E_INVALIDDATA;
+                    JsonExitOnRootFailure(hr, "JSON string contains an invalid unicode escape sequence.");
+                }
+            }
+
+            *pwzTarget = wch;
+            pwz += 4;
+            break;
+        }
+
+        default:
+            hr = E_INVALIDDATA;
+            JsonExitOnRootFailure(hr, "JSON string contains an invalid escape sequence: \\%lc", *pwz);
+        }
+
+        ++pwzTarget;
+        ++pwz;
+    }
+
+LExit:
+    if (pwzTarget)
+    {
+        *pwzTarget = L'\0';
+    }
 
-//LExit:
     return hr;
 }
 
@@ -220,22 +350,56 @@ DAPI_(void) JsonUninitializeWriter(
 }
 
 
+DAPI_(HRESULT) JsonReserveWriter(
+    __in JSON_WRITER* pWriter,
+    __in DWORD cchReserve
+    )
+{
+    HRESULT hr = S_OK;
+
+    ::EnterCriticalSection(&pWriter->cs);
+
+    if (cchReserve > pWriter->cchJson)
+    {
+        hr = EnsureWriterBuffer(pWriter, cchReserve - pWriter->cchJson);
+        JsonExitOnFailure(hr, "Failed to reserve JSON writer buffer.");
+    }
+
+LExit:
+    ::LeaveCriticalSection(&pWriter->cs);
+    return hr;
+}
+
+
+DAPI_(void) JsonResetWriter(
+    __in JSON_WRITER* pWriter
+    )
+{
+    ::EnterCriticalSection(&pWriter->cs);
+
+    pWriter->cchJson = 0;
+    if (pWriter->sczJson)
+    {
+        *pWriter->sczJson = L'\0';
+    }
+
+    pWriter->cTokens = 0;
+
+    ::LeaveCriticalSection(&pWriter->cs);
+}
+
+
 DAPI_(HRESULT) JsonWriteBool(
     __in JSON_WRITER* pWriter,
     __in BOOL fValue
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczValue = NULL;
 
-    hr = StrAllocString(&sczValue, fValue ? L"true" : L"false", 0);
-    JsonExitOnFailure(hr, "Failed to convert boolean to string.");
-
-    hr = DoValue(pWriter, sczValue);
+    hr = fValue ? DoValue(pWriter, L"true", 4, FALSE) : DoValue(pWriter, L"false", 5, FALSE);
     JsonExitOnFailure(hr, "Failed to add boolean to JSON.");
 
 LExit:
-    ReleaseStr(sczValue);
     return hr;
 }
 
@@ -246,16 +410,48 @@ DAPI_(HRESULT) JsonWriteNumber(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczValue = NULL;
 
-    hr = StrAllocFormatted(&sczValue, L"%u", dwValue);
-    JsonExitOnFailure(hr, "Failed to convert number to string.");
+    hr = JsonWriteNumber64(pWriter, dwValue);
+    JsonExitOnFailure(hr, "Failed to add number to JSON.");
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonWriteNumber64(
+    __in JSON_WRITER* pWriter,
+    __in DWORD64 qwValue
+    )
+{
+    HRESULT hr = S_OK;
+    WCHAR wzValue[21] = { };
+    size_t cchValue = 0;
+
+    hr = ::StringCchPrintfW(wzValue, countof(wzValue), L"%I64u", qwValue);
+    JsonExitOnRootFailure(hr, "Failed to convert number to string.");
 
-    hr = DoValue(pWriter, sczValue);
+    hr = ::StringCchLengthW(wzValue, countof(wzValue), &cchValue);
+    JsonExitOnRootFailure(hr, "Failed to get length of number string.");
+
+    hr = DoValue(pWriter, wzValue, static_cast<DWORD>(cchValue), FALSE);
     JsonExitOnFailure(hr, "Failed to add number to JSON.");
 
 LExit:
-    ReleaseStr(sczValue);
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonWriteNull(
+    __in JSON_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = DoValue(pWriter, NULL, 0, FALSE);
+    JsonExitOnFailure(hr, "Failed to add null to JSON.");
+
+LExit:
     return hr;
 }
 
@@ -266,16 +462,11 @@ DAPI_(HRESULT) JsonWriteString(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczJsonString = NULL;
-
-    hr = SerializeJsonString(&sczJsonString, wzValue);
-    JsonExitOnFailure(hr, "Failed to allocate string JSON.");
 
-    hr = DoValue(pWriter, sczJsonString);
+    hr = DoValue(pWriter, wzValue, 0, TRUE);
     JsonExitOnFailure(hr, "Failed to add string to JSON.");
 
 LExit:
-    ReleaseStr(sczJsonString);
     return hr;
 }
 
@@ -286,7 +477,7 @@ DAPI_(HRESULT) JsonWriteArrayStart(
 {
     HRESULT hr = S_OK;
 
-    hr = DoStart(pWriter, JSON_TOKEN_ARRAY_START, L"[");
+    hr = DoStart(pWriter, JSON_TOKEN_ARRAY_START, L'[');
     JsonExitOnFailure(hr, "Failed to start JSON array.");
 
 LExit:
@@ -300,7 +491,7 @@ DAPI_(HRESULT) JsonWriteArrayEnd(
 {
     HRESULT hr = S_OK;
 
-    hr = DoEnd(pWriter, JSON_TOKEN_ARRAY_END, L"]");
+    hr = DoEnd(pWriter, JSON_TOKEN_ARRAY_END, L']');
     JsonExitOnFailure(hr, "Failed to end JSON array.");
 
 LExit:
@@ -314,7 +505,7 @@ DAPI_(HRESULT) JsonWriteObjectStart(
 {
     HRESULT hr = S_OK;
 
-    hr = DoStart(pWriter, JSON_TOKEN_OBJECT_START, L"{");
+    hr = DoStart(pWriter, JSON_TOKEN_OBJECT_START, L'{');
     JsonExitOnFailure(hr, "Failed to start JSON object.");
 
 LExit:
@@ -328,16 +519,11 @@ DAPI_(HRESULT) JsonWriteObjectKey(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczObjectKey = NULL;
 
-    hr = StrAllocFormatted(&sczObjectKey, L"\"%ls\":", wzKey);
-    JsonExitOnFailure(hr, "Failed to allocate JSON object key.");
-
-    hr = DoKey(pWriter, sczObjectKey);
+    hr = DoKey(pWriter, wzKey);
     JsonExitOnFailure(hr, "Failed to add object key to JSON.");
 
 LExit:
-    ReleaseStr(sczObjectKey);
     return hr;
 }
 
@@ -348,7 +534,7 @@ DAPI_(HRESULT) JsonWriteObjectEnd(
 {
     HRESULT hr = S_OK;
 
-    hr = DoEnd(pWriter, JSON_TOKEN_OBJECT_END, L"}");
+    hr = DoEnd(pWriter, JSON_TOKEN_OBJECT_END, L'}');
     JsonExitOnFailure(hr, "Failed to end JSON object.");
 
 LExit:
@@ -356,10 +542,348 @@ LExit:
 }
 
 
+static HRESULT NextToken(
+    __in JSON_READER* pReader,
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    JSON_TOKEN token = JSON_TOKEN_NONE;
+    JSON_TOKEN* pState = NULL;
+    BOOL fAfterComma = FALSE;
+
+    memset(pValue, 0, sizeof(JSON_VALUE));
+
+    hr = EnsureTokenStack(&pReader->rgTokenStack, &pReader->cMaxTokens, pReader->cTokens);
+    JsonExitOnFailure(hr, "Failed to ensure token stack for reader.");
+
+    if (0 == pReader->cTokens)
+    {
+        pReader->rgTokenStack[0] = JSON_TOKEN_NONE;
+        ++pReader->cTokens;
+    }
+
+    pState = pReader->rgTokenStack + pReader->cTokens - 1;
+
+    SkipWhitespace(pReader);
+
+    // Consume the separator that is expected in the current state.
+    switch (*pState)
+    {
+    case JSON_TOKEN_OBJECT_KEY:
+        if (pReader->pwz >= pReader->pwzEnd || L':' != *pReader->pwz)
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        ++pReader->pwz;
+        SkipWhitespace(pReader);
+        break;
+
+    case JSON_TOKEN_OBJECT_VALUE:
+    case JSON_TOKEN_ARRAY_VALUE:
+        if (pReader->pwz < pReader->pwzEnd && L',' == *pReader->pwz)
+        {
+            *pState = JSON_TOKEN_OBJECT_VALUE == *pState ? JSON_TOKEN_OBJECT_START : JSON_TOKEN_ARRAY_START;
+            fAfterComma = TRUE;
+
+            ++pReader->pwz;
+            SkipWhitespace(pReader);
+        }
+        break;
+
+    case JSON_TOKEN_VALUE:
+        ExitFunction1(hr = pReader->pwz < pReader->pwzEnd ? E_INVALIDDATA : E_NOMOREITEMS);
+
+    default:
+        break;
+    }
+
+    if (pReader->pwz >= pReader->pwzEnd)
+    {
+        ExitFunction1(hr = (1 == pReader->cTokens && JSON_TOKEN_NONE == *pState) ? E_NOMOREITEMS : E_INVALIDDATA);
+    }
+
+    switch (*pReader->pwz)
+    {
+    case L'{':
+    case L'[':
+        token = L'{' == *pReader->pwz ? JSON_TOKEN_OBJECT_START : JSON_TOKEN_ARRAY_START;
+        if (JSON_TOKEN_OBJECT_START == *pState || JSON_TOKEN_OBJECT_VALUE == *pState || JSON_TOKEN_ARRAY_VALUE == *pState)
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        // The container is the value of the enclosing state.
+        *pState = JSON_TOKEN_NONE == *pState ? JSON_TOKEN_VALUE : JSON_TOKEN_OBJECT_KEY == *pState ? JSON_TOKEN_OBJECT_VALUE : JSON_TOKEN_ARRAY_VALUE;
+
+        hr = EnsureTokenStack(&pReader->rgTokenStack, &pReader->cMaxTokens, pReader->cTokens);
+        JsonExitOnFailure(hr, "Failed to grow token stack for reader.");
+
+        pReader->rgTokenStack[pReader->cTokens] = token;
+        ++pReader->cTokens;
+        ++pReader->pwz;
+        break;
+
+    case L'}':
+    case L']':
+        token = L'}' == *pReader->pwz ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END;
+
+        // A comma must be followed by another key or value, never the end of the container.
+        if (fAfterComma ||
+            JSON_TOKEN_OBJECT_END == token && JSON_TOKEN_OBJECT_START != *pState && JSON_TOKEN_OBJECT_VALUE != *pState ||
+            JSON_TOKEN_ARRAY_END == token && JSON_TOKEN_ARRAY_START != *pState && JSON_TOKEN_ARRAY_VALUE != *pState)
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        --pReader->cTokens;
+        ++pReader->pwz;
+        break;
+
+    default:
+        if (JSON_TOKEN_OBJECT_START == *pState)
+        {
+            if (L'"' != *pReader->pwz)
+            {
+                ExitFunction1(hr = E_INVALIDDATA);
+            }
+
+            token = JSON_TOKEN_OBJECT_KEY;
+        }
+        else if (JSON_TOKEN_OBJECT_VALUE == *pState || JSON_TOKEN_ARRAY_VALUE == *pState)
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+        else
+        {
+            token = JSON_TOKEN_VALUE;
+        }
+
+        hr = ReadScalar(pReader, pValue);
+        JsonExitOnFailure(hr, "Failed to read JSON value.");
+
+        *pState = JSON_TOKEN_OBJECT_KEY == token ? JSON_TOKEN_OBJECT_KEY : JSON_TOKEN_NONE == *pState ? JSON_TOKEN_VALUE : JSON_TOKEN_OBJECT_KEY == *pState ? JSON_TOKEN_OBJECT_VALUE : JSON_TOKEN_ARRAY_VALUE;
+        break;
+    }
+
+    pReader->token = token;
+    *pToken = token;
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT ReadScalar(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR pwz = pReader->pwz;
+    LPCWSTR pwzEnd = pReader->pwzEnd;
+
+    switch (*pwz)
+    {
+    case L'"':
+        ++pwz;
+        pValue->type = JSON_VALUE_TYPE_STRING;
+        pValue->wzValue = pwz;
+
+        // Scan to the closing quote, only noting escapes so the common case is a straight scan.
+        while (pwz < pwzEnd && L'"' != *pwz)
+        {
+            if (L'\\' == *pwz)
+            {
+                pValue->fEscaped = TRUE;
+                ++pwz;
+            }
+
+            ++pwz;
+        }
+
+        if (pwz >= pwzEnd)
+        {
+            hr = E_INVALIDDATA;
+            JsonExitOnRootFailure(hr, "Unterminated JSON string.");
+        }
+
+        pValue->cchValue = static_cast<DWORD>(pwz - pValue->wzValue);
+        pReader->pwz = pwz + 1;
+        break;
+
+    case L't':
+        if (!MatchLiteral(pReader, L"true", 4))
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        pValue->type = JSON_VALUE_TYPE_TRUE;
+        break;
+
+    case L'f':
+        if (!MatchLiteral(pReader, L"false", 5))
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        pValue->type = JSON_VALUE_TYPE_FALSE;
+        break;
+
+    case L'n':
+        if (!MatchLiteral(pReader, L"null", 4))
+        {
+            ExitFunction1(hr = E_INVALIDDATA);
+        }
+
+        pValue->type = JSON_VALUE_TYPE_NULL;
+        break;
+
+    case L'-':
+    case L'0':
+    case L'1':
+    case L'2':
+    case L'3':
+    case L'4':
+    case L'5':
+    case L'6':
+    case L'7':
+    case L'8':
+    case L'9':
+        pValue->type = JSON_VALUE_TYPE_NUMBER;
+        pValue->wzValue = pwz;
+
+        pwz = ScanNumber(pwz, pwzEnd);
+        if (!pwz)
+        {
+            hr = E_INVALIDDATA;
+            JsonExitOnRootFailure(hr, "Invalid JSON number.");
+        }
+
+        pValue->cchValue = static_cast<DWORD>(pwz - pValue->wzValue);
+        pReader->pwz = pwz;
+        break;
+
+    default:
+        hr = E_INVALIDDATA;
+        JsonExitOnRootFailure(hr, "Unexpected character in JSON: %lc", *pwz);
+    }
+
+LExit:
+    return hr;
+}
+
+
+static BOOL MatchLiteral(
+    __in JSON_READER* pReader,
+    __in_z LPCWSTR wzLiteral,
+    __in DWORD cchLiteral
+    )
+{
+    if (static_cast<DWORD>(pReader->pwzEnd - pReader->pwz) < cchLiteral ||
+        0 != memcmp(pReader->pwz, wzLiteral, cchLiteral * sizeof(WCHAR)))
+    {
+        return FALSE;
+    }
+
+    pReader->pwz += cchLiteral;
+    return TRUE;
+}
+
+
+// Returns the end of the number starting at pwz, or NULL if it is not a valid JSON number:
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static LPCWSTR ScanNumber(
+    __in LPCWSTR pwz,
+    __in LPCWSTR pwzEnd
+    )
+{
+    LPCWSTR pwzDigits = NULL;
+
+    if (pwz < pwzEnd && L'-' == *pwz)
+    {
+        ++pwz;
+    }
+
+    if (pwz < pwzEnd && L'0' == *pwz)
+    {
+        ++pwz;
+    }
+    else
+    {
+        pwzDigits = pwz;
+        pwz = ScanDigits(pwz, pwzEnd);
+        if (pwz == pwzDigits)
+        {
+            return NULL;
+        }
+    }
+
+    if (pwz < pwzEnd && L'.' == *pwz)
+    {
+        pwzDigits = ++pwz;
+        pwz = ScanDigits(pwz, pwzEnd);
+        if (pwz == pwzDigits)
+        {
+            return NULL;
+        }
+    }
+
+    if (pwz < pwzEnd && (L'e' == *pwz || L'E' == *pwz))
+    {
+        ++pwz;
+        if (pwz < pwzEnd && (L'+' == *pwz || L'-' == *pwz))
+        {
+            ++pwz;
+        }
+
+        pwzDigits = pwz;
+        pwz = ScanDigits(pwz, pwzEnd);
+        if (pwz == pwzDigits)
+        {
+            return NULL;
+        }
+    }
+
+    return pwz;
+}
+
+
+static LPCWSTR ScanDigits(
+    __in LPCWSTR pwz,
+    __in LPCWSTR pwzEnd
+    )
+{
+    while (pwz < pwzEnd && L'0' <= *pwz && L'9' >= *pwz)
+    {
+        ++pwz;
+    }
+
+    return pwz;
+}
+
+
+static void SkipWhitespace(
+    __in JSON_READER* pReader
+    )
+{
+    while (pReader->pwz < pReader->pwzEnd &&
+        (L' ' == *pReader->pwz ||
+         L'\t' == *pReader->pwz ||
+         L'\r' == *pReader->pwz ||
+         L'\n' == *pReader->pwz))
+    {
+        ++pReader->pwz;
+    }
+}
+
+
 static HRESULT DoStart(
     __in JSON_WRITER* pWriter,
     __in JSON_TOKEN tokenStart,
-    __in_z LPCWSTR wzStartString
+    __in WCHAR wchStart
     )
 {
     Assert(JSON_TOKEN_ARRAY_START == tokenStart || JSON_TOKEN_OBJECT_START == tokenStart);
@@ -371,9 +895,15 @@ static HRESULT DoStart(
 
     ::EnterCriticalSection(&pWriter->cs);
 
-    hr = EnsureTokenStack(pWriter);
+    hr = EnsureTokenStack(&pWriter->rgTokenStack, &pWriter->cMaxTokens, pWriter->cTokens);
     JsonExitOnFailure(hr, "Failed to ensure token stack for start.");
 
+    if (0 == pWriter->cTokens)
+    {
+        pWriter->rgTokenStack[0] = JSON_TOKEN_NONE;
+        ++pWriter->cTokens;
+    }
+
     token = pWriter->rgTokenStack[pWriter->cTokens - 1];
     switch (token)
     {
@@ -386,9 +916,11 @@ static HRESULT DoStart(
         token = JSON_TOKEN_ARRAY_VALUE;
         break;
 
+    case JSON_TOKEN_OBJECT_KEY: // object key changes to object value.
+        token = JSON_TOKEN_OBJECT_VALUE;
+        break;
+
     case JSON_TOKEN_ARRAY_VALUE:
-    case JSON_TOKEN_ARRAY_END:
-    case JSON_TOKEN_OBJECT_END:
         fNeedComma = TRUE;
         break;
 
@@ -400,11 +932,11 @@ static HRESULT DoStart(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = AppendJson(pWriter, L",", 1);
         JsonExitOnFailure(hr, "Failed to add comma for start array or object to JSON.");
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzStartString, 0);
+    hr = AppendJson(pWriter, &wchStart, 1);
     JsonExitOnFailure(hr, "Failed to start JSON array or object.");
 
     pWriter->rgTokenStack[pWriter->cTokens - 1] = token;
@@ -423,7 +955,7 @@ LExit:
 static HRESULT DoEnd(
     __in JSON_WRITER* pWriter,
     __in JSON_TOKEN tokenEnd,
-    __in_z LPCWSTR wzEndString
+    __in WCHAR wchEnd
     )
 {
     HRESULT hr = S_OK;
@@ -446,7 +978,7 @@ static HRESULT DoEnd(
         }
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzEndString, 0);
+    hr = AppendJson(pWriter, &wchEnd, 1);
     JsonExitOnFailure(hr, "Failed to end JSON array or object.");
 
     --pWriter->cTokens;
@@ -468,8 +1000,11 @@ static HRESULT DoKey(
 
     ::EnterCriticalSection(&pWriter->cs);
 
-    hr = EnsureTokenStack(pWriter);
-    JsonExitOnFailure(hr, "Failed to ensure token stack for key.");
+    if (!pWriter->cTokens)
+    {
+        hr = E_UNEXPECTED;
+        JsonExitOnRootFailure(hr, "Cannot add key to JSON serializer before starting an object.");
+    }
 
     token = pWriter->rgTokenStack[pWriter->cTokens - 1];
     switch (token)
@@ -491,13 +1026,16 @@ static HRESULT DoKey(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = AppendJson(pWriter, L",", 1);
         JsonExitOnFailure(hr, "Failed to add comma for key to JSON.");
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzKey, 0);
+    hr = AppendJsonString(pWriter, wzKey);
     JsonExitOnFailure(hr, "Failed to add key to JSON.");
 
+    hr = AppendJson(pWriter, L":", 1);
+    JsonExitOnFailure(hr, "Failed to add key separator to JSON.");
+
     pWriter->rgTokenStack[pWriter->cTokens - 1] = token;
 
 LExit:
@@ -508,7 +1046,9 @@ LExit:
 
 static HRESULT DoValue(
     __in JSON_WRITER* pWriter,
-    __in_z_opt LPCWSTR wzValue
+    __in_ecount_opt(cchValue) LPCWSTR wzValue,
+    __in DWORD cchValue,
+    __in BOOL fString
     )
 {
     HRESULT hr = S_OK;
@@ -517,9 +1057,15 @@ static HRESULT DoValue(
 
     ::EnterCriticalSection(&pWriter->cs);
 
-    hr = EnsureTokenStack(pWriter);
+    hr = EnsureTokenStack(&pWriter->rgTokenStack, &pWriter->cMaxTokens, pWriter->cTokens);
     JsonExitOnFailure(hr, "Failed to ensure token stack for value.");
 
+    if (0 == pWriter->cTokens)
+    {
+        pWriter->rgTokenStack[0] = JSON_TOKEN_NONE;
+        ++pWriter->cTokens;
+    }
+
     token = pWriter->rgTokenStack[pWriter->cTokens - 1];
     switch (token)
     {
@@ -547,19 +1093,24 @@ static HRESULT DoValue(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = AppendJson(pWriter, L",", 1);
         JsonExitOnFailure(hr, "Failed to add comma for value to JSON.");
     }
 
-    if (wzValue)
+    if (!wzValue)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, wzValue, 0);
-        JsonExitOnFailure(hr, "Failed to add value to JSON.");
+        hr = AppendJson(pWriter, L"null", 4);
+        JsonExitOnFailure(hr, "Failed to add null value to JSON.");
+    }
+    else if (fString)
+    {
+        hr = AppendJsonString(pWriter, wzValue);
+        JsonExitOnFailure(hr, "Failed to add string value to JSON.");
     }
     else
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L"null", 0);
-        JsonExitOnFailure(hr, "Failed to add null value to JSON.");
+        hr = AppendJson(pWriter, wzValue, cchValue);
+        JsonExitOnFailure(hr, "Failed to add value to JSON.");
     }
 
     pWriter->rgTokenStack[pWriter->cTokens - 1] = token;
@@ -571,117 +1122,217 @@ LExit:
 
 
 static HRESULT EnsureTokenStack(
-    __in JSON_WRITER* pWriter
+    __inout JSON_TOKEN** prgTokenStack,
+    __inout DWORD* pcMaxTokens,
+    __in DWORD cTokens
     )
 {
     HRESULT hr = S_OK;
-    DWORD cNumAlloc = pWriter->cTokens != 0 ? pWriter->cTokens : 0;
+    JSON_TOKEN* rgNew = NULL;
+    DWORD cNewMax = 0;
 
-    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pWriter->rgTokenStack), cNumAlloc, sizeof(JSON_TOKEN), JSON_STACK_INCREMENT);
-    JsonExitOnFailure(hr, "Failed to allocate JSON token stack.");
+    // Always leave room to push one more token.
+    if (cTokens + 1 < *pcMaxTokens)
+    {
+        ExitFunction();
+    }
 
-    if (0 == pWriter->cTokens)
+    if (!*prgTokenStack)
     {
-        pWriter->rgTokenStack[0] = JSON_TOKEN_NONE;
-        ++pWriter->cTokens;
+        cNewMax = JSON_MIN_TOKEN_STACK;
+
+        rgNew = static_cast<JSON_TOKEN*>(MemAlloc(cNewMax * sizeof(JSON_TOKEN), TRUE));
+        JsonExitOnNull(rgNew, hr, E_OUTOFMEMORY, "Failed to allocate JSON token stack.");
+    }
+    else
+    {
+        hr = ::DWordMult(*pcMaxTokens, 2, &cNewMax);
+        JsonExitOnRootFailure(hr, "JSON token stack is too deep.");
+
+        rgNew = static_cast<JSON_TOKEN*>(MemReAlloc(*prgTokenStack, cNewMax * sizeof(JSON_TOKEN), TRUE));
+        JsonExitOnNull(rgNew, hr, E_OUTOFMEMORY, "Failed to grow JSON token stack.");
     }
 
+    *prgTokenStack = rgNew;
+    *pcMaxTokens = cNewMax;
+
 LExit:
     return hr;
 }
 
 
-static HRESULT SerializeJsonString(
-    __out_z LPWSTR* psczJsonString,
-    __in_z LPCWSTR wzString
+static HRESULT EnsureWriterBuffer(
+    __in JSON_WRITER* pWriter,
+    __in DWORD cchAdditional
     )
 {
     HRESULT hr = S_OK;
-    DWORD cchRequired = 3; // start with enough space for null terminated empty quoted string (aka: ""\0)
+    DWORD cchRequired = 0;
+    DWORD cchAlloc = 0;
 
-    for (LPCWSTR pch = wzString; *pch; ++pch)
+    // Leave room for the null terminator.
+    hr = ::DWordAdd(pWriter->cchJson, cchAdditional, &cchRequired);
+    JsonExitOnRootFailure(hr, "JSON is too large.");
+
+    hr = ::DWordAdd(cchRequired, 1, &cchRequired);
+    JsonExitOnRootFailure(hr, "JSON is too large.");
+
+    if (cchRequired <= pWriter->cchJsonAlloc)
     {
-        // If it is a special JSON character, add space for the escape backslash.
-        if (L'"' == *pch || L'\\' == *pch || L'/' == *pch || L'\b' == *pch || L'\f' == *pch || L'\n' == *pch || L'\r' == *pch || L'\t' == *pch)
-        {
-            ++cchRequired;
-        }
+        ExitFunction();
+    }
 
-        ++cchRequired;
+    // Grow geometrically so appends are amortized O(1).
+    cchAlloc = max(JSON_MIN_BUFFER_ALLOC, pWriter->cchJsonAlloc);
+    while (cchAlloc < cchRequired)
+    {
+        hr = ::DWordMult(cchAlloc, 2, &cchAlloc);
+        JsonExitOnRootFailure(hr, "JSON is too large.");
     }
 
-    hr = StrAlloc(psczJsonString, cchRequired);
-    JsonExitOnFailure(hr, "Failed to allocate space for JSON string.");
+    hr = StrAlloc(&pWriter->sczJson, cchAlloc);
+    JsonExitOnFailure(hr, "Failed to grow JSON buffer.");
 
-    LPWSTR pchTarget = *psczJsonString;
+    pWriter->cchJsonAlloc = cchAlloc;
+    pWriter->sczJson[pWriter->cchJson] = L'\0';
 
-    *pchTarget = L'\"';
-    ++pchTarget;
+LExit:
+    return hr;
+}
 
-    for (LPCWSTR pch = wzString; *pch; ++pch, ++pchTarget)
-    {
-        // If it is a special JSON character, handle it or just add the character as is.
-        switch (*pch)
-        {
-        case L'"':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'"';
-            break;
 
-        case L'\\':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'\\';
-            break;
+static HRESULT AppendJson(
+    __in JSON_WRITER* pWriter,
+    __in_ecount(cch) LPCWSTR wz,
+    __in DWORD cch
+    )
+{
+    HRESULT hr = S_OK;
 
-        case L'/':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'/';
-            break;
+    hr = EnsureWriterBuffer(pWriter, cch);
+    JsonExitOnFailure(hr, "Failed to ensure JSON buffer.");
 
-        case L'\b':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'b';
-            break;
+    memcpy_s(pWriter->sczJson + pWriter->cchJson, (pWriter->cchJsonAlloc - pWriter->cchJson) * sizeof(WCHAR), wz, cch * sizeof(WCHAR));
+    pWriter->cchJson += cch;
+    pWriter->sczJson[pWriter->cchJson] = L'\0';
 
-        case L'\f':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'f';
-            break;
+LExit:
+    return hr;
+}
 
-        case L'\n':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'n';
-            break;
 
-        case L'\r':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L'r';
-            break;
+static HRESULT AppendJsonString(
+    __in JSON_WRITER* pWriter,
+    __in_z LPCWSTR wzString
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cchString = 0;
+    DWORD cchRequired = 2; // start with enough space for the quotes.
+    LPWSTR pchTarget = NULL;
+    LPCWSTR pchRun = wzString;
 
-        case L'\t':
-            *pchTarget = L'\\';
-            ++pchTarget;
-            *pchTarget = L't';
-            break;
+    // Single scan to size the escaped string.
+    for (LPCWSTR pch = wzString; *pch; ++pch)
+    {
+        WCHAR wchEscape = GetEscapeCharacter(*pch);
 
-        default:
-            *pchTarget = *pch;
-            break;
+        if (wchEscape)
+        {
+            cchRequired += L'u' == wchEscape ? 5 : 1;
         }
 
+        ++cchString;
+    }
+
+    hr = ::DWordAdd(cchRequired, cchString, &cchRequired);
+    JsonExitOnRootFailure(hr, "JSON string is too large.");
+
+    hr = EnsureWriterBuffer(pWriter, cchRequired);
+    JsonExitOnFailure(hr, "Failed to allocate space for JSON string.");
+
+    pchTarget = pWriter->sczJson + pWriter->cchJson;
+
+    *pchTarget = L'\"';
+    ++pchTarget;
+
+    if (cchRequired == cchString + 2)
+    {
+        // Fast path: nothing to escape so copy the whole string at once.
+        memcpy_s(pchTarget, cchString * sizeof(WCHAR), wzString, cchString * sizeof(WCHAR));
+        pchTarget += cchString;
+    }
+    else
+    {
+        for (LPCWSTR pch = wzString; ; ++pch)
+        {
+            WCHAR wchEscape = *pch ? GetEscapeCharacter(*pch) : L'\0';
+
+            if (!*pch || wchEscape)
+            {
+                // Copy the run of characters that did not need escaping.
+                SIZE_T cchRun = pch - pchRun;
+                memcpy_s(pchTarget, cchRun * sizeof(WCHAR), pchRun, cchRun * sizeof(WCHAR));
+                pchTarget += cchRun;
+                pchRun = pch + 1;
+
+                if (!*pch)
+                {
+                    break;
+                }
+
+                *pchTarget = L'\\';
+                ++pchTarget;
+                *pchTarget = wchEscape;
+                ++pchTarget;
+
+                if (L'u' == wchEscape)
+                {
+                    static const WCHAR wzHex[] = L"0123456789abcdef";
+
+                    pchTarget[0] = L'0';
+                    pchTarget[1] = L'0';
+                    pchTarget[2] = wzHex[(*pch >> 4) & 0xF];
+                    pchTarget[3] = wzHex[*pch & 0xF];
+                    pchTarget += 4;
+                }
+            }
+        }
     }
 
     *pchTarget = L'\"';
     ++pchTarget;
     *pchTarget = L'\0';
 
+    pWriter->cchJson += cchRequired;
+
 LExit:
     return hr;
 }
+
+
+static WCHAR GetEscapeCharacter(
+    __in WCHAR wch
+    )
+{
+    if (L' ' <= wch)
+    {
+        return (L'"' == wch || L'\\' == wch || L'/' == wch) ? wch : L'\0';
+    }
+
+    switch (wch)
+    {
+    case L'\b':
+        return L'b';
+    case L'\f':
+        return L'f';
+    case L'\n':
+        return L'n';
+    case L'\r':
+        return L'r';
+    case L'\t':
+        return L't';
+    default:
+        return L'u';
+    }
+}
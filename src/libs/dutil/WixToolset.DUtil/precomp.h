@@ -23,6 +23,7 @@
 #include <psapi.h>
 #include <shlobj.h>
 #include <shlwapi.h>
+#include <xmllite.h>
 #include <gdiplus.h>
 #include <Tlhelp32.h>
 #include <lm.h>
@@ -41,6 +42,11 @@
 #include <dbt.h>
 #include <ShellScalingApi.h>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
 #include "dutilsources.h"
 #include "dutil.h"
 #include "verutil.h"
@@ -17,6 +17,22 @@
 #define ProcExitOnWin32Error(e, x, s, ...) ExitOnWin32ErrorSource(DUTIL_SOURCE_PROCUTIL, e, x, s, __VA_ARGS__)
 #define ProcExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_PROCUTIL, g, x, s, __VA_ARGS__)
 
+// structs
+struct PROC_SNAPSHOT_IMAGE
+{
+    LPWSTR sczExeName;
+    DWORD* rgdwProcessIds;
+    DWORD cProcessIds;
+};
+
+struct PROC_SNAPSHOT
+{
+    STRINGDICT_HANDLE sdImages;
+    PROC_SNAPSHOT_IMAGE* rgImages;
+    DWORD cImages;
+    DWORD cProcesses;
+};
+
 /********************************************************************
  ProcFindAllIdsFromExeName() - returns an array of process ids that are running specified executable.
 
@@ -81,3 +97,143 @@ LExit:
 
     return hr;
 }
+
+
+/********************************************************************
+ ProcSnapshotCreate() - captures the running processes once, indexed by
+                        executable name, so that many names can be looked
+                        up without walking the process list for each.
+
+*******************************************************************/
+extern "C" HRESULT DAPI ProcSnapshotCreate(
+    __out PROC_SNAPSHOT_HANDLE* phSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    HANDLE hSnap = INVALID_HANDLE_VALUE;
+    BOOL fContinue = FALSE;
+    PROCESSENTRY32W peData = { sizeof(peData) };
+    PROC_SNAPSHOT* pSnapshot = NULL;
+    PROC_SNAPSHOT_IMAGE* pImage = NULL;
+
+    pSnapshot = static_cast<PROC_SNAPSHOT*>(MemAlloc(sizeof(PROC_SNAPSHOT), TRUE));
+    ProcExitOnNull(pSnapshot, hr, E_OUTOFMEMORY, "Failed to allocate process snapshot.");
+
+    hr = DictCreateWithEmbeddedKey(&pSnapshot->sdImages, 0, reinterpret_cast<void**>(&pSnapshot->rgImages), offsetof(PROC_SNAPSHOT_IMAGE, sczExeName), DICT_FLAG_CASEINSENSITIVE);
+    ProcExitOnFailure(hr, "Failed to create process snapshot index.");
+
+    hSnap = ::CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (INVALID_HANDLE_VALUE == hSnap)
+    {
+        ProcExitWithLastError(hr, "Failed to create snapshot of processes on system");
+    }
+
+    fContinue = ::Process32FirstW(hSnap, &peData);
+
+    while (fContinue)
+    {
+        hr = DictGetValue(pSnapshot->sdImages, peData.szExeFile, reinterpret_cast<void**>(&pImage));
+        if (E_NOTFOUND == hr)
+        {
+            hr = MemEnsureArraySize(reinterpret_cast<void**>(&pSnapshot->rgImages), pSnapshot->cImages + 1, sizeof(PROC_SNAPSHOT_IMAGE), 64);
+            ProcExitOnFailure(hr, "Failed to grow process snapshot images.");
+
+            pImage = pSnapshot->rgImages + pSnapshot->cImages;
+            ++pSnapshot->cImages;
+
+            hr = StrAllocString(&pImage->sczExeName, peData.szExeFile, 0);
+            ProcExitOnFailure(hr, "Failed to copy process executable name.");
+
+            hr = DictAddValue(pSnapshot->sdImages, pImage);
+            ProcExitOnFailure(hr, "Failed to index process executable name: %ls", peData.szExeFile);
+        }
+        ProcExitOnFailure(hr, "Failed to find process executable name: %ls", peData.szExeFile);
+
+        hr = MemEnsureArraySize(reinterpret_cast<void**>(&pImage->rgdwProcessIds), pImage->cProcessIds + 1, sizeof(DWORD), 4);
+        ProcExitOnFailure(hr, "Failed to grow process ids for executable: %ls", peData.szExeFile);
+
+        pImage->rgdwProcessIds[pImage->cProcessIds] = peData.th32ProcessID;
+        ++pImage->cProcessIds;
+        ++pSnapshot->cProcesses;
+
+        fContinue = ::Process32NextW(hSnap, &peData);
+    }
+
+    er = ::GetLastError();
+    if (ERROR_NO_MORE_FILES != er)
+    {
+        ProcExitOnWin32Error(er, hr, "Failed to enumerate processes on system.");
+    }
+
+    *phSnapshot = pSnapshot;
+    pSnapshot = NULL;
+
+LExit:
+    ReleaseFile(hSnap);
+    ReleaseProcSnapshot(pSnapshot);
+
+    return hr;
+}
+
+
+/********************************************************************
+ ProcSnapshotFindIds() - returns the process ids in the snapshot that are
+                         running the specified executable.
+
+ NOTE: the returned array belongs to the snapshot.
+*******************************************************************/
+extern "C" HRESULT DAPI ProcSnapshotFindIds(
+    __in C_PROC_SNAPSHOT_HANDLE hSnapshot,
+    __in_z LPCWSTR wzExeName,
+    __out_ecount(*pcProcessIds) const DWORD** prgdwProcessIds,
+    __out DWORD* pcProcessIds
+    )
+{
+    HRESULT hr = S_OK;
+    const PROC_SNAPSHOT* pSnapshot = static_cast<const PROC_SNAPSHOT*>(hSnapshot);
+    PROC_SNAPSHOT_IMAGE* pImage = NULL;
+
+    *prgdwProcessIds = NULL;
+    *pcProcessIds = 0;
+
+    hr = DictGetValue(pSnapshot->sdImages, wzExeName, reinterpret_cast<void**>(&pImage));
+    if (E_NOTFOUND == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    ProcExitOnFailure(hr, "Failed to find processes for executable: %ls", wzExeName);
+
+    *prgdwProcessIds = pImage->rgdwProcessIds;
+    *pcProcessIds = pImage->cProcessIds;
+
+LExit:
+    return hr;
+}
+
+
+extern "C" DWORD DAPI ProcSnapshotGetProcessCount(
+    __in C_PROC_SNAPSHOT_HANDLE hSnapshot
+    )
+{
+    return static_cast<const PROC_SNAPSHOT*>(hSnapshot)->cProcesses;
+}
+
+
+extern "C" void DAPI ProcSnapshotUninitialize(
+    __in PROC_SNAPSHOT_HANDLE hSnapshot
+    )
+{
+    PROC_SNAPSHOT* pSnapshot = static_cast<PROC_SNAPSHOT*>(hSnapshot);
+
+    ReleaseDict(pSnapshot->sdImages);
+
+    for (DWORD i = 0; i < pSnapshot->cImages; ++i)
+    {
+        ReleaseMem(pSnapshot->rgImages[i].rgdwProcessIds);
+        ReleaseStr(pSnapshot->rgImages[i].sczExeName);
+    }
+
+    ReleaseMem(pSnapshot->rgImages);
+    MemFree(pSnapshot);
+}
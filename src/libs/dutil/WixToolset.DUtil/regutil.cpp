@@ -291,6 +291,22 @@ extern "C" HRESULT DAPI RegKeyEnum(
     __in DWORD dwIndex,
     __deref_out_z LPWSTR* psczKey
     )
+{
+    return RegKeyEnumEx(hk, dwIndex, psczKey, NULL);
+}
+
+
+/********************************************************************
+ RegKeyEnumEx - enumerates child registry keys and the time each was
+                last written.
+
+*********************************************************************/
+extern "C" HRESULT DAPI RegKeyEnumEx(
+    __in HKEY hk,
+    __in DWORD dwIndex,
+    __deref_out_z LPWSTR* psczKey,
+    __out_opt FILETIME* pftLastWrite
+    )
 {
     HRESULT hr = S_OK;
     DWORD er = ERROR_SUCCESS;
@@ -313,7 +329,7 @@ extern "C" HRESULT DAPI RegKeyEnum(
         RegExitOnFailure(hr, "Failed to allocate string to minimum size.");
     }
 
-    er = vpfnRegEnumKeyExW(hk, dwIndex, *psczKey, &cch, NULL, NULL, NULL, NULL);
+    er = vpfnRegEnumKeyExW(hk, dwIndex, *psczKey, &cch, NULL, NULL, NULL, pftLastWrite);
     if (ERROR_MORE_DATA == er)
     {
         er = vpfnRegQueryInfoKeyW(hk, NULL, NULL, NULL, NULL, &cch, NULL, NULL, NULL, NULL, NULL, NULL);
@@ -323,7 +339,7 @@ extern "C" HRESULT DAPI RegKeyEnum(
         hr = StrAlloc(psczKey, cch);
         RegExitOnFailure(hr, "Failed to allocate string bigger for enum registry key.");
 
-        er = vpfnRegEnumKeyExW(hk, dwIndex, *psczKey, &cch, NULL, NULL, NULL, NULL);
+        er = vpfnRegEnumKeyExW(hk, dwIndex, *psczKey, &cch, NULL, NULL, NULL, pftLastWrite);
     }
     else if (ERROR_NO_MORE_ITEMS == er)
     {
@@ -270,14 +270,43 @@ extern "C" HRESULT DAPI RmuAddProcessesByName(
     HRESULT hr = S_OK;
     DWORD *pdwProcessIds = NULL;
     DWORD cProcessIds = 0;
-    BOOL fNotFound = FALSE;
 
     hr = ProcFindAllIdsFromExeName(wzProcessName, &pdwProcessIds, &cProcessIds);
     RmExitOnFailure(hr, "Failed to enumerate all the processes by name %ls.", wzProcessName);
 
+    hr = RmuAddProcessesByIds(pSession, pdwProcessIds, cProcessIds);
+    if (E_NOTFOUND != hr)
+    {
+        RmExitOnFailure(hr, "Failed to add processes %ls to the Restart Manager session.", wzProcessName);
+    }
+
+LExit:
+    ReleaseMem(pdwProcessIds);
+
+    return hr;
+}
+
+/********************************************************************
+RmuAddProcessesByIds - Adds the given processes to the Restart Manager
+                       Session, such as those found in a process
+                       snapshot.
+
+Returns E_NOTFOUND if any process could not be opened, after adding
+all of the others.
+
+********************************************************************/
+extern "C" HRESULT DAPI RmuAddProcessesByIds(
+    __in PRMU_SESSION pSession,
+    __in_ecount(cProcessIds) const DWORD* rgdwProcessIds,
+    __in DWORD cProcessIds
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fNotFound = FALSE;
+
     for (DWORD i = 0; i < cProcessIds; ++i)
     {
-        hr = RmuAddProcessById(pSession, pdwProcessIds[i]);
+        hr = RmuAddProcessById(pSession, rgdwProcessIds[i]);
         if (E_NOTFOUND == hr)
         {
             // RmuAddProcessById returns E_NOTFOUND when this setup is not elevated and OpenProcess returned access denied (target process running under another user account). 
@@ -285,7 +314,7 @@ extern "C" HRESULT DAPI RmuAddProcessesByName(
         }
         else
         {
-            RmExitOnFailure(hr, "Failed to add process %ls (%d) to the Restart Manager session.", wzProcessName, pdwProcessIds[i]);
+            RmExitOnFailure(hr, "Failed to add process %d to the Restart Manager session.", rgdwProcessIds[i]);
         }
     }
 
@@ -296,8 +325,6 @@ extern "C" HRESULT DAPI RmuAddProcessesByName(
     }
 
 LExit:
-    ReleaseMem(pdwProcessIds);
-
     return hr;
 }
 
@@ -1461,6 +1461,236 @@ static inline BYTE HexCharToByte(
 }
 
 
+/****************************************************************************
+Hex and base85 codec instruction set selection
+
+The vectorized codecs produce exactly the same output as the scalar loops;
+they only change how many bytes are handled per iteration.
+****************************************************************************/
+static volatile LONG vlCodecMaximumIsa = STR_CODEC_ISA_AVX2;
+static volatile LONG vlCodecDetectedIsa = -1;
+
+static LONG DetectCodecIsa()
+{
+    LONG lIsa = STR_CODEC_ISA_SCALAR;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    int rgInfo[4] = { };
+    int cIds = 0;
+
+    ::__cpuid(rgInfo, 0);
+    cIds = rgInfo[0];
+
+    ::__cpuid(rgInfo, 1);
+    if (rgInfo[3] & (1 << 26))
+    {
+        lIsa = STR_CODEC_ISA_SSE2;
+    }
+
+    // AVX2 also needs the OS to save the YMM registers (OSXSAVE and XCR0 bits 1 and 2).
+    if (7 <= cIds && (rgInfo[2] & (1 << 27)) && (rgInfo[2] & (1 << 28)) && 6 == (::_xgetbv(0) & 6))
+    {
+        ::__cpuidex(rgInfo, 7, 0);
+        if (rgInfo[1] & (1 << 5))
+        {
+            lIsa = STR_CODEC_ISA_AVX2;
+        }
+    }
+#endif
+
+    return lIsa;
+}
+
+static STR_CODEC_ISA GetCodecIsa()
+{
+    LONG lIsa = vlCodecDetectedIsa;
+    LONG lMaximumIsa = vlCodecMaximumIsa;
+
+    if (0 > lIsa)
+    {
+        lIsa = DetectCodecIsa();
+        ::InterlockedExchange(&vlCodecDetectedIsa, lIsa);
+    }
+
+    return static_cast<STR_CODEC_ISA>(lIsa < lMaximumIsa ? lIsa : lMaximumIsa);
+}
+
+
+/****************************************************************************
+StrCodecSetMaximumIsa - limits the instruction set used by the hex and
+base85 codecs and returns the previous limit
+
+NOTE: the codecs use the best instruction set the processor supports by default
+****************************************************************************/
+extern "C" STR_CODEC_ISA DAPI StrCodecSetMaximumIsa(
+    __in STR_CODEC_ISA isa
+    )
+{
+    return static_cast<STR_CODEC_ISA>(::InterlockedExchange(&vlCodecMaximumIsa, isa));
+}
+
+
+#if defined(_M_IX86) || defined(_M_X64)
+// Maps 4-bit values to L'0'-L'9' and L'A'-L'F' the same way StrHexEncode() does.
+static inline __m128i NibblesToHexSse2(
+    __in __m128i nibbles
+    )
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8(L'A' - L'9' - 1));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8(L'0')), letters);
+}
+
+static void HexEncodeSse2(
+    __in_ecount(cBlocks * 16) const BYTE* pbSource,
+    __in SIZE_T cBlocks,
+    __out_ecount(cBlocks * 32) LPWSTR wzDest
+    )
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (SIZE_T i = 0; i < cBlocks; ++i, pbSource += 16, wzDest += 32)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbSource));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+        __m128i lo = _mm_and_si128(bytes, mask);
+
+        // Interleave so each source byte becomes its high nibble followed by its low nibble.
+        __m128i first = NibblesToHexSse2(_mm_unpacklo_epi8(hi, lo));
+        __m128i second = NibblesToHexSse2(_mm_unpackhi_epi8(hi, lo));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest), _mm_unpacklo_epi8(first, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + 8), _mm_unpackhi_epi8(first, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + 16), _mm_unpacklo_epi8(second, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + 24), _mm_unpackhi_epi8(second, zero));
+    }
+}
+
+static inline __m256i NibblesToHexAvx2(
+    __in __m256i nibbles
+    )
+{
+    __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), _mm256_set1_epi8(L'A' - L'9' - 1));
+    return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8(L'0')), letters);
+}
+
+static void HexEncodeAvx2(
+    __in_ecount(cBlocks * 32) const BYTE* pbSource,
+    __in SIZE_T cBlocks,
+    __out_ecount(cBlocks * 64) LPWSTR wzDest
+    )
+{
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+
+    for (SIZE_T i = 0; i < cBlocks; ++i, pbSource += 32, wzDest += 64)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pbSource));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask);
+        __m256i lo = _mm256_and_si256(bytes, mask);
+
+        // Unpacking works within each 128-bit lane, so the low half of "first" holds source bytes 0-7 and its high half
+        // holds bytes 16-23; "second" holds bytes 8-15 and 24-31.
+        __m256i first = NibblesToHexAvx2(_mm256_unpacklo_epi8(hi, lo));
+        __m256i second = NibblesToHexAvx2(_mm256_unpackhi_epi8(hi, lo));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(wzDest), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(first)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(wzDest + 16), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(second)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(wzDest + 32), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(first, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(wzDest + 48), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(second, 1)));
+    }
+
+    _mm256_zeroupper();
+}
+
+// Converts each 16-bit character to the byte HexCharToByte() would return, including for characters that aren't hex digits.
+static inline __m128i HexCharsToNibblesSse2(
+    __in __m128i chars
+    )
+{
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'0' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'9' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'a' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'f' + 1)));
+    __m128i offset = _mm_set1_epi16(L'0' + (L'A' - L'9' - 1));
+
+    offset = _mm_sub_epi16(offset, _mm_and_si128(digit, _mm_set1_epi16(L'A' - L'9' - 1)));
+    offset = _mm_add_epi16(offset, _mm_and_si128(lower, _mm_set1_epi16(L'a' - L'A')));
+
+    return _mm_and_si128(_mm_sub_epi16(chars, offset), _mm_set1_epi16(0xFF));
+}
+
+// Combines pairs of 16-bit nibbles into (first << 4) | (second & 0xF), one result per 32-bit lane.
+static inline __m128i CombineNibblesSse2(
+    __in __m128i nibbles
+    )
+{
+    __m128i hi = _mm_and_si128(_mm_slli_epi32(nibbles, 4), _mm_set1_epi32(0xF0));
+    __m128i lo = _mm_and_si128(_mm_srli_epi32(nibbles, 16), _mm_set1_epi32(0x0F));
+
+    return _mm_or_si128(hi, lo);
+}
+
+static void HexDecodeSse2(
+    __in_ecount(cBlocks * 16) LPCWSTR wzSource,
+    __in SIZE_T cBlocks,
+    __out_bcount(cBlocks * 8) BYTE* pbDest
+    )
+{
+    for (SIZE_T i = 0; i < cBlocks; ++i, wzSource += 16, pbDest += 8)
+    {
+        __m128i first = CombineNibblesSse2(HexCharsToNibblesSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(wzSource))));
+        __m128i second = CombineNibblesSse2(HexCharsToNibblesSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(wzSource + 8))));
+        __m128i words = _mm_packs_epi32(first, second);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pbDest), _mm_packus_epi16(words, words));
+    }
+}
+
+static inline __m256i HexCharsToNibblesAvx2(
+    __in __m256i chars
+    )
+{
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi16(chars, _mm256_set1_epi16(L'0' - 1)), _mm256_cmpgt_epi16(_mm256_set1_epi16(L'9' + 1), chars));
+    __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi16(chars, _mm256_set1_epi16(L'a' - 1)), _mm256_cmpgt_epi16(_mm256_set1_epi16(L'f' + 1), chars));
+    __m256i offset = _mm256_set1_epi16(L'0' + (L'A' - L'9' - 1));
+
+    offset = _mm256_sub_epi16(offset, _mm256_and_si256(digit, _mm256_set1_epi16(L'A' - L'9' - 1)));
+    offset = _mm256_add_epi16(offset, _mm256_and_si256(lower, _mm256_set1_epi16(L'a' - L'A')));
+
+    return _mm256_and_si256(_mm256_sub_epi16(chars, offset), _mm256_set1_epi16(0xFF));
+}
+
+static inline __m256i CombineNibblesAvx2(
+    __in __m256i nibbles
+    )
+{
+    __m256i hi = _mm256_and_si256(_mm256_slli_epi32(nibbles, 4), _mm256_set1_epi32(0xF0));
+    __m256i lo = _mm256_and_si256(_mm256_srli_epi32(nibbles, 16), _mm256_set1_epi32(0x0F));
+
+    return _mm256_or_si256(hi, lo);
+}
+
+static void HexDecodeAvx2(
+    __in_ecount(cBlocks * 32) LPCWSTR wzSource,
+    __in SIZE_T cBlocks,
+    __out_bcount(cBlocks * 16) BYTE* pbDest
+    )
+{
+    for (SIZE_T i = 0; i < cBlocks; ++i, wzSource += 32, pbDest += 16)
+    {
+        __m256i first = CombineNibblesAvx2(HexCharsToNibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(wzSource))));
+        __m256i second = CombineNibblesAvx2(HexCharsToNibblesAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(wzSource + 16))));
+
+        // Packing works within each 128-bit lane, so put the 64-bit groups back in source order before narrowing.
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i bytes = _mm256_packus_epi16(words, words);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pbDest), _mm_unpacklo_epi64(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1)));
+    }
+
+    _mm256_zeroupper();
+}
+#endif
+
+
 /****************************************************************************
 StrHexEncode - converts an array of bytes to a text string
 
@@ -1476,7 +1706,8 @@ extern "C" HRESULT DAPI StrHexEncode(
     Assert(pbSource && wzDest);
 
     HRESULT hr = S_OK;
-    DWORD i;
+    SIZE_T i = 0;
+    SIZE_T cBlocks = 0;
     BYTE b;
 
     if (cchDest < 2 * cbSource + 1)
@@ -1484,7 +1715,26 @@ extern "C" HRESULT DAPI StrHexEncode(
         ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
     }
 
-    for (i = 0; i < cbSource; ++i)
+#if defined(_M_IX86) || defined(_M_X64)
+    switch (GetCodecIsa())
+    {
+    case STR_CODEC_ISA_AVX2:
+        cBlocks = cbSource / 32;
+        HexEncodeAvx2(pbSource, cBlocks, wzDest);
+        i = cBlocks * 32;
+        break;
+    case STR_CODEC_ISA_SSE2:
+        cBlocks = cbSource / 16;
+        HexEncodeSse2(pbSource, cBlocks, wzDest);
+        i = cBlocks * 16;
+        break;
+    }
+
+    pbSource += i;
+    wzDest += 2 * i;
+#endif
+
+    for (/* i already initialized */; i < cbSource; ++i)
     {
         b = (*pbSource) >> 4;
         *(wzDest++) = (WCHAR)(L'0' + b + ((b < 10) ? 0 : L'A'-L'9'-1));
@@ -1541,6 +1791,7 @@ extern "C" HRESULT DAPI StrHexDecode(
     HRESULT hr = S_OK;
     size_t cchSource = 0;
     size_t i = 0;
+    size_t cBlocks = 0;
     BYTE b = 0;
 
     hr = ::StringCchLengthW(wzSource, STRSAFE_MAX_CCH, &cchSource);
@@ -1553,7 +1804,26 @@ extern "C" HRESULT DAPI StrHexDecode(
         StrExitOnRootFailure(hr, "Insufficient buffer to decode string '%ls' len: %Iu into %Iu bytes.", wzSource, cchSource, cbDest);
     }
 
-    for (i = 0; i < cchSource / 2; ++i)
+#if defined(_M_IX86) || defined(_M_X64)
+    switch (GetCodecIsa())
+    {
+    case STR_CODEC_ISA_AVX2:
+        cBlocks = cchSource / 32;
+        HexDecodeAvx2(wzSource, cBlocks, pbDest);
+        i = cBlocks * 16;
+        break;
+    case STR_CODEC_ISA_SSE2:
+        cBlocks = cchSource / 16;
+        HexDecodeSse2(wzSource, cBlocks, pbDest);
+        i = cBlocks * 8;
+        break;
+    }
+
+    wzSource += 2 * i;
+    pbDest += i;
+#endif
+
+    for (/* i already initialized */; i < cchSource / 2; ++i)
     {
         b = HexCharToByte(*wzSource++);
         (*pbDest) = b << 4;
@@ -1646,6 +1916,185 @@ const BYTE Base85DecodeTable[256] =
 
 const UINT Base85PowerTable[4] = { 1, 85, 85*85, 85*85*85 };
 
+#if defined(_M_IX86) || defined(_M_X64)
+// Divides each unsigned 32-bit lane by 85: n / 85 == (n * 0xC0C0C0C1) >> 38 for every 32-bit n.
+static inline __m128i Divide85Sse2(
+    __in __m128i n
+    )
+{
+    const __m128i magic = _mm_set1_epi32(0xC0C0C0C1);
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(n, magic), 38);
+    __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), magic), 38);
+
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+// Maps base85 digits to the characters in Base85EncodeTable without a table lookup.
+static inline __m128i Base85DigitsToCharsSse2(
+    __in __m128i digits
+    )
+{
+    __m128i chars = _mm_add_epi32(digits, _mm_set1_epi32(L'!'));
+
+    chars = _mm_add_epi32(chars, _mm_and_si128(_mm_cmpgt_epi32(digits, _mm_set1_epi32(0)), _mm_set1_epi32(3)));  // skip "\"#$"
+    chars = _mm_sub_epi32(chars, _mm_cmpgt_epi32(digits, _mm_set1_epi32(1)));                                    // skip "&"
+    chars = _mm_add_epi32(chars, _mm_and_si128(_mm_cmpgt_epi32(digits, _mm_set1_epi32(22)), _mm_set1_epi32(3))); // skip "<=>"
+    chars = _mm_sub_epi32(chars, _mm_cmpgt_epi32(digits, _mm_set1_epi32(51)));                                   // skip "\\"
+    chars = _mm_sub_epi32(chars, _mm_cmpgt_epi32(digits, _mm_set1_epi32(54)));                                   // skip "`"
+
+    return chars;
+}
+
+static void Base85EncodeSse2(
+    __in_ecount(cBlocks * 16) const BYTE* pbSource,
+    __in SIZE_T cBlocks,
+    __out_ecount(cBlocks * 20) LPWSTR wzDest
+    )
+{
+    DWORD rgrgdwChars[5][4];
+
+    for (SIZE_T i = 0; i < cBlocks; ++i, pbSource += 16, wzDest += 20)
+    {
+        __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbSource));
+
+        for (DWORD j = 0; j < 4; ++j)
+        {
+            __m128i k = Divide85Sse2(n);
+            __m128i k85 = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(k, 6), _mm_slli_epi32(k, 4)), _mm_add_epi32(_mm_slli_epi32(k, 2), k));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgrgdwChars[j]), Base85DigitsToCharsSse2(_mm_sub_epi32(n, k85)));
+            n = k;
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgrgdwChars[4]), Base85DigitsToCharsSse2(n));
+
+        for (DWORD iWord = 0; iWord < 4; ++iWord)
+        {
+            for (DWORD iChar = 0; iChar < 5; ++iChar)
+            {
+                wzDest[iWord * 5 + iChar] = static_cast<WCHAR>(rgrgdwChars[iChar][iWord]);
+            }
+        }
+    }
+}
+
+static inline __m256i Divide85Avx2(
+    __in __m256i n
+    )
+{
+    const __m256i magic = _mm256_set1_epi32(0xC0C0C0C1);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, magic), 38);
+    __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), magic), 38);
+
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+static inline __m256i Base85DigitsToCharsAvx2(
+    __in __m256i digits
+    )
+{
+    __m256i chars = _mm256_add_epi32(digits, _mm256_set1_epi32(L'!'));
+
+    chars = _mm256_add_epi32(chars, _mm256_and_si256(_mm256_cmpgt_epi32(digits, _mm256_set1_epi32(0)), _mm256_set1_epi32(3)));
+    chars = _mm256_sub_epi32(chars, _mm256_cmpgt_epi32(digits, _mm256_set1_epi32(1)));
+    chars = _mm256_add_epi32(chars, _mm256_and_si256(_mm256_cmpgt_epi32(digits, _mm256_set1_epi32(22)), _mm256_set1_epi32(3)));
+    chars = _mm256_sub_epi32(chars, _mm256_cmpgt_epi32(digits, _mm256_set1_epi32(51)));
+    chars = _mm256_sub_epi32(chars, _mm256_cmpgt_epi32(digits, _mm256_set1_epi32(54)));
+
+    return chars;
+}
+
+static void Base85EncodeAvx2(
+    __in_ecount(cBlocks * 32) const BYTE* pbSource,
+    __in SIZE_T cBlocks,
+    __out_ecount(cBlocks * 40) LPWSTR wzDest
+    )
+{
+    DWORD rgrgdwChars[5][8];
+
+    for (SIZE_T i = 0; i < cBlocks; ++i, pbSource += 32, wzDest += 40)
+    {
+        __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pbSource));
+
+        for (DWORD j = 0; j < 4; ++j)
+        {
+            __m256i k = Divide85Avx2(n);
+            __m256i k85 = _mm256_mullo_epi32(k, _mm256_set1_epi32(85));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgrgdwChars[j]), Base85DigitsToCharsAvx2(_mm256_sub_epi32(n, k85)));
+            n = k;
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgrgdwChars[4]), Base85DigitsToCharsAvx2(n));
+
+        for (DWORD iWord = 0; iWord < 8; ++iWord)
+        {
+            for (DWORD iChar = 0; iChar < 5; ++iChar)
+            {
+                wzDest[iWord * 5 + iChar] = static_cast<WCHAR>(rgrgdwChars[iChar][iWord]);
+            }
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+// Maps characters to base85 digits, returning FALSE if any character isn't in Base85EncodeTable.
+static inline BOOL Base85CharsToDigitsSse2(
+    __in __m128i chars,
+    __out __m128i* pDigits
+    )
+{
+    __m128i valid = _mm_cmpeq_epi16(chars, _mm_set1_epi16(L'!'));
+    valid = _mm_or_si128(valid, _mm_cmpeq_epi16(chars, _mm_set1_epi16(L'%')));
+    valid = _mm_or_si128(valid, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'\'' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L';' + 1))));
+    valid = _mm_or_si128(valid, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'?' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'[' + 1))));
+    valid = _mm_or_si128(valid, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L']' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'_' + 1))));
+    valid = _mm_or_si128(valid, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'a' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'~' + 1))));
+
+    if (0xFFFF != _mm_movemask_epi8(valid))
+    {
+        return FALSE;
+    }
+
+    __m128i digits = _mm_sub_epi16(chars, _mm_set1_epi16(L'!'));
+    digits = _mm_sub_epi16(digits, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'%' - 1)), _mm_set1_epi16(3)));
+    digits = _mm_add_epi16(digits, _mm_cmpgt_epi16(chars, _mm_set1_epi16(L'\'' - 1)));
+    digits = _mm_sub_epi16(digits, _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'?' - 1)), _mm_set1_epi16(3)));
+    digits = _mm_add_epi16(digits, _mm_cmpgt_epi16(chars, _mm_set1_epi16(L']' - 1)));
+    digits = _mm_add_epi16(digits, _mm_cmpgt_epi16(chars, _mm_set1_epi16(L'a' - 1)));
+
+    *pDigits = digits;
+    return TRUE;
+}
+#endif
+
+// Combines five base85 digits into four bytes, returning FALSE on overflow.
+static inline BOOL Base85DigitsToWord(
+    __in_ecount(5) const WORD* rgwDigits,
+    __out_bcount(4) BYTE* pbDest
+    )
+{
+    DWORD_PTR n = rgwDigits[0] + rgwDigits[1] * static_cast<DWORD_PTR>(85) + rgwDigits[2] * static_cast<DWORD_PTR>(85 * 85) + rgwDigits[3] * static_cast<DWORD_PTR>(85 * 85 * 85);
+    DWORD_PTR k = rgwDigits[4] * static_cast<DWORD_PTR>(85 * 85 * 85 * 85);
+
+    // if (k + n > (1u << 32)) <=> (k > ~n) then decode error
+    if (k > ~n)
+    {
+        return FALSE;
+    }
+
+    n += k;
+
+    pbDest[0] = (BYTE) n;
+    pbDest[1] = (BYTE) (n >> 8);
+    pbDest[2] = (BYTE) (n >> 16);
+    pbDest[3] = (BYTE) (n >> 24);
+
+    return TRUE;
+}
+
+
 
 /****************************************************************************
 StrAllocBase85Encode - converts an array of bytes into an XML compatible string
@@ -1662,6 +2111,8 @@ extern "C" HRESULT DAPI StrAllocBase85Encode(
     LPWSTR wzDest;
     DWORD_PTR iSource = 0;
     DWORD_PTR iDest = 0;
+    SIZE_T cFullWords = 0;
+    SIZE_T cBlocks = 0;
 
     if (!pwzDest || !pbSource)
     {
@@ -1682,8 +2133,29 @@ extern "C" HRESULT DAPI StrAllocBase85Encode(
 
     wzDest = *pwzDest;
 
-    // first, encode full words
-    for (iSource = 0, iDest = 0; (iSource + 4 < cbSource) && (iDest + 5 < cchDest); iSource += 4, iDest += 5)
+#if defined(_M_IX86) || defined(_M_X64)
+    // first, encode as many full words as possible a block at a time; the last word is always left to the loops below
+    cFullWords = cbSource ? (cbSource - 1) / 4 : 0;
+
+    switch (GetCodecIsa())
+    {
+    case STR_CODEC_ISA_AVX2:
+        cBlocks = cFullWords / 8;
+        Base85EncodeAvx2(pbSource, cBlocks, wzDest);
+        iSource = cBlocks * 32;
+        iDest = cBlocks * 40;
+        break;
+    case STR_CODEC_ISA_SSE2:
+        cBlocks = cFullWords / 4;
+        Base85EncodeSse2(pbSource, cBlocks, wzDest);
+        iSource = cBlocks * 16;
+        iDest = cBlocks * 20;
+        break;
+    }
+#endif
+
+    // then, encode remaining full words
+    for (/* iSource and iDest already initialized */; (iSource + 4 < cbSource) && (iDest + 5 < cchDest); iSource += 4, iDest += 5)
     {
         DWORD n = pbSource[iSource] + (pbSource[iSource + 1] << 8) + (pbSource[iSource + 2] << 16) + (pbSource[iSource + 3] << 24);
         DWORD k = n / 85;
@@ -1756,6 +2228,7 @@ extern "C" HRESULT DAPI StrAllocBase85Decode(
     HRESULT hr = S_OK;
     size_t cchSource = 0;
     DWORD_PTR i, n, k;
+    WORD rgwDigits[40];
 
     BYTE* pbDest = 0;
     SIZE_T cbDest = 0;
@@ -1789,63 +2262,60 @@ extern "C" HRESULT DAPI StrAllocBase85Decode(
     pbDest = *ppbDest;
     *pcbDest = cbDest;
 
-    // decode full words first
-    while (5 <= cchSource)
+#if defined(_M_IX86) || defined(_M_X64)
+    // decode full words a block of eight at a time first
+    if (STR_CODEC_ISA_SSE2 <= GetCodecIsa())
     {
-        k = Base85DecodeTable[wzSource[0]];
-        if (85 == k)
+        while (40 <= cchSource)
         {
-            // illegal symbol
-            return E_UNEXPECTED;
-        }
-        n = k;
+            for (i = 0; i < 5; ++i)
+            {
+                __m128i digits;
+                if (!Base85CharsToDigitsSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(wzSource + i * 8)), &digits))
+                {
+                    // illegal symbol
+                    return E_UNEXPECTED;
+                }
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(rgwDigits + i * 8), digits);
+            }
 
-        k = Base85DecodeTable[wzSource[1]];
-        if (85 == k)
-        {
-            // illegal symbol
-            return E_UNEXPECTED;
-        }
-        n += k * 85;
+            for (i = 0; i < 8; ++i)
+            {
+                if (!Base85DigitsToWord(rgwDigits + i * 5, pbDest))
+                {
+                    // overflow
+                    return E_UNEXPECTED;
+                }
 
-        k = Base85DecodeTable[wzSource[2]];
-        if (85 == k)
-        {
-            // illegal symbol
-            return E_UNEXPECTED;
-        }
-        n += k * (85 * 85);
+                pbDest += 4;
+            }
 
-        k = Base85DecodeTable[wzSource[3]];
-        if (85 == k)
-        {
-            // illegal symbol
-            return E_UNEXPECTED;
+            wzSource += 40;
+            cchSource -= 40;
         }
-        n += k * (85 * 85 * 85);
+    }
+#endif
 
-        k = Base85DecodeTable[wzSource[4]];
-        if (85 == k)
+    // decode remaining full words
+    while (5 <= cchSource)
+    {
+        for (i = 0; i < 5; ++i)
         {
-            // illegal symbol
-            return E_UNEXPECTED;
+            rgwDigits[i] = Base85DecodeTable[wzSource[i]];
+            if (85 == rgwDigits[i])
+            {
+                // illegal symbol
+                return E_UNEXPECTED;
+            }
         }
-        k *= (85 * 85 * 85 * 85);
 
-        // if (k + n > (1u << 32)) <=> (k > ~n) then decode error
-        if (k > ~n)
+        if (!Base85DigitsToWord(rgwDigits, pbDest))
         {
             // overflow
             return E_UNEXPECTED;
         }
 
-        n += k;
-
-        pbDest[0] = (BYTE) n;
-        pbDest[1] = (BYTE) (n >> 8);
-        pbDest[2] = (BYTE) (n >> 16);
-        pbDest[3] = (BYTE) (n >> 24);
-
         wzSource += 5;
         pbDest += 4;
         cchSource -= 5;
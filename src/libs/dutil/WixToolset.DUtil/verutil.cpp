@@ -17,8 +17,75 @@
 
 // constants
 const DWORD GROW_RELEASE_LABELS = 3;
+const DWORD GROW_POOL_VERSIONS = 32;
+const DWORD GROW_POOL_RELEASE_LABELS = 32;
+const DWORD GROW_POOL_STRINGS = 1024;
+const DWORD INLINE_RELEASE_LABELS = 8;
+
+// structs
+typedef struct _VERUTIL_VERSION_VIEW
+{
+    LPCWSTR wzVersion;
+    DWORD dwMajor;
+    DWORD dwMinor;
+    DWORD dwPatch;
+    DWORD dwRevision;
+    DWORD cReleaseLabels;
+    const VERUTIL_VERSION_RELEASE_LABEL* rgReleaseLabels;
+    SIZE_T cchMetadataOffset;
+    BOOL fInvalid;
+} VERUTIL_VERSION_VIEW;
+
+typedef struct _VERUTIL_RELEASE_LABEL_BUFFER
+{
+    VERUTIL_VERSION_RELEASE_LABEL* rgLabels;
+    DWORD cLabels;
+    DWORD dwGrowth;
+
+    // Optional caller-owned storage used before falling back to the heap.
+    VERUTIL_VERSION_RELEASE_LABEL* rgInlineLabels;
+    DWORD cInlineLabels;
+} VERUTIL_RELEASE_LABEL_BUFFER;
 
 // Forward declarations.
+static HRESULT PrepareVersionString(
+    __inout LPCWSTR* pwzVersion,
+    __inout SIZE_T* pcchVersion
+    );
+static HRESULT ParseVersionString(
+    __in_ecount(cchVersion) LPCWSTR wzVersion,
+    __in SIZE_T cchVersion,
+    __in VERUTIL_VERSION_VIEW* pView,
+    __in VERUTIL_RELEASE_LABEL_BUFFER* pLabels
+    );
+static HRESULT AppendReleaseLabel(
+    __in VERUTIL_RELEASE_LABEL_BUFFER* pLabels,
+    __out VERUTIL_VERSION_RELEASE_LABEL** ppLabel
+    );
+static void ViewFromParsedVersion(
+    __in const VERUTIL_VERSION* pVersion,
+    __out VERUTIL_VERSION_VIEW* pView
+    );
+static void ViewFromPackedVersion(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex,
+    __out VERUTIL_VERSION_VIEW* pView
+    );
+static HRESULT CompareVersionViews(
+    __in const VERUTIL_VERSION_VIEW* pView1,
+    __in const VERUTIL_VERSION_VIEW* pView2,
+    __out int* pnResult
+    );
+static __callback int __cdecl CompareParsedVersionPointers(
+    void* pvContext,
+    const void* pvLeft,
+    const void* pvRight
+    );
+static __callback int __cdecl ComparePoolIndices(
+    void* pvContext,
+    const void* pvLeft,
+    const void* pvRight
+    );
 static int CompareDword(
     __in const DWORD& dw1,
     __in const DWORD& dw2
@@ -47,8 +114,8 @@ DAPI_(HRESULT) VerCompareParsedVersions(
 {
     HRESULT hr = S_OK;
     int nResult = 0;
-    DWORD cMaxReleaseLabels = 0;
-    BOOL fCompareMetadata = FALSE;
+    VERUTIL_VERSION_VIEW view1 = { };
+    VERUTIL_VERSION_VIEW view2 = { };
 
     if (pVersion1 && !pVersion1->sczVersion ||
         pVersion2 && !pVersion2->sczVersion)
@@ -69,81 +136,10 @@ DAPI_(HRESULT) VerCompareParsedVersions(
         ExitFunction1(nResult = -1);
     }
 
-    nResult = CompareDword(pVersion1->dwMajor, pVersion2->dwMajor);
-    if (0 != nResult)
-    {
-        ExitFunction();
-    }
-
-    nResult = CompareDword(pVersion1->dwMinor, pVersion2->dwMinor);
-    if (0 != nResult)
-    {
-        ExitFunction();
-    }
-
-    nResult = CompareDword(pVersion1->dwPatch, pVersion2->dwPatch);
-    if (0 != nResult)
-    {
-        ExitFunction();
-    }
+    ViewFromParsedVersion(pVersion1, &view1);
+    ViewFromParsedVersion(pVersion2, &view2);
 
-    nResult = CompareDword(pVersion1->dwRevision, pVersion2->dwRevision);
-    if (0 != nResult)
-    {
-        ExitFunction();
-    }
-
-    if (pVersion1->cReleaseLabels)
-    {
-        if (pVersion2->cReleaseLabels)
-        {
-            cMaxReleaseLabels = max(pVersion1->cReleaseLabels, pVersion2->cReleaseLabels);
-        }
-        else
-        {
-            ExitFunction1(nResult = -1);
-        }
-    }
-    else if (pVersion2->cReleaseLabels)
-    {
-        ExitFunction1(nResult = 1);
-    }
-
-    if (cMaxReleaseLabels)
-    {
-        for (DWORD i = 0; i < cMaxReleaseLabels; ++i)
-        {
-            VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel1 = pVersion1->cReleaseLabels > i ? pVersion1->rgReleaseLabels + i : NULL;
-            VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel2 = pVersion2->cReleaseLabels > i ? pVersion2->rgReleaseLabels + i : NULL;
-
-            hr = CompareReleaseLabel(pReleaseLabel1, pVersion1->sczVersion, pReleaseLabel2, pVersion2->sczVersion, &nResult);
-            if (FAILED(hr) || 0 != nResult)
-            {
-                ExitFunction();
-            }
-        }
-    }
-
-    if (pVersion1->fInvalid)
-    {
-        if (!pVersion2->fInvalid)
-        {
-            ExitFunction1(nResult = -1);
-        }
-        else
-        {
-            fCompareMetadata = TRUE;
-        }
-    }
-    else if (pVersion2->fInvalid)
-    {
-        ExitFunction1(nResult = 1);
-    }
-
-    if (fCompareMetadata)
-    {
-        hr = CompareVersionSubstring(pVersion1->sczVersion + pVersion1->cchMetadataOffset, -1, pVersion2->sczVersion + pVersion2->cchMetadataOffset, -1, &nResult);
-    }
+    hr = CompareVersionViews(&view1, &view2, &nResult);
 
 LExit:
     *pnResult = nResult;
@@ -158,24 +154,71 @@ DAPI_(HRESULT) VerCompareStringVersions(
     )
 {
     HRESULT hr = S_OK;
-    VERUTIL_VERSION* pVersion1 = NULL;
-    VERUTIL_VERSION* pVersion2 = NULL;
+    SIZE_T cchVersion1 = 0;
+    SIZE_T cchVersion2 = 0;
+    VERUTIL_VERSION_RELEASE_LABEL rgInlineLabels1[INLINE_RELEASE_LABELS] = { };
+    VERUTIL_VERSION_RELEASE_LABEL rgInlineLabels2[INLINE_RELEASE_LABELS] = { };
+    VERUTIL_RELEASE_LABEL_BUFFER labels1 = { };
+    VERUTIL_RELEASE_LABEL_BUFFER labels2 = { };
+    VERUTIL_VERSION_VIEW view1 = { };
+    VERUTIL_VERSION_VIEW view2 = { };
     int nResult = 0;
 
-    hr = VerParseVersion(wzVersion1, 0, fStrict, &pVersion1);
+    if (!wzVersion1 || !wzVersion2)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    // Parse both sides in place with stack storage for the release labels so
+    // the common case does not touch the heap.
+    labels1.rgLabels = labels1.rgInlineLabels = rgInlineLabels1;
+    labels1.cInlineLabels = countof(rgInlineLabels1);
+    labels1.dwGrowth = GROW_RELEASE_LABELS;
+
+    labels2.rgLabels = labels2.rgInlineLabels = rgInlineLabels2;
+    labels2.cInlineLabels = countof(rgInlineLabels2);
+    labels2.dwGrowth = GROW_RELEASE_LABELS;
+
+    hr = PrepareVersionString(&wzVersion1, &cchVersion1);
     VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion1);
 
-    hr = VerParseVersion(wzVersion2, 0, fStrict, &pVersion2);
+    hr = ParseVersionString(wzVersion1, cchVersion1, &view1, &labels1);
+    VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion1);
+
+    if (view1.fInvalid && fStrict)
+    {
+        VerExitOnFailure(hr = E_INVALIDARG, "Failed to parse Verutil version '%ls'", wzVersion1);
+    }
+
+    hr = PrepareVersionString(&wzVersion2, &cchVersion2);
+    VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion2);
+
+    hr = ParseVersionString(wzVersion2, cchVersion2, &view2, &labels2);
     VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion2);
 
-    hr = VerCompareParsedVersions(pVersion1, pVersion2, &nResult);
+    if (view2.fInvalid && fStrict)
+    {
+        VerExitOnFailure(hr = E_INVALIDARG, "Failed to parse Verutil version '%ls'", wzVersion2);
+    }
+
+    view1.rgReleaseLabels = labels1.rgLabels;
+    view2.rgReleaseLabels = labels2.rgLabels;
+
+    hr = CompareVersionViews(&view1, &view2, &nResult);
     VerExitOnFailure(hr, "Failed to compare parsed Verutil versions '%ls' and '%ls'.", wzVersion1, wzVersion2);
 
 LExit:
     *pnResult = nResult;
 
-    ReleaseVerutilVersion(pVersion1);
-    ReleaseVerutilVersion(pVersion2);
+    if (labels1.rgLabels != labels1.rgInlineLabels)
+    {
+        ReleaseMem(labels1.rgLabels);
+    }
+
+    if (labels2.rgLabels != labels2.rgInlineLabels)
+    {
+        ReleaseMem(labels2.rgLabels);
+    }
 
     return hr;
 }
@@ -251,21 +294,60 @@ DAPI_(HRESULT) VerParseVersion(
 {
     HRESULT hr = S_OK;
     VERUTIL_VERSION* pVersion = NULL;
-    LPCWSTR wzEnd = NULL;
-    LPCWSTR wzPartBegin = NULL;
-    LPCWSTR wzPartEnd = NULL;
-    BOOL fInvalid = FALSE;
-    BOOL fLastPart = FALSE;
-    BOOL fTrailingDot = FALSE;
-    BOOL fParsedVersionNumber = FALSE;
-    BOOL fExpectedReleaseLabels = FALSE;
-    DWORD iPart = 0;
+    VERUTIL_RELEASE_LABEL_BUFFER labels = { };
+    VERUTIL_VERSION_VIEW view = { };
 
     if (!wzVersion || !ppVersion)
     {
         ExitFunction1(hr = E_INVALIDARG);
     }
 
+    hr = PrepareVersionString(&wzVersion, &cchVersion);
+    VerExitOnFailure(hr, "Failed to prepare version string: %ls", wzVersion);
+
+    pVersion = reinterpret_cast<VERUTIL_VERSION*>(MemAlloc(sizeof(VERUTIL_VERSION), TRUE));
+    VerExitOnNull(pVersion, hr, E_OUTOFMEMORY, "Failed to allocate memory for Verutil version '%ls'.", wzVersion);
+
+    hr = StrAllocString(&pVersion->sczVersion, wzVersion, cchVersion);
+    VerExitOnFailure(hr, "Failed to copy Verutil version string '%ls'.", wzVersion);
+
+    labels.dwGrowth = GROW_RELEASE_LABELS;
+
+    hr = ParseVersionString(pVersion->sczVersion, cchVersion, &view, &labels);
+    pVersion->rgReleaseLabels = labels.rgLabels;
+    VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion);
+
+    if (view.fInvalid && fStrict)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    pVersion->dwMajor = view.dwMajor;
+    pVersion->dwMinor = view.dwMinor;
+    pVersion->dwPatch = view.dwPatch;
+    pVersion->dwRevision = view.dwRevision;
+    pVersion->cReleaseLabels = view.cReleaseLabels;
+    pVersion->cchMetadataOffset = view.cchMetadataOffset;
+    pVersion->fInvalid = view.fInvalid;
+
+    *ppVersion = pVersion;
+    pVersion = NULL;
+
+LExit:
+    ReleaseVerutilVersion(pVersion);
+
+    return hr;
+}
+
+static HRESULT PrepareVersionString(
+    __inout LPCWSTR* pwzVersion,
+    __inout SIZE_T* pcchVersion
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wzVersion = *pwzVersion;
+    SIZE_T cchVersion = *pcchVersion;
+
     // Get string length if not provided.
     if (!cchVersion)
     {
@@ -277,19 +359,41 @@ DAPI_(HRESULT) VerParseVersion(
         VerExitOnRootFailure(hr = E_INVALIDARG, "Version string is too long: %Iu", cchVersion);
     }
 
-    if (L'v' == *wzVersion || L'V' == *wzVersion)
+    if (cchVersion && (L'v' == *wzVersion || L'V' == *wzVersion))
     {
         ++wzVersion;
         --cchVersion;
     }
 
-    pVersion = reinterpret_cast<VERUTIL_VERSION*>(MemAlloc(sizeof(VERUTIL_VERSION), TRUE));
-    VerExitOnNull(pVersion, hr, E_OUTOFMEMORY, "Failed to allocate memory for Verutil version '%ls'.", wzVersion);
+    *pwzVersion = wzVersion;
+    *pcchVersion = cchVersion;
 
-    hr = StrAllocString(&pVersion->sczVersion, wzVersion, cchVersion);
-    VerExitOnFailure(hr, "Failed to copy Verutil version string '%ls'.", wzVersion);
+LExit:
+    return hr;
+}
+
+static HRESULT ParseVersionString(
+    __in_ecount(cchVersion) LPCWSTR wzVersion,
+    __in SIZE_T cchVersion,
+    __in VERUTIL_VERSION_VIEW* pView,
+    __in VERUTIL_RELEASE_LABEL_BUFFER* pLabels
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wzEnd = NULL;
+    LPCWSTR wzPartBegin = NULL;
+    LPCWSTR wzPartEnd = NULL;
+    BOOL fInvalid = FALSE;
+    BOOL fLastPart = FALSE;
+    BOOL fTrailingDot = FALSE;
+    BOOL fParsedVersionNumber = FALSE;
+    BOOL fExpectedReleaseLabels = FALSE;
+    DWORD iPart = 0;
+
+    pView->wzVersion = wzVersion;
 
-    wzVersion = wzPartBegin = wzPartEnd = pVersion->sczVersion;
+
+    wzPartBegin = wzPartEnd = wzVersion;
 
     // Save end pointer.
     wzEnd = wzVersion + cchVersion;
@@ -367,16 +471,16 @@ DAPI_(HRESULT) VerParseVersion(
         switch (iPart)
         {
         case 0:
-            pVersion->dwMajor = uPart;
+            pView->dwMajor = uPart;
             break;
         case 1:
-            pVersion->dwMinor = uPart;
+            pView->dwMinor = uPart;
             break;
         case 2:
-            pVersion->dwPatch = uPart;
+            pView->dwPatch = uPart;
             break;
         case 3:
-            pVersion->dwRevision = uPart;
+            pView->dwRevision = uPart;
             break;
         }
 
@@ -458,11 +562,11 @@ DAPI_(HRESULT) VerParseVersion(
             break;
         }
 
-        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pVersion->rgReleaseLabels), pVersion->cReleaseLabels, 1, sizeof(VERUTIL_VERSION_RELEASE_LABEL), GROW_RELEASE_LABELS);
-        VerExitOnFailure(hr, "Failed to allocate memory for Verutil version release labels '%ls'", wzVersion);
+        VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel = NULL;
+        hr = AppendReleaseLabel(pLabels, &pReleaseLabel);
+        VerExitOnFailure(hr, "Failed to allocate memory for Verutil version release labels '%.*ls'", static_cast<int>(cchVersion), wzVersion);
 
-        VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel = pVersion->rgReleaseLabels + pVersion->cReleaseLabels;
-        ++pVersion->cReleaseLabels;
+        ++pView->cReleaseLabels;
 
         // Try to parse as number.
         UINT uLabel = 0;
@@ -473,7 +577,7 @@ DAPI_(HRESULT) VerParseVersion(
             pReleaseLabel->dwValue = uLabel;
         }
 
-        pReleaseLabel->cchLabelOffset = wzPartBegin - pVersion->sczVersion;
+        pReleaseLabel->cchLabelOffset = wzPartBegin - wzVersion;
         pReleaseLabel->cchLabel = cchLabel;
 
         if (fTrailingDot)
@@ -488,7 +592,7 @@ DAPI_(HRESULT) VerParseVersion(
         }
     }
 
-    fInvalid |= fExpectedReleaseLabels && (!pVersion->cReleaseLabels || fTrailingDot);
+    fInvalid |= fExpectedReleaseLabels && (!pView->cReleaseLabels || fTrailingDot);
 
     if (!fInvalid && wzPartBegin < wzEnd)
     {
@@ -502,21 +606,11 @@ DAPI_(HRESULT) VerParseVersion(
         }
     }
 
-    if (fInvalid && fStrict)
-    {
-        ExitFunction1(hr = E_INVALIDARG);
-    }
-
-    pVersion->cchMetadataOffset = min(wzPartBegin, wzEnd) - pVersion->sczVersion;
-    pVersion->fInvalid = fInvalid;
-
-    *ppVersion = pVersion;
-    pVersion = NULL;
+    pView->cchMetadataOffset = min(wzPartBegin, wzEnd) - wzVersion;
+    pView->fInvalid = fInvalid;
     hr = S_OK;
 
 LExit:
-    ReleaseVerutilVersion(pVersion);
-
     return hr;
 }
 
@@ -550,6 +644,411 @@ LExit:
     return hr;
 }
 
+DAPI_(HRESULT) VerSortVersions(
+    __in_ecount(cVersions) VERUTIL_VERSION** rgpVersions,
+    __in DWORD cVersions
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!rgpVersions && cVersions)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    if (1 < cVersions)
+    {
+        qsort_s(rgpVersions, cVersions, sizeof(VERUTIL_VERSION*), CompareParsedVersionPointers, NULL);
+    }
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) VerPoolAddVersion(
+    __in VERUTIL_VERSION_POOL* pPool,
+    __in_z LPCWSTR wzVersion,
+    __in SIZE_T cchVersion,
+    __in BOOL fStrict,
+    __out_opt DWORD* pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_RELEASE_LABEL_BUFFER labels = { };
+    VERUTIL_VERSION_VIEW view = { };
+    VERUTIL_PACKED_VERSION* pPacked = NULL;
+    DWORD cchStrings = 0;
+    DWORD cchNew = 0;
+    DWORD cOriginalReleaseLabels = 0;
+    BOOL fInPool = FALSE;
+    SIZE_T cchInPoolOffset = 0;
+
+    if (!pPool || !wzVersion)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    cOriginalReleaseLabels = pPool->cReleaseLabels;
+
+    hr = PrepareVersionString(&wzVersion, &cchVersion);
+    VerExitOnFailure(hr, "Failed to prepare version string: %ls", wzVersion);
+
+    hr = ::SizeTToDWord(cchVersion + 1, &cchNew);
+    VerExitOnRootFailure(hr, "Version string is too long: %Iu", cchVersion);
+
+    hr = ::DWordAdd(pPool->cchStrings, cchNew, &cchStrings);
+    VerExitOnRootFailure(hr, "Version pool string storage overflowed.");
+
+    // The string may already be in the pool (e.g. from VerPoolGetVersionString),
+    // so keep its offset because growing the pool can move the storage.
+    fInPool = pPool->wzStrings && pPool->wzStrings <= wzVersion && wzVersion < pPool->wzStrings + pPool->cchStrings;
+    if (fInPool)
+    {
+        cchInPoolOffset = wzVersion - pPool->wzStrings;
+    }
+
+    // Grow the pools geometrically so appending many versions stays amortized O(1).
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pPool->wzStrings), pPool->cchStrings, cchNew, sizeof(WCHAR), max(GROW_POOL_STRINGS, pPool->cchStrings));
+    VerExitOnFailure(hr, "Failed to grow version pool string storage.");
+
+    if (fInPool)
+    {
+        wzVersion = pPool->wzStrings + cchInPoolOffset;
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pPool->rgVersions), pPool->cVersions, 1, sizeof(VERUTIL_PACKED_VERSION), max(GROW_POOL_VERSIONS, pPool->cVersions));
+    VerExitOnFailure(hr, "Failed to grow version pool.");
+
+    memcpy_s(pPool->wzStrings + pPool->cchStrings, cchNew * sizeof(WCHAR), wzVersion, cchVersion * sizeof(WCHAR));
+    pPool->wzStrings[cchStrings - 1] = L'\0';
+
+    labels.rgLabels = pPool->rgReleaseLabels;
+    labels.cLabels = pPool->cReleaseLabels;
+    labels.dwGrowth = max(GROW_POOL_RELEASE_LABELS, pPool->cReleaseLabels);
+
+    hr = ParseVersionString(pPool->wzStrings + pPool->cchStrings, cchVersion, &view, &labels);
+    pPool->rgReleaseLabels = labels.rgLabels;
+    VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", wzVersion);
+
+    if (view.fInvalid && fStrict)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    pPacked = pPool->rgVersions + pPool->cVersions;
+    pPacked->dwMajor = view.dwMajor;
+    pPacked->dwMinor = view.dwMinor;
+    pPacked->dwPatch = view.dwPatch;
+    pPacked->dwRevision = view.dwRevision;
+    pPacked->iReleaseLabel = cOriginalReleaseLabels;
+    pPacked->cReleaseLabels = view.cReleaseLabels;
+    pPacked->cchVersionOffset = pPool->cchStrings;
+    pPacked->cchMetadataOffset = view.cchMetadataOffset;
+    pPacked->fInvalid = view.fInvalid;
+
+    pPool->cReleaseLabels = labels.cLabels;
+    pPool->cchStrings = cchStrings;
+
+    if (pdwIndex)
+    {
+        *pdwIndex = pPool->cVersions;
+    }
+
+    ++pPool->cVersions;
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) VerPoolCompareVersions(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex1,
+    __in DWORD dwIndex2,
+    __out int* pnResult
+    )
+{
+    HRESULT hr = S_OK;
+    int nResult = 0;
+    VERUTIL_VERSION_VIEW view1 = { };
+    VERUTIL_VERSION_VIEW view2 = { };
+
+    if (!pPool || pPool->cVersions <= dwIndex1 || pPool->cVersions <= dwIndex2)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    if (dwIndex1 != dwIndex2)
+    {
+        ViewFromPackedVersion(pPool, dwIndex1, &view1);
+        ViewFromPackedVersion(pPool, dwIndex2, &view2);
+
+        hr = CompareVersionViews(&view1, &view2, &nResult);
+    }
+
+LExit:
+    *pnResult = nResult;
+    return hr;
+}
+
+DAPI_(HRESULT) VerPoolGetVersionString(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex,
+    __out_z LPCWSTR* pwzVersion
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!pPool || pPool->cVersions <= dwIndex)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    *pwzVersion = pPool->wzStrings + pPool->rgVersions[dwIndex].cchVersionOffset;
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) VerPoolSortVersions(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __inout_ecount(cIndices) DWORD* rgdwIndices,
+    __in DWORD cIndices
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!pPool || !rgdwIndices && cIndices)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    for (DWORD i = 0; i < cIndices; ++i)
+    {
+        if (pPool->cVersions <= rgdwIndices[i])
+        {
+            ExitFunction1(hr = E_INVALIDARG);
+        }
+    }
+
+    if (1 < cIndices)
+    {
+        qsort_s(rgdwIndices, cIndices, sizeof(DWORD), ComparePoolIndices, const_cast<VERUTIL_VERSION_POOL*>(pPool));
+    }
+
+LExit:
+    return hr;
+}
+
+DAPI_(void) VerFreeVersionPool(
+    __in VERUTIL_VERSION_POOL* pPool
+    )
+{
+    if (pPool)
+    {
+        ReleaseMem(pPool->rgVersions);
+        ReleaseMem(pPool->rgReleaseLabels);
+        ReleaseMem(pPool->wzStrings);
+        memset(pPool, 0, sizeof(VERUTIL_VERSION_POOL));
+    }
+}
+
+
+static HRESULT AppendReleaseLabel(
+    __in VERUTIL_RELEASE_LABEL_BUFFER* pLabels,
+    __out VERUTIL_VERSION_RELEASE_LABEL** ppLabel
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_VERSION_RELEASE_LABEL* rgHeapLabels = NULL;
+
+    if (pLabels->rgInlineLabels && pLabels->rgLabels == pLabels->rgInlineLabels)
+    {
+        if (pLabels->cLabels < pLabels->cInlineLabels)
+        {
+            ExitFunction();
+        }
+
+        // Spill the inline labels to the heap.
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&rgHeapLabels), 0, pLabels->cLabels + 1, sizeof(VERUTIL_VERSION_RELEASE_LABEL), pLabels->dwGrowth);
+        VerExitOnFailure(hr, "Failed to allocate memory for release labels.");
+
+        memcpy_s(rgHeapLabels, pLabels->cLabels * sizeof(VERUTIL_VERSION_RELEASE_LABEL), pLabels->rgInlineLabels, pLabels->cLabels * sizeof(VERUTIL_VERSION_RELEASE_LABEL));
+        pLabels->rgLabels = rgHeapLabels;
+    }
+    else
+    {
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pLabels->rgLabels), pLabels->cLabels, 1, sizeof(VERUTIL_VERSION_RELEASE_LABEL), pLabels->dwGrowth);
+        VerExitOnFailure(hr, "Failed to allocate memory for release labels.");
+    }
+
+LExit:
+    if (SUCCEEDED(hr))
+    {
+        *ppLabel = pLabels->rgLabels + pLabels->cLabels;
+        memset(*ppLabel, 0, sizeof(VERUTIL_VERSION_RELEASE_LABEL));
+        ++pLabels->cLabels;
+    }
+
+    return hr;
+}
+
+static void ViewFromParsedVersion(
+    __in const VERUTIL_VERSION* pVersion,
+    __out VERUTIL_VERSION_VIEW* pView
+    )
+{
+    pView->wzVersion = pVersion->sczVersion;
+    pView->dwMajor = pVersion->dwMajor;
+    pView->dwMinor = pVersion->dwMinor;
+    pView->dwPatch = pVersion->dwPatch;
+    pView->dwRevision = pVersion->dwRevision;
+    pView->cReleaseLabels = pVersion->cReleaseLabels;
+    pView->rgReleaseLabels = pVersion->rgReleaseLabels;
+    pView->cchMetadataOffset = pVersion->cchMetadataOffset;
+    pView->fInvalid = pVersion->fInvalid;
+}
+
+static void ViewFromPackedVersion(
+    __in const VERUTIL_VERSION_POOL* pPool,
+    __in DWORD dwIndex,
+    __out VERUTIL_VERSION_VIEW* pView
+    )
+{
+    const VERUTIL_PACKED_VERSION* pPacked = pPool->rgVersions + dwIndex;
+
+    pView->wzVersion = pPool->wzStrings + pPacked->cchVersionOffset;
+    pView->dwMajor = pPacked->dwMajor;
+    pView->dwMinor = pPacked->dwMinor;
+    pView->dwPatch = pPacked->dwPatch;
+    pView->dwRevision = pPacked->dwRevision;
+    pView->cReleaseLabels = pPacked->cReleaseLabels;
+    pView->rgReleaseLabels = pPacked->cReleaseLabels ? pPool->rgReleaseLabels + pPacked->iReleaseLabel : NULL;
+    pView->cchMetadataOffset = pPacked->cchMetadataOffset;
+    pView->fInvalid = pPacked->fInvalid;
+}
+
+static HRESULT CompareVersionViews(
+    __in const VERUTIL_VERSION_VIEW* pView1,
+    __in const VERUTIL_VERSION_VIEW* pView2,
+    __out int* pnResult
+    )
+{
+    HRESULT hr = S_OK;
+    int nResult = 0;
+    DWORD cMaxReleaseLabels = 0;
+    BOOL fCompareMetadata = FALSE;
+
+    nResult = CompareDword(pView1->dwMajor, pView2->dwMajor);
+    if (0 != nResult)
+    {
+        ExitFunction();
+    }
+
+    nResult = CompareDword(pView1->dwMinor, pView2->dwMinor);
+    if (0 != nResult)
+    {
+        ExitFunction();
+    }
+
+    nResult = CompareDword(pView1->dwPatch, pView2->dwPatch);
+    if (0 != nResult)
+    {
+        ExitFunction();
+    }
+
+    nResult = CompareDword(pView1->dwRevision, pView2->dwRevision);
+    if (0 != nResult)
+    {
+        ExitFunction();
+    }
+
+    if (pView1->cReleaseLabels)
+    {
+        if (pView2->cReleaseLabels)
+        {
+            cMaxReleaseLabels = max(pView1->cReleaseLabels, pView2->cReleaseLabels);
+        }
+        else
+        {
+            ExitFunction1(nResult = -1);
+        }
+    }
+    else if (pView2->cReleaseLabels)
+    {
+        ExitFunction1(nResult = 1);
+    }
+
+    if (cMaxReleaseLabels)
+    {
+        for (DWORD i = 0; i < cMaxReleaseLabels; ++i)
+        {
+            const VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel1 = pView1->cReleaseLabels > i ? pView1->rgReleaseLabels + i : NULL;
+            const VERUTIL_VERSION_RELEASE_LABEL* pReleaseLabel2 = pView2->cReleaseLabels > i ? pView2->rgReleaseLabels + i : NULL;
+
+            hr = CompareReleaseLabel(pReleaseLabel1, pView1->wzVersion, pReleaseLabel2, pView2->wzVersion, &nResult);
+            if (FAILED(hr) || 0 != nResult)
+            {
+                ExitFunction();
+            }
+        }
+    }
+
+    if (pView1->fInvalid)
+    {
+        if (!pView2->fInvalid)
+        {
+            ExitFunction1(nResult = -1);
+        }
+        else
+        {
+            fCompareMetadata = TRUE;
+        }
+    }
+    else if (pView2->fInvalid)
+    {
+        ExitFunction1(nResult = 1);
+    }
+
+    if (fCompareMetadata)
+    {
+        hr = CompareVersionSubstring(pView1->wzVersion + pView1->cchMetadataOffset, -1, pView2->wzVersion + pView2->cchMetadataOffset, -1, &nResult);
+    }
+
+LExit:
+    *pnResult = nResult;
+    return hr;
+}
+
+static __callback int __cdecl CompareParsedVersionPointers(
+    void* /*pvContext*/,
+    const void* pvLeft,
+    const void* pvRight
+    )
+{
+    int nResult = 0;
+    VERUTIL_VERSION* pLeft = *static_cast<VERUTIL_VERSION* const*>(pvLeft);
+    VERUTIL_VERSION* pRight = *static_cast<VERUTIL_VERSION* const*>(pvRight);
+
+    VerCompareParsedVersions(pLeft, pRight, &nResult);
+
+    return nResult;
+}
+
+static __callback int __cdecl ComparePoolIndices(
+    void* pvContext,
+    const void* pvLeft,
+    const void* pvRight
+    )
+{
+    int nResult = 0;
+    const VERUTIL_VERSION_POOL* pPool = static_cast<const VERUTIL_VERSION_POOL*>(pvContext);
+    DWORD dwLeft = *static_cast<const DWORD*>(pvLeft);
+    DWORD dwRight = *static_cast<const DWORD*>(pvRight);
+
+    VerPoolCompareVersions(pPool, dwLeft, dwRight, &nResult);
+
+    return nResult;
+}
 
 static int CompareDword(
     __in const DWORD& dw1,
@@ -46,6 +46,7 @@ static PFN_MSIDETERMINEPATCHSEQUENCEW vpfnMsiDeterminePatchSequenceW = NULL;
 static PFN_MSIDETERMINEAPPLICABLEPATCHESW vpfnMsiDetermineApplicablePatchesW = NULL;
 static PFN_MSIENUMPRODUCTSEXW vpfnMsiEnumProductsExW = NULL;
 static PFN_MSIGETPATCHINFOEXW vpfnMsiGetPatchInfoExW = NULL;
+static PFN_MSIENUMPATCHESEXW vpfnMsiEnumPatchesExW = NULL;
 static PFN_MSIGETPRODUCTINFOEXW vpfnMsiGetProductInfoExW = NULL;
 static PFN_MSISETEXTERNALUIRECORD vpfnMsiSetExternalUIRecord = NULL;
 static PFN_MSISOURCELISTADDSOURCEEXW vpfnMsiSourceListAddSourceExW = NULL;
@@ -55,6 +56,7 @@ static PFN_MSIDETERMINEPATCHSEQUENCEW vpfnMsiDeterminePatchSequenceWFromLibrary
 static PFN_MSIDETERMINEAPPLICABLEPATCHESW vpfnMsiDetermineApplicablePatchesWFromLibrary = NULL;
 static PFN_MSIENUMPRODUCTSEXW vpfnMsiEnumProductsExWFromLibrary = NULL;
 static PFN_MSIGETPATCHINFOEXW vpfnMsiGetPatchInfoExWFromLibrary = NULL;
+static PFN_MSIENUMPATCHESEXW vpfnMsiEnumPatchesExWFromLibrary = NULL;
 static PFN_MSIGETPRODUCTINFOEXW vpfnMsiGetProductInfoExWFromLibrary = NULL;
 static PFN_MSISETEXTERNALUIRECORD vpfnMsiSetExternalUIRecordFromLibrary = NULL;
 static PFN_MSISOURCELISTADDSOURCEEXW vpfnMsiSourceListAddSourceExWFromLibrary = NULL;
@@ -64,6 +66,7 @@ static PFN_MSIBEGINTRANSACTIONW vpfnMsiBeginTransaction = NULL;
 static PFN_MSIENDTRANSACTION vpfnMsiEndTransaction = NULL;
 
 static BOOL vfWiuInitialized = FALSE;
+static volatile LONG vcWiuQueries = 0;
 
 // globals
 static DWORD vdwMsiDllMajorMinor = 0;
@@ -105,6 +108,14 @@ static INT SendMsiMessage(
     __in_z LPCWSTR wzMessage,
     __in_opt MSIHANDLE hRecord
     );
+static INT DeliverMsiMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in INSTALLMESSAGE mt,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzMessage,
+    __in_ecount(cData) LPWSTR* rgsczData,
+    __in DWORD cData
+    );
 static INT SendErrorMessage(
     __in WIU_MSI_EXECUTE_CONTEXT* pContext,
     __in UINT uiFlags,
@@ -116,9 +127,28 @@ static INT SendFilesInUseMessage(
     __in_opt MSIHANDLE hRecord,
     __in BOOL fRestartManagerRequest
     );
+static INT SendActionData(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzMessage,
+    __in_opt MSIHANDLE hRecord
+    );
 static INT SendProgressUpdate(
     __in WIU_MSI_EXECUTE_CONTEXT* pContext
     );
+static INT SendProgressMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in DWORD dwPercentage
+    );
+static INT FlushPendingMessages(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext
+    );
+static void ReleasePendingActionData(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext
+    );
+static BOOL IsRelayDue(
+    __inout DWORD* pdwLastTick
+    );
 static void ResetProgress(
     __in WIU_MSI_EXECUTE_CONTEXT* pContext
     );
@@ -178,6 +208,12 @@ extern "C" HRESULT DAPI WiuInitialize(
         vpfnMsiGetPatchInfoExW = vpfnMsiGetPatchInfoExWFromLibrary;
     }
 
+    vpfnMsiEnumPatchesExWFromLibrary = reinterpret_cast<PFN_MSIENUMPATCHESEXW>(::GetProcAddress(vhMsiDll, "MsiEnumPatchesExW"));
+    if (NULL == vpfnMsiEnumPatchesExW)
+    {
+        vpfnMsiEnumPatchesExW = vpfnMsiEnumPatchesExWFromLibrary;
+    }
+
     vpfnMsiGetProductInfoExWFromLibrary = reinterpret_cast<PFN_MSIGETPRODUCTINFOEXW>(::GetProcAddress(vhMsiDll, "MsiGetProductInfoExW"));
     if (NULL == vpfnMsiGetProductInfoExW)
     {
@@ -230,6 +266,7 @@ extern "C" void DAPI WiuUninitialize(
         vpfnMsiSetExternalUIRecordFromLibrary = NULL;
         vpfnMsiGetProductInfoExWFromLibrary = NULL;
         vpfnMsiGetPatchInfoExWFromLibrary = NULL;
+        vpfnMsiEnumPatchesExWFromLibrary = NULL;
         vpfnMsiEnumProductsExWFromLibrary = NULL;
         vpfnMsiDetermineApplicablePatchesWFromLibrary = NULL;
         vpfnMsiDeterminePatchSequenceWFromLibrary = NULL;
@@ -294,6 +331,7 @@ extern "C" HRESULT DAPI WiuGetComponentPath(
     WiuExitOnFailure(hr, "Failed to allocate string for component path.");
 
     cchCompare = cch;
+    ::InterlockedIncrement(&vcWiuQueries);
     *pInstallState = vpfnMsiGetComponentPathW(wzProductCode, wzComponentId, *psczValue, &cch);
     if (INSTALLSTATE_MOREDATA == *pInstallState)
     {
@@ -302,6 +340,7 @@ extern "C" HRESULT DAPI WiuGetComponentPath(
         WiuExitOnFailure(hr, "Failed to reallocate string for component path.");
 
         cchCompare = cch;
+        ::InterlockedIncrement(&vcWiuQueries);
         *pInstallState = vpfnMsiGetComponentPathW(wzProductCode, wzComponentId, *psczValue, &cch);
     }
 
@@ -324,6 +363,7 @@ extern "C" HRESULT DAPI WiuGetComponentPath(
         hr = StrAlloc(psczValue, cch);
         WiuExitOnFailure(hr, "Failed to reallocate string for component path.");
 
+        ::InterlockedIncrement(&vcWiuQueries);
         *pInstallState = vpfnMsiGetComponentPathW(wzProductCode, wzComponentId, *psczValue, &cch);
     }
 
@@ -346,6 +386,7 @@ extern "C" HRESULT DAPI WiuLocateComponent(
     WiuExitOnFailure(hr, "Failed to allocate string for component path.");
 
     cchCompare = cch;
+    ::InterlockedIncrement(&vcWiuQueries);
     *pInstallState = vpfnMsiLocateComponentW(wzComponentId, *psczValue, &cch);
     if (INSTALLSTATE_MOREDATA == *pInstallState)
     {
@@ -354,6 +395,7 @@ extern "C" HRESULT DAPI WiuLocateComponent(
         WiuExitOnFailure(hr, "Failed to reallocate string for component path.");
 
         cchCompare = cch;
+        ::InterlockedIncrement(&vcWiuQueries);
         *pInstallState = vpfnMsiLocateComponentW(wzComponentId, *psczValue, &cch);
     }
 
@@ -376,6 +418,7 @@ extern "C" HRESULT DAPI WiuLocateComponent(
         hr = StrAlloc(psczValue, cch);
         WiuExitOnFailure(hr, "Failed to reallocate string for component path.");
 
+        ::InterlockedIncrement(&vcWiuQueries);
         *pInstallState = vpfnMsiLocateComponentW(wzComponentId, *psczValue, &cch);
     }
 
@@ -392,6 +435,7 @@ extern "C" HRESULT DAPI WiuQueryFeatureState(
 {
     HRESULT hr = S_OK;
 
+    ::InterlockedIncrement(&vcWiuQueries);
     *pInstallState = vpfnMsiQueryFeatureStateW(wzProduct, wzFeature);
     if (INSTALLSTATE_INVALIDARG == *pInstallState)
     {
@@ -417,6 +461,7 @@ extern "C" HRESULT DAPI WiuGetProductInfo(
     hr = StrAlloc(psczValue, cch);
     WiuExitOnFailure(hr, "Failed to allocate string for product info.");
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiGetProductInfoW(wzProductCode, wzProperty, *psczValue, &cch);
     if (ERROR_MORE_DATA == er)
     {
@@ -424,6 +469,7 @@ extern "C" HRESULT DAPI WiuGetProductInfo(
         hr = StrAlloc(psczValue, cch);
         WiuExitOnFailure(hr, "Failed to reallocate string for product info.");
 
+        ::InterlockedIncrement(&vcWiuQueries);
         er = vpfnMsiGetProductInfoW(wzProductCode, wzProperty, *psczValue, &cch);
     }
     WiuExitOnWin32Error(er, hr, "Failed to get product info.");
@@ -456,6 +502,7 @@ extern "C" HRESULT DAPI WiuGetProductInfoEx(
     hr = StrAlloc(psczValue, cch);
     WiuExitOnFailure(hr, "Failed to allocate string for extended product info.");
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiGetProductInfoExW(wzProductCode, wzUserSid, dwContext, wzProperty, *psczValue, &cch);
     if (ERROR_MORE_DATA == er)
     {
@@ -463,6 +510,7 @@ extern "C" HRESULT DAPI WiuGetProductInfoEx(
         hr = StrAlloc(psczValue, cch);
         WiuExitOnFailure(hr, "Failed to reallocate string for extended product info.");
 
+        ::InterlockedIncrement(&vcWiuQueries);
         er = vpfnMsiGetProductInfoExW(wzProductCode, wzUserSid, dwContext, wzProperty, *psczValue, &cch);
     }
     WiuExitOnWin32Error(er, hr, "Failed to get extended product info.");
@@ -522,6 +570,7 @@ extern "C" HRESULT DAPI WiuGetPatchInfoEx(
     hr = StrAlloc(psczValue, cch);
     WiuExitOnFailure(hr, "Failed to allocate string for extended patch info.");
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiGetPatchInfoExW(wzPatchCode, wzProductCode, wzUserSid, dwContext, wzProperty, *psczValue, &cch);
     if (ERROR_MORE_DATA == er)
     {
@@ -529,6 +578,7 @@ extern "C" HRESULT DAPI WiuGetPatchInfoEx(
         hr = StrAlloc(psczValue, cch);
         WiuExitOnFailure(hr, "Failed to reallocate string for extended patch info.");
 
+        ::InterlockedIncrement(&vcWiuQueries);
         er = vpfnMsiGetPatchInfoExW(wzPatchCode, wzProductCode, wzUserSid, dwContext, wzProperty, *psczValue, &cch);
     }
     WiuExitOnWin32Error(er, hr, "Failed to get extended patch info.");
@@ -554,6 +604,7 @@ extern "C" HRESULT DAPI WiuDeterminePatchSequence(
         ExitFunction1(hr = E_NOTIMPL);
     }
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiDeterminePatchSequenceW(wzProductCode, wzUserSid, context, cPatchInfo, pPatchInfo);
     WiuExitOnWin32Error(er, hr, "Failed to determine patch sequence for product code.");
 
@@ -576,6 +627,7 @@ extern "C" HRESULT DAPI WiuDetermineApplicablePatches(
         ExitFunction1(hr = E_NOTIMPL);
     }
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiDetermineApplicablePatchesW(wzProductPackagePath, cPatchInfo, pPatchInfo);
     WiuExitOnWin32Error(er, hr, "Failed to determine applicable patches for product package.");
 
@@ -592,6 +644,7 @@ extern "C" HRESULT DAPI WiuEnumProducts(
     HRESULT hr = S_OK;
     DWORD er = ERROR_SUCCESS;
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiEnumProductsW(iProductIndex, wzProductCode);
     if (ERROR_NO_MORE_ITEMS == er)
     {
@@ -623,6 +676,7 @@ extern "C" HRESULT DAPI WiuEnumProductsEx(
         ExitFunction1(hr = E_NOTIMPL);
     }
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiEnumProductsExW(wzProductCode, wzUserSid, dwContext, dwIndex, wzInstalledProductCode, pdwInstalledContext, wzSid, pcchSid);
     if (ERROR_NO_MORE_ITEMS == er)
     {
@@ -644,6 +698,7 @@ extern "C" HRESULT DAPI WiuEnumRelatedProducts(
     HRESULT hr = S_OK;
     DWORD er = ERROR_SUCCESS;
 
+    ::InterlockedIncrement(&vcWiuQueries);
     er = vpfnMsiEnumRelatedProductsW(wzUpgradeCode, 0, iProductIndex, wzProductCode);
     if (ERROR_NO_MORE_ITEMS == er)
     {
@@ -655,6 +710,50 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT DAPI WiuEnumPatchesEx(
+    __in_z_opt LPCWSTR wzProductCode,
+    __in_z_opt LPCWSTR wzUserSid,
+    __in DWORD dwContext,
+    __in DWORD dwFilter,
+    __in DWORD dwIndex,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR wzPatchCode,
+    __out_ecount_opt(MAX_GUID_CHARS + 1) LPWSTR wzTargetProductCode,
+    __out_opt MSIINSTALLCONTEXT* pdwTargetProductContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+
+    if (!vpfnMsiEnumPatchesExW)
+    {
+        ExitFunction1(hr = E_NOTIMPL);
+    }
+
+    ::InterlockedIncrement(&vcWiuQueries);
+    er = vpfnMsiEnumPatchesExW(wzProductCode, wzUserSid, dwContext, dwFilter, dwIndex, wzPatchCode, wzTargetProductCode, pdwTargetProductContext, NULL, NULL);
+    if (ERROR_NO_MORE_ITEMS == er)
+    {
+        ExitFunction1(hr = HRESULT_FROM_WIN32(er));
+    }
+    WiuExitOnWin32Error(er, hr, "Failed to enumerate patches.");
+
+LExit:
+    return hr;
+}
+
+
+/********************************************************************
+ WiuGetQueryCount - returns the number of Windows Installer queries
+                    made through wiutil by this process.
+
+*********************************************************************/
+extern "C" DWORD DAPI WiuGetQueryCount(
+    )
+{
+    return static_cast<DWORD>(vcWiuQueries);
+}
+
+
 /********************************************************************
  WiuEnumRelatedProductCodes - Returns an array of related products for a given upgrade code.
 
@@ -674,8 +773,10 @@ extern "C" HRESULT DAPI WiuEnumRelatedProductCodes(
     HRESULT hr = S_OK;
     WCHAR wzCurrentProductCode[MAX_GUID_CHARS + 1] = { };
     LPWSTR sczInstalledVersion = NULL;
-    VERUTIL_VERSION* pCurrentVersion = NULL;
-    VERUTIL_VERSION* pHighestVersion = NULL;
+    VERUTIL_VERSION_POOL versionPool = { };
+    DWORD dwCurrentVersion = 0;
+    DWORD dwHighestVersion = 0;
+    BOOL fHighestVersion = FALSE;
     int nCompare = 0;
 
     // make sure we start at zero
@@ -703,40 +804,36 @@ extern "C" HRESULT DAPI WiuEnumRelatedProductCodes(
                 continue;
             }
 
-            hr = VerParseVersion(sczInstalledVersion, 0, FALSE, &pCurrentVersion);
+            // pack the versions into a pool so scanning many related products
+            // does not allocate a parsed version per product
+            hr = VerPoolAddVersion(&versionPool, sczInstalledVersion, 0, FALSE, &dwCurrentVersion);
             WiuExitOnFailure(hr, "Failed to parse version: %ls for product code: %ls", sczInstalledVersion, wzCurrentProductCode);
 
-            if (pCurrentVersion->fInvalid)
+            if (versionPool.rgVersions[dwCurrentVersion].fInvalid)
             {
                 WiuExitTrace(E_INVALIDDATA, "Enumerated msi package with invalid version, product code: '%1!ls!', version: '%2!ls!'");
             }
 
             // if this is the first product found then it is the highest version (for now)
-            if (!pHighestVersion)
+            if (!fHighestVersion)
             {
-                pHighestVersion = pCurrentVersion;
-                pCurrentVersion = NULL;
+                dwHighestVersion = dwCurrentVersion;
+                fHighestVersion = TRUE;
             }
             else
             {
-                hr = VerCompareParsedVersions(pCurrentVersion, pHighestVersion, &nCompare);
-                WiuExitOnFailure(hr, "Failed to compare version '%ls' to highest version: '%ls'", pCurrentVersion->sczVersion, pHighestVersion->sczVersion);
+                hr = VerPoolCompareVersions(&versionPool, dwCurrentVersion, dwHighestVersion, &nCompare);
+                WiuExitOnFailure(hr, "Failed to compare version '%ls' to highest version for product code: %ls", sczInstalledVersion, wzCurrentProductCode);
 
                 // if this is the highest version encountered so far then overwrite
                 // the first item in the array (there will never be more than one item)
                 if (nCompare > 0)
                 {
-                    ReleaseVerutilVersion(pHighestVersion);
-                    pHighestVersion = pCurrentVersion;
-                    pCurrentVersion = NULL;
+                    dwHighestVersion = dwCurrentVersion;
 
                     hr = StrAllocString(prgsczProductCodes[0], wzCurrentProductCode, 0);
                     WiuExitOnFailure(hr, "Failed to update array with higher versioned product code.");
                 }
-                else
-                {
-                    ReleaseVerutilVersion(pCurrentVersion);
-                }
 
                 // continue here as we don't want anything else added to the list
                 continue;
@@ -748,8 +845,7 @@ extern "C" HRESULT DAPI WiuEnumRelatedProductCodes(
     }
 
 LExit:
-    ReleaseVerutilVersion(pCurrentVersion);
-    ReleaseVerutilVersion(pHighestVersion);
+    ReleaseVerutilVersionPool(versionPool);
     ReleaseStr(sczInstalledVersion);
     return hr;
 }
@@ -825,6 +921,10 @@ extern "C" HRESULT DAPI WiuInitializeExternalUI(
     pExecuteContext->pfnMessageHandler = pfnMessageHandler;
     pExecuteContext->pvContext = pvContext;
 
+    // Allow the first progress and action data messages through immediately.
+    pExecuteContext->dwLastProgressTick = ::GetTickCount() - WIU_MSI_EXECUTE_RELAY_INTERVAL;
+    pExecuteContext->dwLastActionDataTick = pExecuteContext->dwLastProgressTick;
+
     // If the external UI record is available (MSI version >= 3.1) use it but fall back to the standard external
     // UI handler if necesary.
     if (vpfnMsiSetExternalUIRecord)
@@ -844,6 +944,14 @@ LExit:
 }
 
 
+extern "C" INT DAPI WiuFlushExternalUI(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
+    )
+{
+    return FlushPendingMessages(pExecuteContext);
+}
+
+
 extern "C" void DAPI WiuUninitializeExternalUI(
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     )
@@ -863,6 +971,8 @@ extern "C" void DAPI WiuUninitializeExternalUI(
         vpfnMsiSetExternalUIRecord(pExecuteContext->pfnPreviousExternalUIRecord, 0, NULL, NULL);
     }
 
+    ReleasePendingActionData(pExecuteContext);
+
     memset(pExecuteContext, 0, sizeof(WIU_MSI_EXECUTE_CONTEXT));
 }
 
@@ -1149,7 +1259,7 @@ Trace(REPORT_STANDARD, "MSI install[%x]: %ls", pContext->dwCurrentProgressIndex,
         }
         else
         {
-            nResult = SendMsiMessage(pContext, mt, uiFlags, wzMessage, hRecord);
+            nResult = SendActionData(pContext, uiFlags, wzMessage, hRecord);
         }
         break;
 
@@ -1394,12 +1504,35 @@ static INT SendMsiMessage(
     )
 {
     INT nResult = IDNOACTION;
-    WIU_MSI_EXECUTE_MESSAGE message = { };
     LPWSTR* rgsczData = NULL;
     DWORD cData = 0;
 
+    nResult = FlushPendingMessages(pContext);
+    if (IDCANCEL == nResult)
+    {
+        return nResult;
+    }
+
     InitializeMessageData(hRecord, &rgsczData, &cData);
 
+    nResult = DeliverMsiMessage(pContext, mt, uiFlags, wzMessage, rgsczData, cData);
+
+    UninitializeMessageData(rgsczData, cData);
+    return nResult;
+}
+
+static INT DeliverMsiMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in INSTALLMESSAGE mt,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzMessage,
+    __in_ecount(cData) LPWSTR* rgsczData,
+    __in DWORD cData
+    )
+{
+    INT nResult = IDNOACTION;
+    WIU_MSI_EXECUTE_MESSAGE message = { };
+
     message.type = WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE;
     message.dwAllowedResults = uiFlags;
     message.cData = cData;
@@ -1407,8 +1540,8 @@ static INT SendMsiMessage(
     message.msiMessage.mt = mt;
     message.msiMessage.wzMessage = wzMessage;
     nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    ++pContext->cDeliveredMessages;
 
-    UninitializeMessageData(rgsczData, cData);
     return nResult;
 }
 
@@ -1442,6 +1575,11 @@ static INT SendErrorMessage(
         }
     }
 
+    if (IDCANCEL == FlushPendingMessages(pContext))
+    {
+        return IDCANCEL;
+    }
+
     InitializeMessageData(hRecord, &rgsczData, &cData);
 
     message.type = WIU_MSI_EXECUTE_MESSAGE_ERROR;
@@ -1452,6 +1590,7 @@ static INT SendErrorMessage(
     message.error.dwErrorCode = dwErrorCode;
     message.error.wzMessage = wzMessage;
     nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    ++pContext->cDeliveredMessages;
 
     UninitializeMessageData(rgsczData, cData);
     return nResult;
@@ -1468,6 +1607,12 @@ static INT SendFilesInUseMessage(
     LPWSTR* rgsczData = NULL;
     DWORD cData = 0;
 
+    nResult = FlushPendingMessages(pContext);
+    if (IDCANCEL == nResult)
+    {
+        return nResult;
+    }
+
     InitializeMessageData(hRecord, &rgsczData, &cData);
 
     message.type = WIU_MSI_EXECUTE_MESSAGE_MSI_FILES_IN_USE;
@@ -1477,6 +1622,7 @@ static INT SendFilesInUseMessage(
     message.msiFilesInUse.cFiles = message.cData;       // point the files in use information to the message record information.
     message.msiFilesInUse.rgwzFiles = message.rgwzData;
     nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    ++pContext->cDeliveredMessages;
 
     UninitializeMessageData(rgsczData, cData);
     return nResult;
@@ -1526,14 +1672,137 @@ static INT SendProgressUpdate(
     //AssertSz(qwCompleted <= qwTotal, "Completed progress is larger than total progress.");
 #endif
 
+    // Hold the latest percentage until the relay interval elapses so file heavy
+    // packages do not make a round trip to the handler for every tick.
+    if (!IsRelayDue(&pContext->dwLastProgressTick))
+    {
+        if (pContext->fPendingProgress)
+        {
+            ++pContext->cCoalescedProgress;
+        }
+
+        pContext->fPendingProgress = TRUE;
+        pContext->dwPendingPercentage = dwPercentage;
+
+        return IDOK;
+    }
+
+    if (pContext->fPendingProgress)
+    {
+        pContext->fPendingProgress = FALSE;
+        ++pContext->cCoalescedProgress;
+    }
+
+    nResult = SendProgressMessage(pContext, dwPercentage);
+
+    return nResult;
+}
+
+static INT SendProgressMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in DWORD dwPercentage
+    )
+{
+    int nResult = IDNOACTION;
+    WIU_MSI_EXECUTE_MESSAGE message = { };
+
     message.type = WIU_MSI_EXECUTE_MESSAGE_PROGRESS;
     message.dwAllowedResults = MB_OKCANCEL;
     message.progress.dwPercentage = dwPercentage;
     nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    ++pContext->cDeliveredMessages;
 
     return nResult;
 }
 
+static INT SendActionData(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzMessage,
+    __in_opt MSIHANDLE hRecord
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pContext->fPendingActionData)
+    {
+        ++pContext->cCoalescedActionData;
+        ReleasePendingActionData(pContext);
+    }
+
+    // Action data only describes the item currently being processed so hold just the
+    // latest one until the relay interval elapses or another message flushes it.
+    if (!IsRelayDue(&pContext->dwLastActionDataTick))
+    {
+        hr = StrAllocString(&pContext->sczPendingActionData, wzMessage, 0);
+        if (SUCCEEDED(hr))
+        {
+            InitializeMessageData(hRecord, &pContext->rgsczPendingActionData, &pContext->cPendingActionData);
+
+            pContext->uiPendingActionDataFlags = uiFlags;
+            pContext->fPendingActionData = TRUE;
+        }
+
+        return IDOK;
+    }
+
+    return SendMsiMessage(pContext, INSTALLMESSAGE_ACTIONDATA, uiFlags, wzMessage, hRecord);
+}
+
+static INT FlushPendingMessages(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext
+    )
+{
+    INT nResult = IDNOACTION;
+
+    if (pContext->fPendingActionData)
+    {
+        pContext->fPendingActionData = FALSE;
+        pContext->dwLastActionDataTick = ::GetTickCount();
+
+        nResult = DeliverMsiMessage(pContext, INSTALLMESSAGE_ACTIONDATA, pContext->uiPendingActionDataFlags, pContext->sczPendingActionData, pContext->rgsczPendingActionData, pContext->cPendingActionData);
+
+        ReleasePendingActionData(pContext);
+    }
+
+    if (IDCANCEL != nResult && pContext->fPendingProgress)
+    {
+        pContext->fPendingProgress = FALSE;
+        pContext->dwLastProgressTick = ::GetTickCount();
+
+        nResult = SendProgressMessage(pContext, pContext->dwPendingPercentage);
+    }
+
+    return nResult;
+}
+
+static void ReleasePendingActionData(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext
+    )
+{
+    UninitializeMessageData(pContext->rgsczPendingActionData, pContext->cPendingActionData);
+    ReleaseNullStr(pContext->sczPendingActionData);
+
+    pContext->rgsczPendingActionData = NULL;
+    pContext->cPendingActionData = 0;
+    pContext->fPendingActionData = FALSE;
+}
+
+static BOOL IsRelayDue(
+    __inout DWORD* pdwLastTick
+    )
+{
+    DWORD dwTick = ::GetTickCount();
+
+    if (WIU_MSI_EXECUTE_RELAY_INTERVAL > dwTick - *pdwLastTick)
+    {
+        return FALSE;
+    }
+
+    *pdwLastTick = dwTick;
+    return TRUE;
+}
+
 static void ResetProgress(
     __in WIU_MSI_EXECUTE_CONTEXT* pContext
     )
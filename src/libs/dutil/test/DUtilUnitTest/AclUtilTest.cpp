@@ -0,0 +1,287 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+typedef struct _ACL_TEST_PROGRESS
+{
+    DWORD cCalls;
+    DWORD cLastCompleted;
+    DWORD cLastTotal;
+} ACL_TEST_PROGRESS;
+
+static HRESULT CALLBACK TestPropagationProgress(
+    __in DWORD cCompleted,
+    __in DWORD cTotal,
+    __in_opt LPVOID pvContext
+    );
+
+namespace DutilTests
+{
+    public ref class AclUtil
+    {
+    public:
+        [Fact]
+        void AclPropagateInheritanceCarriesAcesIntoSubtreesTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczRoot = NULL;
+            LPWSTR sczPath = NULL;
+            LPWSTR sczFailedPath = NULL;
+            PSID psidGuests = NULL;
+            ACL_TEST_PROGRESS progress = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                sczRoot = CreateTestFolder(L"%TEMP%\\AclUtilTest\\Propagate");
+
+                CreateTestDirectory(sczRoot, L"A", &sczPath);
+                CreateTestFile(sczRoot, L"A\\file.txt", &sczPath);
+                CreateTestDirectory(sczRoot, L"B", &sczPath);
+                CreateTestDirectory(sczRoot, L"B\\Sub", &sczPath);
+                CreateTestFile(sczRoot, L"B\\Sub\\file.txt", &sczPath);
+                CreateTestFile(sczRoot, L"C.txt", &sczPath);
+                CreateTestDirectory(sczRoot, L"Protected", &sczPath);
+                ProtectDacl(sczPath);
+                CreateTestFile(sczRoot, L"Protected\\file.txt", &sczPath);
+
+                hr = AclGetWellKnownSid(WinBuiltinGuestsSid, &psidGuests);
+                NativeAssert::Succeeded(hr, "Failed to get Guests SID.");
+
+                AddInheritableAceWithoutPropagation(sczRoot, psidGuests);
+
+                hr = PathConcat(sczRoot, L"B\\Sub\\file.txt", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to build path.");
+                Assert::False(HasInheritedAce(sczPath, psidGuests));
+
+                hr = AclPropagateInheritance(sczRoot, 2, 10, TestPropagationProgress, &progress, &sczFailedPath);
+                NativeAssert::Succeeded(hr, "Failed to propagate inheritance.");
+                Assert::True(NULL == sczFailedPath);
+
+                Assert::True(0 < progress.cCalls);
+                Assert::Equal<DWORD>(4, progress.cLastTotal);
+                Assert::Equal<DWORD>(4, progress.cLastCompleted);
+
+                Assert::True(HasInheritedAce(sczPath, psidGuests));
+
+                hr = PathConcat(sczRoot, L"A\\file.txt", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to build path.");
+                Assert::True(HasInheritedAce(sczPath, psidGuests));
+
+                hr = PathConcat(sczRoot, L"C.txt", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to build path.");
+                Assert::True(HasInheritedAce(sczPath, psidGuests));
+
+                hr = PathConcat(sczRoot, L"Protected\\file.txt", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to build path.");
+                Assert::False(HasInheritedAce(sczPath, psidGuests));
+            }
+            finally
+            {
+                ReleaseSid(psidGuests);
+                ReleaseStr(sczFailedPath);
+                ReleaseStr(sczPath);
+                DeleteTestFolder(sczRoot);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void AclPropagateInheritanceHandlesEmptyAndMissingFoldersTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczRoot = NULL;
+            LPWSTR sczPath = NULL;
+            ACL_TEST_PROGRESS progress = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                sczRoot = CreateTestFolder(L"%TEMP%\\AclUtilTest\\Empty");
+
+                hr = AclPropagateInheritance(sczRoot, 0, 10, TestPropagationProgress, &progress, NULL);
+                NativeAssert::Succeeded(hr, "Failed to propagate inheritance to an empty folder.");
+                Assert::Equal<DWORD>(0, progress.cCalls);
+
+                hr = PathConcat(sczRoot, L"Missing", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to build path.");
+
+                hr = AclPropagateInheritance(sczPath, 0, 10, NULL, NULL, NULL);
+                Assert::True(FAILED(hr));
+            }
+            finally
+            {
+                ReleaseStr(sczPath);
+                DeleteTestFolder(sczRoot);
+                DutilUninitialize();
+            }
+        }
+
+    private:
+        LPWSTR CreateTestFolder(LPCWSTR wzPath)
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczRoot = NULL;
+
+            hr = PathExpand(&sczRoot, wzPath, PATH_EXPAND_ENVIRONMENT);
+            NativeAssert::Succeeded(hr, "Failed to expand test folder path.");
+
+            hr = DirEnsureDelete(sczRoot, TRUE, TRUE);
+            if (E_PATHNOTFOUND == hr)
+            {
+                hr = S_OK;
+            }
+            NativeAssert::Succeeded(hr, "Failed to delete test folder.");
+
+            hr = DirEnsureExists(sczRoot, NULL);
+            NativeAssert::Succeeded(hr, "Failed to create test folder.");
+
+            return sczRoot;
+        }
+
+        void DeleteTestFolder(LPWSTR sczRoot)
+        {
+            if (sczRoot)
+            {
+                DirEnsureDelete(sczRoot, TRUE, TRUE);
+                ReleaseStr(sczRoot);
+            }
+        }
+
+        void CreateTestDirectory(LPCWSTR wzRoot, LPCWSTR wzRelativePath, LPWSTR* psczPath)
+        {
+            HRESULT hr = PathConcat(wzRoot, wzRelativePath, psczPath);
+            NativeAssert::Succeeded(hr, "Failed to build directory path.");
+
+            hr = DirEnsureExists(*psczPath, NULL);
+            NativeAssert::Succeeded(hr, "Failed to create directory.");
+        }
+
+        void CreateTestFile(LPCWSTR wzRoot, LPCWSTR wzRelativePath, LPWSTR* psczPath)
+        {
+            HRESULT hr = PathConcat(wzRoot, wzRelativePath, psczPath);
+            NativeAssert::Succeeded(hr, "Failed to build file path.");
+
+            hr = FileWrite(*psczPath, FILE_ATTRIBUTE_NORMAL, reinterpret_cast<LPCBYTE>("test"), 4, NULL);
+            NativeAssert::Succeeded(hr, "Failed to create file.");
+        }
+
+        void ProtectDacl(LPCWSTR wzPath)
+        {
+            HRESULT hr = S_OK;
+            PACL pAcl = NULL;
+            PSECURITY_DESCRIPTOR psd = NULL;
+
+            try
+            {
+                hr = HRESULT_FROM_WIN32(::GetNamedSecurityInfoW(wzPath, SE_FILE_OBJECT, DACL_SECURITY_INFORMATION, NULL, NULL, &pAcl, NULL, &psd));
+                NativeAssert::Succeeded(hr, "Failed to get DACL.");
+
+                hr = HRESULT_FROM_WIN32(::SetNamedSecurityInfoW(const_cast<LPWSTR>(wzPath), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION, NULL, NULL, pAcl, NULL));
+                NativeAssert::Succeeded(hr, "Failed to protect DACL.");
+            }
+            finally
+            {
+                if (psd)
+                {
+                    ::LocalFree(psd);
+                }
+            }
+        }
+
+        // Writes the folder's DACL the way the secure objects custom action does, so nothing below it changes yet.
+        void AddInheritableAceWithoutPropagation(LPCWSTR wzFolder, PSID psid)
+        {
+            HRESULT hr = S_OK;
+            PACL pAcl = NULL;
+            PACL pAclNew = NULL;
+            PSECURITY_DESCRIPTOR psd = NULL;
+            SECURITY_DESCRIPTOR sd = { };
+            EXPLICIT_ACCESSW ea = { };
+
+            try
+            {
+                hr = HRESULT_FROM_WIN32(::GetNamedSecurityInfoW(wzFolder, SE_FILE_OBJECT, DACL_SECURITY_INFORMATION, NULL, NULL, &pAcl, NULL, &psd));
+                NativeAssert::Succeeded(hr, "Failed to get DACL.");
+
+                ea.grfAccessMode = GRANT_ACCESS;
+                ea.grfAccessPermissions = FILE_GENERIC_READ;
+                ea.grfInheritance = SUB_CONTAINERS_AND_OBJECTS_INHERIT;
+                ::BuildTrusteeWithSidW(&ea.Trustee, psid);
+
+                hr = HRESULT_FROM_WIN32(::SetEntriesInAclW(1, &ea, pAcl, &pAclNew));
+                NativeAssert::Succeeded(hr, "Failed to add ACE.");
+
+                Assert::True(::InitializeSecurityDescriptor(&sd, SECURITY_DESCRIPTOR_REVISION));
+                Assert::True(::SetSecurityDescriptorDacl(&sd, TRUE, pAclNew, FALSE));
+                Assert::True(::SetFileSecurityW(wzFolder, DACL_SECURITY_INFORMATION, &sd));
+            }
+            finally
+            {
+                if (pAclNew)
+                {
+                    ::LocalFree(pAclNew);
+                }
+
+                if (psd)
+                {
+                    ::LocalFree(psd);
+                }
+            }
+        }
+
+        bool HasInheritedAce(LPCWSTR wzPath, PSID psid)
+        {
+            HRESULT hr = S_OK;
+            PACL pAcl = NULL;
+            PSECURITY_DESCRIPTOR psd = NULL;
+            bool fFound = false;
+
+            try
+            {
+                hr = HRESULT_FROM_WIN32(::GetNamedSecurityInfoW(wzPath, SE_FILE_OBJECT, DACL_SECURITY_INFORMATION, NULL, NULL, &pAcl, NULL, &psd));
+                NativeAssert::Succeeded(hr, "Failed to get DACL.");
+
+                for (DWORD i = 0; pAcl && !fFound && i < pAcl->AceCount; ++i)
+                {
+                    ACCESS_ALLOWED_ACE* pAce = NULL;
+
+                    Assert::True(::GetAce(pAcl, i, reinterpret_cast<LPVOID*>(&pAce)));
+
+                    fFound = ACCESS_ALLOWED_ACE_TYPE == pAce->Header.AceType && (pAce->Header.AceFlags & INHERITED_ACE) && ::EqualSid(&pAce->SidStart, psid);
+                }
+            }
+            finally
+            {
+                if (psd)
+                {
+                    ::LocalFree(psd);
+                }
+            }
+
+            return fFound;
+        }
+    };
+}
+
+
+static HRESULT CALLBACK TestPropagationProgress(
+    __in DWORD cCompleted,
+    __in DWORD cTotal,
+    __in_opt LPVOID pvContext
+    )
+{
+    ACL_TEST_PROGRESS* pProgress = reinterpret_cast<ACL_TEST_PROGRESS*>(pvContext);
+
+    ++pProgress->cCalls;
+    pProgress->cLastCompleted = cCompleted;
+    pProgress->cLastTotal = cTotal;
+
+    return S_OK;
+}
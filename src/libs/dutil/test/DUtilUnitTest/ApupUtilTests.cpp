@@ -39,6 +39,146 @@ namespace DutilTests
             }
             finally
             {
+                ReleaseApupChain(pChain);
+                ReleaseAtomFeed(pFeed);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void AllocChainFromFileMatchesAtomChain()
+        {
+            HRESULT hr = S_OK;
+            APPLICATION_UPDATE_CHAIN* pChain = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pin_ptr<const wchar_t> feedFilePath = PtrToStringChars(TestData::Get("TestData", "ApupUtilTests", "FeedBv2.0.xml"));
+                hr = ApupAllocChainFromFile(feedFilePath, NULL, &pChain);
+                NativeAssert::Succeeded(hr, "Failed to stream chain from feed: {0}", feedFilePath);
+
+                NativeAssert::StringEqual(L"1116353B-7C6E-4C29-BFA1-D4A972CD421D", pChain->wzDefaultApplicationId);
+                NativeAssert::StringEqual(L"application/exe", pChain->wzDefaultApplicationType);
+
+                Assert::Equal(3ul, pChain->cEntries);
+                NativeAssert::StringEqual(L"Bundle v2.0", pChain->rgEntries[0].wzTitle);
+                NativeAssert::StringEqual(L"Bundle v1.0", pChain->rgEntries[1].wzTitle);
+                NativeAssert::StringEqual(L"Bundle v1.0-preview", pChain->rgEntries[2].wzTitle);
+
+                NativeAssert::StringEqual(L"1.0.0.0-preview", pChain->rgEntries[1].pUpgradeVersion->sczVersion);
+                NativeAssert::StringEqual(L"html", pChain->rgEntries[1].wzContentType);
+                Assert::Equal(1ul, pChain->rgEntries[2].cEnclosures);
+                NativeAssert::StringEqual(L"http://localhost:9999/wix4/BundleB/1.0-preview/BundleB.exe", pChain->rgEntries[2].rgEnclosures[0].wzUrl);
+                Assert::Equal<DWORD64>(10000, pChain->rgEntries[2].dw64TotalSize);
+            }
+            finally
+            {
+                ReleaseApupChain(pChain);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void AllocChainFromFileSkipsEntriesNotNewerThanMinimum()
+        {
+            HRESULT hr = S_OK;
+            APPLICATION_UPDATE_CHAIN* pChain = NULL;
+            VERUTIL_VERSION* pMinimumVersion = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = VerParseVersion(L"1.0.0.0", 0, FALSE, &pMinimumVersion);
+                NativeAssert::Succeeded(hr, "Failed to parse minimum version.");
+
+                pin_ptr<const wchar_t> feedFilePath = PtrToStringChars(TestData::Get("TestData", "ApupUtilTests", "FeedBv2.0.xml"));
+                hr = ApupAllocChainFromFile(feedFilePath, pMinimumVersion, &pChain);
+                NativeAssert::Succeeded(hr, "Failed to stream chain from feed: {0}", feedFilePath);
+
+                Assert::Equal(1ul, pChain->cEntries);
+                NativeAssert::StringEqual(L"Bundle v2.0", pChain->rgEntries[0].wzTitle);
+                NativeAssert::StringEqual(L"2.0.0.0", pChain->rgEntries[0].pVersion->sczVersion);
+            }
+            finally
+            {
+                ReleaseApupChain(pChain);
+                ReleaseVerutilVersion(pMinimumVersion);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void AllocChainFromFileMatchesAllocChainFromAtom()
+        {
+            HRESULT hr = S_OK;
+            const int cEntries = 5000;
+            const int cNewerEntries = 10;
+            String^ feedPath = IO::Path::GetTempFileName();
+            Text::StringBuilder^ feed = gcnew Text::StringBuilder();
+            ATOM_FEED* pFeed = NULL;
+            APPLICATION_UPDATE_CHAIN* pDomChain = NULL;
+            APPLICATION_UPDATE_CHAIN* pStreamChain = NULL;
+            VERUTIL_VERSION* pMinimumVersion = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                feed->Append("<?xml version='1.0' ?>\n<feed xmlns='http://www.w3.org/2005/Atom' xmlns:as='http://appsyndication.org/2006/appsyn'>\n");
+                feed->Append("  <title type='text'>Large feed</title>\n  <id>http://localhost/feed</id>\n  <updated>2014-07-14T12:39:00.000Z</updated>\n");
+                feed->Append("  <as:application type='application/exe'>1116353B-7C6E-4C29-BFA1-D4A972CD421D</as:application>\n");
+
+                for (int i = 0; i < cEntries; ++i)
+                {
+                    feed->AppendFormat("  <entry>\n    <title>Bundle v1.0.{0}</title>\n    <id>v1.0.{0}</id>\n    <updated>2014-11-10T12:39:00.000Z</updated>\n", i);
+                    feed->AppendFormat("    <link rel='enclosure' href='http://localhost/1.0.{0}/Bundle.exe' length='{1}'>\n", i, 1000 + i);
+                    feed->Append("      <as:digest algorithm='sha256'>0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF</as:digest>\n    </link>\n");
+                    feed->Append("    <content type='html'>&lt;p&gt;Change list:&lt;/p&gt;</content>\n");
+                    feed->AppendFormat("    <as:upgrade version='1.0.0.0' />\n    <as:version>1.0.{0}.1</as:version>\n  </entry>\n", i);
+                }
+
+                feed->Append("</feed>\n");
+                IO::File::WriteAllText(feedPath, feed->ToString());
+
+                pin_ptr<const wchar_t> wzFeedPath = PtrToStringChars(feedPath);
+
+                hr = VerParseVersion(L"1.0.4990.0", 0, FALSE, &pMinimumVersion);
+                NativeAssert::Succeeded(hr, "Failed to parse minimum version.");
+
+                XmlInitialize();
+
+                hr = AtomParseFromFile(wzFeedPath, &pFeed);
+                NativeAssert::Succeeded(hr, "Failed to parse feed: {0}", wzFeedPath);
+
+                hr = ApupAllocChainFromAtom(pFeed, &pDomChain);
+                NativeAssert::Succeeded(hr, "Failed to get chain from feed.");
+
+                hr = ApupAllocChainFromFile(wzFeedPath, pMinimumVersion, &pStreamChain);
+                NativeAssert::Succeeded(hr, "Failed to stream chain from feed: {0}", wzFeedPath);
+
+                Assert::Equal<DWORD>(cEntries, pDomChain->cEntries);
+                Assert::Equal<DWORD>(cNewerEntries, pStreamChain->cEntries);
+
+                // The streamed chain is the head of the full chain.
+                for (DWORD i = 0; i < pStreamChain->cEntries; ++i)
+                {
+                    NativeAssert::StringEqual(pDomChain->rgEntries[i].wzTitle, pStreamChain->rgEntries[i].wzTitle);
+                    NativeAssert::StringEqual(pDomChain->rgEntries[i].rgEnclosures[0].wzUrl, pStreamChain->rgEntries[i].rgEnclosures[0].wzUrl);
+                    Assert::Equal(pDomChain->rgEntries[i].dw64TotalSize, pStreamChain->rgEntries[i].dw64TotalSize);
+                    Assert::Equal(pDomChain->rgEntries[i].rgEnclosures[0].cbDigest, pStreamChain->rgEntries[i].rgEnclosures[0].cbDigest);
+                    Assert::True(0 == memcmp(pDomChain->rgEntries[i].rgEnclosures[0].rgbDigest, pStreamChain->rgEntries[i].rgEnclosures[0].rgbDigest, pStreamChain->rgEntries[i].rgEnclosures[0].cbDigest));
+                }
+            }
+            finally
+            {
+                ReleaseApupChain(pStreamChain);
+                ReleaseApupChain(pDomChain);
+                ReleaseAtomFeed(pFeed);
+                ReleaseVerutilVersion(pMinimumVersion);
+                IO::File::Delete(feedPath);
                 DutilUninitialize();
             }
         }
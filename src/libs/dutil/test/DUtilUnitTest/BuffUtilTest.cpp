@@ -0,0 +1,134 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class BuffUtil
+    {
+    public:
+        [Fact]
+        void BuffWriterMatchesBuffWriteTest()
+        {
+            HRESULT hr = S_OK;
+            BUFF_WRITER writer = { };
+            BYTE* pbBuffer = NULL;
+            SIZE_T cbBuffer = 0;
+            LPWSTR sczValue = NULL;
+            LPSTR sczAnsiValue = NULL;
+            BYTE* pbStream = NULL;
+            SIZE_T cbStream = 0;
+            SIZE_T iBuffer = 0;
+            DWORD dw = 0;
+            DWORD64 dw64 = 0;
+            DWORD_PTR dwPtr = 0;
+            const BYTE rgbStream[] = { 1, 2, 3, 4, 5 };
+            LPCWSTR rgwzStrings[] = { L"first", NULL, L"", L"fourth" };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = BuffWriterReserve(&writer, 16);
+                NativeAssert::Succeeded(hr, "Failed to reserve writer capacity.");
+
+                for (DWORD i = 0; i < 100; ++i)
+                {
+                    hr = BuffWriterWriteNumber(&writer, i);
+                    NativeAssert::Succeeded(hr, "Failed to write number.");
+
+                    hr = BuffWriteNumber(&pbBuffer, &cbBuffer, i);
+                    NativeAssert::Succeeded(hr, "Failed to write number.");
+
+                    hr = BuffWriterWriteNumber64(&writer, 0x1000000000ull + i);
+                    NativeAssert::Succeeded(hr, "Failed to write number64.");
+
+                    hr = BuffWriteNumber64(&pbBuffer, &cbBuffer, 0x1000000000ull + i);
+                    NativeAssert::Succeeded(hr, "Failed to write number64.");
+
+                    hr = BuffWriterWritePointer(&writer, i);
+                    NativeAssert::Succeeded(hr, "Failed to write pointer.");
+
+                    hr = BuffWritePointer(&pbBuffer, &cbBuffer, i);
+                    NativeAssert::Succeeded(hr, "Failed to write pointer.");
+
+                    hr = BuffWriterWriteStrings(&writer, rgwzStrings, countof(rgwzStrings));
+                    NativeAssert::Succeeded(hr, "Failed to write strings.");
+
+                    for (DWORD j = 0; j < countof(rgwzStrings); ++j)
+                    {
+                        hr = BuffWriteString(&pbBuffer, &cbBuffer, rgwzStrings[j]);
+                        NativeAssert::Succeeded(hr, "Failed to write string.");
+                    }
+
+                    hr = BuffWriterWriteString(&writer, L"single");
+                    NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                    hr = BuffWriteString(&pbBuffer, &cbBuffer, L"single");
+                    NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                    hr = BuffWriterWriteStringAnsi(&writer, "ansi");
+                    NativeAssert::Succeeded(hr, "Failed to write ansi string.");
+
+                    hr = BuffWriteStringAnsi(&pbBuffer, &cbBuffer, "ansi");
+                    NativeAssert::Succeeded(hr, "Failed to write ansi string.");
+
+                    hr = BuffWriterWriteStream(&writer, rgbStream, countof(rgbStream));
+                    NativeAssert::Succeeded(hr, "Failed to write stream.");
+
+                    hr = BuffWriteStream(&pbBuffer, &cbBuffer, rgbStream, countof(rgbStream));
+                    NativeAssert::Succeeded(hr, "Failed to write stream.");
+                }
+
+                Assert::Equal<DWORD>(static_cast<DWORD>(cbBuffer), static_cast<DWORD>(writer.cbData));
+                Assert::Equal(0, memcmp(pbBuffer, writer.pbData, cbBuffer));
+
+                // the writer's buffer reads back with the existing readers
+                hr = BuffReadNumber(writer.pbData, writer.cbData, &iBuffer, &dw);
+                NativeAssert::Succeeded(hr, "Failed to read number.");
+                Assert::Equal<DWORD>(0, dw);
+
+                hr = BuffReadNumber64(writer.pbData, writer.cbData, &iBuffer, &dw64);
+                NativeAssert::Succeeded(hr, "Failed to read number64.");
+                Assert::Equal<DWORD64>(0x1000000000ull, dw64);
+
+                hr = BuffReadPointer(writer.pbData, writer.cbData, &iBuffer, &dwPtr);
+                NativeAssert::Succeeded(hr, "Failed to read pointer.");
+                Assert::Equal<DWORD64>(0, dwPtr);
+
+                for (DWORD j = 0; j < countof(rgwzStrings); ++j)
+                {
+                    hr = BuffReadString(writer.pbData, writer.cbData, &iBuffer, &sczValue);
+                    NativeAssert::Succeeded(hr, "Failed to read string.");
+                    NativeAssert::StringEqual(rgwzStrings[j] ? rgwzStrings[j] : L"", sczValue);
+                }
+
+                hr = BuffReadString(writer.pbData, writer.cbData, &iBuffer, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to read string.");
+                NativeAssert::StringEqual(L"single", sczValue);
+
+                hr = BuffReadStringAnsi(writer.pbData, writer.cbData, &iBuffer, &sczAnsiValue);
+                NativeAssert::Succeeded(hr, "Failed to read ansi string.");
+                Assert::Equal(0, strcmp("ansi", sczAnsiValue));
+
+                hr = BuffReadStream(writer.pbData, writer.cbData, &iBuffer, &pbStream, &cbStream);
+                NativeAssert::Succeeded(hr, "Failed to read stream.");
+                Assert::Equal<DWORD>(countof(rgbStream), static_cast<DWORD>(cbStream));
+                Assert::Equal(0, memcmp(rgbStream, pbStream, cbStream));
+            }
+            finally
+            {
+                ReleaseMem(pbStream);
+                ReleaseStr(sczAnsiValue);
+                ReleaseStr(sczValue);
+                ReleaseBuffer(pbBuffer);
+                ReleaseBuffWriter(writer);
+                DutilUninitialize();
+            }
+        }
+    };
+}
@@ -8,6 +8,12 @@ using namespace WixBuildTools::TestSupport;
 
 namespace DutilTests
 {
+    static HRESULT CALLBACK DeleteTreeProgress(
+        __in DWORD cScanned,
+        __in DWORD cDirectories,
+        __in_opt LPVOID pvContext
+        );
+
     public ref class DirUtil
     {
     public:
@@ -66,5 +72,238 @@ namespace DutilTests
                 ReleaseStr(sczCurrentDir);
             }
         }
+
+        [Fact]
+        void DirUtilDeleteTreeTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczCurrentDir = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczSubFolder = NULL;
+            DIR_DELETE_TREE_RESULTS results = { };
+            DWORD rgdwProgress[2] = { };
+
+            try
+            {
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = DirGetCurrent(&sczCurrentDir);
+                NativeAssert::Succeeded(hr, "Failed to get current directory.");
+
+                hr = PathConcat(sczCurrentDir, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine current directory: '{0}' with Guid: '{1}'", sczCurrentDir, sczGuid);
+
+                hr = PathConcat(sczFolder, L"a\\b\\c", &sczSubFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine folder: '{0}' with subfolders", sczFolder);
+
+                hr = DirEnsureExists(sczSubFolder, NULL);
+                NativeAssert::Succeeded(hr, "Failed to create multiple directories: {0}", sczSubFolder);
+
+                CreateTestFile(sczFolder, L"root.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczFolder, L"a\\one.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczFolder, L"a\\readonly.txt", FILE_ATTRIBUTE_READONLY);
+                CreateTestFile(sczFolder, L"a\\b\\two.txt", FILE_ATTRIBUTE_HIDDEN);
+                CreateTestFile(sczFolder, L"a\\b\\c\\three.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczFolder, L"a\\b\\c\\four.txt", FILE_ATTRIBUTE_NORMAL);
+
+                hr = DirDeleteTree(sczFolder, 4, DeleteTreeProgress, rgdwProgress, &results);
+                NativeAssert::Succeeded(hr, "Failed to delete directory tree: {0}", sczFolder);
+
+                Assert::False(DirExists(sczFolder, NULL));
+                Assert::Equal<DWORD>(4, results.cDirectories);
+                Assert::Equal<DWORD>(10, results.cDeleted);
+                Assert::Equal<DWORD>(0, results.cRebootRequired);
+                Assert::Equal<DWORD>(0, results.cSkipped);
+                Assert::Equal<DWORD>(4, results.cThreads);
+
+                // The last progress call sees every directory scanned.
+                Assert::Equal<DWORD>(4, rgdwProgress[0]);
+                Assert::Equal<DWORD>(4, rgdwProgress[1]);
+
+                hr = DirDeleteTree(sczFolder, 0, NULL, NULL, &results);
+                Assert::Equal(S_FALSE, hr);
+                Assert::Equal<DWORD>(0, results.cDeleted);
+            }
+            finally
+            {
+                if (sczFolder)
+                {
+                    DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                ReleaseStr(sczSubFolder);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczCurrentDir);
+            }
+        }
+
+        [Fact]
+        void DirUtilMoveTreeTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczCurrentDir = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczSource = NULL;
+            LPWSTR sczBackup = NULL;
+            LPWSTR sczPath = NULL;
+            HANDLE hInUse = INVALID_HANDLE_VALUE;
+
+            try
+            {
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = DirGetCurrent(&sczCurrentDir);
+                NativeAssert::Succeeded(hr, "Failed to get current directory.");
+
+                hr = PathConcat(sczCurrentDir, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine current directory: '{0}' with Guid: '{1}'", sczCurrentDir, sczGuid);
+
+                hr = PathConcat(sczFolder, L"source", &sczSource);
+                NativeAssert::Succeeded(hr, "Failed to combine folder: '{0}' with source", sczFolder);
+
+                hr = PathConcat(sczFolder, L"backup", &sczBackup);
+                NativeAssert::Succeeded(hr, "Failed to combine folder: '{0}' with backup", sczFolder);
+
+                // Nothing in the way, so the whole tree is renamed.
+                CreateTestFile(sczSource, L"a\\one.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczSource, L"two.txt", FILE_ATTRIBUTE_NORMAL);
+
+                hr = DirMoveTree(sczSource, sczBackup, FALSE);
+                NativeAssert::Succeeded(hr, "Failed to move directory tree: {0}", sczSource);
+
+                Assert::False(DirExists(sczSource, NULL));
+                VerifyFileExists(sczBackup, L"a\\one.txt", &sczPath);
+                VerifyFileExists(sczBackup, L"two.txt", &sczPath);
+
+                // The backup already exists, so the children are merged into it.
+                CreateTestFile(sczSource, L"a\\three.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczSource, L"two.txt", FILE_ATTRIBUTE_READONLY);
+
+                hr = DirMoveTree(sczSource, sczBackup, FALSE);
+                Assert::Equal(HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS), hr);
+                VerifyFileExists(sczBackup, L"a\\three.txt", &sczPath);
+                VerifyFileExists(sczSource, L"two.txt", &sczPath);
+
+                hr = DirMoveTree(sczSource, sczBackup, TRUE);
+                NativeAssert::Succeeded(hr, "Failed to merge directory tree: {0}", sczSource);
+
+                Assert::False(DirExists(sczSource, NULL));
+                VerifyFileExists(sczBackup, L"a\\one.txt", &sczPath);
+
+                // A file in use stays behind and everything else still moves.
+                CreateTestFile(sczSource, L"a\\four.txt", FILE_ATTRIBUTE_NORMAL);
+                CreateTestFile(sczSource, L"inuse.txt", FILE_ATTRIBUTE_NORMAL);
+
+                hr = PathConcat(sczSource, L"inuse.txt", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to combine source: '{0}' with inuse.txt", sczSource);
+
+                hInUse = ::CreateFileW(sczPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (INVALID_HANDLE_VALUE == hInUse)
+                {
+                    hr = HRESULT_FROM_WIN32(::GetLastError());
+                    NativeAssert::Succeeded(hr, "Failed to open file: {0}", sczPath);
+                }
+
+                hr = DirMoveTree(sczSource, sczBackup, TRUE);
+                Assert::Equal(HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION), hr);
+                VerifyFileExists(sczBackup, L"a\\four.txt", &sczPath);
+                VerifyFileExists(sczSource, L"inuse.txt", &sczPath);
+
+                ReleaseFileHandle(hInUse);
+
+                // Moving the backup back restores everything that was moved aside.
+                hr = DirMoveTree(sczBackup, sczSource, TRUE);
+                NativeAssert::Succeeded(hr, "Failed to restore directory tree: {0}", sczBackup);
+
+                Assert::False(DirExists(sczBackup, NULL));
+                VerifyFileExists(sczSource, L"a\\one.txt", &sczPath);
+                VerifyFileExists(sczSource, L"a\\three.txt", &sczPath);
+                VerifyFileExists(sczSource, L"a\\four.txt", &sczPath);
+                VerifyFileExists(sczSource, L"two.txt", &sczPath);
+                VerifyFileExists(sczSource, L"inuse.txt", &sczPath);
+            }
+            finally
+            {
+                ReleaseFileHandle(hInUse);
+
+                if (sczFolder)
+                {
+                    DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE);
+                }
+
+                ReleaseStr(sczPath);
+                ReleaseStr(sczBackup);
+                ReleaseStr(sczSource);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczCurrentDir);
+            }
+        }
+
+    private:
+        void VerifyFileExists(
+            __in_z LPCWSTR wzDirectory,
+            __in_z LPCWSTR wzFileName,
+            __inout_z LPWSTR* psczPath
+            )
+        {
+            HRESULT hr = PathConcat(wzDirectory, wzFileName, psczPath);
+            NativeAssert::Succeeded(hr, "Failed to combine directory: '{0}' with file: '{1}'", wzDirectory, wzFileName);
+
+            Assert::True(FileExistsEx(*psczPath, NULL));
+        }
+
+        void CreateTestFile(
+            __in_z LPCWSTR wzDirectory,
+            __in_z LPCWSTR wzFileName,
+            __in DWORD dwFlagsAndAttributes
+            )
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczPath = NULL;
+            LPWSTR sczParent = NULL;
+            const BYTE rgbData[] = { 'w', 'i', 'x' };
+
+            try
+            {
+                hr = PathConcat(wzDirectory, wzFileName, &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to combine directory: '{0}' with file: '{1}'", wzDirectory, wzFileName);
+
+                hr = PathGetParentPath(sczPath, &sczParent);
+                NativeAssert::Succeeded(hr, "Failed to get parent of: {0}", sczPath);
+
+                hr = DirEnsureExists(sczParent, NULL);
+                NativeAssert::Succeeded(hr, "Failed to create directory: {0}", sczParent);
+
+                hr = FileWrite(sczPath, dwFlagsAndAttributes, rgbData, sizeof(rgbData), NULL);
+                NativeAssert::Succeeded(hr, "Failed to write file: {0}", sczPath);
+            }
+            finally
+            {
+                ReleaseStr(sczParent);
+                ReleaseStr(sczPath);
+            }
+        }
     };
+
+    static HRESULT CALLBACK DeleteTreeProgress(
+        __in DWORD cScanned,
+        __in DWORD cDirectories,
+        __in_opt LPVOID pvContext
+        )
+    {
+        DWORD* rgdwProgress = static_cast<DWORD*>(pvContext);
+
+        Assert::True(cScanned <= cDirectories);
+
+        rgdwProgress[0] = cScanned;
+        rgdwProgress[1] = cDirectories;
+
+        return S_OK;
+    }
 }
@@ -8,6 +8,24 @@ using namespace WixBuildTools::TestSupport;
 
 namespace DutilTests
 {
+    static DWORD CALLBACK FileUtilTestProgress(
+        __in LARGE_INTEGER TotalFileSize,
+        __in LARGE_INTEGER TotalBytesTransferred,
+        __in LARGE_INTEGER StreamSize,
+        __in LARGE_INTEGER StreamBytesTransferred,
+        __in DWORD dwStreamNumber,
+        __in DWORD dwCallbackReason,
+        __in HANDLE hSourceFile,
+        __in HANDLE hDestinationFile,
+        __in_opt LPVOID lpData
+        );
+
+    typedef struct _FILE_UTIL_TEST_PROGRESS
+    {
+        DWORD cCalls;
+        BOOL fCancel;
+    } FILE_UTIL_TEST_PROGRESS;
+
     public ref class FileUtil
     {
     public:
@@ -49,6 +67,98 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void FileUtilCopyAndMoveWithProgressTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczTempRoot = NULL;
+            LPWSTR sczTempDir = NULL;
+            LPWSTR sczSource = NULL;
+            LPWSTR sczCopy = NULL;
+            LPWSTR sczCanceled = NULL;
+            LPWSTR sczMoved = NULL;
+            BYTE* pbData = NULL;
+            SIZE_T cbData = 256 * 1024;
+            FILE_UTIL_TEST_PROGRESS progress = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = PathExpand(&sczTempRoot, L"%TEMP%\\FileUtilTest\\", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::Succeeded(hr, "Failed to get temp dir");
+
+                hr = PathConcat(sczTempRoot, sczGuid, &sczTempDir);
+                NativeAssert::Succeeded(hr, "Failed to combine temp dir with guid");
+
+                hr = DirEnsureExists(sczTempDir, NULL);
+                NativeAssert::Succeeded(hr, "Failed to ensure directory exists: {0}", sczTempDir);
+
+                hr = PathConcat(sczTempDir, L"source.bin", &sczSource);
+                NativeAssert::Succeeded(hr, "Failed to get source path");
+
+                hr = PathConcat(sczTempDir, L"copy\\copy.bin", &sczCopy);
+                NativeAssert::Succeeded(hr, "Failed to get copy path");
+
+                hr = PathConcat(sczTempDir, L"canceled.bin", &sczCanceled);
+                NativeAssert::Succeeded(hr, "Failed to get canceled path");
+
+                hr = PathConcat(sczTempDir, L"moved\\moved.bin", &sczMoved);
+                NativeAssert::Succeeded(hr, "Failed to get moved path");
+
+                pbData = static_cast<BYTE*>(MemAlloc(cbData, TRUE));
+                Assert::True(NULL != pbData);
+
+                hr = FileWrite(sczSource, FILE_ATTRIBUTE_NORMAL, pbData, cbData, NULL);
+                NativeAssert::Succeeded(hr, "Failed to write file: {0}", sczSource);
+
+                // The copy creates the missing directory and reports progress.
+                hr = FileEnsureCopyWithRetryAndProgress(sczSource, sczCopy, TRUE, 0, 0, FileUtilTestProgress, &progress);
+                NativeAssert::Succeeded(hr, "Failed to copy file: {0}", sczSource);
+                Assert::True(FileExistsEx(sczCopy, NULL));
+                Assert::NotEqual<DWORD>(0, progress.cCalls);
+
+                // Canceling from the progress routine is not retried.
+                progress.cCalls = 0;
+                progress.fCancel = TRUE;
+
+                hr = FileEnsureCopyWithRetryAndProgress(sczSource, sczCanceled, TRUE, 3, 10000, FileUtilTestProgress, &progress);
+                Assert::Equal(HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED), hr);
+                Assert::Equal<DWORD>(1, progress.cCalls);
+                Assert::False(FileExistsEx(sczCanceled, NULL));
+
+                // A move on one volume is a rename.
+                progress.cCalls = 0;
+                progress.fCancel = FALSE;
+
+                hr = FileEnsureMoveWithRetryAndProgress(sczCopy, sczMoved, TRUE, TRUE, 0, 0, FileUtilTestProgress, &progress);
+                NativeAssert::Succeeded(hr, "Failed to move file: {0}", sczCopy);
+                Assert::True(FileExistsEx(sczMoved, NULL));
+                Assert::False(FileExistsEx(sczCopy, NULL));
+            }
+            finally
+            {
+                if (sczTempDir)
+                {
+                    DirEnsureDelete(sczTempDir, TRUE, TRUE);
+                }
+
+                ReleaseMem(pbData);
+                ReleaseStr(sczMoved);
+                ReleaseStr(sczCanceled);
+                ReleaseStr(sczCopy);
+                ReleaseStr(sczSource);
+                ReleaseStr(sczTempDir);
+                ReleaseStr(sczTempRoot);
+                ReleaseStr(sczGuid);
+                DutilUninitialize();
+            }
+        }
+
     private:
         void TestFile(LPWSTR wzDir, LPCWSTR wzTempDir, LPWSTR wzFileName, size_t cbExpectedStringLength, FILE_ENCODING feExpectedEncoding)
         {
@@ -122,4 +232,23 @@ namespace DutilTests
             return;
         }
     };
+
+    static DWORD CALLBACK FileUtilTestProgress(
+        __in LARGE_INTEGER /*TotalFileSize*/,
+        __in LARGE_INTEGER /*TotalBytesTransferred*/,
+        __in LARGE_INTEGER /*StreamSize*/,
+        __in LARGE_INTEGER /*StreamBytesTransferred*/,
+        __in DWORD /*dwStreamNumber*/,
+        __in DWORD /*dwCallbackReason*/,
+        __in HANDLE /*hSourceFile*/,
+        __in HANDLE /*hDestinationFile*/,
+        __in_opt LPVOID lpData
+        )
+    {
+        FILE_UTIL_TEST_PROGRESS* pProgress = static_cast<FILE_UTIL_TEST_PROGRESS*>(lpData);
+
+        ++pProgress->cCalls;
+
+        return pProgress->fCancel ? PROGRESS_CANCEL : PROGRESS_CONTINUE;
+    }
 }
@@ -64,6 +64,117 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void IniUtilLargeFileTest()
+        {
+            HRESULT hr = S_OK;
+            const DWORD cSections = 100;
+            const DWORD cValuesPerSection = 100;
+            String^ iniPath = IO::Path::GetTempFileName();
+            Text::StringBuilder^ contents = gcnew Text::StringBuilder();
+            INI_HANDLE iniHandle = NULL;
+            INI_VALUE *rgValues = NULL;
+            DWORD cValues = 0;
+            FILE_ENCODING feEncoding = FILE_ENCODING_UNSPECIFIED;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                contents->Append("; Generated by IniUtilLargeFileTest\r\n");
+
+                for (DWORD i = 0; i < cSections; ++i)
+                {
+                    contents->AppendFormat("[Section{0}]\r\n", i);
+
+                    for (DWORD j = 0; j < cValuesPerSection; ++j)
+                    {
+                        contents->AppendFormat("Value{0} = Data{0}.{1}\r\n", j, i);
+                    }
+                }
+
+                // UTF-16 with a BOM, about 500 KB on disk.
+                IO::File::WriteAllText(iniPath, contents->ToString(), Text::Encoding::Unicode);
+
+                pin_ptr<const wchar_t> wzIniPath = PtrToStringChars(iniPath);
+
+                hr = IniInitialize(&iniHandle);
+                NativeAssert::Succeeded(hr, "Failed to initialize INI object");
+
+                hr = StandardIniFormat(iniHandle);
+                NativeAssert::Succeeded(hr, "Failed to set parameters for INI file");
+
+                hr = IniParse(iniHandle, wzIniPath, &feEncoding);
+                NativeAssert::Succeeded(hr, "Failed to parse INI file");
+
+                Assert::Equal<DWORD>(FILE_ENCODING_UTF16_WITH_BOM, feEncoding);
+
+                hr = IniGetValueList(iniHandle, &rgValues, &cValues);
+                NativeAssert::Succeeded(hr, "Failed to get list of values in INI");
+
+                Assert::Equal<DWORD>(cSections * cValuesPerSection, cValues);
+
+                AssertValue(iniHandle, L"Section0\\Value0", L"Data0.0");
+                AssertValue(iniHandle, L"Section50\\Value42", L"Data42.50");
+                AssertValue(iniHandle, L"Section99\\Value99", L"Data99.99");
+                AssertNoValue(iniHandle, L"Section100\\Value0");
+
+                hr = IniSetValue(iniHandle, L"Section50\\Value42", L"Changed");
+                NativeAssert::Succeeded(hr, "Failed to set value in INI");
+
+                hr = IniSetValue(iniHandle, L"Section99\\Value0", NULL);
+                NativeAssert::Succeeded(hr, "Failed to kill value in INI");
+
+                hr = IniSetValue(iniHandle, L"Section0\\Added", L"New");
+                NativeAssert::Succeeded(hr, "Failed to set value in INI");
+
+                hr = IniSetValue(iniHandle, L"TopLevel", L"Top");
+                NativeAssert::Succeeded(hr, "Failed to set value in INI");
+
+                hr = IniSetValue(iniHandle, L"NewSection\\Value", L"Fresh");
+                NativeAssert::Succeeded(hr, "Failed to set value in INI");
+
+                hr = IniWriteFile(iniHandle, NULL, FILE_ENCODING_UNSPECIFIED);
+                NativeAssert::Succeeded(hr, "Failed to write ini file back out to disk");
+
+                // Parsing again with the same handle reads the rewritten file from scratch.
+                hr = IniParse(iniHandle, wzIniPath, NULL);
+                NativeAssert::Succeeded(hr, "Failed to parse INI file again");
+
+                hr = IniGetValueList(iniHandle, &rgValues, &cValues);
+                NativeAssert::Succeeded(hr, "Failed to get list of values in INI");
+
+                Assert::Equal<DWORD>(cSections * cValuesPerSection + 2, cValues);
+
+                AssertValue(iniHandle, L"Section0\\Value0", L"Data0.0");
+                AssertValue(iniHandle, L"Section50\\Value42", L"Changed");
+                AssertValue(iniHandle, L"Section50\\Value43", L"Data43.50");
+                AssertNoValue(iniHandle, L"Section99\\Value0");
+                AssertValue(iniHandle, L"Section99\\Value99", L"Data99.99");
+                AssertValue(iniHandle, L"Section0\\Added", L"New");
+                AssertValue(iniHandle, L"TopLevel", L"Top");
+                AssertValue(iniHandle, L"NewSection\\Value", L"Fresh");
+
+                // New values are written where their section already is, not appended to the end of the file.
+                NativeAssert::StringEqual(L"TopLevel", rgValues[0].wzName);
+                Assert::Equal<DWORD>(2, rgValues[0].dwLineNumber);
+                NativeAssert::StringEqual(L"Section0\\Added", rgValues[cValuesPerSection + 1].wzName);
+
+                // Untouched lines keep their original formatting and edits only replace the value text.
+                String^ written = IO::File::ReadAllText(iniPath);
+                Assert::True(written->StartsWith("; Generated by IniUtilLargeFileTest\r\nTopLevel=Top\r\n[Section0]\r\n"));
+                Assert::True(written->Contains("Value41 = Data41.50\r\nValue42 = Changed\r\nValue43 = Data43.50\r\n"));
+                Assert::True(written->Contains("[Section99]\r\nValue1 = Data1.99\r\n"));
+                Assert::True(written->EndsWith("Value99 = Data99.99\r\n[NewSection]\r\nValue=Fresh\r\n"));
+            }
+            finally
+            {
+                ReleaseIni(iniHandle);
+                IO::File::Delete(iniPath);
+                DutilUninitialize();
+            }
+        }
+
     private:
         void AssertValue(INI_HANDLE iniHandle, LPCWSTR wzValueName, LPCWSTR wzValue)
         {
@@ -0,0 +1,353 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class JsonUtil
+    {
+    public:
+        [Fact]
+        void JsonWriterEscapesStrings()
+        {
+            HRESULT hr = S_OK;
+            JSON_WRITER writer = { };
+
+            JsonInitializeWriter(&writer);
+
+            try
+            {
+                hr = JsonWriteObjectStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start object.");
+
+                hr = JsonWriteObjectKey(&writer, L"plain");
+                NativeAssert::Succeeded(hr, "Failed to write key.");
+
+                hr = JsonWriteString(&writer, L"no escapes here");
+                NativeAssert::Succeeded(hr, "Failed to write plain string.");
+
+                hr = JsonWriteObjectKey(&writer, L"esc\"aped");
+                NativeAssert::Succeeded(hr, "Failed to write escaped key.");
+
+                hr = JsonWriteString(&writer, L"a\"b\\c/d\r\n\t\x0001");
+                NativeAssert::Succeeded(hr, "Failed to write escaped string.");
+
+                hr = JsonWriteObjectKey(&writer, L"list");
+                NativeAssert::Succeeded(hr, "Failed to write list key.");
+
+                hr = JsonWriteArrayStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start array.");
+
+                hr = JsonWriteNumber(&writer, 42);
+                NativeAssert::Succeeded(hr, "Failed to write number.");
+
+                hr = JsonWriteBool(&writer, TRUE);
+                NativeAssert::Succeeded(hr, "Failed to write bool.");
+
+                hr = JsonWriteNull(&writer);
+                NativeAssert::Succeeded(hr, "Failed to write null.");
+
+                hr = JsonWriteObjectStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start nested object.");
+
+                hr = JsonWriteObjectEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end nested object.");
+
+                hr = JsonWriteArrayEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end array.");
+
+                hr = JsonWriteObjectEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end object.");
+
+                NativeAssert::StringEqual(L"{\"plain\":\"no escapes here\",\"esc\\\"aped\":\"a\\\"b\\\\c\\/d\\r\\n\\t\\u0001\",\"list\":[42,true,null,{}]}", writer.sczJson);
+                Assert::Equal<DWORD>(lstrlenW(writer.sczJson), writer.cchJson);
+            }
+            finally
+            {
+                JsonUninitializeWriter(&writer);
+            }
+        }
+
+        [Fact]
+        void JsonReaderReturnsTokensAndSpans()
+        {
+            HRESULT hr = S_OK;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            LPWSTR sczValue = NULL;
+            LPCWSTR wzJson = L" { \"name\" : \"a\\\"b\\u0041\", \"count\": -12.5e3, \"items\": [true, false, null, [] , {}] } ";
+
+            JsonInitializeReaderFromBuffer(wzJson, lstrlenW(wzJson), &reader);
+
+            try
+            {
+                ReadToken(&reader, JSON_TOKEN_OBJECT_START, &value);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_STRING, value.type);
+                Assert::True(value.wzValue > wzJson && value.wzValue < wzJson + lstrlenW(wzJson));
+                Assert::Equal<DWORD>(4, value.cchValue);
+                Assert::False(value.fEscaped);
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_STRING, value.type);
+                Assert::True(value.fEscaped);
+
+                hr = JsonUnescapeString(&value, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to unescape string.");
+                NativeAssert::StringEqual(L"a\"bA", sczValue);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_NUMBER, value.type);
+                Assert::Equal<DWORD>(7, value.cchValue);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_START, &value);
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_TRUE, value.type);
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_FALSE, value.type);
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<DWORD>(JSON_VALUE_TYPE_NULL, value.type);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_START, &value);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_END, &value);
+                ReadToken(&reader, JSON_TOKEN_OBJECT_START, &value);
+                ReadToken(&reader, JSON_TOKEN_OBJECT_END, &value);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_END, &value);
+                ReadToken(&reader, JSON_TOKEN_OBJECT_END, &value);
+
+                hr = JsonReadNext(&reader, &token, &value);
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                JsonUninitializeReader(&reader);
+            }
+        }
+
+        [Fact]
+        void JsonReaderRejectsMalformedJson()
+        {
+            HRESULT hr = S_OK;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+
+            hr = JsonInitializeReader(L"{\"a\" 1}", &reader);
+            NativeAssert::Succeeded(hr, "Failed to initialize reader.");
+
+            try
+            {
+                ReadToken(&reader, JSON_TOKEN_OBJECT_START, &value);
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+
+                hr = JsonReadNext(&reader, &token, &value);
+                NativeAssert::ValidReturnCode(hr, E_INVALIDDATA);
+            }
+            finally
+            {
+                JsonUninitializeReader(&reader);
+            }
+        }
+
+        [Fact]
+        void JsonReaderRejectsTrailingCommas()
+        {
+            VerifyMalformed(L"[1,]");
+            VerifyMalformed(L"[1, ]");
+            VerifyMalformed(L"{\"a\":1,}");
+            VerifyMalformed(L"{\"a\":1 , }");
+            VerifyMalformed(L"[,1]");
+            VerifyMalformed(L"[1,,2]");
+            VerifyMalformed(L"[1,");
+
+            VerifyWellFormed(L"[1, 2]");
+            VerifyWellFormed(L"{\"a\":[],\"b\":{}}");
+        }
+
+        [Fact]
+        void JsonReaderValidatesNumbers()
+        {
+            VerifyMalformed(L"-");
+            VerifyMalformed(L"[-]");
+            VerifyMalformed(L"01");
+            VerifyMalformed(L"1.");
+            VerifyMalformed(L"1.e5");
+            VerifyMalformed(L"1e");
+            VerifyMalformed(L"1e+");
+            VerifyMalformed(L"1-2");
+            VerifyMalformed(L"--1");
+            VerifyMalformed(L"[1.2.3]");
+
+            VerifyWellFormed(L"0");
+            VerifyWellFormed(L"-0");
+            VerifyWellFormed(L"[10, -3.25, 1e5, 2E-3, 4.5e+10]");
+        }
+
+        [Fact]
+        void JsonReaderAndWriterHandleDeepNesting()
+        {
+            HRESULT hr = S_OK;
+            const DWORD cDepth = 100;
+            JSON_WRITER writer = { };
+
+            JsonInitializeWriter(&writer);
+
+            try
+            {
+                for (DWORD i = 0; i < cDepth; ++i)
+                {
+                    hr = JsonWriteArrayStart(&writer);
+                    NativeAssert::Succeeded(hr, "Failed to start array.");
+                }
+
+                for (DWORD i = 0; i < cDepth; ++i)
+                {
+                    hr = JsonWriteArrayEnd(&writer);
+                    NativeAssert::Succeeded(hr, "Failed to end array.");
+                }
+
+                Assert::Equal<DWORD>(cDepth * 2, writer.cchJson);
+
+                VerifyWellFormed(writer.sczJson);
+            }
+            finally
+            {
+                JsonUninitializeWriter(&writer);
+            }
+        }
+
+        [Fact]
+        void JsonRoundTrip100kObjects()
+        {
+            HRESULT hr = S_OK;
+            const DWORD cObjects = 100000;
+            JSON_WRITER writer = { };
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            DWORD cObjectsRead = 0;
+            DWORD cValuesRead = 0;
+
+            JsonInitializeWriter(&writer);
+
+            try
+            {
+                hr = JsonWriteArrayStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start array.");
+
+                for (DWORD i = 0; i < cObjects; ++i)
+                {
+                    hr = JsonWriteObjectStart(&writer);
+                    NativeAssert::Succeeded(hr, "Failed to start object.");
+
+                    hr = JsonWriteObjectKey(&writer, L"package");
+                    NativeAssert::Succeeded(hr, "Failed to write key.");
+
+                    hr = JsonWriteString(&writer, L"C:\\ProgramData\\Package Cache\\{5F3A4C2B}\\setup.msi");
+                    NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                    hr = JsonWriteObjectKey(&writer, L"progress");
+                    NativeAssert::Succeeded(hr, "Failed to write key.");
+
+                    hr = JsonWriteNumber(&writer, i % 101);
+                    NativeAssert::Succeeded(hr, "Failed to write number.");
+
+                    hr = JsonWriteObjectKey(&writer, L"complete");
+                    NativeAssert::Succeeded(hr, "Failed to write key.");
+
+                    hr = JsonWriteBool(&writer, 100 == i % 101);
+                    NativeAssert::Succeeded(hr, "Failed to write bool.");
+
+                    hr = JsonWriteObjectEnd(&writer);
+                    NativeAssert::Succeeded(hr, "Failed to end object.");
+                }
+
+                hr = JsonWriteArrayEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end array.");
+
+                JsonInitializeReaderFromBuffer(writer.sczJson, writer.cchJson, &reader);
+
+                for (;;)
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                    if (E_NOMOREITEMS == hr)
+                    {
+                        break;
+                    }
+                    NativeAssert::Succeeded(hr, "Failed to read token.");
+
+                    if (JSON_TOKEN_OBJECT_START == token)
+                    {
+                        ++cObjectsRead;
+                    }
+                    else if (JSON_TOKEN_VALUE == token)
+                    {
+                        ++cValuesRead;
+                    }
+                }
+
+                Assert::Equal(cObjects, cObjectsRead);
+                Assert::Equal(cObjects * 3, cValuesRead);
+            }
+            finally
+            {
+                JsonUninitializeReader(&reader);
+                JsonUninitializeWriter(&writer);
+            }
+        }
+
+    private:
+        void VerifyMalformed(LPCWSTR wzJson)
+        {
+            Assert::Equal(E_INVALIDDATA, ReadAll(wzJson));
+        }
+
+        void VerifyWellFormed(LPCWSTR wzJson)
+        {
+            Assert::Equal(E_NOMOREITEMS, ReadAll(wzJson));
+        }
+
+        HRESULT ReadAll(LPCWSTR wzJson)
+        {
+            HRESULT hr = S_OK;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+
+            JsonInitializeReaderFromBuffer(wzJson, lstrlenW(wzJson), &reader);
+
+            try
+            {
+                do
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                } while (SUCCEEDED(hr));
+            }
+            finally
+            {
+                JsonUninitializeReader(&reader);
+            }
+
+            return hr;
+        }
+
+        void ReadToken(JSON_READER* pReader, JSON_TOKEN expectedToken, JSON_VALUE* pValue)
+        {
+            HRESULT hr = S_OK;
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+
+            hr = JsonReadNext(pReader, &token, pValue);
+            NativeAssert::Succeeded(hr, "Failed to read next JSON token.");
+
+            Assert::Equal<DWORD>(expectedToken, token);
+        }
+    };
+}
@@ -0,0 +1,68 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class ProcUtil
+    {
+    public:
+        [Fact]
+        void ProcSnapshotFindsCurrentProcessTest()
+        {
+            HRESULT hr = S_OK;
+            PROC_SNAPSHOT_HANDLE hSnapshot = NULL;
+            LPWSTR sczPath = NULL;
+            LPWSTR sczExeName = NULL;
+            const DWORD* rgdwProcessIds = NULL;
+            DWORD cProcessIds = 0;
+            BOOL fFound = FALSE;
+
+            try
+            {
+                hr = PathForCurrentProcess(&sczPath, NULL);
+                NativeAssert::Succeeded(hr, "Failed to get current process path.");
+
+                hr = StrAllocString(&sczExeName, PathFile(sczPath), 0);
+                NativeAssert::Succeeded(hr, "Failed to copy current process name.");
+
+                hr = ProcSnapshotCreate(&hSnapshot);
+                NativeAssert::Succeeded(hr, "Failed to create process snapshot.");
+
+                Assert::True(0 < ProcSnapshotGetProcessCount(hSnapshot));
+
+                // Executable names are matched regardless of case.
+                ::CharUpperW(sczExeName);
+
+                hr = ProcSnapshotFindIds(hSnapshot, sczExeName, &rgdwProcessIds, &cProcessIds);
+                NativeAssert::Succeeded(hr, "Failed to find current process in snapshot.");
+
+                for (DWORD i = 0; i < cProcessIds; ++i)
+                {
+                    if (::GetCurrentProcessId() == rgdwProcessIds[i])
+                    {
+                        fFound = TRUE;
+                    }
+                }
+
+                Assert::True(fFound);
+
+                hr = ProcSnapshotFindIds(hSnapshot, L"ProcUtilTest-not-running.exe", &rgdwProcessIds, &cProcessIds);
+                NativeAssert::Succeeded(hr, "Failed to look up missing process in snapshot.");
+
+                Assert::True(NULL == rgdwProcessIds);
+                Assert::Equal<DWORD>(0, cProcessIds);
+            }
+            finally
+            {
+                ReleaseProcSnapshot(hSnapshot);
+                ReleaseStr(sczExeName);
+                ReleaseStr(sczPath);
+            }
+        }
+    };
+}
@@ -80,6 +80,85 @@ namespace DutilTests
             TestStrAnsiAllocString(b, 0, "abCd");
         }
 
+        [Fact]
+        void StrUtilCodecTest()
+        {
+            HRESULT hr = S_OK;
+            BYTE rgbSource[300];
+            BYTE rgbDecoded[300];
+            WCHAR wzScalarHex[2 * countof(rgbSource) + 1];
+            WCHAR wzHex[2 * countof(rgbSource) + 1];
+            LPWSTR sczScalarBase85 = NULL;
+            LPWSTR sczBase85 = NULL;
+            BYTE* pbDecoded = NULL;
+            SIZE_T cbDecoded = 0;
+            DWORD dwSeed = 0x5EED;
+            STR_CODEC_ISA isaPrevious = StrCodecSetMaximumIsa(STR_CODEC_ISA_AVX2);
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                for (DWORD i = 0; i < countof(rgbSource); ++i)
+                {
+                    dwSeed = dwSeed * 1103515245 + 12345;
+                    rgbSource[i] = static_cast<BYTE>(dwSeed >> 16);
+                }
+
+                // every length crosses each block size with every possible tail
+                for (SIZE_T cb = 0; cb <= countof(rgbSource); ++cb)
+                {
+                    StrCodecSetMaximumIsa(STR_CODEC_ISA_SCALAR);
+
+                    hr = StrHexEncode(rgbSource, cb, wzScalarHex, countof(wzScalarHex));
+                    NativeAssert::Succeeded(hr, "Failed to hex encode with the scalar codec.");
+
+                    ReleaseNullStr(sczScalarBase85);
+                    hr = StrAllocBase85Encode(rgbSource, cb, &sczScalarBase85);
+                    NativeAssert::Succeeded(hr, "Failed to base85 encode with the scalar codec.");
+
+                    for (STR_CODEC_ISA isa = STR_CODEC_ISA_SSE2; isa <= STR_CODEC_ISA_AVX2; isa = static_cast<STR_CODEC_ISA>(isa + 1))
+                    {
+                        StrCodecSetMaximumIsa(isa);
+
+                        hr = StrHexEncode(rgbSource, cb, wzHex, countof(wzHex));
+                        NativeAssert::Succeeded(hr, "Failed to hex encode.");
+                        NativeAssert::StringEqual(wzScalarHex, wzHex);
+
+                        _wcslwr_s(wzHex, countof(wzHex));
+                        hr = StrHexDecode(wzHex, rgbDecoded, countof(rgbDecoded));
+                        NativeAssert::Succeeded(hr, "Failed to hex decode lowercase string: {0}", wzHex);
+                        Assert::Equal(0, memcmp(rgbSource, rgbDecoded, cb));
+
+                        ReleaseNullStr(sczBase85);
+                        hr = StrAllocBase85Encode(rgbSource, cb, &sczBase85);
+                        NativeAssert::Succeeded(hr, "Failed to base85 encode.");
+                        NativeAssert::StringEqual(sczScalarBase85, sczBase85);
+
+                        ReleaseNullMem(pbDecoded);
+                        hr = StrAllocBase85Decode(sczBase85, &pbDecoded, &cbDecoded);
+                        NativeAssert::Succeeded(hr, "Failed to base85 decode string: {0}", sczBase85);
+                        Assert::Equal<DWORD>(static_cast<DWORD>(cb), static_cast<DWORD>(cbDecoded));
+                        Assert::Equal(0, memcmp(rgbSource, pbDecoded, cb));
+                    }
+                }
+
+                // an illegal symbol inside a vectorized block is still rejected
+                sczBase85[3] = L'"';
+                ReleaseNullMem(pbDecoded);
+                hr = StrAllocBase85Decode(sczBase85, &pbDecoded, &cbDecoded);
+                NativeAssert::ValidReturnCode(hr, E_UNEXPECTED);
+            }
+            finally
+            {
+                StrCodecSetMaximumIsa(isaPrevious);
+                ReleaseMem(pbDecoded);
+                ReleaseStr(sczBase85);
+                ReleaseStr(sczScalarBase85);
+                DutilUninitialize();
+            }
+        }
+
     private:
         void TestTrim(LPCWSTR wzInput, LPCWSTR wzExpectedResult)
         {
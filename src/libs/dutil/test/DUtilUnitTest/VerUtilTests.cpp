@@ -913,6 +913,274 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void VerPoolComparesLikeParsedVersions()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_POOL pool = { };
+            VERUTIL_VERSION* rgpVersions[10] = { };
+            LPCWSTR rgwzVersions[] =
+            {
+                L"1.2.3.4",
+                L"v1.2.3",
+                L"1.0-2.0",
+                L"1.0-19",
+                L"1.0-a.b.c.d.e.f.g.h.i.j+meta",
+                L"1.0-a.b.c.d.e.f.g.h.i.k",
+                L"1.2-beta",
+                L"1.2.3.4.5",
+                L"1.2-Beta+abc",
+                L"",
+            };
+            DWORD dwIndex = 0;
+            int nPoolResult = 0;
+            int nParsedResult = 0;
+            int nStringResult = 0;
+
+            try
+            {
+                for (DWORD i = 0; i < countof(rgwzVersions); ++i)
+                {
+                    hr = VerParseVersion(rgwzVersions[i], 0, FALSE, rgpVersions + i);
+                    NativeAssert::Succeeded(hr, "Failed to parse version '{0}'", rgwzVersions[i]);
+
+                    hr = VerPoolAddVersion(&pool, rgwzVersions[i], 0, FALSE, &dwIndex);
+                    NativeAssert::Succeeded(hr, "Failed to add version '{0}' to the pool", rgwzVersions[i]);
+                    Assert::Equal<DWORD>(i, dwIndex);
+                }
+
+                for (DWORD i = 0; i < countof(rgwzVersions); ++i)
+                {
+                    LPCWSTR wzPoolVersion = NULL;
+
+                    hr = VerPoolGetVersionString(&pool, i, &wzPoolVersion);
+                    NativeAssert::Succeeded(hr, "Failed to get pooled version string");
+                    NativeAssert::StringEqual(rgpVersions[i]->sczVersion, wzPoolVersion);
+
+                    for (DWORD j = 0; j < countof(rgwzVersions); ++j)
+                    {
+                        hr = VerPoolCompareVersions(&pool, i, j, &nPoolResult);
+                        NativeAssert::Succeeded(hr, "Failed to compare pooled versions '{0}' and '{1}'", rgwzVersions[i], rgwzVersions[j]);
+
+                        hr = VerCompareParsedVersions(rgpVersions[i], rgpVersions[j], &nParsedResult);
+                        NativeAssert::Succeeded(hr, "Failed to compare versions '{0}' and '{1}'", rgwzVersions[i], rgwzVersions[j]);
+
+                        hr = VerCompareStringVersions(rgwzVersions[i], rgwzVersions[j], FALSE, &nStringResult);
+                        NativeAssert::Succeeded(hr, "Failed to compare version strings '{0}' and '{1}'", rgwzVersions[i], rgwzVersions[j]);
+
+                        Assert::Equal(nParsedResult, nPoolResult);
+                        Assert::Equal(nParsedResult, nStringResult);
+                    }
+                }
+            }
+            finally
+            {
+                for (DWORD i = 0; i < countof(rgpVersions); ++i)
+                {
+                    ReleaseVerutilVersion(rgpVersions[i]);
+                }
+
+                ReleaseVerutilVersionPool(pool);
+            }
+        }
+
+        [Fact]
+        void VerPoolAddVersionRejectsInvalidWhenStrict()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_POOL pool = { };
+            DWORD dwIndex = 0;
+
+            try
+            {
+                hr = VerPoolAddVersion(&pool, L"1.2.3", 0, TRUE, &dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to add version to the pool");
+
+                hr = VerPoolAddVersion(&pool, L"1.2.3-", 0, TRUE, &dwIndex);
+                NativeAssert::ValidReturnCode(hr, E_INVALIDARG);
+
+                Assert::Equal<DWORD>(1, pool.cVersions);
+                Assert::Equal<DWORD>(0, pool.cReleaseLabels);
+                Assert::Equal<DWORD>(6, pool.cchStrings);
+            }
+            finally
+            {
+                ReleaseVerutilVersionPool(pool);
+            }
+        }
+
+        [Fact]
+        void VerPoolAddVersionCopiesStringsFromThePool()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_POOL pool = { };
+            DWORD dwIndex = 0;
+            LPCWSTR wzPoolVersion = NULL;
+            int nResult = 0;
+            const DWORD cCopies = 2000;
+
+            try
+            {
+                hr = VerPoolAddVersion(&pool, L"1.2.3-beta.4+build", 0, FALSE, &dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to add version to the pool");
+
+                // Each copy comes from the pool's own storage, and enough of them force the storage to move.
+                for (DWORD i = 0; i < cCopies; ++i)
+                {
+                    hr = VerPoolGetVersionString(&pool, i, &wzPoolVersion);
+                    NativeAssert::Succeeded(hr, "Failed to get pooled version string");
+
+                    hr = VerPoolAddVersion(&pool, wzPoolVersion, 0, FALSE, &dwIndex);
+                    NativeAssert::Succeeded(hr, "Failed to add pooled version to the pool");
+                    Assert::Equal<DWORD>(i + 1, dwIndex);
+                }
+
+                for (DWORD i = 0; i <= cCopies; ++i)
+                {
+                    hr = VerPoolGetVersionString(&pool, i, &wzPoolVersion);
+                    NativeAssert::Succeeded(hr, "Failed to get pooled version string");
+                    NativeAssert::StringEqual(L"1.2.3-beta.4+build", wzPoolVersion);
+
+                    hr = VerPoolCompareVersions(&pool, 0, i, &nResult);
+                    NativeAssert::Succeeded(hr, "Failed to compare pooled versions");
+                    Assert::Equal<int>(0, nResult);
+                }
+            }
+            finally
+            {
+                ReleaseVerutilVersionPool(pool);
+            }
+        }
+
+        [Fact]
+        void VerSortVersionsSortsAscending()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_POOL pool = { };
+            VERUTIL_VERSION* rgpVersions[5] = { };
+            DWORD rgdwIndices[5] = { };
+            LPCWSTR rgwzVersions[] = { L"2.0", L"1.0-beta", L"1.0", L"1.0-alpha", L"0.9.9" };
+            LPCWSTR rgwzExpected[] = { L"0.9.9", L"1.0-alpha", L"1.0-beta", L"1.0", L"2.0" };
+            LPCWSTR wzPoolVersion = NULL;
+
+            try
+            {
+                for (DWORD i = 0; i < countof(rgwzVersions); ++i)
+                {
+                    hr = VerParseVersion(rgwzVersions[i], 0, FALSE, rgpVersions + i);
+                    NativeAssert::Succeeded(hr, "Failed to parse version '{0}'", rgwzVersions[i]);
+
+                    hr = VerPoolAddVersion(&pool, rgwzVersions[i], 0, FALSE, rgdwIndices + i);
+                    NativeAssert::Succeeded(hr, "Failed to add version '{0}' to the pool", rgwzVersions[i]);
+                }
+
+                hr = VerSortVersions(rgpVersions, countof(rgpVersions));
+                NativeAssert::Succeeded(hr, "Failed to sort versions");
+
+                hr = VerPoolSortVersions(&pool, rgdwIndices, countof(rgdwIndices));
+                NativeAssert::Succeeded(hr, "Failed to sort pooled versions");
+
+                for (DWORD i = 0; i < countof(rgwzExpected); ++i)
+                {
+                    NativeAssert::StringEqual(rgwzExpected[i], rgpVersions[i]->sczVersion);
+
+                    hr = VerPoolGetVersionString(&pool, rgdwIndices[i], &wzPoolVersion);
+                    NativeAssert::Succeeded(hr, "Failed to get pooled version string");
+                    NativeAssert::StringEqual(rgwzExpected[i], wzPoolVersion);
+                }
+            }
+            finally
+            {
+                for (DWORD i = 0; i < countof(rgpVersions); ++i)
+                {
+                    ReleaseVerutilVersion(rgpVersions[i]);
+                }
+
+                ReleaseVerutilVersionPool(pool);
+            }
+        }
+
+        [Fact]
+        void VerPoolComparesLikeStringVersions()
+        {
+            HRESULT hr = S_OK;
+            const DWORD cVersions = 10000;
+            VERUTIL_VERSION_POOL pool = { };
+            VERUTIL_VERSION** rgpVersions = NULL;
+            DWORD* rgdwIndices = NULL;
+            LPWSTR* rgsczVersions = NULL;
+            int nResult = 0;
+            int nPoolResult = 0;
+
+            try
+            {
+                rgpVersions = static_cast<VERUTIL_VERSION**>(MemAlloc(cVersions * sizeof(VERUTIL_VERSION*), TRUE));
+                rgdwIndices = static_cast<DWORD*>(MemAlloc(cVersions * sizeof(DWORD), TRUE));
+                rgsczVersions = static_cast<LPWSTR*>(MemAlloc(cVersions * sizeof(LPWSTR), TRUE));
+                Assert::True(rgpVersions && rgdwIndices && rgsczVersions);
+
+                for (DWORD i = 0; i < cVersions; ++i)
+                {
+                    DWORD dwSeed = (i * 2654435761) >> 7;
+
+                    hr = StrAllocFormatted(rgsczVersions + i, L"%u.%u.%u-rc.%u+build%u", dwSeed % 7, dwSeed % 13, dwSeed % 101, i % 5, i);
+                    NativeAssert::Succeeded(hr, "Failed to format version");
+
+                    hr = VerParseVersion(rgsczVersions[i], 0, FALSE, rgpVersions + i);
+                    NativeAssert::Succeeded(hr, "Failed to parse version '{0}'", rgsczVersions[i]);
+
+                    hr = VerPoolAddVersion(&pool, rgsczVersions[i], 0, FALSE, rgdwIndices + i);
+                    NativeAssert::Succeeded(hr, "Failed to add version '{0}' to the pool", rgsczVersions[i]);
+                }
+
+                for (DWORD i = 1; i < cVersions; ++i)
+                {
+                    hr = VerCompareStringVersions(rgsczVersions[i - 1], rgsczVersions[i], FALSE, &nResult);
+                    NativeAssert::Succeeded(hr, "Failed to compare version strings");
+
+                    hr = VerPoolCompareVersions(&pool, i - 1, i, &nPoolResult);
+                    NativeAssert::Succeeded(hr, "Failed to compare pooled versions");
+
+                    Assert::Equal(nResult < 0 ? -1 : nResult > 0 ? 1 : 0, nPoolResult < 0 ? -1 : nPoolResult > 0 ? 1 : 0);
+                }
+
+                hr = VerPoolSortVersions(&pool, rgdwIndices, cVersions);
+                NativeAssert::Succeeded(hr, "Failed to sort pooled versions");
+
+                hr = VerSortVersions(rgpVersions, cVersions);
+                NativeAssert::Succeeded(hr, "Failed to sort versions");
+
+                for (DWORD i = 0; i < cVersions; ++i)
+                {
+                    LPCWSTR wzPoolVersion = NULL;
+
+                    hr = VerPoolGetVersionString(&pool, rgdwIndices[i], &wzPoolVersion);
+                    NativeAssert::Succeeded(hr, "Failed to get pooled version string");
+
+                    hr = VerCompareStringVersions(rgpVersions[i]->sczVersion, wzPoolVersion, FALSE, &nResult);
+                    NativeAssert::Succeeded(hr, "Failed to compare sorted versions");
+                    Assert::Equal(0, nResult);
+                }
+            }
+            finally
+            {
+                for (DWORD i = 0; rgpVersions && i < cVersions; ++i)
+                {
+                    ReleaseVerutilVersion(rgpVersions[i]);
+                }
+
+                for (DWORD i = 0; rgsczVersions && i < cVersions; ++i)
+                {
+                    ReleaseStr(rgsczVersions[i]);
+                }
+
+                ReleaseMem(rgpVersions);
+                ReleaseMem(rgdwIndices);
+                ReleaseMem(rgsczVersions);
+                ReleaseVerutilVersionPool(pool);
+            }
+        }
+
     private:
         void TestVerutilCompareParsedVersions(VERUTIL_VERSION* pVersion1, VERUTIL_VERSION* pVersion2, int nExpectedResult)
         {
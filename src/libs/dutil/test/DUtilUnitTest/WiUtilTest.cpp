@@ -0,0 +1,291 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+typedef struct _WIUTIL_TEST_HANDLER
+{
+    BOOL fCancelProgress;
+    DWORD cProgress;
+    DWORD dwLastPercentage;
+    DWORD cActionData;
+    WCHAR wzLastActionData[MAX_PATH];
+} WIUTIL_TEST_HANDLER;
+
+static INSTALLUI_HANDLER_RECORD vpfnExternalUIRecord = NULL;
+static LPVOID vpvExternalUIContext = NULL;
+
+static INSTALLUILEVEL WINAPI WiuTest_MsiSetInternalUI(
+    __in INSTALLUILEVEL dwUILevel,
+    __inout_opt HWND* phWnd
+    );
+static UINT WINAPI WiuTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD dwMessageFilter,
+    __in_opt LPVOID pvContext,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    );
+static int TestExecuteMessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    );
+static INT SendProgressRecord(
+    __in MSIHANDLE hRecord,
+    __in int iType,
+    __in int iValue
+    );
+
+namespace DutilTests
+{
+    public ref class WiUtil
+    {
+    public:
+        [Fact]
+        void WiuExternalUICoalescesProgressTest()
+        {
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIUTIL_TEST_HANDLER handler = { };
+            MSIHANDLE hRecord = NULL;
+            const DWORD cTicks = 1050;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hRecord = InitializeExternalUI(&context, &handler);
+
+                // The script is 1000 ticks plus the 50 wiutil adds to the first phase, so all the ticks finish the 15% phase.
+                SendProgressRecord(hRecord, 0, 1000);
+                Assert::Equal<DWORD>(1, handler.cProgress);
+                Assert::Equal<DWORD>(0, handler.dwLastPercentage);
+
+                for (DWORD i = 0; i < cTicks; ++i)
+                {
+                    Assert::Equal(IDOK, SendProgressRecord(hRecord, 2, 1));
+                }
+
+                WiuFlushExternalUI(&context);
+
+                Assert::Equal<DWORD>(15, handler.dwLastPercentage);
+                Assert::True(handler.cProgress < cTicks + 1, String::Format("Delivered {0} progress messages for {1} ticks.", handler.cProgress, cTicks + 1));
+                Assert::Equal<DWORD>(cTicks + 1, handler.cProgress + context.cCoalescedProgress);
+            }
+            finally
+            {
+                UninitializeExternalUI(&context, hRecord);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void WiuExternalUIDeliversLatestActionDataTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIUTIL_TEST_HANDLER handler = { };
+            MSIHANDLE hRecord = NULL;
+            MSIHANDLE hActionData = NULL;
+            WCHAR wzActionData[32] = { };
+            const DWORD cActionData = 200;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hRecord = InitializeExternalUI(&context, &handler);
+
+                hActionData = ::MsiCreateRecord(1);
+                Assert::NotEqual<MSIHANDLE>(NULL, hActionData);
+
+                for (DWORD i = 0; i < cActionData; ++i)
+                {
+                    hr = ::StringCchPrintfW(wzActionData, countof(wzActionData), L"File%u", i);
+                    NativeAssert::Succeeded(hr, "Failed to format action data.");
+
+                    ::MsiRecordSetStringW(hActionData, 1, wzActionData);
+
+                    Assert::Equal(IDOK, vpfnExternalUIRecord(vpvExternalUIContext, INSTALLMESSAGE_ACTIONDATA, hActionData));
+                }
+
+                WiuFlushExternalUI(&context);
+
+                NativeAssert::StringEqual(L"File199", handler.wzLastActionData);
+                Assert::True(handler.cActionData < cActionData, String::Format("Delivered {0} action data messages for {1} sent.", handler.cActionData, cActionData));
+                Assert::Equal<DWORD>(cActionData, handler.cActionData + context.cCoalescedActionData);
+            }
+            finally
+            {
+                if (hActionData)
+                {
+                    ::MsiCloseHandle(hActionData);
+                }
+
+                UninitializeExternalUI(&context, hRecord);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void WiuExternalUIReturnsCancelFromHeldProgressTest()
+        {
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIUTIL_TEST_HANDLER handler = { };
+            MSIHANDLE hRecord = NULL;
+            MSIHANDLE hActionStart = NULL;
+            INT nResult = IDNOACTION;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hRecord = InitializeExternalUI(&context, &handler);
+
+                Assert::Equal(IDOK, SendProgressRecord(hRecord, 0, 1000));
+
+                // The next tick is held unless the relay interval already elapsed, so the cancel
+                // must come back either from the tick itself or from the message that flushes it.
+                handler.fCancelProgress = TRUE;
+
+                nResult = SendProgressRecord(hRecord, 2, 1);
+                if (IDCANCEL != nResult)
+                {
+                    Assert::Equal(IDOK, nResult);
+
+                    hActionStart = ::MsiCreateRecord(3);
+                    Assert::NotEqual<MSIHANDLE>(NULL, hActionStart);
+
+                    ::MsiRecordSetStringW(hActionStart, 1, L"InstallFiles");
+
+                    nResult = vpfnExternalUIRecord(vpvExternalUIContext, INSTALLMESSAGE_ACTIONSTART, hActionStart);
+                }
+
+                Assert::Equal(IDCANCEL, nResult);
+            }
+            finally
+            {
+                if (hActionStart)
+                {
+                    ::MsiCloseHandle(hActionStart);
+                }
+
+                UninitializeExternalUI(&context, hRecord);
+                DutilUninitialize();
+            }
+        }
+
+    private:
+        MSIHANDLE InitializeExternalUI(WIU_MSI_EXECUTE_CONTEXT* pContext, WIUTIL_TEST_HANDLER* pHandler)
+        {
+            HRESULT hr = S_OK;
+            MSIHANDLE hRecord = NULL;
+
+            WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuTest_MsiSetInternalUI, NULL, NULL, WiuTest_MsiSetExternalUIRecord, NULL);
+
+            hr = WiuInitializeExternalUI(TestExecuteMessageHandler, INSTALLUILEVEL_NONE, NULL, pHandler, FALSE, pContext);
+            NativeAssert::Succeeded(hr, "Failed to initialize external UI.");
+            Assert::True(NULL != vpfnExternalUIRecord);
+
+            hRecord = ::MsiCreateRecord(4);
+            Assert::NotEqual<MSIHANDLE>(NULL, hRecord);
+
+            // Windows Installer starts every session by resetting progress.
+            vpfnExternalUIRecord(vpvExternalUIContext, INSTALLMESSAGE_INITIALIZE, hRecord);
+
+            return hRecord;
+        }
+
+        void UninitializeExternalUI(WIU_MSI_EXECUTE_CONTEXT* pContext, MSIHANDLE hRecord)
+        {
+            if (hRecord)
+            {
+                ::MsiCloseHandle(hRecord);
+            }
+
+            WiuUninitializeExternalUI(pContext);
+            WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+            vpfnExternalUIRecord = NULL;
+            vpvExternalUIContext = NULL;
+        }
+    };
+}
+
+
+static INSTALLUILEVEL WINAPI WiuTest_MsiSetInternalUI(
+    __in INSTALLUILEVEL /*dwUILevel*/,
+    __inout_opt HWND* /*phWnd*/
+    )
+{
+    return INSTALLUILEVEL_NONE;
+}
+
+static UINT WINAPI WiuTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD /*dwMessageFilter*/,
+    __in_opt LPVOID pvContext,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    )
+{
+    if (ppuiPrevHandler)
+    {
+        *ppuiPrevHandler = vpfnExternalUIRecord;
+    }
+
+    vpfnExternalUIRecord = puiHandler;
+    vpvExternalUIContext = pvContext;
+
+    return ERROR_SUCCESS;
+}
+
+static int TestExecuteMessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    )
+{
+    WIUTIL_TEST_HANDLER* pHandler = reinterpret_cast<WIUTIL_TEST_HANDLER*>(pvContext);
+    int nResult = IDOK;
+
+    switch (pMessage->type)
+    {
+    case WIU_MSI_EXECUTE_MESSAGE_PROGRESS:
+        ++pHandler->cProgress;
+        pHandler->dwLastPercentage = pMessage->progress.dwPercentage;
+
+        if (pHandler->fCancelProgress)
+        {
+            nResult = IDCANCEL;
+        }
+        break;
+
+    case WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE:
+        if (INSTALLMESSAGE_ACTIONDATA == pMessage->msiMessage.mt)
+        {
+            ++pHandler->cActionData;
+
+            if (pMessage->cData && pMessage->rgwzData[0])
+            {
+                ::StringCchCopyW(pHandler->wzLastActionData, countof(pHandler->wzLastActionData), pMessage->rgwzData[0]);
+            }
+        }
+        break;
+    }
+
+    return nResult;
+}
+
+static INT SendProgressRecord(
+    __in MSIHANDLE hRecord,
+    __in int iType,
+    __in int iValue
+    )
+{
+    ::MsiRecordSetInteger(hRecord, 1, iType);
+    ::MsiRecordSetInteger(hRecord, 2, iValue);
+    ::MsiRecordSetInteger(hRecord, 3, 0);
+    ::MsiRecordSetInteger(hRecord, 4, 0);
+
+    return vpfnExternalUIRecord(vpvExternalUIContext, INSTALLMESSAGE_PROGRESS, hRecord);
+}
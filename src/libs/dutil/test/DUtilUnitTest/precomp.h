@@ -5,6 +5,8 @@
 #include <windows.h>
 #include <strsafe.h>
 #include <ShlObj.h>
+#include <msi.h>
+#include <msiquery.h>
 
 // Include error.h before dutil.h
 #include <dutilsources.h>
@@ -12,20 +14,24 @@
 #include <dutil.h>
 
 #include <verutil.h>
+#include <aclutil.h>
 #include <atomutil.h>
 #include <dictutil.h>
 #include <dirutil.h>
 #include <fileutil.h>
 #include <guidutil.h>
 #include <iniutil.h>
+#include <jsonutil.h>
 #include <memutil.h>
 #include <pathutil.h>
+#include <procutil.h>
 #include <strutil.h>
 #include <monutil.h>
 #include <regutil.h>
 #include <rssutil.h>
 #include <apuputil.h> // NOTE: this must come after atomutil.h and rssutil.h since it uses them.
 #include <uriutil.h>
+#include <wiutil.h>
 #include <xmlutil.h>
 
 #pragma managed
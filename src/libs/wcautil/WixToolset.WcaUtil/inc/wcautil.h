@@ -65,6 +65,16 @@ typedef enum WCA_ENCODING
     WCA_ENCODING_ANSI,
 } WCA_ENCODING;
 
+// Builds CustomActionData in the same delimited format the WcaRead*FromCaData
+// functions parse, tracking the length so each field is appended in place.
+typedef struct WCA_CADATA_WRITER
+{
+    LPWSTR pwzData;
+    SIZE_T cchData;
+    SIZE_T cchAlloc;
+    DWORD cFields;
+} WCA_CADATA_WRITER;
+
 void WIXAPI WcaGlobalInitialize(
     __in HINSTANCE hInst
     );
@@ -277,6 +287,10 @@ HRESULT WIXAPI WcaReadStreamFromCaData(
     __deref_out_bcount(*pcbData) BYTE** ppbData,
     __out DWORD_PTR* pcbData
     );
+HRESULT WIXAPI WcaReadStringViewFromCaData(
+    __deref_in LPWSTR* ppwzCustomActionData,
+    __deref_out_z LPCWSTR* pwzString
+    );
 HRESULT WIXAPI WcaWriteStringToCaData(
     __in_z LPCWSTR wzString,
     __deref_inout_z LPWSTR* ppwzCustomActionData
@@ -290,6 +304,22 @@ HRESULT WIXAPI WcaWriteStreamToCaData(
     __in SIZE_T cbData,
     __deref_inout_z_opt LPWSTR* ppwzCustomActionData
     );
+HRESULT WIXAPI WcaCaDataWriteString(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in_z LPCWSTR wzString
+    );
+HRESULT WIXAPI WcaCaDataWriteInteger(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in int i
+    );
+HRESULT WIXAPI WcaCaDataWriteStream(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    );
+void WIXAPI WcaCaDataWriterUninitialize(
+    __in WCA_CADATA_WRITER* pWriter
+    );
 
 HRESULT __cdecl WcaAddTempRecord(
     __inout MSIHANDLE* phTableView,
@@ -373,6 +403,15 @@ HRESULT WIXAPI QuietExecCapture(
     __out_z_opt LPWSTR* psczOutput
     );
 
+HRESULT WIXAPI QuietExecMultiple(
+    __in_ecount(cCommands) LPWSTR* rgwzCommands,
+    __in DWORD cCommands,
+    __in DWORD cMaxParallel,
+    __in DWORD dwTimeout,
+    __in BOOL fLogCommand,
+    __in BOOL fLogOutput
+    );
+
 WCA_TODO WIXAPI WcaGetComponentToDo(
     __in_z LPCWSTR wzComponentId
     );
@@ -10,7 +10,8 @@ typedef enum eWrapQueryAction
     wqaTableBegin = 1,
     wqaTableFinish,
     wqaRowBegin,
-    wqaRowFinish
+    wqaRowFinish,
+    wqaColumnarTableBegin
 } eWrapQueryAction;
 
 typedef enum eColumnDataType
@@ -57,6 +58,14 @@ typedef enum eFormatMaskColumn
     efmcColumn32 = 1 << 31,
 } eFormatMaskColumn;
 
+// Hash of a string pool by exact characters, each bucket chains string indexes (index + 1, 0 ends the chain)
+typedef struct WCA_WRAPQUERY_STRING_HASH
+{
+    DWORD *rgdwBuckets;
+    DWORD cBuckets;
+    DWORD *rgdwNext;
+} WCA_WRAPQUERY_STRING_HASH;
+
 // Keeps track of the query instance for the reading CA (deferred CA)
 typedef struct WCA_WRAPQUERY_STRUCT
 {
@@ -67,7 +76,20 @@ typedef struct WCA_WRAPQUERY_STRUCT
     eColumnDataType *pcdtColumnType;
     LPWSTR *ppwzColumnNames;
 
-    // Dynamic array of raw record data
+    // Dynamic arrays of column data, one per column - string columns hold indexes into the string pool
+    int **prgiColumnValues;
+
+    // Deduplicated string pool, the strings all live in a single allocation
+    DWORD dwStrings;
+    LPCWSTR *ppwzStrings;
+    LPWSTR pwzStringPool;
+    WCA_WRAPQUERY_STRING_HASH stringHash;
+
+    // Per string column lookup tables, built the first time a column is searched (row + 1, 0 ends the chain)
+    DWORD **prgdwFirstRow;
+    DWORD **prgdwNextRow;
+
+    // Dynamic array of records, each created the first time its row is fetched
     MSIHANDLE *phRecords;
 } *WCA_WRAPQUERY_HANDLE;
 
@@ -115,6 +137,7 @@ HRESULT WIXAPI WcaFetchWrappedRecord(
     );
 
 // Fetch the next record in the query where the string value in column dwComparisonColumn equals the value pwzExpectedValue
+// String columns are searched through a lookup table built on first use, so repeated lookups don't rescan the table
 // NOTE: the MSIHANDLE returned by this function should not be released, as it is the same handle used by the query object to maintain the item.
 //       so, don't use this function with PMSIHANDLE objects!
 HRESULT WIXAPI WcaFetchWrappedRecordWhereString(
@@ -5,6 +5,7 @@
 #include <windows.h>
 #include <msiquery.h>
 #include <wchar.h>
+#include <errno.h>
 #include <strsafe.h>
 
 const WCHAR MAGIC_MULTISZ_DELIM = 128;
@@ -4,6 +4,8 @@
 
 #define OUTPUT_BUFFER 1024
 #define ONEMINUTE 60000
+#define QUIET_EXEC_PENDING_LINES 16
+#define QUIET_EXEC_POLL_INTERVAL 100
 
 static HRESULT CreatePipes(
     __out HANDLE *phOutRead,
@@ -95,142 +97,314 @@ LExit:
     return hr;
 }
 
-static HRESULT HandleOutput(
+// Tracks the output of one command across reads so a line split between two
+// reads is still logged whole.
+typedef struct _QUIET_EXEC_OUTPUT
+{
+    BOOL fLogOutput;
+    LPWSTR* psczOutput;
+    BOOL fFirst;
+    BOOL fUnicode;
+    LPWSTR sczLog;
+
+    // Non-zero when several commands run at once. Each line is then prefixed with
+    // the command number and held back until a few have collected so a command's
+    // output stays together in the log.
+    DWORD dwCommand;
+    LPWSTR sczPending;
+    DWORD cPending;
+} QUIET_EXEC_OUTPUT;
+
+// Tracks one of the commands started by QuietExecMultiple.
+typedef struct _QUIET_EXEC_COMMAND
+{
+    LPWSTR wzCommand;
+    HANDLE hProcess;
+    HANDLE hOutRead;
+    HANDLE hInWrite;
+    DWORD dwStart;
+    QUIET_EXEC_OUTPUT output;
+} QUIET_EXEC_COMMAND;
+
+static void InitializeOutput(
+    __in QUIET_EXEC_OUTPUT* pOutput,
     __in BOOL fLogOutput,
-    __in HANDLE hRead,
-    __out_z_opt LPWSTR* psczOutput
+    __out_z_opt LPWSTR* psczOutput,
+    __in DWORD dwCommand
     )
 {
-    BYTE* pBuffer = NULL;
-    LPWSTR szLog = NULL;
-    LPWSTR szTemp = NULL;
-    LPWSTR pEnd = NULL;
-    LPWSTR pNext = NULL;
+    pOutput->fLogOutput = fLogOutput;
+    pOutput->psczOutput = psczOutput;
+    pOutput->fFirst = TRUE;
+    pOutput->fUnicode = TRUE;
+    pOutput->dwCommand = dwCommand;
+}
+
+static void ReleaseOutput(
+    __in QUIET_EXEC_OUTPUT* pOutput
+    )
+{
+    ReleaseStr(pOutput->sczPending);
+    ReleaseStr(pOutput->sczLog);
+}
+
+static HRESULT WriteOutputLine(
+    __in LOGLEVEL llv,
+    __in_z LPCWSTR wzLine
+    )
+{
+    HRESULT hr = S_OK;
     LPWSTR sczEscaped = NULL;
     LPSTR szWrite = NULL;
-    DWORD dwBytes = OUTPUT_BUFFER;
-    BOOL bFirst = TRUE;
-    BOOL bUnicode = TRUE;
-    HRESULT hr = S_OK;
 
-    // Get buffer for output
-    pBuffer = static_cast<BYTE *>(MemAlloc(OUTPUT_BUFFER, FALSE));
-    ExitOnNull(pBuffer, hr, E_OUTOFMEMORY, "Failed to allocate buffer for output.");
+    hr = StrAllocString(&sczEscaped, wzLine, 0);
+    ExitOnFailure(hr, "Failed to allocate copy of string");
 
-    while (0 != dwBytes)
+    hr = StrReplaceStringAll(&sczEscaped, L"%", L"%%");
+    ExitOnFailure(hr, "Failed to escape percent signs in string");
+
+    hr = StrAnsiAllocString(&szWrite, sczEscaped, 0, CP_OEMCP);
+    ExitOnFailure(hr, "Failed to convert output to ANSI");
+
+    WcaLog(llv, szWrite);
+
+LExit:
+    ReleaseStr(szWrite);
+    ReleaseStr(sczEscaped);
+
+    return hr;
+}
+
+static HRESULT FlushOutput(
+    __in QUIET_EXEC_OUTPUT* pOutput
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pNext = pOutput->sczPending;
+    LPWSTR pEnd = NULL;
+
+    while (pNext && *pNext)
     {
-        ::ZeroMemory(pBuffer, OUTPUT_BUFFER);
-        if (!::ReadFile(hRead, pBuffer, OUTPUT_BUFFER - 1, &dwBytes, NULL) && GetLastError() != ERROR_BROKEN_PIPE)
+        pEnd = wcschr(pNext, L'\n');
+        if (pEnd)
         {
-            ExitOnLastError(hr, "Failed to read from handle.");
+            *pEnd = L'\0';
+            ++pEnd;
         }
 
-        if (fLogOutput)
+        hr = WriteOutputLine(LOGMSG_STANDARD, pNext);
+        ExitOnFailure(hr, "Failed to log output");
+
+        pNext = pEnd;
+    }
+
+    if (pOutput->sczPending)
+    {
+        *pOutput->sczPending = L'\0';
+    }
+    pOutput->cPending = 0;
+
+LExit:
+    return hr;
+}
+
+static HRESULT LogOutputLine(
+    __in QUIET_EXEC_OUTPUT* pOutput,
+    __in LOGLEVEL llv,
+    __in_z LPCWSTR wzLine
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczLine = NULL;
+
+    if (!pOutput->dwCommand)
+    {
+        hr = WriteOutputLine(llv, wzLine);
+        ExitOnFailure(hr, "Failed to log output");
+    }
+    else if (LOGMSG_STANDARD == llv)
+    {
+        hr = StrAllocConcatFormatted(&pOutput->sczPending, L"[%u] %ls\n", pOutput->dwCommand, wzLine);
+        ExitOnFailure(hr, "Failed to buffer output");
+
+        if (QUIET_EXEC_PENDING_LINES <= ++pOutput->cPending)
         {
-            // Check for UNICODE or ANSI output
-            if (bFirst)
-            {
-                if ((isgraph(pBuffer[0]) && isgraph(pBuffer[1])) ||
-                    (isgraph(pBuffer[0]) && isspace(pBuffer[1])) ||
-                    (isspace(pBuffer[0]) && isgraph(pBuffer[1])) ||
-                    (isspace(pBuffer[0]) && isspace(pBuffer[1])))
-                {
-                    bUnicode = FALSE;
-                }
+            hr = FlushOutput(pOutput);
+            ExitOnFailure(hr, "Failed to flush output");
+        }
+    }
+    else
+    {
+        hr = FlushOutput(pOutput);
+        ExitOnFailure(hr, "Failed to flush output");
 
-                bFirst = FALSE;
-            }
+        hr = StrAllocFormatted(&sczLine, L"[%u] %ls", pOutput->dwCommand, wzLine);
+        ExitOnFailure(hr, "Failed to format output");
 
-            // Keep track of output
-            if (bUnicode)
-            {
-                hr = StrAllocConcat(&szLog, (LPCWSTR)pBuffer, 0);
-                ExitOnFailure(hr, "Failed to concatenate output strings.");
+        hr = WriteOutputLine(llv, sczLine);
+        ExitOnFailure(hr, "Failed to log output");
+    }
 
-                if (psczOutput)
-                {
-                    hr = StrAllocConcat(psczOutput, (LPCWSTR)pBuffer, 0);
-                    ExitOnFailure(hr, "Failed to concatenate output to return string.");
-                }
-            }
-            else
-            {
-                hr = StrAllocStringAnsi(&szTemp, (LPCSTR)pBuffer, 0, CP_OEMCP);
-                ExitOnFailure(hr, "Failed to allocate output string.");
-                hr = StrAllocConcat(&szLog, szTemp, 0);
-                ExitOnFailure(hr, "Failed to concatenate output strings.");
+LExit:
+    ReleaseStr(sczLine);
 
-                if (psczOutput)
-                {
-                    hr = StrAllocConcat(psczOutput, szTemp, 0);
-                    ExitOnFailure(hr, "Failed to concatenate output to return string.");
-                }
-            }
+    return hr;
+}
 
-            // Log each line of the output
-            pNext = szLog;
-            pEnd = wcschr(szLog, L'\r');
-            if (NULL == pEnd)
-            {
-                pEnd = wcschr(szLog, L'\n');
-            }
-            while (pEnd && *pEnd)
-            {
-                // Find beginning of next line
-                pEnd[0] = 0;
-                ++pEnd;
-                if ((pEnd[0] == L'\r') || (pEnd[0] == L'\n'))
-                {
-                    ++pEnd;
-                }
+static HRESULT ProcessOutput(
+    __in QUIET_EXEC_OUTPUT* pOutput,
+    __in const BYTE* pBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR szTemp = NULL;
+    LPWSTR pEnd = NULL;
+    LPWSTR pNext = NULL;
 
-                // Log output
-                hr = StrAllocString(&sczEscaped, pNext, 0);
-                ExitOnFailure(hr, "Failed to allocate copy of string");
+    if (!pOutput->fLogOutput)
+    {
+        ExitFunction();
+    }
 
-                hr = StrReplaceStringAll(&sczEscaped, L"%", L"%%");
-                ExitOnFailure(hr, "Failed to escape percent signs in string");
+    // Check for UNICODE or ANSI output
+    if (pOutput->fFirst)
+    {
+        if ((isgraph(pBuffer[0]) && isgraph(pBuffer[1])) ||
+            (isgraph(pBuffer[0]) && isspace(pBuffer[1])) ||
+            (isspace(pBuffer[0]) && isgraph(pBuffer[1])) ||
+            (isspace(pBuffer[0]) && isspace(pBuffer[1])))
+        {
+            pOutput->fUnicode = FALSE;
+        }
 
-                hr = StrAnsiAllocString(&szWrite, sczEscaped, 0, CP_OEMCP);
-                ExitOnFailure(hr, "Failed to convert output to ANSI");
-                WcaLog(LOGMSG_STANDARD, szWrite);
+        pOutput->fFirst = FALSE;
+    }
 
-                // Next line
-                pNext = pEnd;
-                pEnd = wcschr(pNext, L'\r');
-                if (NULL == pEnd)
-                {
-                    pEnd = wcschr(pNext, L'\n');
-                }
-            }
+    // Keep track of output
+    if (pOutput->fUnicode)
+    {
+        hr = StrAllocConcat(&pOutput->sczLog, (LPCWSTR)pBuffer, 0);
+        ExitOnFailure(hr, "Failed to concatenate output strings.");
 
-            hr = StrAllocString(&szTemp, pNext, 0);
-            ExitOnFailure(hr, "Failed to allocate string");
+        if (pOutput->psczOutput)
+        {
+            hr = StrAllocConcat(pOutput->psczOutput, (LPCWSTR)pBuffer, 0);
+            ExitOnFailure(hr, "Failed to concatenate output to return string.");
+        }
+    }
+    else
+    {
+        hr = StrAllocStringAnsi(&szTemp, (LPCSTR)pBuffer, 0, CP_OEMCP);
+        ExitOnFailure(hr, "Failed to allocate output string.");
+        hr = StrAllocConcat(&pOutput->sczLog, szTemp, 0);
+        ExitOnFailure(hr, "Failed to concatenate output strings.");
 
-            hr = StrAllocString(&szLog, szTemp, 0);
-            ExitOnFailure(hr, "Failed to allocate string");
+        if (pOutput->psczOutput)
+        {
+            hr = StrAllocConcat(pOutput->psczOutput, szTemp, 0);
+            ExitOnFailure(hr, "Failed to concatenate output to return string.");
         }
     }
 
+    // Log each line of the output
+    pNext = pOutput->sczLog;
+    pEnd = wcschr(pNext, L'\r');
+    if (NULL == pEnd)
+    {
+        pEnd = wcschr(pNext, L'\n');
+    }
+    while (pEnd && *pEnd)
+    {
+        // Find beginning of next line
+        pEnd[0] = 0;
+        ++pEnd;
+        if ((pEnd[0] == L'\r') || (pEnd[0] == L'\n'))
+        {
+            ++pEnd;
+        }
+
+        // Log output
+        hr = LogOutputLine(pOutput, LOGMSG_STANDARD, pNext);
+        ExitOnFailure(hr, "Failed to log output line");
+
+        // Next line
+        pNext = pEnd;
+        pEnd = wcschr(pNext, L'\r');
+        if (NULL == pEnd)
+        {
+            pEnd = wcschr(pNext, L'\n');
+        }
+    }
+
+    hr = StrAllocString(&szTemp, pNext, 0);
+    ExitOnFailure(hr, "Failed to allocate string");
+
+    hr = StrAllocString(&pOutput->sczLog, szTemp, 0);
+    ExitOnFailure(hr, "Failed to allocate string");
+
+LExit:
+    ReleaseStr(szTemp);
+
+    return hr;
+}
+
+static HRESULT FinishOutput(
+    __in QUIET_EXEC_OUTPUT* pOutput
+    )
+{
+    HRESULT hr = S_OK;
+
     // Print any text that didn't end with a new line
-    if (szLog && *szLog)
+    if (pOutput->sczLog && *pOutput->sczLog)
     {
-        hr = StrReplaceStringAll(&szLog, L"%", L"%%");
-        ExitOnFailure(hr, "Failed to escape percent signs in string");
+        hr = LogOutputLine(pOutput, LOGMSG_VERBOSE, pOutput->sczLog);
+        ExitOnFailure(hr, "Failed to log output line");
+
+        *pOutput->sczLog = L'\0';
+    }
+
+    hr = FlushOutput(pOutput);
+    ExitOnFailure(hr, "Failed to flush output");
+
+LExit:
+    return hr;
+}
+
+static HRESULT HandleOutput(
+    __in BOOL fLogOutput,
+    __in HANDLE hRead,
+    __out_z_opt LPWSTR* psczOutput
+    )
+{
+    BYTE* pBuffer = NULL;
+    QUIET_EXEC_OUTPUT output = { };
+    DWORD dwBytes = OUTPUT_BUFFER;
+    HRESULT hr = S_OK;
+
+    InitializeOutput(&output, fLogOutput, psczOutput, 0);
+
+    // Get buffer for output
+    pBuffer = static_cast<BYTE *>(MemAlloc(OUTPUT_BUFFER, FALSE));
+    ExitOnNull(pBuffer, hr, E_OUTOFMEMORY, "Failed to allocate buffer for output.");
 
-        hr = StrAnsiAllocString(&szWrite, szLog, 0, CP_OEMCP);
-        ExitOnFailure(hr, "Failed to convert output to ANSI");
+    while (0 != dwBytes)
+    {
+        ::ZeroMemory(pBuffer, OUTPUT_BUFFER);
+        if (!::ReadFile(hRead, pBuffer, OUTPUT_BUFFER - 1, &dwBytes, NULL) && GetLastError() != ERROR_BROKEN_PIPE)
+        {
+            ExitOnLastError(hr, "Failed to read from handle.");
+        }
 
-        WcaLog(LOGMSG_VERBOSE, szWrite);
+        hr = ProcessOutput(&output, pBuffer);
+        ExitOnFailure(hr, "Failed to process output.");
     }
 
+    hr = FinishOutput(&output);
+    ExitOnFailure(hr, "Failed to finish output.");
+
 LExit:
     ReleaseMem(pBuffer);
-
-    ReleaseStr(szLog);
-    ReleaseStr(szTemp);
-    ReleaseStr(szWrite);
-    ReleaseStr(sczEscaped);
+    ReleaseOutput(&output);
 
     return hr;
 }
@@ -338,3 +512,245 @@ HRESULT WIXAPI QuietExecCapture(
 {
     return QuietExecImpl(wzCommand, dwTimeout, fLogCommand, fLogOutput, psczOutput);
 }
+
+
+static HRESULT StartCommand(
+    __in QUIET_EXEC_COMMAND* pCommand,
+    __in BOOL fLogCommand
+    )
+{
+    HRESULT hr = S_OK;
+    PROCESS_INFORMATION oProcInfo = { };
+    STARTUPINFOW oStartInfo = { };
+    HANDLE hOutWrite = INVALID_HANDLE_VALUE;
+    HANDLE hErrWrite = INVALID_HANDLE_VALUE;
+    HANDLE hInRead = INVALID_HANDLE_VALUE;
+
+    hr = CreatePipes(&pCommand->hOutRead, &hOutWrite, &hErrWrite, &hInRead, &pCommand->hInWrite);
+    ExitOnFailure(hr, "Failed to create output pipes");
+
+    oStartInfo.cb = sizeof(STARTUPINFOW);
+    oStartInfo.dwFlags = STARTF_USESTDHANDLES;
+    oStartInfo.hStdInput = hInRead;
+    oStartInfo.hStdOutput = hOutWrite;
+    oStartInfo.hStdError = hErrWrite;
+
+    if (fLogCommand)
+    {
+        WcaLog(LOGMSG_VERBOSE, "[%u] %ls", pCommand->output.dwCommand, pCommand->wzCommand);
+    }
+
+#pragma prefast(suppress:25028)
+    if (!::CreateProcessW(NULL,
+        pCommand->wzCommand, // command line
+        NULL, // security info
+        NULL, // thread info
+        TRUE, // inherit handles
+        ::GetPriorityClass(::GetCurrentProcess()) | CREATE_NO_WINDOW, // creation flags
+        NULL, // environment
+        NULL, // cur dir
+        &oStartInfo,
+        &oProcInfo))
+    {
+        ExitWithLastError(hr, "Command %u failed to execute.", pCommand->output.dwCommand);
+    }
+
+    ReleaseFile(oProcInfo.hThread);
+
+    pCommand->hProcess = oProcInfo.hProcess;
+    pCommand->dwStart = ::GetTickCount();
+
+LExit:
+    // Close child output/input handles so it doesn't hang
+    ReleaseFile(hOutWrite);
+    ReleaseFile(hErrWrite);
+    ReleaseFile(hInRead);
+
+    return hr;
+}
+
+static HRESULT ReadCommandOutput(
+    __in QUIET_EXEC_COMMAND* pCommand,
+    __in BYTE* pBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cbAvailable = 0;
+    DWORD dwBytes = 0;
+
+    // Only read what is already in the pipe so one quiet command never holds up the others.
+    while (::PeekNamedPipe(pCommand->hOutRead, NULL, 0, NULL, &cbAvailable, NULL) && cbAvailable)
+    {
+        ::ZeroMemory(pBuffer, OUTPUT_BUFFER);
+        if (!::ReadFile(pCommand->hOutRead, pBuffer, min(cbAvailable, static_cast<DWORD>(OUTPUT_BUFFER - 1)), &dwBytes, NULL) && GetLastError() != ERROR_BROKEN_PIPE)
+        {
+            ExitOnLastError(hr, "Failed to read from handle.");
+        }
+
+        if (!dwBytes)
+        {
+            break;
+        }
+
+        hr = ProcessOutput(&pCommand->output, pBuffer);
+        ExitOnFailure(hr, "Failed to process output.");
+    }
+
+LExit:
+    return hr;
+}
+
+static void ReleaseCommand(
+    __in QUIET_EXEC_COMMAND* pCommand
+    )
+{
+    ReleaseFile(pCommand->hOutRead);
+    ReleaseFile(pCommand->hInWrite);
+    ReleaseHandle(pCommand->hProcess);
+}
+
+// Runs the commands up to cMaxParallel at a time. Unlike QuietExec, which stops waiting after
+// dwTimeout but leaves the command running, a command still running after dwTimeout is terminated
+// and fails with ERROR_TIMEOUT. Pass INFINITE to let every command run to completion.
+HRESULT WIXAPI QuietExecMultiple(
+    __in_ecount(cCommands) LPWSTR* rgwzCommands,
+    __in DWORD cCommands,
+    __in DWORD cMaxParallel,
+    __in DWORD dwTimeout,
+    __in BOOL fLogCommand,
+    __in BOOL fLogOutput
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrCommand = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    QUIET_EXEC_COMMAND* rgCommands = NULL;
+    QUIET_EXEC_COMMAND* pCommand = NULL;
+    HANDLE rghRunning[MAXIMUM_WAIT_OBJECTS] = { };
+    DWORD rgiRunning[MAXIMUM_WAIT_OBJECTS] = { };
+    DWORD cRunning = 0;
+    DWORD iNext = 0;
+    DWORD dwExitCode = ERROR_SUCCESS;
+    DWORD dwStart = ::GetTickCount();
+    BYTE* pBuffer = NULL;
+
+    if (!cCommands)
+    {
+        ExitFunction();
+    }
+
+    cMaxParallel = max(1UL, min(cMaxParallel, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS)));
+
+    rgCommands = static_cast<QUIET_EXEC_COMMAND*>(MemAlloc(sizeof(QUIET_EXEC_COMMAND) * cCommands, TRUE));
+    ExitOnNull(rgCommands, hr, E_OUTOFMEMORY, "Failed to allocate commands.");
+
+    pBuffer = static_cast<BYTE*>(MemAlloc(OUTPUT_BUFFER, FALSE));
+    ExitOnNull(pBuffer, hr, E_OUTOFMEMORY, "Failed to allocate buffer for output.");
+
+    for (DWORD i = 0; i < cCommands; ++i)
+    {
+        rgCommands[i].wzCommand = rgwzCommands[i];
+        rgCommands[i].hOutRead = INVALID_HANDLE_VALUE;
+        rgCommands[i].hInWrite = INVALID_HANDLE_VALUE;
+        InitializeOutput(&rgCommands[i].output, fLogOutput, NULL, i + 1);
+    }
+
+    while (iNext < cCommands || cRunning)
+    {
+        // Once a command fails no more are started but the running ones are allowed to finish.
+        while (SUCCEEDED(hrCommand) && iNext < cCommands && cRunning < cMaxParallel)
+        {
+            pCommand = rgCommands + iNext;
+
+            hrCommand = StartCommand(pCommand, fLogCommand);
+            if (SUCCEEDED(hrCommand))
+            {
+                rghRunning[cRunning] = pCommand->hProcess;
+                rgiRunning[cRunning] = iNext;
+                ++cRunning;
+            }
+
+            ++iNext;
+        }
+
+        if (!cRunning)
+        {
+            break;
+        }
+
+        er = ::WaitForMultipleObjects(cRunning, rghRunning, FALSE, QUIET_EXEC_POLL_INTERVAL);
+        if (WAIT_FAILED == er)
+        {
+            ExitWithLastError(hr, "Failed to wait for commands to finish.");
+        }
+
+        for (DWORD i = 0; i < cRunning;)
+        {
+            pCommand = rgCommands + rgiRunning[i];
+
+            // Check for exit before reading so nothing written before the exit is missed.
+            BOOL fExited = WAIT_OBJECT_0 == ::WaitForSingleObject(pCommand->hProcess, 0);
+
+            hr = ReadCommandOutput(pCommand, pBuffer);
+            ExitOnFailure(hr, "Failed to read output of command %u.", pCommand->output.dwCommand);
+
+            if (fExited)
+            {
+                if (!::GetExitCodeProcess(pCommand->hProcess, &dwExitCode))
+                {
+                    dwExitCode = ERROR_SEM_IS_SET;
+                }
+            }
+            else if (INFINITE != dwTimeout && dwTimeout < ::GetTickCount() - pCommand->dwStart)
+            {
+                WcaLog(LOGMSG_STANDARD, "Command %u did not finish in %u ms; terminating it.", pCommand->output.dwCommand, dwTimeout);
+
+                ::TerminateProcess(pCommand->hProcess, ERROR_TIMEOUT);
+                dwExitCode = ERROR_TIMEOUT;
+            }
+            else
+            {
+                ++i;
+                continue;
+            }
+
+            hr = FinishOutput(&pCommand->output);
+            ExitOnFailure(hr, "Failed to finish output of command %u.", pCommand->output.dwCommand);
+
+            WcaLog(LOGMSG_VERBOSE, "Command %u exited with %u in %u ms.", pCommand->output.dwCommand, dwExitCode, ::GetTickCount() - pCommand->dwStart);
+
+            if (ERROR_SUCCESS != dwExitCode && SUCCEEDED(hrCommand))
+            {
+                hrCommand = HRESULT_FROM_WIN32(dwExitCode);
+                WcaLog(LOGMSG_STANDARD, "Command %u returned an error: %u", pCommand->output.dwCommand, dwExitCode);
+            }
+
+            ReleaseCommand(pCommand);
+
+            // Move the last running command into the finished command's slot.
+            --cRunning;
+            rghRunning[i] = rghRunning[cRunning];
+            rgiRunning[i] = rgiRunning[cRunning];
+        }
+    }
+
+    WcaLog(LOGMSG_VERBOSE, "Ran %u of %u commands, up to %u at a time, in %u ms.", iNext, cCommands, cMaxParallel, ::GetTickCount() - dwStart);
+
+    hr = hrCommand;
+    ExitOnFailure(hr, "Command line returned an error.");
+
+LExit:
+    if (rgCommands)
+    {
+        for (DWORD i = 0; i < cCommands; ++i)
+        {
+            ReleaseCommand(rgCommands + i);
+            ReleaseOutput(&rgCommands[i].output);
+        }
+    }
+
+    ReleaseMem(rgCommands);
+    ReleaseMem(pBuffer);
+
+    return hr;
+}
@@ -1210,10 +1210,8 @@ static LPWSTR BreakDownCustomActionData(
     if (0 == *ppwzData)
         return NULL;
 
-    WCHAR delim[] = {MAGIC_MULTISZ_DELIM, 0}; // magic char followed by Null terminator
-
     LPWSTR pwzReturn = *ppwzData;
-    LPWSTR pwz = wcsstr(pwzReturn, delim);
+    LPWSTR pwz = wcschr(pwzReturn, MAGIC_MULTISZ_DELIM);
     if (pwz)
     {
         *pwz = 0;
@@ -1322,6 +1320,28 @@ LExit:
 }
 
 
+/********************************************************************
+WcaReadStringViewFromCaData() - returns the next string in the
+CustomActionData without copying it
+
+NOTE: this modifies the passed in ppwzCustomActionData variable
+NOTE: the returned string points into the CustomActionData buffer and
+      is only valid as long as that buffer is
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaReadStringViewFromCaData(
+    __deref_in LPWSTR* ppwzCustomActionData,
+    __deref_out_z LPCWSTR* pwzString
+    )
+{
+    LPCWSTR pwz = BreakDownCustomActionData(ppwzCustomActionData);
+    if (!pwz)
+        return E_NOMOREITEMS;
+
+    *pwzString = pwz;
+    return S_OK;
+}
+
+
 /********************************************************************
 WcaWriteStringToCaData() - adds a string to the CustomActionData to
 feed a deferred CustomAction
@@ -1333,7 +1353,6 @@ extern "C" HRESULT WIXAPI WcaWriteStringToCaData(
     )
 {
     HRESULT hr = S_OK;
-    WCHAR delim[] = {MAGIC_MULTISZ_DELIM, 0}; // magic char followed by NULL terminator
     SIZE_T cchString = 0;
     SIZE_T cchCustomActionData = 0;
     SIZE_T cchMax = 0;
@@ -1346,8 +1365,6 @@ extern "C" HRESULT WIXAPI WcaWriteStringToCaData(
     hr = ::StringCchLengthW(wzString, STRSAFE_MAX_LENGTH, reinterpret_cast<size_t*>(&cchString));
     ExitOnRootFailure(hr, "failed to get length of ca data string");
 
-    ++cchString; // assume we'll be adding the delim
-
     if (*ppwzCustomActionData)
     {
         hr = StrMaxLength(*ppwzCustomActionData, &cchCustomActionData);
@@ -1357,23 +1374,28 @@ extern "C" HRESULT WIXAPI WcaWriteStringToCaData(
         ExitOnRootFailure(hr, "failed to get length of custom action data");
     }
 
-    if ((cchCustomActionData - cchMax) < cchString + 1)
+    if ((cchCustomActionData - cchMax) < cchString + 2) // delimiter, string and null terminator
     {
-        cchCustomActionData += cchString + 1 + 255;  // add 255 for good measure
+        // Grow geometrically so a long run of writes only copies the data a few times.
+        cchCustomActionData = max(cchCustomActionData * 2, cchMax + cchString + 2 + 255);
         cchCustomActionData = min(STRSAFE_MAX_LENGTH, cchCustomActionData);
 
         hr = StrAlloc(ppwzCustomActionData, cchCustomActionData);
         ExitOnFailure(hr, "Failed to allocate memory for CustomActionData string");
+
+        if ((cchCustomActionData - cchMax) < cchString + 2)
+        {
+            ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
+        }
     }
 
-    if (**ppwzCustomActionData) // if data exists toss the delimiter on before adding more to the end
+    if (cchMax) // if data exists toss the delimiter on before adding more to the end
     {
-        hr = ::StringCchCatW(*ppwzCustomActionData, cchCustomActionData, delim);
-        ExitOnRootFailure(hr, "Failed to concatenate CustomActionData string");
+        (*ppwzCustomActionData)[cchMax] = MAGIC_MULTISZ_DELIM;
+        ++cchMax;
     }
 
-    hr = ::StringCchCatW(*ppwzCustomActionData, cchCustomActionData, wzString);
-    ExitOnRootFailure(hr, "Failed to concatenate CustomActionData string");
+    memcpy_s(*ppwzCustomActionData + cchMax, (cchCustomActionData - cchMax) * sizeof(WCHAR), wzString, (cchString + 1) * sizeof(WCHAR));
 
 LExit:
     return hr;
@@ -1422,6 +1444,113 @@ LExit:
 }
 
 
+/********************************************************************
+WcaCaDataWriteString() - appends a string to CustomActionData being
+built by a WCA_CADATA_WRITER
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataWriteString(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in_z LPCWSTR wzString
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cchString = 0;
+    SIZE_T cchRequired = 0;
+    SIZE_T cchAlloc = 0;
+
+    hr = ::StringCchLengthW(wzString, STRSAFE_MAX_LENGTH, reinterpret_cast<size_t*>(&cchString));
+    ExitOnRootFailure(hr, "failed to get length of ca data string");
+
+    cchRequired = pWriter->cchData + (pWriter->cFields ? 1 : 0) + cchString + 1;
+    if (STRSAFE_MAX_LENGTH < cchRequired)
+    {
+        ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
+    }
+
+    if (pWriter->cchAlloc < cchRequired)
+    {
+        cchAlloc = max(pWriter->cchAlloc * 2, cchRequired + 255);
+        cchAlloc = min(STRSAFE_MAX_LENGTH, cchAlloc);
+
+        hr = StrAlloc(&pWriter->pwzData, cchAlloc);
+        ExitOnFailure(hr, "Failed to allocate memory for CustomActionData string");
+
+        pWriter->cchAlloc = cchAlloc;
+    }
+
+    // Fields after the first are preceded by the delimiter, even when the first field was empty.
+    if (pWriter->cFields)
+    {
+        pWriter->pwzData[pWriter->cchData] = MAGIC_MULTISZ_DELIM;
+        ++pWriter->cchData;
+    }
+
+    memcpy_s(pWriter->pwzData + pWriter->cchData, (pWriter->cchAlloc - pWriter->cchData) * sizeof(WCHAR), wzString, (cchString + 1) * sizeof(WCHAR));
+    pWriter->cchData += cchString;
+    ++pWriter->cFields;
+
+LExit:
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataWriteInteger() - appends an integer to CustomActionData being
+built by a WCA_CADATA_WRITER
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataWriteInteger(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in int i
+    )
+{
+    WCHAR wzBuffer[13];
+    StringCchPrintfW(wzBuffer, countof(wzBuffer), L"%d", i);
+
+    return WcaCaDataWriteString(pWriter, wzBuffer);
+}
+
+
+/********************************************************************
+WcaCaDataWriteStream() - appends a byte stream to CustomActionData
+being built by a WCA_CADATA_WRITER
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataWriteStream(
+    __in WCA_CADATA_WRITER* pWriter,
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzData = NULL;
+
+    hr = StrAllocBase85Encode(pbData, cbData, &pwzData);
+    ExitOnFailure(hr, "failed to encode data into string");
+
+    hr = WcaCaDataWriteString(pWriter, pwzData);
+
+LExit:
+    ReleaseStr(pwzData);
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataWriterUninitialize() - frees the CustomActionData held by a
+WCA_CADATA_WRITER
+
+********************************************************************/
+extern "C" void WIXAPI WcaCaDataWriterUninitialize(
+    __in WCA_CADATA_WRITER* pWriter
+    )
+{
+    ReleaseStr(pWriter->pwzData);
+    memset(pWriter, 0, sizeof(WCA_CADATA_WRITER));
+}
+
+
 /********************************************************************
 WcaAddTempRecord - adds a temporary record to the active database
 
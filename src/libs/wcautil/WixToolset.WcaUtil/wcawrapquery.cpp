@@ -54,6 +54,27 @@ WCA_WRAPQUERY_HANDLE WIXAPI GetNewQueryInstance(
         hNewHandle->ppwzColumnNames[i] = NULL;
     }
 
+    if (0 != hNewHandle->dwColumns)
+    {
+        hNewHandle->prgiColumnValues = static_cast<int **>(MemAlloc(hNewHandle->dwColumns * sizeof(int *), TRUE));
+        ExitOnNull(hNewHandle->prgiColumnValues, hr, E_OUTOFMEMORY, "Failed to allocate column values array");
+
+        hNewHandle->prgdwFirstRow = static_cast<DWORD **>(MemAlloc(hNewHandle->dwColumns * sizeof(DWORD *), TRUE));
+        ExitOnNull(hNewHandle->prgdwFirstRow, hr, E_OUTOFMEMORY, "Failed to allocate column lookup array");
+
+        hNewHandle->prgdwNextRow = static_cast<DWORD **>(MemAlloc(hNewHandle->dwColumns * sizeof(DWORD *), TRUE));
+        ExitOnNull(hNewHandle->prgdwNextRow, hr, E_OUTOFMEMORY, "Failed to allocate column lookup chain array");
+
+        if (0 != hNewHandle->dwRows)
+        {
+            for (DWORD i = 0; i < hNewHandle->dwColumns; ++i)
+            {
+                hNewHandle->prgiColumnValues[i] = static_cast<int *>(MemAlloc(hNewHandle->dwRows * sizeof(int), TRUE));
+                ExitOnNull(hNewHandle->prgiColumnValues[i], hr, E_OUTOFMEMORY, "Failed to allocate values for column %u", i + 1);
+            }
+        }
+    }
+
     if (0 != hNewHandle->dwRows)
     {
         hNewHandle->phRecords = static_cast<MSIHANDLE *>(MemAlloc(hNewHandle->dwRows * sizeof(MSIHANDLE), TRUE));
@@ -120,6 +141,397 @@ eColumnDataType WIXAPI GetDataTypeFromString(
     }
 }
 
+static DWORD HashPoolString(
+    __in_z LPCWSTR wzValue
+    )
+{
+    DWORD dwHash = 2166136261;
+
+    for (LPCWSTR wz = wzValue; *wz; ++wz)
+    {
+        dwHash = (dwHash ^ *wz) * 16777619;
+    }
+
+    return dwHash;
+}
+
+// Strings are matched by their exact characters, so values that only compare equal linguistically keep separate pool entries
+static HRESULT FindPoolString(
+    __in const WCA_WRAPQUERY_STRING_HASH* pHash,
+    __in LPCWSTR* rgwzStrings,
+    __in_z LPCWSTR wzValue,
+    __out DWORD* pdwIndex
+    )
+{
+    if (0 == pHash->cBuckets)
+    {
+        return E_NOTFOUND;
+    }
+
+    for (DWORD dw = pHash->rgdwBuckets[HashPoolString(wzValue) & (pHash->cBuckets - 1)]; 0 != dw; dw = pHash->rgdwNext[dw - 1])
+    {
+        if (0 == wcscmp(rgwzStrings[dw - 1], wzValue))
+        {
+            *pdwIndex = dw - 1;
+            return S_OK;
+        }
+    }
+
+    return E_NOTFOUND;
+}
+
+// Hashes the last of cStrings strings, doubling the buckets whenever there are more strings than buckets
+static HRESULT AddPoolString(
+    __in WCA_WRAPQUERY_STRING_HASH* pHash,
+    __in_ecount(cStrings) LPCWSTR* rgwzStrings,
+    __in DWORD cStrings
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD* rgdwBuckets = NULL;
+    DWORD cBuckets = 0;
+    DWORD dwBucket = 0;
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pHash->rgdwNext), cStrings, sizeof(DWORD), max(cStrings, 64UL));
+    ExitOnFailure(hr, "Failed to grow string pool hash chains");
+
+    if (pHash->cBuckets < cStrings)
+    {
+        cBuckets = pHash->cBuckets ? pHash->cBuckets * 2 : 64;
+
+        rgdwBuckets = static_cast<DWORD*>(MemAlloc(cBuckets * sizeof(DWORD), TRUE));
+        ExitOnNull(rgdwBuckets, hr, E_OUTOFMEMORY, "Failed to allocate string pool hash buckets");
+
+        for (DWORD i = 0; i + 1 < cStrings; ++i)
+        {
+            dwBucket = HashPoolString(rgwzStrings[i]) & (cBuckets - 1);
+
+            pHash->rgdwNext[i] = rgdwBuckets[dwBucket];
+            rgdwBuckets[dwBucket] = i + 1;
+        }
+
+        ReleaseMem(pHash->rgdwBuckets);
+        pHash->rgdwBuckets = rgdwBuckets;
+        pHash->cBuckets = cBuckets;
+        rgdwBuckets = NULL;
+    }
+
+    dwBucket = HashPoolString(rgwzStrings[cStrings - 1]) & (pHash->cBuckets - 1);
+
+    pHash->rgdwNext[cStrings - 1] = pHash->rgdwBuckets[dwBucket];
+    pHash->rgdwBuckets[dwBucket] = cStrings;
+
+LExit:
+    ReleaseMem(rgdwBuckets);
+
+    return hr;
+}
+
+static void ReleasePoolHash(
+    __in WCA_WRAPQUERY_STRING_HASH* pHash
+    )
+{
+    ReleaseMem(pHash->rgdwBuckets);
+    ReleaseMem(pHash->rgdwNext);
+}
+
+// Accumulates the table data in WcaWrapQuery until it is written out column by column
+typedef struct WCA_WRAPQUERY_BUILDER
+{
+    DWORD cColumns;
+    DWORD cRows;
+
+    // Row-major values, string columns hold indexes into rgsczStrings
+    int* rgiValues;
+    DWORD cValues;
+
+    LPWSTR* rgsczStrings;
+    DWORD cStrings;
+    WCA_WRAPQUERY_STRING_HASH stringHash;
+} WCA_WRAPQUERY_BUILDER;
+
+static HRESULT AddBuilderInteger(
+    __in WCA_WRAPQUERY_BUILDER* pBuilder,
+    __in int iValue
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pBuilder->rgiValues), pBuilder->cValues + 1, sizeof(int), max(pBuilder->cValues, 256UL));
+    ExitOnFailure(hr, "Failed to grow wrapped table values");
+
+    pBuilder->rgiValues[pBuilder->cValues] = iValue;
+    ++pBuilder->cValues;
+
+LExit:
+    return hr;
+}
+
+static HRESULT AddBuilderString(
+    __in WCA_WRAPQUERY_BUILDER* pBuilder,
+    __in_z LPCWSTR wzValue
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwIndex = 0;
+
+    if (S_OK == FindPoolString(&pBuilder->stringHash, const_cast<LPCWSTR*>(pBuilder->rgsczStrings), wzValue, &dwIndex))
+    {
+        ExitFunction1(hr = AddBuilderInteger(pBuilder, static_cast<int>(dwIndex)));
+    }
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pBuilder->rgsczStrings), pBuilder->cStrings + 1, sizeof(LPWSTR), max(pBuilder->cStrings, 64UL));
+    ExitOnFailure(hr, "Failed to grow wrapped table string pool");
+
+    pBuilder->rgsczStrings[pBuilder->cStrings] = NULL;
+
+    hr = StrAllocString(pBuilder->rgsczStrings + pBuilder->cStrings, wzValue, 0);
+    ExitOnFailure(hr, "Failed to copy string into wrapped table string pool");
+
+    ++pBuilder->cStrings;
+
+    hr = AddPoolString(&pBuilder->stringHash, const_cast<LPCWSTR*>(pBuilder->rgsczStrings), pBuilder->cStrings);
+    ExitOnFailure(hr, "Failed to hash string in wrapped table string pool");
+
+    hr = AddBuilderInteger(pBuilder, static_cast<int>(pBuilder->cStrings - 1));
+
+LExit:
+    return hr;
+}
+
+// Formats all values of one column as a single comma separated field
+static HRESULT FormatBuilderColumn(
+    __in const WCA_WRAPQUERY_BUILDER* pBuilder,
+    __in DWORD dwColumn,
+    __deref_out_z LPWSTR* ppwzColumn
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzEnd = NULL;
+    size_t cchRemaining = 0;
+
+    hr = StrAlloc(ppwzColumn, static_cast<SIZE_T>(pBuilder->cRows) * 12 + 1);
+    ExitOnFailure(hr, "Failed to allocate column %u data", dwColumn + 1);
+
+    pwzEnd = *ppwzColumn;
+    cchRemaining = static_cast<size_t>(pBuilder->cRows) * 12 + 1;
+    *pwzEnd = L'\0';
+
+    for (DWORD i = 0; i < pBuilder->cRows; ++i)
+    {
+        hr = ::StringCchPrintfExW(pwzEnd, cchRemaining, &pwzEnd, &cchRemaining, 0, i ? L",%d" : L"%d", pBuilder->rgiValues[i * pBuilder->cColumns + dwColumn]);
+        ExitOnRootFailure(hr, "Failed to format column %u data", dwColumn + 1);
+    }
+
+LExit:
+    return hr;
+}
+
+static void UninitializeBuilder(
+    __in WCA_WRAPQUERY_BUILDER* pBuilder
+    )
+{
+    ReleasePoolHash(&pBuilder->stringHash);
+
+    for (DWORD i = 0; i < pBuilder->cStrings; ++i)
+    {
+        ReleaseStr(pBuilder->rgsczStrings[i]);
+    }
+    ReleaseMem(pBuilder->rgsczStrings);
+    ReleaseMem(pBuilder->rgiValues);
+}
+
+// Adds a string to an unwrapped query's pool, the string isn't copied until SealStringPool
+static HRESULT AddQueryString(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in_z LPCWSTR wzValue,
+    __in BOOL fDeduplicate,
+    __out DWORD* pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (fDeduplicate && S_OK == FindPoolString(&hWrapQuery->stringHash, hWrapQuery->ppwzStrings, wzValue, pdwIndex))
+    {
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&hWrapQuery->ppwzStrings), hWrapQuery->dwStrings + 1, sizeof(LPCWSTR), max(hWrapQuery->dwStrings, 64UL));
+    ExitOnFailure(hr, "Failed to grow unwrapped query string pool");
+
+    hWrapQuery->ppwzStrings[hWrapQuery->dwStrings] = wzValue;
+    *pdwIndex = hWrapQuery->dwStrings;
+    ++hWrapQuery->dwStrings;
+
+    hr = AddPoolString(&hWrapQuery->stringHash, hWrapQuery->ppwzStrings, hWrapQuery->dwStrings);
+    ExitOnFailure(hr, "Failed to hash string in unwrapped query string pool");
+
+LExit:
+    return hr;
+}
+
+// Copies the pool strings, which still point into the CustomActionData, into a single allocation owned by the query
+static HRESULT SealStringPool(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cchPool = 0;
+    SIZE_T cchString = 0;
+    LPWSTR pwz = NULL;
+
+    for (DWORD i = 0; i < hWrapQuery->dwStrings; ++i)
+    {
+        cchPool += wcslen(hWrapQuery->ppwzStrings[i]) + 1;
+    }
+
+    if (0 == cchPool)
+    {
+        ExitFunction();
+    }
+
+    hr = StrAlloc(&hWrapQuery->pwzStringPool, cchPool);
+    ExitOnFailure(hr, "Failed to allocate unwrapped query string pool");
+
+    pwz = hWrapQuery->pwzStringPool;
+    for (DWORD i = 0; i < hWrapQuery->dwStrings; ++i)
+    {
+        cchString = wcslen(hWrapQuery->ppwzStrings[i]) + 1;
+        memcpy_s(pwz, cchString * sizeof(WCHAR), hWrapQuery->ppwzStrings[i], cchString * sizeof(WCHAR));
+
+        hWrapQuery->ppwzStrings[i] = pwz;
+        pwz += cchString;
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT ReadColumnarValues(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn,
+    __in_z LPCWSTR wzColumnData
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wz = wzColumnData;
+    LPWSTR pwzEnd = NULL;
+    long lValue = 0;
+    int* rgiValues = hWrapQuery->prgiColumnValues[dwColumn];
+
+    for (DWORD i = 0; i < hWrapQuery->dwRows; ++i)
+    {
+        errno = 0;
+        lValue = wcstol(wz, &pwzEnd, 10);
+        if (pwzEnd == wz || ERANGE == errno || (L',' != *pwzEnd && L'\0' != *pwzEnd) || (L'\0' == *pwzEnd && i + 1 != hWrapQuery->dwRows))
+        {
+            hr = E_INVALIDARG;
+            ExitOnFailure(hr, "Failed to read row %u value of column %u from custom action data", i + 1, dwColumn + 1);
+        }
+
+        if (cdtString == hWrapQuery->pcdtColumnType[dwColumn] && (0 > lValue || hWrapQuery->dwStrings <= static_cast<DWORD>(lValue)))
+        {
+            hr = E_INVALIDARG;
+            ExitOnFailure(hr, "Invalid string pool index %ld in row %u of column %u", lValue, i + 1, dwColumn + 1);
+        }
+
+        rgiValues[i] = static_cast<int>(lValue);
+        wz = pwzEnd + 1;
+    }
+
+    if (L'\0' != *pwzEnd)
+    {
+        hr = E_INVALIDARG;
+        ExitOnFailure(hr, "Too many values for column %u in custom action data", dwColumn + 1);
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT CreateRowRecord(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwRow
+    )
+{
+    HRESULT hr = S_OK;
+    MSIHANDLE hRec = ::MsiCreateRecord(hWrapQuery->dwColumns);
+    ExitOnNull(hRec, hr, E_OUTOFMEMORY, "Failed to create record for row %u", dwRow + 1);
+
+    for (DWORD j = 0; j < hWrapQuery->dwColumns; ++j)
+    {
+        switch (hWrapQuery->pcdtColumnType[j])
+        {
+        case cdtString:
+            hr = WcaSetRecordString(hRec, j + 1, hWrapQuery->ppwzStrings[hWrapQuery->prgiColumnValues[j][dwRow]]);
+            ExitOnFailure(hr, "Failed to write string to record in column %u", j + 1);
+            break;
+
+        case cdtInt:
+            hr = WcaSetRecordInteger(hRec, j + 1, hWrapQuery->prgiColumnValues[j][dwRow]);
+            ExitOnFailure(hr, "Failed to write integer %d to record in column %u", hWrapQuery->prgiColumnValues[j][dwRow], j + 1);
+            break;
+
+        default:
+            hr = E_INVALIDARG;
+            ExitOnFailure(hr, "Failed to recognize column type enumeration %d for column %u", hWrapQuery->pcdtColumnType[j], j + 1);
+        }
+    }
+
+    hWrapQuery->phRecords[dwRow] = hRec;
+    hRec = NULL;
+
+LExit:
+    if (hRec)
+    {
+        ::MsiCloseHandle(hRec);
+    }
+
+    return hr;
+}
+
+// Chains the rows of a string column by string pool index, in row order, so lookups only visit matching rows
+static HRESULT EnsureColumnLookup(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD* rgdwFirstRow = NULL;
+    DWORD* rgdwNextRow = NULL;
+    DWORD dwString = 0;
+
+    if (hWrapQuery->prgdwFirstRow[dwColumn])
+    {
+        ExitFunction();
+    }
+
+    rgdwFirstRow = static_cast<DWORD*>(MemAlloc(hWrapQuery->dwStrings * sizeof(DWORD), TRUE));
+    ExitOnNull(rgdwFirstRow, hr, E_OUTOFMEMORY, "Failed to allocate lookup table for column %u", dwColumn + 1);
+
+    rgdwNextRow = static_cast<DWORD*>(MemAlloc(hWrapQuery->dwRows * sizeof(DWORD), TRUE));
+    ExitOnNull(rgdwNextRow, hr, E_OUTOFMEMORY, "Failed to allocate lookup chain for column %u", dwColumn + 1);
+
+    for (DWORD i = hWrapQuery->dwRows; i > 0; --i)
+    {
+        dwString = static_cast<DWORD>(hWrapQuery->prgiColumnValues[dwColumn][i - 1]);
+
+        rgdwNextRow[i - 1] = rgdwFirstRow[dwString];
+        rgdwFirstRow[dwString] = i;
+    }
+
+    hWrapQuery->prgdwFirstRow[dwColumn] = rgdwFirstRow;
+    hWrapQuery->prgdwNextRow[dwColumn] = rgdwNextRow;
+    rgdwFirstRow = NULL;
+    rgdwNextRow = NULL;
+
+LExit:
+    ReleaseMem(rgdwFirstRow);
+    ReleaseMem(rgdwNextRow);
+
+    return hr;
+}
+
 HRESULT WIXAPI WcaWrapEmptyQuery(
     __inout LPWSTR * ppwzCustomActionData
     )
@@ -150,6 +562,8 @@ LExit:
 WcaWrapQuery() - wraps a view and transmits it through the
                 CustomActionData property
 
+NOTE: the table is written column by column, with every distinct string
+      stored once in a string pool that the string columns index into
 ********************************************************************/
 HRESULT WIXAPI WcaWrapQuery(
     __in_z LPCWSTR pwzQuery,
@@ -165,10 +579,9 @@ HRESULT WIXAPI WcaWrapQuery(
     UINT cViewColumns;
     eColumnDataType *pcdtColumnTypeList = NULL;
     LPWSTR pwzData = NULL;
-    LPWSTR pwzColumnData = NULL;
-    LPWSTR pwzRecordData = NULL;
-    BYTE* pbData = NULL;
-    DWORD dwNumRecords = 0;
+    WCA_CADATA_WRITER columnWriter = { };
+    WCA_CADATA_WRITER tableWriter = { };
+    WCA_WRAPQUERY_BUILDER builder = { };
     BOOL fAddComponentState = FALSE; // Add two integer columns to the right side of the query - ISInstalled, and ISAction
     BOOL fAddDirectoryPath = FALSE; // Add two string columns to the right side of the query - SourcePath, and TargetPath
     int iTempInteger = 0;
@@ -187,9 +600,6 @@ HRESULT WIXAPI WcaWrapQuery(
     hr = WcaOpenExecuteView(pwzQuery, &hView);
     ExitOnFailure(hr, "Failed to execute view");
 
-    hr = WcaWriteIntegerToCaData(static_cast<int>(wqaTableBegin), ppwzCustomActionData);
-    ExitOnFailure(hr, "Failed to write table begin marker to custom action data");
-
 //  WcaLog(LOGMSG_TRACEONLY, "Starting to wrap table's column information", pwzQuery);
 
     // Use GetColumnInfo to populate the names of the columns.
@@ -228,11 +638,13 @@ HRESULT WIXAPI WcaWrapQuery(
         ExitOnFailure(hr, "Directory column %d out of range", dwDirectoryColumn);
     }
 
-    hr = WcaWriteIntegerToCaData(static_cast<int>(cViewColumns) + 2 * static_cast<int>(fAddComponentState) + 2 * static_cast<int>(fAddDirectoryPath), ppwzCustomActionData);
-    ExitOnFailure(hr, "Failed to write number of columns to custom action data");
+    builder.cColumns = cViewColumns + 2 * static_cast<DWORD>(fAddComponentState) + 2 * static_cast<DWORD>(fAddDirectoryPath);
 
-    pcdtColumnTypeList = new eColumnDataType[cViewColumns];
-    ExitOnNull(pcdtColumnTypeList, hr, E_OUTOFMEMORY, "Failed to allocate memory to store column info types");
+    if (0 != cViewColumns)
+    {
+        pcdtColumnTypeList = static_cast<eColumnDataType *>(MemAlloc(cViewColumns * sizeof(eColumnDataType), TRUE));
+        ExitOnNull(pcdtColumnTypeList, hr, E_OUTOFMEMORY, "Failed to allocate memory to store column info types");
+    }
 
     // Loop through all the columns reporting information about each one
     for (DWORD i = 0; i < cViewColumns; i++)
@@ -240,7 +652,7 @@ HRESULT WIXAPI WcaWrapQuery(
         hr = WcaGetRecordString(hColumnNames, i+1, &pwzData);
         ExitOnFailure(hr, "Failed to get the column %d name", i+1);
 
-        hr = WcaWriteStringToCaData(pwzData, &pwzColumnData);
+        hr = WcaCaDataWriteString(&columnWriter, pwzData);
         ExitOnFailure(hr, "Failed to write column %d name %ls to custom action data", i+1, pwzData);
 
         hr = WcaGetRecordString(hColumnTypes, i+1, &pwzData);
@@ -254,38 +666,38 @@ HRESULT WIXAPI WcaWrapQuery(
             ExitOnFailure(hr, "Failed to recognize column %d type string: %ls", i+1, pwzData);
         }
 
-        hr = WcaWriteIntegerToCaData(pcdtColumnTypeList[i], &pwzColumnData);
+        hr = WcaCaDataWriteInteger(&columnWriter, pcdtColumnTypeList[i]);
         ExitOnFailure(hr, "Failed to write column %d type enumeration to custom action data", i+1);
     }
 
     // Add two integer columns to the right side of the query - ISInstalled, and ISAction
     if (fAddComponentState)
     {
-        hr = WcaWriteStringToCaData(ISINSTALLEDCOLUMNNAME, &pwzColumnData);
+        hr = WcaCaDataWriteString(&columnWriter, ISINSTALLEDCOLUMNNAME);
         ExitOnFailure(hr, "Failed to write extra column %d name %ls to custom action data", cViewColumns + 1, ISINSTALLEDCOLUMNNAME);
 
-        hr = WcaWriteIntegerToCaData(cdtInt, &pwzColumnData);
+        hr = WcaCaDataWriteInteger(&columnWriter, cdtInt);
         ExitOnFailure(hr, "Failed to write extra column %d type to custom action data", cViewColumns + 1);
 
-        hr = WcaWriteStringToCaData(ISACTIONCOLUMNNAME, &pwzColumnData);
+        hr = WcaCaDataWriteString(&columnWriter, ISACTIONCOLUMNNAME);
         ExitOnFailure(hr, "Failed to write extra column %d name %ls to custom action data", cViewColumns + 1, ISACTIONCOLUMNNAME);
 
-        hr = WcaWriteIntegerToCaData(cdtInt, &pwzColumnData);
+        hr = WcaCaDataWriteInteger(&columnWriter, cdtInt);
         ExitOnFailure(hr, "Failed to write extra column %d type to custom action data", cViewColumns + 1);
     }
 
     if (fAddDirectoryPath)
     {
-        hr = WcaWriteStringToCaData(SOURCEPATHCOLUMNNAME, &pwzColumnData);
+        hr = WcaCaDataWriteString(&columnWriter, SOURCEPATHCOLUMNNAME);
         ExitOnFailure(hr, "Failed to write extra column %d name %ls to custom action data", cViewColumns + 1, SOURCEPATHCOLUMNNAME);
 
-        hr = WcaWriteIntegerToCaData(cdtString, &pwzColumnData);
+        hr = WcaCaDataWriteInteger(&columnWriter, cdtString);
         ExitOnFailure(hr, "Failed to write extra column %d type to custom action data", cViewColumns + 1);
 
-        hr = WcaWriteStringToCaData(TARGETPATHCOLUMNNAME, &pwzColumnData);
+        hr = WcaCaDataWriteString(&columnWriter, TARGETPATHCOLUMNNAME);
         ExitOnFailure(hr, "Failed to write extra column %d name %ls to custom action data", cViewColumns + 1, TARGETPATHCOLUMNNAME);
 
-        hr = WcaWriteIntegerToCaData(cdtString, &pwzColumnData);
+        hr = WcaCaDataWriteInteger(&columnWriter, cdtString);
         ExitOnFailure(hr, "Failed to write extra column %d type to custom action data", cViewColumns + 1);
     }
 
@@ -293,9 +705,6 @@ HRESULT WIXAPI WcaWrapQuery(
     //WcaLog(LOGMSG_TRACEONLY, "Starting to wrap table data", pwzQuery);
     while (S_OK == (hr = WcaFetchRecord(hView, &hRec)))
     {
-        hr = WcaWriteIntegerToCaData(static_cast<int>(wqaRowBegin), &pwzRecordData);
-        ExitOnFailure(hr, "Failed to write row begin marker to custom action data");
-
         for (DWORD i = 0; i < cViewColumns; i++)
         {
             switch (pcdtColumnTypeList[i])
@@ -312,8 +721,8 @@ HRESULT WIXAPI WcaWrapQuery(
                 }
                 ExitOnFailure(hr, "Failed to get string for column %d", i + 1);
 
-                hr = WcaWriteStringToCaData(pwzData, &pwzRecordData);
-                ExitOnFailure(hr, "Failed to write string to temporary record custom action data for column %d", i + 1);
+                hr = AddBuilderString(&builder, pwzData);
+                ExitOnFailure(hr, "Failed to add string to wrapped table for column %d", i + 1);
                 break;
 
             case cdtInt:
@@ -327,8 +736,8 @@ HRESULT WIXAPI WcaWrapQuery(
                 }
                 ExitOnFailure(hr, "Failed to get integer for column %d", i + 1);
 
-                hr = WcaWriteIntegerToCaData(iTempInteger, &pwzRecordData);
-                ExitOnFailure(hr, "Failed to write integer to temporary record custom action data for column %d", i + 1);
+                hr = AddBuilderInteger(&builder, iTempInteger);
+                ExitOnFailure(hr, "Failed to add integer to wrapped table for column %d", i + 1);
                 break;
 
             case cdtStream:
@@ -366,11 +775,11 @@ HRESULT WIXAPI WcaWrapQuery(
                 }
             }
 
-            hr = WcaWriteIntegerToCaData(isInstalled, &pwzRecordData);
-            ExitOnFailure(hr, "Failed to write extra ISInstalled column to custom action data");
+            hr = AddBuilderInteger(&builder, isInstalled);
+            ExitOnFailure(hr, "Failed to add extra ISInstalled column to wrapped table");
 
-            hr = WcaWriteIntegerToCaData(isAction, &pwzRecordData);
-            ExitOnFailure(hr, "Failed to write extra ISAction column to custom action data");
+            hr = AddBuilderInteger(&builder, isAction);
+            ExitOnFailure(hr, "Failed to add extra ISAction column to wrapped table");
         }
 
         // Add two string columns to the right side of the query - SourcePath, and TargetPath
@@ -392,21 +801,13 @@ HRESULT WIXAPI WcaWrapQuery(
                         ExitOnRootFailure(hr, "Failed to record entire Source Path for Directory %ls because its length was greater than MAX_PATH.", pwzData);
                     }
 
-                    if (SUCCEEDED(hrTemp))
-                    {
-                        hr = WcaWriteStringToCaData(wzPath, &pwzRecordData);
-                        ExitOnFailure(hr, "Failed to write source path string to record data string");
-                    }
-                    else
-                    {
-                        hr = WcaWriteStringToCaData(L"", &pwzRecordData);
-                        ExitOnFailure(hr, "Failed to write empty source path string to record data string");
-                    }
+                    hr = AddBuilderString(&builder, SUCCEEDED(hrTemp) ? wzPath : L"");
+                    ExitOnFailure(hr, "Failed to add source path string to wrapped table");
                 }
                 else
                 {
-                    hr = WcaWriteStringToCaData(L"", &pwzRecordData);
-                    ExitOnFailure(hr, "Failed to write empty source path string before writing target path string to record data string");
+                    hr = AddBuilderString(&builder, L"");
+                    ExitOnFailure(hr, "Failed to add empty source path string before adding target path string to wrapped table");
                 }
 
                 dwLen = countof(wzPath);
@@ -417,57 +818,74 @@ HRESULT WIXAPI WcaWrapQuery(
                     hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
                     ExitOnRootFailure(hr, "Failed to record entire Source Path for Directory %ls because its length was greater than MAX_PATH.", pwzData);
                 }
-                if (SUCCEEDED(hrTemp))
-                {
-                    hr = WcaWriteStringToCaData(wzPath, &pwzRecordData);
-                    ExitOnFailure(hr, "Failed to write target path string to record data string");
-                }
-                else
-                {
-                    hr = WcaWriteStringToCaData(L"", &pwzRecordData);
-                    ExitOnFailure(hr, "Failed to write empty target path string to record data string");
-                }
+
+                hr = AddBuilderString(&builder, SUCCEEDED(hrTemp) ? wzPath : L"");
+                ExitOnFailure(hr, "Failed to add target path string to wrapped table");
             }
             else
             {
                 // Write both fields as blank
-                hr = WcaWriteStringToCaData(L"", &pwzRecordData);
-                hr = WcaWriteStringToCaData(L"", &pwzRecordData);
+                hr = AddBuilderString(&builder, L"");
+                ExitOnFailure(hr, "Failed to add empty source path string to wrapped table");
+
+                hr = AddBuilderString(&builder, L"");
+                ExitOnFailure(hr, "Failed to add empty target path string to wrapped table");
             }
         }
 
-        hr = WcaWriteIntegerToCaData(static_cast<int>(wqaRowFinish), &pwzRecordData);
-        ExitOnFailure(hr, "Failed to write row finish marker to custom action data");
-
-        ++dwNumRecords;
+        ++builder.cRows;
     }
 
-    hr = WcaWriteIntegerToCaData(dwNumRecords, ppwzCustomActionData);
+    hr = WcaCaDataWriteInteger(&tableWriter, static_cast<int>(wqaColumnarTableBegin));
+    ExitOnFailure(hr, "Failed to write table begin marker to custom action data");
+
+    hr = WcaCaDataWriteInteger(&tableWriter, static_cast<int>(builder.cColumns));
+    ExitOnFailure(hr, "Failed to write number of columns to custom action data");
+
+    hr = WcaCaDataWriteInteger(&tableWriter, static_cast<int>(builder.cRows));
     ExitOnFailure(hr, "Failed to write number of records to custom action data");
 
-    if (NULL != pwzColumnData)
+    if (NULL != columnWriter.pwzData)
     {
-        hr = WcaWriteStringToCaData(pwzColumnData, ppwzCustomActionData);
+        hr = WcaCaDataWriteString(&tableWriter, columnWriter.pwzData);
         ExitOnFailure(hr, "Failed to write column data to custom action data");
     }
 
-    if (NULL != pwzRecordData)
+    hr = WcaCaDataWriteInteger(&tableWriter, static_cast<int>(builder.cStrings));
+    ExitOnFailure(hr, "Failed to write number of pooled strings to custom action data");
+
+    for (DWORD i = 0; i < builder.cStrings; ++i)
     {
-        hr = WcaWriteStringToCaData(pwzRecordData, ppwzCustomActionData);
-        ExitOnFailure(hr, "Failed to write record data to custom action data");
+        hr = WcaCaDataWriteString(&tableWriter, builder.rgsczStrings[i]);
+        ExitOnFailure(hr, "Failed to write pooled string %u to custom action data", i + 1);
     }
 
-    hr = WcaWriteIntegerToCaData(static_cast<int>(wqaTableFinish), ppwzCustomActionData);
+    if (0 != builder.cRows)
+    {
+        for (DWORD i = 0; i < builder.cColumns; ++i)
+        {
+            hr = FormatBuilderColumn(&builder, i, &pwzData);
+            ExitOnFailure(hr, "Failed to format column %u data", i + 1);
+
+            hr = WcaCaDataWriteString(&tableWriter, pwzData);
+            ExitOnFailure(hr, "Failed to write column %u data to custom action data", i + 1);
+        }
+    }
+
+    hr = WcaCaDataWriteInteger(&tableWriter, static_cast<int>(wqaTableFinish));
     ExitOnFailure(hr, "Failed to write table finish marker to custom action data");
 
+    hr = WcaWriteStringToCaData(tableWriter.pwzData, ppwzCustomActionData);
+    ExitOnFailure(hr, "Failed to write wrapped table to custom action data");
+
 //  WcaLog(LOGMSG_TRACEONLY, "Finished wrapping result of query: \"%ls\"", pwzQuery);
 
 LExit:
     ReleaseStr(pwzData);
-    ReleaseStr(pwzColumnData);
-    ReleaseStr(pwzRecordData);
-
-    ReleaseMem(pbData);
+    ReleaseMem(pcdtColumnTypeList);
+    WcaCaDataWriterUninitialize(&columnWriter);
+    WcaCaDataWriterUninitialize(&tableWriter);
+    UninitializeBuilder(&builder);
 
     return hr;
 }
@@ -477,6 +895,8 @@ LExit:
 WcaBeginUnwrapQuery() - unwraps a view for direct access from the
                         CustomActionData property
 
+NOTE: reads both the columnar format written by WcaWrapQuery and the
+      row by row format written by earlier versions
 ********************************************************************/
 HRESULT WIXAPI WcaBeginUnwrapQuery(
     __out WCA_WRAPQUERY_HANDLE * phWrapQuery,
@@ -487,19 +907,23 @@ HRESULT WIXAPI WcaBeginUnwrapQuery(
     int iTempInteger = 0;
     int iColumns = 0;
     int iRows = 0;
-    BYTE* pbData = NULL;
-    LPWSTR pwzData = NULL;
+    int iStrings = 0;
+    BOOL fColumnar = FALSE;
+    DWORD dwString = 0;
+    LPCWSTR wzData = NULL;
     WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
 
     WcaLog(LOGMSG_TRACEONLY, "Unwrapping a query from custom action data");
 
     hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
-    if (wqaTableBegin != iTempInteger)
+    if (wqaTableBegin != iTempInteger && wqaColumnarTableBegin != iTempInteger)
     {
         hr = E_INVALIDARG;
     }
     ExitOnFailure(hr, "Failed to read table begin marker from custom action data (read %d instead)", iTempInteger);
 
+    fColumnar = wqaColumnarTableBegin == iTempInteger;
+
     hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iColumns);
     ExitOnFailure(hr, "Failed to read number of columns from custom action data");
 
@@ -527,57 +951,83 @@ HRESULT WIXAPI WcaBeginUnwrapQuery(
 
         // Set the column type into the actual data structure
         hWrapQuery->pcdtColumnType[i] = (eColumnDataType)iTempInteger;
+
+        if (cdtStream == iTempInteger && 0 != iRows)
+        {
+            hr = E_NOTIMPL;
+            ExitOnFailure(hr, "A query was wrapped which contained a stream data field - however, the ability to wrap stream data fields is not implemented at this time");
+        }
     }
 
-    for (int i = 0; i < iRows; i++)
+    if (fColumnar)
     {
-        hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
-        if (wqaRowBegin != iTempInteger)
+        hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iStrings);
+        ExitOnFailure(hr, "Failed to read number of pooled strings from custom action data");
+
+        for (int i = 0; i < iStrings; i++)
         {
-            hr = E_INVALIDARG;
+            hr = WcaReadStringViewFromCaData(ppwzCustomActionData, &wzData);
+            ExitOnFailure(hr, "Failed to read pooled string %d from custom action data", i+1);
+
+            hr = AddQueryString(hWrapQuery, wzData, FALSE, &dwString);
+            ExitOnFailure(hr, "Failed to add pooled string %d to query", i+1);
         }
-        ExitOnFailure(hr, "Failed to read begin row marker from custom action data (read %d instead)", iTempInteger);
 
-        hWrapQuery->phRecords[i] = ::MsiCreateRecord((unsigned int)iColumns);
+        for (int j = 0; j < iColumns && 0 != iRows; j++)
+        {
+            hr = WcaReadStringViewFromCaData(ppwzCustomActionData, &wzData);
+            ExitOnFailure(hr, "Failed to read column %d's values from custom action data", j+1);
 
-        for (int j = 0; j < iColumns; j++)
+            hr = ReadColumnarValues(hWrapQuery, j, wzData);
+            ExitOnFailure(hr, "Failed to parse column %d's values", j+1);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < iRows; i++)
         {
-            switch (hWrapQuery->pcdtColumnType[j])
+            hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
+            if (wqaRowBegin != iTempInteger)
             {
-            case cdtString:
-                hr = WcaReadStringFromCaData(ppwzCustomActionData, &pwzData);
-                ExitOnFailure(hr, "Failed to read string from custom action data");
+                hr = E_INVALIDARG;
+            }
+            ExitOnFailure(hr, "Failed to read begin row marker from custom action data (read %d instead)", iTempInteger);
 
-                hr = WcaSetRecordString(hWrapQuery->phRecords[i], j+1, pwzData);
-                ExitOnFailure(hr, "Failed to write string %ls to record in column %d", pwzData, j+1);
-                break;
+            for (int j = 0; j < iColumns; j++)
+            {
+                switch (hWrapQuery->pcdtColumnType[j])
+                {
+                case cdtString:
+                    hr = WcaReadStringViewFromCaData(ppwzCustomActionData, &wzData);
+                    ExitOnFailure(hr, "Failed to read string from custom action data");
 
-            case cdtInt:
-                WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
-                ExitOnFailure(hr, "Failed to read integer from custom action data");
+                    hr = AddQueryString(hWrapQuery, wzData, TRUE, &dwString);
+                    ExitOnFailure(hr, "Failed to add string %ls to query in column %d", wzData, j+1);
 
-                WcaSetRecordInteger(hWrapQuery->phRecords[i], j+1, iTempInteger);
-                ExitOnFailure(hr, "Failed to write integer %d to record in column %d", iTempInteger, j+1);
-                break;
+                    hWrapQuery->prgiColumnValues[j][i] = static_cast<int>(dwString);
+                    break;
 
-            case cdtStream:
-                hr = E_NOTIMPL;
-                ExitOnFailure(hr, "A query was wrapped which contained a stream data field - however, the ability to wrap stream data fields is not implemented at this time");
-                break;
+                case cdtInt:
+                    hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
+                    ExitOnFailure(hr, "Failed to read integer from custom action data");
 
-            case cdtUnknown:
-            default:
-                hr = E_INVALIDARG;
-                ExitOnFailure(hr, "Failed to recognize column type enumeration %d for column %d", hWrapQuery->pcdtColumnType[j+1], i+1);
+                    hWrapQuery->prgiColumnValues[j][i] = iTempInteger;
+                    break;
+
+                case cdtUnknown:
+                default:
+                    hr = E_INVALIDARG;
+                    ExitOnFailure(hr, "Failed to recognize column type enumeration %d for column %d", hWrapQuery->pcdtColumnType[j], j+1);
+                }
             }
-        }
 
-        hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
-        if (wqaRowFinish != iTempInteger)
-        {
-            hr = E_INVALIDARG;
+            hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
+            if (wqaRowFinish != iTempInteger)
+            {
+                hr = E_INVALIDARG;
+            }
+            ExitOnFailure(hr, "Failed to read row finish marker from custom action data (read %d instead)", iTempInteger);
         }
-        ExitOnFailure(hr, "Failed to read row finish marker from custom action data (read %d instead)", iTempInteger);
     }
 
     hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iTempInteger);
@@ -587,13 +1037,19 @@ HRESULT WIXAPI WcaBeginUnwrapQuery(
     }
     ExitOnFailure(hr, "Failed to read table finish marker from custom action data (read %d instead)", iTempInteger);
 
+    hr = SealStringPool(hWrapQuery);
+    ExitOnFailure(hr, "Failed to copy query strings out of custom action data");
+
     *phWrapQuery = hWrapQuery;
+    hWrapQuery = NULL;
 
 //  WcaLog(LOGMSG_TRACEONLY, "Successfully finished unwrapping a query from custom action data");
 
 LExit:
-    ReleaseStr(pwzData);
-    ReleaseMem(pbData);
+    if (NULL != hWrapQuery)
+    {
+        WcaFinishUnwrapQuery(hWrapQuery);
+    }
 
     return hr;
 }
@@ -622,6 +1078,7 @@ HRESULT WIXAPI WcaFetchWrappedRecord(
     __out MSIHANDLE* phRec
     )
 {
+    HRESULT hr = S_OK;
     DWORD dwNextIndex = hWrapQuery->dwNextIndex;
 
     if (dwNextIndex >= hWrapQuery->dwRows)
@@ -631,7 +1088,11 @@ HRESULT WIXAPI WcaFetchWrappedRecord(
 
     if (NULL == hWrapQuery->phRecords[dwNextIndex])
     {
-        return E_HANDLE;
+        hr = CreateRowRecord(hWrapQuery, dwNextIndex);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
     }
 
     *phRec = hWrapQuery->phRecords[hWrapQuery->dwNextIndex];
@@ -655,6 +1116,43 @@ HRESULT WIXAPI WcaFetchWrappedRecordWhereString(
     HRESULT hr = S_OK;
     MSIHANDLE hRec = NULL;
     LPWSTR pwzData = NULL;
+    DWORD dwString = 0;
+    DWORD dwRow = 0;
+
+    if (hWrapQuery->dwNextIndex >= hWrapQuery->dwRows)
+    {
+        ExitFunction1(hr = E_NOMOREITEMS);
+    }
+
+    // String columns are looked up through the string pool, anything else is compared record by record
+    if (0 != dwComparisonColumn && dwComparisonColumn <= hWrapQuery->dwColumns && cdtString == hWrapQuery->pcdtColumnType[dwComparisonColumn - 1])
+    {
+        hr = EnsureColumnLookup(hWrapQuery, dwComparisonColumn - 1);
+        ExitOnFailure(hr, "Failed to build lookup table for column %d", dwComparisonColumn);
+
+        if (S_OK == FindPoolString(&hWrapQuery->stringHash, hWrapQuery->ppwzStrings, pwzExpectedValue, &dwString))
+        {
+            // Skip matches before the current position, so repeated calls walk through every matching row in order
+            dwRow = hWrapQuery->prgdwFirstRow[dwComparisonColumn - 1][dwString];
+            while (0 != dwRow && dwRow - 1 < hWrapQuery->dwNextIndex)
+            {
+                dwRow = hWrapQuery->prgdwNextRow[dwComparisonColumn - 1][dwRow - 1];
+            }
+        }
+
+        if (0 == dwRow)
+        {
+            hWrapQuery->dwNextIndex = hWrapQuery->dwRows;
+            ExitFunction1(hr = E_NOMOREITEMS);
+        }
+
+        hWrapQuery->dwNextIndex = dwRow - 1;
+
+        hr = WcaFetchWrappedRecord(hWrapQuery, phRec);
+        ExitOnFailure(hr, "Failed to fetch a wrapped record");
+
+        ExitFunction();
+    }
 
     while (S_OK == (hr = WcaFetchWrappedRecord(hWrapQuery, &hRec)))
     {
@@ -704,9 +1202,34 @@ void WIXAPI WcaFinishUnwrapQuery(
     }
     ReleaseMem(hWrapQuery->ppwzColumnNames);
 
+    for (DWORD i=0;i<hWrapQuery->dwColumns;i++)
+    {
+        if (hWrapQuery->prgiColumnValues)
+        {
+            ReleaseMem(hWrapQuery->prgiColumnValues[i]);
+        }
+
+        if (hWrapQuery->prgdwFirstRow)
+        {
+            ReleaseMem(hWrapQuery->prgdwFirstRow[i]);
+        }
+
+        if (hWrapQuery->prgdwNextRow)
+        {
+            ReleaseMem(hWrapQuery->prgdwNextRow[i]);
+        }
+    }
+    ReleaseMem(hWrapQuery->prgiColumnValues);
+    ReleaseMem(hWrapQuery->prgdwFirstRow);
+    ReleaseMem(hWrapQuery->prgdwNextRow);
+
+    ReleasePoolHash(&hWrapQuery->stringHash);
+    ReleaseMem(hWrapQuery->ppwzStrings);
+    ReleaseStr(hWrapQuery->pwzStringPool);
+
     for (DWORD i=0;i<hWrapQuery->dwRows;i++)
     {
-        if (NULL != hWrapQuery->phRecords[i])
+        if (hWrapQuery->phRecords && NULL != hWrapQuery->phRecords[i])
         {
             ::MsiCloseHandle(hWrapQuery->phRecords[i]);
         }
@@ -0,0 +1,165 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+static LPCWSTR vrgwzTestProperties[] =
+{
+    L"ProductCode", L"{4DA1F2F4-4A29-4E1E-BE43-4B16A7C23F0A}",
+    L"ProductLanguage", L"1033",
+    L"ProductName", L"WcaUtil Test Package",
+    L"ProductVersion", L"1.0.0.0",
+    L"Manufacturer", L"WiX Toolset",
+};
+
+
+HRESULT WcaTestCreatePackage(
+    __in_z LPCWSTR wzPackagePath,
+    __out MSIHANDLE* phDatabase
+    )
+{
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+    MSIHANDLE hDatabase = NULL;
+    MSIHANDLE hSummaryInfo = NULL;
+    MSIHANDLE hRecord = NULL;
+    WCHAR wzPackageCode[39] = { };
+    GUID guid = { };
+
+    er = ::MsiOpenDatabaseW(wzPackagePath, MSIDBOPEN_CREATE, &hDatabase);
+    ExitOnWin32Error(er, hr, "Failed to create test package: %ls", wzPackagePath);
+
+    hr = WcaTestExecuteQuery(hDatabase, L"CREATE TABLE `Property` (`Property` CHAR(72) NOT NULL, `Value` LONGCHAR NOT NULL PRIMARY KEY `Property`)", NULL);
+    ExitOnFailure(hr, "Failed to create Property table.");
+
+    hRecord = ::MsiCreateRecord(2);
+    ExitOnNull(hRecord, hr, E_OUTOFMEMORY, "Failed to create Property record.");
+
+    for (DWORD i = 0; i < countof(vrgwzTestProperties); i += 2)
+    {
+        ::MsiRecordSetStringW(hRecord, 1, vrgwzTestProperties[i]);
+        ::MsiRecordSetStringW(hRecord, 2, vrgwzTestProperties[i + 1]);
+
+        hr = WcaTestExecuteQuery(hDatabase, L"INSERT INTO `Property` (`Property`, `Value`) VALUES (?, ?)", hRecord);
+        ExitOnFailure(hr, "Failed to add property: %ls", vrgwzTestProperties[i]);
+    }
+
+    hr = ::CoCreateGuid(&guid);
+    ExitOnFailure(hr, "Failed to create package code.");
+
+    if (!::StringFromGUID2(guid, wzPackageCode, countof(wzPackageCode)))
+    {
+        ExitWithRootFailure(hr, E_INSUFFICIENT_BUFFER, "Failed to format package code.");
+    }
+
+    er = ::MsiGetSummaryInformationW(hDatabase, NULL, 4, &hSummaryInfo);
+    ExitOnWin32Error(er, hr, "Failed to open summary information.");
+
+    er = ::MsiSummaryInfoSetPropertyW(hSummaryInfo, PID_TEMPLATE, VT_LPSTR, 0, NULL, L"Intel;1033");
+    ExitOnWin32Error(er, hr, "Failed to set summary information template.");
+
+    er = ::MsiSummaryInfoSetPropertyW(hSummaryInfo, PID_REVNUMBER, VT_LPSTR, 0, NULL, wzPackageCode);
+    ExitOnWin32Error(er, hr, "Failed to set summary information package code.");
+
+    er = ::MsiSummaryInfoSetPropertyW(hSummaryInfo, PID_PAGECOUNT, VT_I4, 200, NULL, NULL);
+    ExitOnWin32Error(er, hr, "Failed to set summary information schema.");
+
+    er = ::MsiSummaryInfoSetPropertyW(hSummaryInfo, PID_WORDCOUNT, VT_I4, 2, NULL, NULL);
+    ExitOnWin32Error(er, hr, "Failed to set summary information source type.");
+
+    er = ::MsiSummaryInfoPersist(hSummaryInfo);
+    ExitOnWin32Error(er, hr, "Failed to save summary information.");
+
+    *phDatabase = hDatabase;
+    hDatabase = NULL;
+
+LExit:
+    if (hRecord)
+    {
+        ::MsiCloseHandle(hRecord);
+    }
+
+    if (hSummaryInfo)
+    {
+        ::MsiCloseHandle(hSummaryInfo);
+    }
+
+    if (hDatabase)
+    {
+        ::MsiCloseHandle(hDatabase);
+    }
+
+    return hr;
+}
+
+HRESULT WcaTestExecuteQuery(
+    __in MSIHANDLE hDatabase,
+    __in_z LPCWSTR wzQuery,
+    __in_opt MSIHANDLE hParameters
+    )
+{
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+    MSIHANDLE hView = NULL;
+
+    er = ::MsiDatabaseOpenViewW(hDatabase, wzQuery, &hView);
+    ExitOnWin32Error(er, hr, "Failed to open view: %ls", wzQuery);
+
+    er = ::MsiViewExecute(hView, hParameters);
+    ExitOnWin32Error(er, hr, "Failed to execute view: %ls", wzQuery);
+
+LExit:
+    if (hView)
+    {
+        ::MsiViewClose(hView);
+        ::MsiCloseHandle(hView);
+    }
+
+    return hr;
+}
+
+HRESULT WcaTestOpenSession(
+    __in_z LPCWSTR wzPackagePath,
+    __inout MSIHANDLE* phDatabase,
+    __out MSIHANDLE* phInstall
+    )
+{
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+    MSIHANDLE hInstall = NULL;
+
+    er = ::MsiDatabaseCommit(*phDatabase);
+    ExitOnWin32Error(er, hr, "Failed to commit test package.");
+
+    ::MsiCloseHandle(*phDatabase);
+    *phDatabase = NULL;
+
+    ::MsiSetInternalUI(INSTALLUILEVEL_NONE, NULL);
+
+    er = ::MsiOpenPackageExW(wzPackagePath, MSIOPENPACKAGEFLAGS_IGNOREMACHINESTATE, &hInstall);
+    ExitOnWin32Error(er, hr, "Failed to open session on test package: %ls", wzPackagePath);
+
+    hr = WcaInitialize(hInstall, "WcaTestPackage");
+    ExitOnFailure(hr, "Failed to initialize wcautil.");
+
+    *phInstall = hInstall;
+    hInstall = NULL;
+
+LExit:
+    if (hInstall)
+    {
+        ::MsiCloseHandle(hInstall);
+    }
+
+    return hr;
+}
+
+void WcaTestCloseSession(
+    __in MSIHANDLE hInstall
+    )
+{
+    if (hInstall)
+    {
+        WcaFinalize(ERROR_SUCCESS);
+        ::MsiCloseHandle(hInstall);
+    }
+}
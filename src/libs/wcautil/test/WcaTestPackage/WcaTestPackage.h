@@ -0,0 +1,25 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+// Test package fixture shared by the native custom action unit test projects.
+
+// Creates an empty package with just enough in it to open an install session.
+HRESULT WcaTestCreatePackage(
+    __in_z LPCWSTR wzPackagePath,
+    __out MSIHANDLE* phDatabase
+    );
+HRESULT WcaTestExecuteQuery(
+    __in MSIHANDLE hDatabase,
+    __in_z LPCWSTR wzQuery,
+    __in_opt MSIHANDLE hParameters
+    );
+// Commits and closes the database, then opens a session on the package and initializes wcautil with it.
+HRESULT WcaTestOpenSession(
+    __in_z LPCWSTR wzPackagePath,
+    __inout MSIHANDLE* phDatabase,
+    __out MSIHANDLE* phInstall
+    );
+void WcaTestCloseSession(
+    __in MSIHANDLE hInstall
+    );
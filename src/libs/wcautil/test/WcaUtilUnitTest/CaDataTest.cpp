@@ -0,0 +1,267 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+static const DWORD TEST_FIELD_COUNT = 2000;
+
+// Matches the private MAGIC_MULTISZ_DELIM wcautil separates CustomActionData fields with.
+static const WCHAR TEST_CADATA_DELIM = 128;
+
+static const BYTE vrgbTestStream[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF, 0x42 };
+
+namespace WcaUtilTests
+{
+    public ref class CaData
+    {
+    public:
+        [Fact]
+        void CaDataWriterRoundTripsFieldsTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            WCA_CADATA_WRITER writer = { };
+            LPWSTR pwzCustomActionData = NULL;
+            LPWSTR sczValue = NULL;
+            LPCWSTR wzValue = NULL;
+            BYTE* pbStream = NULL;
+            DWORD_PTR cbStream = 0;
+            int iValue = 0;
+
+            try
+            {
+                hInstall = OpenCaDataTestSession(packagePath);
+
+                hr = WcaCaDataWriteString(&writer, L"");
+                NativeAssert::Succeeded(hr, "Failed to write empty string.");
+
+                hr = WcaCaDataWriteString(&writer, L"First");
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                hr = WcaCaDataWriteInteger(&writer, -42);
+                NativeAssert::Succeeded(hr, "Failed to write integer.");
+
+                hr = WcaCaDataWriteStream(&writer, vrgbTestStream, sizeof(vrgbTestStream));
+                NativeAssert::Succeeded(hr, "Failed to write stream.");
+
+                hr = WcaCaDataWriteString(&writer, L"Last");
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                Assert::Equal<DWORD>(5, writer.cFields);
+                Assert::Equal<SIZE_T>(wcslen(writer.pwzData), writer.cchData);
+
+                pwzCustomActionData = writer.pwzData;
+
+                hr = WcaReadStringViewFromCaData(&pwzCustomActionData, &wzValue);
+                NativeAssert::Succeeded(hr, "Failed to read empty string.");
+                NativeAssert::StringEqual(L"", wzValue);
+
+                hr = WcaReadStringFromCaData(&pwzCustomActionData, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to read string.");
+                NativeAssert::StringEqual(L"First", sczValue);
+
+                hr = WcaReadIntegerFromCaData(&pwzCustomActionData, &iValue);
+                NativeAssert::Succeeded(hr, "Failed to read integer.");
+                Assert::Equal(-42, iValue);
+
+                hr = WcaReadStreamFromCaData(&pwzCustomActionData, &pbStream, &cbStream);
+                NativeAssert::Succeeded(hr, "Failed to read stream.");
+                Assert::Equal<DWORD_PTR>(sizeof(vrgbTestStream), cbStream);
+                Assert::True(0 == memcmp(vrgbTestStream, pbStream, sizeof(vrgbTestStream)));
+
+                hr = WcaReadStringViewFromCaData(&pwzCustomActionData, &wzValue);
+                NativeAssert::Succeeded(hr, "Failed to read string.");
+                NativeAssert::StringEqual(L"Last", wzValue);
+
+                hr = WcaReadStringViewFromCaData(&pwzCustomActionData, &wzValue);
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+            }
+            finally
+            {
+                ReleaseMem(pbStream);
+                ReleaseStr(sczValue);
+                WcaCaDataWriterUninitialize(&writer);
+                CloseCaDataTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void CaDataWriterMatchesLegacyWriterTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            WCA_CADATA_WRITER writer = { };
+            LPWSTR sczLegacy = NULL;
+
+            try
+            {
+                hInstall = OpenCaDataTestSession(packagePath);
+
+                hr = WcaCaDataWriteString(&writer, L"Component");
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+                hr = WcaWriteStringToCaData(L"Component", &sczLegacy);
+                NativeAssert::Succeeded(hr, "Failed to write legacy string.");
+
+                hr = WcaCaDataWriteInteger(&writer, 12345);
+                NativeAssert::Succeeded(hr, "Failed to write integer.");
+                hr = WcaWriteIntegerToCaData(12345, &sczLegacy);
+                NativeAssert::Succeeded(hr, "Failed to write legacy integer.");
+
+                hr = WcaCaDataWriteString(&writer, L"");
+                NativeAssert::Succeeded(hr, "Failed to write empty string.");
+                hr = WcaWriteStringToCaData(L"", &sczLegacy);
+                NativeAssert::Succeeded(hr, "Failed to write legacy empty string.");
+
+                hr = WcaCaDataWriteStream(&writer, vrgbTestStream, sizeof(vrgbTestStream));
+                NativeAssert::Succeeded(hr, "Failed to write stream.");
+                hr = WcaWriteStreamToCaData(vrgbTestStream, sizeof(vrgbTestStream), &sczLegacy);
+                NativeAssert::Succeeded(hr, "Failed to write legacy stream.");
+
+                NativeAssert::StringEqual(sczLegacy, writer.pwzData);
+            }
+            finally
+            {
+                ReleaseStr(sczLegacy);
+                WcaCaDataWriterUninitialize(&writer);
+                CloseCaDataTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void LegacyWriterAppendsManyFieldsTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            LPWSTR sczCustomActionData = NULL;
+            LPWSTR pwzCustomActionData = NULL;
+            int iValue = 0;
+
+            try
+            {
+                hInstall = OpenCaDataTestSession(packagePath);
+
+                for (DWORD i = 0; i < TEST_FIELD_COUNT; ++i)
+                {
+                    hr = WcaWriteIntegerToCaData(static_cast<int>(i), &sczCustomActionData);
+                    NativeAssert::Succeeded(hr, "Failed to write integer.");
+                }
+
+                pwzCustomActionData = sczCustomActionData;
+                for (DWORD i = 0; i < TEST_FIELD_COUNT; ++i)
+                {
+                    hr = WcaReadIntegerFromCaData(&pwzCustomActionData, &iValue);
+                    NativeAssert::Succeeded(hr, "Failed to read integer.");
+                    Assert::Equal(static_cast<int>(i), iValue);
+                }
+
+                hr = WcaReadIntegerFromCaData(&pwzCustomActionData, &iValue);
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+            }
+            finally
+            {
+                ReleaseStr(sczCustomActionData);
+                CloseCaDataTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void LegacyWriterHandlesResetAndInterleavedBuffersTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            LPWSTR sczFirst = NULL;
+            LPWSTR sczSecond = NULL;
+            LPWSTR sczExpected = NULL;
+
+            try
+            {
+                hInstall = OpenCaDataTestSession(packagePath);
+
+                hr = WcaWriteStringToCaData(L"Alpha", &sczFirst);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+                hr = WcaWriteStringToCaData(L"Beta", &sczFirst);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                // Callers reuse a buffer between deferred actions by truncating it in place.
+                *sczFirst = L'\0';
+
+                hr = WcaWriteStringToCaData(L"Gamma", &sczFirst);
+                NativeAssert::Succeeded(hr, "Failed to write string after reset.");
+
+                hr = StrAllocString(&sczExpected, L"Gamma", 0);
+                NativeAssert::Succeeded(hr, "Failed to copy expected string.");
+                NativeAssert::StringEqual(sczExpected, sczFirst);
+
+                // Writing to two buffers in turn must not let one buffer's end leak into the other.
+                hr = WcaWriteStringToCaData(L"One", &sczSecond);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+                hr = WcaWriteStringToCaData(L"Delta", &sczFirst);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+                hr = WcaWriteStringToCaData(L"Two", &sczSecond);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+                hr = WcaWriteStringToCaData(L"Epsilon", &sczFirst);
+                NativeAssert::Succeeded(hr, "Failed to write string.");
+
+                hr = StrAllocFormatted(&sczExpected, L"Gamma%cDelta%cEpsilon", TEST_CADATA_DELIM, TEST_CADATA_DELIM);
+                NativeAssert::Succeeded(hr, "Failed to format expected data.");
+                NativeAssert::StringEqual(sczExpected, sczFirst);
+
+                hr = StrAllocFormatted(&sczExpected, L"One%cTwo", TEST_CADATA_DELIM);
+                NativeAssert::Succeeded(hr, "Failed to format expected data.");
+                NativeAssert::StringEqual(sczExpected, sczSecond);
+            }
+            finally
+            {
+                ReleaseStr(sczExpected);
+                ReleaseStr(sczSecond);
+                ReleaseStr(sczFirst);
+                CloseCaDataTestSession(hInstall, packagePath);
+            }
+        }
+
+    private:
+        MSIHANDLE OpenCaDataTestSession(String^ packagePath)
+        {
+            HRESULT hr = S_OK;
+            pin_ptr<const WCHAR> wzPackagePath = PtrToStringChars(packagePath);
+            MSIHANDLE hDatabase = NULL;
+            MSIHANDLE hInstall = NULL;
+
+            try
+            {
+                hr = WcaTestCreatePackage(wzPackagePath, &hDatabase);
+                NativeAssert::Succeeded(hr, "Failed to create test package.");
+
+                hr = WcaTestOpenSession(wzPackagePath, &hDatabase, &hInstall);
+                NativeAssert::Succeeded(hr, "Failed to open session on test package.");
+            }
+            finally
+            {
+                if (hDatabase)
+                {
+                    ::MsiCloseHandle(hDatabase);
+                }
+            }
+
+            return hInstall;
+        }
+
+        void CloseCaDataTestSession(MSIHANDLE hInstall, String^ packagePath)
+        {
+            WcaTestCloseSession(hInstall);
+
+            if (File::Exists(packagePath))
+            {
+                File::Delete(packagePath);
+            }
+        }
+    };
+}
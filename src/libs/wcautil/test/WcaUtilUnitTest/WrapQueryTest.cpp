@@ -0,0 +1,530 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+static const DWORD TEST_ROW_COUNT = 300;
+
+static LPCWSTR vrgwzTestAccounts[] =
+{
+    L"BUILTIN\\Administrators",
+    L"BUILTIN\\Users",
+    L"NT AUTHORITY\\NETWORK SERVICE",
+};
+
+// Accounts that only differ by case or by characters a linguistic comparison ignores.
+static LPCWSTR vrgwzVariantAccounts[] =
+{
+    L"Administrators",
+    L"Admin\x00ADistrators",
+    L"ADMINISTRATORS",
+};
+
+static HRESULT WriteVariantTable(
+    __in BOOL fColumnar,
+    __in DWORD cRows,
+    __deref_inout_z LPWSTR* psczCustomActionData
+    );
+
+namespace WcaUtilTests
+{
+    public ref class WrapQuery
+    {
+    public:
+        [Fact]
+        void WrapQueryRoundTripsTableTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            LPWSTR sczCustomActionData = NULL;
+            LPWSTR pwzCustomActionData = NULL;
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            MSIHANDLE hRec = NULL;
+            LPWSTR sczValue = NULL;
+            int iValue = 0;
+            DWORD dwRow = 0;
+            array<bool>^ seen = gcnew array<bool>(TEST_ROW_COUNT);
+
+            try
+            {
+                hInstall = OpenWrapTestSession(packagePath, TEST_ROW_COUNT);
+
+                hr = WcaWrapQuery(L"SELECT `Id`, `Account`, `Value` FROM `WrapTest`", &sczCustomActionData, 0, 0xFFFFFFFF, 0xFFFFFFFF);
+                NativeAssert::Succeeded(hr, "Failed to wrap query.");
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::Succeeded(hr, "Failed to unwrap query.");
+
+                Assert::Equal<DWORD>(TEST_ROW_COUNT, WcaGetQueryRecords(hWrapQuery));
+
+                while (S_OK == (hr = WcaFetchWrappedRecord(hWrapQuery, &hRec)))
+                {
+                    hr = WcaGetRecordString(hRec, 1, &sczValue);
+                    NativeAssert::Succeeded(hr, "Failed to get id.");
+
+                    dwRow = UInt32::Parse(gcnew String(sczValue + 3));
+                    Assert::False(seen[dwRow]);
+                    seen[dwRow] = true;
+
+                    hr = WcaGetRecordString(hRec, 2, &sczValue);
+                    NativeAssert::Succeeded(hr, "Failed to get account.");
+                    NativeAssert::StringEqual(vrgwzTestAccounts[dwRow % countof(vrgwzTestAccounts)], sczValue);
+
+                    hr = WcaGetRecordInteger(hRec, 3, &iValue);
+                    NativeAssert::Succeeded(hr, "Failed to get value.");
+                    Assert::Equal(TestRowValue(dwRow), iValue);
+                }
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+
+                Assert::DoesNotContain<bool>(false, seen);
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczCustomActionData);
+                CloseWrapTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void WrapQueryIsSmallerThanRowByRowTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            LPWSTR sczCustomActionData = NULL;
+            LPWSTR sczRowByRowData = NULL;
+            LPWSTR pwzCustomActionData = NULL;
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            MSIHANDLE hRec = NULL;
+            LPWSTR sczValue = NULL;
+            int iValue = 0;
+            size_t cchColumnar = 0;
+            size_t cchRowByRow = 0;
+
+            try
+            {
+                hInstall = OpenWrapTestSession(packagePath, TEST_ROW_COUNT);
+
+                hr = WcaWrapQuery(L"SELECT `Id`, `Account`, `Value` FROM `WrapTest`", &sczCustomActionData, 0, 0xFFFFFFFF, 0xFFFFFFFF);
+                NativeAssert::Succeeded(hr, "Failed to wrap query.");
+
+                cchColumnar = wcslen(sczCustomActionData);
+
+                // Write the same rows the way WcaWrapQuery did before tables were written column by column.
+                WriteRowByRowHeader(TEST_ROW_COUNT, &sczRowByRowData);
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::Succeeded(hr, "Failed to unwrap query.");
+
+                while (S_OK == (hr = WcaFetchWrappedRecord(hWrapQuery, &hRec)))
+                {
+                    hr = WcaWriteIntegerToCaData(wqaRowBegin, &sczRowByRowData);
+                    NativeAssert::Succeeded(hr, "Failed to write row begin.");
+
+                    for (DWORD i = 1; i <= 2; ++i)
+                    {
+                        hr = WcaGetRecordString(hRec, i, &sczValue);
+                        NativeAssert::Succeeded(hr, "Failed to get string.");
+
+                        hr = WcaWriteStringToCaData(sczValue, &sczRowByRowData);
+                        NativeAssert::Succeeded(hr, "Failed to write string.");
+                    }
+
+                    hr = WcaGetRecordInteger(hRec, 3, &iValue);
+                    NativeAssert::Succeeded(hr, "Failed to get value.");
+
+                    hr = WcaWriteIntegerToCaData(iValue, &sczRowByRowData);
+                    NativeAssert::Succeeded(hr, "Failed to write value.");
+
+                    hr = WcaWriteIntegerToCaData(wqaRowFinish, &sczRowByRowData);
+                    NativeAssert::Succeeded(hr, "Failed to write row finish.");
+                }
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+
+                hr = WcaWriteIntegerToCaData(wqaTableFinish, &sczRowByRowData);
+                NativeAssert::Succeeded(hr, "Failed to write table finish.");
+
+                cchRowByRow = wcslen(sczRowByRowData);
+
+                // Every row repeats one of three account names and drops its row markers, so the data should shrink by at least a quarter.
+                Assert::True(cchColumnar * 4 < cchRowByRow * 3, String::Format("Columnar data is {0} characters, row by row data is {1} characters.", cchColumnar, cchRowByRow));
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczRowByRowData);
+                ReleaseStr(sczCustomActionData);
+                CloseWrapTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void WrapQueryFetchWhereStringMatchesExactStringsTest()
+        {
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+
+            try
+            {
+                hInstall = OpenWrapTestSession(packagePath, 0);
+
+                VerifyVariantLookups(TRUE);
+                VerifyVariantLookups(FALSE);
+            }
+            finally
+            {
+                CloseWrapTestSession(hInstall, packagePath);
+            }
+        }
+
+        [Fact]
+        void WrapQueryRejectsOutOfRangeIntegersTest()
+        {
+            HRESULT hr = S_OK;
+            String^ packagePath = Path::Combine(Path::GetTempPath(), Guid::NewGuid().ToString("N") + ".msi");
+            MSIHANDLE hInstall = NULL;
+            LPWSTR sczCustomActionData = NULL;
+            LPWSTR pwzCustomActionData = NULL;
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            MSIHANDLE hRec = NULL;
+            int iValue = 0;
+
+            try
+            {
+                hInstall = OpenWrapTestSession(packagePath, 0);
+
+                WriteColumnarIntegers(2, L"-2147483648,2147483647", &sczCustomActionData);
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::Succeeded(hr, "Failed to unwrap integers at the limits.");
+
+                hr = WcaFetchWrappedRecord(hWrapQuery, &hRec);
+                NativeAssert::Succeeded(hr, "Failed to fetch first row.");
+
+                hr = WcaGetRecordInteger(hRec, 1, &iValue);
+                NativeAssert::Succeeded(hr, "Failed to get first value.");
+                Assert::Equal(Int32::MinValue, iValue);
+
+                hr = WcaFetchWrappedRecord(hWrapQuery, &hRec);
+                NativeAssert::Succeeded(hr, "Failed to fetch second row.");
+
+                hr = WcaGetRecordInteger(hRec, 1, &iValue);
+                NativeAssert::Succeeded(hr, "Failed to get second value.");
+                Assert::Equal(Int32::MaxValue, iValue);
+
+                WcaFinishUnwrapQuery(hWrapQuery);
+                hWrapQuery = NULL;
+                ReleaseNullStr(sczCustomActionData);
+
+                WriteColumnarIntegers(1, L"2147483648", &sczCustomActionData);
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::ValidReturnCode(hr, E_INVALIDARG);
+
+                ReleaseNullStr(sczCustomActionData);
+
+                WriteColumnarIntegers(1, L"-99999999999", &sczCustomActionData);
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::ValidReturnCode(hr, E_INVALIDARG);
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+                ReleaseStr(sczCustomActionData);
+                CloseWrapTestSession(hInstall, packagePath);
+            }
+        }
+
+    private:
+        static int TestRowValue(DWORD dwRow)
+        {
+            return static_cast<int>(dwRow * 7) - 1000;
+        }
+
+        MSIHANDLE OpenWrapTestSession(String^ packagePath, DWORD cRows)
+        {
+            HRESULT hr = S_OK;
+            pin_ptr<const WCHAR> wzPackagePath = PtrToStringChars(packagePath);
+            MSIHANDLE hDatabase = NULL;
+            MSIHANDLE hRecord = NULL;
+            MSIHANDLE hInstall = NULL;
+            WCHAR wzId[16] = { };
+
+            try
+            {
+                hr = WcaTestCreatePackage(wzPackagePath, &hDatabase);
+                NativeAssert::Succeeded(hr, "Failed to create test package.");
+
+                hr = WcaTestExecuteQuery(hDatabase, L"CREATE TABLE `WrapTest` (`Id` CHAR(72) NOT NULL, `Account` CHAR(72), `Value` LONG PRIMARY KEY `Id`)", NULL);
+                NativeAssert::Succeeded(hr, "Failed to create WrapTest table.");
+
+                hRecord = ::MsiCreateRecord(3);
+                Assert::NotEqual<MSIHANDLE>(NULL, hRecord);
+
+                for (DWORD i = 0; i < cRows; ++i)
+                {
+                    hr = ::StringCchPrintfW(wzId, countof(wzId), L"Row%03u", i);
+                    NativeAssert::Succeeded(hr, "Failed to format row id.");
+
+                    ::MsiRecordSetStringW(hRecord, 1, wzId);
+                    ::MsiRecordSetStringW(hRecord, 2, vrgwzTestAccounts[i % countof(vrgwzTestAccounts)]);
+                    ::MsiRecordSetInteger(hRecord, 3, TestRowValue(i));
+
+                    hr = WcaTestExecuteQuery(hDatabase, L"INSERT INTO `WrapTest` (`Id`, `Account`, `Value`) VALUES (?, ?, ?)", hRecord);
+                    NativeAssert::Succeeded(hr, "Failed to add WrapTest row.");
+                }
+
+                hr = WcaTestOpenSession(wzPackagePath, &hDatabase, &hInstall);
+                NativeAssert::Succeeded(hr, "Failed to open session on test package.");
+            }
+            finally
+            {
+                if (hRecord)
+                {
+                    ::MsiCloseHandle(hRecord);
+                }
+
+                if (hDatabase)
+                {
+                    ::MsiCloseHandle(hDatabase);
+                }
+            }
+
+            return hInstall;
+        }
+
+        void CloseWrapTestSession(MSIHANDLE hInstall, String^ packagePath)
+        {
+            WcaTestCloseSession(hInstall);
+
+            if (File::Exists(packagePath))
+            {
+                File::Delete(packagePath);
+            }
+        }
+
+        void WriteRowByRowHeader(DWORD cRows, LPWSTR* psczCustomActionData)
+        {
+            HRESULT hr = S_OK;
+
+            hr = WcaWriteIntegerToCaData(wqaTableBegin, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write table begin.");
+
+            hr = WcaWriteIntegerToCaData(3, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column count.");
+
+            hr = WcaWriteIntegerToCaData(static_cast<int>(cRows), psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write row count.");
+
+            hr = WcaWriteStringToCaData(L"Id", psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column name.");
+
+            hr = WcaWriteIntegerToCaData(cdtString, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column type.");
+
+            hr = WcaWriteStringToCaData(L"Account", psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column name.");
+
+            hr = WcaWriteIntegerToCaData(cdtString, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column type.");
+
+            hr = WcaWriteStringToCaData(L"Value", psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column name.");
+
+            hr = WcaWriteIntegerToCaData(cdtInt, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column type.");
+        }
+
+        void WriteColumnarIntegers(DWORD cRows, LPCWSTR wzValues, LPWSTR* psczCustomActionData)
+        {
+            HRESULT hr = S_OK;
+
+            hr = WcaWriteIntegerToCaData(wqaColumnarTableBegin, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write table begin.");
+
+            hr = WcaWriteIntegerToCaData(1, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column count.");
+
+            hr = WcaWriteIntegerToCaData(static_cast<int>(cRows), psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write row count.");
+
+            hr = WcaWriteStringToCaData(L"Value", psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column name.");
+
+            hr = WcaWriteIntegerToCaData(cdtInt, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column type.");
+
+            hr = WcaWriteIntegerToCaData(0, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write string count.");
+
+            hr = WcaWriteStringToCaData(wzValues, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write column values.");
+
+            hr = WcaWriteIntegerToCaData(wqaTableFinish, psczCustomActionData);
+            NativeAssert::Succeeded(hr, "Failed to write table finish.");
+        }
+
+        void VerifyVariantLookups(BOOL fColumnar)
+        {
+            HRESULT hr = S_OK;
+            const DWORD cRows = 60;
+            LPWSTR sczCustomActionData = NULL;
+            LPWSTR pwzCustomActionData = NULL;
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            MSIHANDLE hRec = NULL;
+            LPWSTR sczValue = NULL;
+            DWORD dwExpectedRow = 0;
+
+            try
+            {
+                hr = WriteVariantTable(fColumnar, cRows, &sczCustomActionData);
+                NativeAssert::Succeeded(hr, "Failed to write variant table.");
+
+                pwzCustomActionData = sczCustomActionData;
+                hr = WcaBeginUnwrapQuery(&hWrapQuery, &pwzCustomActionData);
+                NativeAssert::Succeeded(hr, "Failed to unwrap variant table.");
+
+                for (DWORD i = 0; i < countof(vrgwzVariantAccounts); ++i)
+                {
+                    WcaFetchWrappedReset(hWrapQuery);
+
+                    // Every row with exactly this account is found, in row order, and nothing else.
+                    for (dwExpectedRow = i; S_OK == (hr = WcaFetchWrappedRecordWhereString(hWrapQuery, 2, vrgwzVariantAccounts[i], &hRec)); dwExpectedRow += countof(vrgwzVariantAccounts))
+                    {
+                        hr = WcaGetRecordString(hRec, 1, &sczValue);
+                        NativeAssert::Succeeded(hr, "Failed to get id.");
+
+                        Assert::Equal<DWORD>(dwExpectedRow, UInt32::Parse(gcnew String(sczValue + 3)));
+                    }
+                    NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+
+                    Assert::Equal<DWORD>(cRows + i, dwExpectedRow);
+                }
+
+                WcaFetchWrappedReset(hWrapQuery);
+
+                hr = WcaFetchWrappedRecordWhereString(hWrapQuery, 2, L"administrators", &hRec);
+                NativeAssert::ValidReturnCode(hr, E_NOMOREITEMS);
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczCustomActionData);
+            }
+        }
+    };
+}
+
+
+static HRESULT WriteVariantTable(
+    __in BOOL fColumnar,
+    __in DWORD cRows,
+    __deref_inout_z LPWSTR* psczCustomActionData
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczId = NULL;
+    LPWSTR sczIds = NULL;
+    LPWSTR sczAccounts = NULL;
+
+    hr = WcaWriteIntegerToCaData(fColumnar ? wqaColumnarTableBegin : wqaTableBegin, psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write table begin.");
+
+    hr = WcaWriteIntegerToCaData(2, psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write column count.");
+
+    hr = WcaWriteIntegerToCaData(static_cast<int>(cRows), psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write row count.");
+
+    hr = WcaWriteStringToCaData(L"Id", psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write column name.");
+
+    hr = WcaWriteIntegerToCaData(cdtString, psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write column type.");
+
+    hr = WcaWriteStringToCaData(L"Account", psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write column name.");
+
+    hr = WcaWriteIntegerToCaData(cdtString, psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write column type.");
+
+    if (fColumnar)
+    {
+        // The pool holds every id followed by the variant accounts.
+        hr = WcaWriteIntegerToCaData(static_cast<int>(cRows + countof(vrgwzVariantAccounts)), psczCustomActionData);
+        ExitOnFailure(hr, "Failed to write string count.");
+
+        for (DWORD i = 0; i < cRows; ++i)
+        {
+            hr = StrAllocFormatted(&sczId, L"Row%03u", i);
+            ExitOnFailure(hr, "Failed to format id.");
+
+            hr = WcaWriteStringToCaData(sczId, psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write pooled id.");
+
+            hr = StrAllocConcatFormatted(&sczIds, i ? L",%u" : L"%u", i);
+            ExitOnFailure(hr, "Failed to format id column.");
+
+            hr = StrAllocConcatFormatted(&sczAccounts, i ? L",%u" : L"%u", cRows + i % countof(vrgwzVariantAccounts));
+            ExitOnFailure(hr, "Failed to format account column.");
+        }
+
+        for (DWORD i = 0; i < countof(vrgwzVariantAccounts); ++i)
+        {
+            hr = WcaWriteStringToCaData(vrgwzVariantAccounts[i], psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write pooled account.");
+        }
+
+        hr = WcaWriteStringToCaData(sczIds, psczCustomActionData);
+        ExitOnFailure(hr, "Failed to write id column.");
+
+        hr = WcaWriteStringToCaData(sczAccounts, psczCustomActionData);
+        ExitOnFailure(hr, "Failed to write account column.");
+    }
+    else
+    {
+        for (DWORD i = 0; i < cRows; ++i)
+        {
+            hr = StrAllocFormatted(&sczId, L"Row%03u", i);
+            ExitOnFailure(hr, "Failed to format id.");
+
+            hr = WcaWriteIntegerToCaData(wqaRowBegin, psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write row begin.");
+
+            hr = WcaWriteStringToCaData(sczId, psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write id.");
+
+            hr = WcaWriteStringToCaData(vrgwzVariantAccounts[i % countof(vrgwzVariantAccounts)], psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write account.");
+
+            hr = WcaWriteIntegerToCaData(wqaRowFinish, psczCustomActionData);
+            ExitOnFailure(hr, "Failed to write row finish.");
+        }
+    }
+
+    hr = WcaWriteIntegerToCaData(wqaTableFinish, psczCustomActionData);
+    ExitOnFailure(hr, "Failed to write table finish.");
+
+LExit:
+    ReleaseStr(sczAccounts);
+    ReleaseStr(sczIds);
+    ReleaseStr(sczId);
+
+    return hr;
+}